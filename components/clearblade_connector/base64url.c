@@ -22,10 +22,10 @@ static const char base64en[] = {
 
 #define BASE64DE_FIRST	'+'
 #define BASE64DE_LAST	'z'
-/* ASCII order for BASE 64 decode, -1 in unused character */
+/* ASCII order for BASE 64 decode, -1 in unused character ('-' y '_' del alfabeto url, '+' y '/' tambien se aceptan) */
 static const signed char base64de[] = {
 	/* '+', ',', '-', '.', '/', '0', '1', '2', */ 
-	    62,  -1,  -1,  -1,  63,  52,  53,  54,
+	    62,  -1,  62,  -1,  63,  52,  53,  54,
 
 	/* '3', '4', '5', '6', '7', '8', '9', ':', */
 	    55,  56,  57,  58,  59,  60,  61,  -1,
@@ -43,7 +43,7 @@ static const signed char base64de[] = {
 	    18,  19,  20,  21,  22,  23,  24,  25,
 
 	/* '[', '\', ']', '^', '_', '`', 'a', 'b', */ 
-	    -1,  -1,  -1,  -1,  -1,  -1,  26,  27,
+	    -1,  -1,  -1,  -1,  63,  -1,  26,  27,
 
 	/* 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', */ 
 	    28,  29,  30,  31,  32,  33,  34,  35,
@@ -0,0 +1,161 @@
+/*
+ * boot_timeline.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_sleep.h"
+
+#include "boot_timeline.h"
+
+#define BOOT_TIMELINE_MAGIC 0xB0071E5A
+
+static const char *TAG = "Boot timeline";
+
+/************************************************************************/
+/* Anillo de registros en memoria RTC.                                  */
+/*                                                                      */
+/* Se usa RTC_NOINIT_ATTR (y no RTC_DATA_ATTR) para que el contenido    */
+/* sobreviva tambien a los reinicios por software y por watchdog, no    */
+/* solo al deep sleep. Tras un encendido la memoria contiene basura,    */
+/* por eso se valida con un numero magico.                              */
+/************************************************************************/
+typedef struct
+{
+    uint32_t magic;
+    uint32_t boot_count;
+    uint8_t head;
+    boot_timeline_record_t records[BOOT_TIMELINE_DEPTH];
+} boot_timeline_ring_t;
+
+static RTC_NOINIT_ATTR boot_timeline_ring_t ring;
+
+// Registro del arranque actual, NULL hasta llamar a initialize().
+static boot_timeline_record_t *current = NULL;
+
+// El resumen se envia una unica vez por arranque, cuando una publicacion lo entrega.
+static bool summary_reported = false;
+
+static void initialize(void)
+{
+    esp_reset_reason_t reset_reason = esp_reset_reason();
+
+    if (ring.magic != BOOT_TIMELINE_MAGIC || ring.head >= BOOT_TIMELINE_DEPTH || reset_reason == ESP_RST_POWERON)
+    {
+        memset(&ring, 0, sizeof(ring));
+        ring.magic = BOOT_TIMELINE_MAGIC;
+        ring.head = BOOT_TIMELINE_DEPTH - 1;
+    }
+
+    ring.head = (ring.head + 1) % BOOT_TIMELINE_DEPTH;
+    ring.boot_count++;
+
+    current = &ring.records[ring.head];
+    memset(current, 0, sizeof(*current));
+    current->boot_number = ring.boot_count;
+    current->reset_reason = (uint8_t)reset_reason;
+    current->wakeup_cause = (uint8_t)esp_sleep_get_wakeup_cause();
+
+    ESP_LOGI(TAG, "Arranque numero %lu, reset: %d, wakeup: %d",
+             (unsigned long)current->boot_number, current->reset_reason, current->wakeup_cause);
+}
+
+/************************************************************************/
+/* Marca el instante de una fase. Solo se conserva la primera marca,    */
+/* asi las reconexiones no pisan el valor del arranque.                 */
+/* No reserva memoria ni toma locks: se puede llamar desde cualquier    */
+/* tarea o callback de eventos.                                         */
+/************************************************************************/
+static void stamp(boot_phase_t phase)
+{
+    if (current == NULL || phase >= BOOT_PHASE_COUNT)
+        return;
+    if (current->phase_us[phase] == 0)
+        current->phase_us[phase] = esp_timer_get_time();
+}
+
+/* boots_ago = 0 es el arranque actual, 1 el anterior, etc. */
+static const boot_timeline_record_t *get_record(uint8_t boots_ago)
+{
+    if (current == NULL || boots_ago >= BOOT_TIMELINE_DEPTH || boots_ago >= ring.boot_count)
+        return NULL;
+    return &ring.records[(ring.head + BOOT_TIMELINE_DEPTH - boots_ago) % BOOT_TIMELINE_DEPTH];
+}
+
+static int append_phases(char *buffer, size_t buffer_len, const boot_timeline_record_t *record)
+{
+    int len = 0;
+    for (int i = 0; i < BOOT_PHASE_COUNT && len < buffer_len; i++)
+    {
+        if (record->phase_us[i] == 0)
+            len += snprintf(buffer + len, buffer_len - len, "%snull", i ? ", " : "[");
+        else
+            len += snprintf(buffer + len, buffer_len - len, "%s%lu", i ? ", " : "[", (unsigned long)(record->phase_us[i] / 1000));
+    }
+    if (len < buffer_len)
+        len += snprintf(buffer + len, buffer_len - len, "]");
+    return len;
+}
+
+/************************************************************************/
+/* Escribe en buffer un fragmento JSON con los tiempos en ms desde el   */
+/* arranque de cada fase, del arranque actual y del anterior:           */
+/*   "boot": {"n": 7, "rst": 8, "wake": 4, "ms": [...], "prev_ms": [...]} */
+/* Devuelve la cantidad de caracteres escritos, o 0 si el resumen ya    */
+/* fue reportado en este arranque o no entra en el buffer. Se sigue     */
+/* devolviendo hasta que se llame a mark_reported().                    */
+/************************************************************************/
+static int summarize(char *buffer, size_t buffer_len)
+{
+    if (current == NULL || summary_reported)
+        return 0;
+
+    int len = snprintf(buffer, buffer_len, "\"boot\": {\"n\": %lu, \"rst\": %d, \"wake\": %d, \"ms\": ",
+                       (unsigned long)current->boot_number, current->reset_reason, current->wakeup_cause);
+    if (len < buffer_len)
+        len += append_phases(buffer + len, buffer_len - len, current);
+
+    const boot_timeline_record_t *previous = get_record(1);
+    if (previous != NULL && len < buffer_len)
+    {
+        len += snprintf(buffer + len, buffer_len - len, ", \"prev_ms\": ");
+        if (len < buffer_len)
+            len += append_phases(buffer + len, buffer_len - len, previous);
+    }
+    if (len < buffer_len)
+        len += snprintf(buffer + len, buffer_len - len, "}");
+
+    if (len >= buffer_len)
+    {
+        ESP_LOGW(TAG, "Buffer insuficiente para el resumen de arranque.");
+        buffer[0] = 0;
+        return 0;
+    }
+    return len;
+}
+
+/* El mensaje con el resumen se publico: no se vuelve a incluir */
+static void mark_reported(void)
+{
+    summary_reported = true;
+}
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)            *
+ ******************************************************/
+const boot_timeline_t boot_timeline = {
+    // Boot Timeline Functions
+    .initialize = initialize,
+    .stamp = stamp,
+    .get_record = get_record,
+    .summarize = summarize,
+    .mark_reported = mark_reported,
+};
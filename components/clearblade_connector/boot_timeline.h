@@ -0,0 +1,57 @@
+/*
+ * boot_timeline.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef BOOT_TIMELINE_H_
+#define BOOT_TIMELINE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Fases del arranque que se registran, en el orden en que normalmente ocurren */
+typedef enum
+{
+    BOOT_PHASE_NVS_INIT = 0,
+    BOOT_PHASE_WIFI_INIT,
+    BOOT_PHASE_GOT_IP,
+    BOOT_PHASE_SNTP_SYNC,
+    BOOT_PHASE_JWT_GENERATED,
+    BOOT_PHASE_MQTT_CONNECTED,
+    BOOT_PHASE_FIRST_PUBACK,
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+/* Cantidad de arranques que se conservan en el anillo de memoria RTC */
+#define BOOT_TIMELINE_DEPTH 4
+
+typedef struct
+{
+    uint32_t boot_number;
+    uint8_t reset_reason;
+    uint8_t wakeup_cause;
+    int64_t phase_us[BOOT_PHASE_COUNT]; // 0 = fase no alcanzada
+} boot_timeline_record_t;
+
+/************************************************************************/
+/* La siguiente estructura simula un objeto en C                        */
+/*                                                                      */
+/* Registra, con esp_timer_get_time(), el instante en que se alcanza    */
+/* cada fase del arranque. Los registros viven en memoria RTC y se      */
+/* conservan tras reinicios por software y deep sleep.                  */
+/************************************************************************/
+typedef struct
+{
+    // Boot Timeline Functions
+    void (*initialize)(void);
+    void (*stamp)(boot_phase_t phase);
+    const boot_timeline_record_t *(*get_record)(uint8_t boots_ago);
+    int (*summarize)(char *buffer, size_t buffer_len);
+    void (*mark_reported)(void); // Llamar cuando se publico el mensaje con el resumen
+} boot_timeline_t;
+
+extern const boot_timeline_t boot_timeline;
+
+#endif /* BOOT_TIMELINE_H_ */
@@ -11,81 +11,413 @@
 #include "freertos/event_groups.h"
 #include "nvs_flash.h"
 #include "sntp_time.h"
+#include "certs.h"
 #include "clearblade_connect.h"
 #include "mqtt_basico.h"
 #include "string.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "energy_meter.h"
+#include "telemetry_capture.h"
+#include "cJSON.h"
 
 #define CLEARBLADE_DEFAULT_BROKER_URI "mqtts://us-central1-mqtt.clearblade.com"
 
-extern bool time_sinc_ok;
+static const char *TAG = "Clearblade connector";
 
-clearblade_data_t clearblade_data;
-esp_mqtt_client_handle_t client_handle = NULL;
+/* Instancia por defecto, usada por el objeto mqtt_client */
+static clearblade_client_t default_client;
 
-/* FreeRTOS event group - Clearblade client state */
-EventGroupHandle_t mqtt_client_event_group;
+static void copy_identifier(char *dest, size_t dest_len, const char *src, const char *name)
+{
+    if (strlcpy(dest, src != NULL ? src : "", dest_len) >= dest_len)
+        ESP_LOGE(TAG, "%s demasiado largo, maximo %d caracteres.", name, (int)dest_len - 1);
+}
 
-void set_clearblade_data(const char *brokerUri, const char *projectId, const char *region, const char *registry, const char *deviceId)
+/* Client ID que exige Clearblade: projects/../locations/../registries/../devices/.. */
+int clearblade_format_client_id(char *buffer, size_t buffer_len, const char *projectId, const char *region, const char *registry, const char *deviceId)
+{
+    return snprintf(buffer, buffer_len, "projects/%s/locations/%s/registries/%s/devices/%s", projectId, region, registry, deviceId);
+}
+
+/* Topic /devices/<device-id>/<subtopic>; con subtopic NULL, "events" (telemetria) */
+int clearblade_format_topic(char *buffer, size_t buffer_len, const char *deviceId, const char *subtopic)
+{
+    return snprintf(buffer, buffer_len, "/devices/%s/%s", deviceId, subtopic != NULL ? subtopic : "events");
+}
+
+/************************************************************************/
+/* Deja la instancia lista para configurar. No reserva memoria: el      */
+/* grupo de eventos usa almacenamiento dentro de la propia instancia.   */
+/************************************************************************/
+void clearblade_client_init(clearblade_client_t *client)
+{
+    memset(client, 0, sizeof(*client));
+    client->event_group = xEventGroupCreateStatic(&client->event_group_buffer);
+    xEventGroupSetBits(client->event_group, DISCONNECTED_FROM_MQTT_BROKER);
+
+    client->private_key = DEVICE_KEY;
+    client->private_key_len = strlen(DEVICE_KEY);
+
+    publish_limit_config_t limits = {
+        .msgs_per_s = PUBLISH_LIMITER_MSGS_PER_S,
+        .msg_burst = PUBLISH_LIMITER_MSG_BURST,
+        .bytes_per_s = PUBLISH_LIMITER_BYTES_PER_S,
+        .byte_burst = PUBLISH_LIMITER_BYTE_BURST,
+    };
+    publish_limiter_init(&client->publish_limiter, &limits);
+
+    client->link_mutex = xSemaphoreCreateMutexStatic(&client->link_mutex_buffer);
+    for (int i = 0; i < CLEARBLADE_INFLIGHT_TRACKED; i++)
+        client->inflight[i].msg_id = -1;
+}
+
+void clearblade_client_set_data(clearblade_client_t *client, const char *brokerUri, const char *projectId, const char *region, const char *registry, const char *deviceId)
+{
+    copy_identifier(client->broker_uri, sizeof(client->broker_uri), brokerUri != NULL ? brokerUri : CLEARBLADE_DEFAULT_BROKER_URI, "brokerUri");
+    copy_identifier(client->project_id, sizeof(client->project_id), projectId, "projectId");
+    copy_identifier(client->region, sizeof(client->region), region, "region");
+    copy_identifier(client->registry, sizeof(client->registry), registry, "registry");
+    copy_identifier(client->device_id, sizeof(client->device_id), deviceId, "deviceId");
+
+    clearblade_format_client_id(client->client_id, sizeof(client->client_id),
+                                client->project_id, client->region, client->registry, client->device_id);
+
+    client->clearblade_data.brokerUri = client->broker_uri;
+    client->clearblade_data.projectId = client->project_id;
+    client->clearblade_data.region = client->region;
+    client->clearblade_data.registry = client->registry;
+    client->clearblade_data.deviceId = client->device_id;
+    client->clearblade_data.clientId = client->client_id;
+}
+
+/* La clave (PEM) debe permanecer valida mientras exista el cliente */
+void clearblade_client_set_private_key(clearblade_client_t *client, const char *private_key, size_t private_key_len)
+{
+    client->private_key = private_key;
+    client->private_key_len = private_key_len;
+}
+
+void clearblade_client_set_data_callback(clearblade_client_t *client, clearblade_data_callback_t callback, void *ctx)
+{
+    client->data_callback = callback;
+    client->data_callback_ctx = ctx;
+}
+
+void clearblade_client_set_connection_callback(clearblade_client_t *client, clearblade_connection_callback_t callback, void *ctx)
+{
+    client->connection_callback = callback;
+    client->connection_callback_ctx = ctx;
+}
+
+void clearblade_client_start(clearblade_client_t *client)
+{
+    // La hora puede estar disponible de inmediato (RTC tras deep sleep); SNTP sigue en segundo plano.
+    // La espera de red y hora la hace mqtt_app_main_task, start() no bloquea.
+    time_service.initialize();
+
+#ifdef STATIC_ALLOCATION_MODE
+    client->task = xTaskCreateStatic(mqtt_app_main_task, "mqtt_app_task", CLEARBLADE_MQTT_TASK_STACK_SIZE, client, 3,
+                                     client->task_stack, &client->task_buffer);
+#else
+    xTaskCreate(mqtt_app_main_task, "mqtt_app_task", CLEARBLADE_MQTT_TASK_STACK_SIZE, client, 3, &client->task);
+#endif
+}
+
+void clearblade_client_set_network_available(clearblade_client_t *client, bool is_network_available)
+{
+    if (is_network_available)
+        xEventGroupSetBits(client->event_group, NETWORK_AVAILABLE);
+    else
+        xEventGroupClearBits(client->event_group, NETWORK_AVAILABLE);
+}
+
+/************************************************************************/
+/* Reinicio pedido por el supervisor de vida (cliente trabado). stop()  */
+/* no siempre entrega MQTT_EVENT_DISCONNECTED: los bits se ajustan aca  */
+/* para que mqtt_app_main_task firme un JWT nuevo y lo configure.       */
+/************************************************************************/
+esp_err_t clearblade_client_restart(clearblade_client_t *client)
+{
+    if (client->client_handle == NULL)
+        return ESP_ERR_INVALID_STATE; // mqtt_app_main_task no llego a crearlo
+    ESP_LOGW(TAG, "Reiniciando el cliente MQTT de %s", client->device_id);
+    esp_mqtt_client_stop(client->client_handle);
+    if (client->offline_since_us == 0)
+        client->offline_since_us = esp_timer_get_time();
+    xEventGroupClearBits(client->event_group, CONNECTED_TO_MQTT_BROKER);
+    xEventGroupSetBits(client->event_group, DISCONNECTED_FROM_MQTT_BROKER);
+    return esp_mqtt_client_start(client->client_handle);
+}
+
+/* Publica con la cuota ya reservada */
+static int publish_reserved(clearblade_client_t *client, const char *topic, int topic_len, const char *data, int len, int qos)
 {
-    if (brokerUri != NULL)
+    int64_t sent_us = esp_timer_get_time();
+    int msg_id = esp_mqtt_client_publish(client->client_handle, topic, data, len, qos, 0);
+    if (msg_id < 0)
+        return msg_id;
+    energy_meter.count_publish(topic_len, len, qos, clearblade_client_uses_tls(client));
+    // Lo que salio, como salio: lotes comprimidos incluidos
+    telemetry_capture.record(topic, data, len, qos);
+
+    // El PUBACK puede llegar antes de anotar la salida: se cuenta sin latencia
+    xSemaphoreTake(client->link_mutex, portMAX_DELAY);
+    client->link_stats.published++;
+    if (qos > 0 && msg_id > 0)
     {
-        clearblade_data.brokerUri = malloc(strlen(brokerUri) + 1);
-        strcpy(clearblade_data.brokerUri, brokerUri);
+        client->inflight[client->inflight_next].msg_id = msg_id;
+        client->inflight[client->inflight_next].sent_us = sent_us;
+        client->inflight_next = (client->inflight_next + 1) % CLEARBLADE_INFLIGHT_TRACKED;
     }
-    else
+    xSemaphoreGive(client->link_mutex);
+    return msg_id;
+}
+
+/************************************************************************/
+/* Publica en /devices/<device-id>/<subtopic>. Con subtopic NULL se     */
+/* publica telemetria en "events". Devuelve el msg_id, o -1 si falla.   */
+/*                                                                      */
+/* Toda publicacion pasa por el limitador de la instancia: si la cuota  */
+/* esta agotada la tarea espera su turno, y si la espera supera         */
+/* PUBLISH_LIMITER_MAX_WAIT_MS el mensaje se rechaza (-1).              */
+/************************************************************************/
+int clearblade_client_publish(clearblade_client_t *client, const char *subtopic, const char *data, int len, int qos)
+{
+    char bufferTopic[sizeof("/devices//") + CLEARBLADE_ID_MAX_LEN + 32];
+
+    int topic_len = clearblade_format_topic(bufferTopic, sizeof(bufferTopic), client->device_id, subtopic);
+    if (client->client_handle == NULL)
+        return -1;
+    if (len <= 0)
+        len = strlen(data);
+    if (!publish_limiter_acquire(&client->publish_limiter, topic_len + len))
     {
-        clearblade_data.brokerUri = malloc(strlen(CLEARBLADE_DEFAULT_BROKER_URI) + 1);
-        strcpy(clearblade_data.brokerUri, CLEARBLADE_DEFAULT_BROKER_URI);
+        ESP_LOGW(TAG, "Cuota de publicacion agotada, se descarta el mensaje a %s", bufferTopic);
+        return -1;
     }
+    return publish_reserved(client, bufferTopic, topic_len, data, len, qos);
+}
+
+/************************************************************************/
+/* Como clearblade_client_publish() pero sin esperar al limitador: si   */
+/* la cuota no alcanza, o no deja keep_msgs/keep_bytes libres para      */
+/* otras publicaciones, devuelve -1 sin publicar y en *retry_us cuanto  */
+/* falta. *retry_us = -1 si el mensaje supera la rafaga de bytes y no   */
+/* va a salir nunca, 0 si fallo la publicacion en si.                   */
+/************************************************************************/
+int clearblade_client_try_publish(clearblade_client_t *client, const char *subtopic, const char *data, int len, int qos,
+                                  uint32_t keep_msgs, uint32_t keep_bytes, int64_t *retry_us)
+{
+    char bufferTopic[sizeof("/devices//") + CLEARBLADE_ID_MAX_LEN + 32];
+
+    *retry_us = 0;
+    int topic_len = clearblade_format_topic(bufferTopic, sizeof(bufferTopic), client->device_id, subtopic);
+    if (client->client_handle == NULL)
+        return -1;
+    if (len <= 0)
+        len = strlen(data);
+    int64_t wait_us = publish_limiter_try_reserve(&client->publish_limiter, topic_len + len, keep_msgs, keep_bytes,
+                                                  esp_timer_get_time());
+    if (wait_us != 0)
+    {
+        *retry_us = wait_us;
+        return -1;
+    }
+    return publish_reserved(client, bufferTopic, topic_len, data, len, qos);
+}
 
-    clearblade_data.projectId = malloc(sizeof(projectId) + 100);
-    strcpy(clearblade_data.projectId, projectId);
+void clearblade_client_set_publish_limits(clearblade_client_t *client, const publish_limit_config_t *limits)
+{
+    publish_limiter_set_config(&client->publish_limiter, limits);
+}
 
-    clearblade_data.region = malloc(sizeof(region) + 100);
-    strcpy(clearblade_data.region, region);
+void clearblade_client_get_publish_limits(clearblade_client_t *client, publish_limit_config_t *limits)
+{
+    publish_limiter_get_config(&client->publish_limiter, limits);
+}
 
-    clearblade_data.registry = malloc(sizeof(registry) + 100);
-    strcpy(clearblade_data.registry, registry);
+void clearblade_client_get_publish_stats(clearblade_client_t *client, publish_limiter_stats_t *stats)
+{
+    publish_limiter_get_stats(&client->publish_limiter, stats);
+}
 
-    clearblade_data.deviceId = malloc(sizeof(deviceId) + 100);
-    strcpy(clearblade_data.deviceId, deviceId);
+void clearblade_client_get_link_stats(clearblade_client_t *client, clearblade_link_stats_t *stats)
+{
+    xSemaphoreTake(client->link_mutex, portMAX_DELAY);
+    *stats = client->link_stats;
+    xSemaphoreGive(client->link_mutex);
+}
 
-    clearblade_data.clientId = malloc(strlen(projectId) + strlen(region) + strlen(registry) + strlen(deviceId) + 500);
-    sprintf(clearblade_data.clientId,
-            "projects/%s/locations/%s/registries/%s/devices/%s",
-            clearblade_data.projectId,
-            clearblade_data.region,
-            clearblade_data.registry,
-            clearblade_data.deviceId);
-};
+static void count_ack(clearblade_client_t *client, int msg_id, int64_t now_us)
+{
+    static const uint32_t bounds_ms[CLEARBLADE_ACK_LATENCY_BUCKETS] = CLEARBLADE_ACK_LATENCY_BOUNDS_MS;
 
-void start(void)
+    client->link_stats.acked++;
+    for (int i = 0; i < CLEARBLADE_INFLIGHT_TRACKED; i++)
+    {
+        if (client->inflight[i].msg_id != msg_id)
+            continue;
+        client->inflight[i].msg_id = -1;
+        uint32_t latency_ms = (uint32_t)((now_us - client->inflight[i].sent_us) / 1000);
+        int bucket = 0;
+        while (bucket < CLEARBLADE_ACK_LATENCY_BUCKETS && latency_ms > bounds_ms[bucket])
+            bucket++;
+        client->link_stats.ack_latency_count[bucket]++;
+        client->link_stats.ack_latency_ms_total += latency_ms;
+        return;
+    }
+    client->link_stats.acked_untracked++;
+}
+
+/* mqtts:// y wss:// van sobre TLS */
+bool clearblade_client_uses_tls(const clearblade_client_t *client)
+{
+    return strncmp(client->broker_uri, "mqtts://", 8) == 0 || strncmp(client->broker_uri, "wss://", 6) == 0;
+}
+
+/* Cada intento de conexion: handshake TLS y CONNECT con el client ID, el usuario y el JWT */
+static void count_connect_energy(clearblade_client_t *client)
+{
+    const esp_mqtt_client_config_t *config = &client->mqtt_config;
+    const char *client_id = config->credentials.client_id;
+    const char *username = config->credentials.username;
+    const char *password = config->credentials.authentication.password;
+    uint32_t remaining = 10 + 2 + (client_id != NULL ? strlen(client_id) : 0) + 2 +
+                         (username != NULL ? strlen(username) : 0) + 2 + (password != NULL ? strlen(password) : 0);
+    bool tls = clearblade_client_uses_tls(client);
+    if (tls)
+        energy_meter.count_handshake();
+    energy_meter.count_tx(energy_meter_mqtt_packet_len(remaining), tls);
+}
+
+void clearblade_client_count_event(clearblade_client_t *client, esp_mqtt_event_id_t event_id, int msg_id)
+{
+    int64_t now_us = esp_timer_get_time();
+    xSemaphoreTake(client->link_mutex, portMAX_DELAY);
+    switch (event_id)
+    {
+    case MQTT_EVENT_BEFORE_CONNECT:
+        count_connect_energy(client);
+        break;
+    case MQTT_EVENT_CONNECTED:
+        client->link_stats.connects++;
+        break;
+    case MQTT_EVENT_DISCONNECTED:
+        client->link_stats.disconnects++;
+        // Los PUBACK pendientes de esta sesion no se van a medir
+        for (int i = 0; i < CLEARBLADE_INFLIGHT_TRACKED; i++)
+            client->inflight[i].msg_id = -1;
+        break;
+    case MQTT_EVENT_PUBLISHED:
+        count_ack(client, msg_id, now_us);
+        break;
+    case MQTT_EVENT_ERROR:
+        client->link_stats.errors++;
+        break;
+    default:
+        break;
+    }
+    xSemaphoreGive(client->link_mutex);
+}
+
+/* Lee item como entero de 32 bits sin signo; si no lo es, avisa y deja *value como estaba */
+static void config_get_u32(const cJSON *object, const char *key, uint32_t *value)
+{
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(object, key);
+    if (item == NULL)
+        return;
+    if (!cJSON_IsNumber(item) || item->valuedouble < 0 || item->valuedouble > UINT32_MAX ||
+        item->valuedouble != (double)(uint32_t)item->valuedouble)
+    {
+        ESP_LOGW(TAG, "Configuracion: \"%s\" no es un entero de 32 bits sin signo, se ignora", key);
+        return;
+    }
+    *value = (uint32_t)item->valuedouble;
+}
+
+/************************************************************************/
+/* Aplica la configuracion recibida en /devices/<device-id>/config.     */
+/* Reconoce los limites de publicacion, por ejemplo:                    */
+/*   {"publish_limit": {"msgs_per_s": 20, "msg_burst": 5,               */
+/*                      "bytes_per_s": 8192, "byte_burst": 2048}}       */
+/* Los limites solo se leen dentro de "publish_limit". Las claves       */
+/* ausentes o invalidas conservan su valor; 0 quita el limite. Devuelve */
+/* true si los limites cambiaron.                                       */
+/* Una clave "version" entera en el primer nivel queda como version de  */
+/* la configuracion, que state_shadow reporta.                          */
+/************************************************************************/
+bool clearblade_client_apply_config(clearblade_client_t *client, const char *data, int len)
 {
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    if (!cJSON_IsObject(root))
+    {
+        ESP_LOGW(TAG, "Configuracion ignorada: no es un objeto JSON");
+        cJSON_Delete(root);
+        return false;
+    }
 
-    mqtt_client_event_group = xEventGroupCreate();
-    xEventGroupSetBits(*mqtt_client.mqtt_event_group, DISCONNECTED_FROM_MQTT_BROKER);
+    publish_limit_config_t limits;
+    publish_limiter_get_config(&client->publish_limiter, &limits);
+    publish_limit_config_t previous = limits;
 
-    xEventGroupWaitBits(mqtt_client_event_group, NETWORK_AVAILABLE,
-                        pdFALSE,
-                        pdFALSE,
-                        portMAX_DELAY);
+    config_get_u32(root, "version", &client->config_version);
+    const cJSON *publish_limit = cJSON_GetObjectItemCaseSensitive(root, "publish_limit");
+    if (cJSON_IsObject(publish_limit))
+    {
+        config_get_u32(publish_limit, "msgs_per_s", &limits.msgs_per_s);
+        config_get_u32(publish_limit, "msg_burst", &limits.msg_burst);
+        config_get_u32(publish_limit, "bytes_per_s", &limits.bytes_per_s);
+        config_get_u32(publish_limit, "byte_burst", &limits.byte_burst);
+    }
+    else if (publish_limit != NULL)
+        ESP_LOGW(TAG, "Configuracion: \"publish_limit\" no es un objeto, se ignora");
+    cJSON_Delete(root);
+    if (memcmp(&limits, &previous, sizeof(limits)) == 0)
+        return false;
 
-    initialize_sntp();
+    // Una rafaga de 0 con tasa no nula no deja pasar nada
+    if (limits.msgs_per_s > 0 && limits.msg_burst == 0)
+        limits.msg_burst = 1;
+    if (limits.bytes_per_s > 0 && limits.byte_burst == 0)
+        limits.byte_burst = limits.bytes_per_s;
 
-    xEventGroupWaitBits(mqtt_client_event_group, NETWORK_AVAILABLE | TIME_SYNCHRONIZED,
-                        pdFALSE,
-                        pdTRUE,
-                        portMAX_DELAY);
+    ESP_LOGI(TAG, "Limites de publicacion: %lu msg/s (rafaga %lu), %lu B/s (rafaga %lu)", (unsigned long)limits.msgs_per_s,
+             (unsigned long)limits.msg_burst, (unsigned long)limits.bytes_per_s, (unsigned long)limits.byte_burst);
+    publish_limiter_set_config(&client->publish_limiter, &limits);
+    return true;
+}
 
-    xTaskCreate(mqtt_app_main_task, "mqtt_app_task", 4096 * 10, NULL, 3, NULL);
+uint32_t clearblade_client_get_config_version(clearblade_client_t *client)
+{
+    return client->config_version;
+}
+
+/*****************************************************
+ *   Instancia por defecto (compatibilidad)          *
+ ******************************************************/
+
+/* Se inicializa con el primer uso: el callback de IP puede llegar antes que set_clearblade_data() */
+static clearblade_client_t *get_default_client(void)
+{
+    if (default_client.event_group == NULL)
+        clearblade_client_init(&default_client);
+    return &default_client;
+}
+
+void set_clearblade_data(const char *brokerUri, const char *projectId, const char *region, const char *registry, const char *deviceId)
+{
+    clearblade_client_set_data(get_default_client(), brokerUri, projectId, region, registry, deviceId);
+};
+
+void start(void)
+{
+    clearblade_client_start(get_default_client());
 }
 
 void set_network_available_flag(bool is_network_available)
 {
-    if (is_network_available)
-        xEventGroupSetBits(mqtt_client_event_group, NETWORK_AVAILABLE);
-    else
-        xEventGroupClearBits(mqtt_client_event_group, NETWORK_AVAILABLE);
+    clearblade_client_set_network_available(get_default_client(), is_network_available);
 }
 
 /*****************************************************
@@ -93,11 +425,12 @@ void set_network_available_flag(bool is_network_available)
  ******************************************************/
 const mqtt_client_t mqtt_client = {
     // Clearblade Connector Props
-    .mqtt_event_group = &mqtt_client_event_group,
-    .client_handle = &client_handle,
-    .clearblade_data = &clearblade_data,
+    .mqtt_event_group = &default_client.event_group,
+    .client_handle = &default_client.client_handle,
+    .clearblade_data = &default_client.clearblade_data,
+    .instance = &default_client,
     // Clearblade Connector Functions
     .set_clearblade_data = set_clearblade_data,
     .start = start,
     .set_network_available_flag = set_network_available_flag,
-};
\ No newline at end of file
+};
@@ -10,10 +10,16 @@
 #define CLEARBLADE_CONNECT_H_
 
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "stdlib.h"
 #include "stdio.h"
+#include "stdbool.h"
 #include "mqtt_client.h"
+#include "jwt_token_gcp.h"
+#include "jwt_signer.h"
+#include "publish_limiter.h"
 
 /* FreeRTOS event group - Clearblade client state   */
 /* EventGroupHandle_t mqtt_client_event_group;      */
@@ -21,6 +27,34 @@
 #define TIME_SYNCHRONIZED BIT1
 #define CONNECTED_TO_MQTT_BROKER BIT3
 #define DISCONNECTED_FROM_MQTT_BROKER BIT4
+#define JWT_TOKEN_READY BIT5
+
+/* Capacidad de los identificadores del dispositivo */
+#define CLEARBLADE_BROKER_URI_MAX_LEN 128
+#define CLEARBLADE_ID_MAX_LEN 64
+#define CLEARBLADE_CLIENT_ID_MAX_LEN (sizeof("projects//locations//registries//devices/") + 4 * CLEARBLADE_ID_MAX_LEN)
+
+/* Stack de la tarea mqtt_app_main_task */
+#define CLEARBLADE_MQTT_TASK_STACK_SIZE (4096 * 10)
+
+/* Latencia publicacion -> PUBACK (QoS 1): limite superior de cada balde, en ms */
+#define CLEARBLADE_ACK_LATENCY_BOUNDS_MS {50, 100, 250, 500, 1000, 2500, 5000, 10000}
+#define CLEARBLADE_ACK_LATENCY_BUCKETS 8
+/* Publicaciones QoS 1 en vuelo cuya hora de salida se recuerda; si hay */
+/* mas, el PUBACK de las pisadas se cuenta sin latencia                 */
+#define CLEARBLADE_INFLIGHT_TRACKED 16
+
+typedef struct
+{
+    uint32_t connects;
+    uint32_t disconnects;
+    uint32_t errors;
+    uint32_t published;        // Aceptadas por el cliente MQTT
+    uint32_t acked;            // PUBACK recibidos
+    uint32_t acked_untracked;  // PUBACK sin hora de salida (no esta en la tabla)
+    uint32_t ack_latency_count[CLEARBLADE_ACK_LATENCY_BUCKETS + 1]; // El ultimo: mas que el mayor limite
+    uint64_t ack_latency_ms_total;
+} clearblade_link_stats_t;
 
 typedef struct
 {
@@ -32,11 +66,103 @@ typedef struct
     char *clientId;
 } clearblade_data_t;
 
+typedef struct clearblade_client clearblade_client_t;
+
+/* Callbacks de la aplicacion; reciben el cliente que los dispara y el contexto registrado */
+typedef void (*clearblade_data_callback_t)(clearblade_client_t *client, const char *topic, int topic_len,
+                                           const char *data, int data_len, void *ctx);
+typedef void (*clearblade_connection_callback_t)(clearblade_client_t *client, bool connected, void *ctx);
+
+/************************************************************************/
+/* Instancia de cliente Clearblade.                                     */
+/*                                                                      */
+/* Contiene todo el estado de una conexion: identidad, clave, handle    */
+/* MQTT, grupo de eventos, token JWT y configuracion. Se pueden crear   */
+/* varias instancias (por ejemplo, una conexion de control y otra de    */
+/* telemetria, o varios dispositivos simulados) con                     */
+/* clearblade_client_init(). Los campos son privados: usar las          */
+/* funciones clearblade_client_*().                                     */
+/************************************************************************/
+struct clearblade_client
+{
+    // Identidad
+    clearblade_data_t clearblade_data;
+    char broker_uri[CLEARBLADE_BROKER_URI_MAX_LEN + 1];
+    char project_id[CLEARBLADE_ID_MAX_LEN + 1];
+    char region[CLEARBLADE_ID_MAX_LEN + 1];
+    char registry[CLEARBLADE_ID_MAX_LEN + 1];
+    char device_id[CLEARBLADE_ID_MAX_LEN + 1];
+    char client_id[CLEARBLADE_CLIENT_ID_MAX_LEN];
+    const char *private_key;
+    size_t private_key_len;
+
+    // Estado de la conexion
+    esp_mqtt_client_handle_t client_handle;
+    EventGroupHandle_t event_group;
+    StaticEventGroup_t event_group_buffer;
+    esp_mqtt_client_config_t mqtt_config;
+    char jwt[JWT_TOKEN_MAX_LEN];
+    jwt_request_t jwt_request;   // Pedido al pool jwt_signer, si esta corriendo
+    int64_t offline_since_us;    // Inicio de la desconexion actual; 0 si esta conectado
+    TaskHandle_t task;
+    publish_limiter_t publish_limiter; // Compartido por todas las publicaciones de la instancia
+    uint32_t config_version;     // Clave "version" de la ultima configuracion, 0 si no vino
+
+    // Estadisticas del enlace; las protege link_mutex
+    clearblade_link_stats_t link_stats;
+    struct
+    {
+        int msg_id;
+        int64_t sent_us;
+    } inflight[CLEARBLADE_INFLIGHT_TRACKED];
+    uint8_t inflight_next;
+    SemaphoreHandle_t link_mutex;
+    StaticSemaphore_t link_mutex_buffer;
+#ifdef STATIC_ALLOCATION_MODE
+    StackType_t task_stack[CLEARBLADE_MQTT_TASK_STACK_SIZE];
+    StaticTask_t task_buffer;
+#endif
+
+    // Callbacks
+    clearblade_data_callback_t data_callback;
+    void *data_callback_ctx;
+    clearblade_connection_callback_t connection_callback;
+    void *connection_callback_ctx;
+};
+
+int clearblade_format_client_id(char *buffer, size_t buffer_len, const char *projectId, const char *region, const char *registry, const char *deviceId);
+int clearblade_format_topic(char *buffer, size_t buffer_len, const char *deviceId, const char *subtopic);
+
+void clearblade_client_init(clearblade_client_t *client);
+void clearblade_client_set_data(clearblade_client_t *client, const char *brokerUri, const char *projectId, const char *region, const char *registry, const char *deviceId);
+void clearblade_client_set_private_key(clearblade_client_t *client, const char *private_key, size_t private_key_len);
+void clearblade_client_set_data_callback(clearblade_client_t *client, clearblade_data_callback_t callback, void *ctx);
+void clearblade_client_set_connection_callback(clearblade_client_t *client, clearblade_connection_callback_t callback, void *ctx);
+void clearblade_client_start(clearblade_client_t *client);
+void clearblade_client_set_network_available(clearblade_client_t *client, bool is_network_available);
+/* Detiene y vuelve a arrancar el cliente MQTT, con un JWT nuevo; ESP_ERR_INVALID_STATE si todavia no existe */
+esp_err_t clearblade_client_restart(clearblade_client_t *client);
+int clearblade_client_publish(clearblade_client_t *client, const char *subtopic, const char *data, int len, int qos);
+int clearblade_client_try_publish(clearblade_client_t *client, const char *subtopic, const char *data, int len, int qos,
+                                  uint32_t keep_msgs, uint32_t keep_bytes, int64_t *retry_us);
+void clearblade_client_set_publish_limits(clearblade_client_t *client, const publish_limit_config_t *limits);
+void clearblade_client_get_publish_limits(clearblade_client_t *client, publish_limit_config_t *limits);
+void clearblade_client_get_publish_stats(clearblade_client_t *client, publish_limiter_stats_t *stats);
+bool clearblade_client_apply_config(clearblade_client_t *client, const char *data, int len);
+uint32_t clearblade_client_get_config_version(clearblade_client_t *client);
+void clearblade_client_get_link_stats(clearblade_client_t *client, clearblade_link_stats_t *stats);
+bool clearblade_client_uses_tls(const clearblade_client_t *client);
+/* Lo llama el manejador de eventos MQTT de la instancia */
+void clearblade_client_count_event(clearblade_client_t *client, esp_mqtt_event_id_t event_id, int msg_id);
+
 /************************************************************************/
 /* La siguiente estructura simula un objeto en C                        */
 /*                                                                      */
 /* Las propiedades estan implementadas comp punteros a variables del .c */
 /* Los metodos son punteros a funciones definidas dentro del .c         */
+/*                                                                      */
+/* mqtt_client es la instancia por defecto, para compatibilidad con el  */
+/* codigo que usa un unico cliente.                                     */
 /************************************************************************/
 typedef struct
 {
@@ -44,9 +170,10 @@ typedef struct
     EventGroupHandle_t *mqtt_event_group;
     esp_mqtt_client_handle_t *client_handle;
     clearblade_data_t *clearblade_data;
+    clearblade_client_t *instance;
 
     // Clearblade Connector Functions
-    void (*set_clearblade_data)(char *brokerUri, char *projectId, char *region, char *registry, char *deviceId);
+    void (*set_clearblade_data)(const char *brokerUri, const char *projectId, const char *region, const char *registry, const char *deviceId);
     void (*start)(void);
     void (*set_network_available_flag)(bool is_network_available);
 } mqtt_client_t;
@@ -59,4 +186,4 @@ typedef struct
 /************************************************************************/
 extern const mqtt_client_t mqtt_client;
 
-#endif /* CLEARBLADE_CONNECT_H_ */
\ No newline at end of file
+#endif /* CLEARBLADE_CONNECT_H_ */
@@ -0,0 +1,445 @@
+/*
+ * jwt_signer.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <string.h>
+#include <mbedtls/pk.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "jwt_token_gcp.h"
+#include "jwt_signer.h"
+#include "energy_meter.h"
+#include "resource_monitor.h"
+
+#define SIGNER_IDLE_BIT BIT0
+
+#define KEY_CACHE_WAYS (JWT_SIGNER_KEY_CACHE_SIZE < 4 ? JWT_SIGNER_KEY_CACHE_SIZE : 4)
+#define KEY_CACHE_SETS (JWT_SIGNER_KEY_CACHE_SIZE / KEY_CACHE_WAYS)
+
+static const char *TAG = "JWT signer";
+
+/* Clave parseada de una identidad. busy: la esta usando un worker. */
+typedef struct
+{
+    bool valid;  // Entrada asignada a identity
+    bool parsed; // pk contiene la clave key/key_len
+    bool busy;
+    uint32_t hash;
+    uint32_t last_used;
+    const unsigned char *key;
+    size_t key_len;
+    char identity[JWT_SIGNER_IDENTITY_MAX_LEN + 1];
+    mbedtls_pk_context pk;
+} key_cache_entry_t;
+
+/* Cada worker siembra su generador una sola vez, no uno por token */
+typedef struct
+{
+    TaskHandle_t task;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context ctr_drbg;
+} signer_worker_t;
+
+static signer_worker_t workers[JWT_SIGNER_MAX_WORKERS];
+static uint8_t worker_count = 0;
+static volatile bool running = false;
+static volatile bool stopping = false;
+
+// Cola de prioridad (min-heap por offline_since_us y orden de llegada)
+static jwt_request_t *pending[JWT_SIGNER_MAX_PENDING];
+static uint32_t pending_count = 0;
+static uint32_t in_progress = 0;
+static uint32_t next_sequence = 0;
+
+static key_cache_entry_t key_cache[KEY_CACHE_SETS * KEY_CACHE_WAYS];
+static uint32_t cache_clock = 0;
+
+static jwt_signer_stats_t stats;
+
+static SemaphoreHandle_t signer_mutex = NULL;
+static SemaphoreHandle_t work_semaphore = NULL;
+static SemaphoreHandle_t exit_semaphore = NULL;
+static EventGroupHandle_t signer_events = NULL;
+
+#ifdef STATIC_ALLOCATION_MODE
+static StaticSemaphore_t signer_mutex_buffer;
+static StaticSemaphore_t work_semaphore_buffer;
+static StaticSemaphore_t exit_semaphore_buffer;
+static StaticEventGroup_t signer_events_buffer;
+static StackType_t worker_stacks[JWT_SIGNER_MAX_WORKERS][JWT_SIGNER_TASK_STACK_SIZE];
+static StaticTask_t worker_buffers[JWT_SIGNER_MAX_WORKERS];
+#endif
+
+static void lock(void)
+{
+    xSemaphoreTake(signer_mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(signer_mutex);
+}
+
+static uint32_t identity_hash(const char *identity)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    while (*identity)
+        hash = (hash ^ (uint8_t)*identity++) * 16777619u;
+    return hash;
+}
+
+/*****************************************************
+ *   Cola de prioridad                                *
+ ******************************************************/
+static bool request_before(const jwt_request_t *a, const jwt_request_t *b)
+{
+    if (a->offline_since_us != b->offline_since_us)
+        return a->offline_since_us < b->offline_since_us;
+    return (int32_t)(a->sequence - b->sequence) < 0;
+}
+
+static void heap_push(jwt_request_t *request)
+{
+    uint32_t pos = pending_count++;
+    while (pos > 0)
+    {
+        uint32_t parent = (pos - 1) / 2;
+        if (!request_before(request, pending[parent]))
+            break;
+        pending[pos] = pending[parent];
+        pos = parent;
+    }
+    pending[pos] = request;
+}
+
+static jwt_request_t *heap_pop(void)
+{
+    jwt_request_t *top = pending[0];
+    jwt_request_t *last = pending[--pending_count];
+    uint32_t pos = 0;
+
+    for (;;)
+    {
+        uint32_t child = 2 * pos + 1;
+        if (child >= pending_count)
+            break;
+        if (child + 1 < pending_count && request_before(pending[child + 1], pending[child]))
+            child++;
+        if (!request_before(pending[child], last))
+            break;
+        pending[pos] = pending[child];
+        pos = child;
+    }
+    if (pending_count > 0)
+        pending[pos] = last;
+    return top;
+}
+
+/*****************************************************
+ *   Cache de claves                                  *
+ ******************************************************/
+
+/************************************************************************/
+/* Devuelve la entrada de la identidad marcada como ocupada, o NULL si  */
+/* todas las de su conjunto estan ocupadas. La cache es asociativa por  */
+/* conjuntos de KEY_CACHE_WAYS entradas con reemplazo LRU, para no      */
+/* recorrerla entera cuando el build de host la agranda. *needs_parse   */
+/* indica si hay que (re)parsear la clave: entrada nueva, o la          */
+/* identidad cambio de clave. Se llama con el mutex tomado.             */
+/************************************************************************/
+static key_cache_entry_t *cache_acquire(const jwt_request_t *request, bool *needs_parse)
+{
+    uint32_t hash = identity_hash(request->identity);
+    key_cache_entry_t *set = &key_cache[(hash % KEY_CACHE_SETS) * KEY_CACHE_WAYS];
+    key_cache_entry_t *victim = NULL;
+
+    for (int i = 0; i < KEY_CACHE_WAYS; i++)
+    {
+        key_cache_entry_t *entry = &set[i];
+        if (entry->valid && entry->hash == hash && strcmp(entry->identity, request->identity) == 0)
+        {
+            if (entry->busy)
+                return NULL;
+            entry->busy = true;
+            entry->last_used = ++cache_clock;
+            *needs_parse = !entry->parsed || entry->key != request->private_key || entry->key_len != request->private_key_len;
+            if (*needs_parse)
+                stats.key_cache_misses++;
+            else
+                stats.key_cache_hits++;
+            return entry;
+        }
+        // Victima: una entrada libre, o la usada hace mas tiempo
+        if (!entry->busy && (victim == NULL || (victim->valid && (!entry->valid || entry->last_used < victim->last_used))))
+            victim = entry;
+    }
+
+    stats.key_cache_misses++;
+    if (victim == NULL)
+        return NULL;
+    victim->valid = true;
+    victim->parsed = false;
+    victim->busy = true;
+    victim->hash = hash;
+    victim->last_used = ++cache_clock;
+    strlcpy(victim->identity, request->identity, sizeof(victim->identity));
+    *needs_parse = true;
+    return victim;
+}
+
+static int parse_key(mbedtls_pk_context *pk, const jwt_request_t *request, signer_worker_t *worker)
+{
+    mbedtls_pk_free(pk);
+    mbedtls_pk_init(pk);
+    // Como createGCPJWTBuffer(): el largo del PEM debe incluir el '\0'.
+    return mbedtls_pk_parse_key(pk, request->private_key, request->private_key_len + 1, NULL, 0,
+                                mbedtls_ctr_drbg_random, &worker->ctr_drbg);
+}
+
+/*****************************************************
+ *   Workers                                          *
+ ******************************************************/
+static void sign_request(signer_worker_t *worker, jwt_request_t *request)
+{
+    bool needs_parse = false;
+    bool key_ok;
+    mbedtls_pk_context temp_pk;
+    mbedtls_pk_context *pk;
+
+    lock();
+    key_cache_entry_t *entry = cache_acquire(request, &needs_parse);
+    unlock();
+
+    if (entry != NULL)
+    {
+        pk = &entry->pk;
+        if (needs_parse)
+        {
+            entry->parsed = parse_key(pk, request, worker) == 0;
+            entry->key = request->private_key;
+            entry->key_len = request->private_key_len;
+        }
+        key_ok = entry->parsed;
+    }
+    else
+    {
+        // Conjunto de la cache ocupado por otros workers: se parsea una copia descartable.
+        pk = &temp_pk;
+        mbedtls_pk_init(pk);
+        key_ok = parse_key(pk, request, worker) == 0;
+    }
+
+    if (key_ok)
+    {
+        int64_t sign_start_us = esp_timer_get_time();
+        request->result_len = createGCPJWTWithKey(request->token, request->token_len, request->project_id, pk,
+                                                  mbedtls_ctr_drbg_random, &worker->ctr_drbg, request->expiration_minutes);
+        energy_meter.count_jwt((uint32_t)(esp_timer_get_time() - sign_start_us));
+    }
+    else
+        request->result_len = 0;
+
+    lock();
+    if (entry != NULL)
+        entry->busy = false;
+    if (request->result_len > 0)
+        stats.signed_ok++;
+    else
+        stats.failed++;
+    unlock();
+
+    if (entry == NULL)
+        mbedtls_pk_free(&temp_pk);
+}
+
+static void worker_task(void *param)
+{
+    signer_worker_t *worker = (signer_worker_t *)param;
+    const char *pers = "jwt_signer";
+    jwt_request_t *batch[JWT_SIGNER_BATCH_SIZE];
+
+    resource_monitor.register_task(NULL, "jwt_signer", JWT_SIGNER_TASK_STACK_SIZE);
+    mbedtls_entropy_init(&worker->entropy);
+    mbedtls_ctr_drbg_init(&worker->ctr_drbg);
+    if (mbedtls_ctr_drbg_seed(&worker->ctr_drbg, mbedtls_entropy_func, &worker->entropy, (const unsigned char *)pers, strlen(pers)) != 0)
+        ESP_LOGE(TAG, "No se pudo sembrar el generador del worker");
+
+    while (1)
+    {
+        xSemaphoreTake(work_semaphore, portMAX_DELAY);
+        if (stopping)
+            break;
+
+        // Un solo acceso a la cola por lote; los pedidos salen en orden de prioridad.
+        lock();
+        int count = 0;
+        while (count < JWT_SIGNER_BATCH_SIZE && pending_count > 0)
+            batch[count++] = heap_pop();
+        in_progress += count;
+        if (count > 0)
+            stats.batches++;
+        unlock();
+
+        for (int i = 0; i < count; i++)
+        {
+            sign_request(worker, batch[i]);
+            if (batch[i]->done != NULL)
+                batch[i]->done(batch[i], batch[i]->done_ctx);
+        }
+
+        lock();
+        in_progress -= count;
+        if (pending_count == 0 && in_progress == 0)
+            xEventGroupSetBits(signer_events, SIGNER_IDLE_BIT);
+        unlock();
+    }
+
+    mbedtls_ctr_drbg_free(&worker->ctr_drbg);
+    mbedtls_entropy_free(&worker->entropy);
+    resource_monitor.task_exit();
+    xSemaphoreGive(exit_semaphore);
+    vTaskDelete(NULL);
+}
+
+/*****************************************************
+ *   API                                              *
+ ******************************************************/
+static void create_primitives(void)
+{
+    if (signer_mutex != NULL)
+        return;
+#ifdef STATIC_ALLOCATION_MODE
+    signer_mutex = xSemaphoreCreateMutexStatic(&signer_mutex_buffer);
+    work_semaphore = xSemaphoreCreateCountingStatic(JWT_SIGNER_MAX_PENDING + JWT_SIGNER_MAX_WORKERS, 0, &work_semaphore_buffer);
+    exit_semaphore = xSemaphoreCreateCountingStatic(JWT_SIGNER_MAX_WORKERS, 0, &exit_semaphore_buffer);
+    signer_events = xEventGroupCreateStatic(&signer_events_buffer);
+#else
+    signer_mutex = xSemaphoreCreateMutex();
+    work_semaphore = xSemaphoreCreateCounting(JWT_SIGNER_MAX_PENDING + JWT_SIGNER_MAX_WORKERS, 0);
+    exit_semaphore = xSemaphoreCreateCounting(JWT_SIGNER_MAX_WORKERS, 0);
+    signer_events = xEventGroupCreate();
+#endif
+    xEventGroupSetBits(signer_events, SIGNER_IDLE_BIT);
+}
+
+static esp_err_t start(uint8_t requested_workers)
+{
+    if (running)
+        return ESP_ERR_INVALID_STATE;
+    create_primitives();
+
+    uint8_t count = requested_workers > 0 ? requested_workers : portNUM_PROCESSORS;
+    if (count > JWT_SIGNER_MAX_WORKERS)
+        count = JWT_SIGNER_MAX_WORKERS;
+
+    stopping = false;
+    worker_count = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+#ifdef STATIC_ALLOCATION_MODE
+        workers[i].task = xTaskCreateStatic(worker_task, "jwt_signer", JWT_SIGNER_TASK_STACK_SIZE, &workers[i], 2,
+                                            worker_stacks[i], &worker_buffers[i]);
+#else
+        if (xTaskCreate(worker_task, "jwt_signer", JWT_SIGNER_TASK_STACK_SIZE, &workers[i], 2, &workers[i].task) != pdPASS)
+            workers[i].task = NULL;
+#endif
+        if (workers[i].task == NULL)
+            break;
+        worker_count++;
+    }
+    if (worker_count == 0)
+        return ESP_ERR_NO_MEM;
+
+    running = true;
+    ESP_LOGI(TAG, "Pool de firma iniciado con %d workers", worker_count);
+    return ESP_OK;
+}
+
+/* Espera a que terminen los pedidos en curso; los pendientes quedan en la cola */
+static void stop(void)
+{
+    if (!running)
+        return;
+    running = false;
+    stopping = true;
+    for (uint8_t i = 0; i < worker_count; i++)
+        xSemaphoreGive(work_semaphore);
+    for (uint8_t i = 0; i < worker_count; i++)
+        xSemaphoreTake(exit_semaphore, portMAX_DELAY);
+    worker_count = 0;
+}
+
+static bool is_running(void)
+{
+    return running;
+}
+
+static esp_err_t submit(jwt_request_t *request)
+{
+    if (!running)
+        return ESP_ERR_INVALID_STATE;
+    if (request->identity == NULL || strlen(request->identity) > JWT_SIGNER_IDENTITY_MAX_LEN || request->token == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    lock();
+    if (pending_count == JWT_SIGNER_MAX_PENDING)
+    {
+        stats.rejected++;
+        unlock();
+        return ESP_ERR_NO_MEM;
+    }
+    request->result_len = 0;
+    request->sequence = next_sequence++;
+    heap_push(request);
+    stats.submitted++;
+    if (pending_count > stats.max_pending)
+        stats.max_pending = pending_count;
+    xEventGroupClearBits(signer_events, SIGNER_IDLE_BIT);
+    unlock();
+
+    xSemaphoreGive(work_semaphore);
+    return ESP_OK;
+}
+
+static bool wait_idle(TickType_t ticks_to_wait)
+{
+    if (signer_events == NULL)
+        return true;
+    return (xEventGroupWaitBits(signer_events, SIGNER_IDLE_BIT, pdFALSE, pdTRUE, ticks_to_wait) & SIGNER_IDLE_BIT) != 0;
+}
+
+static void get_stats(jwt_signer_stats_t *out)
+{
+    if (signer_mutex == NULL)
+    {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    lock();
+    *out = stats;
+    unlock();
+}
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)            *
+ ******************************************************/
+const jwt_signer_t jwt_signer = {
+    // JWT Signer Functions
+    .start = start,
+    .stop = stop,
+    .is_running = is_running,
+    .submit = submit,
+    .wait_idle = wait_idle,
+    .get_stats = get_stats,
+};
@@ -0,0 +1,97 @@
+/*
+ * jwt_signer.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef JWT_SIGNER_H_
+#define JWT_SIGNER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+/* Limites del pool. En el ESP32 alcanza con pocos; el build de host los agranda. */
+#ifndef JWT_SIGNER_MAX_WORKERS
+#define JWT_SIGNER_MAX_WORKERS 2
+#endif
+#ifndef JWT_SIGNER_MAX_PENDING
+#define JWT_SIGNER_MAX_PENDING 16
+#endif
+#ifndef JWT_SIGNER_KEY_CACHE_SIZE
+#define JWT_SIGNER_KEY_CACHE_SIZE 4
+#endif
+
+/* Pedidos que un worker toma de la cola por vez */
+#define JWT_SIGNER_BATCH_SIZE 4
+#define JWT_SIGNER_IDENTITY_MAX_LEN 64
+#define JWT_SIGNER_TASK_STACK_SIZE (4096 * 2)
+
+typedef struct jwt_request jwt_request_t;
+
+/* Se llama desde el worker que firmo; request->result_len es 0 si fallo */
+typedef void (*jwt_request_done_t)(jwt_request_t *request, void *ctx);
+
+/************************************************************************/
+/* Pedido de token. Lo reserva quien lo envia y debe seguir valido hasta */
+/* que se llama done().                                                 */
+/************************************************************************/
+struct jwt_request
+{
+    // Entrada
+    const char *identity;             // Clave de la cache de claves parseadas (device ID)
+    const char *project_id;
+    const unsigned char *private_key; // Igual que createGCPJWTBuffer(): PEM sin contar el '\0', o DER
+    size_t private_key_len;
+    uint16_t expiration_minutes;
+    int64_t offline_since_us;         // esp_timer_get_time() de la desconexion; el mas antiguo se firma primero
+    char *token;
+    size_t token_len;
+    jwt_request_done_t done;
+    void *done_ctx;
+
+    // Salida
+    size_t result_len;
+
+    // Privado
+    uint32_t sequence;
+};
+
+typedef struct
+{
+    uint32_t submitted;
+    uint32_t signed_ok;
+    uint32_t failed;
+    uint32_t rejected;   // Cola llena
+    uint32_t key_cache_hits;
+    uint32_t key_cache_misses;
+    uint32_t batches;
+    uint32_t max_pending;
+} jwt_signer_stats_t;
+
+/************************************************************************/
+/* La siguiente estructura simula un objeto en C                        */
+/*                                                                      */
+/* Servicio de firma de JWT: un pool de tareas que toma pedidos de      */
+/* varias identidades en lotes, con prioridad para las que llevan mas   */
+/* tiempo desconectadas, y conserva las claves ya parseadas. Sirve      */
+/* para que una reconexion masiva (varias instancias de cliente, o el   */
+/* simulador de flota) no firme todo en serie en un solo nucleo.        */
+/************************************************************************/
+typedef struct
+{
+    // JWT Signer Functions
+    esp_err_t (*start)(uint8_t workers); // 0: un worker por nucleo
+    void (*stop)(void);
+    bool (*is_running)(void);
+    esp_err_t (*submit)(jwt_request_t *request);
+    bool (*wait_idle)(TickType_t ticks_to_wait);
+    void (*get_stats)(jwt_signer_stats_t *stats);
+} jwt_signer_t;
+
+extern const jwt_signer_t jwt_signer;
+
+#endif /* JWT_SIGNER_H_ */
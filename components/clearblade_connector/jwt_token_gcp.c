@@ -28,6 +28,13 @@
 #include "base64url.h"
 #include <time.h>
 
+/* Nivel de log del modulo; los mensajes de mas detalle no se compilan */
+#ifndef JWT_LOG_LEVEL
+#define JWT_LOG_LEVEL ESP_LOG_INFO
+#endif
+#define DEFERRED_LOG_LOCAL_LEVEL JWT_LOG_LEVEL
+#include "deferred_log.h"
+
 /**
  * Return a string representation of an mbedtls error code
  */
@@ -47,16 +54,16 @@ static char *mbedtlsError(int errnum)
  * string is then signed using RSASSA which basically produces an SHA256 message digest that is then signed.  The resulting
  * binary is then itself converted into base64url and concatenated with the previously built base64url combined header and
  * payload and that is our resulting JWT token.
+ * @param token Buffer that receives the token.
+ * @param token_len Size of the buffer, JWT_TOKEN_MAX_LEN is always enough.
  * @param projectId The GCP project.
- * @param privateKey The PEM or DER of the private key.
- * @param privateKeySize The size in bytes of the private key.
- * @returns A JWT token for transmission to GCP.
+ * @param pk_context An already parsed private key.
+ * @param f_rng, p_rng A seeded random generator (mbedtls_ctr_drbg_random and its context).
+ * @returns The length of the token, or 0 on error.
  */
-char *createGCPJWT(char *projectId, unsigned char *privateKey, size_t privateKeySize, uint16_t expiration_minutes)
+size_t createGCPJWTWithKey(char *token, size_t token_len, const char *projectId, mbedtls_pk_context *pk_context,
+                           int (*f_rng)(void *, unsigned char *, size_t), void *p_rng, uint16_t expiration_minutes)
 {
-
-    privateKeySize++; // Le sumo un caracter al largo, porque para armar el JWT necesita incluir el caracter de terminacion '\0'.
-
     char base64Header[100];
     const char header[] = "{\"typ\": \"JWT\",\"alg\": \"RS256\"}";
     base64url_encode(
@@ -64,18 +71,18 @@ char *createGCPJWT(char *projectId, unsigned char *privateKey, size_t privateKey
         strlen(header),          // Length of data to encode.
         base64Header);           // Base64 encoded data.
 
-    ESP_LOGI("CreateJWT", "header: %s ", header);
+    DLOGD("CreateJWT", "header: %s", header);
 
     time_t now;
     time(&now);
-    printf("Tiempo ahora time() %lld ", now);
+    DLOGD("CreateJWT", "Tiempo ahora time() %lld", (long long)now);
     uint32_t iat = now;                           // Set the time now.
     uint32_t exp = iat + 60 * expiration_minutes; // Set the expiry time.
 
     char payload[100];
-    sprintf(payload, "{\"aud\": \"%s\", \"iat\": %ld, \"exp\": %ld}", projectId, iat, exp);
+    sprintf(payload, "{\"aud\": \"%s\", \"iat\": %lu, \"exp\": %lu}", projectId, (unsigned long)iat, (unsigned long)exp);
 
-    ESP_LOGI("CreateJWT", "payload: %s ", payload);
+    DLOGD("CreateJWT", "payload: %s", payload);
 
     char base64Payload[100];
     base64url_encode(
@@ -90,7 +97,51 @@ char *createGCPJWT(char *projectId, unsigned char *privateKey, size_t privateKey
     // At this point we have created the header and payload parts, converted both to base64 and concatenated them
     // together as a single string.  Now we need to sign them using RSASSA
 
-    uint8_t oBuf[5000];
+    uint8_t oBuf[MBEDTLS_PK_SIGNATURE_MAX_SIZE];
+
+    uint8_t digest[32];
+    int rc = mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), headerAndPayload, strlen((char *)headerAndPayload), digest);
+    if (rc != 0)
+    {
+        printf("Failed to mbedtls_md: %d (-0x%x): %s\n", rc, -rc, mbedtlsError(rc));
+        return 0;
+    }
+
+    size_t retSize;
+    rc = mbedtls_pk_sign(pk_context, MBEDTLS_MD_SHA256, digest, sizeof(digest), oBuf, sizeof(oBuf), &retSize, f_rng, p_rng);
+    if (rc != 0)
+    {
+        printf("Failed to mbedtls_pk_sign: %d (-0x%x): %s\n", rc, -rc, mbedtlsError(rc));
+        return 0;
+    }
+
+    char base64Signature[600];
+    if (BASE64_ENCODE_OUT_SIZE(retSize) >= sizeof(base64Signature))
+    {
+        printf("Signature too long: %d bytes\n", (int)retSize);
+        return 0;
+    }
+    base64url_encode((unsigned char *)oBuf, retSize, base64Signature);
+
+    int written = snprintf(token, token_len, "%s.%s", headerAndPayload, base64Signature);
+    if (written > 0 && written < token_len)
+        return written;
+
+    printf("JWT buffer too small: %d bytes needed\n", written + 1);
+    return 0;
+}
+
+/**
+ * Create a JWT token for GCP, parsing the key and seeding a random generator on every call.
+ * @param privateKey The PEM or DER of the private key.
+ * @param privateKeySize The size in bytes of the private key.
+ * @returns The length of the token, or 0 on error.
+ */
+size_t createGCPJWTBuffer(char *token, size_t token_len, const char *projectId, const unsigned char *privateKey, size_t privateKeySize, uint16_t expiration_minutes)
+{
+    size_t retLen = 0;
+
+    privateKeySize++; // Le sumo un caracter al largo, porque para armar el JWT necesita incluir el caracter de terminacion '\0'.
 
     mbedtls_entropy_context entropy;
     mbedtls_ctr_drbg_context ctr_drbg;
@@ -101,42 +152,50 @@ char *createGCPJWT(char *projectId, unsigned char *privateKey, size_t privateKey
 
     mbedtls_pk_context pk_context;
     mbedtls_pk_init(&pk_context);
-    int rc = mbedtls_pk_parse_key(&pk_context, privateKey, privateKeySize, NULL, 0, mbedtls_ctr_drbg_random, &ctr_drbg);
-    if (rc != 0)
-    {
-        printf("Failed to mbedtls_pk_parse_key: %d (-0x%x): %s\n", rc, -rc, mbedtlsError(rc));
-        return 0;
-    }
 
-    mbedtls_ctr_drbg_seed(
+    // El generador se siembra antes de usarlo para parsear la clave.
+    int rc = mbedtls_ctr_drbg_seed(
         &ctr_drbg,
         mbedtls_entropy_func,
         &entropy,
         (const unsigned char *)pers,
         strlen(pers));
-
-    uint8_t digest[32];
-    rc = mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), headerAndPayload, strlen((char *)headerAndPayload), digest);
     if (rc != 0)
     {
-        printf("Failed to mbedtls_md: %d (-0x%x): %s\n", rc, -rc, mbedtlsError(rc));
-        return 0;
+        printf("Failed to mbedtls_ctr_drbg_seed: %d (-0x%x): %s\n", rc, -rc, mbedtlsError(rc));
+        goto cleanup;
     }
 
-    size_t retSize;
-    rc = mbedtls_pk_sign(&pk_context, MBEDTLS_MD_SHA256, digest, sizeof(digest), oBuf, sizeof(oBuf), &retSize, mbedtls_ctr_drbg_random, &ctr_drbg);
+    rc = mbedtls_pk_parse_key(&pk_context, privateKey, privateKeySize, NULL, 0, mbedtls_ctr_drbg_random, &ctr_drbg);
     if (rc != 0)
     {
-        printf("Failed to mbedtls_pk_sign: %d (-0x%x): %s\n", rc, -rc, mbedtlsError(rc));
-        return 0;
+        printf("Failed to mbedtls_pk_parse_key: %d (-0x%x): %s\n", rc, -rc, mbedtlsError(rc));
+        goto cleanup;
     }
 
-    char base64Signature[600];
-    base64url_encode((unsigned char *)oBuf, retSize, base64Signature);
+    retLen = createGCPJWTWithKey(token, token_len, projectId, &pk_context, mbedtls_ctr_drbg_random, &ctr_drbg, expiration_minutes);
 
-    char *retData = (char *)malloc(strlen((char *)headerAndPayload) + 1 + strlen((char *)base64Signature) + 1);
-    sprintf(retData, "%s.%s", headerAndPayload, base64Signature);
+cleanup:
     mbedtls_pk_free(&pk_context);
+    mbedtls_ctr_drbg_free(&ctr_drbg);
+    mbedtls_entropy_free(&entropy);
+
+    return retLen;
+}
+
+/**
+ * Same as createGCPJWTBuffer(), but returns the token in a heap buffer that the caller must free().
+ * @returns A JWT token for transmission to GCP, or 0 on error.
+ */
+char *createGCPJWT(char *projectId, unsigned char *privateKey, size_t privateKeySize, uint16_t expiration_minutes)
+{
+    char token[JWT_TOKEN_MAX_LEN];
+    size_t len = createGCPJWTBuffer(token, sizeof(token), projectId, privateKey, privateKeySize, expiration_minutes);
+    if (len == 0)
+        return 0;
 
+    char *retData = (char *)malloc(len + 1);
+    if (retData != NULL)
+        memcpy(retData, token, len + 1);
     return retData;
-}
\ No newline at end of file
+}
@@ -10,7 +10,15 @@
 #define MAIN_JWT_TOKEN_GCP_H_
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <mbedtls/pk.h>
+
+/* Largo maximo de un token (alcanza para firmas RSA de hasta 4096 bits) */
+#define JWT_TOKEN_MAX_LEN 1024
 
 char *createGCPJWT(char *projectId, unsigned char *privateKey, size_t privateKeySize, uint16_t expiration_minutes);
+size_t createGCPJWTBuffer(char *token, size_t token_len, const char *projectId, const unsigned char *privateKey, size_t privateKeySize, uint16_t expiration_minutes);
+size_t createGCPJWTWithKey(char *token, size_t token_len, const char *projectId, mbedtls_pk_context *pk_context,
+                           int (*f_rng)(void *, unsigned char *, size_t), void *p_rng, uint16_t expiration_minutes);
 
 #endif /* MAIN_JWT_TOKEN_GCP_H_ */
@@ -19,6 +19,7 @@
 
 #include "certs.h"
 #include "mqtt_basico.h"
+#include "resource_monitor.h"
 #include <string.h>
 #include "esp_system.h"
 #include "esp_event.h"
@@ -29,15 +30,23 @@
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
 
-#include "lwip/sockets.h"
-#include "lwip/dns.h"
-#include "lwip/netdb.h"
-
 #include "esp_log.h"
 #include "mqtt_client.h"
-#include "cJSON.h"
 #include "jwt_token_gcp.h"
+#include "jwt_signer.h"
+#include "esp_timer.h"
 #include "clearblade_connect.h"
+#include "boot_timeline.h"
+#include "sntp_time.h"
+#include "energy_meter.h"
+#include "health_supervisor.h"
+
+/* Nivel de log del modulo; los mensajes de mas detalle no se compilan */
+#ifndef MQTT_BASICO_LOG_LEVEL
+#define MQTT_BASICO_LOG_LEVEL ESP_LOG_INFO
+#endif
+#define DEFERRED_LOG_LOCAL_LEVEL MQTT_BASICO_LOG_LEVEL
+#include "deferred_log.h"
 
 static const char *TAG = "MQTT MODULE: ";
 
@@ -48,61 +57,78 @@ int sntp_response_time_seconds = 0;
 unsigned int tph_on_time = 0;
 time_t wake_up_timestamp = 0;
 
-esp_mqtt_client_config_t mqtt_client_config = {};
-char *GCP_JWT = NULL;
 bool mqtt_client_connected = false;
 bool mqtt_disconnected_event_flag = false;
 
-static bool mqtt_client_configure(void);
+static bool mqtt_client_configure(clearblade_client_t *client);
 
-int T = 0, P = 0, H = 0; // las declaro global para probar rapidamente
 uint8_t id_sensor_recibido;
 
-static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event)
+/* SUBSCRIBE con un topic: packet id, largo, topic y QoS */
+static void count_subscribe_energy(clearblade_client_t *client, const char *topic)
+{
+    uint32_t remaining = 2 + 2 + strlen(topic) + 1;
+    energy_meter.count_tx(energy_meter_mqtt_packet_len(remaining), clearblade_client_uses_tls(client));
+}
+
+static esp_err_t mqtt_event_handler_cb(clearblade_client_t *client, esp_mqtt_event_handle_t event)
 {
-    esp_mqtt_client_handle_t esp_mqtt_client = event->client;
+    clearblade_client_count_event(client, event->event_id, event->msg_id);
     switch (event->event_id)
     {
     case MQTT_EVENT_CONNECTED:
-        ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
+        DLOGI(TAG, "MQTT_EVENT_CONNECTED");
+        boot_timeline.stamp(BOOT_PHASE_MQTT_CONNECTED);
 
         // Setear bit de grupo de evengos: CONNECTED_TO_MQTT_BROKER
-        xEventGroupSetBits(*mqtt_client.mqtt_event_group, CONNECTED_TO_MQTT_BROKER);
-        xEventGroupClearBits(*mqtt_client.mqtt_event_group, DISCONNECTED_FROM_MQTT_BROKER);
+        xEventGroupSetBits(client->event_group, CONNECTED_TO_MQTT_BROKER);
+        xEventGroupClearBits(client->event_group, DISCONNECTED_FROM_MQTT_BROKER);
+        client->offline_since_us = 0;
 
         char bufferTopic[100];
 
         // Suscribirse a tema 'config' de Google Cloud IoT
         bufferTopic[0] = 0;
         strcat(bufferTopic, "/devices/");
-        strcat(bufferTopic, mqtt_client.clearblade_data->deviceId);
+        strcat(bufferTopic, client->clearblade_data.deviceId);
         strcat(bufferTopic, "/config");
         esp_mqtt_client_subscribe(event->client, bufferTopic, 0);
+        count_subscribe_energy(client, bufferTopic);
 
         // Suscribirse a tema 'commands' de Google Cloud IoT
         bufferTopic[0] = 0;
         strcat(bufferTopic, "/devices/");
-        strcat(bufferTopic, mqtt_client.clearblade_data->deviceId);
+        strcat(bufferTopic, client->clearblade_data.deviceId);
         strcat(bufferTopic, "/commands/#");
         esp_mqtt_client_subscribe(event->client, bufferTopic, 0);
+        count_subscribe_energy(client, bufferTopic);
+
+        if (client->connection_callback != NULL)
+            client->connection_callback(client, true, client->connection_callback_ctx);
         break;
 
     case MQTT_EVENT_DISCONNECTED:
-        ESP_LOGW(TAG, "MQTT_EVENT_DISCONNECTED");
-        xEventGroupSetBits(*mqtt_client.mqtt_event_group, DISCONNECTED_FROM_MQTT_BROKER);
-        xEventGroupClearBits(*mqtt_client.mqtt_event_group, CONNECTED_TO_MQTT_BROKER);
+        DLOGW(TAG, "MQTT_EVENT_DISCONNECTED");
+        xEventGroupSetBits(client->event_group, DISCONNECTED_FROM_MQTT_BROKER);
+        xEventGroupClearBits(client->event_group, CONNECTED_TO_MQTT_BROKER);
+        if (client->offline_since_us == 0)
+            client->offline_since_us = esp_timer_get_time();
+
+        if (client->connection_callback != NULL)
+            client->connection_callback(client, false, client->connection_callback_ctx);
         break;
 
     case MQTT_EVENT_SUBSCRIBED:
-        ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
+        DLOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
         break;
 
     case MQTT_EVENT_UNSUBSCRIBED:
-        ESP_LOGI(TAG, "MQTT_EVENT_UNSUBSCRIBED, msg_id=%d", event->msg_id);
+        DLOGI(TAG, "MQTT_EVENT_UNSUBSCRIBED, msg_id=%d", event->msg_id);
         break;
 
     case MQTT_EVENT_PUBLISHED:
-        ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+        DLOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+        boot_timeline.stamp(BOOT_PHASE_FIRST_PUBACK);
         last_error_count = 0;
         last_error_code = 0;
         last_on_time_seconds = 0;
@@ -110,19 +136,27 @@ static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event)
         break;
 
     case MQTT_EVENT_DATA:
-        ESP_LOGI(TAG, "MQTT_EVENT_DATA: ");
-        printf("TOPIC=%.*s\r\n", event->topic_len, event->topic);
-        printf("DATA=%.*s\r\n", event->data_len, event->data);
+        DLOGI(TAG, "MQTT_EVENT_DATA: %.*s (%d bytes)", event->topic_len, event->topic, event->data_len);
+        DLOGD(TAG, "DATA=%.*s", event->data_len, event->data);
+
+        // La configuracion del dispositivo puede traer los limites de publicacion
+        char configTopic[sizeof("/devices//config") + CLEARBLADE_ID_MAX_LEN];
+        int config_topic_len = clearblade_format_topic(configTopic, sizeof(configTopic), client->device_id, "config");
+        if (event->topic_len == config_topic_len && memcmp(event->topic, configTopic, config_topic_len) == 0)
+            clearblade_client_apply_config(client, event->data, event->data_len);
+
+        if (client->data_callback != NULL)
+            client->data_callback(client, event->topic, event->topic_len, event->data, event->data_len, client->data_callback_ctx);
         break;
 
     case MQTT_EVENT_ERROR:
-        ESP_LOGW(TAG, "MQTT_EVENT_ERROR");
+        DLOGW(TAG, "MQTT_EVENT_ERROR");
         last_error_count++;
         last_error_code |= ERROR_CODE_MQTT;
         break;
 
     default:
-        ESP_LOGI(TAG, "Other event id:%d", event->event_id);
+        DLOGI(TAG, "Other event id:%d", event->event_id);
         break;
     }
     return ESP_OK;
@@ -130,55 +164,124 @@ static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event)
 
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
 {
-    ESP_LOGD(TAG, "Event dispatched from event loop base=%s, event_id=%ld", base, event_id);
-    mqtt_event_handler_cb(event_data);
+    DLOGD(TAG, "Event dispatched from event loop base=%s, event_id=%ld", base, (long)event_id);
+    mqtt_event_handler_cb((clearblade_client_t *)handler_args, event_data);
+}
+
+/* Espera con plazo a que esten los bits; late en cada vuelta porque la red y el broker son externos */
+static void wait_bits_beating(clearblade_client_t *client, EventBits_t bits, int health_id)
+{
+    while ((xEventGroupWaitBits(client->event_group, bits, pdFALSE, pdTRUE, pdMS_TO_TICKS(HEALTH_SUPERVISOR_WAIT_MS)) &
+            bits) != bits)
+        health_supervisor.beat(health_id);
+    health_supervisor.beat(health_id);
 }
 
+/************************************************************************/
+/* Tarea de un cliente Clearblade; recibe la instancia como parametro.  */
+/* Todas sus esperas tienen plazo y late en cada vuelta: si se traba    */
+/* firmando o configurando el cliente, el supervisor de vida escala.    */
+/************************************************************************/
 void mqtt_app_main_task(void *parm)
 {
-    ESP_LOGI(TAG, "Ingresa a mqtt_app_main_task()");
+    clearblade_client_t *client = (clearblade_client_t *)parm;
+    resource_monitor.register_task(NULL, "mqtt_app_task", CLEARBLADE_MQTT_TASK_STACK_SIZE);
+    int health_id = health_supervisor.register_task("mqtt_app_task", HEALTH_SUPERVISOR_WAIT_MS);
+    ESP_LOGI(TAG, "Ingresa a mqtt_app_main_task() - %s", client->clearblade_data.deviceId);
+
+    wait_bits_beating(client, NETWORK_AVAILABLE, health_id);
+    while (!time_service.wait_available(pdMS_TO_TICKS(HEALTH_SUPERVISOR_WAIT_MS)))
+        health_supervisor.beat(health_id);
+    xEventGroupSetBits(client->event_group, TIME_SYNCHRONIZED);
 
-    mqtt_client_configure();
+    mqtt_client_configure(client);
 
-    *mqtt_client.client_handle = esp_mqtt_client_init(&mqtt_client_config);
-    esp_mqtt_client_register_event(*mqtt_client.client_handle, ESP_EVENT_ANY_ID, mqtt_event_handler, *mqtt_client.client_handle);
+    client->client_handle = esp_mqtt_client_init(&client->mqtt_config);
+    esp_mqtt_client_register_event(client->client_handle, ESP_EVENT_ANY_ID, mqtt_event_handler, client);
 
     ESP_LOGI(TAG, "Arrancando MQTT client... ");
-    esp_mqtt_client_start(*mqtt_client.client_handle);
+    esp_mqtt_client_start(client->client_handle);
 
-    xEventGroupWaitBits(*mqtt_client.mqtt_event_group, CONNECTED_TO_MQTT_BROKER,
-                        pdFALSE,
-                        pdTRUE,
-                        portMAX_DELAY);
+    wait_bits_beating(client, CONNECTED_TO_MQTT_BROKER, health_id);
     ESP_LOGI(TAG, "Primera conexión al Broker establecida...");
 
     while (1)
     {
-        xEventGroupWaitBits(*mqtt_client.mqtt_event_group, DISCONNECTED_FROM_MQTT_BROKER,
-                            pdFALSE,
-                            pdTRUE,
-                            portMAX_DELAY);
+        EventBits_t bits = xEventGroupWaitBits(client->event_group, DISCONNECTED_FROM_MQTT_BROKER,
+                                               pdFALSE,
+                                               pdTRUE,
+                                               pdMS_TO_TICKS(HEALTH_SUPERVISOR_WAIT_MS));
+        health_supervisor.beat(health_id);
+        if (!(bits & DISCONNECTED_FROM_MQTT_BROKER))
+            continue;
         ESP_LOGW(TAG, "Reconfigurando conexión y cliente MQTT...");
-        if (mqtt_client_configure())
+        if (mqtt_client_configure(client))
         {
             ESP_LOGW(TAG, "Seteando configuracion Cliente MQTT... ");
-            esp_mqtt_set_config(*mqtt_client.client_handle, &mqtt_client_config);
+            esp_mqtt_set_config(client->client_handle, &client->mqtt_config);
         }
         vTaskDelay(1000 / portTICK_PERIOD_MS);
     }
+    resource_monitor.task_exit();
     vTaskDelete(NULL);
 }
 
-static bool mqtt_client_configure(void)
+static void jwt_request_done(jwt_request_t *request, void *ctx)
 {
+    clearblade_client_t *client = (clearblade_client_t *)ctx;
+    xEventGroupSetBits(client->event_group, JWT_TOKEN_READY);
+}
 
-    ESP_LOGI(TAG, "Generando JWT Token... ");
-    if (GCP_JWT != NULL)
-        free(GCP_JWT);
+/************************************************************************/
+/* Genera el token en client->jwt. Si el pool jwt_signer esta corriendo */
+/* se le delega la firma (las instancias desconectadas hace mas tiempo  */
+/* se firman primero); si no, se firma en esta tarea.                   */
+/************************************************************************/
+static size_t mqtt_client_create_jwt(clearblade_client_t *client)
+{
+    if (jwt_signer.is_running())
+    {
+        jwt_request_t *request = &client->jwt_request;
+
+        request->identity = client->clearblade_data.deviceId;
+        request->project_id = client->clearblade_data.projectId;
+        request->private_key = (const unsigned char *)client->private_key;
+        request->private_key_len = client->private_key_len;
+        request->expiration_minutes = IOTCORE_TOKEN_EXPIRATION_TIME_MINUTES;
+        request->offline_since_us = client->offline_since_us != 0 ? client->offline_since_us : esp_timer_get_time();
+        request->token = client->jwt;
+        request->token_len = sizeof(client->jwt);
+        request->done = jwt_request_done;
+        request->done_ctx = client;
+
+        xEventGroupClearBits(client->event_group, JWT_TOKEN_READY);
+        if (jwt_signer.submit(request) == ESP_OK)
+        {
+            // El pedido es del pool hasta que termine: no se abandona, y sin latidos el supervisor escala
+            while ((xEventGroupWaitBits(client->event_group, JWT_TOKEN_READY, pdTRUE, pdTRUE,
+                                        pdMS_TO_TICKS(HEALTH_SUPERVISOR_WAIT_MS)) & JWT_TOKEN_READY) == 0)
+                ESP_LOGW(TAG, "La firma del JWT de %s sigue pendiente", client->clearblade_data.deviceId);
+            return request->result_len;
+        }
+        ESP_LOGW(TAG, "Cola del pool de firma llena, se firma en la tarea");
+    }
 
-    GCP_JWT = createGCPJWT(mqtt_client.clearblade_data->projectId, DEVICE_KEY, strlen(DEVICE_KEY), IOTCORE_TOKEN_EXPIRATION_TIME_MINUTES);
+    // El token se arma en el buffer de la instancia; esp-mqtt copia la password al configurarse.
+    int64_t sign_start_us = esp_timer_get_time();
+    size_t jwt_len = createGCPJWTBuffer(client->jwt, sizeof(client->jwt), client->clearblade_data.projectId,
+                                        (const unsigned char *)client->private_key, client->private_key_len,
+                                        IOTCORE_TOKEN_EXPIRATION_TIME_MINUTES);
+    energy_meter.count_jwt((uint32_t)(esp_timer_get_time() - sign_start_us));
+    return jwt_len;
+}
+
+static bool mqtt_client_configure(clearblade_client_t *client)
+{
+
+    ESP_LOGI(TAG, "Generando JWT Token... ");
+    size_t jwt_len = mqtt_client_create_jwt(client);
 
-    if (GCP_JWT == 0)
+    if (jwt_len == 0)
     {
         last_error_count++;
         last_error_code |= ERROR_CODE_JWT;
@@ -186,13 +289,14 @@ static bool mqtt_client_configure(void)
         return false;
     }
 
-    mqtt_client_config.broker.address.uri = mqtt_client.clearblade_data->brokerUri;
-    mqtt_client_config.credentials.username = IOTCORE_USERNAME;
-    mqtt_client_config.broker.verification.certificate = CA_MIN_CERT;
-    mqtt_client_config.credentials.authentication.password = GCP_JWT;
-    mqtt_client_config.network.disable_auto_reconnect = false;
-    mqtt_client_config.credentials.client_id = mqtt_client.clearblade_data->clientId;
+    client->mqtt_config.broker.address.uri = client->clearblade_data.brokerUri;
+    client->mqtt_config.credentials.username = IOTCORE_USERNAME;
+    client->mqtt_config.broker.verification.certificate = CA_MIN_CERT;
+    client->mqtt_config.credentials.authentication.password = client->jwt;
+    client->mqtt_config.network.disable_auto_reconnect = false;
+    client->mqtt_config.credentials.client_id = client->clearblade_data.clientId;
 
+    boot_timeline.stamp(BOOT_PHASE_JWT_GENERATED);
     ESP_LOGI(TAG, "JWT Token generado... ");
     return true;
 }
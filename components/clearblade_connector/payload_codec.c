@@ -0,0 +1,178 @@
+/*
+ * payload_codec.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <string.h>
+
+#include "payload_codec.h"
+
+/* Reglas del formato de bloque de LZ4 */
+#define MIN_MATCH 4
+#define MF_LIMIT 12     // Ninguna coincidencia empieza en los ultimos 12 bytes
+#define LAST_LITERALS 5 // y los ultimos 5 son siempre literales
+
+static uint32_t read32(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - PAYLOAD_CODEC_HASH_LOG);
+}
+
+/* Largos de 15 o mas: bytes de 255 y el resto */
+static bool put_length(uint8_t **op, const uint8_t *end, size_t len)
+{
+    for (; len >= 255; len -= 255)
+    {
+        if (*op >= end)
+            return false;
+        *(*op)++ = 255;
+    }
+    if (*op >= end)
+        return false;
+    *(*op)++ = len;
+    return true;
+}
+
+/* Token, literales y, salvo en la ultima secuencia (match_len 0), la coincidencia */
+static bool put_sequence(uint8_t **op, const uint8_t *end, const uint8_t *literals, size_t lit_len, size_t offset,
+                         size_t match_len)
+{
+    if (*op >= end)
+        return false;
+    uint8_t *token = (*op)++;
+    *token = (lit_len >= 15 ? 15 : lit_len) << 4;
+    if (lit_len >= 15 && !put_length(op, end, lit_len - 15))
+        return false;
+    if ((size_t)(end - *op) < lit_len)
+        return false;
+    memcpy(*op, literals, lit_len);
+    *op += lit_len;
+    if (match_len == 0)
+        return true;
+
+    if (end - *op < 2)
+        return false;
+    *(*op)++ = offset;
+    *(*op)++ = offset >> 8;
+    size_t extra = match_len - MIN_MATCH;
+    *token |= extra >= 15 ? 15 : extra;
+    return extra < 15 || put_length(op, end, extra - 15);
+}
+
+size_t payload_codec_compress(payload_codec_state_t *state, const uint8_t *in, size_t in_len, uint8_t *out,
+                              size_t out_max)
+{
+    if (in_len > PAYLOAD_CODEC_MAX_INPUT || out_max <= PAYLOAD_CODEC_HEADER_LEN)
+        return 0;
+    out[0] = PAYLOAD_CODEC_MARKER;
+    out[1] = PAYLOAD_CODEC_LZ4;
+    out[2] = in_len;
+    out[3] = in_len >> 8;
+    uint8_t *op = out + PAYLOAD_CODEC_HEADER_LEN;
+    const uint8_t *end = out + out_max;
+
+    // Las posiciones entran en 16 bits: el payload no pasa de 64 KB, la distancia maxima de LZ4
+    memset(state->table, 0, sizeof(state->table));
+    size_t anchor = 0;
+    if (in_len > MF_LIMIT)
+    {
+        size_t match_limit = in_len - LAST_LITERALS;
+        size_t ip = 0;
+        while (ip <= in_len - MF_LIMIT)
+        {
+            uint32_t sequence = read32(in + ip);
+            uint32_t h = hash(sequence);
+            size_t ref = state->table[h];
+            state->table[h] = ip;
+            if (ref >= ip || read32(in + ref) != sequence)
+            {
+                ip++;
+                continue;
+            }
+            while (ip > anchor && ref > 0 && in[ip - 1] == in[ref - 1])
+            {
+                ip--;
+                ref--;
+            }
+            size_t len = MIN_MATCH;
+            while (ip + len < match_limit && in[ip + len] == in[ref + len])
+                len++;
+            if (!put_sequence(&op, end, in + anchor, ip - anchor, ip - ref, len))
+                return 0;
+            ip += len;
+            anchor = ip;
+        }
+    }
+    if (!put_sequence(&op, end, in + anchor, in_len - anchor, 0, 0))
+        return 0;
+    return op - out;
+}
+
+bool payload_codec_is_encoded(const uint8_t *data, size_t len)
+{
+    return len >= PAYLOAD_CODEC_HEADER_LEN && data[0] == PAYLOAD_CODEC_MARKER;
+}
+
+/* Largo extendido de literales o coincidencia; false si se termina la entrada */
+static bool get_length(const uint8_t **ip, const uint8_t *end, size_t *len)
+{
+    uint8_t byte;
+    do
+    {
+        if (*ip >= end)
+            return false;
+        byte = *(*ip)++;
+        *len += byte;
+    } while (byte == 255);
+    return true;
+}
+
+int payload_codec_decompress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_max)
+{
+    if (!payload_codec_is_encoded(in, in_len) || in[1] != PAYLOAD_CODEC_LZ4)
+        return -1;
+    size_t expected = in[2] | (in[3] << 8);
+    if (expected > out_max)
+        return -1;
+
+    const uint8_t *ip = in + PAYLOAD_CODEC_HEADER_LEN;
+    const uint8_t *end = in + in_len;
+    size_t o = 0;
+    while (ip < end)
+    {
+        uint8_t token = *ip++;
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && !get_length(&ip, end, &lit_len))
+            return -1;
+        if ((size_t)(end - ip) < lit_len || expected - o < lit_len)
+            return -1;
+        memcpy(out + o, ip, lit_len);
+        ip += lit_len;
+        o += lit_len;
+        if (ip == end)
+            break; // Ultima secuencia: solo literales
+
+        if (end - ip < 2)
+            return -1;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t match_len = token & 15;
+        if (match_len == 15 && !get_length(&ip, end, &match_len))
+            return -1;
+        match_len += MIN_MATCH;
+        if (offset == 0 || offset > o || expected - o < match_len)
+            return -1;
+        // Byte a byte: la coincidencia puede solaparse con lo que escribe
+        for (size_t k = 0; k < match_len; k++, o++)
+            out[o] = out[o - offset];
+    }
+    return o == expected ? (int)o : -1;
+}
@@ -0,0 +1,52 @@
+/*
+ * payload_codec.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef PAYLOAD_CODEC_H_
+#define PAYLOAD_CODEC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/************************************************************************/
+/* Payload comprimido. Un JSON empieza con '{' o '[' y un bloque de     */
+/* historial con SAMPLE_HISTORY_MAGIC; el comprimido empieza con        */
+/* PAYLOAD_CODEC_MARKER, asi el backend lo distingue sin otro topic:    */
+/*                                                                      */
+/*   u8 0xC7, u8 codificacion (1 = bloque LZ4), u16 largo original      */
+/*   y despues el bloque LZ4                                            */
+/*                                                                      */
+/* Se eligio el formato de bloque de LZ4 porque lo decodifica cualquier */
+/* biblioteca estandar (lz4.block.decompress(datos[4:], largo) en       */
+/* Python). La ventana es el propio payload: cada mensaje se decodifica */
+/* solo, aunque se pierda otro con QoS 0.                               */
+/************************************************************************/
+#define PAYLOAD_CODEC_MARKER 0xC7
+#define PAYLOAD_CODEC_LZ4 0x01
+#define PAYLOAD_CODEC_HEADER_LEN 4
+#define PAYLOAD_CODEC_MAX_INPUT 0xFFFF
+
+/* 2^N entradas de 2 bytes en la tabla de hashes */
+#ifndef PAYLOAD_CODEC_HASH_LOG
+#define PAYLOAD_CODEC_HASH_LOG 10
+#endif
+
+/* Lo usa un solo compresor a la vez; los campos son privados */
+typedef struct
+{
+    uint16_t table[1 << PAYLOAD_CODEC_HASH_LOG];
+} payload_codec_state_t;
+
+/* Comprime in en out con la cabecera. Devuelve el largo, o 0 si no entra */
+/* en out_max: con out_max < in_len solo sale si achica el payload        */
+size_t payload_codec_compress(payload_codec_state_t *state, const uint8_t *in, size_t in_len, uint8_t *out,
+                              size_t out_max);
+bool payload_codec_is_encoded(const uint8_t *data, size_t len);
+/* Devuelve el largo decodificado, o -1 si el payload esta corrupto o no entra */
+int payload_codec_decompress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_max);
+
+#endif /* PAYLOAD_CODEC_H_ */
@@ -0,0 +1,176 @@
+/*
+ * publish_limiter.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+#include "publish_limiter.h"
+
+#define TOKEN_SCALE 1000000LL
+/* Tope del tiempo a reponer de una vez, evita el desborde de elapsed * tasa */
+#define REFILL_MAX_US (3600 * 1000000LL)
+
+static void refill_bucket(int64_t *tokens, uint32_t rate, uint32_t burst, int64_t elapsed_us)
+{
+    int64_t capacity = (int64_t)burst * TOKEN_SCALE;
+    *tokens += elapsed_us * rate;
+    if (*tokens > capacity)
+        *tokens = capacity;
+}
+
+/* Espera hasta que el balde, tras descontar cost, vuelva a cero */
+static int64_t bucket_wait_us(int64_t tokens, int64_t cost, uint32_t rate)
+{
+    int64_t balance = tokens - cost;
+    if (rate == 0 || balance >= 0)
+        return 0;
+    return (-balance + rate - 1) / rate;
+}
+
+void publish_limiter_init(publish_limiter_t *limiter, const publish_limit_config_t *config)
+{
+    memset(limiter, 0, sizeof(*limiter));
+    limiter->mutex = xSemaphoreCreateMutexStatic(&limiter->mutex_buffer);
+    publish_limiter_set_config(limiter, config);
+}
+
+/* Los baldes arrancan llenos con la nueva rafaga */
+void publish_limiter_set_config(publish_limiter_t *limiter, const publish_limit_config_t *config)
+{
+    xSemaphoreTake(limiter->mutex, portMAX_DELAY);
+    limiter->config = *config;
+    limiter->msg_tokens = (int64_t)config->msg_burst * TOKEN_SCALE;
+    limiter->byte_tokens = (int64_t)config->byte_burst * TOKEN_SCALE;
+    limiter->last_refill_us = esp_timer_get_time();
+    xSemaphoreGive(limiter->mutex);
+}
+
+void publish_limiter_get_config(publish_limiter_t *limiter, publish_limit_config_t *config)
+{
+    xSemaphoreTake(limiter->mutex, portMAX_DELAY);
+    *config = limiter->config;
+    xSemaphoreGive(limiter->mutex);
+}
+
+/* Repone los baldes hasta now_us; se llama con el mutex tomado */
+static void refill(publish_limiter_t *limiter, int64_t now_us)
+{
+    const publish_limit_config_t *config = &limiter->config;
+    int64_t elapsed_us = now_us - limiter->last_refill_us;
+    if (elapsed_us > REFILL_MAX_US)
+        elapsed_us = REFILL_MAX_US;
+    if (elapsed_us > 0)
+    {
+        refill_bucket(&limiter->msg_tokens, config->msgs_per_s, config->msg_burst, elapsed_us);
+        refill_bucket(&limiter->byte_tokens, config->bytes_per_s, config->byte_burst, elapsed_us);
+        limiter->last_refill_us = now_us;
+    }
+}
+
+/* Lo que se deja en el balde se recorta a lo que la rafaga deja libre tras cost */
+static int64_t bucket_keep(uint32_t burst, int64_t cost, uint32_t keep)
+{
+    int64_t spare = (int64_t)burst * TOKEN_SCALE - cost;
+    int64_t wanted = (int64_t)keep * TOKEN_SCALE;
+    if (spare <= 0)
+        return 0;
+    return wanted < spare ? wanted : spare;
+}
+
+int64_t publish_limiter_reserve(publish_limiter_t *limiter, size_t bytes, int64_t now_us, int64_t max_wait_us)
+{
+    xSemaphoreTake(limiter->mutex, portMAX_DELAY);
+    const publish_limit_config_t *config = &limiter->config;
+    refill(limiter, now_us);
+
+    int64_t msg_cost = config->msgs_per_s > 0 ? TOKEN_SCALE : 0;
+    int64_t byte_cost = config->bytes_per_s > 0 ? (int64_t)bytes * TOKEN_SCALE : 0;
+    int64_t wait_us = bucket_wait_us(limiter->msg_tokens, msg_cost, config->msgs_per_s);
+    int64_t byte_wait_us = bucket_wait_us(limiter->byte_tokens, byte_cost, config->bytes_per_s);
+    if (byte_wait_us > wait_us)
+        wait_us = byte_wait_us;
+
+    if (wait_us > max_wait_us)
+    {
+        limiter->stats.rejected++;
+        xSemaphoreGive(limiter->mutex);
+        return -1;
+    }
+
+    limiter->msg_tokens -= msg_cost;
+    limiter->byte_tokens -= byte_cost;
+    if (wait_us == 0)
+    {
+        limiter->stats.passed++;
+    }
+    else
+    {
+        limiter->stats.throttled++;
+        limiter->stats.throttle_us_total += wait_us;
+        if (wait_us > limiter->stats.throttle_us_max)
+            limiter->stats.throttle_us_max = wait_us;
+    }
+    xSemaphoreGive(limiter->mutex);
+    return wait_us;
+}
+
+int64_t publish_limiter_try_reserve(publish_limiter_t *limiter, size_t bytes, uint32_t keep_msgs, uint32_t keep_bytes,
+                                    int64_t now_us)
+{
+    xSemaphoreTake(limiter->mutex, portMAX_DELAY);
+    const publish_limit_config_t *config = &limiter->config;
+    refill(limiter, now_us);
+
+    int64_t msg_cost = config->msgs_per_s > 0 ? TOKEN_SCALE : 0;
+    int64_t byte_cost = config->bytes_per_s > 0 ? (int64_t)bytes * TOKEN_SCALE : 0;
+    if (byte_cost > (int64_t)config->byte_burst * TOKEN_SCALE)
+    {
+        limiter->stats.rejected++;
+        xSemaphoreGive(limiter->mutex);
+        return -1;
+    }
+
+    int64_t msg_need = msg_cost > 0 ? msg_cost + bucket_keep(config->msg_burst, msg_cost, keep_msgs) : 0;
+    int64_t byte_need = byte_cost > 0 ? byte_cost + bucket_keep(config->byte_burst, byte_cost, keep_bytes) : 0;
+    int64_t wait_us = bucket_wait_us(limiter->msg_tokens, msg_need, config->msgs_per_s);
+    int64_t byte_wait_us = bucket_wait_us(limiter->byte_tokens, byte_need, config->bytes_per_s);
+    if (byte_wait_us > wait_us)
+        wait_us = byte_wait_us;
+
+    if (wait_us == 0)
+    {
+        limiter->msg_tokens -= msg_cost;
+        limiter->byte_tokens -= byte_cost;
+        limiter->stats.passed++;
+    }
+    xSemaphoreGive(limiter->mutex);
+    return wait_us;
+}
+
+bool publish_limiter_acquire(publish_limiter_t *limiter, size_t bytes)
+{
+    int64_t wait_us = publish_limiter_reserve(limiter, bytes, esp_timer_get_time(), PUBLISH_LIMITER_MAX_WAIT_MS * 1000LL);
+    if (wait_us < 0)
+        return false;
+    if (wait_us > 0)
+    {
+        // Se redondea hacia arriba: con ticks de 10 ms una espera corta no debe quedar en 0
+        int64_t tick_us = portTICK_PERIOD_MS * 1000LL;
+        vTaskDelay((TickType_t)((wait_us + tick_us - 1) / tick_us));
+    }
+    return true;
+}
+
+void publish_limiter_get_stats(publish_limiter_t *limiter, publish_limiter_stats_t *stats)
+{
+    xSemaphoreTake(limiter->mutex, portMAX_DELAY);
+    *stats = limiter->stats;
+    xSemaphoreGive(limiter->mutex);
+}
@@ -0,0 +1,95 @@
+/*
+ * publish_limiter.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef PUBLISH_LIMITER_H_
+#define PUBLISH_LIMITER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+/* Limites por defecto, por debajo de la cuota por dispositivo de Clearblade. */
+/* Los valores del proyecto llegan por el topic /config (ver                 */
+/* clearblade_client_apply_config()). 0 = sin limite en esa dimension.       */
+#ifndef PUBLISH_LIMITER_MSGS_PER_S
+#define PUBLISH_LIMITER_MSGS_PER_S 10
+#endif
+#ifndef PUBLISH_LIMITER_MSG_BURST
+#define PUBLISH_LIMITER_MSG_BURST 5
+#endif
+#ifndef PUBLISH_LIMITER_BYTES_PER_S
+#define PUBLISH_LIMITER_BYTES_PER_S 16384
+#endif
+#ifndef PUBLISH_LIMITER_BYTE_BURST
+#define PUBLISH_LIMITER_BYTE_BURST 4096
+#endif
+/* Espera maxima de una publicacion; si hace falta mas, se rechaza */
+#ifndef PUBLISH_LIMITER_MAX_WAIT_MS
+#define PUBLISH_LIMITER_MAX_WAIT_MS 5000
+#endif
+
+typedef struct
+{
+    uint32_t msgs_per_s;
+    uint32_t msg_burst;   // Mensajes que pueden salir juntos tras un rato sin publicar
+    uint32_t bytes_per_s; // Topic + payload, como los cuenta el broker
+    uint32_t byte_burst;
+} publish_limit_config_t;
+
+typedef struct
+{
+    uint32_t passed;          // Salieron sin esperar
+    uint32_t throttled;       // Esperaron turno
+    uint32_t rejected;        // La espera superaba PUBLISH_LIMITER_MAX_WAIT_MS
+    uint64_t throttle_us_total;
+    uint32_t throttle_us_max;
+} publish_limiter_stats_t;
+
+/************************************************************************/
+/* Token bucket doble (mensajes y bytes). Los tokens se llevan en       */
+/* millonesimas para reponer por microsegundo sin flotantes. Cada       */
+/* reserva descuenta sus tokens aunque el balde quede en negativo y     */
+/* devuelve la espera hasta saldar la deuda: las publicaciones          */
+/* concurrentes quedan en fila y salen espaciadas a la tasa configurada */
+/* en lugar de en rafagas. Los campos son privados.                     */
+/************************************************************************/
+typedef struct
+{
+    publish_limit_config_t config;
+    int64_t msg_tokens;
+    int64_t byte_tokens;
+    int64_t last_refill_us;
+    publish_limiter_stats_t stats;
+    SemaphoreHandle_t mutex;
+    StaticSemaphore_t mutex_buffer;
+} publish_limiter_t;
+
+void publish_limiter_init(publish_limiter_t *limiter, const publish_limit_config_t *config);
+void publish_limiter_set_config(publish_limiter_t *limiter, const publish_limit_config_t *config);
+void publish_limiter_get_config(publish_limiter_t *limiter, publish_limit_config_t *config);
+
+/* Reserva el envio de un mensaje de bytes bytes en now_us. Devuelve la espera */
+/* en us antes de publicar (0 = ya), o -1 si supera max_wait_us; en ese caso   */
+/* no se descuenta nada.                                                       */
+int64_t publish_limiter_reserve(publish_limiter_t *limiter, size_t bytes, int64_t now_us, int64_t max_wait_us);
+
+/* Reserva sin deuda ni espera, para quien tiene otro trabajo mientras tanto:   */
+/* solo descuenta si el balde cubre el mensaje y ademas deja keep_msgs y        */
+/* keep_bytes para otras publicaciones (recortados a lo que la rafaga deja      */
+/* libre). Devuelve 0 si reservo, la espera en us hasta poder hacerlo, o -1 si  */
+/* el mensaje supera la rafaga de bytes y nunca va a poder salir asi.           */
+int64_t publish_limiter_try_reserve(publish_limiter_t *limiter, size_t bytes, uint32_t keep_msgs, uint32_t keep_bytes,
+                                    int64_t now_us);
+
+/* Reserva y bloquea la tarea hasta su turno. false si se rechazo */
+bool publish_limiter_acquire(publish_limiter_t *limiter, size_t bytes);
+
+void publish_limiter_get_stats(publish_limiter_t *limiter, publish_limiter_stats_t *stats);
+
+#endif /* PUBLISH_LIMITER_H_ */
@@ -0,0 +1,71 @@
+/*
+ * rtc_drift.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <stdlib.h>
+
+#include "rtc_drift.h"
+
+bool rtc_drift_sync(rtc_drift_t *drift, int64_t local_us, int64_t sntp_us, int32_t *measured_ppm)
+{
+    int64_t interval_us = sntp_us - drift->last_sync_us;
+    int64_t ppm = 0;
+    bool measured = false;
+    if (drift->last_sync_us > 0 && interval_us > RTC_DRIFT_MIN_INTERVAL_US)
+    {
+        // Error propio del RTC, sin la correccion que ya se le aplico
+        int64_t rtc_error_us = (local_us - sntp_us) + drift->applied_us;
+        // Mas de RTC_DRIFT_MAX_PPM es un salto de la hora: la estimacion sigue como estaba
+        measured = llabs(rtc_error_us) <= interval_us / 1000000LL * RTC_DRIFT_MAX_PPM;
+        if (measured)
+            ppm = rtc_error_us * 1000000LL / interval_us;
+    }
+
+    if (measured && drift->drift_valid)
+    {
+        int32_t residual_ppm = abs((int32_t)ppm - drift->drift_ppm);
+        // Redondeo al mas cercano: truncando, la estimacion se queda hasta 3 ppm corta
+        int32_t sum = 3 * drift->drift_ppm + (int32_t)ppm;
+        drift->drift_ppm = (sum >= 0 ? sum + 2 : sum - 2) / 4;
+        drift->drift_bound_ppm = (3 * drift->drift_bound_ppm + 2 * residual_ppm) / 4;
+        if (drift->drift_bound_ppm < RTC_DRIFT_RESIDUAL_MIN_PPM)
+            drift->drift_bound_ppm = RTC_DRIFT_RESIDUAL_MIN_PPM;
+    }
+    else if (measured)
+    {
+        drift->drift_ppm = (int32_t)ppm;
+        drift->drift_bound_ppm = RTC_DRIFT_DEFAULT_BOUND_PPM / 2;
+        drift->drift_valid = true;
+    }
+    if (measured && measured_ppm != NULL)
+        *measured_ppm = (int32_t)ppm;
+    drift->last_sync_us = sntp_us;
+    drift->applied_us = 0;
+    return measured;
+}
+
+int64_t rtc_drift_correction_us(rtc_drift_t *drift, int64_t now_us)
+{
+    if (!drift->drift_valid || drift->last_sync_us == 0)
+        return 0;
+    // Correccion total esperada desde la ultima sincronizacion, menos la ya aplicada
+    int64_t elapsed_us = now_us - drift->last_sync_us;
+    int64_t expected_us = (elapsed_us + drift->applied_us) * drift->drift_ppm / 1000000LL;
+    int64_t delta_us = expected_us - drift->applied_us;
+    drift->applied_us = expected_us;
+    return delta_us;
+}
+
+uint32_t rtc_drift_uncertainty_ms(const rtc_drift_t *drift, int64_t now_us)
+{
+    int64_t elapsed_s = (now_us - drift->last_sync_us) / 1000000LL;
+    if (elapsed_s < 0)
+        elapsed_s = 0;
+
+    uint32_t bound_ppm = drift->drift_valid ? drift->drift_bound_ppm : RTC_DRIFT_DEFAULT_BOUND_PPM;
+    // ppm * s = us
+    return RTC_DRIFT_SYNC_UNCERTAINTY_MS + (uint32_t)((elapsed_s * bound_ppm) / 1000);
+}
@@ -0,0 +1,56 @@
+/*
+ * rtc_drift.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef RTC_DRIFT_H_
+#define RTC_DRIFT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Deriva supuesta del RTC mientras no haya una estimacion propia */
+#define RTC_DRIFT_DEFAULT_BOUND_PPM 500
+
+/* Incertidumbre de una sincronizacion SNTP recien hecha */
+#define RTC_DRIFT_SYNC_UNCERTAINTY_MS 50
+
+/* Intervalo minimo entre sincronizaciones para que la estimacion de deriva sea util */
+#define RTC_DRIFT_MIN_INTERVAL_US (10LL * 60 * 1000000)
+
+/* Cota de la deriva residual una vez estimada (ppm) */
+#define RTC_DRIFT_RESIDUAL_MIN_PPM 20
+
+/* Un error mayor entre sincronizaciones no es deriva sino un salto de la hora */
+/* (el servidor corrigio la suya, o alguien ajusto el reloj): no se estima     */
+#define RTC_DRIFT_MAX_PPM (4 * RTC_DRIFT_DEFAULT_BOUND_PPM)
+
+/************************************************************************/
+/* Estimacion de la deriva del RTC entre sincronizaciones SNTP. Solo    */
+/* aritmetica sobre las horas que recibe: sntp_time.c le pasa la hora   */
+/* del sistema y la de SNTP, y guarda la estructura en memoria RTC.     */
+/************************************************************************/
+typedef struct
+{
+    int64_t last_sync_us;     // Hora SNTP (epoch, us) de la ultima sincronizacion; 0 si no hubo
+    int64_t applied_us;       // Correccion de deriva aplicada desde la ultima sincronizacion
+    int32_t drift_ppm;        // Deriva estimada (>0: el RTC adelanta)
+    uint32_t drift_bound_ppm; // Cota del error de la estimacion
+    bool drift_valid;
+} rtc_drift_t;
+
+/* Registra una sincronizacion: local_us es la hora del sistema justo antes de */
+/* ajustarla a sntp_us. Devuelve true (y la deriva medida) si el intervalo     */
+/* desde la anterior alcanzo para actualizar la estimacion y la medicion no    */
+/* supera RTC_DRIFT_MAX_PPM.                                                   */
+bool rtc_drift_sync(rtc_drift_t *drift, int64_t local_us, int64_t sntp_us, int32_t *measured_ppm);
+
+/* Correccion que falta restar a la hora del sistema now_us; la da por aplicada */
+int64_t rtc_drift_correction_us(rtc_drift_t *drift, int64_t now_us);
+
+/* Cota del error de la hora now_us: la de la sincronizacion mas la deriva posible desde entonces */
+uint32_t rtc_drift_uncertainty_ms(const rtc_drift_t *drift, int64_t now_us);
+
+#endif /* RTC_DRIFT_H_ */
@@ -8,8 +8,11 @@
  */
 
 #include "sntp_time.h"
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <sys/time.h>
+#include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
@@ -19,27 +22,227 @@
 #include "esp_attr.h"
 #include "esp_sleep.h"
 #include "esp_sntp.h"
-#include "clearblade_connect.h"
+#include "boot_timeline.h"
+
+#define TIME_SERVICE_MAGIC 0x71AE5E7C
 
 static const char *TAG = "SNTP Module";
 
-/* Variable holding number of times ESP32 restarted since first boot.
- * It is placed into RTC memory using RTC_DATA_ATTR and
- * maintains its value when ESP32 wakes from deep sleep.
- */
-RTC_DATA_ATTR static int boot_count = 0;
+/************************************************************************/
+/* Estado persistente en RTC.                                           */
+/*                                                                      */
+/* La hora del sistema del ESP32 se mantiene con el RTC durante el deep */
+/* sleep y los reinicios por software. Se guarda el instante de la      */
+/* ultima sincronizacion SNTP, la deriva estimada y la correccion ya    */
+/* aplicada (rtc_drift.h), para poder acotar el error de la hora        */
+/* actual.                                                              */
+/* RTC_NOINIT_ATTR: el contenido sobrevive a los reinicios por software */
+/* y se valida con un numero magico tras un encendido.                  */
+/************************************************************************/
+typedef struct
+{
+    uint32_t magic;
+    rtc_drift_t drift;
+} time_service_rtc_t;
+
+static RTC_NOINIT_ATTR time_service_rtc_t rtc_state;
 
-void time_sync_notification_cb(struct timeval *tv)
+static const char *default_servers[] = SNTP_TIME_DEFAULT_SERVERS;
+static const char *const *sntp_servers = default_servers;
+static uint8_t sntp_server_count = sizeof(default_servers) / sizeof(default_servers[0]);
+
+static uint32_t max_error_ms = SNTP_TIME_DEFAULT_MAX_ERROR_MS;
+static time_quality_t quality = TIME_QUALITY_UNSET;
+static bool initialized = false;
+
+/* Se activa cuando la hora es utilizable (RTC confiable o primera sincronizacion SNTP) */
+#define TIME_AVAILABLE_BIT BIT0
+static StaticEventGroup_t time_event_group_buffer;
+static EventGroupHandle_t time_event_group = NULL;
+
+static int64_t get_time_us(void)
 {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static int64_t get_time_ms(void)
+{
+    return get_time_us() / 1000;
+}
+
+static void set_time_us(int64_t time_us)
+{
+    struct timeval tv = {
+        .tv_sec = time_us / 1000000LL,
+        .tv_usec = time_us % 1000000LL,
+    };
+    settimeofday(&tv, NULL);
+}
+
+static uint32_t get_uncertainty_ms(void)
+{
+    if (quality == TIME_QUALITY_UNSET)
+        return UINT32_MAX;
+    return rtc_drift_uncertainty_ms(&rtc_state.drift, get_time_us());
+}
+
+static bool is_trusted(void)
+{
+    return quality != TIME_QUALITY_UNSET && get_uncertainty_ms() <= max_error_ms;
+}
+
+static time_quality_t get_quality(void)
+{
+    return quality;
+}
+
+static int32_t get_drift_ppm(void)
+{
+    return rtc_state.drift.drift_valid ? rtc_state.drift.drift_ppm : 0;
+}
+
+static void notify_time_available(void)
+{
+    xEventGroupSetBits(time_event_group, TIME_AVAILABLE_BIT);
+}
+
+static bool wait_available(TickType_t ticks_to_wait)
+{
+    if (time_event_group == NULL)
+        return false;
+    return (xEventGroupWaitBits(time_event_group, TIME_AVAILABLE_BIT, pdFALSE, pdTRUE, ticks_to_wait) & TIME_AVAILABLE_BIT) != 0;
+}
+
+/************************************************************************/
+/* Reemplaza la funcion weak de ESP-IDF que aplica la hora recibida por */
+/* SNTP (ver esp_sntp.h). Antes de ajustar el reloj mide la diferencia  */
+/* con la hora local para estimar la deriva del RTC.                    */
+/************************************************************************/
+void sntp_sync_time(struct timeval *tv)
+{
+    int64_t sntp_us = (int64_t)tv->tv_sec * 1000000LL + tv->tv_usec;
+    int64_t local_us = get_time_us();
+
+    int32_t measured_ppm;
+    if (rtc_drift_sync(&rtc_state.drift, local_us, sntp_us, &measured_ppm))
+        ESP_LOGI(TAG, "Deriva RTC medida: %ld ppm, estimada: %ld ppm (+/- %lu)",
+                 (long)measured_ppm, (long)rtc_state.drift.drift_ppm, (unsigned long)rtc_state.drift.drift_bound_ppm);
+
+    ESP_LOGI(TAG, "Offset SNTP: %lld ms", (long long)((sntp_us - local_us) / 1000));
+
+    settimeofday(tv, NULL);
+    sntp_set_sync_status(SNTP_SYNC_STATUS_COMPLETED);
+
+    rtc_state.magic = TIME_SERVICE_MAGIC;
+
+    bool was_unset = (quality == TIME_QUALITY_UNSET);
+    quality = TIME_QUALITY_SNTP;
+
     ESP_LOGI(TAG, "Notification of a time synchronization event");
-    xEventGroupSetBits(*mqtt_client.mqtt_event_group, TIME_SYNCHRONIZED);
+    boot_timeline.stamp(BOOT_PHASE_SNTP_SYNC);
+    if (was_unset)
+        notify_time_available();
+}
+
+/************************************************************************/
+/* Tras un deep sleep o un reinicio, corrige la hora del sistema con la */
+/* deriva estimada y decide si se puede usar sin esperar a SNTP.        */
+/************************************************************************/
+static void restore_rtc_time(void)
+{
+    esp_reset_reason_t reset_reason = esp_reset_reason();
+    if (rtc_state.magic != TIME_SERVICE_MAGIC || reset_reason == ESP_RST_POWERON || reset_reason == ESP_RST_BROWNOUT)
+    {
+        ESP_LOGI(TAG, "Sin hora previa en RTC.");
+        memset(&rtc_state, 0, sizeof(rtc_state));
+        rtc_state.magic = TIME_SERVICE_MAGIC;
+        return;
+    }
+
+    if (rtc_state.drift.last_sync_us == 0)
+    {
+        ESP_LOGI(TAG, "Sin sincronizacion SNTP previa.");
+        return;
+    }
+
+    int64_t now_us = get_time_us();
+    if (now_us < rtc_state.drift.last_sync_us)
+    {
+        ESP_LOGW(TAG, "Hora del RTC anterior a la ultima sincronizacion, se descarta.");
+        rtc_state.drift.last_sync_us = 0;
+        rtc_state.drift.applied_us = 0;
+        return;
+    }
+
+    int64_t delta_us = rtc_drift_correction_us(&rtc_state.drift, now_us);
+    if (delta_us != 0)
+    {
+        set_time_us(now_us - delta_us);
+        ESP_LOGI(TAG, "Correccion de deriva aplicada: %lld ms", (long long)(-delta_us / 1000));
+    }
+
+    quality = TIME_QUALITY_RTC_ESTIMATE;
+    uint32_t uncertainty_ms = get_uncertainty_ms();
+    if (uncertainty_ms <= max_error_ms)
+    {
+        ESP_LOGI(TAG, "Hora del RTC aceptada, error estimado %lu ms.", (unsigned long)uncertainty_ms);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Error estimado del RTC %lu ms, se espera a SNTP.", (unsigned long)uncertainty_ms);
+        quality = TIME_QUALITY_UNSET;
+    }
+}
+
+static void set_servers(const char *const *servers, uint8_t count)
+{
+    // esp_sntp_setservername() guarda el puntero, los nombres deben ser estaticos.
+    sntp_servers = servers;
+    sntp_server_count = count;
 }
 
-void initialize_sntp(void)
+static void set_max_error_ms(uint32_t error_ms)
 {
+    max_error_ms = error_ms;
+}
+
+/* Se puede llamar desde varios clientes; solo la primera llamada tiene efecto */
+static void initialize(void)
+{
+    if (initialized)
+        return;
+    initialized = true;
+
+    time_event_group = xEventGroupCreateStatic(&time_event_group_buffer);
+    restore_rtc_time();
+
     ESP_LOGI(TAG, "Initializing SNTP");
     esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
-    esp_sntp_setservername(0, "time.google.com");
-    sntp_set_time_sync_notification_cb(time_sync_notification_cb);
+    for (uint8_t i = 0; i < sntp_server_count && i < CONFIG_LWIP_SNTP_MAX_SERVERS; i++)
+    {
+        ESP_LOGI(TAG, "Servidor SNTP %d: %s", i, sntp_servers[i]);
+        esp_sntp_setservername(i, sntp_servers[i]);
+    }
     esp_sntp_init();
+
+    if (is_trusted())
+        notify_time_available();
 }
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)            *
+ ******************************************************/
+const time_service_t time_service = {
+    // Time Service Functions
+    .set_servers = set_servers,
+    .set_max_error_ms = set_max_error_ms,
+    .initialize = initialize,
+    .wait_available = wait_available,
+    .is_trusted = is_trusted,
+    .get_quality = get_quality,
+    .get_uncertainty_ms = get_uncertainty_ms,
+    .get_drift_ppm = get_drift_ppm,
+    .get_time_ms = get_time_ms,
+};
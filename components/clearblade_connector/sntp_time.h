@@ -10,6 +10,51 @@
 #ifndef SNTP_TIME_H_
 #define SNTP_TIME_H_
 
-void initialize_sntp(void);
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "rtc_drift.h"
+
+/* Servidores SNTP por defecto, en orden de preferencia */
+#define SNTP_TIME_DEFAULT_SERVERS {"time.google.com", "pool.ntp.org", "time.cloudflare.com"}
+
+/* Error maximo (ms) con el que se acepta la hora del RTC sin esperar a SNTP */
+#define SNTP_TIME_DEFAULT_MAX_ERROR_MS 2000
+
+/* Deriva supuesta y error de una sincronizacion: ver rtc_drift.h */
+#define SNTP_TIME_DEFAULT_DRIFT_BOUND_PPM RTC_DRIFT_DEFAULT_BOUND_PPM
+#define SNTP_TIME_SYNC_UNCERTAINTY_MS RTC_DRIFT_SYNC_UNCERTAINTY_MS
+
+typedef enum
+{
+    TIME_QUALITY_UNSET = 0,     // Hora desconocida (encendido en frio, sin SNTP)
+    TIME_QUALITY_RTC_ESTIMATE,  // Hora del RTC corregida por deriva, dentro del error maximo
+    TIME_QUALITY_SNTP,          // Sincronizada por SNTP en este arranque
+} time_quality_t;
+
+/************************************************************************/
+/* La siguiente estructura simula un objeto en C                        */
+/*                                                                      */
+/* Servicio de hora: confia en la hora del RTC tras un deep sleep o un  */
+/* reinicio si su error estimado es menor al maximo configurado, y      */
+/* sincroniza por SNTP en segundo plano contra una lista de servidores. */
+/* En cada sincronizacion estima la deriva del RTC y la corrige en los  */
+/* arranques siguientes.                                                */
+/************************************************************************/
+typedef struct
+{
+    // Time Service Functions
+    void (*set_servers)(const char *const *servers, uint8_t count);
+    void (*set_max_error_ms)(uint32_t max_error_ms);
+    void (*initialize)(void);
+    bool (*wait_available)(TickType_t ticks_to_wait);
+    bool (*is_trusted)(void);
+    time_quality_t (*get_quality)(void);
+    uint32_t (*get_uncertainty_ms)(void);
+    int32_t (*get_drift_ppm)(void);
+    int64_t (*get_time_ms)(void);
+} time_service_t;
+
+extern const time_service_t time_service;
 
 #endif /* SNTP_TIME_H_ */
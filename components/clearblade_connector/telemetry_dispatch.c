@@ -0,0 +1,475 @@
+/*
+ * telemetry_dispatch.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "telemetry_dispatch.h"
+#include "payload_codec.h"
+#include "energy_meter.h"
+#include "health_supervisor.h"
+#include "resource_monitor.h"
+
+#define DISPATCH_IDLE_BIT BIT0
+/* Espera antes de reintentar una publicacion que fallo (desconexion en curso) */
+#define DISPATCH_RETRY_MS 1000
+/* Resultado de publish_batch() cuando fallo la publicacion */
+#define DISPATCH_PUBLISH_FAILED (-1)
+
+static const char *TAG = "Telemetry dispatch";
+
+typedef struct
+{
+    int64_t queued_us;
+    uint16_t len;
+    char data[TELEMETRY_DISPATCH_MSG_MAX_LEN];
+} dispatch_msg_t;
+
+/* Cola circular de una clase. first_seq numera al mensaje de head: el despacho
+ * publica sin sacar de la cola y al terminar saca hasta el numero publicado,
+ * aunque mientras tanto send() haya descartado los mas viejos. */
+typedef struct
+{
+    dispatch_msg_t *slots;
+    uint8_t depth;
+    uint8_t head;
+    uint8_t count;
+    uint32_t first_seq;
+    int64_t last_publish_us;
+    int64_t retry_at_us; // El limitador no tenia cuota o fallo la publicacion: no antes de este momento
+    telemetry_class_config_t config;
+    telemetry_dispatch_stats_t stats;
+} dispatch_queue_t;
+
+static dispatch_msg_t alarm_slots[TELEMETRY_DISPATCH_ALARM_DEPTH];
+static dispatch_msg_t bulk_slots[TELEMETRY_DISPATCH_BULK_DEPTH];
+
+// Por orden de prioridad: el despacho atiende primero la clase de menor indice
+static dispatch_queue_t queues[TELEMETRY_CLASS_COUNT] = {
+    [TELEMETRY_CLASS_ALARM] = {
+        .slots = alarm_slots,
+        .depth = TELEMETRY_DISPATCH_ALARM_DEPTH,
+        .config = {.subtopic = TELEMETRY_DISPATCH_ALARM_SUBTOPIC, .qos = 1, .batch_max = 1, .batch_max_age_ms = 0, .min_interval_ms = 0},
+    },
+    [TELEMETRY_CLASS_BULK] = {
+        .slots = bulk_slots,
+        .depth = TELEMETRY_DISPATCH_BULK_DEPTH,
+        .config = {.subtopic = TELEMETRY_DISPATCH_BULK_SUBTOPIC, .qos = 0, .batch_max = 4, .batch_max_age_ms = 10 * 60 * 1000, .min_interval_ms = 1000,
+                   .compress_min_len = TELEMETRY_DISPATCH_COMPRESS_MIN_LEN},
+    },
+};
+
+static clearblade_client_t *dispatch_client = NULL;
+static volatile bool flush_requested = false;
+
+// Lote en armado y su version comprimida; solo los usa la tarea de despacho
+static char batch_buffer[TELEMETRY_DISPATCH_BATCH_MAX_LEN];
+static uint8_t compressed_buffer[TELEMETRY_DISPATCH_BATCH_MAX_LEN];
+static payload_codec_state_t codec_state;
+
+static SemaphoreHandle_t dispatch_mutex = NULL;
+static SemaphoreHandle_t work_semaphore = NULL;
+static EventGroupHandle_t dispatch_events = NULL;
+static TaskHandle_t dispatch_task_handle = NULL;
+
+#ifdef STATIC_ALLOCATION_MODE
+static StaticSemaphore_t dispatch_mutex_buffer;
+static StaticSemaphore_t work_semaphore_buffer;
+static StaticEventGroup_t dispatch_events_buffer;
+static StackType_t dispatch_task_stack[TELEMETRY_DISPATCH_TASK_STACK_SIZE];
+static StaticTask_t dispatch_task_buffer;
+#endif
+
+static void lock(void)
+{
+    xSemaphoreTake(dispatch_mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(dispatch_mutex);
+}
+
+static dispatch_msg_t *queue_at(dispatch_queue_t *queue, uint8_t index)
+{
+    return &queue->slots[(queue->head + index) % queue->depth];
+}
+
+static void queue_pop(dispatch_queue_t *queue)
+{
+    queue->head = (queue->head + 1) % queue->depth;
+    queue->count--;
+    queue->first_seq++;
+}
+
+static bool queues_empty(void)
+{
+    for (int cls = 0; cls < TELEMETRY_CLASS_COUNT; cls++)
+        if (queues[cls].count > 0)
+            return false;
+    return true;
+}
+
+/*****************************************************
+ *   Despacho                                         *
+ ******************************************************/
+
+/* Momento (us) en que la clase puede publicar; INT64_MAX si no tiene mensajes */
+static int64_t queue_due_us(const dispatch_queue_t *queue)
+{
+    if (queue->count == 0)
+        return INT64_MAX;
+    const dispatch_msg_t *oldest = &queue->slots[queue->head];
+    int64_t due_us = queue->count >= queue->config.batch_max || flush_requested
+                         ? oldest->queued_us
+                         : oldest->queued_us + queue->config.batch_max_age_ms * 1000LL;
+    int64_t allowed_us = queue->last_publish_us + queue->config.min_interval_ms * 1000LL;
+    if (queue->last_publish_us != 0 && allowed_us > due_us)
+        due_us = allowed_us;
+    return queue->retry_at_us > due_us ? queue->retry_at_us : due_us;
+}
+
+/* Copia a batch_buffer hasta limit mensajes de la cola; con el mutex tomado.
+ * Con batch_max 1 el mensaje va tal cual, si no siempre como arreglo. */
+static uint8_t build_batch(dispatch_queue_t *queue, uint8_t limit, int *len)
+{
+    uint8_t taken = 0;
+    *len = 0;
+    if (queue->config.batch_max <= 1)
+    {
+        if (queue->count == 0)
+            return 0;
+        dispatch_msg_t *msg = queue_at(queue, 0);
+        memcpy(batch_buffer, msg->data, msg->len);
+        *len = msg->len;
+        return 1;
+    }
+
+    batch_buffer[(*len)++] = '[';
+    while (taken < queue->count && taken < limit)
+    {
+        dispatch_msg_t *msg = queue_at(queue, taken);
+        if (*len + msg->len + 2 > (int)sizeof(batch_buffer))
+            break;
+        if (taken > 0)
+            batch_buffer[(*len)++] = ',';
+        memcpy(batch_buffer + *len, msg->data, msg->len);
+        *len += msg->len;
+        taken++;
+    }
+    batch_buffer[(*len)++] = ']';
+    return taken;
+}
+
+/************************************************************************/
+/* Arma y publica un lote de la clase. Los mensajes se copian bajo el   */
+/* mutex y se publican sin el, para no frenar a send(); se sacan de la  */
+/* cola solo si la publicacion salio.                                   */
+/*                                                                      */
+/* Las alarmas esperan su turno en el limitador como cualquier          */
+/* publicacion. La rutina no espera: si no hay cuota, o si publicar     */
+/* dejaria sin lugar a una alarma (TELEMETRY_DISPATCH_ALARM_RESERVE_*), */
+/* devuelve cuanto falta y la tarea vuelve a mirar las alarmas mientras */
+/* tanto. Un lote que no entra en la rafaga del limitador se parte a la */
+/* mitad; un mensaje solo que no entra se descarta.                     */
+/*                                                                      */
+/* Devuelve 0 si la cola avanzo, la espera en us si el limitador no     */
+/* dejo publicar o DISPATCH_PUBLISH_FAILED.                             */
+/************************************************************************/
+static int64_t publish_batch(dispatch_queue_t *queue)
+{
+    bool is_alarm = queue == &queues[TELEMETRY_CLASS_ALARM];
+    uint8_t limit = UINT8_MAX;
+    for (;;)
+    {
+        lock();
+        telemetry_class_config_t config = queue->config;
+        uint32_t first_seq = queue->first_seq;
+        int64_t oldest_us = queue->count > 0 ? queue->slots[queue->head].queued_us : 0;
+        int len;
+        uint8_t taken = build_batch(queue, limit < config.batch_max ? limit : config.batch_max, &len);
+        unlock();
+
+        if (taken == 0)
+            return DISPATCH_PUBLISH_FAILED;
+
+        // Solo si achica: con out_max < len, payload_codec_compress() devuelve 0 si no
+        const char *payload = batch_buffer;
+        int payload_len = len;
+        if (config.compress_min_len > 0 && len >= config.compress_min_len)
+        {
+            size_t compressed_len = payload_codec_compress(&codec_state, (const uint8_t *)batch_buffer, len,
+                                                           compressed_buffer, len - 1);
+            if (compressed_len > 0)
+            {
+                payload = (const char *)compressed_buffer;
+                payload_len = compressed_len;
+            }
+        }
+
+        int msg_id;
+        int64_t retry_us = 0;
+        if (is_alarm)
+            msg_id = clearblade_client_publish(dispatch_client, config.subtopic, payload, payload_len, config.qos);
+        else
+            msg_id = clearblade_client_try_publish(dispatch_client, config.subtopic, payload, payload_len, config.qos,
+                                                   TELEMETRY_DISPATCH_ALARM_RESERVE_MSGS,
+                                                   TELEMETRY_DISPATCH_ALARM_RESERVE_BYTES, &retry_us);
+        if (msg_id < 0 && retry_us > 0)
+            return retry_us;
+        if (msg_id < 0 && retry_us < 0 && taken > 1)
+        {
+            limit = taken / 2;
+            continue;
+        }
+        int64_t now_us = esp_timer_get_time();
+        // El costo de energia se reparte entre las muestras de rutina; las alarmas no lo son
+        if (msg_id >= 0 && queue == &queues[TELEMETRY_CLASS_BULK])
+            energy_meter.count_samples(taken);
+
+        lock();
+        if (msg_id < 0 && retry_us < 0)
+        {
+            // Si send() ya lo descarto no queda nada que sacar
+            if (queue->count > 0 && queue->first_seq == first_seq)
+                queue_pop(queue);
+            queue->stats.dropped++;
+            ESP_LOGW(TAG, "Mensaje de %d bytes mas grande que la rafaga del limitador, se descarta", payload_len);
+        }
+        else if (msg_id < 0)
+            queue->stats.publish_errors++;
+        else
+        {
+            // Los que send() descarto mientras se publicaba ya no estan en la cola
+            uint32_t published_seq = first_seq + taken;
+            while (queue->count > 0 && (int32_t)(queue->first_seq - published_seq) < 0)
+                queue_pop(queue);
+            queue->last_publish_us = now_us;
+            queue->stats.published += taken;
+            queue->stats.batches++;
+            queue->stats.raw_bytes += len;
+            queue->stats.sent_bytes += payload_len;
+            if (payload != batch_buffer)
+                queue->stats.compressed++;
+            uint32_t wait_us = (uint32_t)(now_us - oldest_us);
+            queue->stats.wait_us_total += wait_us;
+            if (wait_us > queue->stats.wait_us_max)
+                queue->stats.wait_us_max = wait_us;
+        }
+        if (queues_empty())
+        {
+            flush_requested = false;
+            xEventGroupSetBits(dispatch_events, DISPATCH_IDLE_BIT);
+        }
+        unlock();
+        return msg_id >= 0 || retry_us < 0 ? 0 : DISPATCH_PUBLISH_FAILED;
+    }
+}
+
+/* Las esperas tienen plazo: la tarea late en cada vuelta aunque no haya trabajo */
+static void dispatch_task(void *param)
+{
+    const TickType_t max_wait_ticks = pdMS_TO_TICKS(HEALTH_SUPERVISOR_WAIT_MS);
+    TickType_t wait_ticks = max_wait_ticks;
+    resource_monitor.register_task(NULL, "telemetry_dispatch", TELEMETRY_DISPATCH_TASK_STACK_SIZE);
+    int health_id = health_supervisor.register_task("telemetry_dispatch", HEALTH_SUPERVISOR_WAIT_MS);
+    for (;;)
+    {
+        xSemaphoreTake(work_semaphore, wait_ticks);
+        health_supervisor.beat(health_id);
+
+        // Sin conexion los mensajes esperan en la cola (la de rutina descarta los mas viejos)
+        if (!(xEventGroupWaitBits(dispatch_client->event_group, CONNECTED_TO_MQTT_BROKER, pdFALSE, pdTRUE, max_wait_ticks) &
+              CONNECTED_TO_MQTT_BROKER))
+        {
+            wait_ticks = 0;
+            continue;
+        }
+
+        // Un lote por vuelta, de la clase de mayor prioridad que este lista: despues
+        // de cada lote de rutina se vuelven a mirar las alarmas
+        wait_ticks = max_wait_ticks;
+        for (int cls = 0; cls < TELEMETRY_CLASS_COUNT; cls++)
+        {
+            lock();
+            int64_t due_us = queue_due_us(&queues[cls]);
+            unlock();
+            if (due_us == INT64_MAX)
+                continue;
+
+            int64_t now_us = esp_timer_get_time();
+            if (due_us <= now_us)
+            {
+                // Una clase que espera cuota o reintento no frena a las demas: queda
+                // con retry_at_us y la tarea sigue mirando las alarmas mientras tanto
+                int64_t retry_us = publish_batch(&queues[cls]);
+                if (retry_us == DISPATCH_PUBLISH_FAILED)
+                {
+                    ESP_LOGW(TAG, "No se pudo publicar en %s", queues[cls].config.subtopic);
+                    retry_us = DISPATCH_RETRY_MS * 1000LL;
+                }
+                lock();
+                queues[cls].retry_at_us = retry_us > 0 ? esp_timer_get_time() + retry_us : 0;
+                unlock();
+                wait_ticks = 0;
+                break;
+            }
+            TickType_t ticks = (due_us - now_us) / 1000 / portTICK_PERIOD_MS + 1;
+            if (ticks < wait_ticks)
+                wait_ticks = ticks;
+        }
+    }
+}
+
+/*****************************************************
+ *   API                                              *
+ ******************************************************/
+static void create_primitives(void)
+{
+    if (dispatch_mutex != NULL)
+        return;
+#ifdef STATIC_ALLOCATION_MODE
+    dispatch_mutex = xSemaphoreCreateMutexStatic(&dispatch_mutex_buffer);
+    work_semaphore = xSemaphoreCreateBinaryStatic(&work_semaphore_buffer);
+    dispatch_events = xEventGroupCreateStatic(&dispatch_events_buffer);
+#else
+    dispatch_mutex = xSemaphoreCreateMutex();
+    work_semaphore = xSemaphoreCreateBinary();
+    dispatch_events = xEventGroupCreate();
+#endif
+    xEventGroupSetBits(dispatch_events, DISPATCH_IDLE_BIT);
+}
+
+/* El subtopic debe seguir valido mientras se use la configuracion */
+static void set_class_config(telemetry_class_t cls, const telemetry_class_config_t *config)
+{
+    if (cls >= TELEMETRY_CLASS_COUNT)
+        return;
+    create_primitives();
+    lock();
+    queues[cls].config = *config;
+    if (queues[cls].config.batch_max == 0)
+        queues[cls].config.batch_max = 1;
+    unlock();
+    xSemaphoreGive(work_semaphore);
+}
+
+static esp_err_t start(clearblade_client_t *client)
+{
+    if (dispatch_task_handle != NULL)
+        return ESP_ERR_INVALID_STATE;
+    create_primitives();
+    dispatch_client = client;
+
+    // Por encima de la tarea de la aplicacion, para que una alarma salga apenas se encola
+#ifdef STATIC_ALLOCATION_MODE
+    dispatch_task_handle = xTaskCreateStatic(dispatch_task, "telemetry_dispatch", TELEMETRY_DISPATCH_TASK_STACK_SIZE, NULL, 4,
+                                             dispatch_task_stack, &dispatch_task_buffer);
+#else
+    if (xTaskCreate(dispatch_task, "telemetry_dispatch", TELEMETRY_DISPATCH_TASK_STACK_SIZE, NULL, 4, &dispatch_task_handle) != pdPASS)
+        dispatch_task_handle = NULL;
+#endif
+    if (dispatch_task_handle == NULL)
+        return ESP_ERR_NO_MEM;
+    ESP_LOGI(TAG, "Despacho de telemetria iniciado");
+    return ESP_OK;
+}
+
+static bool is_running(void)
+{
+    return dispatch_task_handle != NULL;
+}
+
+/************************************************************************/
+/* Copia el mensaje a la cola de la clase y despierta al despacho. Si   */
+/* la cola de rutina esta llena se descarta su mensaje mas viejo; si    */
+/* esta llena la de alarmas, se rechaza la nueva (ESP_ERR_NO_MEM).      */
+/************************************************************************/
+static esp_err_t send(telemetry_class_t cls, const char *data, int len)
+{
+    if (cls >= TELEMETRY_CLASS_COUNT || data == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (len <= 0)
+        len = strlen(data);
+    if (len > TELEMETRY_DISPATCH_MSG_MAX_LEN)
+        return ESP_ERR_INVALID_SIZE;
+    if (dispatch_task_handle == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    dispatch_queue_t *queue = &queues[cls];
+    lock();
+    if (queue->count == queue->depth)
+    {
+        queue->stats.dropped++;
+        if (cls == TELEMETRY_CLASS_ALARM)
+        {
+            unlock();
+            return ESP_ERR_NO_MEM;
+        }
+        queue_pop(queue);
+    }
+    dispatch_msg_t *msg = queue_at(queue, queue->count);
+    msg->queued_us = esp_timer_get_time();
+    msg->len = len;
+    memcpy(msg->data, data, len);
+    queue->count++;
+    queue->stats.queued++;
+    if (queue->count > queue->stats.max_depth)
+        queue->stats.max_depth = queue->count;
+    xEventGroupClearBits(dispatch_events, DISPATCH_IDLE_BIT);
+    unlock();
+
+    xSemaphoreGive(work_semaphore);
+    return ESP_OK;
+}
+
+static void flush(void)
+{
+    if (dispatch_task_handle == NULL)
+        return;
+    flush_requested = true;
+    xSemaphoreGive(work_semaphore);
+}
+
+static bool wait_idle(TickType_t ticks_to_wait)
+{
+    if (dispatch_events == NULL)
+        return true;
+    return (xEventGroupWaitBits(dispatch_events, DISPATCH_IDLE_BIT, pdFALSE, pdTRUE, ticks_to_wait) & DISPATCH_IDLE_BIT) != 0;
+}
+
+static void get_stats(telemetry_class_t cls, telemetry_dispatch_stats_t *stats)
+{
+    if (cls >= TELEMETRY_CLASS_COUNT || dispatch_mutex == NULL)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    lock();
+    *stats = queues[cls].stats;
+    stats->depth = queues[cls].count;
+    unlock();
+}
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)            *
+ ******************************************************/
+const telemetry_dispatch_t telemetry_dispatch = {
+    // Telemetry Dispatch Functions
+    .set_class_config = set_class_config,
+    .start = start,
+    .is_running = is_running,
+    .send = send,
+    .flush = flush,
+    .wait_idle = wait_idle,
+    .get_stats = get_stats,
+};
@@ -0,0 +1,106 @@
+/*
+ * telemetry_dispatch.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef TELEMETRY_DISPATCH_H_
+#define TELEMETRY_DISPATCH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "clearblade_connect.h"
+
+/* Capacidad de las colas. La de alarmas es corta: se vacia apenas hay conexion */
+#ifndef TELEMETRY_DISPATCH_ALARM_DEPTH
+#define TELEMETRY_DISPATCH_ALARM_DEPTH 4
+#endif
+#ifndef TELEMETRY_DISPATCH_BULK_DEPTH
+#define TELEMETRY_DISPATCH_BULK_DEPTH 16
+#endif
+/* Mensaje individual (mismo tamaño que el JSON de temp_sensor) y lote armado */
+#define TELEMETRY_DISPATCH_MSG_MAX_LEN 400
+#define TELEMETRY_DISPATCH_BATCH_MAX_LEN 1536
+#define TELEMETRY_DISPATCH_TASK_STACK_SIZE (4096 * 1)
+/* Los lotes de rutina desde este largo salen comprimidos (payload_codec.h) */
+#ifndef TELEMETRY_DISPATCH_COMPRESS_MIN_LEN
+#define TELEMETRY_DISPATCH_COMPRESS_MIN_LEN 512
+#endif
+
+/* Cuota del limitador de publicacion que la rutina deja libre para una */
+/* alarma: un lote de rutina espera antes que dejar sin lugar a la alarma */
+#ifndef TELEMETRY_DISPATCH_ALARM_RESERVE_MSGS
+#define TELEMETRY_DISPATCH_ALARM_RESERVE_MSGS 1
+#endif
+#ifndef TELEMETRY_DISPATCH_ALARM_RESERVE_BYTES
+#define TELEMETRY_DISPATCH_ALARM_RESERVE_BYTES (TELEMETRY_DISPATCH_MSG_MAX_LEN + 64)
+#endif
+
+/* Subtopics por defecto de cada clase */
+#define TELEMETRY_DISPATCH_ALARM_SUBTOPIC "events/alarm"
+#define TELEMETRY_DISPATCH_BULK_SUBTOPIC "events/batch"
+
+typedef enum
+{
+    TELEMETRY_CLASS_ALARM = 0, // Sale en cuanto llega, antes que cualquier lote
+    TELEMETRY_CLASS_BULK,      // Telemetria de rutina, en lotes y con limite de tasa
+    TELEMETRY_CLASS_COUNT
+} telemetry_class_t;
+
+typedef struct
+{
+    const char *subtopic;      // Debajo de /devices/<device-id>/
+    uint8_t qos;
+    uint8_t batch_max;         // Mensajes por publicacion; con 1 se publica el mensaje tal cual
+    uint32_t batch_max_age_ms; // Un lote incompleto sale cuando su mensaje mas viejo tiene esta edad
+    uint32_t min_interval_ms;  // Tiempo minimo entre dos publicaciones de la clase
+    uint16_t compress_min_len; // Publicaciones desde este largo van comprimidas; 0 = nunca
+} telemetry_class_config_t;
+
+typedef struct
+{
+    uint32_t queued;
+    uint32_t dropped;          // Alarmas: cola llena; rutina: se descarto el mas viejo. O no entraba en el limitador
+    uint32_t published;        // Mensajes (no lotes)
+    uint32_t publish_errors;
+    uint32_t batches;
+    uint32_t depth;            // Mensajes en cola ahora
+    uint32_t max_depth;
+    uint64_t wait_us_total;    // Tiempo en cola, de send() a la publicacion
+    uint32_t wait_us_max;
+    uint32_t compressed;       // Publicaciones que salieron comprimidas
+    uint64_t raw_bytes;        // Payloads publicados, antes y despues de comprimir
+    uint64_t sent_bytes;
+} telemetry_dispatch_stats_t;
+
+/************************************************************************/
+/* La siguiente estructura simula un objeto en C                        */
+/*                                                                      */
+/* Despacho de telemetria por clase de prioridad. Cada clase tiene su   */
+/* cola y su subtopic: las alarmas (events/alarm, QoS 1) salen de       */
+/* inmediato; la telemetria de rutina (events/batch, QoS 0) se junta    */
+/* en lotes JSON ([m1, m2, ...]) y se publica con un limite de tasa.    */
+/* Los lotes desde compress_min_len bytes salen comprimidos con         */
+/* payload_codec si eso los achica.                                     */
+/* Una tarea publica por el cliente Clearblade y antes de cada lote     */
+/* vacia la cola de alarmas, asi una alarma nunca espera detras de la   */
+/* telemetria encolada.                                                 */
+/************************************************************************/
+typedef struct
+{
+    // Telemetry Dispatch Functions
+    void (*set_class_config)(telemetry_class_t cls, const telemetry_class_config_t *config);
+    esp_err_t (*start)(clearblade_client_t *client);
+    bool (*is_running)(void);
+    esp_err_t (*send)(telemetry_class_t cls, const char *data, int len);
+    void (*flush)(void); // Publica los lotes incompletos sin esperar su edad
+    bool (*wait_idle)(TickType_t ticks_to_wait);
+    void (*get_stats)(telemetry_class_t cls, telemetry_dispatch_stats_t *stats);
+} telemetry_dispatch_t;
+
+extern const telemetry_dispatch_t telemetry_dispatch;
+
+#endif /* TELEMETRY_DISPATCH_H_ */
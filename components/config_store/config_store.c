@@ -0,0 +1,302 @@
+/*
+ * config_store.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <string.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "config_store.h"
+
+#define SCHEMA_VERSION_KEY "schema"
+
+static const char *TAG = "Config store";
+
+typedef enum
+{
+    CONFIG_TYPE_STR,
+    CONFIG_TYPE_U32,
+} config_type_t;
+
+/************************************************************************/
+/* Tabla de claves: nombre en NVS, tipo, ubicacion dentro de            */
+/* config_store_data_t y valor por defecto (solo para enteros).         */
+/* El orden debe coincidir con config_key_t.                            */
+/************************************************************************/
+typedef struct
+{
+    const char *nvs_key;
+    config_type_t type;
+    size_t offset;
+    size_t size;
+    uint32_t default_u32;
+} config_key_desc_t;
+
+#define CONFIG_FIELD(field) offsetof(config_store_data_t, field), sizeof(((config_store_data_t *)0)->field)
+
+static const config_key_desc_t config_keys[CONFIG_KEY_COUNT] = {
+    [CONFIG_KEY_STA_SSID] = {"sta_ssid", CONFIG_TYPE_STR, CONFIG_FIELD(sta_ssid), 0},
+    [CONFIG_KEY_STA_PASS] = {"sta_pass", CONFIG_TYPE_STR, CONFIG_FIELD(sta_pass), 0},
+};
+
+// Configuracion vigente (lecturas y escrituras pendientes).
+static config_store_data_t config;
+// Copia de lo que hay grabado en NVS, para calcular las diferencias en commit().
+static config_store_data_t persisted;
+
+static config_store_migration_t migration_hook = NULL;
+
+static StaticSemaphore_t config_mutex_buffer;
+static SemaphoreHandle_t config_mutex = NULL;
+
+static void lock(void)
+{
+    if (config_mutex == NULL)
+        config_mutex = xSemaphoreCreateMutexStatic(&config_mutex_buffer);
+    xSemaphoreTake(config_mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(config_mutex);
+}
+
+static inline void *field_ptr(config_store_data_t *data, config_key_t key)
+{
+    return (uint8_t *)data + config_keys[key].offset;
+}
+
+static void set_defaults(config_store_data_t *data)
+{
+    memset(data, 0, sizeof(*data));
+    for (int key = 0; key < CONFIG_KEY_COUNT; key++)
+    {
+        if (config_keys[key].type == CONFIG_TYPE_U32)
+            *(uint32_t *)field_ptr(data, key) = config_keys[key].default_u32;
+    }
+}
+
+static esp_err_t read_key(nvs_handle_t nvs, config_key_t key, config_store_data_t *data)
+{
+    const config_key_desc_t *desc = &config_keys[key];
+    size_t len = desc->size;
+
+    switch (desc->type)
+    {
+    case CONFIG_TYPE_STR:
+        return nvs_get_str(nvs, desc->nvs_key, (char *)field_ptr(data, key), &len);
+    case CONFIG_TYPE_U32:
+        return nvs_get_u32(nvs, desc->nvs_key, (uint32_t *)field_ptr(data, key));
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t write_key(nvs_handle_t nvs, config_key_t key, config_store_data_t *data)
+{
+    const config_key_desc_t *desc = &config_keys[key];
+
+    switch (desc->type)
+    {
+    case CONFIG_TYPE_STR:
+        return nvs_set_str(nvs, desc->nvs_key, (const char *)field_ptr(data, key));
+    case CONFIG_TYPE_U32:
+        return nvs_set_u32(nvs, desc->nvs_key, *(uint32_t *)field_ptr(data, key));
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+/************************************************************************/
+/* Si la version grabada es anterior a la actual, llama al hook de      */
+/* migracion y graba la nueva version.                                  */
+/************************************************************************/
+static esp_err_t migrate(uint16_t stored_version)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(CONFIG_STORE_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK)
+        return err;
+
+    ESP_LOGI(TAG, "Migrando configuracion de version %d a %d", stored_version, CONFIG_STORE_SCHEMA_VERSION);
+    if (migration_hook != NULL)
+        err = migration_hook(nvs, stored_version, CONFIG_STORE_SCHEMA_VERSION);
+
+    if (err == ESP_OK)
+        err = nvs_set_u16(nvs, SCHEMA_VERSION_KEY, CONFIG_STORE_SCHEMA_VERSION);
+    if (err == ESP_OK)
+        err = nvs_commit(nvs);
+
+    nvs_close(nvs);
+    return err;
+}
+
+static void set_migration_hook(config_store_migration_t hook)
+{
+    migration_hook = hook;
+}
+
+/************************************************************************/
+/* Carga todas las claves en RAM. Las que no existen en NVS toman su    */
+/* valor por defecto. Se llama una vez al arrancar, tras nvs_flash_init */
+/************************************************************************/
+static esp_err_t load(void)
+{
+    lock();
+    set_defaults(&config);
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(CONFIG_STORE_NAMESPACE, NVS_READONLY, &nvs);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+    {
+        // Namespace inexistente: primer arranque, todo queda por defecto.
+        ESP_LOGI(TAG, "Sin configuracion grabada, se usan valores por defecto.");
+        config.schema_version = CONFIG_STORE_SCHEMA_VERSION;
+        memcpy(&persisted, &config, sizeof(config));
+        persisted.schema_version = 0; // El primer commit() graba tambien la version
+        unlock();
+        return ESP_OK;
+    }
+    if (err != ESP_OK)
+    {
+        memcpy(&persisted, &config, sizeof(config));
+        unlock();
+        return err;
+    }
+
+    uint16_t stored_version = 0;
+    nvs_get_u16(nvs, SCHEMA_VERSION_KEY, &stored_version);
+    nvs_close(nvs);
+
+    if (stored_version < CONFIG_STORE_SCHEMA_VERSION)
+    {
+        err = migrate(stored_version);
+        if (err != ESP_OK)
+            ESP_LOGE(TAG, "Error en migracion: %s", esp_err_to_name(err));
+    }
+    else if (stored_version > CONFIG_STORE_SCHEMA_VERSION)
+    {
+        ESP_LOGW(TAG, "Version de configuracion %d mas nueva que el firmware (%d)", stored_version, CONFIG_STORE_SCHEMA_VERSION);
+    }
+    config.schema_version = CONFIG_STORE_SCHEMA_VERSION;
+
+    err = nvs_open(CONFIG_STORE_NAMESPACE, NVS_READONLY, &nvs);
+    if (err == ESP_OK)
+    {
+        for (int key = 0; key < CONFIG_KEY_COUNT; key++)
+        {
+            esp_err_t key_err = read_key(nvs, key, &config);
+            if (key_err == ESP_OK)
+                ESP_LOGI(TAG, "Param readed: %s", config_keys[key].nvs_key);
+            else if (key_err != ESP_ERR_NVS_NOT_FOUND)
+                ESP_LOGW(TAG, "Error leyendo %s: %s", config_keys[key].nvs_key, esp_err_to_name(key_err));
+        }
+        nvs_close(nvs);
+    }
+
+    memcpy(&persisted, &config, sizeof(config));
+    unlock();
+    return err;
+}
+
+static const config_store_data_t *get(void)
+{
+    return &config;
+}
+
+static esp_err_t set_str(config_key_t key, const char *value)
+{
+    if (key >= CONFIG_KEY_COUNT || config_keys[key].type != CONFIG_TYPE_STR || value == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (strlen(value) >= config_keys[key].size)
+        return ESP_ERR_INVALID_SIZE;
+
+    lock();
+    strcpy((char *)field_ptr(&config, key), value);
+    unlock();
+    return ESP_OK;
+}
+
+static esp_err_t set_u32(config_key_t key, uint32_t value)
+{
+    if (key >= CONFIG_KEY_COUNT || config_keys[key].type != CONFIG_TYPE_U32)
+        return ESP_ERR_INVALID_ARG;
+
+    lock();
+    *(uint32_t *)field_ptr(&config, key) = value;
+    unlock();
+    return ESP_OK;
+}
+
+/************************************************************************/
+/* Graba en NVS unicamente las claves que difieren de lo persistido.    */
+/* Si no hay cambios no abre el NVS ni escribe la flash.                */
+/************************************************************************/
+static esp_err_t commit(void)
+{
+    lock();
+
+    bool changed[CONFIG_KEY_COUNT];
+    int changed_count = 0;
+    for (int key = 0; key < CONFIG_KEY_COUNT; key++)
+    {
+        if (config_keys[key].type == CONFIG_TYPE_STR)
+            changed[key] = strcmp((char *)field_ptr(&config, key), (char *)field_ptr(&persisted, key)) != 0;
+        else
+            changed[key] = memcmp(field_ptr(&config, key), field_ptr(&persisted, key), config_keys[key].size) != 0;
+        changed_count += changed[key];
+    }
+
+    if (changed_count == 0)
+    {
+        unlock();
+        return ESP_OK;
+    }
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(CONFIG_STORE_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK)
+    {
+        unlock();
+        return err;
+    }
+
+    for (int key = 0; key < CONFIG_KEY_COUNT && err == ESP_OK; key++)
+    {
+        if (changed[key])
+        {
+            err = write_key(nvs, key, &config);
+            ESP_LOGI(TAG, "Param writed: %s", config_keys[key].nvs_key);
+        }
+    }
+    if (err == ESP_OK && persisted.schema_version != CONFIG_STORE_SCHEMA_VERSION)
+        err = nvs_set_u16(nvs, SCHEMA_VERSION_KEY, CONFIG_STORE_SCHEMA_VERSION);
+    if (err == ESP_OK)
+        err = nvs_commit(nvs);
+    nvs_close(nvs);
+
+    if (err == ESP_OK)
+        memcpy(&persisted, &config, sizeof(config));
+    else
+        ESP_LOGE(TAG, "Error grabando configuracion: %s", esp_err_to_name(err));
+
+    unlock();
+    return err;
+}
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)            *
+ ******************************************************/
+const config_store_t config_store = {
+    // Config Store Functions
+    .set_migration_hook = set_migration_hook,
+    .load = load,
+    .get = get,
+    .set_str = set_str,
+    .set_u32 = set_u32,
+    .commit = commit,
+};
@@ -0,0 +1,64 @@
+/*
+ * config_store.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef CONFIG_STORE_H_
+#define CONFIG_STORE_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "nvs.h"
+
+/* Se conserva el namespace de wfm_miscs para no perder credenciales ya grabadas */
+#define CONFIG_STORE_NAMESPACE "ESP32_WFM"
+
+/* Version del esquema de configuracion. Incrementar al agregar, quitar o cambiar */
+/* el significado de una clave, y contemplar la migracion en el hook.             */
+#define CONFIG_STORE_SCHEMA_VERSION 1
+
+#define CONFIG_STA_SSID_MAX_LEN 32
+#define CONFIG_STA_PASS_MAX_LEN 64
+
+/* Configuracion completa del dispositivo, cargada en RAM una sola vez al arrancar */
+typedef struct
+{
+    uint16_t schema_version;
+    char sta_ssid[CONFIG_STA_SSID_MAX_LEN + 1];
+    char sta_pass[CONFIG_STA_PASS_MAX_LEN + 1];
+} config_store_data_t;
+
+typedef enum
+{
+    CONFIG_KEY_STA_SSID = 0,
+    CONFIG_KEY_STA_PASS,
+    CONFIG_KEY_COUNT
+} config_key_t;
+
+/* Hook de migracion: se llama con el NVS abierto en escritura cuando la version */
+/* grabada es anterior a CONFIG_STORE_SCHEMA_VERSION (0 = claves sin esquema).    */
+typedef esp_err_t (*config_store_migration_t)(nvs_handle_t nvs, uint16_t from_version, uint16_t to_version);
+
+/************************************************************************/
+/* La siguiente estructura simula un objeto en C                        */
+/*                                                                      */
+/* Las lecturas se sirven desde RAM. Las escrituras quedan pendientes   */
+/* en RAM hasta commit(), que graba en NVS solo las claves que cambiaron */
+/* con un unico nvs_commit().                                           */
+/************************************************************************/
+typedef struct
+{
+    // Config Store Functions
+    void (*set_migration_hook)(config_store_migration_t hook);
+    esp_err_t (*load)(void);
+    const config_store_data_t *(*get)(void);
+    esp_err_t (*set_str)(config_key_t key, const char *value);
+    esp_err_t (*set_u32)(config_key_t key, uint32_t value);
+    esp_err_t (*commit)(void);
+} config_store_t;
+
+extern const config_store_t config_store;
+
+#endif /* CONFIG_STORE_H_ */
@@ -0,0 +1,682 @@
+/*
+ * deferred_log.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "deferred_log.h"
+#include "resource_monitor.h"
+
+#if (DEFERRED_LOG_SLOTS & (DEFERRED_LOG_SLOTS - 1)) != 0
+#error "DEFERRED_LOG_SLOTS debe ser potencia de 2"
+#endif
+#define SLOT_MASK (DEFERRED_LOG_SLOTS - 1)
+
+static const char *TAG = "Deferred log";
+
+/* Sitio de referencia del marco DEFERRED_LOG_FRAME_ANCHOR */
+const deferred_log_site_t deferred_log_anchor = {0, ESP_LOG_NONE, 0};
+
+/************************************************************************/
+/* Anillo acotado de varios productores y un consumidor (Vyukov). Cada  */
+/* lugar lleva un turno: los productores reservan una posicion con CAS  */
+/* y la publican al avanzar el turno; el consumidor lee solo los        */
+/* lugares publicados. turn guarda la secuencia menos el indice del     */
+/* lugar, asi el anillo en cero ya esta inicializado.                   */
+/************************************************************************/
+typedef struct
+{
+    atomic_uint turn;
+    uint32_t timestamp_ms;
+    const deferred_log_site_t *site;
+    const char *tag;
+    uint8_t len;
+    uint8_t payload[DEFERRED_LOG_PAYLOAD_MAX];
+} log_slot_t;
+
+static log_slot_t slots[DEFERRED_LOG_SLOTS];
+static atomic_uint enqueue_pos;
+static atomic_uint dequeue_pos;
+
+static atomic_uint written;
+static atomic_uint dropped;
+static atomic_uint truncated;
+static atomic_uint high_water;
+static uint32_t drained = 0;
+static uint32_t dropped_reported = 0;
+
+static volatile bool running = false;
+static deferred_log_sink_t sink = NULL;
+static void *sink_ctx = NULL;
+static bool anchor_sent = false;
+
+static SemaphoreHandle_t drain_mutex = NULL;
+static StaticSemaphore_t drain_mutex_buffer;
+static TaskHandle_t drain_task_handle = NULL;
+
+#ifdef STATIC_ALLOCATION_MODE
+static StackType_t drain_task_stack[DEFERRED_LOG_TASK_STACK_SIZE];
+static StaticTask_t drain_task_buffer;
+#endif
+
+/*****************************************************
+ *   Especificaciones de formato                      *
+ ******************************************************/
+typedef enum
+{
+    LENGTH_NONE = 0,
+    LENGTH_HH,
+    LENGTH_H,
+    LENGTH_L,
+    LENGTH_LL,
+    LENGTH_BIG_L,
+    LENGTH_Z,
+    LENGTH_J,
+    LENGTH_T,
+} length_t;
+
+typedef struct
+{
+    char flags[8];
+    bool width_star;
+    int width;          // -1 = sin ancho
+    bool precision_star;
+    int precision;      // -1 = sin precision
+    length_t length;
+    char conversion;
+} format_spec_t;
+
+/* p apunta al caracter siguiente al '%'; devuelve el siguiente a la especificacion */
+static const char *parse_spec(const char *p, format_spec_t *spec)
+{
+    memset(spec, 0, sizeof(*spec));
+    spec->width = -1;
+    spec->precision = -1;
+
+    size_t flag_count = 0;
+    while (*p != 0 && strchr("-+ #0", *p) != NULL)
+    {
+        if (flag_count < sizeof(spec->flags) - 1)
+            spec->flags[flag_count++] = *p;
+        p++;
+    }
+    if (*p == '*')
+    {
+        spec->width_star = true;
+        p++;
+    }
+    else if (*p >= '0' && *p <= '9')
+    {
+        spec->width = 0;
+        while (*p >= '0' && *p <= '9')
+            spec->width = spec->width * 10 + (*p++ - '0');
+    }
+    if (*p == '.')
+    {
+        p++;
+        spec->precision = 0;
+        if (*p == '*')
+        {
+            spec->precision_star = true;
+            p++;
+        }
+        while (*p >= '0' && *p <= '9')
+            spec->precision = spec->precision * 10 + (*p++ - '0');
+    }
+    switch (*p)
+    {
+    case 'h':
+        spec->length = p[1] == 'h' ? LENGTH_HH : LENGTH_H;
+        p += p[1] == 'h' ? 2 : 1;
+        break;
+    case 'l':
+        spec->length = p[1] == 'l' ? LENGTH_LL : LENGTH_L;
+        p += p[1] == 'l' ? 2 : 1;
+        break;
+    case 'L':
+        spec->length = LENGTH_BIG_L;
+        p++;
+        break;
+    case 'z':
+        spec->length = LENGTH_Z;
+        p++;
+        break;
+    case 'j':
+        spec->length = LENGTH_J;
+        p++;
+        break;
+    case 't':
+        spec->length = LENGTH_T;
+        p++;
+        break;
+    }
+    spec->conversion = *p;
+    return *p != 0 ? p + 1 : p;
+}
+
+static bool is_integer(char conversion)
+{
+    return conversion != 0 && strchr("diouxXc", conversion) != NULL;
+}
+
+static bool is_signed(char conversion)
+{
+    return conversion == 'd' || conversion == 'i';
+}
+
+static bool is_float(char conversion)
+{
+    return conversion != 0 && strchr("fFeEgGaA", conversion) != NULL;
+}
+
+/*****************************************************
+ *   Codificacion de los argumentos                   *
+ ******************************************************/
+typedef struct
+{
+    uint8_t *data;
+    size_t len;
+    bool truncated;
+} payload_writer_t;
+
+static bool put_value(payload_writer_t *writer, uint8_t type, const void *value, size_t size)
+{
+    if (writer->len + 1 + size > DEFERRED_LOG_PAYLOAD_MAX)
+    {
+        writer->truncated = true;
+        return false;
+    }
+    writer->data[writer->len++] = type;
+    memcpy(writer->data + writer->len, value, size); // Little endian en el ESP32 y en el host
+    writer->len += size;
+    return true;
+}
+
+static bool put_int(payload_writer_t *writer, int64_t value, size_t size)
+{
+    if (size <= 4)
+    {
+        int32_t narrow = (int32_t)value;
+        return put_value(writer, DEFERRED_LOG_ARG_I32, &narrow, 4);
+    }
+    return put_value(writer, DEFERRED_LOG_ARG_I64, &value, 8);
+}
+
+static bool put_string(payload_writer_t *writer, const char *text, int precision)
+{
+    if (text == NULL)
+        text = "(null)";
+    size_t len = strnlen(text, precision >= 0 ? (size_t)precision : 255);
+    if (writer->len + 2 > DEFERRED_LOG_PAYLOAD_MAX)
+    {
+        writer->truncated = true;
+        return false;
+    }
+    uint8_t type = DEFERRED_LOG_ARG_STR;
+    size_t room = DEFERRED_LOG_PAYLOAD_MAX - writer->len - 2;
+    if (len > room || (precision < 0 && text[len] != 0))
+    {
+        type |= DEFERRED_LOG_ARG_TRUNCATED;
+        writer->truncated = true;
+        if (len > room)
+            len = room;
+    }
+    writer->data[writer->len++] = type;
+    writer->data[writer->len++] = (uint8_t)len;
+    memcpy(writer->data + writer->len, text, len);
+    writer->len += len;
+    return true;
+}
+
+/* Toma los argumentos en el orden del formato; corta al llenarse el mensaje */
+static void encode_args(const char *format, va_list args, payload_writer_t *writer)
+{
+    for (const char *p = format; *p != 0;)
+    {
+        if (*p++ != '%')
+            continue;
+        if (*p == '%')
+        {
+            p++;
+            continue;
+        }
+        format_spec_t spec;
+        p = parse_spec(p, &spec);
+        bool ok = true;
+        if (spec.width_star)
+            ok = put_int(writer, va_arg(args, int), 4);
+        if (ok && spec.precision_star)
+        {
+            spec.precision = va_arg(args, int);
+            ok = put_int(writer, spec.precision, 4);
+        }
+        if (!ok)
+            return;
+
+        if (is_integer(spec.conversion))
+        {
+            switch (spec.length)
+            {
+            case LENGTH_L:
+                ok = put_int(writer, va_arg(args, long), sizeof(long));
+                break;
+            case LENGTH_LL:
+                ok = put_int(writer, va_arg(args, long long), 8);
+                break;
+            case LENGTH_J:
+                ok = put_int(writer, va_arg(args, intmax_t), 8);
+                break;
+            case LENGTH_Z:
+                ok = put_int(writer, (int64_t)va_arg(args, size_t), sizeof(size_t));
+                break;
+            case LENGTH_T:
+                ok = put_int(writer, va_arg(args, ptrdiff_t), sizeof(ptrdiff_t));
+                break;
+            default:
+                ok = put_int(writer, va_arg(args, int), 4);
+                break;
+            }
+        }
+        else if (is_float(spec.conversion))
+        {
+            double value = spec.length == LENGTH_BIG_L ? (double)va_arg(args, long double) : va_arg(args, double);
+            ok = put_value(writer, DEFERRED_LOG_ARG_F64, &value, 8);
+        }
+        else if (spec.conversion == 's')
+        {
+            ok = put_string(writer, va_arg(args, const char *), spec.precision);
+        }
+        else if (spec.conversion == 'p')
+        {
+            uint64_t value = (uintptr_t)va_arg(args, void *);
+            ok = put_value(writer, DEFERRED_LOG_ARG_PTR, &value, 8);
+        }
+        else if (spec.conversion == 'n')
+        {
+            (void)va_arg(args, void *);
+        }
+        if (!ok)
+            return;
+    }
+}
+
+/*****************************************************
+ *   Formateo                                         *
+ ******************************************************/
+typedef struct
+{
+    const uint8_t *data;
+    size_t len;
+    size_t offset;
+} payload_reader_t;
+
+static bool get_value(payload_reader_t *reader, uint8_t *type, uint64_t *value, const char **text, size_t *text_len)
+{
+    if (reader->offset >= reader->len)
+        return false;
+    *type = reader->data[reader->offset++];
+    switch (*type & ~DEFERRED_LOG_ARG_TRUNCATED)
+    {
+    case DEFERRED_LOG_ARG_I32:
+    {
+        uint32_t narrow;
+        if (reader->offset + 4 > reader->len)
+            return false;
+        memcpy(&narrow, reader->data + reader->offset, 4);
+        reader->offset += 4;
+        *value = narrow;
+        return true;
+    }
+    case DEFERRED_LOG_ARG_I64:
+    case DEFERRED_LOG_ARG_F64:
+    case DEFERRED_LOG_ARG_PTR:
+        if (reader->offset + 8 > reader->len)
+            return false;
+        memcpy(value, reader->data + reader->offset, 8);
+        reader->offset += 8;
+        return true;
+    case DEFERRED_LOG_ARG_STR:
+        if (reader->offset >= reader->len || reader->offset + 1 + reader->data[reader->offset] > reader->len)
+            return false;
+        *text_len = reader->data[reader->offset++];
+        *text = (const char *)reader->data + reader->offset;
+        reader->offset += *text_len;
+        return true;
+    }
+    return false;
+}
+
+static int get_int(payload_reader_t *reader, bool *ok)
+{
+    uint8_t type;
+    uint64_t value = 0;
+    const char *text;
+    size_t text_len;
+    *ok = get_value(reader, &type, &value, &text, &text_len) && type == DEFERRED_LOG_ARG_I32;
+    return (int32_t)value;
+}
+
+/* Escribe en out[*pos] sin pasarse de out_len; *pos cuenta lo que hubiera hecho falta */
+static void append_text(char *out, size_t out_len, size_t *pos, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(*pos < out_len ? out + *pos : NULL, *pos < out_len ? out_len - *pos : 0, fmt, args);
+    va_end(args);
+    if (n > 0)
+        *pos += n;
+}
+
+int deferred_log_format(const char *format, const uint8_t *payload, size_t payload_len, char *out, size_t out_len)
+{
+    payload_reader_t reader = {payload, payload_len, 0};
+    size_t pos = 0;
+    if (out_len > 0)
+        out[0] = 0;
+
+    for (const char *p = format; *p != 0;)
+    {
+        const char *literal = p;
+        while (*p != 0 && *p != '%')
+            p++;
+        if (p > literal)
+            append_text(out, out_len, &pos, "%.*s", (int)(p - literal), literal);
+        if (*p == 0)
+            break;
+        p++;
+        if (*p == '%')
+        {
+            append_text(out, out_len, &pos, "%%");
+            p++;
+            continue;
+        }
+
+        format_spec_t spec;
+        p = parse_spec(p, &spec);
+        bool ok = true;
+        if (spec.width_star)
+            spec.width = get_int(&reader, &ok);
+        if (ok && spec.precision_star)
+            spec.precision = get_int(&reader, &ok);
+        if (spec.conversion == 'n')
+            continue;
+
+        // La especificacion se rearma con los tamanos del host: enteros como long long
+        char piece[32];
+        int n = snprintf(piece, sizeof(piece), "%%%s", spec.flags);
+        if (spec.width >= 0)
+            n += snprintf(piece + n, sizeof(piece) - n, "%d", spec.width);
+        if (spec.precision >= 0 && spec.conversion != 's')
+            n += snprintf(piece + n, sizeof(piece) - n, ".%d", spec.precision);
+
+        uint8_t type = 0;
+        uint64_t value = 0;
+        const char *text = NULL;
+        size_t text_len = 0;
+        if (!ok || !get_value(&reader, &type, &value, &text, &text_len))
+        {
+            append_text(out, out_len, &pos, "<?>");
+            break;
+        }
+        uint8_t base_type = type & ~DEFERRED_LOG_ARG_TRUNCATED;
+
+        if (is_integer(spec.conversion) && (base_type == DEFERRED_LOG_ARG_I32 || base_type == DEFERRED_LOG_ARG_I64))
+        {
+            if (spec.conversion == 'c')
+            {
+                snprintf(piece + n, sizeof(piece) - n, "c");
+                append_text(out, out_len, &pos, piece, (int)value);
+                continue;
+            }
+            snprintf(piece + n, sizeof(piece) - n, "ll%c", spec.conversion);
+            if (base_type == DEFERRED_LOG_ARG_I32)
+                value = is_signed(spec.conversion) ? (uint64_t)(int64_t)(int32_t)value : (uint32_t)value;
+            if (is_signed(spec.conversion))
+                append_text(out, out_len, &pos, piece, (long long)value);
+            else
+                append_text(out, out_len, &pos, piece, (unsigned long long)value);
+        }
+        else if (is_float(spec.conversion) && base_type == DEFERRED_LOG_ARG_F64)
+        {
+            double number;
+            memcpy(&number, &value, sizeof(number));
+            snprintf(piece + n, sizeof(piece) - n, "%c", spec.conversion);
+            append_text(out, out_len, &pos, piece, number);
+        }
+        else if (spec.conversion == 's' && base_type == DEFERRED_LOG_ARG_STR)
+        {
+            snprintf(piece + n, sizeof(piece) - n, ".*s%s", (type & DEFERRED_LOG_ARG_TRUNCATED) ? "~" : "");
+            append_text(out, out_len, &pos, piece, (int)text_len, text);
+        }
+        else if (spec.conversion == 'p' && base_type == DEFERRED_LOG_ARG_PTR)
+        {
+            append_text(out, out_len, &pos, "0x%llx", (unsigned long long)value);
+        }
+        else
+        {
+            append_text(out, out_len, &pos, "<?>");
+            break;
+        }
+    }
+    return (int)pos;
+}
+
+/*****************************************************
+ *   Productores                                      *
+ ******************************************************/
+static const char level_letters[] = "NEWIDV";
+
+/* Antes de start(): se escribe en el momento, como ESP_LOGx */
+static void write_now(const deferred_log_site_t *site, const char *tag, va_list args)
+{
+    char line[DEFERRED_LOG_LINE_MAX];
+    vsnprintf(line, sizeof(line), DEFERRED_LOG_SITE_FORMAT(site), args);
+    esp_log_write((esp_log_level_t)site->level, tag, "%c (%lu) %s: %s\n", level_letters[site->level % 6],
+                  (unsigned long)esp_log_timestamp(), tag, line);
+}
+
+void deferred_log_write(const deferred_log_site_t *site, const char *tag, ...)
+{
+    va_list args;
+    va_start(args, tag);
+    if (!running)
+    {
+        write_now(site, tag, args);
+        va_end(args);
+        return;
+    }
+
+    unsigned pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    log_slot_t *slot;
+    while (true)
+    {
+        slot = &slots[pos & SLOT_MASK];
+        unsigned turn = atomic_load_explicit(&slot->turn, memory_order_acquire);
+        int diff = (int)(turn - (pos & ~SLOT_MASK));
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // Lleno: el consumidor no libero este lugar en la vuelta anterior
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            va_end(args);
+            return;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    payload_writer_t writer = {slot->payload, 0, false};
+    encode_args(DEFERRED_LOG_SITE_FORMAT(site), args, &writer);
+    va_end(args);
+    slot->timestamp_ms = esp_log_timestamp();
+    slot->site = site;
+    slot->tag = tag;
+    slot->len = (uint8_t)writer.len;
+    atomic_store_explicit(&slot->turn, (pos & ~SLOT_MASK) + 1, memory_order_release);
+
+    atomic_fetch_add_explicit(&written, 1, memory_order_relaxed);
+    if (writer.truncated)
+        atomic_fetch_add_explicit(&truncated, 1, memory_order_relaxed);
+    unsigned used = pos + 1 - atomic_load_explicit(&dequeue_pos, memory_order_relaxed);
+    unsigned seen = atomic_load_explicit(&high_water, memory_order_relaxed);
+    while (used > seen && !atomic_compare_exchange_weak_explicit(&high_water, &seen, used, memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+/*****************************************************
+ *   Consumidor                                       *
+ ******************************************************/
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void put_u64(uint8_t *p, uint64_t v)
+{
+    put_u32(p, (uint32_t)v);
+    put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static void send_frame(uint8_t kind, uint8_t level, uint32_t timestamp_ms, const void *site, const char *tag,
+                       const uint8_t *payload, uint8_t len)
+{
+    uint8_t frame[DEFERRED_LOG_FRAME_MAX];
+    frame[0] = kind;
+    frame[1] = len;
+    frame[2] = level;
+    frame[3] = 0;
+    put_u32(frame + 4, timestamp_ms);
+    put_u64(frame + 8, (uintptr_t)site);
+    put_u64(frame + 16, (uintptr_t)tag);
+    memcpy(frame + DEFERRED_LOG_FRAME_HEADER, payload, len);
+    sink(frame, DEFERRED_LOG_FRAME_HEADER + len, sink_ctx);
+}
+
+static void emit(const log_slot_t *slot)
+{
+    if (sink != NULL)
+    {
+        if (!anchor_sent)
+        {
+            send_frame(DEFERRED_LOG_FRAME_ANCHOR, 0, 0, &deferred_log_anchor, NULL, NULL, 0);
+            anchor_sent = true;
+        }
+        send_frame(DEFERRED_LOG_FRAME_MSG, slot->site->level, slot->timestamp_ms, slot->site, slot->tag, slot->payload, slot->len);
+        return;
+    }
+    char line[DEFERRED_LOG_LINE_MAX];
+    deferred_log_format(DEFERRED_LOG_SITE_FORMAT(slot->site), slot->payload, slot->len, line, sizeof(line));
+    esp_log_write((esp_log_level_t)slot->site->level, slot->tag, "%c (%lu) %s: %s\n", level_letters[slot->site->level % 6],
+                  (unsigned long)slot->timestamp_ms, slot->tag, line);
+}
+
+/* Un solo consumidor: la tarea y flush() se turnan con drain_mutex */
+static void drain(void)
+{
+    xSemaphoreTake(drain_mutex, portMAX_DELAY);
+    unsigned pos = atomic_load_explicit(&dequeue_pos, memory_order_relaxed);
+    while (true)
+    {
+        log_slot_t *slot = &slots[pos & SLOT_MASK];
+        unsigned turn = atomic_load_explicit(&slot->turn, memory_order_acquire);
+        if (turn != (pos & ~SLOT_MASK) + 1)
+            break;
+        emit(slot);
+        atomic_store_explicit(&slot->turn, (pos & ~SLOT_MASK) + DEFERRED_LOG_SLOTS, memory_order_release);
+        pos++;
+        atomic_store_explicit(&dequeue_pos, pos, memory_order_relaxed);
+        drained++;
+    }
+
+    uint32_t lost = atomic_load_explicit(&dropped, memory_order_relaxed);
+    if (lost != dropped_reported)
+    {
+        esp_log_write(ESP_LOG_WARN, TAG, "W (%lu) %s: %lu mensajes descartados, anillo lleno\n",
+                      (unsigned long)esp_log_timestamp(), TAG, (unsigned long)(lost - dropped_reported));
+        dropped_reported = lost;
+    }
+    xSemaphoreGive(drain_mutex);
+}
+
+static void drain_task(void *param)
+{
+    resource_monitor.register_task(NULL, "deferred_log", DEFERRED_LOG_TASK_STACK_SIZE);
+    while (true)
+    {
+        drain();
+        vTaskDelay(DEFERRED_LOG_DRAIN_PERIOD_MS / portTICK_PERIOD_MS > 0 ? DEFERRED_LOG_DRAIN_PERIOD_MS / portTICK_PERIOD_MS : 1);
+    }
+}
+
+static esp_err_t start(void)
+{
+    if (drain_task_handle != NULL)
+        return ESP_ERR_INVALID_STATE;
+    drain_mutex = xSemaphoreCreateMutexStatic(&drain_mutex_buffer);
+
+#ifdef STATIC_ALLOCATION_MODE
+    drain_task_handle = xTaskCreateStatic(drain_task, "deferred_log", DEFERRED_LOG_TASK_STACK_SIZE, NULL,
+                                          DEFERRED_LOG_TASK_PRIORITY, drain_task_stack, &drain_task_buffer);
+#else
+    if (xTaskCreate(drain_task, "deferred_log", DEFERRED_LOG_TASK_STACK_SIZE, NULL, DEFERRED_LOG_TASK_PRIORITY,
+                    &drain_task_handle) != pdPASS)
+        drain_task_handle = NULL;
+#endif
+    if (drain_task_handle == NULL)
+        return ESP_ERR_NO_MEM;
+    running = true;
+    return ESP_OK;
+}
+
+/* El sink se fija antes de start(): la tarea lo lee sin sincronizar */
+static void set_sink(deferred_log_sink_t new_sink, void *ctx)
+{
+    sink_ctx = ctx;
+    sink = new_sink;
+    anchor_sent = false;
+}
+
+static void flush(void)
+{
+    if (drain_mutex != NULL)
+        drain();
+}
+
+static void get_stats(deferred_log_stats_t *stats)
+{
+    stats->written = atomic_load(&written);
+    stats->dropped = atomic_load(&dropped);
+    stats->truncated = atomic_load(&truncated);
+    stats->drained = drained;
+    stats->high_water = atomic_load(&high_water);
+}
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)            *
+ ******************************************************/
+const deferred_log_t deferred_log = {
+    // Deferred Log Functions
+    .start = start,
+    .set_sink = set_sink,
+    .flush = flush,
+    .get_stats = get_stats,
+};
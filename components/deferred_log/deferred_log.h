@@ -0,0 +1,147 @@
+/*
+ * deferred_log.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef DEFERRED_LOG_H_
+#define DEFERRED_LOG_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_log.h"
+
+/************************************************************************/
+/* Nivel de compilacion. Cada modulo puede definir                      */
+/* DEFERRED_LOG_LOCAL_LEVEL antes de incluir este archivo; los mensajes */
+/* de mas detalle no se compilan (ni el formato ni los argumentos).     */
+/************************************************************************/
+#ifndef DEFERRED_LOG_DEFAULT_LEVEL
+#define DEFERRED_LOG_DEFAULT_LEVEL ESP_LOG_INFO
+#endif
+#ifndef DEFERRED_LOG_LOCAL_LEVEL
+#define DEFERRED_LOG_LOCAL_LEVEL DEFERRED_LOG_DEFAULT_LEVEL
+#endif
+
+/* Anillo: DEFERRED_LOG_SLOTS mensajes (potencia de 2) con hasta         */
+/* DEFERRED_LOG_PAYLOAD_MAX bytes de argumentos cada uno                 */
+#ifndef DEFERRED_LOG_SLOTS
+#define DEFERRED_LOG_SLOTS 32
+#endif
+#ifndef DEFERRED_LOG_PAYLOAD_MAX
+#define DEFERRED_LOG_PAYLOAD_MAX 100
+#endif
+#define DEFERRED_LOG_LINE_MAX 256
+
+#define DEFERRED_LOG_TASK_STACK_SIZE (4096 * 1)
+#define DEFERRED_LOG_TASK_PRIORITY 1
+#define DEFERRED_LOG_DRAIN_PERIOD_MS 20
+
+/************************************************************************/
+/* Cada llamada tiene un sitio constante en flash: nivel, linea y el    */
+/* formato a continuacion. El anillo guarda la direccion del sitio, la  */
+/* del tag y los argumentos crudos; el texto se arma despues, en la     */
+/* tarea de vaciado o en el host (host/replay/dlog_decode.c). El sitio  */
+/* no tiene punteros, asi que el decodificador lo lee del ELF tal cual. */
+/************************************************************************/
+typedef struct
+{
+    uint16_t line;
+    uint8_t level;
+    uint8_t reserved;
+    // Sigue el formato, terminado en 0
+} deferred_log_site_t;
+
+#define DEFERRED_LOG_SITE_FORMAT(site) ((const char *)((const deferred_log_site_t *)(site) + 1))
+
+/* Argumentos en el anillo: un byte de tipo y el valor */
+#define DEFERRED_LOG_ARG_I32 1
+#define DEFERRED_LOG_ARG_I64 2
+#define DEFERRED_LOG_ARG_F64 3
+#define DEFERRED_LOG_ARG_STR 4 // u8 largo y los caracteres, sin el 0
+#define DEFERRED_LOG_ARG_PTR 5
+#define DEFERRED_LOG_ARG_TRUNCATED 0x80 // Cadena cortada para entrar en el mensaje
+
+/************************************************************************/
+/* Formato binario (set_sink). Un marco por mensaje, little endian:     */
+/*   u8 DEFERRED_LOG_FRAME_MSG, u8 largo de los argumentos, u8 nivel,   */
+/*   u8 0, u32 ms desde el arranque, u64 sitio, u64 tag, argumentos     */
+/* El primer marco es DEFERRED_LOG_FRAME_ANCHOR con la direccion de     */
+/* deferred_log_anchor en "sitio": con ella el decodificador corrige    */
+/* el desplazamiento de carga de un ejecutable PIE (0 en el ESP32).     */
+/************************************************************************/
+#define DEFERRED_LOG_FRAME_MSG 0xD1
+#define DEFERRED_LOG_FRAME_ANCHOR 0xD0
+#define DEFERRED_LOG_FRAME_HEADER 24
+#define DEFERRED_LOG_FRAME_MAX (DEFERRED_LOG_FRAME_HEADER + DEFERRED_LOG_PAYLOAD_MAX)
+
+typedef void (*deferred_log_sink_t)(const uint8_t *frame, size_t len, void *ctx);
+
+typedef struct
+{
+    uint32_t written;
+    uint32_t dropped;    // Anillo lleno
+    uint32_t truncated;  // Argumentos que no entraron
+    uint32_t drained;
+    uint32_t high_water; // Maxima ocupacion del anillo
+} deferred_log_stats_t;
+
+/************************************************************************/
+/* La siguiente estructura simula un objeto en C                        */
+/*                                                                      */
+/* Log diferido: la llamada solo copia los argumentos a un anillo sin   */
+/* bloqueos (varios productores, tareas o interrupciones, y un          */
+/* consumidor) y una tarea de baja prioridad los formatea y escribe por */
+/* esp_log_write(). Antes de start() los mensajes se escriben en el     */
+/* momento, como con ESP_LOGx. Si el anillo se llena el mensaje se      */
+/* descarta y se cuenta: el que llama nunca espera.                     */
+/************************************************************************/
+typedef struct
+{
+    // Deferred Log Functions
+    esp_err_t (*start)(void);
+    /* Con sink, la tarea entrega marcos binarios en lugar de texto */
+    void (*set_sink)(deferred_log_sink_t sink, void *ctx);
+    void (*flush)(void); // Vacia el anillo desde la tarea que llama (antes del deep sleep)
+    void (*get_stats)(deferred_log_stats_t *stats);
+} deferred_log_t;
+
+extern const deferred_log_t deferred_log;
+
+extern const deferred_log_site_t deferred_log_anchor;
+
+void deferred_log_write(const deferred_log_site_t *site, const char *tag, ...);
+/* Arma el texto de un mensaje a partir del formato y los argumentos    */
+/* crudos; compartido con el decodificador del host. Devuelve el largo. */
+int deferred_log_format(const char *format, const uint8_t *payload, size_t payload_len, char *out, size_t out_len);
+
+static inline __attribute__((format(printf, 1, 2))) void deferred_log_check_format(const char *format, ...)
+{
+}
+
+#define DEFERRED_LOG_AT(level, tag, format, ...)                                                   \
+    do                                                                                             \
+    {                                                                                              \
+        if ((level) <= DEFERRED_LOG_LOCAL_LEVEL)                                                   \
+        {                                                                                          \
+            static const struct                                                                    \
+            {                                                                                      \
+                deferred_log_site_t site;                                                          \
+                char format_text[sizeof(format)];                                                  \
+            } deferred_log_site_ = {{__LINE__, (level), 0}, format};                               \
+            if (0)                                                                                 \
+                deferred_log_check_format(format, ##__VA_ARGS__);                                  \
+            deferred_log_write(&deferred_log_site_.site, tag, ##__VA_ARGS__);                      \
+        }                                                                                          \
+    } while (0)
+
+#define DLOGE(tag, format, ...) DEFERRED_LOG_AT(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define DLOGW(tag, format, ...) DEFERRED_LOG_AT(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define DLOGI(tag, format, ...) DEFERRED_LOG_AT(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define DLOGD(tag, format, ...) DEFERRED_LOG_AT(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define DLOGV(tag, format, ...) DEFERRED_LOG_AT(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+#endif /* DEFERRED_LOG_H_ */
@@ -0,0 +1,259 @@
+/*
+ * delta_patch.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <string.h>
+
+#include "delta_patch.h"
+
+_Static_assert(DELTA_PATCH_BUFFER_SIZE >= DELTA_PATCH_HEADER_LEN, "la cabecera se arma en el buffer");
+
+enum
+{
+    STATE_HEADER = 0,
+    STATE_OP,
+    STATE_ARG,
+    STATE_ADD,
+    STATE_INSERT,
+};
+
+static void put_u32(uint8_t *out, uint32_t value)
+{
+    out[0] = value;
+    out[1] = value >> 8;
+    out[2] = value >> 16;
+    out[3] = value >> 24;
+}
+
+static uint32_t get_u32(const uint8_t *in)
+{
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+void delta_patch_write_header(uint8_t *out, const delta_patch_header_t *header)
+{
+    memset(out, 0, DELTA_PATCH_HEADER_LEN);
+    memcpy(out, DELTA_PATCH_MAGIC, 4);
+    out[4] = DELTA_PATCH_VERSION;
+    put_u32(out + 8, header->old_size);
+    put_u32(out + 12, header->new_size);
+    memcpy(out + 16, header->old_sha256, DELTA_PATCH_HASH_LEN);
+    memcpy(out + 16 + DELTA_PATCH_HASH_LEN, header->new_sha256, DELTA_PATCH_HASH_LEN);
+}
+
+bool delta_patch_parse_header(const uint8_t *in, delta_patch_header_t *header)
+{
+    if (memcmp(in, DELTA_PATCH_MAGIC, 4) != 0 || in[4] != DELTA_PATCH_VERSION)
+        return false;
+    header->old_size = get_u32(in + 8);
+    header->new_size = get_u32(in + 12);
+    memcpy(header->old_sha256, in + 16, DELTA_PATCH_HASH_LEN);
+    memcpy(header->new_sha256, in + 16 + DELTA_PATCH_HASH_LEN, DELTA_PATCH_HASH_LEN);
+    return true;
+}
+
+void delta_patch_init(delta_patch_t *patch, const delta_patch_io_t *io)
+{
+    memset(patch, 0, sizeof(*patch));
+    patch->io = *io;
+    patch->state = STATE_HEADER;
+    patch->result = DELTA_PATCH_MORE;
+}
+
+static bool flush(delta_patch_t *patch)
+{
+    if (patch->buffered == 0)
+        return true;
+    if (patch->io.write_new(patch->buffer, patch->buffered, patch->io.ctx) != 0)
+        return false;
+    patch->buffered = 0;
+    return true;
+}
+
+/* Trae n bytes de la vieja al final del buffer (COPY y ADD) */
+static bool read_old(delta_patch_t *patch, size_t n)
+{
+    if (patch->io.read_old(patch->old_pos, patch->buffer + patch->buffered, n, patch->io.ctx) != 0)
+        return false;
+    patch->old_pos += n;
+    return true;
+}
+
+static int fail(delta_patch_t *patch, int result)
+{
+    patch->result = result;
+    return result;
+}
+
+/* Ejecuta la operacion cuyo argumento se termino de leer */
+static int run_op(delta_patch_t *patch)
+{
+    uint32_t arg = patch->arg;
+    uint32_t old_left = patch->header.old_size - patch->old_pos;
+    uint32_t new_left = patch->header.new_size - patch->new_pos;
+
+    patch->state = STATE_OP;
+    switch (patch->op)
+    {
+    case DELTA_PATCH_OP_COPY:
+        if (arg > old_left || arg > new_left)
+            return fail(patch, DELTA_PATCH_ERR_CORRUPT);
+        patch->stats.copied += arg;
+        while (arg > 0)
+        {
+            size_t n = DELTA_PATCH_BUFFER_SIZE - patch->buffered;
+            if (n > arg)
+                n = arg;
+            if (!read_old(patch, n))
+                return fail(patch, DELTA_PATCH_ERR_IO);
+            patch->buffered += n;
+            patch->new_pos += n;
+            arg -= n;
+            if (patch->buffered == DELTA_PATCH_BUFFER_SIZE && !flush(patch))
+                return fail(patch, DELTA_PATCH_ERR_IO);
+        }
+        break;
+    case DELTA_PATCH_OP_ADD:
+        if (arg > old_left || arg > new_left)
+            return fail(patch, DELTA_PATCH_ERR_CORRUPT);
+        patch->stats.added += arg;
+        patch->remaining = arg;
+        if (arg > 0)
+            patch->state = STATE_ADD;
+        break;
+    case DELTA_PATCH_OP_INSERT:
+        if (arg > new_left)
+            return fail(patch, DELTA_PATCH_ERR_CORRUPT);
+        patch->stats.inserted += arg;
+        patch->remaining = arg;
+        if (arg > 0)
+            patch->state = STATE_INSERT;
+        break;
+    case DELTA_PATCH_OP_SEEK:
+    {
+        int64_t pos = (int64_t)patch->old_pos + (int32_t)((arg >> 1) ^ -(arg & 1));
+        if (pos < 0 || pos > patch->header.old_size)
+            return fail(patch, DELTA_PATCH_ERR_CORRUPT);
+        patch->old_pos = (uint32_t)pos;
+        break;
+    }
+    }
+    return DELTA_PATCH_MORE;
+}
+
+int delta_patch_feed(delta_patch_t *patch, const uint8_t *data, size_t len)
+{
+    if (patch->result == DELTA_PATCH_DONE && len > 0)
+        patch->result = DELTA_PATCH_ERR_CORRUPT;
+    size_t i = 0;
+    while (i < len && patch->result == DELTA_PATCH_MORE)
+    {
+        switch (patch->state)
+        {
+        case STATE_HEADER:
+        {
+            size_t n = DELTA_PATCH_HEADER_LEN - patch->buffered;
+            if (n > len - i)
+                n = len - i;
+            memcpy(patch->buffer + patch->buffered, data + i, n);
+            patch->buffered += n;
+            i += n;
+            if (patch->buffered < DELTA_PATCH_HEADER_LEN)
+                break;
+            patch->buffered = 0;
+            if (!delta_patch_parse_header(patch->buffer, &patch->header))
+                return fail(patch, DELTA_PATCH_ERR_FORMAT);
+            if (patch->io.header != NULL && patch->io.header(&patch->header, patch->io.ctx) != 0)
+                return fail(patch, DELTA_PATCH_ERR_ABORTED);
+            patch->state = STATE_OP;
+            break;
+        }
+        case STATE_OP:
+            patch->op = data[i++];
+            patch->stats.ops++;
+            if (patch->op == DELTA_PATCH_OP_END)
+            {
+                if (patch->new_pos != patch->header.new_size)
+                    return fail(patch, DELTA_PATCH_ERR_CORRUPT);
+                if (!flush(patch))
+                    return fail(patch, DELTA_PATCH_ERR_IO);
+                patch->result = DELTA_PATCH_DONE;
+            }
+            else if (patch->op <= DELTA_PATCH_OP_SEEK)
+            {
+                patch->arg = 0;
+                patch->arg_shift = 0;
+                patch->state = STATE_ARG;
+            }
+            else
+                return fail(patch, DELTA_PATCH_ERR_CORRUPT);
+            break;
+        case STATE_ARG:
+        {
+            uint8_t byte = data[i++];
+            if (patch->arg_shift > 28 || (patch->arg_shift == 28 && (byte & 0x70) != 0))
+                return fail(patch, DELTA_PATCH_ERR_CORRUPT);
+            patch->arg |= (uint32_t)(byte & 0x7F) << patch->arg_shift;
+            patch->arg_shift += 7;
+            if ((byte & 0x80) == 0)
+                run_op(patch);
+            break;
+        }
+        case STATE_ADD:
+        case STATE_INSERT:
+        {
+            size_t n = DELTA_PATCH_BUFFER_SIZE - patch->buffered;
+            if (n > patch->remaining)
+                n = patch->remaining;
+            if (n > len - i)
+                n = len - i;
+            uint8_t *out = patch->buffer + patch->buffered;
+            if (patch->state == STATE_ADD)
+            {
+                if (!read_old(patch, n))
+                    return fail(patch, DELTA_PATCH_ERR_IO);
+                for (size_t k = 0; k < n; k++)
+                    out[k] += data[i + k];
+            }
+            else
+                memcpy(out, data + i, n);
+            patch->buffered += n;
+            patch->new_pos += n;
+            patch->remaining -= n;
+            i += n;
+            if (patch->buffered == DELTA_PATCH_BUFFER_SIZE && !flush(patch))
+                return fail(patch, DELTA_PATCH_ERR_IO);
+            if (patch->remaining == 0)
+                patch->state = STATE_OP;
+            break;
+        }
+        }
+    }
+    if (patch->result == DELTA_PATCH_DONE && i < len)
+        patch->result = DELTA_PATCH_ERR_CORRUPT;
+    return patch->result;
+}
+
+const char *delta_patch_strerror(int result)
+{
+    switch (result)
+    {
+    case DELTA_PATCH_MORE:
+        return "incompleto";
+    case DELTA_PATCH_DONE:
+        return "completo";
+    case DELTA_PATCH_ERR_FORMAT:
+        return "no es un parche de esta version";
+    case DELTA_PATCH_ERR_CORRUPT:
+        return "parche corrupto";
+    case DELTA_PATCH_ERR_IO:
+        return "error de lectura o escritura";
+    case DELTA_PATCH_ERR_ABORTED:
+        return "cabecera rechazada";
+    default:
+        return "desconocido";
+    }
+}
@@ -0,0 +1,119 @@
+/*
+ * delta_patch.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef DELTA_PATCH_H_
+#define DELTA_PATCH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/************************************************************************/
+/* Formato del parche (todo little endian):                             */
+/*                                                                      */
+/*   "DPT1", u8 version, 3 bytes en 0, u32 tamano de la imagen vieja,   */
+/*   u32 tamano de la nueva, sha256 de la vieja, sha256 de la nueva     */
+/*                                                                      */
+/* y despues una serie de operaciones sobre dos cursores, uno en la     */
+/* imagen vieja y otro en la nueva (que solo avanza):                   */
+/*                                                                      */
+/*   COPY n    copia n bytes de la vieja                                */
+/*   ADD n d   n bytes de la vieja mas los n bytes de d (modulo 256):   */
+/*             codigo que solo cambio en direcciones desplazadas        */
+/*   INSERT n d  n bytes literales                                      */
+/*   SEEK s    mueve el cursor de la vieja s bytes (con signo)          */
+/*   END       la nueva tiene que estar completa                        */
+/*                                                                      */
+/* Los largos van como varints (LEB128) y el salto de SEEK en zigzag.   */
+/* Es la idea de bsdiff sin la compresion de los bloques: el aplicador  */
+/* lee la vieja en el orden que pide el parche y escribe la nueva en    */
+/* orden, con un solo buffer de DELTA_PATCH_BUFFER_SIZE.                */
+/************************************************************************/
+#define DELTA_PATCH_MAGIC "DPT1"
+#define DELTA_PATCH_VERSION 1
+#define DELTA_PATCH_HEADER_LEN 80
+#define DELTA_PATCH_HASH_LEN 32
+
+#define DELTA_PATCH_OP_END 0x00
+#define DELTA_PATCH_OP_COPY 0x01
+#define DELTA_PATCH_OP_ADD 0x02
+#define DELTA_PATCH_OP_INSERT 0x03
+#define DELTA_PATCH_OP_SEEK 0x04
+
+/* Escrituras de la imagen nueva en bloques de hasta este tamano */
+#ifndef DELTA_PATCH_BUFFER_SIZE
+#define DELTA_PATCH_BUFFER_SIZE 1024
+#endif
+
+typedef enum
+{
+    DELTA_PATCH_MORE = 0,         // Falta parche
+    DELTA_PATCH_DONE = 1,         // Llego END y la imagen nueva esta completa
+    DELTA_PATCH_ERR_FORMAT = -1,  // Magic o version desconocidos
+    DELTA_PATCH_ERR_CORRUPT = -2, // Operacion invalida, fuera de rango o datos tras END
+    DELTA_PATCH_ERR_IO = -3,      // Fallo una lectura o escritura
+    DELTA_PATCH_ERR_ABORTED = -4, // El callback de la cabecera la rechazo
+} delta_patch_result_t;
+
+typedef struct
+{
+    uint32_t old_size;
+    uint32_t new_size;
+    uint8_t old_sha256[DELTA_PATCH_HASH_LEN];
+    uint8_t new_sha256[DELTA_PATCH_HASH_LEN];
+} delta_patch_header_t;
+
+/* Los callbacks devuelven 0 si salio bien */
+typedef struct
+{
+    int (*header)(const delta_patch_header_t *header, void *ctx); // Opcional, antes de escribir nada
+    int (*read_old)(uint32_t offset, uint8_t *buffer, size_t len, void *ctx);
+    int (*write_new)(const uint8_t *data, size_t len, void *ctx);
+    void *ctx;
+} delta_patch_io_t;
+
+typedef struct
+{
+    uint32_t copied;   // Bytes de la nueva por tipo de operacion
+    uint32_t added;
+    uint32_t inserted;
+    uint32_t ops;
+} delta_patch_stats_t;
+
+/************************************************************************/
+/* Aplicador incremental: se le pasa el parche en pedazos de cualquier  */
+/* tamano, a medida que llega por la red. Los campos son privados.      */
+/************************************************************************/
+typedef struct
+{
+    delta_patch_io_t io;
+    delta_patch_header_t header;
+    delta_patch_stats_t stats;
+    int state;
+    int result;
+    uint8_t op;
+    uint32_t arg;
+    uint8_t arg_shift;
+    uint32_t remaining;
+    uint32_t old_pos;
+    uint32_t new_pos;
+    size_t buffered;
+    uint8_t buffer[DELTA_PATCH_BUFFER_SIZE]; // Cabecera y despues la salida pendiente
+} delta_patch_t;
+
+void delta_patch_init(delta_patch_t *patch, const delta_patch_io_t *io);
+/* Devuelve delta_patch_result_t. Tras un error sigue devolviendo el mismo; */
+/* mas datos despues de DONE son DELTA_PATCH_ERR_CORRUPT                    */
+int delta_patch_feed(delta_patch_t *patch, const uint8_t *data, size_t len);
+const char *delta_patch_strerror(int result);
+
+/* Cabecera en DELTA_PATCH_HEADER_LEN bytes */
+void delta_patch_write_header(uint8_t *out, const delta_patch_header_t *header);
+/* false si no es un parche de esta version */
+bool delta_patch_parse_header(const uint8_t *in, delta_patch_header_t *header);
+
+#endif /* DELTA_PATCH_H_ */
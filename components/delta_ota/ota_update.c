@@ -0,0 +1,389 @@
+/*
+ * ota_update.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_crt_bundle.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "cJSON.h"
+#include "mbedtls/md.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/sha256.h"
+
+#include "ota_update.h"
+#include "resource_monitor.h"
+
+static const char *TAG = "OTA update";
+
+extern const char OTA_SIGNING_KEY[] asm("_binary_ota_signing_pub_pem_start");
+
+static clearblade_client_t *ota_client = NULL;
+static QueueHandle_t ota_queue = NULL;
+static TaskHandle_t ota_task_handle = NULL;
+static ota_update_stats_t stats;
+static volatile bool busy = false; // Hay un pedido encolado o en curso
+
+#ifdef STATIC_ALLOCATION_MODE
+static StaticQueue_t ota_queue_buffer;
+static uint8_t ota_queue_storage[sizeof(ota_update_request_t)];
+static StackType_t ota_task_stack[OTA_UPDATE_TASK_STACK_SIZE];
+static StaticTask_t ota_task_buffer;
+#endif
+
+/* Estado de la actualizacion en curso: lo unico que ocupa, sea cual sea la imagen */
+typedef struct
+{
+    const esp_partition_t *target;
+    esp_ota_handle_t handle;
+    const uint8_t *running;         // App que corre, mapeada
+    esp_partition_mmap_handle_t running_mmap;
+    uint32_t running_size;
+    mbedtls_sha256_context sha;
+    const char *error;
+} ota_session_t;
+
+static ota_update_request_t request;
+static ota_session_t session;
+static delta_patch_t patch;
+static uint8_t chunk[OTA_UPDATE_CHUNK_SIZE];
+
+/*****************************************************
+ *   Pedido                                           *
+ ******************************************************/
+static int hex_decode(const char *hex, uint8_t *out, size_t out_max)
+{
+    size_t len = strlen(hex);
+    if (len % 2 != 0 || len / 2 > out_max)
+        return -1;
+    for (size_t i = 0; i < len / 2; i++)
+    {
+        unsigned int byte;
+        if (sscanf(hex + 2 * i, "%2x", &byte) != 1)
+            return -1;
+        out[i] = byte;
+    }
+    return (int)(len / 2);
+}
+
+bool ota_update_parse_request(const char *data, size_t len, ota_update_request_t *request)
+{
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    if (root == NULL)
+        return false;
+
+    bool ok = false;
+    memset(request, 0, sizeof(*request));
+    cJSON *id = cJSON_GetObjectItem(root, "id");
+    cJSON *url = cJSON_GetObjectItem(root, "url");
+    cJSON *delta = cJSON_GetObjectItem(root, "delta");
+    cJSON *size = cJSON_GetObjectItem(root, "size");
+    cJSON *sha256 = cJSON_GetObjectItem(root, "sha256");
+    cJSON *sig = cJSON_GetObjectItem(root, "sig");
+    if (!cJSON_IsString(url) || strlen(url->valuestring) >= sizeof(request->url) || !cJSON_IsNumber(size) ||
+        size->valuedouble <= 0 || !cJSON_IsString(sha256) || !cJSON_IsString(sig))
+        goto end;
+
+    request->id = cJSON_IsNumber(id) ? (uint16_t)id->valueint : 0;
+    strlcpy(request->url, url->valuestring, sizeof(request->url));
+    request->delta = cJSON_IsNumber(delta) ? delta->valueint != 0 : cJSON_IsTrue(delta);
+    request->size = (uint32_t)size->valuedouble;
+    if (hex_decode(sha256->valuestring, request->sha256, sizeof(request->sha256)) != DELTA_PATCH_HASH_LEN)
+        goto end;
+    int sig_len = hex_decode(sig->valuestring, request->signature, sizeof(request->signature));
+    if (sig_len <= 0)
+        goto end;
+    request->signature_len = sig_len;
+    ok = true;
+end:
+    cJSON_Delete(root);
+    return ok;
+}
+
+/*****************************************************
+ *   Eventos                                          *
+ ******************************************************/
+static void publish_event(const char *state, int pct, const char *error)
+{
+    char message[OTA_UPDATE_EVENT_MAX_LEN];
+    int len;
+    if (error != NULL)
+        len = snprintf(message, sizeof(message), "{\"ota\": %u, \"state\": \"%s\", \"err\": \"%s\"}",
+                       (unsigned)request.id, state, error);
+    else
+        len = snprintf(message, sizeof(message), "{\"ota\": %u, \"state\": \"%s\", \"pct\": %d, \"rx\": %lu}",
+                       (unsigned)request.id, state, pct, (unsigned long)stats.downloaded);
+    if (len >= (int)sizeof(message))
+        len = sizeof(message) - 1;
+    // QoS 1: el backend decide reintentar o mandar la imagen completa con esto
+    if (clearblade_client_publish(ota_client, OTA_UPDATE_SUBTOPIC, message, len, 1) < 0)
+        ESP_LOGW(TAG, "No se pudo publicar %s", message);
+}
+
+/*****************************************************
+ *   Escritura de la imagen                           *
+ ******************************************************/
+static int write_new(const uint8_t *data, size_t len, void *ctx)
+{
+    if (esp_ota_write(session.handle, data, len) != ESP_OK)
+    {
+        session.error = "escritura en flash";
+        return -1;
+    }
+    mbedtls_sha256_update(&session.sha, data, len);
+    stats.written += len;
+    return 0;
+}
+
+static int read_old(uint32_t offset, uint8_t *buffer, size_t len, void *ctx)
+{
+    if (offset + len > session.running_size)
+        return -1;
+    memcpy(buffer, session.running + offset, len);
+    return 0;
+}
+
+/* El parche tiene que ser para la app que corre y dar la imagen del pedido */
+static int check_header(const delta_patch_header_t *header, void *ctx)
+{
+    uint8_t running_sha[DELTA_PATCH_HASH_LEN];
+    if (header->new_size != request.size || memcmp(header->new_sha256, request.sha256, DELTA_PATCH_HASH_LEN) != 0)
+    {
+        session.error = "el parche no es del pedido";
+        return -1;
+    }
+    if (header->old_size > session.running_size ||
+        mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), session.running, header->old_size, running_sha) != 0 ||
+        memcmp(running_sha, header->old_sha256, DELTA_PATCH_HASH_LEN) != 0)
+    {
+        session.error = "base distinta";
+        return -1;
+    }
+    return 0;
+}
+
+static bool verify_signature(const uint8_t *hash)
+{
+    mbedtls_pk_context key;
+    mbedtls_pk_init(&key);
+    int ret = mbedtls_pk_parse_public_key(&key, (const unsigned char *)OTA_SIGNING_KEY, strlen(OTA_SIGNING_KEY) + 1);
+    if (ret == 0)
+        ret = mbedtls_pk_verify(&key, MBEDTLS_MD_SHA256, hash, DELTA_PATCH_HASH_LEN, request.signature,
+                                request.signature_len);
+    mbedtls_pk_free(&key);
+    return ret == 0;
+}
+
+/* Descarga y aplica el pedido; devuelve NULL o la causa del fallo */
+static const char *download(void)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    if (request.size > session.target->size)
+        return "imagen mayor que la particion";
+    if (esp_partition_mmap(running, 0, running->size, ESP_PARTITION_MMAP_DATA, (const void **)&session.running,
+                           &session.running_mmap) != ESP_OK)
+        return "no se pudo mapear la app";
+    session.running_size = running->size;
+
+    esp_http_client_config_t config = {
+        .url = request.url,
+        .timeout_ms = OTA_UPDATE_HTTP_TIMEOUT_MS,
+        .buffer_size = OTA_UPDATE_CHUNK_SIZE,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+    };
+    esp_http_client_handle_t http = esp_http_client_init(&config);
+    if (http == NULL || esp_http_client_open(http, 0) != ESP_OK)
+    {
+        if (http != NULL)
+            esp_http_client_cleanup(http);
+        return "no se pudo conectar";
+    }
+    esp_http_client_fetch_headers(http);
+    if (esp_http_client_get_status_code(http) != 200)
+    {
+        esp_http_client_cleanup(http);
+        return "respuesta HTTP";
+    }
+
+    delta_patch_io_t io = {.header = check_header, .read_old = read_old, .write_new = write_new};
+    delta_patch_init(&patch, &io);
+    int result = DELTA_PATCH_MORE;
+    int next_pct = OTA_UPDATE_PROGRESS_STEP_PCT;
+    while (true)
+    {
+        int len = esp_http_client_read(http, (char *)chunk, sizeof(chunk));
+        if (len < 0)
+        {
+            session.error = "descarga interrumpida";
+            break;
+        }
+        if (len == 0)
+            break;
+        stats.downloaded += len;
+        if (request.delta)
+            result = delta_patch_feed(&patch, chunk, len);
+        else
+            result = stats.written + len > request.size || write_new(chunk, len, NULL) != 0 ? DELTA_PATCH_ERR_IO
+                                                                                         : DELTA_PATCH_MORE;
+        if (result < 0)
+        {
+            if (session.error == NULL)
+                session.error = delta_patch_strerror(result);
+            break;
+        }
+        int pct = (int)((uint64_t)stats.written * 100 / request.size);
+        if (pct >= next_pct && pct < 100)
+        {
+            publish_event("progress", pct, NULL);
+            next_pct = pct - pct % OTA_UPDATE_PROGRESS_STEP_PCT + OTA_UPDATE_PROGRESS_STEP_PCT;
+        }
+    }
+    esp_http_client_cleanup(http);
+    if (session.error != NULL)
+        return session.error;
+    if (request.delta ? result != DELTA_PATCH_DONE : stats.written != request.size)
+        return "imagen incompleta";
+    return NULL;
+}
+
+static const char *apply(void)
+{
+    memset(&session, 0, sizeof(session));
+    stats.downloaded = 0;
+    stats.written = 0;
+    mbedtls_sha256_init(&session.sha);
+    mbedtls_sha256_starts(&session.sha, 0);
+
+    session.target = esp_ota_get_next_update_partition(NULL);
+    if (session.target == NULL)
+        return "sin particion OTA";
+    if (esp_ota_begin(session.target, OTA_WITH_SEQUENTIAL_WRITES, &session.handle) != ESP_OK)
+        return "no se pudo abrir la particion";
+
+    const char *error = download();
+    if (session.running != NULL)
+        esp_partition_munmap(session.running_mmap);
+    uint8_t hash[DELTA_PATCH_HASH_LEN];
+    mbedtls_sha256_finish(&session.sha, hash);
+    mbedtls_sha256_free(&session.sha);
+    if (error == NULL && memcmp(hash, request.sha256, DELTA_PATCH_HASH_LEN) != 0)
+        error = "sha256 distinto";
+    if (error == NULL && !verify_signature(hash))
+        error = "firma invalida";
+    if (error != NULL)
+    {
+        esp_ota_abort(session.handle);
+        return error;
+    }
+    // esp_ota_end() revisa ademas el formato de la imagen
+    if (esp_ota_end(session.handle) != ESP_OK)
+        return "imagen invalida";
+    if (esp_ota_set_boot_partition(session.target) != ESP_OK)
+        return "no se pudo cambiar la particion de arranque";
+    return NULL;
+}
+
+static void ota_task(void *param)
+{
+    resource_monitor.register_task(NULL, "ota_update", OTA_UPDATE_TASK_STACK_SIZE);
+    while (true)
+    {
+        if (xQueueReceive(ota_queue, &request, portMAX_DELAY) != pdTRUE)
+            continue;
+        ESP_LOGI(TAG, "Pedido %u: %s %s, %lu bytes", (unsigned)request.id, request.delta ? "parche" : "imagen",
+                 request.url, (unsigned long)request.size);
+        publish_event("start", 0, NULL);
+        const char *error = apply();
+        if (error != NULL)
+        {
+            stats.failed++;
+            ESP_LOGE(TAG, "Pedido %u: %s", (unsigned)request.id, error);
+            publish_event("error", 0, error);
+            busy = false;
+            continue;
+        }
+        stats.applied++;
+        ESP_LOGI(TAG, "Pedido %u: %lu bytes descargados para %lu de imagen, reiniciando", (unsigned)request.id,
+                 (unsigned long)stats.downloaded, (unsigned long)stats.written);
+        publish_event("done", 100, NULL);
+        vTaskDelay(pdMS_TO_TICKS(OTA_UPDATE_RESTART_DELAY_MS));
+        esp_restart();
+    }
+}
+
+static esp_err_t start(clearblade_client_t *client)
+{
+    if (ota_task_handle != NULL)
+        return ESP_ERR_INVALID_STATE;
+    ota_client = client;
+
+#ifdef STATIC_ALLOCATION_MODE
+    ota_queue = xQueueCreateStatic(1, sizeof(ota_update_request_t), ota_queue_storage, &ota_queue_buffer);
+    ota_task_handle = xTaskCreateStatic(ota_task, "ota_update", OTA_UPDATE_TASK_STACK_SIZE, NULL, 2, ota_task_stack,
+                                        &ota_task_buffer);
+#else
+    ota_queue = xQueueCreate(1, sizeof(ota_update_request_t));
+    if (ota_queue == NULL)
+        return ESP_ERR_NO_MEM;
+    if (xTaskCreate(ota_task, "ota_update", OTA_UPDATE_TASK_STACK_SIZE, NULL, 2, &ota_task_handle) != pdPASS)
+        ota_task_handle = NULL;
+#endif
+    return ota_task_handle != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+/* Se llama desde la tarea MQTT: solo valida y encola */
+static bool handle_command(const char *topic, int topic_len, const char *data, int data_len)
+{
+    static ota_update_request_t incoming; // No entra en el stack de la tarea MQTT
+    size_t command_len = strlen(OTA_UPDATE_COMMAND);
+    if (topic_len < (int)command_len || memcmp(topic + topic_len - command_len, OTA_UPDATE_COMMAND, command_len) != 0)
+        return false;
+
+    stats.requests++;
+    if (!ota_update_parse_request(data, data_len, &incoming))
+    {
+        stats.rejected++;
+        ESP_LOGW(TAG, "Pedido de OTA invalido: %.*s", data_len, data);
+        return true;
+    }
+    if (busy || ota_queue == NULL)
+    {
+        stats.rejected++;
+        ESP_LOGW(TAG, "Pedido de OTA %u descartado: hay otro en curso", (unsigned)incoming.id);
+        return true;
+    }
+    busy = true;
+    if (xQueueSend(ota_queue, &incoming, 0) != pdTRUE)
+    {
+        busy = false;
+        stats.rejected++;
+        ESP_LOGW(TAG, "Pedido de OTA %u descartado: hay otro en curso", (unsigned)incoming.id);
+        return true;
+    }
+    return true;
+}
+
+static void get_stats(ota_update_stats_t *out)
+{
+    *out = stats;
+}
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)            *
+ ******************************************************/
+const ota_update_t ota_update = {
+    // OTA Update Functions
+    .start = start,
+    .handle_command = handle_command,
+    .get_stats = get_stats,
+};
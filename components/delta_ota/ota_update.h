@@ -0,0 +1,88 @@
+/*
+ * ota_update.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef OTA_UPDATE_H_
+#define OTA_UPDATE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "clearblade_connect.h"
+#include "delta_patch.h"
+
+/* Pedido en /devices/<id>/commands/ota; el avance va a events/ota */
+#define OTA_UPDATE_COMMAND "/commands/ota"
+#define OTA_UPDATE_SUBTOPIC "events/ota"
+
+#define OTA_UPDATE_TASK_STACK_SIZE (4096 * 2) // TLS de esp_http_client y verificacion RSA
+#define OTA_UPDATE_URL_MAX_LEN 256
+#define OTA_UPDATE_SIG_MAX_LEN 512 // RSA de hasta 4096 bits
+#define OTA_UPDATE_CHUNK_SIZE 1024 // Lecturas del socket
+#ifndef OTA_UPDATE_HTTP_TIMEOUT_MS
+#define OTA_UPDATE_HTTP_TIMEOUT_MS (15 * 1000)
+#endif
+#define OTA_UPDATE_PROGRESS_STEP_PCT 10
+#define OTA_UPDATE_RESTART_DELAY_MS 3000 // Para que salga el evento "done"
+#define OTA_UPDATE_EVENT_MAX_LEN 160
+
+typedef struct
+{
+    uint16_t id;
+    char url[OTA_UPDATE_URL_MAX_LEN];
+    bool delta;                               // Parche contra la app que corre, o imagen completa
+    uint32_t size;                            // Bytes de la imagen nueva
+    uint8_t sha256[DELTA_PATCH_HASH_LEN];     // De la imagen nueva
+    uint8_t signature[OTA_UPDATE_SIG_MAX_LEN]; // Firma PKCS#1 v1.5 de ese sha256
+    size_t signature_len;
+} ota_update_request_t;
+
+typedef struct
+{
+    uint32_t requests;
+    uint32_t rejected;     // Pedido invalido o con otra actualizacion en curso
+    uint32_t failed;
+    uint32_t applied;
+    uint32_t downloaded;   // Bytes transferidos en la ultima actualizacion
+    uint32_t written;      // Bytes escritos en la particion
+} ota_update_stats_t;
+
+/************************************************************************/
+/* La siguiente estructura simula un objeto en C                        */
+/*                                                                      */
+/* Actualizacion de firmware por /commands/ota. El backend publica:     */
+/*                                                                      */
+/*   {"id": 7, "url": "https://.../1.5.0-from-1.4.0.dpt", "delta": 1,   */
+/*    "size": 1013232, "sha256": "<hex>", "sig": "<hex>"}               */
+/*                                                                      */
+/* Una tarea descarga el parche y lo aplica (delta_patch.h) a medida    */
+/* que llega, leyendo la app que corre mapeada en flash y escribiendo   */
+/* la nueva en la otra particion OTA: la RAM usada no depende del       */
+/* tamano de la imagen. La cabecera del parche trae el sha256 de la     */
+/* imagen base; si no es la que corre, se aborta antes de escribir y el */
+/* backend tiene que mandar la imagen completa ("delta": 0). Al final   */
+/* compara el sha256 de lo escrito con el del pedido y verifica la      */
+/* firma con la clave publica embebida (ota_signing_pub.pem); solo      */
+/* entonces cambia la particion de arranque y reinicia. Avisa en        */
+/* events/ota:                                                          */
+/*                                                                      */
+/*   {"ota": 7, "state": "progress", "pct": 40, "rx": 81920}            */
+/*   {"ota": 7, "state": "error", "err": "firma invalida"}              */
+/************************************************************************/
+typedef struct
+{
+    // OTA Update Functions
+    esp_err_t (*start)(clearblade_client_t *client);
+    bool (*handle_command)(const char *topic, int topic_len, const char *data, int data_len); // false: no es el topic
+    void (*get_stats)(ota_update_stats_t *stats);
+} ota_update_t;
+
+extern const ota_update_t ota_update;
+
+bool ota_update_parse_request(const char *data, size_t len, ota_update_request_t *request);
+
+#endif /* OTA_UPDATE_H_ */
@@ -0,0 +1,471 @@
+/*
+ * energy_meter.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#include "energy_meter.h"
+#include "resource_monitor.h"
+
+#define ENERGY_METER_MAGIC 0xE4E26E7A
+
+static const char *TAG = "Energy meter";
+
+/************************************************************************/
+/* Ciclo cerrado por end_cycle(), en memoria RTC como boot_timeline:    */
+/* RTC_NOINIT_ATTR conserva tambien la carga acumulada tras reinicios   */
+/* por software; tras un encendido se valida con el numero magico.      */
+/************************************************************************/
+typedef struct
+{
+    uint32_t magic;
+    uint32_t cycles;
+    bool pending;   // El ultimo ciclo no se entrego todavia
+    double life_uah; // De los ciclos cerrados desde el encendido
+    energy_totals_t last;
+} energy_rtc_t;
+
+static RTC_NOINIT_ATTR energy_rtc_t rtc;
+
+static energy_model_t model = ENERGY_MODEL_DEFAULT;
+static energy_totals_t period;
+static energy_totals_t cycle;
+static energy_radio_t radio = ENERGY_RADIO_OFF;
+static int64_t last_us = 0; // esp_timer_get_time() cuenta desde el arranque: el periodo empieza ahi
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+static configRUN_TIME_COUNTER_TYPE idle_last[ENERGY_METER_MAX_CORES];
+#endif
+static int64_t cpu_last_us = 0;
+
+static energy_report_callback_t report_callback = NULL;
+static void *report_ctx = NULL;
+
+static SemaphoreHandle_t meter_mutex = NULL;
+static StaticSemaphore_t meter_mutex_buffer;
+static portMUX_TYPE meter_mutex_init = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t meter_task_handle = NULL;
+static char report_buffer[ENERGY_METER_REPORT_MAX_LEN];
+
+#ifdef STATIC_ALLOCATION_MODE
+static StackType_t meter_task_stack[ENERGY_METER_TASK_STACK_SIZE];
+static StaticTask_t meter_task_buffer;
+#endif
+
+/* Se cuenta desde antes de start(): el mutex se crea al primer uso */
+static void lock(void)
+{
+    if (meter_mutex == NULL)
+    {
+        taskENTER_CRITICAL(&meter_mutex_init);
+        if (meter_mutex == NULL)
+            meter_mutex = xSemaphoreCreateMutexStatic(&meter_mutex_buffer);
+        taskEXIT_CRITICAL(&meter_mutex_init);
+    }
+    xSemaphoreTake(meter_mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(meter_mutex);
+}
+
+/* Suma al periodo y al ciclo */
+#define COUNT(field, value)            \
+    do                                 \
+    {                                  \
+        period.field += (value);       \
+        cycle.field += (value);        \
+    } while (0)
+
+/*****************************************************
+ *   Calculos                                         *
+ ******************************************************/
+uint32_t energy_meter_mqtt_packet_len(uint32_t remaining_len)
+{
+    uint32_t len = 1 + remaining_len;
+    do
+    {
+        len++;
+        remaining_len >>= 7;
+    } while (remaining_len > 0);
+    return len;
+}
+
+uint64_t energy_meter_tx_airtime_us(const energy_totals_t *totals, const energy_model_t *model)
+{
+    return (uint64_t)totals->tx_packets * model->tx_packet_us + totals->tls_tx_bytes * model->tx_byte_ns / 1000;
+}
+
+/* uA * us -> uAh */
+double energy_meter_charge_uah(const energy_totals_t *totals, const energy_model_t *model)
+{
+    double ua_us = (double)model->base_ua * totals->awake_us + (double)model->cpu_ua * totals->cpu_active_us +
+                   (double)model->radio_on_ua * totals->radio_on_us + (double)model->radio_ps_ua * totals->radio_ps_us +
+                   (double)model->tx_ua * energy_meter_tx_airtime_us(totals, model) +
+                   (double)model->sleep_ua * totals->sleep_us;
+    return ua_us / 3.6e9;
+}
+
+bool energy_meter_parse_model(const char *text, energy_model_t *model)
+{
+    static const struct
+    {
+        const char *name;
+        size_t offset;
+        size_t size;
+    } fields[] = {
+        {"base", offsetof(energy_model_t, base_ua), sizeof(uint32_t)},
+        {"cpu", offsetof(energy_model_t, cpu_ua), sizeof(uint32_t)},
+        {"radio_on", offsetof(energy_model_t, radio_on_ua), sizeof(uint32_t)},
+        {"radio_ps", offsetof(energy_model_t, radio_ps_ua), sizeof(uint32_t)},
+        {"tx", offsetof(energy_model_t, tx_ua), sizeof(uint32_t)},
+        {"sleep", offsetof(energy_model_t, sleep_ua), sizeof(uint32_t)},
+        {"tx_packet_us", offsetof(energy_model_t, tx_packet_us), sizeof(uint32_t)},
+        {"tx_byte_ns", offsetof(energy_model_t, tx_byte_ns), sizeof(uint32_t)},
+        {"tls_record", offsetof(energy_model_t, tls_record_overhead), sizeof(uint16_t)},
+        {"tls_handshake", offsetof(energy_model_t, tls_handshake_bytes), sizeof(uint16_t)},
+    };
+
+    energy_model_t parsed = *model;
+    while (*text != '\0')
+    {
+        const char *equals = strchr(text, '=');
+        if (equals == NULL)
+            return false;
+        size_t name_len = equals - text;
+        char *end;
+        unsigned long value = strtoul(equals + 1, &end, 10);
+        if (end == equals + 1 || (*end != ',' && *end != '\0'))
+            return false;
+
+        size_t i = 0;
+        while (i < sizeof(fields) / sizeof(fields[0]) &&
+               (strlen(fields[i].name) != name_len || strncmp(fields[i].name, text, name_len) != 0))
+            i++;
+        if (i == sizeof(fields) / sizeof(fields[0]))
+            return false;
+        uint8_t *field = (uint8_t *)&parsed + fields[i].offset;
+        if (fields[i].size == sizeof(uint16_t))
+            *(uint16_t *)field = value;
+        else
+            *(uint32_t *)field = value;
+        text = *end == ',' ? end + 1 : end;
+    }
+    *model = parsed;
+    return true;
+}
+
+/* Los campos del reporte, sin llaves */
+static int format_fields(char *buffer, size_t buffer_len, const energy_totals_t *totals, const energy_model_t *model)
+{
+    double uah = energy_meter_charge_uah(totals, model);
+    return snprintf(buffer, buffer_len,
+                    "\"s\": %.1f, \"samples\": %lu, \"msgs\": %lu, \"mqtt_tx\": %llu, \"tls_tx\": %llu, \"hs\": %lu, "
+                    "\"jwt\": %lu, \"jwt_ms\": %llu, \"radio_s\": %.1f, \"ps_s\": %.1f, \"tx_ms\": %.1f, "
+                    "\"cpu_s\": %.2f, \"sleep_s\": %.1f, \"uah\": %.1f, \"uah_sample\": %.3f",
+                    totals->awake_us / 1e6, (unsigned long)totals->samples, (unsigned long)totals->messages,
+                    (unsigned long long)totals->mqtt_tx_bytes, (unsigned long long)totals->tls_tx_bytes,
+                    (unsigned long)totals->tls_handshakes, (unsigned long)totals->jwt_signs,
+                    (unsigned long long)(totals->jwt_sign_us / 1000), totals->radio_on_us / 1e6,
+                    totals->radio_ps_us / 1e6, energy_meter_tx_airtime_us(totals, model) / 1e3,
+                    totals->cpu_active_us / 1e6, totals->sleep_us / 1e6, uah,
+                    totals->samples > 0 ? uah / totals->samples : 0.0);
+}
+
+int energy_meter_format_report(char *buffer, size_t buffer_len, const char *key, const energy_totals_t *totals,
+                               const energy_model_t *model)
+{
+    size_t len = snprintf(buffer, buffer_len, "{\"%s\": {", key);
+    len += format_fields(len < buffer_len ? buffer + len : NULL, len < buffer_len ? buffer_len - len : 0, totals, model);
+    len += snprintf(len < buffer_len ? buffer + len : NULL, len < buffer_len ? buffer_len - len : 0, "}}");
+    return (int)len;
+}
+
+/*****************************************************
+ *   Tiempos                                          *
+ ******************************************************/
+/* Tiempo despierto y de radio hasta ahora; se llama con el mutex tomado */
+static void advance(int64_t now_us)
+{
+    uint64_t elapsed = now_us - last_us;
+    last_us = now_us;
+    COUNT(awake_us, elapsed);
+    if (radio == ENERGY_RADIO_ON)
+        COUNT(radio_on_us, elapsed);
+    else if (radio == ENERGY_RADIO_PS)
+        COUNT(radio_ps_us, elapsed);
+}
+
+/************************************************************************/
+/* Tiempo activo de CPU: lo que no corrio la tarea idle de cada nucleo. */
+/* El contador de FreeRTOS es de 32 bits en us; la resta sin signo      */
+/* tolera una vuelta entre dos mediciones. Sin las estadisticas de      */
+/* tiempo de ejecucion se cuenta un nucleo activo todo el tiempo.       */
+/************************************************************************/
+static void sample_cpu(int64_t now_us)
+{
+    uint64_t elapsed = now_us - cpu_last_us;
+    cpu_last_us = now_us;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    for (int core = 0; core < ENERGY_METER_MAX_CORES && core < portNUM_PROCESSORS; core++)
+    {
+        TaskHandle_t idle_task = xTaskGetIdleTaskHandleForCore(core);
+        if (idle_task == NULL)
+            continue;
+        configRUN_TIME_COUNTER_TYPE idle = ulTaskGetRunTimeCounter(idle_task);
+        uint64_t idle_elapsed = (configRUN_TIME_COUNTER_TYPE)(idle - idle_last[core]);
+        idle_last[core] = idle;
+        COUNT(cpu_active_us, elapsed > idle_elapsed ? elapsed - idle_elapsed : 0);
+    }
+#else
+    COUNT(cpu_active_us, elapsed);
+#endif
+}
+
+static void sample(void)
+{
+    int64_t now_us = esp_timer_get_time();
+    lock();
+    advance(now_us);
+    sample_cpu(now_us);
+    unlock();
+}
+
+/*****************************************************
+ *   Contadores                                       *
+ ******************************************************/
+static void set_radio(energy_radio_t state)
+{
+    int64_t now_us = esp_timer_get_time();
+    lock();
+    advance(now_us);
+    radio = state;
+    unlock();
+}
+
+/* Sin TLS cada paquete MQTT es un segmento; con TLS va en registros de hasta ENERGY_METER_TLS_RECORD_LEN */
+static void add_tx(uint32_t mqtt_bytes, bool tls)
+{
+    uint32_t records = tls ? (mqtt_bytes + ENERGY_METER_TLS_RECORD_LEN - 1) / ENERGY_METER_TLS_RECORD_LEN : 1;
+    COUNT(mqtt_tx_bytes, mqtt_bytes);
+    COUNT(tls_tx_bytes, mqtt_bytes + (tls ? records * model.tls_record_overhead : 0));
+    COUNT(tx_packets, records);
+}
+
+static void count_publish(uint32_t topic_len, uint32_t payload_len, int qos, bool tls)
+{
+    // Largo del topic, topic, packet id (QoS > 0) y payload
+    uint32_t remaining = 2 + topic_len + (qos > 0 ? 2 : 0) + payload_len;
+    lock();
+    COUNT(messages, 1);
+    add_tx(energy_meter_mqtt_packet_len(remaining), tls);
+    unlock();
+}
+
+static void count_tx(uint32_t mqtt_bytes, bool tls)
+{
+    lock();
+    add_tx(mqtt_bytes, tls);
+    unlock();
+}
+
+static void count_handshake(void)
+{
+    lock();
+    COUNT(tls_handshakes, 1);
+    COUNT(tls_tx_bytes, model.tls_handshake_bytes);
+    COUNT(tx_packets, ENERGY_METER_TLS_HANDSHAKE_PACKETS);
+    unlock();
+}
+
+static void count_jwt(uint32_t sign_us)
+{
+    lock();
+    COUNT(jwt_signs, 1);
+    COUNT(jwt_sign_us, sign_us);
+    unlock();
+}
+
+static void count_samples(uint32_t samples)
+{
+    lock();
+    COUNT(samples, samples);
+    unlock();
+}
+
+static void get_period(energy_totals_t *totals)
+{
+    sample();
+    lock();
+    *totals = period;
+    unlock();
+}
+
+static void get_cycle(energy_totals_t *totals)
+{
+    sample();
+    lock();
+    *totals = cycle;
+    unlock();
+}
+
+/************************************************************************/
+/* Cierra el ciclo antes del deep sleep: queda en RTC con el sueno que  */
+/* sigue, y se entrega al despertar.                                    */
+/************************************************************************/
+static void end_cycle(uint64_t sleep_us)
+{
+    sample();
+    lock();
+    rtc.last = cycle;
+    rtc.last.sleep_us = sleep_us;
+    rtc.cycles++;
+    rtc.life_uah += energy_meter_charge_uah(&rtc.last, &model);
+    rtc.pending = true;
+    unlock();
+}
+
+static void set_model(const energy_model_t *new_model)
+{
+    lock();
+    model = *new_model;
+    unlock();
+}
+
+static void get_model(energy_model_t *current)
+{
+    lock();
+    *current = model;
+    unlock();
+}
+
+/*****************************************************
+ *   Reportes                                         *
+ ******************************************************/
+static void report_period(void)
+{
+    energy_totals_t totals;
+    energy_model_t current;
+    sample();
+    lock();
+    totals = period;
+    current = model;
+    memset(&period, 0, sizeof(period));
+    unlock();
+
+    int len = energy_meter_format_report(report_buffer, sizeof(report_buffer), "energy", &totals, &current);
+    if (len >= (int)sizeof(report_buffer))
+        return;
+    ESP_LOGI(TAG, "%s", report_buffer);
+    if (report_callback != NULL)
+        report_callback(report_buffer, len, false, report_ctx);
+}
+
+/* El ciclo anterior se reintenta en cada medicion hasta que el callback lo entregue */
+static void report_cycle(void)
+{
+    lock();
+    bool pending = rtc.pending;
+    energy_totals_t totals = rtc.last;
+    energy_model_t current = model;
+    uint32_t cycles = rtc.cycles;
+    double life_uah = rtc.life_uah;
+    unlock();
+    if (!pending || report_callback == NULL)
+        return;
+
+    size_t len = snprintf(report_buffer, sizeof(report_buffer), "{\"energy_cycle\": {\"n\": %lu, \"life_uah\": %.1f, ",
+                          (unsigned long)cycles, life_uah);
+    len += format_fields(len < sizeof(report_buffer) ? report_buffer + len : NULL,
+                         len < sizeof(report_buffer) ? sizeof(report_buffer) - len : 0, &totals, &current);
+    len += snprintf(len < sizeof(report_buffer) ? report_buffer + len : NULL,
+                    len < sizeof(report_buffer) ? sizeof(report_buffer) - len : 0, "}}");
+    if (len >= sizeof(report_buffer) || report_callback(report_buffer, len, true, report_ctx))
+    {
+        lock();
+        rtc.pending = false;
+        unlock();
+    }
+}
+
+static void meter_task(void *param)
+{
+    resource_monitor.register_task(NULL, "energy_meter", ENERGY_METER_TASK_STACK_SIZE);
+    TickType_t last_report = xTaskGetTickCount();
+    while (true)
+    {
+        sample();
+        report_cycle();
+        if (xTaskGetTickCount() - last_report >= pdMS_TO_TICKS(ENERGY_METER_REPORT_MS))
+        {
+            last_report = xTaskGetTickCount();
+            report_period();
+        }
+        vTaskDelay(pdMS_TO_TICKS(ENERGY_METER_SAMPLE_MS));
+    }
+}
+
+static esp_err_t start(void)
+{
+    if (meter_task_handle != NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    lock();
+    if (rtc.magic != ENERGY_METER_MAGIC || esp_reset_reason() == ESP_RST_POWERON)
+    {
+        memset(&rtc, 0, sizeof(rtc));
+        rtc.magic = ENERGY_METER_MAGIC;
+    }
+    unlock();
+
+#ifdef STATIC_ALLOCATION_MODE
+    meter_task_handle = xTaskCreateStatic(meter_task, "energy_meter", ENERGY_METER_TASK_STACK_SIZE, NULL, 1,
+                                          meter_task_stack, &meter_task_buffer);
+#else
+    if (xTaskCreate(meter_task, "energy_meter", ENERGY_METER_TASK_STACK_SIZE, NULL, 1, &meter_task_handle) != pdPASS)
+        meter_task_handle = NULL;
+#endif
+    if (meter_task_handle == NULL)
+        return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+/* El callback se fija antes de start(): la tarea lo lee sin sincronizar */
+static void set_report_callback(energy_report_callback_t callback, void *ctx)
+{
+    report_ctx = ctx;
+    report_callback = callback;
+}
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)            *
+ ******************************************************/
+const energy_meter_t energy_meter = {
+    // Energy Meter Functions
+    .set_model = set_model,
+    .get_model = get_model,
+    .set_report_callback = set_report_callback,
+    .start = start,
+    .set_radio = set_radio,
+    .count_publish = count_publish,
+    .count_tx = count_tx,
+    .count_handshake = count_handshake,
+    .count_jwt = count_jwt,
+    .count_samples = count_samples,
+    .get_period = get_period,
+    .get_cycle = get_cycle,
+    .end_cycle = end_cycle,
+};
@@ -0,0 +1,151 @@
+/*
+ * energy_meter.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef ENERGY_METER_H_
+#define ENERGY_METER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define ENERGY_METER_SAMPLE_MS (10 * 1000) // Menos que la vuelta del contador de 32 bits (71 min)
+#ifndef ENERGY_METER_REPORT_MS
+#define ENERGY_METER_REPORT_MS (15 * 60 * 1000)
+#endif
+#define ENERGY_METER_TASK_STACK_SIZE (4096 * 1) // El callback del reporte puede publicar
+#define ENERGY_METER_REPORT_MAX_LEN 512
+#define ENERGY_METER_MAX_CORES 2
+
+/* Registros TLS: CONFIG_MBEDTLS_SSL_OUT_CONTENT_LEN y mensajes del cliente en un handshake */
+#define ENERGY_METER_TLS_RECORD_LEN 4096
+#define ENERGY_METER_TLS_HANDSHAKE_PACKETS 3 // ClientHello, ClientKeyExchange + Finished, ACK
+
+/* Modelo de consumo por defecto: ESP32 a 160 MHz, 3.3 V, Wi-Fi a 13 dBm */
+#ifndef ENERGY_METER_BASE_UA
+#define ENERGY_METER_BASE_UA 20000 // Despierto, CPU en idle, radio apagada
+#endif
+#ifndef ENERGY_METER_CPU_UA
+#define ENERGY_METER_CPU_UA 15000 // Extra por nucleo activo
+#endif
+#ifndef ENERGY_METER_RADIO_ON_UA
+#define ENERGY_METER_RADIO_ON_UA 80000 // Extra con la radio escuchando (sin power save o con el AP)
+#endif
+#ifndef ENERGY_METER_RADIO_PS_UA
+#define ENERGY_METER_RADIO_PS_UA 5000 // Extra promedio asociado con modem sleep (DTIM 1)
+#endif
+#ifndef ENERGY_METER_TX_UA
+#define ENERGY_METER_TX_UA 100000 // Extra mientras transmite
+#endif
+#ifndef ENERGY_METER_SLEEP_UA
+#define ENERGY_METER_SLEEP_UA 10 // Deep sleep con el timer RTC
+#endif
+
+typedef struct
+{
+    uint32_t base_ua;
+    uint32_t cpu_ua;
+    uint32_t radio_on_ua;
+    uint32_t radio_ps_ua;
+    uint32_t tx_ua;
+    uint32_t sleep_ua;
+    uint32_t tx_packet_us;        // Tiempo de aire fijo por paquete: preambulo, contencion y ACK
+    uint32_t tx_byte_ns;          // Tiempo de aire por byte (150 ns: ~54 Mbit/s)
+    uint16_t tls_record_overhead; // Bytes por registro TLS (29: AES-GCM en TLS 1.2)
+    uint16_t tls_handshake_bytes; // Lo que transmite el cliente en un handshake sin certificado propio
+} energy_model_t;
+
+#define ENERGY_MODEL_DEFAULT                                                                           \
+    {                                                                                                  \
+        .base_ua = ENERGY_METER_BASE_UA, .cpu_ua = ENERGY_METER_CPU_UA,                                \
+        .radio_on_ua = ENERGY_METER_RADIO_ON_UA, .radio_ps_ua = ENERGY_METER_RADIO_PS_UA,              \
+        .tx_ua = ENERGY_METER_TX_UA, .sleep_ua = ENERGY_METER_SLEEP_UA, .tx_packet_us = 250,           \
+        .tx_byte_ns = 150, .tls_record_overhead = 29, .tls_handshake_bytes = 420,                      \
+    }
+
+typedef enum
+{
+    ENERGY_RADIO_OFF = 0,
+    ENERGY_RADIO_ON,  // Escuchando todo el tiempo: conectando, WIFI_PS_NONE o con el AP
+    ENERGY_RADIO_PS,  // Asociada con modem sleep
+} energy_radio_t;
+
+/* Acumulados de un periodo de reporte o de un ciclo de despertar */
+typedef struct
+{
+    uint32_t samples;        // Muestras publicadas (un lote de N cuenta N)
+    uint32_t messages;       // PUBLISH aceptados por el cliente
+    uint32_t tx_packets;     // Registros TLS (o paquetes MQTT sin TLS) y mensajes de handshake
+    uint64_t mqtt_tx_bytes;  // PUBLISH, CONNECT y SUBSCRIBE completos
+    uint64_t tls_tx_bytes;   // Lo anterior con los registros TLS y los handshakes
+    uint32_t tls_handshakes;
+    uint32_t jwt_signs;
+    uint64_t jwt_sign_us;
+    uint64_t awake_us;
+    uint64_t cpu_active_us;  // Suma de los nucleos
+    uint64_t radio_on_us;
+    uint64_t radio_ps_us;
+    uint64_t sleep_us;       // Solo en un ciclo: el deep sleep que lo sigue
+} energy_totals_t;
+
+/* Recibe el reporte periodico (cycle = false) y el del ciclo anterior al deep sleep; */
+/* devuelve false si no lo pudo entregar (el del ciclo se reintenta)                  */
+typedef bool (*energy_report_callback_t)(const char *json, int len, bool cycle, void *ctx);
+
+/************************************************************************/
+/* La siguiente estructura simula un objeto en C                        */
+/*                                                                      */
+/* Contabilidad de energia. Los modulos anotan lo que cuesta: el        */
+/* cliente Clearblade los bytes de cada PUBLISH, CONNECT y SUBSCRIBE y  */
+/* los handshakes TLS, la firma de cada JWT, wifi_manager el estado de  */
+/* la radio y el despacho las muestras publicadas. Una tarea de baja    */
+/* prioridad suma el tiempo despierto, con la radio encendida y con     */
+/* algun nucleo activo (el idle de FreeRTOS, con                        */
+/* CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS), y cada                     */
+/* ENERGY_METER_REPORT_MS entrega el periodo con la carga estimada por  */
+/* el modelo y lo que cuesta cada muestra:                              */
+/*                                                                      */
+/*   {"energy": {"s": 900.0, "samples": 4, "msgs": 4, "mqtt_tx": 1210,  */
+/*     "tls_tx": 1326, "hs": 0, "jwt": 0, "jwt_ms": 0, "radio_s": 900,  */
+/*     "ps_s": 0, "tx_ms": 1.2, "cpu_s": 3.1, "sleep_s": 0,             */
+/*     "uah": 25013.2, "uah_sample": 6253.300}}                         */
+/*                                                                      */
+/* end_cycle() guarda el ciclo en memoria RTC antes del deep sleep; al  */
+/* despertar se entrega como "energy_cycle", con el sueno incluido y    */
+/* la carga acumulada desde el encendido ("life_uah").                  */
+/************************************************************************/
+typedef struct
+{
+    // Energy Meter Functions
+    void (*set_model)(const energy_model_t *model);
+    void (*get_model)(energy_model_t *model);
+    void (*set_report_callback)(energy_report_callback_t callback, void *ctx);
+    esp_err_t (*start)(void);
+    void (*set_radio)(energy_radio_t state);
+    void (*count_publish)(uint32_t topic_len, uint32_t payload_len, int qos, bool tls);
+    void (*count_tx)(uint32_t mqtt_bytes, bool tls); // Un paquete MQTT que no es PUBLISH
+    void (*count_handshake)(void);
+    void (*count_jwt)(uint32_t sign_us);
+    void (*count_samples)(uint32_t samples);
+    void (*get_period)(energy_totals_t *totals); // Desde el ultimo reporte
+    void (*get_cycle)(energy_totals_t *totals);  // Desde el arranque o el despertar
+    void (*end_cycle)(uint64_t sleep_us);        // Antes de esp_deep_sleep_start()
+} energy_meter_t;
+
+extern const energy_meter_t energy_meter;
+
+/* Largo de un paquete MQTT con ese remaining length (cabecera fija incluida) */
+uint32_t energy_meter_mqtt_packet_len(uint32_t remaining_len);
+uint64_t energy_meter_tx_airtime_us(const energy_totals_t *totals, const energy_model_t *model);
+double energy_meter_charge_uah(const energy_totals_t *totals, const energy_model_t *model);
+/* "base=20000,cpu=15000,...": cambia solo los campos presentes; false si alguno no existe */
+bool energy_meter_parse_model(const char *text, energy_model_t *model);
+/* Arma {"<key>": {...}}; devuelve el largo (o el que haria falta) */
+int energy_meter_format_report(char *buffer, size_t buffer_len, const char *key, const energy_totals_t *totals,
+                               const energy_model_t *model);
+
+#endif /* ENERGY_METER_H_ */
@@ -0,0 +1,543 @@
+/*
+ * health_supervisor.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#include "health_supervisor.h"
+#include "resource_monitor.h"
+
+#define HEALTH_SUPERVISOR_MAGIC 0x4EA17B0D
+/* Por encima de las tareas supervisadas: una que no suelta la CPU no la frena */
+#define HEALTH_SUPERVISOR_TASK_PRIORITY 5
+
+static const char *TAG = "Health supervisor";
+
+typedef struct
+{
+    const char *name; // NULL: lugar libre
+    uint32_t period_ms;
+    int64_t last_beat_us;
+    uint32_t beats;
+    uint32_t missed;
+    uint32_t max_ms;
+    bool late;        // Vencio el plazo y no volvio a latir
+    uint16_t latency[HEALTH_LATENCY_BUCKETS]; // Del periodo de reporte; se saturan
+} beat_entry_t;
+
+/************************************************************************/
+/* Motivo del ultimo reinicio del supervisor, en memoria RTC como       */
+/* energy_meter: RTC_NOINIT_ATTR sobrevive a esp_restart() y a los      */
+/* watchdogs; tras un encendido se valida con el numero magico.         */
+/************************************************************************/
+typedef struct
+{
+    uint32_t magic;
+    uint32_t reboots;     // Desde el encendido
+    uint32_t consecutive; // Sin un periodo estable entre ellos
+    bool pending;         // El ultimo reinicio fue del supervisor
+    char task[HEALTH_SUPERVISOR_NAME_LEN];
+    uint32_t age_ms;
+    uint32_t uptime_s;
+} health_rtc_t;
+
+static RTC_NOINIT_ATTR health_rtc_t rtc;
+
+static beat_entry_t entries[HEALTH_SUPERVISOR_MAX_TASKS];
+static health_action_t level = HEALTH_ACTION_NONE;
+static int64_t action_us = 0;
+static uint32_t actions[HEALTH_ACTION_COUNT];
+static health_boot_info_t boot_info;
+static bool boot_pending = false;
+
+static health_report_callback_t report_callback = NULL;
+static void *report_ctx = NULL;
+static health_recovery_callback_t recovery_callback = NULL;
+static void *recovery_ctx = NULL;
+
+static SemaphoreHandle_t supervisor_mutex = NULL;
+static StaticSemaphore_t supervisor_mutex_buffer;
+static portMUX_TYPE supervisor_mutex_init = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t supervisor_task_handle = NULL;
+static char report_buffer[HEALTH_SUPERVISOR_REPORT_MAX_LEN];
+
+#ifdef STATIC_ALLOCATION_MODE
+static StackType_t supervisor_task_stack[HEALTH_SUPERVISOR_TASK_STACK_SIZE];
+static StaticTask_t supervisor_task_buffer;
+#endif
+
+/* Las tareas se registran antes de start(): el mutex se crea al primer uso */
+static void lock(void)
+{
+    if (supervisor_mutex == NULL)
+    {
+        taskENTER_CRITICAL(&supervisor_mutex_init);
+        if (supervisor_mutex == NULL)
+            supervisor_mutex = xSemaphoreCreateMutexStatic(&supervisor_mutex_buffer);
+        taskEXIT_CRITICAL(&supervisor_mutex_init);
+    }
+    xSemaphoreTake(supervisor_mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(supervisor_mutex);
+}
+
+/*****************************************************
+ *   Histograma                                       *
+ ******************************************************/
+/* 0..3 ms exactos; despues el bit mas alto y los dos siguientes */
+int health_latency_bucket(uint32_t interval_ms)
+{
+    if (interval_ms < HEALTH_LATENCY_SUB_BUCKETS)
+        return interval_ms;
+    int msb = 31 - __builtin_clz(interval_ms);
+    int bucket = (msb - 1) * HEALTH_LATENCY_SUB_BUCKETS + ((interval_ms >> (msb - 2)) & (HEALTH_LATENCY_SUB_BUCKETS - 1));
+    return bucket < HEALTH_LATENCY_BUCKETS ? bucket : HEALTH_LATENCY_BUCKETS - 1;
+}
+
+uint32_t health_latency_bucket_limit(int bucket)
+{
+    if (bucket < HEALTH_LATENCY_SUB_BUCKETS)
+        return bucket;
+    int msb = bucket / HEALTH_LATENCY_SUB_BUCKETS + 1;
+    uint32_t sub = bucket % HEALTH_LATENCY_SUB_BUCKETS;
+    return ((HEALTH_LATENCY_SUB_BUCKETS + sub + 1) << (msb - 2)) - 1;
+}
+
+uint32_t health_latency_percentile(const uint16_t *counts, uint32_t percentile)
+{
+    uint32_t total = 0;
+    for (int i = 0; i < HEALTH_LATENCY_BUCKETS; i++)
+        total += counts[i];
+    if (total == 0)
+        return 0;
+    uint32_t target = (total * percentile + 99) / 100;
+    if (target == 0)
+        target = 1;
+    uint32_t seen = 0;
+    for (int i = 0; i < HEALTH_LATENCY_BUCKETS; i++)
+    {
+        seen += counts[i];
+        if (seen >= target)
+            return health_latency_bucket_limit(i);
+    }
+    return health_latency_bucket_limit(HEALTH_LATENCY_BUCKETS - 1);
+}
+
+const char *health_action_name(health_action_t action)
+{
+    switch (action)
+    {
+    case HEALTH_ACTION_NONE:
+        return "none";
+    case HEALTH_ACTION_RESTART_CLIENT:
+        return "restart_client";
+    case HEALTH_ACTION_RESTART_WIFI:
+        return "restart_wifi";
+    case HEALTH_ACTION_REBOOT:
+        return "reboot";
+    default:
+        return "?";
+    }
+}
+
+const char *health_reset_reason_name(int reset_reason)
+{
+    switch (reset_reason)
+    {
+    case ESP_RST_POWERON:
+        return "poweron";
+    case ESP_RST_EXT:
+        return "ext";
+    case ESP_RST_SW:
+        return "sw";
+    case ESP_RST_PANIC:
+        return "panic";
+    case ESP_RST_INT_WDT:
+        return "int_wdt";
+    case ESP_RST_TASK_WDT:
+        return "task_wdt";
+    case ESP_RST_WDT:
+        return "wdt";
+    case ESP_RST_DEEPSLEEP:
+        return "deepsleep";
+    case ESP_RST_BROWNOUT:
+        return "brownout";
+    default:
+        return "other";
+    }
+}
+
+/*****************************************************
+ *   Latidos                                          *
+ ******************************************************/
+/* El mismo nombre registrado de nuevo (la tarea se recreo) reusa su lugar */
+static int register_task(const char *name, uint32_t period_ms)
+{
+    if (name == NULL)
+        return -1;
+    int64_t now_us = esp_timer_get_time();
+    lock();
+    int id = -1;
+    for (int i = 0; i < HEALTH_SUPERVISOR_MAX_TASKS && id < 0; i++)
+        if (entries[i].name != NULL && strcmp(entries[i].name, name) == 0)
+            id = i;
+    for (int i = 0; i < HEALTH_SUPERVISOR_MAX_TASKS && id < 0; i++)
+        if (entries[i].name == NULL)
+            id = i;
+    if (id >= 0)
+    {
+        entries[id].name = name;
+        entries[id].period_ms = period_ms;
+        entries[id].last_beat_us = now_us; // El primer plazo cuenta desde el registro
+        entries[id].late = false;
+    }
+    unlock();
+    if (id < 0)
+        ESP_LOGW(TAG, "Sin lugar para el latido de %s (HEALTH_SUPERVISOR_MAX_TASKS)", name);
+    return id;
+}
+
+static void beat(int id)
+{
+    if (id < 0 || id >= HEALTH_SUPERVISOR_MAX_TASKS)
+        return;
+    int64_t now_us = esp_timer_get_time();
+    lock();
+    beat_entry_t *entry = &entries[id];
+    uint64_t interval_ms = (now_us - entry->last_beat_us) / 1000;
+    uint32_t interval = interval_ms > UINT32_MAX ? UINT32_MAX : (uint32_t)interval_ms;
+    uint16_t *count = &entry->latency[health_latency_bucket(interval)];
+    if (*count < UINT16_MAX)
+        (*count)++;
+    if (interval > entry->max_ms)
+        entry->max_ms = interval;
+    entry->last_beat_us = now_us;
+    entry->beats++;
+    entry->late = false;
+    unlock();
+}
+
+/*****************************************************
+ *   Escalada                                         *
+ ******************************************************/
+static bool deliver(const char *json, int len, health_report_kind_t kind)
+{
+    if (report_callback == NULL || len <= 0 || len >= HEALTH_SUPERVISOR_REPORT_MAX_LEN)
+        return false;
+    return report_callback(json, len, kind, report_ctx);
+}
+
+/************************************************************************/
+/* Ejecuta un paso de la escalada fuera del mutex. Antes de reiniciar,  */
+/* la tarea atrasada queda en RTC y el callback puede guardar lo que    */
+/* se perderia con la RAM (log diferido, ciclo de energia).             */
+/************************************************************************/
+static void act(health_action_t action, const char *task, uint32_t age_ms)
+{
+    ESP_LOGE(TAG, "%s sin latir hace %lu ms: %s", task, (unsigned long)age_ms, health_action_name(action));
+    char alert[HEALTH_SUPERVISOR_ALERT_MAX_LEN];
+    int len = snprintf(alert, sizeof(alert), "{\"alert\": \"health\", \"task\": \"%s\", \"age_ms\": %lu, \"action\": \"%s\"}",
+                       task, (unsigned long)age_ms, health_action_name(action));
+    if (len < (int)sizeof(alert))
+        deliver(alert, len, HEALTH_REPORT_ALERT);
+
+    if (action == HEALTH_ACTION_REBOOT)
+    {
+        lock();
+        rtc.pending = true;
+        snprintf(rtc.task, sizeof(rtc.task), "%s", task);
+        rtc.age_ms = age_ms;
+        rtc.uptime_s = esp_timer_get_time() / 1000000;
+        rtc.reboots++;
+        rtc.consecutive++;
+        unlock();
+        if (recovery_callback != NULL)
+            recovery_callback(action, task, recovery_ctx);
+        esp_restart();
+    }
+
+    esp_err_t err = recovery_callback != NULL ? recovery_callback(action, task, recovery_ctx) : ESP_ERR_NOT_SUPPORTED;
+    if (err != ESP_OK)
+        ESP_LOGW(TAG, "No se pudo %s: %s", health_action_name(action), esp_err_to_name(err));
+}
+
+/************************************************************************/
+/* Busca la tarea mas atrasada. Sin atrasos la escalada vuelve a cero;  */
+/* con alguno, la primera accion es inmediata y las siguientes esperan  */
+/* HEALTH_SUPERVISOR_ESCALATE_MS a que la tarea vuelva a latir. Despues */
+/* de HEALTH_SUPERVISOR_MAX_REBOOTS reinicios seguidos la escalada no   */
+/* pasa de reiniciar el Wi-Fi (un AP caido no se arregla reiniciando).  */
+/************************************************************************/
+static void check(void)
+{
+    int64_t now_us = esp_timer_get_time();
+    health_action_t action = HEALTH_ACTION_NONE;
+    char late_name[HEALTH_SUPERVISOR_NAME_LEN] = "";
+    uint32_t late_age_ms = 0;
+    bool recovered = false;
+
+    lock();
+    const beat_entry_t *late = NULL;
+    uint32_t late_over_ms = 0;
+    for (int i = 0; i < HEALTH_SUPERVISOR_MAX_TASKS; i++)
+    {
+        beat_entry_t *entry = &entries[i];
+        if (entry->name == NULL || entry->period_ms == 0)
+            continue;
+        uint32_t age_ms = (now_us - entry->last_beat_us) / 1000;
+        uint32_t deadline_ms = (uint64_t)entry->period_ms * HEALTH_SUPERVISOR_DEADLINE_PCT / 100;
+        if (age_ms <= deadline_ms)
+            continue;
+        if (!entry->late)
+        {
+            entry->late = true;
+            entry->missed++;
+        }
+        if (late == NULL || age_ms - deadline_ms > late_over_ms)
+        {
+            late = entry;
+            late_over_ms = age_ms - deadline_ms;
+            late_age_ms = age_ms;
+        }
+    }
+
+    if (late == NULL)
+    {
+        if (level != HEALTH_ACTION_NONE)
+        {
+            recovered = true;
+            level = HEALTH_ACTION_NONE;
+            actions[HEALTH_ACTION_NONE]++;
+        }
+        if (rtc.consecutive > 0 && now_us >= HEALTH_SUPERVISOR_STABLE_MS * 1000LL)
+            rtc.consecutive = 0;
+    }
+    else if (level == HEALTH_ACTION_NONE || now_us - action_us >= HEALTH_SUPERVISOR_ESCALATE_MS * 1000LL)
+    {
+        action = level < HEALTH_ACTION_REBOOT ? level + 1 : HEALTH_ACTION_REBOOT;
+        if (action == HEALTH_ACTION_REBOOT && rtc.consecutive >= HEALTH_SUPERVISOR_MAX_REBOOTS)
+            action = HEALTH_ACTION_RESTART_WIFI;
+        level = action;
+        action_us = now_us;
+        actions[action]++;
+        snprintf(late_name, sizeof(late_name), "%s", late->name);
+    }
+    unlock();
+
+    if (recovered)
+        ESP_LOGI(TAG, "Todas las tareas volvieron a latir");
+    if (action != HEALTH_ACTION_NONE)
+        act(action, late_name, late_age_ms);
+}
+
+/*****************************************************
+ *   Consultas y reportes                             *
+ ******************************************************/
+static int get_tasks(health_task_info_t *tasks, int max_tasks)
+{
+    int64_t now_us = esp_timer_get_time();
+    int count = 0;
+    lock();
+    for (int i = 0; i < HEALTH_SUPERVISOR_MAX_TASKS && count < max_tasks; i++)
+    {
+        const beat_entry_t *entry = &entries[i];
+        if (entry->name == NULL)
+            continue;
+        tasks[count++] = (health_task_info_t){
+            .name = entry->name,
+            .period_ms = entry->period_ms,
+            .beats = entry->beats,
+            .missed = entry->missed,
+            .age_ms = (now_us - entry->last_beat_us) / 1000,
+            .max_ms = entry->max_ms,
+            .p50_ms = health_latency_percentile(entry->latency, 50),
+            .p90_ms = health_latency_percentile(entry->latency, 90),
+            .p99_ms = health_latency_percentile(entry->latency, 99),
+            .late = entry->late,
+        };
+        // El balde da el limite superior; ningun intervalo supero al maximo medido
+        health_task_info_t *info = &tasks[count - 1];
+        if (info->p50_ms > info->max_ms)
+            info->p50_ms = info->max_ms;
+        if (info->p90_ms > info->max_ms)
+            info->p90_ms = info->max_ms;
+        if (info->p99_ms > info->max_ms)
+            info->p99_ms = info->max_ms;
+    }
+    unlock();
+    return count;
+}
+
+static void get_status(health_status_t *status)
+{
+    lock();
+    status->level = level;
+    memcpy(status->actions, actions, sizeof(actions));
+    status->boot = boot_info;
+    unlock();
+}
+
+int health_supervisor_format_report(char *buffer, size_t buffer_len)
+{
+    health_task_info_t tasks[HEALTH_SUPERVISOR_MAX_TASKS];
+    health_status_t status;
+    int count = get_tasks(tasks, HEALTH_SUPERVISOR_MAX_TASKS);
+    get_status(&status);
+
+    size_t len = snprintf(buffer, buffer_len, "{\"health\": {\"level\": %d, \"actions\": [%lu, %lu, %lu, %lu], \"tasks\": [",
+                          (int)status.level, (unsigned long)status.actions[HEALTH_ACTION_NONE],
+                          (unsigned long)status.actions[HEALTH_ACTION_RESTART_CLIENT],
+                          (unsigned long)status.actions[HEALTH_ACTION_RESTART_WIFI],
+                          (unsigned long)status.actions[HEALTH_ACTION_REBOOT]);
+    for (int i = 0; i < count; i++)
+        len += snprintf(len < buffer_len ? buffer + len : NULL, len < buffer_len ? buffer_len - len : 0,
+                        "%s[\"%s\", %lu, %lu, %lu, %lu, %lu, %lu]", i > 0 ? ", " : "", tasks[i].name,
+                        (unsigned long)tasks[i].period_ms, (unsigned long)tasks[i].p50_ms, (unsigned long)tasks[i].p90_ms,
+                        (unsigned long)tasks[i].p99_ms, (unsigned long)tasks[i].max_ms, (unsigned long)tasks[i].missed);
+    len += snprintf(len < buffer_len ? buffer + len : NULL, len < buffer_len ? buffer_len - len : 0, "]}}");
+    return (int)len;
+}
+
+/* Los percentiles del reporte son del periodo: despues se empieza de cero */
+static void report(void)
+{
+    int len = health_supervisor_format_report(report_buffer, sizeof(report_buffer));
+    lock();
+    for (int i = 0; i < HEALTH_SUPERVISOR_MAX_TASKS; i++)
+        memset(entries[i].latency, 0, sizeof(entries[i].latency));
+    unlock();
+    if (len >= (int)sizeof(report_buffer))
+    {
+        ESP_LOGW(TAG, "Reporte de %d bytes, no entra en HEALTH_SUPERVISOR_REPORT_MAX_LEN", len);
+        return;
+    }
+    ESP_LOGI(TAG, "%s", report_buffer);
+    deliver(report_buffer, len, HEALTH_REPORT_PERIODIC);
+}
+
+/* El motivo del arranque se reintenta en cada revision hasta que el callback lo entregue */
+static void report_boot(void)
+{
+    if (!boot_pending || report_callback == NULL)
+        return;
+    health_boot_info_t boot;
+    lock();
+    boot = boot_info;
+    unlock();
+
+    int len;
+    if (boot.by_supervisor)
+        len = snprintf(report_buffer, sizeof(report_buffer),
+                       "{\"health_boot\": {\"reset\": \"%s\", \"task\": \"%s\", \"age_ms\": %lu, \"uptime_s\": %lu, "
+                       "\"reboots\": %lu}}",
+                       health_reset_reason_name(boot.reset_reason), boot.task, (unsigned long)boot.age_ms,
+                       (unsigned long)boot.uptime_s, (unsigned long)boot.reboots);
+    else
+        len = snprintf(report_buffer, sizeof(report_buffer), "{\"health_boot\": {\"reset\": \"%s\", \"reboots\": %lu}}",
+                       health_reset_reason_name(boot.reset_reason), (unsigned long)boot.reboots);
+    if (len >= (int)sizeof(report_buffer) || deliver(report_buffer, len, HEALTH_REPORT_BOOT))
+        boot_pending = false;
+}
+
+static void supervisor_task(void *param)
+{
+    resource_monitor.register_task(NULL, "health_supervisor", HEALTH_SUPERVISOR_TASK_STACK_SIZE);
+    TickType_t last_report = xTaskGetTickCount();
+    while (true)
+    {
+        check();
+        report_boot();
+        if (xTaskGetTickCount() - last_report >= pdMS_TO_TICKS(HEALTH_SUPERVISOR_REPORT_MS))
+        {
+            last_report = xTaskGetTickCount();
+            report();
+        }
+        vTaskDelay(pdMS_TO_TICKS(HEALTH_SUPERVISOR_CHECK_MS));
+    }
+}
+
+static esp_err_t start(void)
+{
+    if (supervisor_task_handle != NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    lock();
+    esp_reset_reason_t reset_reason = esp_reset_reason();
+    if (rtc.magic != HEALTH_SUPERVISOR_MAGIC || reset_reason == ESP_RST_POWERON)
+    {
+        memset(&rtc, 0, sizeof(rtc));
+        rtc.magic = HEALTH_SUPERVISOR_MAGIC;
+    }
+    boot_info = (health_boot_info_t){
+        .reset_reason = reset_reason,
+        .by_supervisor = rtc.pending,
+        .reboots = rtc.reboots,
+    };
+    if (rtc.pending)
+    {
+        memcpy(boot_info.task, rtc.task, sizeof(boot_info.task));
+        boot_info.task[sizeof(boot_info.task) - 1] = '\0';
+        boot_info.age_ms = rtc.age_ms;
+        boot_info.uptime_s = rtc.uptime_s;
+        rtc.pending = false;
+    }
+    boot_pending = true;
+    unlock();
+    if (boot_info.by_supervisor)
+        ESP_LOGW(TAG, "Reiniciado por el supervisor: %s sin latir hace %lu ms", boot_info.task,
+                 (unsigned long)boot_info.age_ms);
+
+#ifdef STATIC_ALLOCATION_MODE
+    supervisor_task_handle = xTaskCreateStatic(supervisor_task, "health_supervisor", HEALTH_SUPERVISOR_TASK_STACK_SIZE, NULL,
+                                               HEALTH_SUPERVISOR_TASK_PRIORITY, supervisor_task_stack, &supervisor_task_buffer);
+#else
+    if (xTaskCreate(supervisor_task, "health_supervisor", HEALTH_SUPERVISOR_TASK_STACK_SIZE, NULL,
+                    HEALTH_SUPERVISOR_TASK_PRIORITY, &supervisor_task_handle) != pdPASS)
+        supervisor_task_handle = NULL;
+#endif
+    if (supervisor_task_handle == NULL)
+        return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+/* Los callbacks se fijan antes de start(): la tarea los lee sin sincronizar */
+static void set_report_callback(health_report_callback_t callback, void *ctx)
+{
+    report_ctx = ctx;
+    report_callback = callback;
+}
+
+static void set_recovery_callback(health_recovery_callback_t callback, void *ctx)
+{
+    recovery_ctx = ctx;
+    recovery_callback = callback;
+}
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)            *
+ ******************************************************/
+const health_supervisor_t health_supervisor = {
+    // Health Supervisor Functions
+    .register_task = register_task,
+    .beat = beat,
+    .set_report_callback = set_report_callback,
+    .set_recovery_callback = set_recovery_callback,
+    .start = start,
+    .check = check,
+    .get_tasks = get_tasks,
+    .get_status = get_status,
+};
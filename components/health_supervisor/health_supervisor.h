@@ -0,0 +1,159 @@
+/*
+ * health_supervisor.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef HEALTH_SUPERVISOR_H_
+#define HEALTH_SUPERVISOR_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/* Latidos que se pueden registrar a la vez */
+#ifndef HEALTH_SUPERVISOR_MAX_TASKS
+#define HEALTH_SUPERVISOR_MAX_TASKS 8
+#endif
+#define HEALTH_SUPERVISOR_CHECK_MS 1000
+#ifndef HEALTH_SUPERVISOR_REPORT_MS
+#define HEALTH_SUPERVISOR_REPORT_MS (15 * 60 * 1000)
+#endif
+#define HEALTH_SUPERVISOR_TASK_STACK_SIZE (4096 * 1) // La accion de recuperacion corre en esta tarea
+#define HEALTH_SUPERVISOR_REPORT_MAX_LEN 768
+#define HEALTH_SUPERVISOR_ALERT_MAX_LEN 160
+#define HEALTH_SUPERVISOR_NAME_LEN 16 // Copia del nombre en RTC
+
+/* Plazo maximo de las esperas de una tarea supervisada: late al menos con este periodo */
+#ifndef HEALTH_SUPERVISOR_WAIT_MS
+#define HEALTH_SUPERVISOR_WAIT_MS (30 * 1000)
+#endif
+/* Un latido se pierde cuando pasa este porcentaje del periodo esperado */
+#ifndef HEALTH_SUPERVISOR_DEADLINE_PCT
+#define HEALTH_SUPERVISOR_DEADLINE_PCT 200
+#endif
+/* Si la tarea no vuelve a latir despues de una accion, se pasa a la siguiente */
+#ifndef HEALTH_SUPERVISOR_ESCALATE_MS
+#define HEALTH_SUPERVISOR_ESCALATE_MS (2 * 60 * 1000)
+#endif
+/* Reinicios seguidos sin un periodo estable; despues solo se reinicia el Wi-Fi */
+#ifndef HEALTH_SUPERVISOR_MAX_REBOOTS
+#define HEALTH_SUPERVISOR_MAX_REBOOTS 3
+#endif
+#ifndef HEALTH_SUPERVISOR_STABLE_MS
+#define HEALTH_SUPERVISOR_STABLE_MS (30 * 60 * 1000)
+#endif
+
+/* Histograma log-lineal de intervalos entre latidos, en ms: 4 baldes por */
+/* potencia de 2 (error menor al 25%), hasta 2^23 ms (2.3 h)              */
+#define HEALTH_LATENCY_SUB_BUCKETS 4
+#define HEALTH_LATENCY_MAGNITUDES 22
+#define HEALTH_LATENCY_BUCKETS (HEALTH_LATENCY_SUB_BUCKETS * HEALTH_LATENCY_MAGNITUDES)
+
+typedef enum
+{
+    HEALTH_ACTION_NONE = 0,
+    HEALTH_ACTION_RESTART_CLIENT, // Detener y volver a arrancar el cliente MQTT
+    HEALTH_ACTION_RESTART_WIFI,   // Detener y volver a arrancar el Wi-Fi
+    HEALTH_ACTION_REBOOT,         // esp_restart(), con el motivo en RTC
+    HEALTH_ACTION_COUNT,
+} health_action_t;
+
+typedef struct
+{
+    const char *name;
+    uint32_t period_ms;
+    uint32_t beats;
+    uint32_t missed;          // Veces que vencio el plazo
+    uint32_t age_ms;          // Desde el ultimo latido (o el registro)
+    uint32_t max_ms;          // Mayor intervalo entre latidos desde el arranque
+    uint32_t p50_ms;          // Percentiles del periodo de reporte actual
+    uint32_t p90_ms;
+    uint32_t p99_ms;
+    bool late;
+} health_task_info_t;
+
+/* Motivo del arranque, guardado en RTC por el reinicio anterior */
+typedef struct
+{
+    int reset_reason;         // esp_reset_reason()
+    bool by_supervisor;       // Lo reinicio el supervisor: los campos de abajo son validos
+    char task[HEALTH_SUPERVISOR_NAME_LEN];
+    uint32_t age_ms;          // Tiempo sin latir de esa tarea
+    uint32_t uptime_s;        // Tiempo encendido antes del reinicio
+    uint32_t reboots;         // Reinicios del supervisor desde el encendido
+} health_boot_info_t;
+
+typedef struct
+{
+    health_action_t level;    // Ultima accion de la escalada en curso; NONE si todas laten
+    uint32_t actions[HEALTH_ACTION_COUNT]; // Acciones desde el arranque (la de NONE: recuperaciones)
+    health_boot_info_t boot;
+} health_status_t;
+
+typedef enum
+{
+    HEALTH_REPORT_PERIODIC = 0,
+    HEALTH_REPORT_ALERT,      // Cada accion de la escalada
+    HEALTH_REPORT_BOOT,       // El motivo del arranque; se reintenta hasta que el callback lo entregue
+} health_report_kind_t;
+
+/* Devuelve false si no lo pudo entregar; solo se reintenta el de BOOT */
+typedef bool (*health_report_callback_t)(const char *json, int len, health_report_kind_t kind, void *ctx);
+/* Ejecuta la accion (con REBOOT: lo ultimo antes de esp_restart()); task es la tarea atrasada */
+typedef esp_err_t (*health_recovery_callback_t)(health_action_t action, const char *task, void *ctx);
+
+/************************************************************************/
+/* La siguiente estructura simula un objeto en C                        */
+/*                                                                      */
+/* Supervisor de vida. Cada tarea critica registra un latido con su     */
+/* periodo esperado y llama a beat() en cada vuelta de su loop; sus     */
+/* esperas tienen plazo (HEALTH_SUPERVISOR_WAIT_MS), asi una tarea sana */
+/* late aunque no haya trabajo. Una tarea de prioridad alta revisa cada */
+/* HEALTH_SUPERVISOR_CHECK_MS los plazos y, si alguno vencio, escala:   */
+/*                                                                      */
+/*   reiniciar el cliente MQTT -> reiniciar el Wi-Fi -> esp_restart()   */
+/*                                                                      */
+/* con HEALTH_SUPERVISOR_ESCALATE_MS entre un paso y el siguiente. Las  */
+/* dos primeras acciones las ejecuta el callback de recuperacion; antes */
+/* de reiniciar, la tarea atrasada queda en memoria RTC y el arranque   */
+/* siguiente la reporta:                                                */
+/*                                                                      */
+/*   {"health_boot": {"reset": "sw", "task": "app_main",                */
+/*                   "age_ms": 601000, "uptime_s": 5400, "reboots": 1}} */
+/*                                                                      */
+/* Cada HEALTH_SUPERVISOR_REPORT_MS entrega los percentiles del tiempo  */
+/* entre latidos de cada tarea en el periodo:                           */
+/*                                                                      */
+/*   {"health": {"level": 0, "actions": [0, 1, 0, 0],                   */
+/*     "tasks": [["app_main", periodo, p50, p90, p99, max, vencidos],   */
+/*               ...]}}                                                 */
+/************************************************************************/
+typedef struct
+{
+    // Health Supervisor Functions
+    int (*register_task)(const char *name, uint32_t period_ms); // Devuelve el id (-1 si no hay lugar); con 0 solo mide
+    void (*beat)(int id);
+    void (*set_report_callback)(health_report_callback_t callback, void *ctx);
+    void (*set_recovery_callback)(health_recovery_callback_t callback, void *ctx);
+    esp_err_t (*start)(void);
+    void (*check)(void); // Revisa ya, sin esperar a la tarea
+    int (*get_tasks)(health_task_info_t *tasks, int max_tasks);
+    void (*get_status)(health_status_t *status);
+} health_supervisor_t;
+
+extern const health_supervisor_t health_supervisor;
+
+/* Balde del histograma para un intervalo, y el mayor intervalo que cae en el balde */
+int health_latency_bucket(uint32_t interval_ms);
+uint32_t health_latency_bucket_limit(int bucket);
+/* percentile en [0, 100]; 0 si no hay muestras */
+uint32_t health_latency_percentile(const uint16_t *counts, uint32_t percentile);
+const char *health_action_name(health_action_t action);
+const char *health_reset_reason_name(int reset_reason);
+/* Arma el reporte periodico; devuelve el largo (o el que haria falta) */
+int health_supervisor_format_report(char *buffer, size_t buffer_len);
+
+#endif /* HEALTH_SUPERVISOR_H_ */
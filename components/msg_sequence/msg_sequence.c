@@ -0,0 +1,162 @@
+/*
+ * msg_sequence.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "nvs.h"
+
+#include "msg_sequence.h"
+
+#define RESERVED_KEY "reserved"
+/* RTC_NOINIT_ATTR no se inicializa en ningun reinicio; tras un           */
+/* encendido tiene basura: el estado solo vale si la verificacion         */
+/* coincide con los dos contadores.                                       */
+#define RTC_CHECK_KEY 0x5345514e43455121ULL
+
+static const char *TAG = "Msg sequence";
+
+// Proximo numero a entregar y ultimo numero cubierto por la reserva en NVS.
+// RTC_DATA_ATTR se volveria a cargar en cada reinicio por software o del watchdog.
+static uint64_t RTC_NOINIT_ATTR rtc_next;
+static uint64_t RTC_NOINIT_ATTR rtc_reserved;
+static uint64_t RTC_NOINIT_ATTR rtc_check;
+static bool RTC_NOINIT_ATTR resync_pending;
+
+static StaticSemaphore_t sequence_mutex_buffer;
+static SemaphoreHandle_t sequence_mutex = NULL;
+
+static void lock(void)
+{
+    if (sequence_mutex == NULL)
+        sequence_mutex = xSemaphoreCreateMutexStatic(&sequence_mutex_buffer);
+    xSemaphoreTake(sequence_mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(sequence_mutex);
+}
+
+static bool rtc_valid(void)
+{
+    return rtc_next != 0 && rtc_next <= rtc_reserved + 1 && rtc_check == (rtc_next ^ rtc_reserved ^ RTC_CHECK_KEY);
+}
+
+static void rtc_seal(void)
+{
+    rtc_check = rtc_next ^ rtc_reserved ^ RTC_CHECK_KEY;
+}
+
+/* Graba el final de un bloque nuevo a partir de rtc_next */
+static esp_err_t reserve_block(void)
+{
+    nvs_handle_t nvs;
+    uint64_t reserved = rtc_next + MSG_SEQUENCE_CHECKPOINT_BLOCK - 1;
+
+    esp_err_t err = nvs_open(MSG_SEQUENCE_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK)
+        return err;
+    err = nvs_set_u64(nvs, RESERVED_KEY, reserved);
+    if (err == ESP_OK)
+        err = nvs_commit(nvs);
+    nvs_close(nvs);
+
+    if (err == ESP_OK)
+        rtc_reserved = reserved;
+    return err;
+}
+
+/************************************************************************/
+/* Con el estado de RTC intacto (deep sleep, reinicio por software o    */
+/* del watchdog) no toca el NVS. Si no, sigue despues del ultimo bloque */
+/* reservado y reserva el siguiente.                                    */
+/************************************************************************/
+static esp_err_t initialize(void)
+{
+    lock();
+    if (esp_reset_reason() != ESP_RST_POWERON && rtc_valid())
+    {
+        unlock();
+        return ESP_OK;
+    }
+
+    uint64_t stored = 0;
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(MSG_SEQUENCE_NAMESPACE, NVS_READONLY, &nvs);
+    if (err == ESP_OK)
+    {
+        err = nvs_get_u64(nvs, RESERVED_KEY, &stored);
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
+    {
+        unlock();
+        ESP_LOGE(TAG, "Error leyendo la secuencia: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    rtc_next = stored + 1;
+    rtc_reserved = stored;
+    resync_pending = stored != 0;
+    err = reserve_block();
+    rtc_seal();
+    unlock();
+
+    ESP_LOGI(TAG, "Secuencia recuperada del NVS, sigue en %llu", (unsigned long long)rtc_next);
+    if (err != ESP_OK)
+        ESP_LOGE(TAG, "Error reservando bloque: %s", esp_err_to_name(err));
+    return err;
+}
+
+static uint64_t next(bool *resync)
+{
+    lock();
+    if (!rtc_valid())
+    {
+        unlock();
+        return 0;
+    }
+
+    // Fin del bloque: se reserva otro antes de entregar el numero
+    if (rtc_next > rtc_reserved)
+    {
+        esp_err_t err = reserve_block();
+        if (err != ESP_OK)
+            ESP_LOGE(TAG, "Error reservando bloque: %s", esp_err_to_name(err));
+    }
+
+    uint64_t value = rtc_next++;
+    if (rtc_reserved < value)
+        rtc_reserved = value; // Sin NVS: se sigue numerando, el proximo next() reintenta la reserva
+    if (resync != NULL)
+        *resync = resync_pending;
+    resync_pending = false;
+    rtc_seal();
+    unlock();
+    return value;
+}
+
+static uint64_t last(void)
+{
+    lock();
+    uint64_t value = rtc_valid() ? rtc_next - 1 : 0;
+    unlock();
+    return value;
+}
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)            *
+ ******************************************************/
+const msg_sequence_t msg_sequence = {
+    // Msg Sequence Functions
+    .initialize = initialize,
+    .next = next,
+    .last = last,
+};
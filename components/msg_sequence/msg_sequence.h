@@ -0,0 +1,46 @@
+/*
+ * msg_sequence.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef MSG_SEQUENCE_H_
+#define MSG_SEQUENCE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define MSG_SEQUENCE_NAMESPACE "msg_seq"
+
+/* Numeros que se reservan con cada escritura en NVS. Tras un corte de     */
+/* energia se sigue desde el final del bloque reservado: se saltean a lo   */
+/* sumo MSG_SEQUENCE_CHECKPOINT_BLOCK numeros, pero nunca se repite uno.   */
+#ifndef MSG_SEQUENCE_CHECKPOINT_BLOCK
+#define MSG_SEQUENCE_CHECKPOINT_BLOCK 256
+#endif
+
+/************************************************************************/
+/* La siguiente estructura simula un objeto en C                        */
+/*                                                                      */
+/* Numero de secuencia de 64 bits del dispositivo, estrictamente        */
+/* creciente, para que el backend detecte huecos y duplicados sin       */
+/* comparar contenidos. El contador vive en RTC_NOINIT (sobrevive al    */
+/* deep sleep y a los reinicios por software y del watchdog); el NVS    */
+/* solo guarda el final del bloque reservado, una escritura cada        */
+/* MSG_SEQUENCE_CHECKPOINT_BLOCK mensajes.                              */
+/************************************************************************/
+typedef struct
+{
+    // Msg Sequence Functions
+    esp_err_t (*initialize)(void); // Despues de nvs_flash_init()
+    /* Proximo numero (desde 1). resync, si no es NULL, es true en el primero */
+    /* tras recuperar el contador del NVS: el salto previo no son perdidas.    */
+    uint64_t (*next)(bool *resync);
+    uint64_t (*last)(void); // Ultimo numero entregado, 0 si ninguno
+} msg_sequence_t;
+
+extern const msg_sequence_t msg_sequence;
+
+#endif /* MSG_SEQUENCE_H_ */
@@ -0,0 +1,355 @@
+/*
+ * resource_monitor.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_system.h"
+
+#include "resource_monitor.h"
+
+static const char *TAG = "Resource monitor";
+
+typedef struct
+{
+    TaskHandle_t task;  // NULL si la tarea termino
+    const char *name;   // NULL: lugar libre
+    uint32_t stack_size;
+    uint32_t min_free;
+    bool alive;
+    bool alerted;
+} task_entry_t;
+
+/* Alerta pendiente: se entrega fuera del mutex */
+typedef struct
+{
+    const char *name;
+    uint32_t free;
+} stack_alert_t;
+
+static task_entry_t entries[RESOURCE_MONITOR_MAX_TASKS];
+static resource_heap_info_t heap_info;
+static bool heap_alerted = false;
+
+static resource_report_callback_t report_callback = NULL;
+static void *report_ctx = NULL;
+
+static SemaphoreHandle_t monitor_mutex = NULL;
+static StaticSemaphore_t monitor_mutex_buffer;
+static portMUX_TYPE monitor_mutex_init = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t monitor_task_handle = NULL;
+static char report_buffer[RESOURCE_MONITOR_REPORT_MAX_LEN];
+
+#ifdef STATIC_ALLOCATION_MODE
+static StackType_t monitor_task_stack[RESOURCE_MONITOR_TASK_STACK_SIZE];
+static StaticTask_t monitor_task_buffer;
+#endif
+
+/* Las tareas se registran antes de start(): el mutex se crea al primer uso */
+static void lock(void)
+{
+    if (monitor_mutex == NULL)
+    {
+        taskENTER_CRITICAL(&monitor_mutex_init);
+        if (monitor_mutex == NULL)
+            monitor_mutex = xSemaphoreCreateMutexStatic(&monitor_mutex_buffer);
+        taskEXIT_CRITICAL(&monitor_mutex_init);
+    }
+    xSemaphoreTake(monitor_mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(monitor_mutex);
+}
+
+uint32_t resource_monitor_recommended_stack(uint32_t peak_used)
+{
+    uint32_t recommended = peak_used + peak_used * RESOURCE_MONITOR_STACK_MARGIN_PCT / 100;
+    recommended = (recommended + RESOURCE_MONITOR_STACK_ROUND - 1) / RESOURCE_MONITOR_STACK_ROUND * RESOURCE_MONITOR_STACK_ROUND;
+    return recommended < RESOURCE_MONITOR_STACK_MIN ? RESOURCE_MONITOR_STACK_MIN : recommended;
+}
+
+/* Lee el stack libre de una entrada viva; se llama con el mutex tomado */
+static void sample_entry(task_entry_t *entry)
+{
+    uint32_t free = uxTaskGetStackHighWaterMark(entry->task);
+    if (free < entry->min_free)
+        entry->min_free = free;
+}
+
+/*****************************************************
+ *   Registro de tareas                               *
+ ******************************************************/
+static void register_task(TaskHandle_t task, const char *name, uint32_t stack_size)
+{
+    if (task == NULL)
+        task = xTaskGetCurrentTaskHandle();
+    if (task == NULL || name == NULL)
+        return; // Hilo que no es una tarea de FreeRTOS (host)
+
+    lock();
+    // La misma tarea registrada de nuevo, o una que reemplaza a otra terminada con el mismo nombre
+    task_entry_t *entry = NULL;
+    for (int i = 0; i < RESOURCE_MONITOR_MAX_TASKS && entry == NULL; i++)
+        if (entries[i].name != NULL && entries[i].task == task)
+            entry = &entries[i];
+    for (int i = 0; i < RESOURCE_MONITOR_MAX_TASKS && entry == NULL; i++)
+        if (entries[i].name != NULL && !entries[i].alive && strcmp(entries[i].name, name) == 0)
+            entry = &entries[i];
+    for (int i = 0; i < RESOURCE_MONITOR_MAX_TASKS && entry == NULL; i++)
+        if (entries[i].name == NULL)
+        {
+            entry = &entries[i];
+            entry->min_free = UINT32_MAX;
+        }
+
+    if (entry == NULL)
+    {
+        unlock();
+        ESP_LOGW(TAG, "Sin lugar para la tarea %s (RESOURCE_MONITOR_MAX_TASKS)", name);
+        return;
+    }
+    entry->task = task;
+    entry->name = name;
+    entry->stack_size = stack_size;
+    entry->alive = true;
+    sample_entry(entry);
+    unlock();
+}
+
+/* Ultima medicion de la tarea que llama; despues ya no se consulta su handle */
+static void task_exit(void)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    if (task == NULL)
+        return;
+    lock();
+    for (int i = 0; i < RESOURCE_MONITOR_MAX_TASKS; i++)
+        if (entries[i].name != NULL && entries[i].task == task && entries[i].alive)
+        {
+            sample_entry(&entries[i]);
+            entries[i].alive = false;
+            entries[i].task = NULL;
+        }
+    unlock();
+}
+
+/*****************************************************
+ *   Mediciones y alertas                             *
+ ******************************************************/
+static void deliver(const char *json, int len, bool alert)
+{
+    if (report_callback != NULL && len > 0 && len < RESOURCE_MONITOR_REPORT_MAX_LEN)
+        report_callback(json, len, alert, report_ctx);
+}
+
+static void sample(void)
+{
+    stack_alert_t stack_alerts[RESOURCE_MONITOR_MAX_TASKS];
+    int stack_alert_count = 0;
+    bool heap_alert = false;
+
+    lock();
+    for (int i = 0; i < RESOURCE_MONITOR_MAX_TASKS; i++)
+    {
+        task_entry_t *entry = &entries[i];
+        if (entry->name == NULL || !entry->alive)
+            continue;
+        sample_entry(entry);
+        if (entry->min_free < RESOURCE_MONITOR_STACK_ALERT_BYTES && !entry->alerted)
+        {
+            entry->alerted = true;
+            stack_alerts[stack_alert_count].name = entry->name;
+            stack_alerts[stack_alert_count].free = entry->min_free;
+            stack_alert_count++;
+        }
+    }
+
+    // Un heap libre en 0 indica que no hay medicion (host)
+    uint32_t free = esp_get_free_heap_size();
+    uint32_t block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    if (free > 0)
+    {
+        heap_info.free = free;
+        heap_info.min_free = esp_get_minimum_free_heap_size();
+        heap_info.largest_block = block;
+        if (heap_info.samples == 0 || block < heap_info.min_largest_block)
+            heap_info.min_largest_block = block;
+        heap_info.samples++;
+
+        bool low = free < RESOURCE_MONITOR_HEAP_ALERT_BYTES || block < RESOURCE_MONITOR_BLOCK_ALERT_BYTES;
+        // Se vuelve a armar cuando se recupera con margen, para no alertar en cada oscilacion
+        bool recovered = free >= RESOURCE_MONITOR_HEAP_ALERT_BYTES * 5 / 4 && block >= RESOURCE_MONITOR_BLOCK_ALERT_BYTES * 5 / 4;
+        if (low && !heap_alerted)
+        {
+            heap_alerted = true;
+            heap_alert = true;
+        }
+        else if (recovered)
+            heap_alerted = false;
+    }
+    heap_info.alerts += stack_alert_count + (heap_alert ? 1 : 0);
+    unlock();
+
+    char alert[RESOURCE_MONITOR_ALERT_MAX_LEN];
+    for (int i = 0; i < stack_alert_count; i++)
+    {
+        ESP_LOGW(TAG, "Stack casi agotado en %s: quedan %lu bytes", stack_alerts[i].name,
+                 (unsigned long)stack_alerts[i].free);
+        int len = snprintf(alert, sizeof(alert), "{\"alert\": \"stack\", \"task\": \"%s\", \"free\": %lu}",
+                           stack_alerts[i].name, (unsigned long)stack_alerts[i].free);
+        if (len < (int)sizeof(alert))
+            deliver(alert, len, true);
+    }
+    if (heap_alert)
+    {
+        ESP_LOGW(TAG, "Heap bajo: %lu bytes libres, mayor bloque %lu", (unsigned long)free, (unsigned long)block);
+        int len = snprintf(alert, sizeof(alert), "{\"alert\": \"heap\", \"free\": %lu, \"block\": %lu}",
+                           (unsigned long)free, (unsigned long)block);
+        if (len < (int)sizeof(alert))
+            deliver(alert, len, true);
+    }
+}
+
+/************************************************************************/
+/* Copia el registro agrupado por nombre: el tamano y el pico son los   */
+/* mayores del grupo, y el grupo sigue vivo si alguna lo esta           */
+/************************************************************************/
+static int get_tasks(resource_task_info_t *tasks, int max_tasks)
+{
+    uint32_t peaks[RESOURCE_MONITOR_MAX_TASKS];
+    int count = 0;
+    lock();
+    for (int i = 0; i < RESOURCE_MONITOR_MAX_TASKS; i++)
+    {
+        const task_entry_t *entry = &entries[i];
+        if (entry->name == NULL)
+            continue;
+        uint32_t peak = entry->min_free < entry->stack_size ? entry->stack_size - entry->min_free : 0;
+
+        int j = 0;
+        while (j < count && strcmp(tasks[j].name, entry->name) != 0)
+            j++;
+        if (j == count)
+        {
+            if (count == max_tasks || count == RESOURCE_MONITOR_MAX_TASKS)
+                continue;
+            tasks[count] = (resource_task_info_t){.name = entry->name};
+            peaks[count++] = 0;
+        }
+        if (entry->stack_size > tasks[j].stack_size)
+            tasks[j].stack_size = entry->stack_size;
+        if (peak > peaks[j])
+            peaks[j] = peak;
+        tasks[j].alive |= entry->alive;
+    }
+    unlock();
+
+    for (int j = 0; j < count; j++)
+    {
+        tasks[j].min_free = tasks[j].stack_size - peaks[j];
+        tasks[j].recommended = resource_monitor_recommended_stack(peaks[j]);
+    }
+    return count;
+}
+
+static void get_heap(resource_heap_info_t *heap)
+{
+    lock();
+    *heap = heap_info;
+    unlock();
+}
+
+int resource_monitor_format_report(char *buffer, size_t buffer_len)
+{
+    resource_task_info_t tasks[RESOURCE_MONITOR_MAX_TASKS];
+    resource_heap_info_t heap;
+    int count = get_tasks(tasks, RESOURCE_MONITOR_MAX_TASKS);
+    get_heap(&heap);
+
+    size_t len = snprintf(buffer, buffer_len, "{\"res\": {\"heap\": [%lu, %lu, %lu, %lu], \"tasks\": [",
+                          (unsigned long)heap.free, (unsigned long)heap.min_free, (unsigned long)heap.largest_block,
+                          (unsigned long)heap.min_largest_block);
+    for (int i = 0; i < count; i++)
+        len += snprintf(len < buffer_len ? buffer + len : NULL, len < buffer_len ? buffer_len - len : 0,
+                        "%s[\"%s\", %lu, %lu, %lu]", i > 0 ? ", " : "", tasks[i].name,
+                        (unsigned long)tasks[i].stack_size, (unsigned long)(tasks[i].stack_size - tasks[i].min_free),
+                        (unsigned long)tasks[i].recommended);
+    len += snprintf(len < buffer_len ? buffer + len : NULL, len < buffer_len ? buffer_len - len : 0, "]}}");
+    return (int)len;
+}
+
+static void report(void)
+{
+    int len = resource_monitor_format_report(report_buffer, sizeof(report_buffer));
+    if (len >= (int)sizeof(report_buffer))
+    {
+        ESP_LOGW(TAG, "Reporte de %d bytes, no entra en RESOURCE_MONITOR_REPORT_MAX_LEN", len);
+        return;
+    }
+    ESP_LOGI(TAG, "%s", report_buffer);
+    deliver(report_buffer, len, false);
+}
+
+static void monitor_task(void *param)
+{
+    register_task(NULL, "resource_monitor", RESOURCE_MONITOR_TASK_STACK_SIZE);
+    TickType_t last_report = xTaskGetTickCount();
+    while (true)
+    {
+        sample();
+        if (xTaskGetTickCount() - last_report >= pdMS_TO_TICKS(RESOURCE_MONITOR_REPORT_MS))
+        {
+            last_report = xTaskGetTickCount();
+            report();
+        }
+        vTaskDelay(pdMS_TO_TICKS(RESOURCE_MONITOR_SAMPLE_MS));
+    }
+}
+
+static esp_err_t start(void)
+{
+    if (monitor_task_handle != NULL)
+        return ESP_ERR_INVALID_STATE;
+
+#ifdef STATIC_ALLOCATION_MODE
+    monitor_task_handle = xTaskCreateStatic(monitor_task, "resource_monitor", RESOURCE_MONITOR_TASK_STACK_SIZE, NULL, 1,
+                                            monitor_task_stack, &monitor_task_buffer);
+#else
+    if (xTaskCreate(monitor_task, "resource_monitor", RESOURCE_MONITOR_TASK_STACK_SIZE, NULL, 1, &monitor_task_handle) != pdPASS)
+        monitor_task_handle = NULL;
+#endif
+    if (monitor_task_handle == NULL)
+        return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+/* El callback se fija antes de start(): la tarea lo lee sin sincronizar */
+static void set_report_callback(resource_report_callback_t callback, void *ctx)
+{
+    report_ctx = ctx;
+    report_callback = callback;
+}
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)            *
+ ******************************************************/
+const resource_monitor_t resource_monitor = {
+    // Resource Monitor Functions
+    .register_task = register_task,
+    .task_exit = task_exit,
+    .set_report_callback = set_report_callback,
+    .start = start,
+    .sample = sample,
+    .get_tasks = get_tasks,
+    .get_heap = get_heap,
+};
@@ -0,0 +1,109 @@
+/*
+ * resource_monitor.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef RESOURCE_MONITOR_H_
+#define RESOURCE_MONITOR_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/* Tareas que se pueden registrar a la vez (las de todas las instancias) */
+#ifndef RESOURCE_MONITOR_MAX_TASKS
+#define RESOURCE_MONITOR_MAX_TASKS 16
+#endif
+#define RESOURCE_MONITOR_SAMPLE_MS (5 * 1000)
+#ifndef RESOURCE_MONITOR_REPORT_MS
+#define RESOURCE_MONITOR_REPORT_MS (15 * 60 * 1000)
+#endif
+#define RESOURCE_MONITOR_TASK_STACK_SIZE (4096 * 1) // El callback del reporte puede publicar
+
+/* Umbrales de alerta */
+#ifndef RESOURCE_MONITOR_STACK_ALERT_BYTES
+#define RESOURCE_MONITOR_STACK_ALERT_BYTES 512 // Stack libre minimo de una tarea
+#endif
+#ifndef RESOURCE_MONITOR_HEAP_ALERT_BYTES
+#define RESOURCE_MONITOR_HEAP_ALERT_BYTES (16 * 1024) // Heap libre
+#endif
+#ifndef RESOURCE_MONITOR_BLOCK_ALERT_BYTES
+#define RESOURCE_MONITOR_BLOCK_ALERT_BYTES (4 * 1024) // Mayor bloque libre (fragmentacion)
+#endif
+
+/* Stack recomendado: el pico observado mas un margen, redondeado */
+#define RESOURCE_MONITOR_STACK_MARGIN_PCT 25
+#define RESOURCE_MONITOR_STACK_ROUND 256
+#define RESOURCE_MONITOR_STACK_MIN 2048
+
+#define RESOURCE_MONITOR_REPORT_MAX_LEN 768
+#define RESOURCE_MONITOR_ALERT_MAX_LEN 128
+
+typedef struct
+{
+    const char *name;
+    uint32_t stack_size;    // Bytes, como se paso a xTaskCreate
+    uint32_t min_free;      // Menor stack libre observado (bytes)
+    uint32_t recommended;   // Stack sugerido a partir de ese pico
+    bool alive;             // false: la tarea termino (queda su pico)
+} resource_task_info_t;
+
+typedef struct
+{
+    uint32_t free;
+    uint32_t min_free;      // Minimo desde el arranque
+    uint32_t largest_block;
+    uint32_t min_largest_block;
+    uint32_t samples;
+    uint32_t alerts;
+} resource_heap_info_t;
+
+/* Recibe el reporte periodico (alert = false) y cada alerta (alert = true), en JSON */
+typedef void (*resource_report_callback_t)(const char *json, int len, bool alert, void *ctx);
+
+/************************************************************************/
+/* La siguiente estructura simula un objeto en C                        */
+/*                                                                      */
+/* Monitor de stacks y heap. Cada tarea de los componentes se registra  */
+/* al empezar (register_task con NULL: la que llama) y, si termina,     */
+/* llama a task_exit() antes de vTaskDelete(NULL). Una tarea de baja    */
+/* prioridad mide cada RESOURCE_MONITOR_SAMPLE_MS el stack libre minimo */
+/* (uxTaskGetStackHighWaterMark) de cada una, el heap libre, el minimo  */
+/* historico y el mayor bloque; cada RESOURCE_MONITOR_REPORT_MS entrega */
+/* un reporte compacto con el stack recomendado de cada tarea (las que  */
+/* comparten nombre, como los workers de jwt_signer, van juntas):       */
+/*                                                                      */
+/*   {"res": {"heap": [libre, minimo, bloque, bloque minimo],           */
+/*            "tasks": [["mqtt_app_task", tamano, pico, sugerido],      */
+/*                      ...]}}                                          */
+/*                                                                      */
+/* Al cruzar un umbral entrega una alerta, una vez por tarea (el pico   */
+/* no baja) y de nuevo para el heap si se recupero y volvio a caer:     */
+/*                                                                      */
+/*   {"alert": "stack", "task": "go_sleep_task", "free": 380}           */
+/*   {"alert": "heap", "free": 15000, "block": 9000}                    */
+/************************************************************************/
+typedef struct
+{
+    // Resource Monitor Functions
+    void (*register_task)(TaskHandle_t task, const char *name, uint32_t stack_size);
+    void (*task_exit)(void);
+    void (*set_report_callback)(resource_report_callback_t callback, void *ctx);
+    esp_err_t (*start)(void);
+    void (*sample)(void); // Mide ya, sin esperar a la tarea
+    int (*get_tasks)(resource_task_info_t *tasks, int max_tasks);
+    void (*get_heap)(resource_heap_info_t *heap);
+} resource_monitor_t;
+
+extern const resource_monitor_t resource_monitor;
+
+uint32_t resource_monitor_recommended_stack(uint32_t peak_used);
+/* Arma el reporte periodico; devuelve el largo (o el que haria falta) */
+int resource_monitor_format_report(char *buffer, size_t buffer_len);
+
+#endif /* RESOURCE_MONITOR_H_ */
@@ -0,0 +1,365 @@
+/*
+ * sample_history.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "cJSON.h"
+
+#include "sample_history.h"
+#include "resource_monitor.h"
+#include "sntp_time.h"
+
+static const char *TAG = "Sample history";
+
+/* Peor caso de una muestra codificada: 10 + 3 + 3 + 5 bytes */
+#define RECORD_MAX_ENCODED 21
+
+static clearblade_client_t *history_client = NULL;
+static QueueHandle_t history_queue = NULL;
+static TaskHandle_t history_task_handle = NULL;
+static sample_history_stats_t stats;
+
+#ifdef STATIC_ALLOCATION_MODE
+static StaticQueue_t history_queue_buffer;
+static uint8_t history_queue_storage[SAMPLE_HISTORY_QUEUE_LEN * sizeof(sample_history_request_t)];
+static StackType_t history_task_stack[SAMPLE_HISTORY_TASK_STACK_SIZE];
+static StaticTask_t history_task_buffer;
+#endif
+
+// Un bloque y el cursor: lo unico que ocupa una respuesta, sea cual sea el rango
+static uint8_t chunk[SAMPLE_HISTORY_CHUNK_MAX];
+static sample_store_cursor_t cursor;
+
+/*****************************************************
+ *   Codificacion                                     *
+ ******************************************************/
+static size_t put_varint(uint8_t *out, uint64_t value)
+{
+    size_t len = 0;
+    while (value >= 0x80)
+    {
+        out[len++] = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    out[len++] = (uint8_t)value;
+    return len;
+}
+
+static uint64_t zigzag(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/* Estado del bloque en armado; las diferencias se reinician en cada bloque */
+typedef struct
+{
+    size_t len;
+    uint16_t count;
+    sample_record_t previous;
+    int64_t previous_dt;
+} chunk_encoder_t;
+
+static void chunk_begin(chunk_encoder_t *encoder, uint16_t id, uint16_t index)
+{
+    chunk[0] = SAMPLE_HISTORY_MAGIC;
+    chunk[1] = SAMPLE_HISTORY_VERSION;
+    chunk[2] = id;
+    chunk[3] = id >> 8;
+    chunk[4] = index;
+    chunk[5] = index >> 8;
+    encoder->len = SAMPLE_HISTORY_CHUNK_HEADER;
+    encoder->count = 0;
+    encoder->previous_dt = 0;
+}
+
+static bool chunk_full(const chunk_encoder_t *encoder)
+{
+    return encoder->count >= SAMPLE_HISTORY_CHUNK_RECORDS_MAX || encoder->len + RECORD_MAX_ENCODED > SAMPLE_HISTORY_CHUNK_MAX;
+}
+
+static void chunk_add(chunk_encoder_t *encoder, const sample_record_t *record)
+{
+    uint8_t *out = chunk + encoder->len;
+    size_t len = 0;
+    if (encoder->count == 0)
+    {
+        len += put_varint(out + len, (uint64_t)record->time_ms);
+        len += put_varint(out + len, zigzag(record->temp_centi));
+        len += put_varint(out + len, record->hum_centi);
+        len += put_varint(out + len, record->press_pa);
+    }
+    else
+    {
+        int64_t dt = record->time_ms - encoder->previous.time_ms;
+        len += put_varint(out + len, zigzag(dt - encoder->previous_dt));
+        len += put_varint(out + len, zigzag((int32_t)record->temp_centi - encoder->previous.temp_centi));
+        len += put_varint(out + len, zigzag((int32_t)record->hum_centi - encoder->previous.hum_centi));
+        len += put_varint(out + len, zigzag((int64_t)record->press_pa - encoder->previous.press_pa));
+        encoder->previous_dt = dt;
+    }
+    encoder->previous = *record;
+    encoder->len += len;
+    encoder->count++;
+}
+
+static size_t chunk_finish(chunk_encoder_t *encoder, uint8_t flags)
+{
+    chunk[6] = encoder->count;
+    chunk[7] = encoder->count >> 8;
+    chunk[8] = flags;
+    return encoder->len;
+}
+
+static bool get_varint(const uint8_t *data, size_t len, size_t *offset, uint64_t *value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 64 && *offset < len; shift += 7)
+    {
+        uint8_t byte = data[(*offset)++];
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+int sample_history_decode(const uint8_t *data, size_t len, sample_history_chunk_info_t *info, sample_record_t *records,
+                          size_t max_records)
+{
+    if (len < SAMPLE_HISTORY_CHUNK_HEADER || data[0] != SAMPLE_HISTORY_MAGIC || data[1] != SAMPLE_HISTORY_VERSION)
+        return -1;
+    info->id = data[2] | (uint16_t)data[3] << 8;
+    info->index = data[4] | (uint16_t)data[5] << 8;
+    info->count = data[6] | (uint16_t)data[7] << 8;
+    info->flags = data[8];
+    if (info->count > max_records)
+        return -1;
+
+    size_t offset = SAMPLE_HISTORY_CHUNK_HEADER;
+    int64_t previous_dt = 0;
+    for (uint16_t i = 0; i < info->count; i++)
+    {
+        uint64_t v[4];
+        for (int field = 0; field < 4; field++)
+        {
+            if (!get_varint(data, len, &offset, &v[field]))
+                return -1;
+        }
+        sample_record_t *record = &records[i];
+        if (i == 0)
+        {
+            record->time_ms = (int64_t)v[0];
+            record->temp_centi = (int16_t)unzigzag(v[1]);
+            record->hum_centi = (uint16_t)v[2];
+            record->press_pa = (uint32_t)v[3];
+            continue;
+        }
+        const sample_record_t *previous = &records[i - 1];
+        previous_dt += unzigzag(v[0]);
+        record->time_ms = previous->time_ms + previous_dt;
+        record->temp_centi = (int16_t)(previous->temp_centi + unzigzag(v[1]));
+        record->hum_centi = (uint16_t)(previous->hum_centi + unzigzag(v[2]));
+        record->press_pa = (uint32_t)(previous->press_pa + unzigzag(v[3]));
+    }
+    return offset == len ? info->count : -1;
+}
+
+/************************************************************************/
+/* Recorre el rango con el cursor y arma los bloques. Un bloque se      */
+/* entrega al llenarse, salvo el ultimo, que espera al final del rango  */
+/* para salir marcado.                                                  */
+/************************************************************************/
+int sample_history_stream(const sample_history_request_t *request, sample_history_sink_t sink, void *ctx)
+{
+    chunk_encoder_t encoder;
+    sample_record_t record;
+    uint16_t index = 0;
+    uint32_t sent = 0;
+    bool truncated = false;
+
+    if (sample_store.query_start(&cursor, request->from_ms, request->to_ms) != ESP_OK)
+        ESP_LOGW(TAG, "Serie cerrada: respuesta vacia al pedido %u", (unsigned)request->id);
+    chunk_begin(&encoder, request->id, index);
+    while (true)
+    {
+        bool more = !truncated && sample_store.query_next(&cursor, &record);
+        if (more && request->max_records != 0 && sent >= request->max_records)
+        {
+            truncated = true;
+            more = false;
+        }
+        if (more && !chunk_full(&encoder))
+        {
+            chunk_add(&encoder, &record);
+            sent++;
+            continue;
+        }
+
+        uint8_t flags = more ? 0 : SAMPLE_HISTORY_FLAG_LAST;
+        if (!more && (truncated || cursor.lost_sectors > 0))
+            flags |= SAMPLE_HISTORY_FLAG_INCOMPLETE;
+        size_t len = chunk_finish(&encoder, flags);
+        if (sink(chunk, len, ctx) != 0)
+            return -1;
+        stats.chunks++;
+        stats.bytes += len;
+        stats.records += encoder.count;
+        if (!more)
+            break;
+
+        chunk_begin(&encoder, request->id, ++index);
+        chunk_add(&encoder, &record);
+        sent++;
+    }
+    return sent;
+}
+
+/* Clave del primer nivel como entero en [min, max]; si no esta deja *value. false si no es un entero en rango */
+static bool get_integer(const cJSON *root, const char *key, int64_t min, int64_t max, int64_t *value)
+{
+    const cJSON *item = cJSON_GetObjectItem(root, key);
+    if (item == NULL)
+        return true;
+    // Rango antes de convertir: un double fuera de int64_t no tiene conversion definida
+    if (!cJSON_IsNumber(item) || item->valuedouble < (double)min || item->valuedouble > (double)max ||
+        item->valuedouble != (double)(int64_t)item->valuedouble)
+        return false;
+    *value = (int64_t)item->valuedouble;
+    return true;
+}
+
+bool sample_history_parse_request(const char *data, size_t len, int64_t now_ms, sample_history_request_t *request)
+{
+    int64_t id = 0, from_ms = 0, to_ms = INT64_MAX, max_records = 0, last_s = -1;
+
+    // Sin payload vale como {}: todas las claves son opcionales
+    if (len > 0)
+    {
+        cJSON *root = cJSON_ParseWithLength(data, len);
+        bool ok = cJSON_IsObject(root) && get_integer(root, "id", 0, UINT16_MAX, &id) &&
+                  get_integer(root, "from", 0, SAMPLE_HISTORY_TIME_MAX_MS, &from_ms) &&
+                  get_integer(root, "to", 0, SAMPLE_HISTORY_TIME_MAX_MS, &to_ms) &&
+                  get_integer(root, "max", 0, UINT32_MAX, &max_records) &&
+                  get_integer(root, "last_s", 0, SAMPLE_HISTORY_TIME_MAX_MS / 1000, &last_s);
+        cJSON_Delete(root);
+        if (!ok)
+            return false;
+    }
+
+    request->id = (uint16_t)id;
+    request->from_ms = from_ms;
+    request->to_ms = to_ms;
+    request->max_records = (uint32_t)max_records;
+    if (last_s >= 0)
+    {
+        if (now_ms <= 0)
+            return false;
+        // last_s ya esta acotado: el producto no desborda
+        request->from_ms = now_ms - last_s * 1000;
+    }
+    return request->from_ms <= request->to_ms;
+}
+
+/*****************************************************
+ *   Tarea                                            *
+ ******************************************************/
+static int publish_chunk(const uint8_t *data, size_t len, void *ctx)
+{
+    for (int attempt = 0; attempt < SAMPLE_HISTORY_PUBLISH_RETRIES; attempt++)
+    {
+        if (clearblade_client_publish(history_client, SAMPLE_HISTORY_SUBTOPIC, (const char *)data, len, 1) >= 0)
+            return 0;
+        vTaskDelay(SAMPLE_HISTORY_RETRY_DELAY_MS / portTICK_PERIOD_MS);
+    }
+    return -1;
+}
+
+static void history_task(void *param)
+{
+    sample_history_request_t request;
+    resource_monitor.register_task(NULL, "sample_history", SAMPLE_HISTORY_TASK_STACK_SIZE);
+    while (true)
+    {
+        if (xQueueReceive(history_queue, &request, portMAX_DELAY) != pdTRUE)
+            continue;
+        int sent = sample_history_stream(&request, publish_chunk, NULL);
+        if (sent < 0)
+        {
+            stats.aborted++;
+            ESP_LOGE(TAG, "Pedido %u interrumpido: no se pudo publicar", (unsigned)request.id);
+            continue;
+        }
+        ESP_LOGI(TAG, "Pedido %u: %d muestras enviadas", (unsigned)request.id, sent);
+    }
+}
+
+static esp_err_t start(clearblade_client_t *client)
+{
+    if (history_task_handle != NULL)
+        return ESP_ERR_INVALID_STATE;
+    history_client = client;
+
+#ifdef STATIC_ALLOCATION_MODE
+    history_queue = xQueueCreateStatic(SAMPLE_HISTORY_QUEUE_LEN, sizeof(sample_history_request_t), history_queue_storage,
+                                       &history_queue_buffer);
+    history_task_handle = xTaskCreateStatic(history_task, "sample_history", SAMPLE_HISTORY_TASK_STACK_SIZE, NULL, 2,
+                                            history_task_stack, &history_task_buffer);
+#else
+    history_queue = xQueueCreate(SAMPLE_HISTORY_QUEUE_LEN, sizeof(sample_history_request_t));
+    if (history_queue == NULL)
+        return ESP_ERR_NO_MEM;
+    if (xTaskCreate(history_task, "sample_history", SAMPLE_HISTORY_TASK_STACK_SIZE, NULL, 2, &history_task_handle) != pdPASS)
+        history_task_handle = NULL;
+#endif
+    return history_task_handle != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+/* Se llama desde la tarea MQTT: no lee la flash, solo encola */
+static bool handle_command(const char *topic, int topic_len, const char *data, int data_len)
+{
+    size_t command_len = strlen(SAMPLE_HISTORY_COMMAND);
+    if (topic_len < (int)command_len || memcmp(topic + topic_len - command_len, SAMPLE_HISTORY_COMMAND, command_len) != 0)
+        return false;
+
+    stats.requests++;
+    sample_history_request_t request;
+    if (!sample_history_parse_request(data, data_len, time_service.get_time_ms(), &request))
+    {
+        stats.rejected++;
+        ESP_LOGW(TAG, "Pedido de historial invalido: %.*s", data_len, data);
+        return true;
+    }
+    if (history_queue == NULL || xQueueSend(history_queue, &request, 0) != pdTRUE)
+    {
+        stats.rejected++;
+        ESP_LOGW(TAG, "Pedido de historial %u descartado: cola llena", (unsigned)request.id);
+    }
+    return true;
+}
+
+static void get_stats(sample_history_stats_t *out)
+{
+    *out = stats;
+}
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)            *
+ ******************************************************/
+const sample_history_t sample_history = {
+    // Sample History Functions
+    .start = start,
+    .handle_command = handle_command,
+    .get_stats = get_stats,
+};
@@ -0,0 +1,117 @@
+/*
+ * sample_history.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef SAMPLE_HISTORY_H_
+#define SAMPLE_HISTORY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "clearblade_connect.h"
+#include "sample_store.h"
+
+/* Pedido en /devices/<id>/commands/history; las respuestas van a events/history */
+#define SAMPLE_HISTORY_COMMAND "/commands/history"
+#define SAMPLE_HISTORY_SUBTOPIC "events/history"
+
+#define SAMPLE_HISTORY_TASK_STACK_SIZE (4096 * 1)
+#define SAMPLE_HISTORY_QUEUE_LEN 2
+#define SAMPLE_HISTORY_PUBLISH_RETRIES 3
+#define SAMPLE_HISTORY_RETRY_DELAY_MS 1000
+/* Mayor "from"/"to" aceptado: 2^53 ms, lo que un numero JSON representa exacto */
+#define SAMPLE_HISTORY_TIME_MAX_MS (1LL << 53)
+
+/************************************************************************/
+/* Formato de las respuestas. Cada bloque es un payload binario que se  */
+/* decodifica solo (con QoS 0 se puede perder otro sin arrastrar a      */
+/* este):                                                               */
+/*                                                                      */
+/*   u8 magic, u8 version, u16 id del pedido, u16 numero de bloque,     */
+/*   u16 muestras, u8 flags                                             */
+/*   primera muestra: hora, temp, hum y presion absolutas               */
+/*   siguientes: diferencia de la diferencia de hora (0 con periodo     */
+/*   fijo) y diferencias de temp, hum y presion                         */
+/*                                                                      */
+/* Los valores van como varints (LEB128), los que pueden ser negativos  */
+/* en zigzag. Una muestra cuesta entre 4 y 6 bytes contra 16 en la      */
+/* flash. El ultimo bloque lleva SAMPLE_HISTORY_FLAG_LAST, aunque no    */
+/* tenga muestras.                                                      */
+/************************************************************************/
+#define SAMPLE_HISTORY_MAGIC 0xB7
+#define SAMPLE_HISTORY_VERSION 1
+#define SAMPLE_HISTORY_CHUNK_HEADER 9
+#ifndef SAMPLE_HISTORY_CHUNK_MAX
+#define SAMPLE_HISTORY_CHUNK_MAX 512
+#endif
+#define SAMPLE_HISTORY_CHUNK_RECORDS_MAX 128
+#define SAMPLE_HISTORY_FLAG_LAST 0x01
+#define SAMPLE_HISTORY_FLAG_INCOMPLETE 0x02 // Se reciclaron sectores durante la lectura o se llego a "max"
+
+typedef struct
+{
+    uint16_t id;
+    int64_t from_ms;
+    int64_t to_ms;
+    uint32_t max_records; // 0 = sin limite
+} sample_history_request_t;
+
+typedef struct
+{
+    uint16_t id;
+    uint16_t index;
+    uint16_t count;
+    uint8_t flags;
+} sample_history_chunk_info_t;
+
+typedef struct
+{
+    uint32_t requests;
+    uint32_t rejected; // Pedido invalido o cola llena
+    uint32_t chunks;
+    uint32_t records;
+    uint32_t bytes;
+    uint32_t aborted;  // No se pudo publicar un bloque
+} sample_history_stats_t;
+
+/* Recibe cada bloque; distinto de 0 corta la respuesta */
+typedef int (*sample_history_sink_t)(const uint8_t *chunk, size_t len, void *ctx);
+
+/************************************************************************/
+/* La siguiente estructura simula un objeto en C                        */
+/*                                                                      */
+/* Atiende los pedidos de historial: el callback de datos del cliente   */
+/* los pasa a handle_command(), que solo los encola; una tarea recorre  */
+/* el rango con un cursor de sample_store y publica cada bloque al      */
+/* llenarse. En RAM nunca hay mas que un bloque y el buffer del cursor. */
+/*                                                                      */
+/* Pedido (JSON, todas las claves opcionales; una clave que no sea un   */
+/* entero en rango invalida el pedido):                                 */
+/*   {"id": 7, "from": <ms>, "to": <ms>, "last_s": 3600, "max": 500}    */
+/************************************************************************/
+typedef struct
+{
+    // Sample History Functions
+    esp_err_t (*start)(clearblade_client_t *client);
+    /* true si topic es un pedido de historial (valido o no) */
+    bool (*handle_command)(const char *topic, int topic_len, const char *data, int data_len);
+    void (*get_stats)(sample_history_stats_t *stats);
+} sample_history_t;
+
+extern const sample_history_t sample_history;
+
+/* Interpreta el pedido; now_ms resuelve "last_s" */
+bool sample_history_parse_request(const char *data, size_t len, int64_t now_ms, sample_history_request_t *request);
+/* Recorre el rango y entrega los bloques a sink. Usa buffers estaticos:  */
+/* una sola tarea a la vez. Devuelve las muestras enviadas, -1 si sink    */
+/* corto la respuesta.                                                    */
+int sample_history_stream(const sample_history_request_t *request, sample_history_sink_t sink, void *ctx);
+/* Decodifica un bloque; devuelve las muestras o -1 si es invalido */
+int sample_history_decode(const uint8_t *chunk, size_t len, sample_history_chunk_info_t *info, sample_record_t *records,
+                          size_t max_records);
+
+#endif /* SAMPLE_HISTORY_H_ */
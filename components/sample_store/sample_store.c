@@ -0,0 +1,516 @@
+/*
+ * sample_store.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+#include "sample_store.h"
+
+static const char *TAG = "Sample store";
+
+/* Indice disperso: una entrada por sector. seq == 0: borrado o invalido */
+typedef struct
+{
+    uint32_t seq;
+    int64_t base_ms;
+} sector_index_t;
+
+static sector_index_t sectors[SAMPLE_STORE_MAX_SECTORS];
+static uint32_t sector_count = 0;
+static uint32_t head = 0;      // Sector en escritura
+static uint32_t head_seq = 0;  // 0 = sin muestras
+static uint32_t head_slot = 0; // Proximo lugar libre del sector en escritura
+static int64_t last_ms = 0;
+static bool opened = false;
+
+static uint32_t appended = 0;
+static uint32_t rejected = 0;
+static uint32_t erases = 0;
+static uint32_t torn = 0;
+
+static StaticSemaphore_t store_mutex_buffer;
+static SemaphoreHandle_t store_mutex = NULL;
+
+static void lock(void)
+{
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(store_mutex);
+}
+
+/* CRC-16/CCITT-FALSE, bit a bit: los registros son de 14 bytes */
+static uint16_t crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    put_u16(p, v);
+    put_u16(p + 2, v >> 16);
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return p[0] | (uint16_t)p[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return get_u16(p) | (uint32_t)get_u16(p + 2) << 16;
+}
+
+static bool is_erased(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        if (data[i] != 0xFF)
+            return false;
+    return true;
+}
+
+static uint32_t slot_offset(uint32_t sector, uint32_t slot)
+{
+    return sector * SAMPLE_STORE_SECTOR_SIZE + SAMPLE_STORE_HEADER_SIZE + slot * SAMPLE_STORE_RECORD_SIZE;
+}
+
+/*****************************************************
+ *   Cabeceras y registros                            *
+ ******************************************************/
+static void encode_header(uint8_t *out, uint32_t seq, int64_t base_ms)
+{
+    memset(out, 0xFF, SAMPLE_STORE_HEADER_SIZE);
+    put_u32(out, SAMPLE_STORE_MAGIC);
+    put_u16(out + 4, SAMPLE_STORE_VERSION);
+    put_u16(out + 6, SAMPLE_STORE_RECORD_SIZE);
+    put_u32(out + 8, seq);
+    put_u32(out + 16, (uint32_t)base_ms);
+    put_u32(out + 20, (uint32_t)((uint64_t)base_ms >> 32));
+    put_u16(out + 24, crc16(out, 24));
+}
+
+/* Lee la cabecera del sector; false si esta borrado o danado */
+static bool read_header(uint32_t sector, sector_index_t *entry)
+{
+    uint8_t header[SAMPLE_STORE_HEADER_SIZE];
+    entry->seq = 0;
+    if (sample_store_flash_read(sector * SAMPLE_STORE_SECTOR_SIZE, header, sizeof(header)) != ESP_OK)
+        return false;
+    if (is_erased(header, sizeof(header)))
+        return false;
+    if (get_u32(header) != SAMPLE_STORE_MAGIC || get_u16(header + 4) != SAMPLE_STORE_VERSION ||
+        get_u16(header + 6) != SAMPLE_STORE_RECORD_SIZE || get_u16(header + 24) != crc16(header, 24) ||
+        get_u32(header + 8) == 0)
+    {
+        torn++;
+        return false;
+    }
+    entry->seq = get_u32(header + 8);
+    entry->base_ms = (int64_t)((uint64_t)get_u32(header + 16) | (uint64_t)get_u32(header + 20) << 32);
+    return true;
+}
+
+static void encode_record(uint8_t *out, const sample_record_t *record, int64_t base_ms)
+{
+    put_u32(out, (uint32_t)(record->time_ms - base_ms));
+    put_u16(out + 4, (uint16_t)record->temp_centi);
+    put_u16(out + 6, record->hum_centi);
+    put_u32(out + 8, record->press_pa);
+    put_u16(out + 12, 0xFFFF);
+    put_u16(out + 14, crc16(out, 14));
+}
+
+/* 1 registro valido, 0 lugar libre, -1 registro danado */
+static int decode_record(const uint8_t *in, int64_t base_ms, sample_record_t *record)
+{
+    if (is_erased(in, SAMPLE_STORE_RECORD_SIZE))
+        return 0;
+    if (get_u16(in + 14) != crc16(in, 14))
+        return -1;
+    record->time_ms = base_ms + get_u32(in);
+    record->temp_centi = (int16_t)get_u16(in + 4);
+    record->hum_centi = get_u16(in + 6);
+    record->press_pa = get_u32(in + 8);
+    return 1;
+}
+
+/************************************************************************/
+/* Ubica el final del sector en escritura. Los registros se graban en   */
+/* orden, asi que los lugares usados (validos o danados) forman un      */
+/* prefijo: alcanza con una busqueda binaria del primer lugar borrado.  */
+/************************************************************************/
+static esp_err_t recover_head(void)
+{
+    uint8_t buffer[SAMPLE_STORE_RECORD_SIZE];
+    uint32_t low = 0;
+    uint32_t high = SAMPLE_STORE_RECORDS_PER_SECTOR;
+    while (low < high)
+    {
+        uint32_t mid = (low + high) / 2;
+        esp_err_t err = sample_store_flash_read(slot_offset(head, mid), buffer, sizeof(buffer));
+        if (err != ESP_OK)
+            return err;
+        if (is_erased(buffer, sizeof(buffer)))
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    head_slot = low;
+
+    // La ultima muestra valida da la hora minima de la siguiente
+    last_ms = sectors[head].base_ms;
+    for (uint32_t slot = head_slot; slot > 0; slot--)
+    {
+        sample_record_t record;
+        esp_err_t err = sample_store_flash_read(slot_offset(head, slot - 1), buffer, sizeof(buffer));
+        if (err != ESP_OK)
+            return err;
+        if (decode_record(buffer, sectors[head].base_ms, &record) == 1)
+        {
+            last_ms = record.time_ms;
+            break;
+        }
+        torn++;
+    }
+    return ESP_OK;
+}
+
+/************************************************************************/
+/* Arma el indice con las cabeceras de todos los sectores. El sector en */
+/* escritura es el de mayor numero; un sector cuya cabecera quedo a     */
+/* medio grabar se trata como vacio y se vuelve a borrar al llegar a el.*/
+/************************************************************************/
+static esp_err_t store_open(const char *location)
+{
+    if (store_mutex == NULL)
+        store_mutex = xSemaphoreCreateMutexStatic(&store_mutex_buffer);
+    lock();
+    if (opened)
+    {
+        unlock();
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint32_t size;
+    esp_err_t err = sample_store_flash_open(location, &size);
+    if (err != ESP_OK)
+    {
+        unlock();
+        return err;
+    }
+    sector_count = size / SAMPLE_STORE_SECTOR_SIZE;
+    if (sector_count > SAMPLE_STORE_MAX_SECTORS)
+        sector_count = SAMPLE_STORE_MAX_SECTORS;
+    if (sector_count < 2)
+    {
+        sample_store_flash_close();
+        unlock();
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    appended = rejected = erases = torn = 0;
+    head = 0;
+    head_seq = 0;
+    head_slot = 0;
+    last_ms = 0;
+    for (uint32_t i = 0; i < sector_count; i++)
+    {
+        if (read_header(i, &sectors[i]) && sectors[i].seq > head_seq)
+        {
+            head = i;
+            head_seq = sectors[i].seq;
+        }
+    }
+    err = head_seq != 0 ? recover_head() : ESP_OK;
+    if (err != ESP_OK)
+    {
+        sample_store_flash_close();
+        unlock();
+        return err;
+    }
+    opened = true;
+    unlock();
+
+    ESP_LOGI(TAG, "%s: %lu sectores, escribiendo el %lu (numero %lu, %lu registros), %lu danados",
+             location != NULL ? location : "", (unsigned long)sector_count, (unsigned long)head, (unsigned long)head_seq,
+             (unsigned long)head_slot, (unsigned long)torn);
+    return ESP_OK;
+}
+
+static void store_close(void)
+{
+    if (store_mutex == NULL)
+        return;
+    lock();
+    if (opened)
+        sample_store_flash_close();
+    opened = false;
+    unlock();
+}
+
+static bool is_open(void)
+{
+    return opened;
+}
+
+/* Borra el sector siguiente y graba su cabecera; el mas viejo se pierde */
+static esp_err_t start_sector(int64_t base_ms)
+{
+    uint32_t next = head_seq != 0 ? (head + 1) % sector_count : head;
+    sectors[next].seq = 0;
+    esp_err_t err = sample_store_flash_erase(next * SAMPLE_STORE_SECTOR_SIZE, SAMPLE_STORE_SECTOR_SIZE);
+    if (err != ESP_OK)
+        return err;
+    erases++;
+
+    uint8_t header[SAMPLE_STORE_HEADER_SIZE];
+    encode_header(header, head_seq + 1, base_ms);
+    err = sample_store_flash_write(next * SAMPLE_STORE_SECTOR_SIZE, header, sizeof(header));
+    if (err != ESP_OK)
+        return err;
+
+    head = next;
+    head_seq++;
+    head_slot = 0;
+    sectors[head].seq = head_seq;
+    sectors[head].base_ms = base_ms;
+    return ESP_OK;
+}
+
+static esp_err_t append(const sample_record_t *record)
+{
+    if (!opened)
+        return ESP_ERR_INVALID_STATE;
+    lock();
+    if (head_seq != 0 && record->time_ms < last_ms)
+    {
+        rejected++;
+        unlock();
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = ESP_OK;
+    if (head_seq == 0 || head_slot >= SAMPLE_STORE_RECORDS_PER_SECTOR ||
+        (uint64_t)(record->time_ms - sectors[head].base_ms) > UINT32_MAX)
+        err = start_sector(record->time_ms);
+    if (err != ESP_OK)
+    {
+        unlock();
+        ESP_LOGE(TAG, "Error abriendo sector: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    uint8_t buffer[SAMPLE_STORE_RECORD_SIZE];
+    encode_record(buffer, record, sectors[head].base_ms);
+    err = sample_store_flash_write(slot_offset(head, head_slot), buffer, sizeof(buffer));
+    // Aun con error el lugar pudo quedar programado a medias: no se reutiliza
+    head_slot++;
+    if (err == ESP_OK)
+    {
+        last_ms = record->time_ms;
+        appended++;
+    }
+    unlock();
+    return err;
+}
+
+/*****************************************************
+ *   Consultas                                        *
+ ******************************************************/
+/* Sector valido de menor numero mayor que seq; sector_count si no hay */
+static uint32_t sector_after(uint32_t seq)
+{
+    uint32_t found = sector_count;
+    for (uint32_t i = 0; i < sector_count; i++)
+    {
+        if (sectors[i].seq > seq && (found == sector_count || sectors[i].seq < sectors[found].seq))
+            found = i;
+    }
+    return found;
+}
+
+static void cursor_enter(sample_store_cursor_t *cursor, uint32_t sector)
+{
+    cursor->sector = sector;
+    cursor->seq = sectors[sector].seq;
+    cursor->base_ms = sectors[sector].base_ms;
+    cursor->slot = 0;
+}
+
+static esp_err_t query_start(sample_store_cursor_t *cursor, int64_t from_ms, int64_t to_ms)
+{
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->from_ms = from_ms;
+    cursor->to_ms = to_ms;
+    cursor->done = true;
+    if (!opened)
+        return ESP_ERR_INVALID_STATE;
+
+    lock();
+    // Las horas crecen con el numero de sector: se empieza en el ultimo que arranca antes de from_ms
+    uint32_t start = sector_count;
+    for (uint32_t i = 0; i < sector_count; i++)
+    {
+        if (sectors[i].seq != 0 && sectors[i].base_ms < from_ms && (start == sector_count || sectors[i].seq > sectors[start].seq))
+            start = i;
+    }
+    if (start == sector_count)
+        start = sector_after(0);
+    if (start != sector_count && from_ms <= to_ms)
+    {
+        cursor->done = false;
+        cursor_enter(cursor, start);
+    }
+    unlock();
+    return ESP_OK;
+}
+
+/* Trae el proximo bloque de registros de la flash; false al terminar */
+static bool cursor_fill(sample_store_cursor_t *cursor)
+{
+    lock();
+    while (!cursor->done)
+    {
+        // La escritura dio la vuelta y borro el sector: se sigue en el mas viejo
+        if (cursor->sector >= sector_count || sectors[cursor->sector].seq != cursor->seq)
+        {
+            uint32_t next = sector_after(cursor->seq);
+            cursor->lost_sectors++;
+            if (next == sector_count)
+            {
+                cursor->done = true;
+                break;
+            }
+            cursor_enter(cursor, next);
+            continue;
+        }
+
+        uint32_t limit = cursor->sector == head ? head_slot : SAMPLE_STORE_RECORDS_PER_SECTOR;
+        if (cursor->slot >= limit)
+        {
+            uint32_t next = cursor->sector == head ? sector_count : sector_after(cursor->seq);
+            if (next == sector_count || sectors[next].base_ms > cursor->to_ms)
+            {
+                cursor->done = true;
+                break;
+            }
+            if (sectors[next].seq != cursor->seq + 1)
+                cursor->lost_sectors += sectors[next].seq - cursor->seq - 1;
+            cursor_enter(cursor, next);
+            continue;
+        }
+
+        uint32_t count = limit - cursor->slot;
+        if (count > SAMPLE_STORE_CURSOR_RECORDS)
+            count = SAMPLE_STORE_CURSOR_RECORDS;
+        esp_err_t err = sample_store_flash_read(slot_offset(cursor->sector, cursor->slot), cursor->buffer,
+                                                count * SAMPLE_STORE_RECORD_SIZE);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Error leyendo la flash: %s", esp_err_to_name(err));
+            cursor->done = true;
+            break;
+        }
+        cursor->slot += count;
+        cursor->buffered = count;
+        cursor->position = 0;
+        unlock();
+        return true;
+    }
+    unlock();
+    return false;
+}
+
+static bool query_next(sample_store_cursor_t *cursor, sample_record_t *record)
+{
+    while (true)
+    {
+        if (cursor->position >= cursor->buffered && !cursor_fill(cursor))
+            return false;
+
+        const uint8_t *raw = cursor->buffer + cursor->position++ * SAMPLE_STORE_RECORD_SIZE;
+        int rc = decode_record(raw, cursor->base_ms, record);
+        if (rc < 0)
+            torn++;
+        if (rc <= 0 || record->time_ms < cursor->from_ms)
+            continue;
+        if (record->time_ms > cursor->to_ms)
+        {
+            cursor->done = true;
+            cursor->buffered = 0;
+            return false;
+        }
+        return true;
+    }
+}
+
+static void get_stats(sample_store_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (store_mutex == NULL)
+        return;
+    lock();
+    stats->sectors = sector_count;
+    stats->head_seq = head_seq;
+    stats->head_records = head_slot;
+    for (uint32_t i = 0; i < sector_count; i++)
+    {
+        if (sectors[i].seq != 0)
+            stats->used_sectors++;
+    }
+    uint32_t oldest = sector_after(0);
+    stats->oldest_ms = oldest < sector_count ? sectors[oldest].base_ms : 0;
+    stats->newest_ms = head_seq != 0 ? last_ms : 0;
+    stats->appended = appended;
+    stats->rejected = rejected;
+    stats->erases = erases;
+    stats->torn = torn;
+    unlock();
+}
+
+void sample_store_make_record(sample_record_t *record, int64_t time_ms, float temp_c, float hum_pct, float press_hpa)
+{
+    float temp_centi = roundf(temp_c * 100.0f);
+    float hum_centi = roundf(hum_pct * 100.0f);
+    float press_pa = roundf(press_hpa * 100.0f);
+    record->time_ms = time_ms;
+    record->temp_centi = temp_centi > INT16_MAX ? INT16_MAX : temp_centi < INT16_MIN ? INT16_MIN : (int16_t)temp_centi;
+    record->hum_centi = hum_centi > UINT16_MAX ? UINT16_MAX : hum_centi < 0 ? 0 : (uint16_t)hum_centi;
+    record->press_pa = press_pa < 0 ? 0 : (uint32_t)press_pa;
+}
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)            *
+ ******************************************************/
+const sample_store_t sample_store = {
+    // Sample Store Functions
+    .open = store_open,
+    .close = store_close,
+    .is_open = is_open,
+    .append = append,
+    .query_start = query_start,
+    .query_next = query_next,
+    .get_stats = get_stats,
+};
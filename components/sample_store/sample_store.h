@@ -0,0 +1,138 @@
+/*
+ * sample_store.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef SAMPLE_STORE_H_
+#define SAMPLE_STORE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/************************************************************************/
+/* Formato en la flash. La particion se divide en sectores de borrado;  */
+/* cada sector empieza con una cabecera (numero de sector creciente y   */
+/* hora de la primera muestra) y sigue con registros de tamano fijo,    */
+/* que se graban en orden sobre la flash borrada (0xFF). Al llenarse un */
+/* sector se borra el siguiente, en forma circular: todos los sectores  */
+/* se borran la misma cantidad de veces y se pierde siempre el mas      */
+/* viejo.                                                               */
+/*                                                                      */
+/*   cabecera (32 bytes)                                                */
+/*     u32 magic, u16 version, u16 tamano de registro, u32 numero,      */
+/*     u32 0xFFFFFFFF, i64 hora base (ms), u16 crc, 6 x 0xFF            */
+/*   registro (16 bytes)                                                */
+/*     u32 ms desde la hora base, i16 temp (0.01 C), u16 hum (0.01 %HR),*/
+/*     u32 presion (Pa), u16 0xFFFF, u16 crc                            */
+/*                                                                      */
+/* Un registro o una cabecera a medio grabar (corte de energia) no      */
+/* pasan el CRC: se saltean, y el siguiente registro va en el lugar     */
+/* siguiente, sin volver a programar el danado.                         */
+/************************************************************************/
+#define SAMPLE_STORE_SECTOR_SIZE 4096
+#define SAMPLE_STORE_HEADER_SIZE 32
+#define SAMPLE_STORE_RECORD_SIZE 16
+#define SAMPLE_STORE_RECORDS_PER_SECTOR ((SAMPLE_STORE_SECTOR_SIZE - SAMPLE_STORE_HEADER_SIZE) / SAMPLE_STORE_RECORD_SIZE)
+#define SAMPLE_STORE_MAGIC 0x474f4c53 // "SLOG"
+#define SAMPLE_STORE_VERSION 1
+
+/* Sectores que se indexan en RAM (12 bytes cada uno); el resto de la     */
+/* particion no se usa                                                    */
+#ifndef SAMPLE_STORE_MAX_SECTORS
+#define SAMPLE_STORE_MAX_SECTORS 64
+#endif
+
+/* Registros que un cursor lee de la flash por vez */
+#ifndef SAMPLE_STORE_CURSOR_RECORDS
+#define SAMPLE_STORE_CURSOR_RECORDS 16
+#endif
+
+typedef struct
+{
+    int64_t time_ms;    // Epoch
+    int16_t temp_centi; // 0.01 C
+    uint16_t hum_centi; // 0.01 %HR
+    uint32_t press_pa;
+} sample_record_t;
+
+typedef struct
+{
+    uint32_t sectors;      // Sectores de la particion (hasta SAMPLE_STORE_MAX_SECTORS)
+    uint32_t used_sectors; // Con cabecera valida
+    uint32_t head_seq;     // Numero del sector en escritura, 0 si vacio
+    uint32_t head_records; // Lugares usados en ese sector
+    int64_t oldest_ms;     // Hora base del sector mas viejo
+    int64_t newest_ms;     // Ultima muestra grabada
+    uint32_t appended;     // Desde open()
+    uint32_t rejected;     // Hora anterior a la ultima muestra
+    uint32_t erases;       // Desde open()
+    uint32_t torn;         // Registros o cabeceras con CRC invalido encontrados
+} sample_store_stats_t;
+
+/************************************************************************/
+/* Cursor de lectura de un rango de horas. Lee la flash de a            */
+/* SAMPLE_STORE_CURSOR_RECORDS registros: recorrer un rango no          */
+/* depende de su largo. Si la escritura recicla el sector que el cursor */
+/* esta leyendo, sigue en el mas viejo que quede y cuenta lo perdido.   */
+/************************************************************************/
+typedef struct
+{
+    int64_t from_ms;
+    int64_t to_ms;
+    uint32_t sector;   // Indice del sector que se esta leyendo
+    uint32_t seq;      // Numero que tenia al empezar a leerlo
+    int64_t base_ms;
+    uint32_t slot;     // Proximo registro a leer de la flash
+    bool done;
+    uint32_t lost_sectors;
+    uint16_t buffered;
+    uint16_t position;
+    uint8_t buffer[SAMPLE_STORE_CURSOR_RECORDS * SAMPLE_STORE_RECORD_SIZE];
+} sample_store_cursor_t;
+
+/************************************************************************/
+/* La siguiente estructura simula un objeto en C                        */
+/*                                                                      */
+/* Serie de muestras del sensor en una particion de datos, como un log  */
+/* circular. En RAM solo se guarda un indice disperso: numero y hora    */
+/* base de cada sector. open() lo arma leyendo las cabeceras y ubica el */
+/* final del sector en escritura con una busqueda binaria, asi el       */
+/* arranque no depende de cuantas muestras haya.                        */
+/************************************************************************/
+typedef struct
+{
+    // Sample Store Functions
+    esp_err_t (*open)(const char *location); // Particion (ESP32) o archivo (host)
+    void (*close)(void);
+    bool (*is_open)(void);
+    /* Agrega una muestra. Las horas deben ser crecientes: una anterior a */
+    /* la ultima se rechaza con ESP_ERR_INVALID_ARG.                      */
+    esp_err_t (*append)(const sample_record_t *record);
+    esp_err_t (*query_start)(sample_store_cursor_t *cursor, int64_t from_ms, int64_t to_ms);
+    /* Proxima muestra del rango, false al terminar */
+    bool (*query_next)(sample_store_cursor_t *cursor, sample_record_t *record);
+    void (*get_stats)(sample_store_stats_t *stats);
+} sample_store_t;
+
+extern const sample_store_t sample_store;
+
+/* Muestra a partir de los valores del sensor, redondeados */
+void sample_store_make_record(sample_record_t *record, int64_t time_ms, float temp_c, float hum_pct, float press_hpa);
+
+/************************************************************************/
+/* Acceso a la flash: sample_store_flash.c en el ESP32, con la API de   */
+/* particiones; en el host, un archivo que se comporta como una NOR     */
+/* (host/mocks/src/sample_store_host.c). Los offsets son relativos al   */
+/* inicio de la particion.                                              */
+/************************************************************************/
+esp_err_t sample_store_flash_open(const char *location, uint32_t *size);
+esp_err_t sample_store_flash_read(uint32_t offset, void *buffer, size_t len);
+esp_err_t sample_store_flash_write(uint32_t offset, const void *data, size_t len);
+esp_err_t sample_store_flash_erase(uint32_t offset, size_t len);
+void sample_store_flash_close(void);
+
+#endif /* SAMPLE_STORE_H_ */
@@ -0,0 +1,61 @@
+/*
+ * sample_store_flash.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include "esp_log.h"
+#include "esp_partition.h"
+
+#include "sample_store.h"
+
+#define STORE_LOG_TAG "SAMPLE_STORE"
+
+/************************************************************************/
+/* La serie se graba en una particion de datos propia (partitions.csv), */
+/* para que su desgaste no afecte al NVS. Las lecturas pasan por        */
+/* esp_partition_read(): los cursores leen de a pocos registros y la    */
+/* particion cambia mientras se lee, no conviene mapearla.              */
+/************************************************************************/
+static const esp_partition_t *store_partition = NULL;
+
+esp_err_t sample_store_flash_open(const char *location, uint32_t *size)
+{
+    if (store_partition != NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, location);
+    if (partition == NULL)
+        return ESP_ERR_NOT_FOUND;
+    if (partition->erase_size != SAMPLE_STORE_SECTOR_SIZE)
+    {
+        ESP_LOGE(STORE_LOG_TAG, "Particion %s: sector de %lu bytes", location, (unsigned long)partition->erase_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    ESP_LOGI(STORE_LOG_TAG, "Particion %s: %lu bytes en 0x%lx", location, (unsigned long)partition->size,
+             (unsigned long)partition->address);
+    store_partition = partition;
+    *size = partition->size;
+    return ESP_OK;
+}
+
+esp_err_t sample_store_flash_read(uint32_t offset, void *buffer, size_t len)
+{
+    return esp_partition_read(store_partition, offset, buffer, len);
+}
+
+esp_err_t sample_store_flash_write(uint32_t offset, const void *data, size_t len)
+{
+    return esp_partition_write(store_partition, offset, data, len);
+}
+
+esp_err_t sample_store_flash_erase(uint32_t offset, size_t len)
+{
+    return esp_partition_erase_range(store_partition, offset, len);
+}
+
+void sample_store_flash_close(void)
+{
+    store_partition = NULL;
+}
@@ -0,0 +1,149 @@
+/*
+ * sensor_source.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_random.h"
+
+#include "sensor_source.h"
+#include "sensor_trace.h"
+#include "tph_model.h"
+
+#define SOURCE_LOG_TAG "SENSOR_SOURCE"
+
+/*****************************************************
+ *   Modelo                                           *
+ ******************************************************/
+static tph_model_t RTC_DATA_ATTR tph_model;
+static uint32_t RTC_DATA_ATTR tph_model_storage[TPH_MODEL_STORAGE_BYTES(1) / sizeof(uint32_t)];
+static bool RTC_DATA_ATTR model_ready = false;
+static int64_t RTC_DATA_ATTR model_last_ms = 0;
+
+static esp_err_t model_open(const char *location)
+{
+    (void)location;
+    if (model_ready)
+        return ESP_OK;
+
+    // Semilla propia de cada equipo; en el host, esp_random() es reproducible
+    tph_model_params_t params;
+    tph_model_default_params(&params);
+    uint64_t seed = (uint64_t)esp_random() << 32 | esp_random();
+    ESP_LOGI(SOURCE_LOG_TAG, "Inicializa el modelo TPH.");
+    esp_err_t err = tph_model_init(&tph_model, &params, tph_model_storage, sizeof(tph_model_storage), 1, seed, 0, 0, 1.0f);
+    model_ready = err == ESP_OK;
+    model_last_ms = 0;
+    return err;
+}
+
+/************************************************************************/
+/* El paso es el tiempo real desde la muestra anterior (incluye el deep */
+/* sleep) y el ciclo diario se resincroniza con la hora, que puede      */
+/* haber cambiado con el SNTP.                                          */
+/************************************************************************/
+static esp_err_t model_read(int64_t time_ms, sensor_sample_t *sample)
+{
+    if (!model_ready)
+        return ESP_ERR_INVALID_STATE;
+
+    float step_s = (time_ms - model_last_ms) / 1000.0f;
+    if (model_last_ms == 0 || step_s < 0.001f || step_s > 86400)
+        step_s = 1.0f; // Primera muestra o salto de reloj
+    model_last_ms = time_ms;
+
+    tph_model_set_step(&tph_model, step_s);
+    tph_model_set_time(&tph_model, time_ms / 1000.0 - step_s);
+    tph_model_generate(&tph_model, 1, &sample->temp_c, &sample->press_hpa, &sample->hum_pct);
+    return ESP_OK;
+}
+
+static void model_close(void)
+{
+}
+
+/*****************************************************
+ *   Traza                                            *
+ ******************************************************/
+// El cursor y el ancla (hora de la primera lectura) sobreviven al deep sleep
+static sensor_trace_t RTC_DATA_ATTR trace;
+static int64_t RTC_DATA_ATTR trace_anchor_ms = 0;
+static bool trace_mapped = false;
+
+static esp_err_t trace_open(const char *location)
+{
+    const uint8_t *data;
+    size_t len;
+    esp_err_t err = sensor_trace_map(location, &data, &len);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(SOURCE_LOG_TAG, "No se pudo mapear la traza %s (%s)", location, esp_err_to_name(err));
+        return err;
+    }
+
+    // Misma traza que antes del deep sleep: sigue desde donde estaba
+    if (trace_anchor_ms != 0 && sensor_trace_attach(&trace, data, len) == ESP_OK)
+    {
+        trace_mapped = true;
+        return ESP_OK;
+    }
+
+    err = sensor_trace_open(&trace, data, len);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(SOURCE_LOG_TAG, "Traza %s invalida (%s)", location, esp_err_to_name(err));
+        sensor_trace_unmap();
+        return err;
+    }
+    ESP_LOGI(SOURCE_LOG_TAG, "Traza %s: %s, %lld s", location, trace.format == SENSOR_TRACE_FORMAT_BINARY ? "binaria" : "CSV",
+             (long long)((trace.last_ms - trace.first_ms) / 1000));
+    trace_anchor_ms = 0;
+    trace_mapped = true;
+    return ESP_OK;
+}
+
+static esp_err_t trace_read(int64_t time_ms, sensor_sample_t *sample)
+{
+    if (!trace_mapped)
+        return ESP_ERR_INVALID_STATE;
+    if (trace_anchor_ms == 0 || time_ms < trace_anchor_ms)
+        trace_anchor_ms = time_ms;
+
+    // La traza se repite: el tiempo transcurrido se toma modulo su duracion
+    int64_t elapsed_ms = (time_ms - trace_anchor_ms) % (trace.last_ms - trace.first_ms);
+    sensor_trace_point_t point;
+    sensor_trace_sample(&trace, trace.first_ms + elapsed_ms, &point);
+    sample->temp_c = point.temp_c;
+    sample->press_hpa = point.press_hpa;
+    sample->hum_pct = point.hum_pct;
+    return ESP_OK;
+}
+
+static void trace_close(void)
+{
+    if (!trace_mapped)
+        return;
+    sensor_trace_unmap();
+    trace_mapped = false;
+    trace_anchor_ms = 0;
+}
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)
+ ******************************************************/
+const sensor_source_t sensor_source_model = {
+    .name = "model",
+    .open = model_open,
+    .read = model_read,
+    .close = model_close,
+};
+
+const sensor_source_t sensor_source_trace = {
+    .name = "trace",
+    .open = trace_open,
+    .read = trace_read,
+    .close = trace_close,
+};
@@ -0,0 +1,45 @@
+/*
+ * sensor_source.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef SENSOR_SOURCE_H_
+#define SENSOR_SOURCE_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct
+{
+    float temp_c;
+    float press_hpa;
+    float hum_pct;
+} sensor_sample_t;
+
+/************************************************************************/
+/* La siguiente estructura simula un objeto en C                        */
+/*                                                                      */
+/* Representa una fuente de muestras para el sensor simulado. El        */
+/* sensor le pide el valor en la hora de cada muestra (ms unix) y no    */
+/* sabe de donde sale: del modelo o de una traza grabada.               */
+/* El estado de cada fuente vive en la memoria RTC, para que la serie   */
+/* siga despues del deep sleep.                                         */
+/************************************************************************/
+typedef struct
+{
+    const char *name;
+    // location: NULL para el modelo; particion (ESP32) o archivo (host) para la traza
+    esp_err_t (*open)(const char *location);
+    esp_err_t (*read)(int64_t time_ms, sensor_sample_t *sample);
+    void (*close)(void);
+} sensor_source_t;
+
+/* Modelo TPH de un canal (tph_model.h) */
+extern const sensor_source_t sensor_source_model;
+/* Traza grabada (sensor_trace.h), interpolada y repetida en loop desde la
+ * primera lectura */
+extern const sensor_source_t sensor_source_trace;
+
+#endif /* SENSOR_SOURCE_H_ */
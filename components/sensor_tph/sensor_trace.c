@@ -0,0 +1,306 @@
+/*
+ * sensor_trace.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <string.h>
+
+#include "sensor_trace.h"
+
+/*****************************************************
+ *   CSV                                              *
+ ******************************************************/
+static bool is_blank(uint8_t c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* Numero decimal acotado por end (los datos mapeados no terminan en 0) */
+static const uint8_t *parse_number(const uint8_t *p, const uint8_t *end, double *value)
+{
+    while (p < end && is_blank(*p))
+        p++;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    double number = 0;
+    int digits = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        number = number * 10 + (*p++ - '0');
+        digits++;
+    }
+    if (p < end && *p == '.')
+    {
+        double scale = 0.1;
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, scale *= 0.1)
+        {
+            number += (*p - '0') * scale;
+            digits++;
+        }
+    }
+    if (digits == 0)
+        return NULL;
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const uint8_t *q = p + 1;
+        bool negative_exp = false;
+        if (q < end && (*q == '-' || *q == '+'))
+            negative_exp = *q++ == '-';
+        int exponent = 0;
+        if (q < end && *q >= '0' && *q <= '9')
+        {
+            while (q < end && *q >= '0' && *q <= '9')
+                exponent = exponent * 10 + (*q++ - '0');
+            for (; exponent > 0; exponent--)
+                number = negative_exp ? number / 10 : number * 10;
+            p = q;
+        }
+    }
+    while (p < end && is_blank(*p))
+        p++;
+    *value = negative ? -number : number;
+    return p;
+}
+
+/* Una linea [start, end) sin el '\n'; false si no tiene los 4 numeros */
+static bool parse_csv_line(const uint8_t *start, const uint8_t *end, sensor_trace_point_t *point)
+{
+    double fields[4];
+    const uint8_t *p = start;
+    for (int i = 0; i < 4; i++)
+    {
+        if (i > 0)
+        {
+            if (p >= end || (*p != ',' && *p != ';'))
+                return false;
+            p++;
+        }
+        p = parse_number(p, end, &fields[i]);
+        if (p == NULL)
+            return false;
+    }
+    if (p < end && *p != ',' && *p != ';') // Columnas extra se ignoran
+        return false;
+
+    double time_ms = fields[0] * 1000.0;
+    point->time_ms = (int64_t)(time_ms >= 0 ? time_ms + 0.5 : time_ms - 0.5);
+    point->temp_c = fields[1];
+    point->press_hpa = fields[2];
+    point->hum_pct = fields[3];
+    return true;
+}
+
+/* Siguiente linea valida desde *offset; line_start (si no es NULL) recibe su comienzo */
+static bool next_csv_point(const sensor_trace_t *trace, size_t *offset, sensor_trace_point_t *point, size_t *line_start)
+{
+    const uint8_t *end = trace->data + trace->len;
+    const uint8_t *p = trace->data + *offset;
+    while (p < end)
+    {
+        const uint8_t *eol = memchr(p, '\n', end - p);
+        const uint8_t *line_end = eol != NULL ? eol : end;
+        const uint8_t *next = eol != NULL ? eol + 1 : end;
+        if (parse_csv_line(p, line_end, point))
+        {
+            if (line_start != NULL)
+                *line_start = p - trace->data;
+            *offset = next - trace->data;
+            return true;
+        }
+        p = next;
+    }
+    *offset = trace->len;
+    return false;
+}
+
+/* Ultima linea valida, buscando hacia atras: no recorre el archivo entero */
+static bool last_csv_point(const sensor_trace_t *trace, sensor_trace_point_t *point)
+{
+    size_t line_end = trace->len;
+    while (line_end > trace->first_offset)
+    {
+        size_t line_start = line_end;
+        while (line_start > 0 && trace->data[line_start - 1] != '\n')
+            line_start--;
+        if (parse_csv_line(trace->data + line_start, trace->data + line_end, point))
+            return true;
+        if (line_start == 0)
+            break;
+        line_end = line_start - 1;
+    }
+    return false;
+}
+
+/*****************************************************
+ *   Binario                                          *
+ ******************************************************/
+static uint32_t read_u32(const uint8_t *p)
+{
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static float read_f32(const uint8_t *p)
+{
+    uint32_t bits = read_u32(p);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint8_t binary_record_len(const sensor_trace_t *trace)
+{
+    return trace->data[5];
+}
+
+static int64_t binary_base_ms(const sensor_trace_t *trace)
+{
+    return (int64_t)((uint64_t)read_u32(trace->data + 12) | (uint64_t)read_u32(trace->data + 16) << 32);
+}
+
+static void binary_point(const sensor_trace_t *trace, uint32_t index, sensor_trace_point_t *point)
+{
+    const uint8_t *record = trace->data + SENSOR_TRACE_HEADER_LEN + (size_t)index * binary_record_len(trace);
+    point->time_ms = binary_base_ms(trace) + read_u32(record);
+    point->temp_c = read_f32(record + 4);
+    point->press_hpa = read_f32(record + 8);
+    point->hum_pct = read_f32(record + 12);
+}
+
+static uint32_t binary_index(const sensor_trace_t *trace, size_t offset)
+{
+    return (offset - SENSOR_TRACE_HEADER_LEN) / binary_record_len(trace);
+}
+
+/*****************************************************
+ *   Lector                                           *
+ ******************************************************/
+bool sensor_trace_next(const sensor_trace_t *trace, size_t *offset, sensor_trace_point_t *point)
+{
+    if (trace->format == SENSOR_TRACE_FORMAT_CSV)
+        return next_csv_point(trace, offset, point, NULL);
+
+    uint32_t index = binary_index(trace, *offset);
+    if (index >= trace->points)
+        return false;
+    binary_point(trace, index, point);
+    *offset += binary_record_len(trace);
+    return true;
+}
+
+/* before = primera muestra, after = segunda */
+static void rewind_trace(sensor_trace_t *trace)
+{
+    trace->next_offset = trace->first_offset;
+    sensor_trace_next(trace, &trace->next_offset, &trace->before);
+    sensor_trace_next(trace, &trace->next_offset, &trace->after);
+}
+
+/* Binario: busqueda binaria de la primera muestra con tiempo >= time_ms */
+static void seek_binary(sensor_trace_t *trace, int64_t time_ms)
+{
+    uint32_t low = 1, high = trace->points - 1;
+    sensor_trace_point_t point;
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        binary_point(trace, mid, &point);
+        if (point.time_ms < time_ms)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    binary_point(trace, low - 1, &trace->before);
+    binary_point(trace, low, &trace->after);
+    trace->next_offset = SENSOR_TRACE_HEADER_LEN + (size_t)(low + 1) * binary_record_len(trace);
+}
+
+esp_err_t sensor_trace_open(sensor_trace_t *trace, const uint8_t *data, size_t len)
+{
+    memset(trace, 0, sizeof(*trace));
+    trace->data = data;
+
+    if (len >= SENSOR_TRACE_HEADER_LEN && memcmp(data, SENSOR_TRACE_MAGIC, 4) == 0)
+    {
+        if (data[4] != SENSOR_TRACE_VERSION || data[5] < SENSOR_TRACE_RECORD_LEN)
+            return ESP_ERR_NOT_SUPPORTED;
+        trace->format = SENSOR_TRACE_FORMAT_BINARY;
+        trace->points = read_u32(data + 8);
+        if (trace->points < 2 || (len - SENSOR_TRACE_HEADER_LEN) / data[5] < trace->points)
+            return ESP_ERR_INVALID_SIZE;
+        trace->len = SENSOR_TRACE_HEADER_LEN + (size_t)trace->points * data[5];
+        trace->first_offset = SENSOR_TRACE_HEADER_LEN;
+        sensor_trace_point_t last;
+        binary_point(trace, trace->points - 1, &last);
+        trace->last_ms = last.time_ms;
+    }
+    else
+    {
+        // El relleno de la flash borrada (o de un buffer) no es parte del CSV
+        while (len > 0 && (data[len - 1] == 0xFF || data[len - 1] == 0x00))
+            len--;
+        trace->format = SENSOR_TRACE_FORMAT_CSV;
+        trace->len = len;
+        size_t offset = 0;
+        sensor_trace_point_t first, last;
+        if (!next_csv_point(trace, &offset, &first, &trace->first_offset) || !last_csv_point(trace, &last) ||
+            last.time_ms <= first.time_ms)
+            return ESP_ERR_INVALID_SIZE;
+        trace->last_ms = last.time_ms;
+    }
+
+    rewind_trace(trace);
+    trace->first_ms = trace->before.time_ms;
+    return trace->last_ms > trace->first_ms ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+esp_err_t sensor_trace_attach(sensor_trace_t *trace, const uint8_t *data, size_t len)
+{
+    sensor_trace_t fresh;
+    esp_err_t err = sensor_trace_open(&fresh, data, len);
+    if (err != ESP_OK)
+        return err;
+    if (fresh.format != trace->format || fresh.len != trace->len || fresh.first_ms != trace->first_ms ||
+        fresh.last_ms != trace->last_ms)
+        return ESP_ERR_INVALID_STATE;
+    trace->data = data;
+    return ESP_OK;
+}
+
+void sensor_trace_sample(sensor_trace_t *trace, int64_t time_ms, sensor_trace_point_t *point)
+{
+    if (time_ms < trace->before.time_ms || time_ms > trace->after.time_ms)
+    {
+        if (trace->format == SENSOR_TRACE_FORMAT_BINARY)
+            seek_binary(trace, time_ms);
+        else
+        {
+            // CSV: solo hacia adelante; hacia atras se vuelve a empezar
+            if (time_ms < trace->before.time_ms)
+                rewind_trace(trace);
+            sensor_trace_point_t next;
+            while (time_ms > trace->after.time_ms && sensor_trace_next(trace, &trace->next_offset, &next))
+            {
+                trace->before = trace->after;
+                trace->after = next;
+            }
+        }
+    }
+
+    const sensor_trace_point_t *a = &trace->before, *b = &trace->after;
+    if (time_ms <= a->time_ms || b->time_ms <= a->time_ms)
+        *point = *a;
+    else if (time_ms >= b->time_ms)
+        *point = *b;
+    else
+    {
+        float f = (float)(time_ms - a->time_ms) / (float)(b->time_ms - a->time_ms);
+        point->temp_c = a->temp_c + (b->temp_c - a->temp_c) * f;
+        point->press_hpa = a->press_hpa + (b->press_hpa - a->press_hpa) * f;
+        point->hum_pct = a->hum_pct + (b->hum_pct - a->hum_pct) * f;
+    }
+    point->time_ms = time_ms;
+}
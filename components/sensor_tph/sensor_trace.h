@@ -0,0 +1,87 @@
+/*
+ * sensor_trace.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef SENSOR_TRACE_H_
+#define SENSOR_TRACE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/************************************************************************/
+/* Lectura de trazas grabadas de temperatura, presion y humedad.        */
+/*                                                                      */
+/* Formatos aceptados:                                                  */
+/*                                                                      */
+/*   CSV:     una muestra por linea "tiempo_s,temp_c,presion_hpa,hum"   */
+/*            (tiempo en segundos, unix o relativo, con decimales).     */
+/*            Las lineas que no tienen los 4 numeros (encabezado,       */
+/*            comentarios con #) se saltean.                            */
+/*   binario: encabezado "TPHT", version (u8), largo de registro (u8),  */
+/*            reservado (2 bytes), cantidad de registros (u32), hora    */
+/*            base (ms, i64); registros de tiempo desde la base (ms,    */
+/*            u32) y temperatura, presion y humedad (float). Todo       */
+/*            little endian.                                            */
+/*                                                                      */
+/* Los tiempos deben ser crecientes. El lector recorre los datos en el  */
+/* lugar (archivo o particion mapeados), sin copiarlos a RAM: guarda    */
+/* solo las dos muestras que rodean al tiempo pedido e interpola entre  */
+/* ellas. Los bytes 0xFF o 0x00 al final (flash borrada) se ignoran.    */
+/************************************************************************/
+#define SENSOR_TRACE_MAGIC "TPHT"
+#define SENSOR_TRACE_VERSION 1
+#define SENSOR_TRACE_HEADER_LEN 20
+#define SENSOR_TRACE_RECORD_LEN 16
+
+typedef enum
+{
+    SENSOR_TRACE_FORMAT_CSV = 0,
+    SENSOR_TRACE_FORMAT_BINARY,
+} sensor_trace_format_t;
+
+typedef struct
+{
+    int64_t time_ms;
+    float temp_c;
+    float press_hpa;
+    float hum_pct;
+} sensor_trace_point_t;
+
+/* Estado de lectura, inicializar con sensor_trace_open(). No guarda punteros
+ * salvo data: se puede conservar (RTC) y reenganchar con sensor_trace_attach() */
+typedef struct
+{
+    const uint8_t *data;
+    size_t len;            // Sin el relleno final
+    sensor_trace_format_t format;
+    uint32_t points;       // Binario: registros; CSV: 0 (no se cuentan)
+    size_t first_offset;   // Primera muestra
+    int64_t first_ms;
+    int64_t last_ms;
+    size_t next_offset;    // Siguiente muestra despues de "after"
+    sensor_trace_point_t before;
+    sensor_trace_point_t after;
+} sensor_trace_t;
+
+/* ESP_ERR_INVALID_SIZE si no hay al menos dos muestras */
+esp_err_t sensor_trace_open(sensor_trace_t *trace, const uint8_t *data, size_t len);
+/* Reengancha un estado guardado a los mismos datos mapeados en otra direccion;
+ * ESP_ERR_INVALID_STATE si los datos no son los de la traza guardada */
+esp_err_t sensor_trace_attach(sensor_trace_t *trace, const uint8_t *data, size_t len);
+/* Interpola en time_ms (tiempo de la traza). Fuera de rango devuelve el extremo */
+void sensor_trace_sample(sensor_trace_t *trace, int64_t time_ms, sensor_trace_point_t *point);
+/* Recorre las muestras desde *offset (empezar con trace->first_offset); false al final */
+bool sensor_trace_next(const sensor_trace_t *trace, size_t *offset, sensor_trace_point_t *point);
+
+/* Acceso de solo lectura a la traza, sin copiarla: particion de flash mapeada
+ * (location = etiqueta de la particion) en el ESP32, archivo mapeado
+ * (location = ruta) en el host. Una traza mapeada a la vez. */
+esp_err_t sensor_trace_map(const char *location, const uint8_t **data, size_t *len);
+void sensor_trace_unmap(void);
+
+#endif /* SENSOR_TRACE_H_ */
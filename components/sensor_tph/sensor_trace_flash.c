@@ -0,0 +1,51 @@
+/*
+ * sensor_trace_flash.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include "esp_log.h"
+#include "esp_partition.h"
+
+#include "sensor_trace.h"
+
+#define TRACE_LOG_TAG "SENSOR_TRACE"
+
+/************************************************************************/
+/* La traza se graba en una particion de datos (partitions.csv) y se    */
+/* mapea en el espacio de datos de la flash: el cache de la flash trae  */
+/* solo las paginas que el lector recorre, no se copia a RAM.           */
+/*                                                                      */
+/*   parttool.py write_partition --partition-name trace --input t.csv   */
+/************************************************************************/
+static esp_partition_mmap_handle_t trace_mmap_handle;
+static bool trace_mapped = false;
+
+esp_err_t sensor_trace_map(const char *location, const uint8_t **data, size_t *len)
+{
+    if (trace_mapped)
+        return ESP_ERR_INVALID_STATE;
+
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, location);
+    if (partition == NULL)
+        return ESP_ERR_NOT_FOUND;
+
+    const void *mapped;
+    esp_err_t err = esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &mapped, &trace_mmap_handle);
+    if (err != ESP_OK)
+        return err;
+    ESP_LOGI(TRACE_LOG_TAG, "Particion %s mapeada: %lu bytes en %p", location, (unsigned long)partition->size, mapped);
+    *data = mapped;
+    *len = partition->size;
+    trace_mapped = true;
+    return ESP_OK;
+}
+
+void sensor_trace_unmap(void)
+{
+    if (!trace_mapped)
+        return;
+    esp_partition_munmap(trace_mmap_handle);
+    trace_mapped = false;
+}
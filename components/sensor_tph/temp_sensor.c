@@ -15,33 +15,87 @@
 #include "nvs_flash.h"
 #include "esp_sleep.h"
 #include "esp_wifi.h"
-#include "esp_random.h"
 #include <string.h>
 
 #include "temp_sensor.h"
+#include "sensor_source.h"
+#include "clearblade_connect.h"
+#include "telemetry_dispatch.h"
+#include "boot_timeline.h"
+#include "sntp_time.h"
+#include "msg_sequence.h"
+#include "sample_store.h"
+#include "resource_monitor.h"
+#include "energy_meter.h"
 
 #define SENSOR_LOG_TAG "SENSOR_SIM"
+#define GO_SLEEP_TASK_STACK_SIZE (4096 * 1)
+
+/* Nivel de log del modulo: los mensajes de depuracion no se compilan salvo */
+/* que se pida -DSENSOR_LOG_LEVEL=ESP_LOG_DEBUG                            */
+#ifndef SENSOR_LOG_LEVEL
+#define SENSOR_LOG_LEVEL ESP_LOG_INFO
+#endif
+#define DEFERRED_LOG_LOCAL_LEVEL SENSOR_LOG_LEVEL
+#include "deferred_log.h"
 
 /************************************************************************/
-/* Simula sensor de temperatura                                         */
+/* Simula sensor de temperatura, presion y humedad                      */
 /*                                                                      */
-/* La temperatura, en vez de ser un número random, lo que hace          */
-/* sumar un delta hacia arriba o hacia abajo, según un random           */
-/* Por el motivo anterior, necesito que la variable "temp" perdure      */
-/* tras los reinicios por software y esto se logra guardandola en la    */
-/* memoria del reloj de tiempo real RTC usando el atuributo             */
-/* RTC_DATA_ATTR.                                                       */
+/* Los valores salen de una fuente (sensor_source.h): el modelo TPH     */
+/* por defecto, o una traza grabada elegida con set_source(). Las       */
+/* fuentes guardan su estado en la memoria del reloj de tiempo real     */
+/* RTC, y las ultimas muestras tambien, usando el atributo              */
+/* RTC_DATA_ATTR, para que la serie continue tras los reinicios por     */
+/* software y el deep sleep.                                            */
 /*                                                                      */
 /* Situacion similar para la variable "restart_counter"                 */
 /************************************************************************/
 static uint32_t RTC_DATA_ATTR restart_counter = 0;
 
-// Espacio de memoria para alojar la propiedad "float *temp;" del objeto.
+// Fuente de las muestras; se elige en cada arranque
+static const sensor_source_t *source = &sensor_source_model;
+
+// Espacio de memoria para alojar las propiedades "float *temp;", "float *pressure;" y "float *humidity;" del objeto.
 float RTC_DATA_ATTR temp;
+float RTC_DATA_ATTR pressure;
+float RTC_DATA_ATTR humidity;
 
 // Espacio de memoria para alojar la propiedad "unsigned char* temp_string;" del objeto.
 char temp_string[10];
 
+// Hora (epoch, ms) de la ultima muestra y su incertidumbre segun el servicio de hora.
+static int64_t sample_time_ms = 0;
+static uint32_t sample_time_error_ms = 0;
+
+/************************************************************************/
+/* Alarmas por umbral. Cada una se activa al cruzar el limite y se      */
+/* desactiva al volver con un margen de histeresis; los dos cambios se  */
+/* publican de inmediato en events/alarm. El estado se guarda en RTC    */
+/* para no repetir la alarma tras el deep sleep.                        */
+/************************************************************************/
+typedef struct
+{
+    const char *name;
+    const float *value;
+    float limit;
+    float hysteresis;
+    bool above; // true: alarma por encima del limite
+} sensor_alarm_t;
+
+static const sensor_alarm_t sensor_alarms[] = {
+    {"temperatura_alta", &temp, TEMP_SENSOR_ALARM_TEMP_HIGH_C, TEMP_SENSOR_ALARM_TEMP_HYSTERESIS_C, true},
+    {"temperatura_baja", &temp, TEMP_SENSOR_ALARM_TEMP_LOW_C, TEMP_SENSOR_ALARM_TEMP_HYSTERESIS_C, false},
+    {"humedad_alta", &humidity, TEMP_SENSOR_ALARM_HUM_HIGH_PCT, TEMP_SENSOR_ALARM_HUM_HYSTERESIS_PCT, true},
+};
+#define SENSOR_ALARM_COUNT (sizeof(sensor_alarms) / sizeof(sensor_alarms[0]))
+
+static uint32_t RTC_DATA_ATTR alarm_active_mask = 0;
+
+const char *mqtt_topic = NULL;
+const char *mqtt_deviceId = NULL;
+clearblade_client_t *mqtt_clearblade_client = NULL;
+
 /************************************************************************/
 /* Convierte la temperatura almacenada en float, a cadena de caracteres */
 /* Formatea la cadena de texto para que se envie siempre la misma       */
@@ -49,43 +103,103 @@ char temp_string[10];
 /************************************************************************/
 static void convert_temp_to_string(void)
 {
-    ESP_LOGI(SENSOR_LOG_TAG, "Ingresa a convert_temp_to_string().");
+    DLOGD(SENSOR_LOG_TAG, "Ingresa a convert_temp_to_string().");
     if (temp >= 100)
     {
-        ESP_LOGE(SENSOR_LOG_TAG, "Temperatura supera limite superior.");
+        DLOGE(SENSOR_LOG_TAG, "Temperatura supera limite superior.");
         temp = 99.9;
     }
     if (temp <= 0)
     {
-        ESP_LOGE(SENSOR_LOG_TAG, "Temperatura supera limite inferior.");
+        DLOGE(SENSOR_LOG_TAG, "Temperatura supera limite inferior.");
         temp = 0;
     }
     // Convierta a cadena de texto con formato de 4 digitos, 1 posicion decimal.
     snprintf((char *)temp_string, sizeof(temp_string), "%04.1f", temp);
 }
 
+static void publish_alarm(const sensor_alarm_t *alarm, bool active)
+{
+    char bufferJson[200];
+
+    DLOGW(SENSOR_LOG_TAG, "Alarma %s %s: %.1f (limite %.1f)", alarm->name, active ? "activa" : "normalizada", *alarm->value,
+             alarm->limit);
+    if (mqtt_deviceId == NULL)
+        return;
+
+    bool seq_resync = false;
+    uint64_t seq = msg_sequence.next(&seq_resync);
+    size_t id_len = strlen(mqtt_deviceId);
+    int len = snprintf(bufferJson, sizeof(bufferJson),
+                       "{ \"dev_id\": %s, \"seq\": %llu, \"alarma\": \"%s\", \"activa\": %s, \"valor\": %.1f, \"limite\": %.1f, "
+                       "\"ts\": %lld%s }",
+                       mqtt_deviceId + (id_len > 3 ? id_len - 3 : 0), (unsigned long long)seq, alarm->name,
+                       active ? "true" : "false", *alarm->value, alarm->limit, (long long)sample_time_ms,
+                       seq_resync ? ", " TEMP_SENSOR_SEQ_RESYNC_FIELD : "");
+
+    // Con el despacho en marcha la alarma pasa adelante de la telemetria encolada
+    if (telemetry_dispatch.is_running())
+    {
+        if (telemetry_dispatch.send(TELEMETRY_CLASS_ALARM, bufferJson, len) != ESP_OK)
+            DLOGE(SENSOR_LOG_TAG, "Cola de alarmas llena.");
+        return;
+    }
+    if (mqtt_clearblade_client == NULL)
+        return;
+    clearblade_client_publish(mqtt_clearblade_client, TELEMETRY_DISPATCH_ALARM_SUBTOPIC, bufferJson, len, 1);
+}
+
+static void check_alarms(void)
+{
+    for (uint32_t i = 0; i < SENSOR_ALARM_COUNT; i++)
+    {
+        const sensor_alarm_t *alarm = &sensor_alarms[i];
+        float value = *alarm->value;
+        bool active = (alarm_active_mask & (1u << i)) != 0;
+        bool beyond = alarm->above ? value > alarm->limit : value < alarm->limit;
+        bool back = alarm->above ? value < alarm->limit - alarm->hysteresis : value > alarm->limit + alarm->hysteresis;
+
+        if (!active && beyond)
+            alarm_active_mask |= 1u << i;
+        else if (active && back)
+            alarm_active_mask &= ~(1u << i);
+        else
+            continue;
+        publish_alarm(alarm, !active);
+    }
+}
+
 /************************************************************************/
-/* Simula el sensor de temperatura, generando un desvio positivo o      */
-/* negativo en base al resultado de un random.                          */
-/* Lo implementé de este modo para que se vaya formando una curva y no  */
-/* puntos inconexos                                                     */
+/* Toma una muestra de la fuente en la hora actual                      */
 /************************************************************************/
 static void sample_temp(void)
 {
-    ESP_LOGI(SENSOR_LOG_TAG, "Ingresa a sample_temp().");
-
-    // Tomo la muestra del supuesto sensor, en este ejemplo solo genero un random.
-    ESP_LOGI(SENSOR_LOG_TAG, "Tomando muestra... ");
-    uint32_t random_number = esp_random();
-    if (random_number > 2147483648)
-        temp += 0.3;
-    else
-        temp -= 0.3;
-
-    if (temp > 40)
-        temp = 39.5;
-    if (temp < 1)
-        temp = 1.5;
+    DLOGD(SENSOR_LOG_TAG, "Ingresa a sample_temp().");
+
+    DLOGD(SENSOR_LOG_TAG, "Tomando muestra... ");
+    sample_time_ms = time_service.get_time_ms();
+    sample_time_error_ms = time_service.get_uncertainty_ms();
+
+    sensor_sample_t sample;
+    if (source->read(sample_time_ms, &sample) != ESP_OK)
+    {
+        DLOGE(SENSOR_LOG_TAG, "La fuente %s no entrego muestra.", source->name);
+        return;
+    }
+    temp = sample.temp_c;
+    pressure = sample.press_hpa;
+    humidity = sample.hum_pct;
+    check_alarms();
+
+    // Con hora valida la muestra tambien va a la serie en flash, para los pedidos de historial
+    if (sample_store.is_open() && sample_time_error_ms != UINT32_MAX)
+    {
+        sample_record_t record;
+        sample_store_make_record(&record, sample_time_ms, temp, humidity, pressure);
+        esp_err_t err = sample_store.append(&record);
+        if (err != ESP_OK)
+            DLOGW(SENSOR_LOG_TAG, "No se guardo la muestra: %s", esp_err_to_name(err));
+    }
     convert_temp_to_string();
 }
 
@@ -104,13 +218,19 @@ static void sample_temp(void)
 void go_sleep_task(void *param)
 {
     uint8_t seconds = *((uint8_t *)param);
-    ESP_LOGI(SENSOR_LOG_TAG, "Inicia go_sleep_task().");
-    ESP_LOGI(SENSOR_LOG_TAG, "Segundos para ir a sleep: %d", (int)seconds);
+    resource_monitor.register_task(NULL, "go_sleep_task", GO_SLEEP_TASK_STACK_SIZE);
+    DLOGD(SENSOR_LOG_TAG, "Inicia go_sleep_task().");
+    DLOGI(SENSOR_LOG_TAG, "Segundos para ir a sleep: %d", (int)seconds);
     vTaskDelay(seconds * 1000 / portTICK_PERIOD_MS);
 
     esp_sleep_enable_timer_wakeup(30 * 1000000);
-    ESP_LOGI(SENSOR_LOG_TAG, "Sleep!");
+    DLOGI(SENSOR_LOG_TAG, "Sleep!");
+    // El ciclo queda en RTC con el sueno que sigue; se reporta al despertar
+    energy_meter.end_cycle(30 * 1000000ULL);
+    // Lo que quede en el anillo del log se perderia con la RAM
+    deferred_log.flush();
     esp_deep_sleep_start();
+    resource_monitor.task_exit();
     vTaskDelete(NULL);
 }
 
@@ -122,11 +242,24 @@ void go_sleep_task(void *param)
 /*                                                                      */
 /* Se llama en el manejador de eventos BLE, cuando inicia el ADV        */
 /************************************************************************/
+#ifdef STATIC_ALLOCATION_MODE
+static StackType_t go_sleep_task_stack[GO_SLEEP_TASK_STACK_SIZE];
+static StaticTask_t go_sleep_task_buffer;
+#endif
+
+// El parametro de la tarea debe sobrevivir a go_sleep(), no puede estar en su stack.
+static uint8_t go_sleep_seconds;
+
 static void go_sleep(uint8_t seconds)
 {
-    // uint8_t *seconds_pointer = &seconds;
-    ESP_LOGI(SENSOR_LOG_TAG, "Ingresa a go_sleep().");
-    xTaskCreate(go_sleep_task, "go_sleep_task", 4096 * 1, (void *)(&seconds), 3, NULL);
+    DLOGD(SENSOR_LOG_TAG, "Ingresa a go_sleep().");
+    go_sleep_seconds = seconds;
+#ifdef STATIC_ALLOCATION_MODE
+    xTaskCreateStatic(go_sleep_task, "go_sleep_task", GO_SLEEP_TASK_STACK_SIZE, (void *)(&go_sleep_seconds), 3,
+                      go_sleep_task_stack, &go_sleep_task_buffer);
+#else
+    xTaskCreate(go_sleep_task, "go_sleep_task", GO_SLEEP_TASK_STACK_SIZE, (void *)(&go_sleep_seconds), 3, NULL);
+#endif
 }
 
 /************************************************************************/
@@ -138,55 +271,113 @@ static void go_sleep(uint8_t seconds)
 /************************************************************************/
 static void initialize(void)
 {
-    ESP_LOGI(SENSOR_LOG_TAG, "Ingresa a initialize().");
-    if (restart_counter == 0)
-    {
-        ESP_LOGI(SENSOR_LOG_TAG, "Inicializa temperatura a 24.");
-        temp = 24;
-    }
-    ESP_LOGI(SENSOR_LOG_TAG, "Reinicio numero: %d", (int)restart_counter);
+    DLOGD(SENSOR_LOG_TAG, "Ingresa a initialize().");
+    // El modelo conserva su estado en RTC; solo se inicializa al encender
+    ESP_ERROR_CHECK_WITHOUT_ABORT(sensor_source_model.open(NULL));
+    DLOGI(SENSOR_LOG_TAG, "Reinicio numero: %d", (int)restart_counter);
     restart_counter++;
 }
 
-const char *mqtt_topic = NULL;
-const char *mqtt_deviceId = NULL;
-esp_mqtt_client_handle_t *esp_mqtt_client_handle = NULL;
+/************************************************************************/
+/* Cambia la fuente de las muestras. location es la particion (ESP32)   */
+/* o el archivo (host) de la traza; el modelo no lo usa. Si la fuente   */
+/* no abre, se conserva la anterior.                                    */
+/************************************************************************/
+static esp_err_t set_source(const sensor_source_t *new_source, const char *location)
+{
+    DLOGD(SENSOR_LOG_TAG, "Ingresa a set_source(): %s", new_source->name);
+    if (new_source == source)
+        return ESP_OK;
+    esp_err_t err = new_source->open(location);
+    if (err != ESP_OK)
+    {
+        DLOGW(SENSOR_LOG_TAG, "Se sigue usando la fuente %s.", source->name);
+        return err;
+    }
+    source->close();
+    source = new_source;
+    return ESP_OK;
+}
 
-static void set_mqtt_info(const char *topic, const char *deviceId, esp_mqtt_client_handle_t *esp_mqtt_client_handle_pointer)
+/* Las publicaciones directas pasan por el cliente, y por su limite de tasa */
+static void set_mqtt_info(const char *topic, const char *deviceId, clearblade_client_t *client)
 {
-    esp_mqtt_client_handle = esp_mqtt_client_handle_pointer;
+    mqtt_clearblade_client = client;
     mqtt_topic = topic;
     mqtt_deviceId = deviceId;
 }
 
+/************************************************************************/
+/* Arma el JSON de telemetria. dev_id son los ultimos 3 caracteres del  */
+/* device ID y seq el numero de secuencia del mensaje (msg_sequence.h); */
+/* la marca de tiempo se omite si no hay hora valida                    */
+/* (ts_err_ms == UINT32_MAX). extra, si no es NULL, se agrega al final. */
+/* Devuelve el largo, como snprintf.                                    */
+/************************************************************************/
+int temp_sensor_format_payload(char *buffer, size_t buffer_len, const char *device_id, uint64_t seq, const char *temp_text,
+                               float pressure_hpa, float humidity_pct, int8_t rssi, int64_t ts_ms, uint32_t ts_err_ms,
+                               const char *extra)
+{
+    size_t id_len = strlen(device_id);
+    int len = snprintf(buffer, buffer_len,
+                       "{ \"dev_id\": %s, \"seq\": %llu, \"temperatura\": %s, \"presion\": %.1f, \"humedad\": %.1f, \"rssi\": %d",
+                       device_id + (id_len > 3 ? id_len - 3 : 0), (unsigned long long)seq, temp_text, pressure_hpa,
+                       humidity_pct, rssi);
+
+    if (ts_err_ms != UINT32_MAX && len >= 0 && (size_t)len < buffer_len)
+        len += snprintf(buffer + len, buffer_len - len, ", \"ts\": %lld, \"ts_err_ms\": %lu", (long long)ts_ms, (unsigned long)ts_err_ms);
+    if (extra != NULL && len >= 0 && (size_t)len < buffer_len)
+        len += snprintf(buffer + len, buffer_len - len, ", %s", extra);
+    if (len >= 0 && (size_t)len < buffer_len)
+        len += snprintf(buffer + len, buffer_len - len, " }");
+    return len;
+}
+
 static void publish_to_mqtt(void)
 {
-    ESP_LOGI(SENSOR_LOG_TAG, "Ingresa a publish_to_mqtt_topic()");
+    DLOGD(SENSOR_LOG_TAG, "Ingresa a publish_to_mqtt_topic()");
 
-    char bufferJson[300];
+    char bufferJson[400];
     char bufferTopic[350];
     int msg_id;
-    char buffer_temp_txt[15];
-    char buffer_rssi_txt[15];
 
     // Consulto al modulo el nivel de señal que esta recibiendo.
     int8_t rssi = 0;
     wifi_ap_record_t ap_info;
     esp_wifi_sta_get_ap_info(&ap_info);
     rssi = ap_info.rssi;
-    snprintf(buffer_rssi_txt, sizeof(buffer_rssi_txt), "%d", rssi);
 
-    bufferJson[0] = 0;
+    // El primer numero tras recuperar la secuencia del NVS se marca: el salto no son mensajes perdidos
+    bool seq_resync = false;
+    uint64_t seq = msg_sequence.next(&seq_resync);
 
-    strcat(bufferJson, "{ \"dev_id\": ");
-    strcat(bufferJson, mqtt_deviceId + strlen(mqtt_deviceId) - 3); // " + strlen(mqtt_deviceId) - 3", como trabajo con punteros, equivale a string.right(3)
-    strcat(bufferJson, ", \"temperatura\": ");
-    strcat(bufferJson, temp_string);
-    strcat(bufferJson, ", \"rssi\": ");
-    strcat(bufferJson, buffer_rssi_txt);
-    strcat(bufferJson, " }");
+    // El primer mensaje tras el arranque lleva los tiempos de cada fase del boot.
+    char buffer_boot_txt[200];
+    bool has_boot_summary = boot_timeline.summarize(buffer_boot_txt, sizeof(buffer_boot_txt)) > 0;
+    const char *extra = has_boot_summary ? buffer_boot_txt : NULL;
 
-    ESP_LOGI(SENSOR_LOG_TAG, "JSON enviado:  %s", bufferJson);
+    char buffer_extra_txt[sizeof(TEMP_SENSOR_SEQ_RESYNC_FIELD ", ") + sizeof(buffer_boot_txt)];
+    if (seq_resync)
+    {
+        snprintf(buffer_extra_txt, sizeof(buffer_extra_txt), "%s%s%s", TEMP_SENSOR_SEQ_RESYNC_FIELD,
+                 has_boot_summary ? ", " : "", has_boot_summary ? buffer_boot_txt : "");
+        extra = buffer_extra_txt;
+    }
+
+    temp_sensor_format_payload(bufferJson, sizeof(bufferJson), mqtt_deviceId, seq, temp_string, pressure, humidity, rssi,
+                               sample_time_ms, sample_time_error_ms, extra);
+
+    DLOGD(SENSOR_LOG_TAG, "JSON enviado:  %s", bufferJson);
+
+    // Con el despacho en marcha la muestra es telemetria de rutina: va en lotes, QoS 0
+    if (telemetry_dispatch.is_running())
+    {
+        if (telemetry_dispatch.send(TELEMETRY_CLASS_BULK, bufferJson, 0) != ESP_OK)
+            DLOGE(SENSOR_LOG_TAG, "No se pudo encolar la muestra.");
+        else if (has_boot_summary)
+            boot_timeline.mark_reported(); // La cola lo retiene hasta que haya conexion
+        return;
+    }
 
     bufferTopic[0] = 0;
     strcat(bufferTopic, "/devices/");
@@ -195,19 +386,23 @@ static void publish_to_mqtt(void)
     // Ejemplo para publicar telemetria (eventos) telemetria por defecto, derivada a un topic Google pub/sub
     //  Asi publico a una "subcarpeta", declarada en Clearblade y redirigida a un TOPIC de Google pub/sub
     strcat(bufferTopic, "/events");
-    msg_id = esp_mqtt_client_publish(*esp_mqtt_client_handle, bufferTopic, bufferJson, 0, 1, 0);
+    msg_id = clearblade_client_publish(mqtt_clearblade_client, NULL, bufferJson, 0, 1);
+    if (msg_id >= 0)
+    {
+        energy_meter.count_samples(1);
+        // Si no salio, el resumen va en la muestra siguiente
+        if (has_boot_summary)
+            boot_timeline.mark_reported();
+    }
 
     // Ejemplo para publicar telemetria (eventos) subcarpeta
     // Asi publico a una "subcarpeta", declarada en Clearblade y redirigida a un TOPIC de Google pub/sub
     // strcat(bufferTopic, "/events/bmp");
     // msg_id = esp_mqtt_client_publish(cliente, bufferTopic, bufferJson, 0, 1, 0);
 
-    // Ejemplo para publicar y actualizar STATE en IoT Core
-    // TOPIC: /devices/DEVICE-ID/state
-    // strcat(bufferTopic, "/state");
-    // msg_id = esp_mqtt_client_publish(cliente, bufferTopic, "state desde device-101", 0, 1, 0);
+    // El STATE (/devices/DEVICE-ID/state) lo publica state_shadow, solo cuando cambia
 
-    ESP_LOGI(SENSOR_LOG_TAG, "sent publish successful, msg_id=%d", msg_id);
+    DLOGI(SENSOR_LOG_TAG, "sent publish successful, msg_id=%d", msg_id);
 }
 
 /*****************************************************
@@ -217,9 +412,12 @@ const tempSensor_t tempSensor = {
     // Sensor Props
     .temp_string = temp_string,
     .temp = &temp,
+    .pressure = &pressure,
+    .humidity = &humidity,
     // Sensor Functions
     .initialize = initialize,
     .sample_temp = sample_temp,
+    .set_source = set_source,
     .go_sleep = go_sleep,
     .set_mqtt_info = set_mqtt_info,
     .publish_to_mqtt = publish_to_mqtt,
@@ -10,12 +10,29 @@
 #ifndef TEMP_SENSOR_H_
 #define TEMP_SENSOR_H_
 
-#include "mqtt_client.h"
+#include <stddef.h>
+#include <stdint.h>
+#include "clearblade_connect.h"
+#include "sensor_source.h"
+
+/* Umbrales de alarma; cada alarma se desactiva al volver a la zona normal
+ * con un margen de histeresis, para no oscilar en el limite */
+#ifndef TEMP_SENSOR_ALARM_TEMP_HIGH_C
+#define TEMP_SENSOR_ALARM_TEMP_HIGH_C 35.0f
+#endif
+#ifndef TEMP_SENSOR_ALARM_TEMP_LOW_C
+#define TEMP_SENSOR_ALARM_TEMP_LOW_C 2.0f
+#endif
+#ifndef TEMP_SENSOR_ALARM_HUM_HIGH_PCT
+#define TEMP_SENSOR_ALARM_HUM_HIGH_PCT 90.0f
+#endif
+#define TEMP_SENSOR_ALARM_TEMP_HYSTERESIS_C 1.0f
+#define TEMP_SENSOR_ALARM_HUM_HYSTERESIS_PCT 3.0f
 
 /************************************************************************/
 /* La siguiente estructura simula un objeto en C                        */
 /*                                                                      */
-/* En este caso representa un sensor de temperatura                     */
+/* En este caso representa un sensor de temperatura, presion y humedad  */
 /* Las propiedades estan implementadas comp punteros a variables del .c */
 /* Los metodos son punteros a funciones definidas dentro del .c         */
 /************************************************************************/
@@ -24,11 +41,14 @@ typedef struct
     // Sensor Props
     char *temp_string;
     float *temp;
+    float *pressure; // hPa
+    float *humidity; // %HR
     // Sensor Functions
     void (*initialize)(void);
     void (*sample_temp)(void);
+    esp_err_t (*set_source)(const sensor_source_t *source, const char *location);
     void (*go_sleep)(uint8_t seconds);
-    void (*set_mqtt_info)(const char *topic, const char *deviceId, esp_mqtt_client_handle_t *esp_mqtt_client_handle_pointer);
+    void (*set_mqtt_info)(const char *topic, const char *deviceId, clearblade_client_t *client);
     void (*publish_to_mqtt)(void);
 } tempSensor_t;
 
@@ -40,4 +60,12 @@ typedef struct
 /************************************************************************/
 extern const tempSensor_t tempSensor;
 
+/* Campo que marca el primer mensaje tras recuperar la secuencia del NVS */
+#define TEMP_SENSOR_SEQ_RESYNC_FIELD "\"seq_resync\": true"
+
+/* Formato sin estado, compartido con el simulador de flota (host/fleet_sim) */
+int temp_sensor_format_payload(char *buffer, size_t buffer_len, const char *device_id, uint64_t seq, const char *temp_text,
+                               float pressure_hpa, float humidity_pct, int8_t rssi, int64_t ts_ms, uint32_t ts_err_ms,
+                               const char *extra);
+
 #endif /* TEMP_SENSOR_H_ */
\ No newline at end of file
@@ -0,0 +1,257 @@
+/*
+ * tph_model.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "tph_model.h"
+
+#define TPH_DAY_S 86400.0
+#define TPH_TWO_PI 6.283185307179586
+// El seno del ciclo diario vale 1 a las 15 h locales
+#define TPH_DIURNAL_ZERO_S (9 * 3600)
+
+/* Limites de un sensor tipo BME280 */
+#define TPH_TEMP_MIN_C -40.0f
+#define TPH_TEMP_MAX_C 85.0f
+#define TPH_PRESS_MIN_HPA 300.0f
+#define TPH_PRESS_MAX_HPA 1100.0f
+#define TPH_HUM_MIN_PCT 0.0f
+#define TPH_HUM_MAX_PCT 100.0f
+
+void tph_model_default_params(tph_model_params_t *params)
+{
+    *params = (tph_model_params_t){
+        .temp_mean_c = 20.0f,
+        .temp_diurnal_amp_c = 5.0f,
+        .temp_anomaly_sigma_c = 2.0f,
+        .temp_anomaly_tau_s = 6 * 3600.0f,
+        .temp_noise_c = 0.1f,
+        .press_mean_hpa = 1013.25f,
+        .press_tide_amp_hpa = 0.8f,
+        .press_anomaly_sigma_hpa = 6.0f,
+        .press_anomaly_tau_s = 48 * 3600.0f,
+        .press_noise_hpa = 0.12f,
+        .hum_mean_pct = 60.0f,
+        .hum_temp_coupling = -2.5f,
+        .hum_press_correlation = -0.6f,
+        .hum_anomaly_sigma_pct = 8.0f,
+        .hum_anomaly_tau_s = 12 * 3600.0f,
+        .hum_noise_pct = 1.0f,
+    };
+}
+
+/*****************************************************
+ *   PRNG                                             *
+ ******************************************************/
+static inline uint32_t xorshift32(uint32_t x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+/* splitmix64 de (semilla, canal): canales vecinos quedan descorrelacionados */
+uint32_t tph_rng_seed(uint64_t seed, uint32_t lane)
+{
+    uint64_t z = seed + (lane + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    uint32_t state = (uint32_t)z ^ (uint32_t)(z >> 32);
+    return state != 0 ? state : 0x6D2B79F5u; // xorshift no sale del 0
+}
+
+uint32_t tph_rng_next(uint32_t *state)
+{
+    *state = xorshift32(*state);
+    return *state;
+}
+
+/* Uniforme en [-1, 1) */
+static float rng_uniform(uint32_t *state)
+{
+    return (int32_t)(tph_rng_next(state) >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+/* Aproximadamente normal: suma de cuatro uniformes de 16 bits (Irwin-Hall),
+ * centrada y con varianza 1. Solo enteros y una conversion, para vectorizar */
+static inline float normal_from(uint32_t a, uint32_t b)
+{
+    int32_t sum = (int32_t)(a & 0xffff) + (int32_t)(a >> 16) + (int32_t)(b & 0xffff) + (int32_t)(b >> 16);
+    return (float)(sum - 131070) * (1.7320508f / 65536.0f);
+}
+
+/* Uniforme en [-1, 1) de un campo de 10 bits */
+static inline float noise_from(uint32_t x, int shift)
+{
+    return (float)((int32_t)((x >> shift) & 0x3ff) - 512) * (1.0f / 512.0f);
+}
+
+static inline float clampf(float value, float low, float high)
+{
+    value = value < low ? low : value;
+    return value > high ? high : value;
+}
+
+/*****************************************************
+ *   Modelo                                           *
+ ******************************************************/
+void tph_model_set_step(tph_model_t *model, float step_s)
+{
+    const tph_model_params_t *p = &model->params;
+    double angle = TPH_TWO_PI * step_s / TPH_DAY_S;
+
+    model->step_s = step_s;
+    model->rot_cos = (float)cos(angle);
+    model->rot_sin = (float)sin(angle);
+
+    // AR(1) con desvio estacionario sigma: a' = phi a + sigma sqrt(1 - phi^2) n
+    model->temp_phi = expf(-step_s / p->temp_anomaly_tau_s);
+    model->temp_gain = p->temp_anomaly_sigma_c * sqrtf(1.0f - model->temp_phi * model->temp_phi);
+    model->press_phi = expf(-step_s / p->press_anomaly_tau_s);
+    model->press_gain = p->press_anomaly_sigma_hpa * sqrtf(1.0f - model->press_phi * model->press_phi);
+    model->hum_phi = expf(-step_s / p->hum_anomaly_tau_s);
+    model->hum_gain = p->hum_anomaly_sigma_pct * sqrtf(1.0f - model->hum_phi * model->hum_phi);
+}
+
+void tph_model_set_time(tph_model_t *model, double time_s)
+{
+    model->time_s = time_s;
+    double local_s = fmod(time_s + model->params.utc_offset_s - TPH_DIURNAL_ZERO_S, TPH_DAY_S);
+    for (uint32_t c = 0; c < model->channels; c++)
+    {
+        double angle = TPH_TWO_PI * (local_s + model->phase_offset_s[c]) / TPH_DAY_S;
+        model->diurnal_cos[c] = (float)cos(angle);
+        model->diurnal_sin[c] = (float)sin(angle);
+    }
+}
+
+esp_err_t tph_model_init(tph_model_t *model, const tph_model_params_t *params, void *storage, size_t storage_len,
+                         uint32_t channels, uint64_t seed, uint32_t first_lane, double start_time_s, float step_s)
+{
+    if (channels == 0 || storage == NULL || storage_len < TPH_MODEL_STORAGE_BYTES(channels) || step_s <= 0)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(model, 0, sizeof(*model));
+    model->channels = channels;
+    model->lanes = TPH_MODEL_LANES(channels);
+    model->params = *params;
+
+    float *arrays = storage;
+    uint32_t lanes = model->lanes;
+    model->site_temp = arrays + 0 * lanes;
+    model->site_press = arrays + 1 * lanes;
+    model->site_hum = arrays + 2 * lanes;
+    model->phase_offset_s = arrays + 3 * lanes;
+    model->diurnal_cos = arrays + 4 * lanes;
+    model->diurnal_sin = arrays + 5 * lanes;
+    model->temp_anomaly = arrays + 6 * lanes;
+    model->press_anomaly = arrays + 7 * lanes;
+    model->hum_anomaly = arrays + 8 * lanes;
+    model->rng = (uint32_t *)(arrays + 9 * lanes);
+
+    for (uint32_t c = 0; c < channels; c++)
+    {
+        uint32_t *rng = &model->rng[c];
+        *rng = tph_rng_seed(seed, first_lane + c);
+        model->site_temp[c] = params->temp_mean_c + params->site_temp_spread_c * rng_uniform(rng);
+        model->site_press[c] = params->press_mean_hpa + params->site_press_spread_hpa * rng_uniform(rng);
+        model->site_hum[c] = params->hum_mean_pct + params->site_hum_spread_pct * rng_uniform(rng);
+        model->phase_offset_s[c] = params->site_phase_spread_s * rng_uniform(rng);
+        // Las anomalias arrancan en su distribucion estacionaria
+        model->temp_anomaly[c] = params->temp_anomaly_sigma_c * normal_from(tph_rng_next(rng), tph_rng_next(rng));
+        model->press_anomaly[c] = params->press_anomaly_sigma_hpa * normal_from(tph_rng_next(rng), tph_rng_next(rng));
+        model->hum_anomaly[c] = params->hum_anomaly_sigma_pct * normal_from(tph_rng_next(rng), tph_rng_next(rng));
+    }
+    tph_model_set_step(model, step_s);
+    tph_model_set_time(model, start_time_s);
+    return ESP_OK;
+}
+
+/* Un paso de todos los canales. GCC solo confia en restrict cuando los
+ * punteros son parametros: por eso cada arreglo entra por separado y los
+ * coeficientes se copian a variables locales. Asi el loop se vectoriza */
+static void step_kernel(const tph_model_t *model, uint32_t channels, const float *restrict site_temp,
+                        const float *restrict site_press, const float *restrict site_hum, float *restrict dcos,
+                        float *restrict dsin, float *restrict temp_anomaly, float *restrict press_anomaly,
+                        float *restrict hum_anomaly, uint32_t *restrict rng, float *restrict temp_out,
+                        float *restrict press_out, float *restrict hum_out)
+{
+    const tph_model_params_t *p = &model->params;
+    const float rot_cos = model->rot_cos, rot_sin = model->rot_sin;
+    const float temp_phi = model->temp_phi, temp_gain = model->temp_gain;
+    const float press_phi = model->press_phi, press_gain = model->press_gain;
+    const float hum_phi = model->hum_phi, hum_gain = model->hum_gain;
+    const float temp_amp = p->temp_diurnal_amp_c, tide_amp = p->press_tide_amp_hpa;
+    const float hum_coupling = p->hum_temp_coupling;
+    const float hum_rho = p->hum_press_correlation;
+    const float hum_rho_rest = sqrtf(1.0f - hum_rho * hum_rho);
+    const float temp_noise = p->temp_noise_c, press_noise = p->press_noise_hpa, hum_noise = p->hum_noise_pct;
+
+    for (uint32_t c = 0; c < channels; c++)
+    {
+        uint32_t x1 = xorshift32(rng[c]);
+        uint32_t x2 = xorshift32(x1);
+        uint32_t x3 = xorshift32(x2);
+        uint32_t x4 = xorshift32(x3);
+        uint32_t x5 = xorshift32(x4);
+        uint32_t x6 = xorshift32(x5);
+        uint32_t x7 = xorshift32(x6);
+        rng[c] = x7;
+        float n_temp = normal_from(x1, x2);
+        float n_press = normal_from(x3, x4);
+        float n_hum = hum_rho * n_press + hum_rho_rest * normal_from(x5, x6);
+
+        // Fasor del ciclo diario, rotado un paso
+        float cs = dcos[c] * rot_cos - dsin[c] * rot_sin;
+        float sn = dsin[c] * rot_cos + dcos[c] * rot_sin;
+        dcos[c] = cs;
+        dsin[c] = sn;
+
+        float ta = temp_phi * temp_anomaly[c] + temp_gain * n_temp;
+        float pa = press_phi * press_anomaly[c] + press_gain * n_press;
+        float ha = hum_phi * hum_anomaly[c] + hum_gain * n_hum;
+        temp_anomaly[c] = ta;
+        press_anomaly[c] = pa;
+        hum_anomaly[c] = ha;
+
+        float temp_dev = temp_amp * sn + ta;
+        // cos(2 * angulo): la marea barometrica tiene dos maximos por dia
+        float tide = tide_amp * (cs * cs - sn * sn);
+        float t = site_temp[c] + temp_dev + temp_noise * noise_from(x7, 0);
+        float pr = site_press[c] + pa + tide + press_noise * noise_from(x7, 10);
+        float h = site_hum[c] + hum_coupling * temp_dev + ha + hum_noise * noise_from(x7, 20);
+
+        temp_out[c] = clampf(t, TPH_TEMP_MIN_C, TPH_TEMP_MAX_C);
+        press_out[c] = clampf(pr, TPH_PRESS_MIN_HPA, TPH_PRESS_MAX_HPA);
+        hum_out[c] = clampf(h, TPH_HUM_MIN_PCT, TPH_HUM_MAX_PCT);
+    }
+}
+
+void tph_model_generate(tph_model_t *model, uint32_t steps, float *temp_c, float *press_hpa, float *hum_pct)
+{
+    size_t channels = model->channels;
+
+    for (uint32_t s = 0; s < steps; s++)
+        step_kernel(model, model->channels, model->site_temp, model->site_press, model->site_hum, model->diurnal_cos,
+                    model->diurnal_sin, model->temp_anomaly, model->press_anomaly, model->hum_anomaly, model->rng,
+                    temp_c + s * channels, press_hpa + s * channels, hum_pct + s * channels);
+    model->time_s += (double)steps * model->step_s;
+
+    // La rotacion en float acumula error en el modulo del fasor: se corrige con
+    // un paso de Newton hacia 1, sin raiz cuadrada
+    float *restrict dcos = model->diurnal_cos;
+    float *restrict dsin = model->diurnal_sin;
+    for (size_t c = 0; c < channels; c++)
+    {
+        float scale = 1.5f - 0.5f * (dcos[c] * dcos[c] + dsin[c] * dsin[c]);
+        dcos[c] *= scale;
+        dsin[c] *= scale;
+    }
+}
@@ -0,0 +1,113 @@
+/*
+ * tph_model.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef TPH_MODEL_H_
+#define TPH_MODEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/************************************************************************/
+/* Modelo de temperatura, presion y humedad para N canales (sensores).  */
+/*                                                                      */
+/* Cada canal tiene su sitio (medias propias), un ciclo diario          */
+/* (temperatura con pico a las 15 h, marea barometrica de 12 h) y tres  */
+/* anomalias AR(1) de distinta memoria: clima (temperatura), sistemas   */
+/* de presion (dias) y humedad. La humedad baja cuando sube la          */
+/* temperatura y sube cuando baja la presion. A eso se suma el ruido    */
+/* del sensor.                                                          */
+/*                                                                      */
+/* El estado se guarda como estructura de arreglos (un arreglo por      */
+/* variable, un elemento por canal) y cada paso se calcula para todos   */
+/* los canales en un loop sin ramas ni llamadas, que el compilador      */
+/* puede vectorizar. El generador pseudoaleatorio es un xorshift32 por  */
+/* canal sembrado con (semilla, numero de canal): la misma semilla da   */
+/* la misma secuencia, sin importar como se reparten los canales.       */
+/************************************************************************/
+
+/* Arreglos de estado por canal; cada arreglo ocupa un multiplo de 8 canales
+ * para que todos queden alineados igual */
+#define TPH_MODEL_ARRAYS 10
+#define TPH_MODEL_LANES(channels) (((channels) + 7u) & ~7u)
+#define TPH_MODEL_STORAGE_BYTES(channels) (TPH_MODEL_LANES(channels) * TPH_MODEL_ARRAYS * sizeof(float))
+
+typedef struct
+{
+    float temp_mean_c;           // Media del sitio
+    float temp_diurnal_amp_c;    // Amplitud del ciclo diario
+    float temp_anomaly_sigma_c;  // Desvio estacionario de la anomalia
+    float temp_anomaly_tau_s;    // Memoria de la anomalia
+    float temp_noise_c;          // Ruido del sensor (maximo, uniforme)
+    float press_mean_hpa;
+    float press_tide_amp_hpa;    // Marea barometrica semidiurna
+    float press_anomaly_sigma_hpa;
+    float press_anomaly_tau_s;
+    float press_noise_hpa;
+    float hum_mean_pct;
+    float hum_temp_coupling;     // %HR por grado de desvio de temperatura
+    float hum_press_correlation; // Correlacion entre las innovaciones de humedad y presion
+    float hum_anomaly_sigma_pct;
+    float hum_anomaly_tau_s;
+    float hum_noise_pct;
+    float site_temp_spread_c;    // Dispersion de las medias entre canales
+    float site_press_spread_hpa;
+    float site_hum_spread_pct;
+    float site_phase_spread_s;   // Dispersion del horario del ciclo diario
+    int32_t utc_offset_s;        // Huso horario de los sitios (el ciclo diario es local)
+} tph_model_params_t;
+
+typedef struct
+{
+    uint32_t channels;
+    uint32_t lanes;
+    double time_s; // Hora unix de la ultima muestra generada
+    float step_s;
+    tph_model_params_t params;
+
+    // Coeficientes de un paso, los recalcula tph_model_set_step()
+    float rot_cos;
+    float rot_sin;
+    float temp_phi;
+    float temp_gain;
+    float press_phi;
+    float press_gain;
+    float hum_phi;
+    float hum_gain;
+
+    // Estado por canal (apuntan al almacenamiento de tph_model_init())
+    float *site_temp;
+    float *site_press;
+    float *site_hum;
+    float *phase_offset_s;
+    float *diurnal_cos;
+    float *diurnal_sin;
+    float *temp_anomaly;
+    float *press_anomaly;
+    float *hum_anomaly;
+    uint32_t *rng;
+} tph_model_t;
+
+/* Valores de un clima templado; sin dispersion entre canales */
+void tph_model_default_params(tph_model_params_t *params);
+
+/* storage: TPH_MODEL_STORAGE_BYTES(channels) bytes alineados a 4, propiedad del
+ * llamador. first_lane: numero del primer canal en la flota, para la semilla */
+esp_err_t tph_model_init(tph_model_t *model, const tph_model_params_t *params, void *storage, size_t storage_len,
+                         uint32_t channels, uint64_t seed, uint32_t first_lane, double start_time_s, float step_s);
+/* Cambia el intervalo entre muestras */
+void tph_model_set_step(tph_model_t *model, float step_s);
+/* Resincroniza el ciclo diario con la hora unix (las anomalias se conservan) */
+void tph_model_set_time(tph_model_t *model, double time_s);
+/* Genera steps pasos de todos los canales: salida[paso * channels + canal] */
+void tph_model_generate(tph_model_t *model, uint32_t steps, float *temp_c, float *press_hpa, float *hum_pct);
+
+/* PRNG deterministico: siembra de un canal y siguiente valor */
+uint32_t tph_rng_seed(uint64_t seed, uint32_t lane);
+uint32_t tph_rng_next(uint32_t *state);
+
+#endif /* TPH_MODEL_H_ */
@@ -0,0 +1,248 @@
+/*
+ * state_shadow.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_app_desc.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+
+#include "mqtt_basico.h"
+#include "resource_monitor.h"
+#include "state_shadow.h"
+
+#define ALL_FIELDS ((1u << STATE_FIELD_COUNT) - 1)
+
+static const char *TAG = "State shadow";
+
+static clearblade_client_t *shadow_client = NULL;
+static state_shadow_values_t reported;   // Lo que el backend ya tiene
+static state_shadow_stats_t stats;
+static uint32_t seq = 0;
+
+static SemaphoreHandle_t shadow_mutex = NULL;
+static StaticSemaphore_t shadow_mutex_buffer;
+static TaskHandle_t shadow_task_handle = NULL;
+
+#ifdef STATIC_ALLOCATION_MODE
+static StackType_t shadow_task_stack[STATE_SHADOW_TASK_STACK_SIZE];
+static StaticTask_t shadow_task_buffer;
+#endif
+
+static void lock(void)
+{
+    xSemaphoreTake(shadow_mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(shadow_mutex);
+}
+
+uint32_t state_shadow_diff(const state_shadow_values_t *current, const state_shadow_values_t *reported)
+{
+    uint32_t mask = 0;
+    if (strcmp(current->firmware, reported->firmware) != 0)
+        mask |= 1u << STATE_FIELD_FIRMWARE;
+    if (current->config_version != reported->config_version)
+        mask |= 1u << STATE_FIELD_CONFIG;
+    // Asociarse o perder el AP siempre cuenta; el resto, fuera de la histeresis
+    if ((current->rssi == 0) != (reported->rssi == 0) ||
+        abs(current->rssi - reported->rssi) >= STATE_SHADOW_RSSI_HYSTERESIS_DB)
+        mask |= 1u << STATE_FIELD_RSSI;
+    if (current->error_code != reported->error_code)
+        mask |= 1u << STATE_FIELD_ERRORS;
+    return mask;
+}
+
+int state_shadow_format(char *buffer, size_t buffer_len, const state_shadow_values_t *values, uint32_t mask, uint32_t seq,
+                        bool snapshot, int64_t uptime_s)
+{
+#define APPEND(...) len += snprintf(len < buffer_len ? buffer + len : NULL, len < buffer_len ? buffer_len - len : 0, __VA_ARGS__)
+    size_t len = 0;
+    APPEND("{\"n\": %lu", (unsigned long)seq);
+    if (snapshot)
+        APPEND(", \"snap\": 1");
+    if (mask & (1u << STATE_FIELD_FIRMWARE))
+        APPEND(", \"fw\": \"%s\"", values->firmware);
+    if (mask & (1u << STATE_FIELD_CONFIG))
+        APPEND(", \"cfg\": %lu", (unsigned long)values->config_version);
+    if (mask & (1u << STATE_FIELD_RSSI))
+        APPEND(", \"rssi\": %d", values->rssi);
+    if (mask & (1u << STATE_FIELD_ERRORS))
+        APPEND(", \"err\": %lu", (unsigned long)values->error_code);
+    APPEND(", \"up\": %lld}", (long long)uptime_s);
+#undef APPEND
+    return (int)len;
+}
+
+/* El firmware se copia una vez en start(): no cambia sin reiniciar */
+static void collect(state_shadow_values_t *values)
+{
+    values->config_version = clearblade_client_get_config_version(shadow_client);
+    values->error_code = (uint32_t)last_error_code;
+    wifi_ap_record_t ap;
+    values->rssi = esp_wifi_sta_get_ap_info(&ap) == ESP_OK ? ap.rssi : 0;
+}
+
+static bool mqtt_connected(void)
+{
+    return (xEventGroupGetBits(shadow_client->event_group) & CONNECTED_TO_MQTT_BROKER) != 0;
+}
+
+/* Publica los campos de mask; si el cliente la acepta, pasan a ser lo reportado */
+static bool publish(const state_shadow_values_t *current, uint32_t mask, bool snapshot)
+{
+    char message[STATE_SHADOW_MAX_LEN];
+    int len = state_shadow_format(message, sizeof(message), current, mask, seq + 1, snapshot,
+                                  esp_timer_get_time() / 1000000);
+    if (len >= (int)sizeof(message))
+    {
+        ESP_LOGE(TAG, "Estado de %d bytes, no entra en STATE_SHADOW_MAX_LEN", len);
+        return false;
+    }
+    if (clearblade_client_publish(shadow_client, STATE_SHADOW_SUBTOPIC, message, len, 1) < 0)
+    {
+        lock();
+        stats.failed++;
+        unlock();
+        return false;
+    }
+
+    lock();
+    seq++;
+    if (snapshot)
+    {
+        reported = *current;
+        stats.snapshots++;
+    }
+    else
+    {
+        if (mask & (1u << STATE_FIELD_CONFIG))
+            reported.config_version = current->config_version;
+        if (mask & (1u << STATE_FIELD_RSSI))
+            reported.rssi = current->rssi;
+        if (mask & (1u << STATE_FIELD_ERRORS))
+            reported.error_code = current->error_code;
+        stats.diffs++;
+        stats.fields_sent += __builtin_popcount(mask);
+    }
+    stats.bytes += len;
+    unlock();
+    ESP_LOGD(TAG, "%.*s", len, message);
+    return true;
+}
+
+static void shadow_task(void *param)
+{
+    state_shadow_values_t current;
+    uint32_t snapshot_connects = 0; // Conexion para la que ya salio el snapshot
+    int64_t window_start_us = 0;
+
+    resource_monitor.register_task(NULL, "state_shadow", STATE_SHADOW_TASK_STACK_SIZE);
+    lock();
+    current = reported;
+    unlock();
+    while (true)
+    {
+        vTaskDelay(pdMS_TO_TICKS(STATE_SHADOW_POLL_MS));
+        // Desconectado no se publica: al volver sale el snapshot con todo lo que cambio
+        if (!mqtt_connected())
+            continue;
+        collect(&current);
+
+        clearblade_link_stats_t link;
+        clearblade_client_get_link_stats(shadow_client, &link);
+        if (link.connects != snapshot_connects)
+        {
+            if (publish(&current, ALL_FIELDS, true))
+                snapshot_connects = link.connects;
+            window_start_us = 0;
+            continue;
+        }
+
+        lock();
+        uint32_t changed = state_shadow_diff(&current, &reported);
+        unlock();
+        int64_t now = esp_timer_get_time();
+        if (changed == 0)
+        {
+            if (window_start_us != 0)
+            {
+                lock();
+                stats.reverted++;
+                unlock();
+            }
+            window_start_us = 0;
+            continue;
+        }
+        if (window_start_us == 0)
+            window_start_us = now;
+        if (now - window_start_us >= STATE_SHADOW_COALESCE_MS * 1000LL && publish(&current, changed, false))
+            window_start_us = 0;
+    }
+}
+
+static esp_err_t start(clearblade_client_t *client)
+{
+    if (shadow_task_handle != NULL)
+        return ESP_ERR_INVALID_STATE;
+    shadow_client = client;
+    shadow_mutex = xSemaphoreCreateMutexStatic(&shadow_mutex_buffer);
+    strlcpy(reported.firmware, esp_app_get_description()->version, sizeof(reported.firmware));
+
+#ifdef STATIC_ALLOCATION_MODE
+    shadow_task_handle = xTaskCreateStatic(shadow_task, "state_shadow", STATE_SHADOW_TASK_STACK_SIZE, NULL, 2,
+                                           shadow_task_stack, &shadow_task_buffer);
+#else
+    if (xTaskCreate(shadow_task, "state_shadow", STATE_SHADOW_TASK_STACK_SIZE, NULL, 2, &shadow_task_handle) != pdPASS)
+        shadow_task_handle = NULL;
+#endif
+    if (shadow_task_handle == NULL)
+        return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+static void get_reported(state_shadow_values_t *values)
+{
+    if (shadow_mutex == NULL)
+    {
+        memset(values, 0, sizeof(*values));
+        return;
+    }
+    lock();
+    *values = reported;
+    unlock();
+}
+
+static void get_stats(state_shadow_stats_t *out)
+{
+    if (shadow_mutex == NULL)
+    {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    lock();
+    *out = stats;
+    unlock();
+}
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)            *
+ ******************************************************/
+const state_shadow_t state_shadow = {
+    // State Shadow Functions
+    .start = start,
+    .get_reported = get_reported,
+    .get_stats = get_stats,
+};
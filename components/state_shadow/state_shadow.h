@@ -0,0 +1,96 @@
+/*
+ * state_shadow.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef STATE_SHADOW_H_
+#define STATE_SHADOW_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "clearblade_connect.h"
+
+#define STATE_SHADOW_SUBTOPIC "state"
+#define STATE_SHADOW_POLL_MS 1000
+/* Ventana de agrupado: los cambios que llegan dentro de ella salen en un */
+/* unico mensaje, y los que se revierten antes de cerrarla no salen       */
+#ifndef STATE_SHADOW_COALESCE_MS
+#define STATE_SHADOW_COALESCE_MS (5 * 1000)
+#endif
+/* El RSSI solo cuenta como cambio si se aleja esto del ultimo reportado */
+#ifndef STATE_SHADOW_RSSI_HYSTERESIS_DB
+#define STATE_SHADOW_RSSI_HYSTERESIS_DB 6
+#endif
+#define STATE_SHADOW_FIRMWARE_MAX_LEN 32
+#define STATE_SHADOW_MAX_LEN 192
+#define STATE_SHADOW_TASK_STACK_SIZE (4096 * 1)
+
+typedef enum
+{
+    STATE_FIELD_FIRMWARE = 0, // "fw"
+    STATE_FIELD_CONFIG,       // "cfg": version de la configuracion aplicada
+    STATE_FIELD_RSSI,         // "rssi": dBm del AP de la estacion, 0 sin asociacion
+    STATE_FIELD_ERRORS,       // "err": last_error_code (ERROR_CODE_*)
+    STATE_FIELD_COUNT
+} state_field_t;
+
+typedef struct
+{
+    char firmware[STATE_SHADOW_FIRMWARE_MAX_LEN];
+    uint32_t config_version;
+    int8_t rssi;
+    uint32_t error_code;
+} state_shadow_values_t;
+
+typedef struct
+{
+    uint32_t snapshots;
+    uint32_t diffs;
+    uint32_t fields_sent;   // Campos en los diffs
+    uint32_t reverted;      // Ventanas que cerraron sin cambios netos
+    uint32_t failed;        // Publicaciones rechazadas (se reintentan)
+    uint32_t bytes;
+} state_shadow_stats_t;
+
+/************************************************************************/
+/* La siguiente estructura simula un objeto en C                        */
+/*                                                                      */
+/* Sombra del estado del dispositivo en /devices/<id>/state. Una tarea  */
+/* lee cada STATE_SHADOW_POLL_MS la version del firmware y de la        */
+/* configuracion, el RSSI y last_error_code, y los compara con lo       */
+/* ultimo que reporto. Los cambios abren una ventana de                 */
+/* STATE_SHADOW_COALESCE_MS; al cerrarla publica solo los campos que    */
+/* siguen distintos, con el tiempo desde el arranque:                   */
+/*                                                                      */
+/*   {"n": 12, "rssi": -71, "up": 3605}                                 */
+/*                                                                      */
+/* Tras cada conexion al broker publica el estado completo ("snap"),    */
+/* asi el backend no depende de los diffs que se perdieron offline:     */
+/*                                                                      */
+/*   {"n": 13, "snap": 1, "fw": "1.4.0", "cfg": 7, "rssi": -64,         */
+/*    "err": 0, "up": 3720}                                             */
+/*                                                                      */
+/* "n" crece con cada mensaje: un salto le indica al backend que falta  */
+/* un diff y que debe esperar el proximo snapshot.                      */
+/************************************************************************/
+typedef struct
+{
+    // State Shadow Functions
+    esp_err_t (*start)(clearblade_client_t *client);
+    void (*get_reported)(state_shadow_values_t *values);
+    void (*get_stats)(state_shadow_stats_t *stats);
+} state_shadow_t;
+
+extern const state_shadow_t state_shadow;
+
+/* Campos de current que difieren de reported (bit 1 << state_field_t) */
+uint32_t state_shadow_diff(const state_shadow_values_t *current, const state_shadow_values_t *reported);
+/* Arma el mensaje con los campos de mask; devuelve el largo (o el que haria falta) */
+int state_shadow_format(char *buffer, size_t buffer_len, const state_shadow_values_t *values, uint32_t mask, uint32_t seq,
+                        bool snapshot, int64_t uptime_s);
+
+#endif /* STATE_SHADOW_H_ */
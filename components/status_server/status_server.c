@@ -0,0 +1,430 @@
+/*
+ * status_server.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_http_server.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "lwip/sockets.h"
+
+#include "deferred_log.h"
+#include "energy_meter.h"
+#include "health_supervisor.h"
+#include "mqtt_basico.h"
+#include "resource_monitor.h"
+#include "sample_history.h"
+#include "sample_store.h"
+#include "state_shadow.h"
+#include "telemetry_dispatch.h"
+#include "status_server.h"
+
+static const char *TAG = "Status server";
+
+static const char *const class_names[TELEMETRY_CLASS_COUNT] = {
+    [TELEMETRY_CLASS_ALARM] = "alarm",
+    [TELEMETRY_CLASS_BULK] = "bulk",
+};
+
+static httpd_handle_t server = NULL;
+static clearblade_client_t *status_client = NULL;
+static status_server_stats_t stats;
+
+/*****************************************************
+ *   Salida en bloques                                *
+ ******************************************************/
+typedef struct
+{
+    httpd_req_t *req;
+    size_t len;
+    esp_err_t err;
+    char buffer[STATUS_SERVER_CHUNK_SIZE];
+} chunk_writer_t;
+
+static void writer_flush(chunk_writer_t *writer)
+{
+    if (writer->len > 0 && writer->err == ESP_OK)
+        writer->err = httpd_resp_send_chunk(writer->req, writer->buffer, writer->len);
+    writer->len = 0;
+}
+
+/* Agrega texto al bloque; si no entra, envia el bloque y lo escribe en uno nuevo */
+static void __attribute__((format(printf, 2, 3))) writer_printf(chunk_writer_t *writer, const char *format, ...)
+{
+    if (writer->err != ESP_OK)
+        return;
+    va_list args;
+    va_start(args, format);
+    size_t room = sizeof(writer->buffer) - writer->len;
+    int n = vsnprintf(writer->buffer + writer->len, room, format, args);
+    va_end(args);
+    if (n < 0)
+        return;
+    if ((size_t)n >= room)
+    {
+        writer_flush(writer);
+        va_start(args, format);
+        n = vsnprintf(writer->buffer, sizeof(writer->buffer), format, args);
+        va_end(args);
+        if ((size_t)n >= sizeof(writer->buffer))
+            n = sizeof(writer->buffer) - 1; // Una linea mas larga que el bloque sale cortada
+    }
+    writer->len += n;
+}
+
+static esp_err_t writer_finish(chunk_writer_t *writer)
+{
+    writer_flush(writer);
+    if (writer->err == ESP_OK)
+        writer->err = httpd_resp_send_chunk(writer->req, NULL, 0);
+    if (writer->err != ESP_OK)
+        stats.send_errors++;
+    return writer->err;
+}
+
+/*****************************************************
+ *   Datos                                            *
+ ******************************************************/
+
+/* El pedido tiene que haber llegado a la direccion de la SoftAP */
+static bool from_softap(httpd_req_t *req)
+{
+#if STATUS_SERVER_AP_ONLY
+    struct sockaddr_storage local;
+    socklen_t local_len = sizeof(local);
+    if (getsockname(httpd_req_to_sockfd(req), (struct sockaddr *)&local, &local_len) != 0)
+        return false;
+
+    uint32_t addr;
+    if (local.ss_family == AF_INET)
+        addr = ((struct sockaddr_in *)&local)->sin_addr.s_addr;
+    else if (local.ss_family == AF_INET6)
+        memcpy(&addr, (uint8_t *)&((struct sockaddr_in6 *)&local)->sin6_addr + 12, sizeof(addr)); // ::ffff:a.b.c.d
+    else
+        return false;
+
+    esp_netif_ip_info_t ap_info;
+    esp_netif_t *ap = esp_netif_get_handle_from_ifkey("WIFI_AP_DEF");
+    return ap != NULL && esp_netif_get_ip_info(ap, &ap_info) == ESP_OK && addr == ap_info.ip.addr;
+#else
+    return true;
+#endif
+}
+
+static bool begin_request(httpd_req_t *req, const char *type)
+{
+    // La tarea del servidor es del ESP-IDF: se registra en su primer pedido
+    resource_monitor.register_task(NULL, "httpd", STATUS_SERVER_TASK_STACK_SIZE);
+    stats.requests++;
+    if (!from_softap(req))
+    {
+        stats.rejected++;
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Solo por la SoftAP");
+        return false;
+    }
+    httpd_resp_set_type(req, type);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return true;
+}
+
+static bool mqtt_connected(void)
+{
+    return status_client != NULL && (xEventGroupGetBits(status_client->event_group) & CONNECTED_TO_MQTT_BROKER) != 0;
+}
+
+/*****************************************************
+ *   GET /metrics                                     *
+ ******************************************************/
+static void family(chunk_writer_t *writer, const char *name, const char *type, const char *help)
+{
+    writer_printf(writer, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void metric(chunk_writer_t *writer, const char *name, const char *type, const char *help, long long value)
+{
+    family(writer, name, type, help);
+    writer_printf(writer, "%s %lld\n", name, value);
+}
+
+static void write_link_metrics(chunk_writer_t *writer)
+{
+    static const uint32_t bounds_ms[CLEARBLADE_ACK_LATENCY_BUCKETS] = CLEARBLADE_ACK_LATENCY_BOUNDS_MS;
+    clearblade_link_stats_t link;
+    publish_limiter_stats_t limiter;
+    clearblade_client_get_link_stats(status_client, &link);
+    clearblade_client_get_publish_stats(status_client, &limiter);
+
+    metric(writer, "mqtt_connected", "gauge", "Conectado al broker", mqtt_connected());
+    metric(writer, "mqtt_connects_total", "counter", "Conexiones al broker", link.connects);
+    metric(writer, "mqtt_disconnects_total", "counter", "Desconexiones del broker", link.disconnects);
+    metric(writer, "mqtt_errors_total", "counter", "MQTT_EVENT_ERROR", link.errors);
+    metric(writer, "mqtt_published_total", "counter", "Publicaciones aceptadas por el cliente", link.published);
+    metric(writer, "mqtt_acked_total", "counter", "PUBACK recibidos", link.acked);
+    metric(writer, "publish_limiter_throttled_total", "counter", "Publicaciones que esperaron turno", limiter.throttled);
+    metric(writer, "publish_limiter_rejected_total", "counter", "Publicaciones descartadas por cuota", limiter.rejected);
+
+    // Histograma de Prometheus: baldes acumulados
+    family(writer, "mqtt_puback_latency_ms", "histogram", "Latencia de publicacion a PUBACK (QoS 1)");
+    uint32_t cumulative = 0;
+    for (int i = 0; i < CLEARBLADE_ACK_LATENCY_BUCKETS; i++)
+    {
+        cumulative += link.ack_latency_count[i];
+        writer_printf(writer, "mqtt_puback_latency_ms_bucket{le=\"%u\"} %u\n", (unsigned)bounds_ms[i], (unsigned)cumulative);
+    }
+    cumulative += link.ack_latency_count[CLEARBLADE_ACK_LATENCY_BUCKETS];
+    writer_printf(writer, "mqtt_puback_latency_ms_bucket{le=\"+Inf\"} %u\n", (unsigned)cumulative);
+    writer_printf(writer, "mqtt_puback_latency_ms_sum %llu\nmqtt_puback_latency_ms_count %u\n",
+                  (unsigned long long)link.ack_latency_ms_total, (unsigned)cumulative);
+}
+
+static void write_queue_metrics(chunk_writer_t *writer)
+{
+    telemetry_dispatch_stats_t classes[TELEMETRY_CLASS_COUNT];
+    for (int cls = 0; cls < TELEMETRY_CLASS_COUNT; cls++)
+        telemetry_dispatch.get_stats(cls, &classes[cls]);
+
+#define CLASS_FAMILY(name, type, help, field)                                                          \
+    do                                                                                                 \
+    {                                                                                                  \
+        family(writer, name, type, help);                                                              \
+        for (int cls = 0; cls < TELEMETRY_CLASS_COUNT; cls++)                                          \
+            writer_printf(writer, name "{class=\"%s\"} %llu\n", class_names[cls],                      \
+                          (unsigned long long)classes[cls].field);                                     \
+    } while (0)
+
+    CLASS_FAMILY("telemetry_queue_depth", "gauge", "Mensajes en cola", depth);
+    CLASS_FAMILY("telemetry_queue_max_depth", "gauge", "Maxima ocupacion de la cola", max_depth);
+    CLASS_FAMILY("telemetry_queue_wait_us_max", "gauge", "Maxima espera en cola", wait_us_max);
+    CLASS_FAMILY("telemetry_published_total", "counter", "Mensajes publicados", published);
+    CLASS_FAMILY("telemetry_dropped_total", "counter", "Mensajes descartados", dropped);
+    CLASS_FAMILY("telemetry_compressed_total", "counter", "Lotes publicados comprimidos", compressed);
+    CLASS_FAMILY("telemetry_raw_bytes_total", "counter", "Bytes de los lotes antes de comprimir", raw_bytes);
+    CLASS_FAMILY("telemetry_sent_bytes_total", "counter", "Bytes de lotes publicados", sent_bytes);
+#undef CLASS_FAMILY
+
+    deferred_log_stats_t log;
+    deferred_log.get_stats(&log);
+    metric(writer, "deferred_log_ring_high_water", "gauge", "Maxima ocupacion del anillo de log", log.high_water);
+    metric(writer, "deferred_log_dropped_total", "counter", "Mensajes de log descartados", log.dropped);
+
+    sample_store_stats_t store;
+    sample_history_stats_t history;
+    sample_store.get_stats(&store);
+    sample_history.get_stats(&history);
+    metric(writer, "sample_store_used_sectors", "gauge", "Sectores con muestras", store.used_sectors);
+    metric(writer, "sample_store_appended_total", "counter", "Muestras grabadas", store.appended);
+    metric(writer, "sample_history_requests_total", "counter", "Pedidos de historial", history.requests);
+
+    state_shadow_stats_t shadow;
+    state_shadow.get_stats(&shadow);
+    metric(writer, "state_snapshots_total", "counter", "Estados completos publicados", shadow.snapshots);
+    metric(writer, "state_diffs_total", "counter", "Diffs de estado publicados", shadow.diffs);
+    metric(writer, "state_bytes_total", "counter", "Bytes publicados en state", shadow.bytes);
+}
+
+static void write_system_metrics(chunk_writer_t *writer)
+{
+    metric(writer, "device_uptime_seconds", "gauge", "Tiempo desde el arranque", esp_timer_get_time() / 1000000);
+    metric(writer, "device_last_error_code", "gauge", "Mapa de bits ERROR_CODE_*", last_error_code);
+    metric(writer, "heap_free_bytes", "gauge", "Heap libre", esp_get_free_heap_size());
+    metric(writer, "heap_min_free_bytes", "gauge", "Minimo heap libre desde el arranque", esp_get_minimum_free_heap_size());
+    metric(writer, "heap_largest_free_block_bytes", "gauge", "Mayor bloque libre",
+           heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+
+    resource_task_info_t tasks[RESOURCE_MONITOR_MAX_TASKS];
+    int count = resource_monitor.get_tasks(tasks, RESOURCE_MONITOR_MAX_TASKS);
+    family(writer, "task_stack_high_water_bytes", "gauge", "Minimo stack libre de la tarea");
+    for (int i = 0; i < count; i++)
+        writer_printf(writer, "task_stack_high_water_bytes{task=\"%s\"} %u\n", tasks[i].name, (unsigned)tasks[i].min_free);
+    family(writer, "task_stack_recommended_bytes", "gauge", "Stack sugerido segun el pico observado");
+    for (int i = 0; i < count; i++)
+        writer_printf(writer, "task_stack_recommended_bytes{task=\"%s\"} %u\n", tasks[i].name, (unsigned)tasks[i].recommended);
+
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK)
+        metric(writer, "wifi_rssi_dbm", "gauge", "RSSI del AP de la estacion", ap.rssi);
+}
+
+/* Acumulados del ciclo actual (desde el arranque o el despertar) */
+static void write_energy_metrics(chunk_writer_t *writer)
+{
+    energy_totals_t cycle;
+    energy_model_t model;
+    energy_meter.get_cycle(&cycle);
+    energy_meter.get_model(&model);
+    metric(writer, "energy_charge_uah", "gauge", "Carga estimada por el modelo", (long long)energy_meter_charge_uah(&cycle, &model));
+    metric(writer, "energy_samples_total", "counter", "Muestras publicadas", cycle.samples);
+    family(writer, "energy_tx_bytes_total", "counter", "Bytes transmitidos por capa");
+    writer_printf(writer, "energy_tx_bytes_total{layer=\"mqtt\"} %llu\n", (unsigned long long)cycle.mqtt_tx_bytes);
+    writer_printf(writer, "energy_tx_bytes_total{layer=\"tls\"} %llu\n", (unsigned long long)cycle.tls_tx_bytes);
+    metric(writer, "energy_tls_handshakes_total", "counter", "Handshakes TLS", cycle.tls_handshakes);
+    metric(writer, "energy_jwt_signs_total", "counter", "Firmas de JWT", cycle.jwt_signs);
+    metric(writer, "energy_radio_on_ms_total", "counter", "Radio escuchando", cycle.radio_on_us / 1000);
+    metric(writer, "energy_tx_airtime_us_total", "counter", "Tiempo de aire estimado",
+           energy_meter_tx_airtime_us(&cycle, &model));
+    metric(writer, "energy_cpu_active_ms_total", "counter", "CPU activa, suma de los nucleos", cycle.cpu_active_us / 1000);
+}
+
+static void write_health_metrics(chunk_writer_t *writer)
+{
+    health_status_t status;
+    health_task_info_t tasks[HEALTH_SUPERVISOR_MAX_TASKS];
+    health_supervisor.get_status(&status);
+    int count = health_supervisor.get_tasks(tasks, HEALTH_SUPERVISOR_MAX_TASKS);
+    metric(writer, "health_level", "gauge", "Accion de la escalada en curso (0: todas laten)", status.level);
+    family(writer, "health_actions_total", "counter", "Acciones de recuperacion");
+    for (int i = 0; i < HEALTH_ACTION_COUNT; i++)
+        writer_printf(writer, "health_actions_total{action=\"%s\"} %lu\n", health_action_name(i),
+                      (unsigned long)status.actions[i]);
+    family(writer, "health_heartbeat_age_ms", "gauge", "Tiempo desde el ultimo latido");
+    for (int i = 0; i < count; i++)
+        writer_printf(writer, "health_heartbeat_age_ms{task=\"%s\"} %lu\n", tasks[i].name, (unsigned long)tasks[i].age_ms);
+    family(writer, "health_missed_total", "counter", "Plazos vencidos");
+    for (int i = 0; i < count; i++)
+        writer_printf(writer, "health_missed_total{task=\"%s\"} %lu\n", tasks[i].name, (unsigned long)tasks[i].missed);
+    family(writer, "health_loop_latency_ms", "summary", "Tiempo entre latidos en el periodo de reporte");
+    for (int i = 0; i < count; i++)
+    {
+        writer_printf(writer, "health_loop_latency_ms{task=\"%s\",quantile=\"0.5\"} %lu\n", tasks[i].name,
+                      (unsigned long)tasks[i].p50_ms);
+        writer_printf(writer, "health_loop_latency_ms{task=\"%s\",quantile=\"0.9\"} %lu\n", tasks[i].name,
+                      (unsigned long)tasks[i].p90_ms);
+        writer_printf(writer, "health_loop_latency_ms{task=\"%s\",quantile=\"0.99\"} %lu\n", tasks[i].name,
+                      (unsigned long)tasks[i].p99_ms);
+    }
+}
+
+static esp_err_t metrics_handler(httpd_req_t *req)
+{
+    if (!begin_request(req, "text/plain; version=0.0.4"))
+        return ESP_OK;
+    chunk_writer_t writer = {.req = req};
+    write_system_metrics(&writer);
+    write_energy_metrics(&writer);
+    write_health_metrics(&writer);
+    if (status_client != NULL)
+        write_link_metrics(&writer);
+    write_queue_metrics(&writer);
+    return writer_finish(&writer);
+}
+
+/*****************************************************
+ *   GET /status                                      *
+ ******************************************************/
+static esp_err_t status_handler(httpd_req_t *req)
+{
+    if (!begin_request(req, HTTPD_TYPE_JSON))
+        return ESP_OK;
+    chunk_writer_t writer = {.req = req};
+
+    writer_printf(&writer, "{\"device\": \"%s\", \"uptime_s\": %lld, \"last_error_code\": %d, \"reset_reason\": %d",
+                  status_client != NULL ? status_client->device_id : "", (long long)(esp_timer_get_time() / 1000000),
+                  last_error_code, (int)esp_reset_reason());
+
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK)
+        writer_printf(&writer, ", \"wifi\": {\"connected\": true, \"rssi\": %d}", ap.rssi);
+    else
+        writer_printf(&writer, ", \"wifi\": {\"connected\": false}");
+
+    if (status_client != NULL)
+    {
+        clearblade_link_stats_t link;
+        clearblade_client_get_link_stats(status_client, &link);
+        int64_t offline_since_us = status_client->offline_since_us;
+        writer_printf(&writer,
+                      ", \"mqtt\": {\"connected\": %s, \"offline_s\": %lld, \"connects\": %u, \"disconnects\": %u, "
+                      "\"published\": %u, \"acked\": %u}",
+                      mqtt_connected() ? "true" : "false",
+                      offline_since_us > 0 ? (long long)((esp_timer_get_time() - offline_since_us) / 1000000) : 0LL,
+                      (unsigned)link.connects, (unsigned)link.disconnects, (unsigned)link.published, (unsigned)link.acked);
+    }
+
+    writer_printf(&writer, ", \"queues\": {");
+    for (int cls = 0; cls < TELEMETRY_CLASS_COUNT; cls++)
+    {
+        telemetry_dispatch_stats_t queue;
+        telemetry_dispatch.get_stats(cls, &queue);
+        writer_printf(&writer, "%s\"%s\": %u", cls > 0 ? ", " : "", class_names[cls], (unsigned)queue.depth);
+    }
+
+    sample_store_stats_t store;
+    sample_store.get_stats(&store);
+    writer_printf(&writer,
+                  "}, \"heap\": {\"free\": %u, \"min_free\": %u, \"largest_block\": %u}, "
+                  "\"samples\": {\"oldest_ms\": %lld, \"newest_ms\": %lld}}\n",
+                  (unsigned)esp_get_free_heap_size(), (unsigned)esp_get_minimum_free_heap_size(),
+                  (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT), (long long)store.oldest_ms,
+                  (long long)store.newest_ms);
+    return writer_finish(&writer);
+}
+
+/*****************************************************
+ *   Servidor                                         *
+ ******************************************************/
+
+/* esp_http_server reserva su tarea y sus sockets en httpd_start(): en */
+/* STATIC_ALLOCATION_MODE eso pasa una sola vez, al arrancar           */
+static esp_err_t start(clearblade_client_t *client, uint16_t port)
+{
+    if (server != NULL)
+        return ESP_ERR_INVALID_STATE;
+    status_client = client;
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = port;
+    config.stack_size = STATUS_SERVER_TASK_STACK_SIZE;
+    config.max_uri_handlers = 2;
+    config.max_open_sockets = 3;
+    config.lru_purge_enable = true;
+    config.task_priority = 2;
+
+    esp_err_t err = httpd_start(&server, &config);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "No se pudo iniciar el servidor: %s", esp_err_to_name(err));
+        server = NULL;
+        return err;
+    }
+
+    static const httpd_uri_t metrics_uri = {.uri = "/metrics", .method = HTTP_GET, .handler = metrics_handler};
+    static const httpd_uri_t status_uri = {.uri = "/status", .method = HTTP_GET, .handler = status_handler};
+    httpd_register_uri_handler(server, &metrics_uri);
+    httpd_register_uri_handler(server, &status_uri);
+    ESP_LOGI(TAG, "Sirviendo /metrics y /status en el puerto %u", port);
+    return ESP_OK;
+}
+
+static void stop(void)
+{
+    if (server == NULL)
+        return;
+    httpd_stop(server);
+    server = NULL;
+}
+
+static void get_stats(status_server_stats_t *out)
+{
+    *out = stats;
+}
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)            *
+ ******************************************************/
+const status_server_t status_server = {
+    // Status Server Functions
+    .start = start,
+    .stop = stop,
+    .get_stats = get_stats,
+};
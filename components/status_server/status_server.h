@@ -0,0 +1,55 @@
+/*
+ * status_server.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef STATUS_SERVER_H_
+#define STATUS_SERVER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "clearblade_connect.h"
+
+#define STATUS_SERVER_PORT 80
+/* Solo se atienden pedidos que llegan por la SoftAP (ESP_CONFIG_AP); */
+/* desde la red de la estacion se responde 403                        */
+#ifndef STATUS_SERVER_AP_ONLY
+#define STATUS_SERVER_AP_ONLY 1
+#endif
+/* Bloque de salida: las respuestas se arman de a STATUS_SERVER_CHUNK_SIZE */
+/* bytes en el stack del manejador y se envian con chunked encoding        */
+#define STATUS_SERVER_CHUNK_SIZE 256
+#define STATUS_SERVER_TASK_STACK_SIZE (4096 * 1)
+
+typedef struct
+{
+    uint32_t requests;
+    uint32_t rejected;     // Fuera de la SoftAP
+    uint32_t send_errors;  // El cliente corto la conexion
+} status_server_stats_t;
+
+/************************************************************************/
+/* La siguiente estructura simula un objeto en C                        */
+/*                                                                      */
+/* Servidor HTTP local en la SoftAP para tecnicos y colectores en el    */
+/* sitio, sin pasar por la nube:                                        */
+/*   GET /metrics  texto de Prometheus: colas, latencia de PUBACK,      */
+/*                 reconexiones, heap, stacks y RSSI                    */
+/*   GET /status   documento JSON con el estado del equipo              */
+/* Las respuestas no se arman enteras en memoria: cada linea se escribe */
+/* en un bloque de STATUS_SERVER_CHUNK_SIZE bytes que sale al llenarse. */
+/************************************************************************/
+typedef struct
+{
+    // Status Server Functions
+    esp_err_t (*start)(clearblade_client_t *client, uint16_t port);
+    void (*stop)(void);
+    void (*get_stats)(status_server_stats_t *stats);
+} status_server_t;
+
+extern const status_server_t status_server;
+
+#endif /* STATUS_SERVER_H_ */
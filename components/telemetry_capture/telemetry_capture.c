@@ -0,0 +1,402 @@
+/*
+ * telemetry_capture.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "telemetry_capture.h"
+
+#define TELEMETRY_CAPTURE_FILE_BUFFER_SIZE 1024
+#define TELEMETRY_CAPTURE_MAX_PROBES 16
+#define VARINT_MAX_LEN 10
+
+static const char *TAG = "Telemetry capture";
+
+typedef struct
+{
+    uint64_t hash;
+    uint16_t len;
+    int32_t index; // -1 = libre
+} topic_slot_t;
+
+static FILE *capture_file = NULL;
+static char file_buffer[TELEMETRY_CAPTURE_FILE_BUFFER_SIZE];
+static volatile bool active = false;
+static int64_t last_us = 0;
+static int32_t next_topic_index = 0;
+static topic_slot_t topic_slots[TELEMETRY_CAPTURE_TOPIC_SLOTS];
+static telemetry_capture_stats_t stats;
+
+static StaticSemaphore_t capture_mutex_buffer;
+static SemaphoreHandle_t capture_mutex = NULL;
+
+static void lock(void)
+{
+    if (capture_mutex == NULL)
+        capture_mutex = xSemaphoreCreateMutexStatic(&capture_mutex_buffer);
+    xSemaphoreTake(capture_mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(capture_mutex);
+}
+
+/*****************************************************
+ *   Codificacion                                     *
+ ******************************************************/
+static size_t varint_encode(uint8_t *buffer, uint64_t value)
+{
+    size_t len = 0;
+    do
+    {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        buffer[len++] = byte | (value != 0 ? 0x80 : 0);
+    } while (value != 0);
+    return len;
+}
+
+/* 1 leido, 0 faltan bytes, -1 mas de 64 bits */
+static int varint_decode(const uint8_t *data, size_t len, size_t *offset, uint64_t *value)
+{
+    uint64_t result = 0;
+    for (int i = 0; i < VARINT_MAX_LEN; i++)
+    {
+        if (*offset + i >= len)
+            return 0;
+        uint8_t byte = data[*offset + i];
+        result |= (uint64_t)(byte & 0x7F) << (7 * i);
+        if ((byte & 0x80) == 0)
+        {
+            *offset += i + 1;
+            *value = result;
+            return 1;
+        }
+    }
+    return -1;
+}
+
+static uint64_t topic_hash(const char *topic, size_t len)
+{
+    // FNV-1a de 64 bits; con el largo, una colision entre topics reales es despreciable
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++)
+        hash = (hash ^ (uint8_t)topic[i]) * 0x100000001b3ULL;
+    return hash;
+}
+
+/* Devuelve el indice del topic, o -1 si hay que definirlo (*slot libre) o escribirlo literal (*slot NULL) */
+static int32_t topic_lookup(const char *topic, size_t len, topic_slot_t **slot)
+{
+    uint64_t hash = topic_hash(topic, len);
+    *slot = NULL;
+    for (int probe = 0; probe < TELEMETRY_CAPTURE_MAX_PROBES && probe < TELEMETRY_CAPTURE_TOPIC_SLOTS; probe++)
+    {
+        topic_slot_t *candidate = &topic_slots[(hash + probe) % TELEMETRY_CAPTURE_TOPIC_SLOTS];
+        if (candidate->index < 0)
+        {
+            candidate->hash = hash;
+            candidate->len = (uint16_t)len;
+            *slot = candidate;
+            return -1;
+        }
+        if (candidate->hash == hash && candidate->len == len)
+            return candidate->index;
+    }
+    return -1;
+}
+
+static bool write_bytes(const void *data, size_t len)
+{
+    if (len > 0 && fwrite(data, 1, len, capture_file) != len)
+    {
+        stats.write_errors++;
+        return false;
+    }
+    stats.bytes += len;
+    return true;
+}
+
+static void begin_segment(void)
+{
+    uint8_t buffer[1 + VARINT_MAX_LEN];
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    buffer[0] = TELEMETRY_CAPTURE_FLAG_SEGMENT;
+    size_t len = 1 + varint_encode(&buffer[1], (uint64_t)now.tv_sec * 1000 + now.tv_usec / 1000);
+    write_bytes(buffer, len);
+
+    for (int i = 0; i < TELEMETRY_CAPTURE_TOPIC_SLOTS; i++)
+        topic_slots[i].index = -1;
+    next_topic_index = 0;
+    last_us = esp_timer_get_time();
+    stats.segments++;
+}
+
+/*****************************************************
+ *   Captura                                          *
+ ******************************************************/
+
+/* Abre el archivo para agregar un segmento; si no existe lo crea con el encabezado */
+static esp_err_t start(const char *path)
+{
+    uint8_t header[TELEMETRY_CAPTURE_HEADER_LEN] = {0};
+    esp_err_t err = ESP_OK;
+
+    lock();
+    if (capture_file != NULL)
+    {
+        active = false;
+        fclose(capture_file);
+        capture_file = NULL;
+    }
+
+    FILE *existing = fopen(path, "rb");
+    size_t existing_len = 0;
+    if (existing != NULL)
+    {
+        existing_len = fread(header, 1, sizeof(header), existing);
+        fclose(existing);
+    }
+    if (existing_len > 0 && (existing_len < sizeof(header) || memcmp(header, TELEMETRY_CAPTURE_MAGIC, 4) != 0 ||
+                             header[4] != TELEMETRY_CAPTURE_VERSION))
+    {
+        // No se pisa un archivo que no es una captura
+        ESP_LOGE(TAG, "%s no es una captura valida", path);
+        unlock();
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    capture_file = fopen(path, "ab");
+    if (capture_file == NULL)
+    {
+        ESP_LOGE(TAG, "No se pudo abrir %s", path);
+        unlock();
+        return ESP_FAIL;
+    }
+    setvbuf(capture_file, file_buffer, _IOFBF, sizeof(file_buffer));
+
+    if (existing_len == 0)
+    {
+        memset(header, 0, sizeof(header));
+        memcpy(header, TELEMETRY_CAPTURE_MAGIC, 4);
+        header[4] = TELEMETRY_CAPTURE_VERSION;
+        write_bytes(header, sizeof(header));
+    }
+    begin_segment();
+    if (stats.write_errors > 0)
+        err = ESP_FAIL;
+    active = true;
+    unlock();
+
+    ESP_LOGI(TAG, "Capturando publicaciones en %s", path);
+    return err;
+}
+
+static void stop(void)
+{
+    lock();
+    active = false;
+    if (capture_file != NULL)
+    {
+        fclose(capture_file);
+        capture_file = NULL;
+    }
+    unlock();
+}
+
+static bool is_active(void)
+{
+    return active;
+}
+
+/* Mismo criterio que esp_mqtt_client_publish(): len <= 0 toma strlen(data) */
+static void record(const char *topic, const char *data, int len, int qos)
+{
+    uint8_t head[1 + 3 * VARINT_MAX_LEN];
+    size_t head_len = 1;
+
+    if (!active)
+        return;
+    size_t topic_len = strlen(topic);
+    size_t payload_len = len > 0 ? (size_t)len : (data != NULL ? strlen(data) : 0);
+    int64_t now = esp_timer_get_time();
+
+    lock();
+    if (!active)
+    {
+        unlock();
+        return;
+    }
+    topic_slot_t *slot;
+    int32_t index = topic_lookup(topic, topic_len, &slot);
+
+    head[0] = qos & TELEMETRY_CAPTURE_FLAG_QOS_MASK;
+    head_len += varint_encode(&head[head_len], now > last_us ? now - last_us : 0);
+    if (index >= 0)
+    {
+        head[0] |= TELEMETRY_CAPTURE_FLAG_TOPIC_REF;
+        head_len += varint_encode(&head[head_len], index);
+    }
+    else
+    {
+        if (slot != NULL)
+        {
+            head[0] |= TELEMETRY_CAPTURE_FLAG_TOPIC_DEFINE;
+            slot->index = next_topic_index++;
+        }
+        head_len += varint_encode(&head[head_len], topic_len);
+    }
+    last_us = now > last_us ? now : last_us;
+
+    bool ok = write_bytes(head, head_len);
+    if (ok && index < 0)
+        ok = write_bytes(topic, topic_len);
+    if (ok)
+    {
+        uint8_t payload_head[VARINT_MAX_LEN];
+        ok = write_bytes(payload_head, varint_encode(payload_head, payload_len)) && write_bytes(data, payload_len);
+    }
+    if (ok)
+        stats.records++;
+    else
+    {
+        // Un registro a medias deja el resto del archivo ilegible: se deja de capturar
+        ESP_LOGE(TAG, "Error de escritura, captura detenida");
+        active = false;
+    }
+    unlock();
+}
+
+static void flush(void)
+{
+    lock();
+    if (capture_file != NULL)
+        fflush(capture_file);
+    unlock();
+}
+
+static void get_stats(telemetry_capture_stats_t *out)
+{
+    lock();
+    *out = stats;
+    unlock();
+}
+
+/*****************************************************
+ *   Lectura                                          *
+ ******************************************************/
+esp_err_t telemetry_capture_cursor_init(telemetry_capture_cursor_t *cursor, const uint8_t *data, size_t len)
+{
+    memset(cursor, 0, sizeof(*cursor));
+    if (len < TELEMETRY_CAPTURE_HEADER_LEN || memcmp(data, TELEMETRY_CAPTURE_MAGIC, 4) != 0)
+        return ESP_ERR_INVALID_ARG;
+    if (data[4] != TELEMETRY_CAPTURE_VERSION)
+        return ESP_ERR_NOT_SUPPORTED;
+    cursor->offset = TELEMETRY_CAPTURE_HEADER_LEN;
+    return ESP_OK;
+}
+
+int telemetry_capture_next(telemetry_capture_cursor_t *cursor, const uint8_t *data, size_t len,
+                           telemetry_capture_record_t *out)
+{
+    size_t offset = cursor->offset;
+    uint64_t value;
+    int rc;
+
+    if (offset >= len)
+        return 0;
+    uint8_t flags = data[offset++];
+
+    if (flags == TELEMETRY_CAPTURE_FLAG_SEGMENT)
+    {
+        if ((rc = varint_decode(data, len, &offset, &value)) <= 0)
+            return rc;
+        // Los segmentos se ubican por hora de inicio; si el reloj no estaba en hora, siguen al anterior
+        if (cursor->segments == 0)
+            cursor->first_segment_unix_ms = (int64_t)value;
+        int64_t base_us = ((int64_t)value - cursor->first_segment_unix_ms) * 1000;
+        cursor->segment_base_us = base_us > cursor->last_us ? base_us : cursor->last_us;
+        cursor->last_us = cursor->segment_base_us;
+        cursor->next_topic_index = 0;
+        cursor->segments++;
+        cursor->offset = offset;
+        return 2;
+    }
+    if (cursor->segments == 0 || (flags & ~(TELEMETRY_CAPTURE_FLAG_QOS_MASK | TELEMETRY_CAPTURE_FLAG_TOPIC_DEFINE |
+                                            TELEMETRY_CAPTURE_FLAG_TOPIC_REF)) != 0 ||
+        (flags & TELEMETRY_CAPTURE_FLAG_TOPIC_DEFINE && flags & TELEMETRY_CAPTURE_FLAG_TOPIC_REF))
+        return -1;
+
+    memset(out, 0, sizeof(*out));
+    out->qos = flags & TELEMETRY_CAPTURE_FLAG_QOS_MASK;
+    out->topic_index = -1;
+
+    uint64_t delta_us;
+    if ((rc = varint_decode(data, len, &offset, &delta_us)) <= 0)
+        return rc;
+    if ((rc = varint_decode(data, len, &offset, &value)) <= 0)
+        return rc;
+    if (flags & TELEMETRY_CAPTURE_FLAG_TOPIC_REF)
+    {
+        if (value >= (uint64_t)cursor->next_topic_index)
+            return -1;
+        out->topic_index = (int32_t)value;
+    }
+    else
+    {
+        if (value > UINT16_MAX)
+            return -1;
+        if (len - offset < value)
+            return 0;
+        out->topic = (const char *)&data[offset];
+        out->topic_len = (uint16_t)value;
+        offset += value;
+        if (flags & TELEMETRY_CAPTURE_FLAG_TOPIC_DEFINE)
+        {
+            out->topic_index = cursor->next_topic_index;
+            out->topic_defined = true;
+        }
+    }
+    if ((rc = varint_decode(data, len, &offset, &value)) <= 0)
+        return rc;
+    if (value > UINT32_MAX)
+        return -1;
+    if (len - offset < value)
+        return 0;
+    out->payload = &data[offset];
+    out->payload_len = (uint32_t)value;
+    offset += value;
+
+    // El cursor avanza solo con el registro completo
+    if (out->topic_defined)
+        cursor->next_topic_index++;
+    cursor->last_us += (int64_t)delta_us;
+    out->timestamp_us = cursor->last_us;
+    cursor->offset = offset;
+    return 1;
+}
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)            *
+ ******************************************************/
+const telemetry_capture_t telemetry_capture = {
+    // Telemetry Capture Functions
+    .start = start,
+    .stop = stop,
+    .is_active = is_active,
+    .record = record,
+    .flush = flush,
+    .get_stats = get_stats,
+};
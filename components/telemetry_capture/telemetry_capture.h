@@ -0,0 +1,105 @@
+/*
+ * telemetry_capture.h
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#ifndef TELEMETRY_CAPTURE_H_
+#define TELEMETRY_CAPTURE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/************************************************************************/
+/* Formato del archivo de captura (solo se agregan bytes al final):     */
+/*                                                                      */
+/*   encabezado: "TCAP", version (u8), reservado (3 bytes)              */
+/*   segmento:   flags = SEGMENT, hora de inicio (ms unix, varint)      */
+/*   registro:   flags (QoS y forma del topic), delta_us (varint),      */
+/*               topic, largo del payload (varint), payload             */
+/*                                                                      */
+/* Cada start() abre un segmento nuevo; los tiempos de un registro son  */
+/* microsegundos monotonicos desde el registro anterior del segmento.   */
+/* La primera vez que aparece un topic se escribe completo y recibe el  */
+/* siguiente indice del segmento; despues se referencia por indice.     */
+/* Un registro incompleto al final del archivo (corte de energia) se    */
+/* ignora al leer.                                                      */
+/************************************************************************/
+#define TELEMETRY_CAPTURE_MAGIC "TCAP"
+#define TELEMETRY_CAPTURE_VERSION 1
+#define TELEMETRY_CAPTURE_HEADER_LEN 8
+
+#define TELEMETRY_CAPTURE_FLAG_QOS_MASK 0x03
+#define TELEMETRY_CAPTURE_FLAG_TOPIC_DEFINE 0x04 // Topic literal, recibe el proximo indice
+#define TELEMETRY_CAPTURE_FLAG_TOPIC_REF 0x08    // Topic por indice
+#define TELEMETRY_CAPTURE_FLAG_SEGMENT 0x80
+
+/* Topics distintos que se recuerdan por segmento; el resto se escribe literal */
+#ifndef TELEMETRY_CAPTURE_TOPIC_SLOTS
+#define TELEMETRY_CAPTURE_TOPIC_SLOTS 32
+#endif
+
+typedef struct
+{
+    uint32_t records;
+    uint32_t segments;
+    uint64_t bytes;
+    uint32_t write_errors;
+} telemetry_capture_stats_t;
+
+/* Registro decodificado; topic y payload apuntan dentro del buffer leido */
+typedef struct
+{
+    int64_t timestamp_us; // Desde el inicio del primer segmento del archivo
+    const char *topic;
+    uint16_t topic_len;
+    int32_t topic_index;  // -1 si el topic no tiene indice
+    bool topic_defined;   // Este registro define topic_index
+    const uint8_t *payload;
+    uint32_t payload_len;
+    uint8_t qos;
+} telemetry_capture_record_t;
+
+/* Estado de lectura, inicializar con telemetry_capture_cursor_init() */
+typedef struct
+{
+    size_t offset;
+    uint32_t segments;
+    int64_t first_segment_unix_ms;
+    int64_t segment_base_us;
+    int64_t last_us;
+    int32_t next_topic_index;
+} telemetry_capture_cursor_t;
+
+/* Lectura (sin estado global, la usan las herramientas de host) */
+esp_err_t telemetry_capture_cursor_init(telemetry_capture_cursor_t *cursor, const uint8_t *data, size_t len);
+/* 1 registro, 2 segmento nuevo (los indices de topic se reinician), 0 fin o registro incompleto, -1 dato invalido */
+int telemetry_capture_next(telemetry_capture_cursor_t *cursor, const uint8_t *data, size_t len,
+                           telemetry_capture_record_t *record);
+
+/************************************************************************/
+/* La siguiente estructura simula un objeto en C                        */
+/*                                                                      */
+/* Graba cada publicacion en un archivo de captura. La llama           */
+/* clearblade_client_publish() despues de publicar, con el topic, el    */
+/* QoS y el payload que salieron (los lotes comprimidos tal cual).      */
+/* Mientras no se llame a start(), record() no hace nada. Es para el    */
+/* host: main.c no la inicia porque el firmware no monta ningun VFS.    */
+/************************************************************************/
+typedef struct
+{
+    // Telemetry Capture Functions
+    esp_err_t (*start)(const char *path);
+    void (*stop)(void);
+    bool (*is_active)(void);
+    void (*record)(const char *topic, const char *data, int len, int qos);
+    void (*flush)(void);
+    void (*get_stats)(telemetry_capture_stats_t *stats);
+} telemetry_capture_t;
+
+extern const telemetry_capture_t telemetry_capture;
+
+#endif /* TELEMETRY_CAPTURE_H_ */
@@ -9,7 +9,9 @@
 
 #include <string.h>
 #include "wifi_manager.h"
-#include "wfm_miscs.h"
+#include "config_store.h"
+#include "resource_monitor.h"
+#include "energy_meter.h"
 #include "esp_event.h"
 #include "esp_wifi.h"
 #include "esp_log.h"
@@ -49,30 +51,36 @@
 
 void wifi_init(void);
 
+#define WIFI_WAIT_FOR_IP_TASK_STACK_SIZE 2048
+#define WIFI_WAIT_FOR_IP_LOG_MS (30 * 1000) // The wait is bounded: it logs while the station keeps trying
+
 /* FreeRTOS event group to signal when we are connected*/
 static EventGroupHandle_t wifi_event_group;
 
-/* The event group allows multiple bits for each event, but we only care about two events:
- * - we are connected to the AP with an IP
- * - we failed to connect after the maximum amount of retries */
-#define WIFI_STA_CONNECTED_BIT BIT0
-#define WIFI_STA_FAIL_BIT BIT1
+#ifdef STATIC_ALLOCATION_MODE
+static StaticEventGroup_t wifi_event_group_buffer;
+static StackType_t wifi_wait_for_ip_task_stack[WIFI_WAIT_FOR_IP_TASK_STACK_SIZE];
+static StaticTask_t wifi_wait_for_ip_task_buffer;
+#endif
 
 static const char *TAG = "wifi module";
 
 static int s_retry_num = 0;
-char *sta_ssid = NULL;
-char *sta_pass = NULL;
+// Apuntan a la configuracion en RAM del config_store.
+const char *sta_ssid = NULL;
+const char *sta_pass = NULL;
 char *sta_ip = NULL;
+static char sta_ip_buffer[16];
 char *ap_ip = DEFAULT_AP_IP;
 void (*event_got_ip_callback)(void);
+void (*event_disconnected_callback)(void);
 
 esp_netif_t *wifiAP;
 esp_netif_t *wifiSTA;
 
 inline static void wifi_init_sta(void);
 inline static void wifi_init_softap(void);
-inline static void wifi_wait_for_ip(void);
+inline static void wifi_wait_for_ip(void *pvParameters);
 void set_ap_ip(char *ip);
 
 static void event_handler(void *arg, esp_event_base_t event_base,
@@ -84,6 +92,8 @@ static void event_handler(void *arg, esp_event_base_t event_base,
     }
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
     {
+        if (event_disconnected_callback != NULL)
+            event_disconnected_callback();
         if (s_retry_num < WIFI_STA_MAXIMUM_CONNECT_RETRY)
         {
             esp_wifi_connect();
@@ -101,16 +111,23 @@ static void event_handler(void *arg, esp_event_base_t event_base,
     {
         ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
         ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
-        sta_ip = malloc(20);
-        sprintf(sta_ip, IPSTR, IP2STR(&event->ip_info.ip));
+        snprintf(sta_ip_buffer, sizeof(sta_ip_buffer), IPSTR, IP2STR(&event->ip_info.ip));
+        sta_ip = sta_ip_buffer;
         event_got_ip_callback();
         s_retry_num = 0;
         xEventGroupSetBits(wifi_event_group, WIFI_STA_CONNECTED_BIT);
         xEventGroupClearBits(wifi_event_group, WIFI_STA_FAIL_BIT);
     }
+    else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_LOST_IP)
+    {
+        // Asociado pero sin IP: para el resto del firmware tampoco hay red
+        ESP_LOGI(TAG, "lost ip");
+        if (event_disconnected_callback != NULL)
+            event_disconnected_callback();
+    }
     else
     {
-        ESP_LOGI(TAG, "Evento sin tratar %d %d", (int)event_base, (int)event_id);
+        ESP_LOGI(TAG, "Evento sin tratar %s %d", event_base, (int)event_id);
     }
 }
 
@@ -164,18 +181,27 @@ inline static void wifi_init_sta(void)
 
     ESP_LOGI(TAG, "wifi_init_sta finished.");
 
-    xTaskCreate(wifi_wait_for_ip, "wifi_wait_for_ip_task", 2048, NULL, 10, NULL);
+#ifdef STATIC_ALLOCATION_MODE
+    xTaskCreateStatic(wifi_wait_for_ip, "wifi_wait_for_ip_task", WIFI_WAIT_FOR_IP_TASK_STACK_SIZE, NULL, 10,
+                      wifi_wait_for_ip_task_stack, &wifi_wait_for_ip_task_buffer);
+#else
+    xTaskCreate(wifi_wait_for_ip, "wifi_wait_for_ip_task", WIFI_WAIT_FOR_IP_TASK_STACK_SIZE, NULL, 10, NULL);
+#endif
 }
 
-inline static void wifi_wait_for_ip(void)
+inline static void wifi_wait_for_ip(void *pvParameters)
 {
+    resource_monitor.register_task(NULL, "wifi_wait_for_ip_task", WIFI_WAIT_FOR_IP_TASK_STACK_SIZE);
     /* Waiting until either the connection is established (WIFI_STA_CONNECTED_BIT) or connection failed for the maximum
      * number of re-tries (WIFI_STA_FAIL_BIT). The bits are set by event_handler() (see above) */
-    EventBits_t bits = xEventGroupWaitBits(wifi_event_group,
-                                           WIFI_STA_CONNECTED_BIT | WIFI_STA_FAIL_BIT,
-                                           pdFALSE,
-                                           pdFALSE,
-                                           portMAX_DELAY);
+    EventBits_t bits;
+    while (!((bits = xEventGroupWaitBits(wifi_event_group,
+                                         WIFI_STA_CONNECTED_BIT | WIFI_STA_FAIL_BIT,
+                                         pdFALSE,
+                                         pdFALSE,
+                                         pdMS_TO_TICKS(WIFI_WAIT_FOR_IP_LOG_MS))) &
+             (WIFI_STA_CONNECTED_BIT | WIFI_STA_FAIL_BIT)))
+        ESP_LOGW(TAG, "Still waiting for an IP from SSID:%s", sta_ssid);
 
     /* xEventGroupWaitBits() returns the bits before the call returned, hence we can test which event actually
      * happened. */
@@ -194,6 +220,7 @@ inline static void wifi_wait_for_ip(void)
         ESP_LOGE(TAG, "UNEXPECTED EVENT");
     }
 
+    resource_monitor.task_exit();
     vTaskDelete(NULL);
 }
 
@@ -214,7 +241,7 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
     }
     else
     {
-        ESP_LOGI(TAG, "Evento WIFI sin tratar %d %d", (int)event_base, (int)event_id);
+        ESP_LOGI(TAG, "Evento WIFI sin tratar %s %d", event_base, (int)event_id);
     }
 }
 
@@ -262,17 +289,22 @@ inline static void wifi_init_softap(void)
 
 void wifi_init(void)
 {
+#ifdef STATIC_ALLOCATION_MODE
+    wifi_event_group = xEventGroupCreateStatic(&wifi_event_group_buffer);
+#else
     wifi_event_group = xEventGroupCreate();
+#endif
     event_got_ip_callback = NULL;
+    event_disconnected_callback = NULL;
 
     ESP_ERROR_CHECK(esp_netif_init());
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
-    get_config_param_str("sta_ssid", &sta_ssid);
-    get_config_param_str("sta_pass", &sta_pass);
-    if (sta_ssid == NULL || sta_pass == NULL)
+    sta_ssid = config_store.get()->sta_ssid;
+    sta_pass = config_store.get()->sta_pass;
+    if (strlen(sta_ssid) == 0 || strlen(sta_pass) == 0)
     {
         ESP_LOGI(TAG, "WiFi credentials not set.");
         ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
@@ -290,6 +322,31 @@ void wifi_init(void)
     ESP_LOGI(TAG, "ESP_WIFI STARTING...");
     ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_NONE));
     ESP_ERROR_CHECK(esp_wifi_start());
+    // Sin power save y con el AP levantado la radio escucha todo el tiempo
+    energy_meter.set_radio(ENERGY_RADIO_ON);
+}
+
+/************************************************************************/
+/* Reinicio pedido por el supervisor de vida: detiene el driver y lo    */
+/* vuelve a arrancar; la estacion empieza con los reintentos en cero    */
+/* (tambien si ya se habian agotado). Hasta la nueva IP no hay red, asi */
+/* que avisa como en una desconexion.                                   */
+/************************************************************************/
+esp_err_t wifi_restart(void)
+{
+    ESP_LOGW(TAG, "Reiniciando Wi-Fi");
+    esp_err_t err = esp_wifi_stop();
+    if (err != ESP_OK)
+        return err;
+    energy_meter.set_radio(ENERGY_RADIO_OFF);
+    if (event_disconnected_callback != NULL)
+        event_disconnected_callback();
+    s_retry_num = 0;
+    xEventGroupClearBits(wifi_event_group, WIFI_STA_CONNECTED_BIT | WIFI_STA_FAIL_BIT);
+    err = esp_wifi_start();
+    if (err == ESP_OK)
+        energy_meter.set_radio(ENERGY_RADIO_ON);
+    return err;
 }
 
 void set_sta_credentials(char *ssid, char *pass)
@@ -302,18 +359,18 @@ void set_sta_credentials(char *ssid, char *pass)
     if (strlen(pass) == 0)
         return;
 
-    set_config_param_str("sta_ssid", ssid);
-    set_config_param_str("sta_pass", pass);
-
-    get_config_param_str("sta_ssid", &sta_ssid);
-    get_config_param_str("sta_pass", &sta_pass);
+    // Solo se escribe la flash si las credenciales cambiaron.
+    config_store.set_str(CONFIG_KEY_STA_SSID, ssid);
+    config_store.set_str(CONFIG_KEY_STA_PASS, pass);
+    if (config_store.commit() != ESP_OK)
+        ESP_LOGE(TAG, "Error grabando credenciales.");
 
     // esp_restart();
 }
 
 char *get_sta_ssid(void)
 {
-    return sta_ssid;
+    return (char *)sta_ssid;
 }
 
 char *get_sta_ip(void)
@@ -328,6 +385,13 @@ void set_got_ip_callback(void *callback)
     event_got_ip_callback = callback;
 }
 
+void set_disconnected_callback(void *callback)
+{
+
+    ESP_LOGI(TAG, "Setting disconnected event callback.");
+    event_disconnected_callback = callback;
+}
+
 void set_ap_ip(char *ip)
 {
 
@@ -354,5 +418,7 @@ const wifi_manager_t wifi_manager = {
     .get_sta_ssid = get_sta_ssid,
     .get_sta_ip = get_sta_ip,
     .set_got_ip_callback = set_got_ip_callback,
+    .set_disconnected_callback = set_disconnected_callback,
     .set_ap_ip = set_ap_ip,
+    .restart = wifi_restart,
 };
\ No newline at end of file
@@ -10,9 +10,16 @@
 #ifndef LZ_WIFI_MANAGER_
 #define LZ_WIFI_MANAGER_
 
+#include "esp_err.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 
+/* The event group allows multiple bits for each event, but we only care about two events:
+ * - we are connected to the AP with an IP
+ * - we failed to connect after the maximum amount of retries (until restart()) */
+#define WIFI_STA_CONNECTED_BIT BIT0
+#define WIFI_STA_FAIL_BIT BIT1
+
 /************************************************************************/
 /* La siguiente estructura simula un objeto en C                        */
 /*                                                                      */
@@ -29,7 +36,9 @@ typedef struct
     char *(*get_sta_ssid)(void);
     char *(*get_sta_ip)(void);
     void (*set_got_ip_callback)(void *callback);
+    void (*set_disconnected_callback)(void *callback); // Desasociacion, IP perdida o restart()
     void (*set_ap_ip)(char *ip);
+    esp_err_t (*restart)(void);
 } wifi_manager_t;
 
 /************************************************************************/
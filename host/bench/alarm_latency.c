@@ -0,0 +1,259 @@
+/*
+ * alarm_latency.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Latencia de alarmas con la cola de telemetria de rutina saturada.
+ *  Un hilo encola muestras de rutina (telemetry_dispatch, clase BULK)
+ *  mas rapido de lo que el limite de tasa deja publicar, asi la cola
+ *  siempre esta llena; mientras tanto se envia una alarma por intervalo
+ *  y se mide desde send() hasta su PUBACK del broker. El tiempo en cola
+ *  de la rutina muestra lo que esperaria la alarma en una cola unica.
+ *
+ *  Uso: alarm_latency [--broker host:puerto] [--duration S]
+ *                     [--bulk-rate N] [--batch N] [--bulk-interval-ms MS]
+ *                     [--alarm-interval-ms MS] [--out archivo.json]
+ *
+ *  Necesita un broker local (clearblade_broker o cualquier MQTT 3.1.1).
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "clearblade_connect.h"
+#include "esp_event.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "latency_histogram.h"
+#include "telemetry_dispatch.h"
+
+#define ALARM_DEVICE_ID "device-alarm"
+#define ALARM_ACK_TIMEOUT_US 5000000
+
+static struct
+{
+    const char *broker;
+    const char *out_path;
+    uint32_t duration_s;
+    uint32_t bulk_rate;
+    uint32_t batch;
+    uint32_t bulk_interval_ms;
+    uint32_t alarm_interval_ms;
+} options = {
+    .broker = "127.0.0.1:1883",
+    .out_path = "alarm_latency.json",
+    .duration_s = 30,
+    .bulk_rate = 200,
+    .batch = 8,
+    .bulk_interval_ms = 100,
+    .alarm_interval_ms = 250,
+};
+
+static clearblade_client_t client;
+static volatile bool producing = true;
+
+// Solo las alarmas van con QoS 1: cada PUBACK es el de la alarma en vuelo
+static pthread_mutex_t ack_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ack_cond = PTHREAD_COND_INITIALIZER;
+static int64_t ack_us = 0;
+
+static void on_mqtt_event(esp_mqtt_client_handle_t handle, esp_mqtt_event_id_t event_id, int msg_id)
+{
+    (void)handle;
+    (void)msg_id;
+    if (event_id != MQTT_EVENT_PUBLISHED)
+        return;
+    pthread_mutex_lock(&ack_mutex);
+    ack_us = esp_timer_get_time();
+    pthread_cond_signal(&ack_cond);
+    pthread_mutex_unlock(&ack_mutex);
+}
+
+static void *bulk_producer(void *arg)
+{
+    (void)arg;
+    char payload[256];
+    int64_t period_us = 1000000 / (options.bulk_rate > 0 ? options.bulk_rate : 1);
+    int64_t next_us = esp_timer_get_time();
+    for (uint32_t seq = 0; producing; seq++)
+    {
+        int len = snprintf(payload, sizeof(payload),
+                           "{ \"dev_id\": arm, \"temperatura\": 24.%u, \"presion\": 1013.2, \"humedad\": 55.0, \"seq\": %u }",
+                           seq % 10, seq);
+        telemetry_dispatch.send(TELEMETRY_CLASS_BULK, payload, len);
+        next_us += period_us;
+        int64_t wait_us = next_us - esp_timer_get_time();
+        if (wait_us > 0)
+            usleep(wait_us);
+    }
+    return NULL;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Uso: %s [--broker host:puerto] [--duration S] [--bulk-rate N] [--batch N]\n"
+            "          [--bulk-interval-ms MS] [--alarm-interval-ms MS] [--out archivo.json]\n",
+            argv0);
+}
+
+static int parse_options(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (value == NULL)
+            return -1;
+        i++;
+        if (strcmp(arg, "--broker") == 0)
+            options.broker = value;
+        else if (strcmp(arg, "--duration") == 0)
+            options.duration_s = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--bulk-rate") == 0)
+            options.bulk_rate = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--batch") == 0)
+            options.batch = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--bulk-interval-ms") == 0)
+            options.bulk_interval_ms = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--alarm-interval-ms") == 0)
+            options.alarm_interval_ms = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--out") == 0)
+            options.out_path = value;
+        else
+            return -1;
+    }
+    return options.batch > 0 && options.batch <= 255 ? 0 : -1;
+}
+
+static void write_results(const latency_histogram_t *latency, uint32_t alarms, uint32_t lost)
+{
+    telemetry_dispatch_stats_t bulk, alarm;
+    telemetry_dispatch.get_stats(TELEMETRY_CLASS_BULK, &bulk);
+    telemetry_dispatch.get_stats(TELEMETRY_CLASS_ALARM, &alarm);
+    double bulk_wait_ms = bulk.batches > 0 ? bulk.wait_us_total / 1000.0 / bulk.batches : 0;
+    double alarm_wait_ms = alarm.batches > 0 ? alarm.wait_us_total / 1000.0 / alarm.batches : 0;
+    publish_limiter_stats_t throttle;
+    clearblade_client_get_publish_stats(&client, &throttle);
+
+    fprintf(stderr,
+            "Alarmas %u (sin PUBACK %u): p50/p99/max %llu/%llu/%llu us hasta el PUBACK, espera en cola media/max "
+            "%.2f/%.2f ms\nRutina: %u encoladas, %u descartadas, %u publicadas en %u lotes, espera media/max %.1f/%.1f ms\n",
+            alarms, lost, (unsigned long long)latency_histogram_percentile(latency, 50),
+            (unsigned long long)latency_histogram_percentile(latency, 99), (unsigned long long)latency->max_us, alarm_wait_ms,
+            alarm.wait_us_max / 1000.0, bulk.queued,
+            bulk.dropped, bulk.published, bulk.batches, bulk_wait_ms, bulk.wait_us_max / 1000.0);
+    fprintf(stderr, "Limite de publicacion: %u sin espera, %u demoradas (max %.1f ms), %u rechazadas\n", throttle.passed,
+            throttle.throttled, throttle.throttle_us_max / 1000.0, throttle.rejected);
+
+    FILE *out = fopen(options.out_path, "w");
+    if (out == NULL)
+    {
+        perror(options.out_path);
+        return;
+    }
+    fprintf(out, "{\n  \"duration_s\": %u,\n  \"bulk_rate\": %u,\n  \"batch\": %u,\n  \"bulk_interval_ms\": %u,\n",
+            options.duration_s, options.bulk_rate, options.batch, options.bulk_interval_ms);
+    fprintf(out,
+            "  \"alarm\": {\"sent\": %u, \"lost\": %u, \"dropped\": %u, \"p50_us\": %llu, \"p99_us\": %llu, \"max_us\": %llu, "
+            "\"wait_avg_ms\": %.2f, \"wait_max_ms\": %.2f},\n",
+            alarms, lost, alarm.dropped, (unsigned long long)latency_histogram_percentile(latency, 50),
+            (unsigned long long)latency_histogram_percentile(latency, 99), (unsigned long long)latency->max_us, alarm_wait_ms,
+            alarm.wait_us_max / 1000.0);
+    fprintf(out,
+            "  \"bulk\": {\"queued\": %u, \"dropped\": %u, \"published\": %u, \"batches\": %u, \"max_depth\": %u, "
+            "\"wait_avg_ms\": %.1f, \"wait_max_ms\": %.1f},\n",
+            bulk.queued, bulk.dropped, bulk.published, bulk.batches, bulk.max_depth, bulk_wait_ms, bulk.wait_us_max / 1000.0);
+    fprintf(out, "  \"publish_limit\": {\"passed\": %u, \"throttled\": %u, \"rejected\": %u, \"throttle_ms_max\": %.1f}\n}\n",
+            throttle.passed, throttle.throttled, throttle.rejected, throttle.throttle_us_max / 1000.0);
+    fclose(out);
+    fprintf(stderr, "Resultados: %s\n", options.out_path);
+}
+
+int main(int argc, char **argv)
+{
+    if (parse_options(argc, argv) != 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // jwt_token_gcp imprime el token por stdout
+    int dev_null = open("/dev/null", O_WRONLY);
+    dup2(dev_null, STDOUT_FILENO);
+    close(dev_null);
+
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    host_mqtt_set_event_observer(on_mqtt_event);
+
+    char broker_uri[CLEARBLADE_BROKER_URI_MAX_LEN];
+    snprintf(broker_uri, sizeof(broker_uri), "mqtt://%s", options.broker);
+    clearblade_client_init(&client);
+    clearblade_client_set_data(&client, broker_uri, "daiot-practica", "us-central1", "registry_1", ALARM_DEVICE_ID);
+    clearblade_client_set_network_available(&client, true);
+    clearblade_client_start(&client);
+    if ((xEventGroupWaitBits(client.event_group, CONNECTED_TO_MQTT_BROKER, pdFALSE, pdTRUE, 10000 / portTICK_PERIOD_MS) &
+         CONNECTED_TO_MQTT_BROKER) == 0)
+    {
+        fprintf(stderr, "Sin conexion con %s\n", options.broker);
+        return 1;
+    }
+
+    telemetry_class_config_t bulk_config = {
+        .subtopic = TELEMETRY_DISPATCH_BULK_SUBTOPIC,
+        .qos = 0,
+        .batch_max = options.batch,
+        .batch_max_age_ms = 1000,
+        .min_interval_ms = options.bulk_interval_ms,
+        .compress_min_len = TELEMETRY_DISPATCH_COMPRESS_MIN_LEN,
+    };
+    telemetry_dispatch.set_class_config(TELEMETRY_CLASS_BULK, &bulk_config);
+    if (telemetry_dispatch.start(&client) != ESP_OK)
+        return 1;
+
+    pthread_t producer;
+    pthread_create(&producer, NULL, bulk_producer, NULL);
+    usleep(500000); // La cola de rutina se llena antes de la primera alarma
+
+    latency_histogram_t latency;
+    latency_histogram_init(&latency);
+    uint32_t alarms = 0, lost = 0;
+    char payload[128];
+    int64_t deadline_us = esp_timer_get_time() + options.duration_s * 1000000LL;
+    while (esp_timer_get_time() < deadline_us)
+    {
+        int len = snprintf(payload, sizeof(payload), "{ \"dev_id\": arm, \"alarma\": \"temperatura_alta\", \"seq\": %u }", alarms);
+        pthread_mutex_lock(&ack_mutex);
+        ack_us = 0;
+        int64_t sent_us = esp_timer_get_time();
+        telemetry_dispatch.send(TELEMETRY_CLASS_ALARM, payload, len);
+        alarms++;
+        while (ack_us == 0 && esp_timer_get_time() - sent_us < ALARM_ACK_TIMEOUT_US)
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += 100000000;
+            if (deadline.tv_nsec >= 1000000000)
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&ack_cond, &ack_mutex, &deadline);
+        }
+        if (ack_us != 0)
+            latency_histogram_record(&latency, ack_us - sent_us);
+        else
+            lost++;
+        pthread_mutex_unlock(&ack_mutex);
+        usleep(options.alarm_interval_ms * 1000);
+    }
+
+    producing = false;
+    pthread_join(producer, NULL);
+    write_results(&latency, alarms, lost);
+    return lost == 0 ? 0 : 1;
+}
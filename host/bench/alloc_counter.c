@@ -0,0 +1,58 @@
+/*
+ * alloc_counter.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <stddef.h>
+
+#include "alloc_counter.h"
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static alloc_counter_t counter;
+
+static inline void count_alloc(size_t size)
+{
+    __atomic_fetch_add(&counter.allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&counter.bytes, size, __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t size)
+{
+    count_alloc(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    count_alloc(nmemb * size);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    count_alloc(size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    if (ptr != NULL)
+        __atomic_fetch_add(&counter.frees, 1, __ATOMIC_RELAXED);
+    __libc_free(ptr);
+}
+
+alloc_counter_t alloc_counter_snapshot(void)
+{
+    alloc_counter_t snapshot = {
+        .allocs = __atomic_load_n(&counter.allocs, __ATOMIC_RELAXED),
+        .frees = __atomic_load_n(&counter.frees, __ATOMIC_RELAXED),
+        .bytes = __atomic_load_n(&counter.bytes, __ATOMIC_RELAXED),
+    };
+    return snapshot;
+}
@@ -0,0 +1,24 @@
+/*
+ * alloc_counter.h
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Cuenta las llamadas a malloc/calloc/realloc de todo el proceso (incluido
+ *  el backend criptografico) interponiendo las funciones de glibc.
+ */
+
+#ifndef ALLOC_COUNTER_H_
+#define ALLOC_COUNTER_H_
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t bytes;
+} alloc_counter_t;
+
+alloc_counter_t alloc_counter_snapshot(void);
+
+#endif /* ALLOC_COUNTER_H_ */
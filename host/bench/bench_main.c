@@ -0,0 +1,475 @@
+/*
+ * bench_main.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Benchmarks de host de los caminos criticos del firmware. Cada caso se
+ *  repite hasta superar el tiempo minimo y se reporta ns/op, reservas de
+ *  memoria por operacion y bytes reservados por operacion.
+ *
+ *  Uso: host_bench [--out archivo.json] [--filter texto] [--min-time-ms N]
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "mqtt_client.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+#include "alloc_counter.h"
+#include "base64url.h"
+#include "boot_timeline.h"
+#include "certs.h"
+#include "clearblade_connect.h"
+#include "config_store.h"
+#include "deferred_log.h"
+#include "jwt_token_gcp.h"
+#include "msg_sequence.h"
+#include "sample_history.h"
+#include "sample_store.h"
+#include "temp_sensor.h"
+#include "sensor_trace.h"
+#include "tph_model.h"
+
+#define BENCH_DEFAULT_OUT "bench_results.json"
+#define BENCH_DEFAULT_MIN_TIME_MS 300
+#define BENCH_MAX_RESULTS 32
+
+typedef struct
+{
+    const char *name;
+    void (*setup)(void);
+    void (*run)(void);
+} bench_case_t;
+
+typedef struct
+{
+    const char *name;
+    uint64_t iterations;
+    double ns_per_op;
+    double allocs_per_op;
+    double bytes_per_op;
+} bench_result_t;
+
+static clearblade_client_t bench_client;
+static clearblade_client_t sensor_client;
+
+/* Los casos de publicacion miden el camino completo, sin el limite de tasa */
+static const publish_limit_config_t bench_no_limits = {0};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*****************************************************
+ *   Casos                                            *
+ ******************************************************/
+static unsigned char base64_input[256];
+static char base64_output[BASE64_ENCODE_OUT_SIZE(sizeof(base64_input)) + 1];
+
+static void setup_base64(void)
+{
+    esp_fill_random(base64_input, sizeof(base64_input));
+}
+
+static void run_base64(void)
+{
+    base64url_encode(base64_input, sizeof(base64_input), base64_output);
+}
+
+static char jwt_buffer[JWT_TOKEN_MAX_LEN];
+
+static void run_jwt(void)
+{
+    if (createGCPJWTBuffer(jwt_buffer, sizeof(jwt_buffer), "bench-project", (const unsigned char *)DEVICE_KEY,
+                           strlen(DEVICE_KEY), 60) == 0)
+    {
+        fprintf(stderr, "createGCPJWTBuffer fallo\n");
+        exit(1);
+    }
+}
+
+static void setup_sensor(void)
+{
+    if (sensor_client.client_handle == NULL)
+    {
+        esp_mqtt_client_config_t config = {0};
+        clearblade_client_init(&sensor_client);
+        clearblade_client_set_data(&sensor_client, NULL, "bench-project", "us-central1", "bench-registry", "device-101");
+        clearblade_client_set_publish_limits(&sensor_client, &bench_no_limits);
+        sensor_client.client_handle = esp_mqtt_client_init(&config);
+        esp_mqtt_client_start(sensor_client.client_handle);
+    }
+    msg_sequence.initialize();
+    tempSensor.initialize();
+    tempSensor.set_mqtt_info("events", "device-101", &sensor_client);
+}
+
+static void run_sensor_sample(void)
+{
+    tempSensor.sample_temp();
+}
+
+static void run_sensor_sample_publish(void)
+{
+    tempSensor.sample_temp();
+    tempSensor.publish_to_mqtt();
+}
+
+/* Un bloque de 16 pasos para 1024 canales: 16384 muestras TPH por operacion */
+#define BENCH_TPH_CHANNELS 1024
+#define BENCH_TPH_STEPS 16
+
+static tph_model_t bench_tph_model;
+static float bench_tph_storage[TPH_MODEL_STORAGE_BYTES(BENCH_TPH_CHANNELS) / sizeof(float)];
+static float bench_tph_temp[BENCH_TPH_STEPS * BENCH_TPH_CHANNELS];
+static float bench_tph_press[BENCH_TPH_STEPS * BENCH_TPH_CHANNELS];
+static float bench_tph_hum[BENCH_TPH_STEPS * BENCH_TPH_CHANNELS];
+
+static void setup_tph_model(void)
+{
+    tph_model_params_t params;
+    tph_model_default_params(&params);
+    tph_model_init(&bench_tph_model, &params, bench_tph_storage, sizeof(bench_tph_storage), BENCH_TPH_CHANNELS, 1, 0,
+                   1790000000.0, 1.0f);
+}
+
+static void run_tph_model_block(void)
+{
+    tph_model_generate(&bench_tph_model, BENCH_TPH_STEPS, bench_tph_temp, bench_tph_press, bench_tph_hum);
+}
+
+/* Traza CSV en memoria (una muestra por minuto); cada lectura avanza 10 s e
+ * interpola, como el sensor reproduciendo una traza */
+#define BENCH_TRACE_POINTS 4096
+#define BENCH_TRACE_STEP_MS 10000
+
+static char bench_trace_csv[BENCH_TRACE_POINTS * 40];
+static size_t bench_trace_csv_len;
+static sensor_trace_t bench_trace;
+static int64_t bench_trace_time_ms;
+
+static void setup_sensor_trace(void)
+{
+    bench_trace_csv_len = snprintf(bench_trace_csv, sizeof(bench_trace_csv), "time_s,temp_c,press_hpa,hum_pct\n");
+    for (int i = 0; i < BENCH_TRACE_POINTS; i++)
+        bench_trace_csv_len += snprintf(bench_trace_csv + bench_trace_csv_len, sizeof(bench_trace_csv) - bench_trace_csv_len,
+                                        "%d,%.2f,%.2f,%.1f\n", 1790000000 + i * 60, 20 + (i % 50) * 0.1,
+                                        1013 - (i % 30) * 0.1, 60 - (i % 40) * 0.2);
+    sensor_trace_open(&bench_trace, (const uint8_t *)bench_trace_csv, bench_trace_csv_len);
+    bench_trace_time_ms = bench_trace.first_ms;
+}
+
+static void run_sensor_trace_sample(void)
+{
+    sensor_trace_point_t point;
+    bench_trace_time_ms += BENCH_TRACE_STEP_MS;
+    if (bench_trace_time_ms > bench_trace.last_ms)
+        bench_trace_time_ms = bench_trace.first_ms;
+    sensor_trace_sample(&bench_trace, bench_trace_time_ms, &point);
+}
+
+static void run_boot_timeline_stamp(void)
+{
+    boot_timeline.stamp(BOOT_PHASE_GOT_IP);
+}
+
+static void setup_config_store(void)
+{
+    nvs_flash_init();
+    config_store.load();
+}
+
+static void run_config_store_commit(void)
+{
+    static int toggle = 0;
+    config_store.set_str(CONFIG_KEY_STA_SSID, (toggle ^= 1) ? "bench-ssid-a" : "bench-ssid-b");
+    config_store.commit();
+}
+
+static void run_config_store_commit_unchanged(void)
+{
+    config_store.commit();
+}
+
+/* Conecta un cliente completo: tarea MQTT, JWT y handshake simulado */
+static void setup_clearblade_client(void)
+{
+    if (bench_client.event_group != NULL)
+        return;
+    clearblade_client_init(&bench_client);
+    clearblade_client_set_data(&bench_client, NULL, "bench-project", "us-central1", "bench-registry", "device-101");
+    clearblade_client_set_publish_limits(&bench_client, &bench_no_limits);
+    clearblade_client_start(&bench_client);
+    clearblade_client_set_network_available(&bench_client, true);
+    xEventGroupWaitBits(bench_client.event_group, CONNECTED_TO_MQTT_BROKER, pdFALSE, pdTRUE, pdMS_TO_TICKS(10000));
+}
+
+static void run_clearblade_publish(void)
+{
+    static const char payload[] = "{ \"dev_id\": 101, \"temperatura\": 24.3, \"rssi\": -60 }";
+    clearblade_client_publish(&bench_client, NULL, payload, sizeof(payload) - 1, 1);
+}
+
+/* Reserva con cuota holgada: el costo del limitador en cada publicacion */
+static publish_limiter_t bench_limiter;
+static int64_t bench_limiter_now_us;
+
+static void setup_publish_limiter(void)
+{
+    publish_limit_config_t limits = {.msgs_per_s = 1000000, .msg_burst = 100, .bytes_per_s = 100000000, .byte_burst = 65536};
+    publish_limiter_init(&bench_limiter, &limits);
+    bench_limiter_now_us = esp_timer_get_time();
+}
+
+static void run_publish_limiter_reserve(void)
+{
+    bench_limiter_now_us += 10;
+    publish_limiter_reserve(&bench_limiter, 120, bench_limiter_now_us, 0);
+}
+
+/* Incluye la escritura en NVS de cada MSG_SEQUENCE_CHECKPOINT_BLOCK numeros */
+static void setup_msg_sequence(void)
+{
+    nvs_flash_init();
+    msg_sequence.initialize();
+}
+
+static void run_msg_sequence_next(void)
+{
+    msg_sequence.next(NULL);
+}
+
+/* Imagen temporal de la particion; incluye el borrado de un sector cada 254 muestras */
+static int64_t bench_sample_ms = 1760000000000LL;
+
+static void setup_sample_store(void)
+{
+    char path[] = "/tmp/host_bench_samples_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0)
+        close(fd);
+    sample_store.open(path);
+    unlink(path);
+}
+
+static void run_sample_store_append(void)
+{
+    sample_record_t record;
+    bench_sample_ms += 240000;
+    sample_store_make_record(&record, bench_sample_ms, 21.5f, 48.0f, 1013.2f);
+    sample_store.append(&record);
+}
+
+static int bench_history_sink(const uint8_t *chunk, size_t len, void *ctx)
+{
+    return 0;
+}
+
+/* Las ultimas 1000 muestras grabadas por sample_store_append, codificadas en bloques */
+static void run_sample_history_stream(void)
+{
+    sample_history_request_t request = {.from_ms = bench_sample_ms - 999 * 240000LL, .to_ms = bench_sample_ms};
+    sample_history_stream(&request, bench_history_sink, NULL);
+}
+
+/* Log diferido con un sink binario que se queda con el ultimo marco. El */
+/* caso de escritura vacia el anillo cada 16 mensajes (la tarea tambien */
+/* lo hace): mide la copia de los argumentos mas la entrega del marco.   */
+static const char *bench_log_tag = "BENCH";
+static uint8_t bench_log_frame[DEFERRED_LOG_FRAME_MAX];
+static size_t bench_log_frame_len = 0;
+static char bench_log_line[DEFERRED_LOG_LINE_MAX];
+static int bench_log_count = 0;
+
+static void bench_log_sink(const uint8_t *frame, size_t len, void *ctx)
+{
+    memcpy(bench_log_frame, frame, len);
+    bench_log_frame_len = len;
+}
+
+static void setup_deferred_log(void)
+{
+    static bool started = false;
+    if (started)
+        return;
+    deferred_log.set_sink(bench_log_sink, NULL);
+    deferred_log.start();
+    started = true;
+}
+
+static void run_deferred_log_write(void)
+{
+    DLOGI(bench_log_tag, "Muestra %d: temp %.2f hum %.2f estado %s", bench_log_count, 21.5, 48.0, "ok");
+    if (++bench_log_count % 16 == 0)
+        deferred_log.flush();
+}
+
+/* El costo que se saca del camino critico: armar el texto del ultimo marco */
+static void run_deferred_log_format(void)
+{
+    if (bench_log_frame_len > DEFERRED_LOG_FRAME_HEADER)
+        deferred_log_format("Muestra %d: temp %.2f hum %.2f estado %s", bench_log_frame + DEFERRED_LOG_FRAME_HEADER,
+                            bench_log_frame_len - DEFERRED_LOG_FRAME_HEADER, bench_log_line, sizeof(bench_log_line));
+}
+
+static const bench_case_t bench_cases[] = {
+    {"base64url_encode_256B", setup_base64, run_base64},
+    {"jwt_create_rs256", NULL, run_jwt},
+    {"temp_sensor_sample", setup_sensor, run_sensor_sample},
+    {"temp_sensor_sample_publish", setup_sensor, run_sensor_sample_publish},
+    {"tph_model_block_16x1024", setup_tph_model, run_tph_model_block},
+    {"sensor_trace_csv_sample", setup_sensor_trace, run_sensor_trace_sample},
+    {"boot_timeline_stamp", NULL, run_boot_timeline_stamp},
+    {"config_store_commit_changed", setup_config_store, run_config_store_commit},
+    {"config_store_commit_unchanged", setup_config_store, run_config_store_commit_unchanged},
+    {"msg_sequence_next", setup_msg_sequence, run_msg_sequence_next},
+    {"clearblade_client_publish_qos1", setup_clearblade_client, run_clearblade_publish},
+    {"publish_limiter_reserve", setup_publish_limiter, run_publish_limiter_reserve},
+    {"sample_store_append", setup_sample_store, run_sample_store_append},
+    {"sample_history_stream_1000", NULL, run_sample_history_stream},
+    // Al final: despues de start() los DLOGx de los otros casos pasan por el anillo
+    {"deferred_log_write", setup_deferred_log, run_deferred_log_write},
+    {"deferred_log_format", setup_deferred_log, run_deferred_log_format},
+};
+
+/*****************************************************
+ *   Runner                                           *
+ ******************************************************/
+
+/* Duplica las iteraciones hasta que la corrida supera min_time_ns */
+static bench_result_t run_case(const bench_case_t *bench, uint64_t min_time_ns)
+{
+    bench_result_t result = {.name = bench->name};
+    uint64_t iterations = 1;
+
+    if (bench->setup != NULL)
+        bench->setup();
+    bench->run(); // Calentamiento: inicializaciones perezosas fuera de la medicion
+
+    for (;;)
+    {
+        alloc_counter_t before = alloc_counter_snapshot();
+        uint64_t start = now_ns();
+        for (uint64_t i = 0; i < iterations; i++)
+            bench->run();
+        uint64_t elapsed = now_ns() - start;
+        alloc_counter_t after = alloc_counter_snapshot();
+
+        if (elapsed >= min_time_ns || iterations >= (1ULL << 30))
+        {
+            result.iterations = iterations;
+            result.ns_per_op = (double)elapsed / iterations;
+            result.allocs_per_op = (double)(after.allocs - before.allocs) / iterations;
+            result.bytes_per_op = (double)(after.bytes - before.bytes) / iterations;
+            return result;
+        }
+        iterations *= 2;
+    }
+}
+
+static int write_results(const char *path, const bench_result_t *results, int count)
+{
+    FILE *out = fopen(path, "w");
+    if (out == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    fprintf(out, "{\n  \"schema\": 1,\n  \"timestamp\": %lld,\n", (long long)time(NULL));
+    fprintf(out, "  \"crypto_backend\": \"%s\",\n", HOST_CRYPTO_BACKEND);
+#ifdef STATIC_ALLOCATION_MODE
+    fprintf(out, "  \"static_allocation\": true,\n");
+#else
+    fprintf(out, "  \"static_allocation\": false,\n");
+#endif
+    fprintf(out, "  \"results\": [\n");
+    for (int i = 0; i < count; i++)
+    {
+        fprintf(out, "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.1f, \"allocs_per_op\": %.3f, \"bytes_per_op\": %.1f}%s\n",
+                results[i].name, (unsigned long long)results[i].iterations, results[i].ns_per_op,
+                results[i].allocs_per_op, results[i].bytes_per_op, i + 1 < count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    return fclose(out);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Uso: %s [--out archivo.json] [--filter texto] [--min-time-ms N] [--list]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_path = BENCH_DEFAULT_OUT;
+    const char *filter = NULL;
+    uint64_t min_time_ms = BENCH_DEFAULT_MIN_TIME_MS;
+    int case_count = sizeof(bench_cases) / sizeof(bench_cases[0]);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+            out_path = argv[++i];
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            filter = argv[++i];
+        else if (strcmp(argv[i], "--min-time-ms") == 0 && i + 1 < argc)
+            min_time_ms = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--list") == 0)
+        {
+            for (int c = 0; c < case_count; c++)
+                printf("%s\n", bench_cases[c].name);
+            return 0;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    host_mock_seed_random(1);
+    boot_timeline.initialize();
+
+    // Los componentes imprimen por stdout (printf); se descarta durante las mediciones.
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int dev_null = open("/dev/null", O_WRONLY);
+    dup2(dev_null, STDOUT_FILENO);
+    close(dev_null);
+
+    bench_result_t results[BENCH_MAX_RESULTS];
+    int result_count = 0;
+    for (int c = 0; c < case_count && result_count < BENCH_MAX_RESULTS; c++)
+    {
+        if (filter != NULL && strstr(bench_cases[c].name, filter) == NULL)
+            continue;
+        results[result_count] = run_case(&bench_cases[c], min_time_ms * 1000000ULL);
+        fprintf(stderr, "%-32s %12llu it %14.1f ns/op %10.3f allocs/op %12.1f B/op\n",
+                results[result_count].name, (unsigned long long)results[result_count].iterations,
+                results[result_count].ns_per_op, results[result_count].allocs_per_op,
+                results[result_count].bytes_per_op);
+        result_count++;
+    }
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+
+    if (write_results(out_path, results, result_count) != 0)
+        return 1;
+    fprintf(stderr, "Resultados: %s\n", out_path);
+    return 0;
+}
@@ -0,0 +1,287 @@
+/*
+ * jwt_storm.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Tormenta de reconexion: tiempo para volver a autenticar N identidades.
+ *  Primero firma en serie con createGCPJWTBuffer() (lo que hace cada cliente
+ *  sin el pool), despues con jwt_signer para cada cantidad de workers, con
+ *  la cache de claves fria (identidades nuevas) y caliente (repetidas).
+ *  Cada identidad tiene un tiempo de desconexion aleatorio; se reporta la
+ *  latencia de todas y la del decil que lleva mas tiempo desconectado.
+ *
+ *  Uso: jwt_storm [--identities N] [--workers 1,4,0] [--out archivo.json]
+ *       (0 = un worker por CPU)
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+
+#include "certs.h"
+#include "jwt_signer.h"
+#include "jwt_token_gcp.h"
+#include "latency_histogram.h"
+
+#define STORM_DEFAULT_IDENTITIES 10000
+#define STORM_DEFAULT_WORKERS "1,4,0"
+#define STORM_DEFAULT_OUT "jwt_storm.json"
+#define STORM_MAX_RUNS 32
+#define STORM_PROJECT "storm-project"
+#define STORM_EXPIRATION_MINUTES 60
+
+typedef struct
+{
+    jwt_request_t request;
+    char identity[JWT_SIGNER_IDENTITY_MAX_LEN + 1];
+    char token[JWT_TOKEN_MAX_LEN];
+    uint64_t submitted_us;
+    bool oldest_decile;
+} storm_identity_t;
+
+typedef struct
+{
+    char name[32];
+    int workers;
+    double wall_ms;
+    double tokens_per_s;
+    uint64_t p50_us;
+    uint64_t p99_us;
+    uint64_t oldest_p99_us;
+    uint32_t failed;
+    uint32_t cache_hits;
+    uint32_t cache_misses;
+} storm_result_t;
+
+static storm_identity_t *identities;
+static int identity_count = STORM_DEFAULT_IDENTITIES;
+static latency_histogram_t latency_all;
+static latency_histogram_t latency_oldest;
+static pthread_mutex_t latency_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void request_done(jwt_request_t *request, void *ctx)
+{
+    storm_identity_t *identity = (storm_identity_t *)ctx;
+    uint64_t latency = now_us() - identity->submitted_us;
+
+    pthread_mutex_lock(&latency_mutex);
+    latency_histogram_record(&latency_all, latency);
+    if (identity->oldest_decile)
+        latency_histogram_record(&latency_oldest, latency);
+    pthread_mutex_unlock(&latency_mutex);
+}
+
+/* Identidades "<prefijo>-<n>"; cambiar el prefijo deja la cache fria */
+static void prepare_identities(const char *prefix)
+{
+    for (int i = 0; i < identity_count; i++)
+    {
+        storm_identity_t *identity = &identities[i];
+        snprintf(identity->identity, sizeof(identity->identity), "%s-%06d", prefix, i);
+        // Desconexiones repartidas en los ultimos 10 s; el decil mas antiguo es el de offline < 1 s
+        int64_t offline_since_us = (int64_t)(esp_random() % 10000000);
+        identity->oldest_decile = offline_since_us < 1000000;
+
+        jwt_request_t *request = &identity->request;
+        memset(request, 0, sizeof(*request));
+        request->identity = identity->identity;
+        request->project_id = STORM_PROJECT;
+        request->private_key = (const unsigned char *)DEVICE_KEY;
+        request->private_key_len = strlen(DEVICE_KEY);
+        request->expiration_minutes = STORM_EXPIRATION_MINUTES;
+        request->offline_since_us = offline_since_us;
+        request->token = identity->token;
+        request->token_len = sizeof(identity->token);
+        request->done = request_done;
+        request->done_ctx = identity;
+    }
+    latency_histogram_init(&latency_all);
+    latency_histogram_init(&latency_oldest);
+}
+
+static void finish_result(storm_result_t *result, uint64_t start_us)
+{
+    result->wall_ms = (now_us() - start_us) / 1000.0;
+    result->tokens_per_s = identity_count / (result->wall_ms / 1000.0);
+    result->p50_us = latency_histogram_percentile(&latency_all, 50);
+    result->p99_us = latency_histogram_percentile(&latency_all, 99);
+    result->oldest_p99_us = latency_histogram_percentile(&latency_oldest, 99);
+    fprintf(stderr, "%-16s %3d workers %10.1f ms %9.1f tok/s  p50 %8llu us  p99 %8llu us  oldest p99 %8llu us  fail %u  cache %u/%u\n",
+            result->name, result->workers, result->wall_ms, result->tokens_per_s,
+            (unsigned long long)result->p50_us, (unsigned long long)result->p99_us,
+            (unsigned long long)result->oldest_p99_us, result->failed, result->cache_hits, result->cache_misses);
+}
+
+/* Linea de base: cada identidad parsea su clave y firma en serie */
+static void run_serial(storm_result_t *result)
+{
+    memset(result, 0, sizeof(*result));
+    strlcpy(result->name, "serial", sizeof(result->name));
+    result->workers = 0;
+    prepare_identities("serial");
+
+    uint64_t start_us = now_us();
+    for (int i = 0; i < identity_count; i++)
+    {
+        storm_identity_t *identity = &identities[i];
+        identity->submitted_us = start_us;
+        if (createGCPJWTBuffer(identity->token, sizeof(identity->token), STORM_PROJECT, (const unsigned char *)DEVICE_KEY,
+                               strlen(DEVICE_KEY), STORM_EXPIRATION_MINUTES) == 0)
+            result->failed++;
+        request_done(&identity->request, identity);
+    }
+    finish_result(result, start_us);
+}
+
+static void run_pool(storm_result_t *result, const char *name, int workers, const char *prefix)
+{
+    jwt_signer_stats_t before, after;
+
+    memset(result, 0, sizeof(*result));
+    strlcpy(result->name, name, sizeof(result->name));
+    prepare_identities(prefix);
+    jwt_signer.get_stats(&before);
+
+    // Todas las identidades piden token a la vez, como tras un reinicio del broker
+    uint64_t start_us = now_us();
+    for (int i = 0; i < identity_count; i++)
+    {
+        identities[i].submitted_us = start_us;
+        if (jwt_signer.submit(&identities[i].request) != ESP_OK)
+            result->failed++;
+    }
+    jwt_signer.wait_idle(portMAX_DELAY);
+
+    jwt_signer.get_stats(&after);
+    result->failed += after.failed - before.failed;
+    result->cache_hits = after.key_cache_hits - before.key_cache_hits;
+    result->cache_misses = after.key_cache_misses - before.key_cache_misses;
+    result->workers = workers;
+    finish_result(result, start_us);
+}
+
+static int write_results(const char *path, const storm_result_t *results, int count)
+{
+    FILE *out = fopen(path, "w");
+    if (out == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    fprintf(out, "{\n  \"schema\": 1,\n  \"timestamp\": %lld,\n", (long long)time(NULL));
+    fprintf(out, "  \"crypto_backend\": \"%s\",\n", HOST_CRYPTO_BACKEND);
+    fprintf(out, "  \"cpus\": %d,\n  \"identities\": %d,\n", portNUM_PROCESSORS, identity_count);
+    fprintf(out, "  \"results\": [\n");
+    for (int i = 0; i < count; i++)
+    {
+        const storm_result_t *r = &results[i];
+        fprintf(out, "    {\"name\": \"%s\", \"workers\": %d, \"wall_ms\": %.1f, \"tokens_per_s\": %.1f, "
+                     "\"p50_us\": %llu, \"p99_us\": %llu, \"oldest_decile_p99_us\": %llu, \"failed\": %u, "
+                     "\"key_cache_hits\": %u, \"key_cache_misses\": %u}%s\n",
+                r->name, r->workers, r->wall_ms, r->tokens_per_s, (unsigned long long)r->p50_us,
+                (unsigned long long)r->p99_us, (unsigned long long)r->oldest_p99_us, r->failed,
+                r->cache_hits, r->cache_misses, i + 1 < count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    return fclose(out);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Uso: %s [--identities N] [--workers 1,4,0] [--out archivo.json]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_path = STORM_DEFAULT_OUT;
+    char workers_list[64];
+
+    strlcpy(workers_list, STORM_DEFAULT_WORKERS, sizeof(workers_list));
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--identities") == 0 && i + 1 < argc)
+            identity_count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+            strlcpy(workers_list, argv[++i], sizeof(workers_list));
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+            out_path = argv[++i];
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (identity_count <= 0 || identity_count > JWT_SIGNER_MAX_PENDING)
+    {
+        fprintf(stderr, "--identities debe estar entre 1 y %d\n", JWT_SIGNER_MAX_PENDING);
+        return 2;
+    }
+
+    identities = calloc(identity_count, sizeof(*identities));
+    if (identities == NULL)
+        return 1;
+    host_mock_seed_random(1);
+
+    // createGCPJWTBuffer() imprime por stdout (printf); se descarta durante las mediciones.
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int dev_null = open("/dev/null", O_WRONLY);
+    dup2(dev_null, STDOUT_FILENO);
+    close(dev_null);
+
+    storm_result_t results[STORM_MAX_RUNS];
+    int result_count = 0;
+    run_serial(&results[result_count++]);
+
+    int run = 0;
+    for (char *item = strtok(workers_list, ","); item != NULL && result_count + 2 <= STORM_MAX_RUNS; item = strtok(NULL, ","))
+    {
+        int workers = atoi(item);
+        char prefix[16];
+        char name[32];
+
+        if (jwt_signer.start(workers) != ESP_OK)
+        {
+            fprintf(stderr, "No se pudo iniciar el pool con %d workers\n", workers);
+            return 1;
+        }
+        if (workers <= 0)
+            workers = portNUM_PROCESSORS;
+        if (workers > JWT_SIGNER_MAX_WORKERS)
+            workers = JWT_SIGNER_MAX_WORKERS;
+
+        snprintf(prefix, sizeof(prefix), "run%d", run++);
+        snprintf(name, sizeof(name), "pool_cold_w%d", workers);
+        run_pool(&results[result_count++], name, workers, prefix);
+        snprintf(name, sizeof(name), "pool_warm_w%d", workers);
+        run_pool(&results[result_count++], name, workers, prefix);
+
+        jwt_signer.stop();
+    }
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+
+    free(identities);
+    if (write_results(out_path, results, result_count) != 0)
+        return 1;
+    fprintf(stderr, "Resultados: %s\n", out_path);
+    return 0;
+}
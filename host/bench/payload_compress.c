@@ -0,0 +1,310 @@
+/*
+ * payload_compress.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Compresion de lotes de telemetria con payload_codec. Arma lotes como
+ *  los de telemetry_dispatch ([m1, m2, ...], hasta
+ *  TELEMETRY_DISPATCH_BATCH_MAX_LEN) con muestras de temp_sensor: una por
+ *  minuto, con temperatura, presion, humedad y RSSI que derivan de a poco,
+ *  como una cola de rutina que se vacia tras una desconexion. Para cada
+ *  tamano de lote reporta el tamano antes y despues, el tiempo de
+ *  compresion y de descompresion, y la RAM: el estado del compresor, el
+ *  buffer de salida y el stack medido en una tarea.
+ *
+ *  Uso: payload_compress [--batches N] [--sizes 1,2,4,8] [--seed N]
+ *                        [--out archivo.json]
+ *
+ *  Sale con 1 si algun lote no se recupera igual al descomprimirlo.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "payload_codec.h"
+#include "telemetry_dispatch.h"
+#include "temp_sensor.h"
+
+#define BENCH_MAX_SIZES 16
+#define BENCH_TASK_STACK_SIZE (4096 * 1)
+#define BENCH_START_MS 1760000000000LL
+
+static struct
+{
+    uint32_t batches;
+    int sizes[BENCH_MAX_SIZES];
+    int size_count;
+    uint64_t seed;
+    const char *out_path;
+} options = {
+    .batches = 2000,
+    .sizes = {1, 2, 4, 6, 8},
+    .size_count = 5,
+    .seed = 1,
+    .out_path = "payload_compress.json",
+};
+
+typedef struct
+{
+    int batch_size;
+    uint32_t batches;
+    uint32_t above_threshold;   // Desde TELEMETRY_DISPATCH_COMPRESS_MIN_LEN
+    uint32_t compressed;        // Ademas achicaron: salen comprimidos
+    uint64_t raw_bytes;
+    uint64_t codec_bytes;       // Todos los lotes comprimidos
+    uint64_t sent_bytes;        // Lo que publicaria el despacho
+    uint64_t compress_ns;
+    uint64_t decompress_ns;
+    uint32_t mismatches;
+} size_result_t;
+
+static size_result_t results[BENCH_MAX_SIZES];
+static uint32_t stack_used = 0;
+static SemaphoreHandle_t done;
+
+static uint64_t rng_state;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* xorshift64*: la misma serie con la misma --seed */
+static double rng_uniform(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (double)((rng_state * 2685821657736338717ULL) >> 11) / (double)(1ULL << 53);
+}
+
+/* Serie de muestras de un dispositivo: deriva lenta como la del modelo TPH */
+static struct
+{
+    uint64_t seq;
+    int64_t ts_ms;
+    double temp;
+    double pressure;
+    double humidity;
+    int rssi;
+} sensor;
+
+static int next_sample(char *buffer, size_t len)
+{
+    char temp_text[16];
+    sensor.seq++;
+    sensor.ts_ms += 60000;
+    sensor.temp += (rng_uniform() - 0.5) * 0.1;
+    sensor.pressure += (rng_uniform() - 0.5) * 0.2;
+    sensor.humidity += (rng_uniform() - 0.5) * 0.4;
+    sensor.rssi += (int)(rng_uniform() * 5) - 2;
+    if (sensor.rssi > -45 || sensor.rssi < -90)
+        sensor.rssi = -65;
+    snprintf(temp_text, sizeof(temp_text), "%.2f", sensor.temp);
+    return temp_sensor_format_payload(buffer, len, "device-101", sensor.seq, temp_text, sensor.pressure, sensor.humidity,
+                                      sensor.rssi, sensor.ts_ms, (uint32_t)(rng_uniform() * 40), NULL);
+}
+
+/* Mismo armado que publish_batch() de telemetry_dispatch.c */
+static int build_batch(char *batch, int batch_size)
+{
+    char sample[TELEMETRY_DISPATCH_MSG_MAX_LEN];
+    int len = 0;
+    batch[len++] = '[';
+    for (int i = 0; i < batch_size; i++)
+    {
+        int sample_len = next_sample(sample, sizeof(sample));
+        if (len + sample_len + 2 > TELEMETRY_DISPATCH_BATCH_MAX_LEN)
+            break;
+        if (i > 0)
+            batch[len++] = ',';
+        memcpy(batch + len, sample, sample_len);
+        len += sample_len;
+    }
+    batch[len++] = ']';
+    return len;
+}
+
+/* Lotes armados de antemano: el stack que se mide en la tarea es solo el del codec */
+static char *batches;
+static int *batch_lens;
+static uint8_t compressed[TELEMETRY_DISPATCH_BATCH_MAX_LEN];
+static uint8_t restored[TELEMETRY_DISPATCH_BATCH_MAX_LEN];
+static payload_codec_state_t codec_state;
+
+static void build_batches(int batch_size)
+{
+    rng_state = options.seed * 0x9E3779B97F4A7C15ULL + 1;
+    sensor.seq = 0;
+    sensor.ts_ms = BENCH_START_MS;
+    sensor.temp = 22.5;
+    sensor.pressure = 1013.2;
+    sensor.humidity = 45.0;
+    sensor.rssi = -65;
+    for (uint32_t b = 0; b < options.batches; b++)
+        batch_lens[b] = build_batch(batches + (size_t)b * TELEMETRY_DISPATCH_BATCH_MAX_LEN, batch_size);
+}
+
+static void run_size(size_result_t *result)
+{
+    for (uint32_t b = 0; b < options.batches; b++)
+    {
+        const char *batch = batches + (size_t)b * TELEMETRY_DISPATCH_BATCH_MAX_LEN;
+        int len = batch_lens[b];
+        uint64_t start = now_ns();
+        size_t compressed_len =
+            payload_codec_compress(&codec_state, (const uint8_t *)batch, len, compressed, sizeof(compressed));
+        uint64_t middle = now_ns();
+        int restored_len = compressed_len > 0 ? payload_codec_decompress(compressed, compressed_len, restored, sizeof(restored))
+                                              : -1;
+        uint64_t end = now_ns();
+
+        result->batches++;
+        result->raw_bytes += len;
+        result->compress_ns += middle - start;
+        result->decompress_ns += end - middle;
+        if (restored_len != len || memcmp(restored, batch, len) != 0)
+        {
+            result->mismatches++;
+            continue;
+        }
+        result->codec_bytes += compressed_len;
+        bool above = len >= TELEMETRY_DISPATCH_COMPRESS_MIN_LEN;
+        bool smaller = compressed_len < (size_t)len;
+        result->above_threshold += above;
+        result->compressed += above && smaller;
+        result->sent_bytes += above && smaller ? compressed_len : (size_t)len;
+    }
+}
+
+static void bench_task(void *param)
+{
+    run_size((size_result_t *)param);
+    uint32_t used = BENCH_TASK_STACK_SIZE - uxTaskGetStackHighWaterMark(NULL);
+    if (used > stack_used)
+        stack_used = used;
+    xSemaphoreGive(done);
+    vTaskDelete(NULL);
+}
+
+static void write_results(void)
+{
+    FILE *out = fopen(options.out_path, "w");
+    if (out == NULL)
+    {
+        perror(options.out_path);
+        return;
+    }
+    fprintf(out, "{\n  \"threshold\": %d,\n  \"batch_max_len\": %d,\n", TELEMETRY_DISPATCH_COMPRESS_MIN_LEN,
+            TELEMETRY_DISPATCH_BATCH_MAX_LEN);
+    fprintf(out, "  \"ram\": {\"state_bytes\": %zu, \"output_bytes\": %d, \"stack_bytes\": %lu},\n",
+            sizeof(payload_codec_state_t), TELEMETRY_DISPATCH_BATCH_MAX_LEN, (unsigned long)stack_used);
+    fprintf(out, "  \"sizes\": [\n");
+    for (int i = 0; i < options.size_count; i++)
+    {
+        const size_result_t *r = &results[i];
+        double mb = r->raw_bytes / 1e6;
+        fprintf(out,
+                "    {\"batch\": %d, \"batches\": %lu, \"raw_avg\": %.1f, \"codec_avg\": %.1f, \"ratio\": %.3f, "
+                "\"sent_ratio\": %.3f, \"compressed\": %lu, \"compress_us\": %.2f, \"decompress_us\": %.2f, "
+                "\"compress_mb_s\": %.1f, \"decompress_mb_s\": %.1f, \"mismatches\": %lu}%s\n",
+                r->batch_size, (unsigned long)r->batches, (double)r->raw_bytes / r->batches,
+                (double)r->codec_bytes / r->batches, (double)r->codec_bytes / r->raw_bytes,
+                (double)r->sent_bytes / r->raw_bytes, (unsigned long)r->compressed,
+                r->compress_ns / 1000.0 / r->batches, r->decompress_ns / 1000.0 / r->batches,
+                mb / (r->compress_ns / 1e9), mb / (r->decompress_ns / 1e9), (unsigned long)r->mismatches,
+                i + 1 < options.size_count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    fclose(out);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Uso: %s [--batches N] [--sizes 1,2,4,8] [--seed N] [--out archivo.json]\n", argv0);
+}
+
+static int parse_sizes(const char *value)
+{
+    options.size_count = 0;
+    for (const char *p = value; *p != '\0' && options.size_count < BENCH_MAX_SIZES;)
+    {
+        char *end;
+        long size = strtol(p, &end, 10);
+        if (end == p || size <= 0)
+            return -1;
+        options.sizes[options.size_count++] = (int)size;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return options.size_count > 0 ? 0 : -1;
+}
+
+static int parse_options(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (i + 1 >= argc)
+            return -1;
+        const char *value = argv[++i];
+        if (strcmp(arg, "--batches") == 0)
+            options.batches = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--sizes") == 0)
+        {
+            if (parse_sizes(value) != 0)
+                return -1;
+        }
+        else if (strcmp(arg, "--seed") == 0)
+            options.seed = strtoull(value, NULL, 10);
+        else if (strcmp(arg, "--out") == 0)
+            options.out_path = value;
+        else
+            return -1;
+    }
+    return options.batches > 0 ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    if (parse_options(argc, argv) != 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    batches = malloc((size_t)options.batches * TELEMETRY_DISPATCH_BATCH_MAX_LEN);
+    batch_lens = malloc(options.batches * sizeof(int));
+    done = xSemaphoreCreateBinary();
+    for (int i = 0; i < options.size_count; i++)
+    {
+        results[i].batch_size = options.sizes[i];
+        build_batches(options.sizes[i]);
+        // En una tarea del mock de FreeRTOS para medir el stack como en el ESP32
+        if (batches == NULL || batch_lens == NULL ||
+            xTaskCreate(bench_task, "payload_compress", BENCH_TASK_STACK_SIZE, &results[i], 2, NULL) != pdPASS)
+            return 1;
+        xSemaphoreTake(done, portMAX_DELAY);
+    }
+
+    write_results();
+    uint32_t mismatches = 0;
+    for (int i = 0; i < options.size_count; i++)
+    {
+        const size_result_t *r = &results[i];
+        mismatches += r->mismatches;
+        fprintf(stderr, "lote de %2d: %6.1f -> %6.1f bytes (%.1f%%), %lu/%lu comprimidos, %.2f us comprimir, %.2f us descomprimir\n",
+                r->batch_size, (double)r->raw_bytes / r->batches, (double)r->codec_bytes / r->batches,
+                100.0 * r->codec_bytes / r->raw_bytes, (unsigned long)r->compressed, (unsigned long)r->batches,
+                r->compress_ns / 1000.0 / r->batches, r->decompress_ns / 1000.0 / r->batches);
+    }
+    fprintf(stderr, "RAM: %zu bytes de estado, %d de salida, %lu de stack -> %s\n", sizeof(payload_codec_state_t),
+            TELEMETRY_DISPATCH_BATCH_MAX_LEN, (unsigned long)stack_used, options.out_path);
+    return mismatches > 0 ? 1 : 0;
+}
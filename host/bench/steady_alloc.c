@@ -0,0 +1,175 @@
+/*
+ * steady_alloc.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Comprueba que el firmware no reserva memoria en regimen: arranca como
+ *  main.c (wifi_manager, mqtt_app_main_task del conector Clearblade y el
+ *  sensor, con el esp-mqtt simulado en proceso), deja pasar --warmup
+ *  vueltas del loop principal (muestrear, esperar al broker y publicar)
+ *  y cuenta con alloc_counter las reservas de todo el proceso durante
+ *  --cycles vueltas mas: primero publicando directo y despues con
+ *  telemetry_dispatch en marcha (lotes).
+ *
+ *  Uso: steady_alloc [--warmup N] [--cycles N] [--interval-ms MS]
+ *
+ *  Sale con 1 si hubo alguna reserva. Solo tiene sentido con el build de
+ *  -DSTATIC_ALLOCATION_MODE=ON; sin el sale con 2.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_event.h"
+#include "esp_random.h"
+#include "nvs_flash.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+#include "alloc_counter.h"
+#include "boot_timeline.h"
+#include "clearblade_connect.h"
+#include "config_store.h"
+#include "msg_sequence.h"
+#include "sample_store.h"
+#include "telemetry_dispatch.h"
+#include "temp_sensor.h"
+#include "wifi_manager.h"
+
+#define STEADY_DEVICE_ID "device-steady"
+/* mqtts:// hace que el esp-mqtt simulado conecte en proceso, sin broker */
+#define STEADY_BROKER_URI "mqtts://steady.invalid"
+#define STEADY_CONNECT_TIMEOUT_MS 10000
+
+static struct
+{
+    uint32_t warmup;
+    uint32_t cycles;
+    uint32_t interval_ms;
+} options = {
+    .warmup = 300, // Pasa el primer checkpoint de msg_sequence (cada 256 numeros)
+    .cycles = 1000,
+    .interval_ms = 1,
+};
+
+static void wifi_got_ip_event_callback(void)
+{
+    mqtt_client.set_network_available_flag(true);
+}
+
+/* Una vuelta del loop de main.c */
+static bool main_loop_cycle(void)
+{
+    tempSensor.sample_temp();
+    EventBits_t bits = xEventGroupWaitBits(*mqtt_client.mqtt_event_group, NETWORK_AVAILABLE | CONNECTED_TO_MQTT_BROKER,
+                                           pdFALSE, pdTRUE, pdMS_TO_TICKS(STEADY_CONNECT_TIMEOUT_MS));
+    if ((bits & CONNECTED_TO_MQTT_BROKER) == 0)
+        return false;
+    tempSensor.publish_to_mqtt();
+    vTaskDelay(pdMS_TO_TICKS(options.interval_ms));
+    return true;
+}
+
+/* Reservas durante options.cycles vueltas, despues de options.warmup; -1 si se perdio la conexion */
+static int64_t measure(const char *name)
+{
+    for (uint32_t i = 0; i < options.warmup; i++)
+        if (!main_loop_cycle())
+            return -1;
+    alloc_counter_t before = alloc_counter_snapshot();
+    for (uint32_t i = 0; i < options.cycles; i++)
+        if (!main_loop_cycle())
+            return -1;
+    alloc_counter_t after = alloc_counter_snapshot();
+    uint64_t allocs = after.allocs - before.allocs;
+    fprintf(stderr, "%-10s %u vueltas: %llu reservas, %llu bytes\n", name, options.cycles, (unsigned long long)allocs,
+            (unsigned long long)(after.bytes - before.bytes));
+    return (int64_t)allocs;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Uso: %s [--warmup N] [--cycles N] [--interval-ms MS]\n", argv0);
+}
+
+static int parse_options(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (value == NULL)
+            return -1;
+        i++;
+        if (strcmp(arg, "--warmup") == 0)
+            options.warmup = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--cycles") == 0)
+            options.cycles = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--interval-ms") == 0)
+            options.interval_ms = strtoul(value, NULL, 10);
+        else
+            return -1;
+    }
+    return options.cycles > 0 ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    if (parse_options(argc, argv) != 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+#ifndef STATIC_ALLOCATION_MODE
+    fprintf(stderr, "Compilar con -DSTATIC_ALLOCATION_MODE=ON\n");
+    return 2;
+#endif
+
+    host_mock_seed_random(1);
+    boot_timeline.initialize();
+
+    // createGCPJWTBuffer() y el sensor imprimen por stdout (printf); los logs van por stderr.
+    fflush(stdout);
+    int dev_null = open("/dev/null", O_WRONLY);
+    dup2(dev_null, STDOUT_FILENO);
+    close(dev_null);
+
+    // Arranque, en el mismo orden que app_main()
+    ESP_ERROR_CHECK(nvs_flash_init());
+    ESP_ERROR_CHECK_WITHOUT_ABORT(config_store.load());
+    ESP_ERROR_CHECK_WITHOUT_ABORT(msg_sequence.initialize());
+    char store_path[] = "/tmp/steady_alloc_samples_XXXXXX";
+    int store_fd = mkstemp(store_path);
+    if (store_fd >= 0)
+        close(store_fd);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(sample_store.open(store_path));
+    unlink(store_path);
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+
+    wifi_manager.set_sta_credentials("host-ap", "host-password");
+    wifi_manager.wifi_init();
+    wifi_manager.set_got_ip_callback(wifi_got_ip_event_callback);
+
+    mqtt_client.set_clearblade_data(STEADY_BROKER_URI, "daiot-practica", "us-central1", "registry_1", STEADY_DEVICE_ID);
+    // Las vueltas van sin pausa: sin el limite de tasa, como en host_bench
+    static const publish_limit_config_t no_limits = {0};
+    clearblade_client_set_publish_limits(mqtt_client.instance, &no_limits);
+    mqtt_client.start();
+
+    tempSensor.initialize();
+    tempSensor.set_mqtt_info("", STEADY_DEVICE_ID, mqtt_client.instance);
+
+    int64_t direct = measure("directo");
+    if (telemetry_dispatch.start(mqtt_client.instance) != ESP_OK)
+        return 1;
+    int64_t batched = measure("lotes");
+    if (direct < 0 || batched < 0)
+    {
+        fprintf(stderr, "Sin conexion con el broker simulado\n");
+        return 1;
+    }
+    return direct == 0 && batched == 0 ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+/*
+ * latency_histogram.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <string.h>
+
+#include "latency_histogram.h"
+
+/* Magnitud 0: valores 0..SUB-1 exactos. Magnitud m: [SUB << (m-1), SUB << m) */
+static void bucket_of(uint64_t value, int *magnitude, int *sub)
+{
+    if (value < LATENCY_HISTOGRAM_SUB_BUCKETS)
+    {
+        *magnitude = 0;
+        *sub = (int)value;
+        return;
+    }
+    int bits = 63 - __builtin_clzll(value);      // posicion del bit mas alto
+    int m = bits - 5;                            // log2(SUB) = 6
+    if (m >= LATENCY_HISTOGRAM_MAGNITUDES)
+    {
+        *magnitude = LATENCY_HISTOGRAM_MAGNITUDES - 1;
+        *sub = LATENCY_HISTOGRAM_SUB_BUCKETS - 1;
+        return;
+    }
+    *magnitude = m;
+    *sub = (int)((value >> (m - 1)) - LATENCY_HISTOGRAM_SUB_BUCKETS);
+}
+
+static uint64_t bucket_upper(int magnitude, int sub)
+{
+    if (magnitude == 0)
+        return (uint64_t)sub;
+    return ((uint64_t)(LATENCY_HISTOGRAM_SUB_BUCKETS + sub + 1) << (magnitude - 1)) - 1;
+}
+
+void latency_histogram_init(latency_histogram_t *histogram)
+{
+    memset(histogram, 0, sizeof(*histogram));
+    histogram->min_us = UINT64_MAX;
+}
+
+void latency_histogram_record(latency_histogram_t *histogram, uint64_t value_us)
+{
+    int magnitude, sub;
+    bucket_of(value_us, &magnitude, &sub);
+    histogram->buckets[magnitude][sub]++;
+    histogram->count++;
+    histogram->sum_us += value_us;
+    if (value_us > histogram->max_us)
+        histogram->max_us = value_us;
+    if (value_us < histogram->min_us)
+        histogram->min_us = value_us;
+}
+
+void latency_histogram_merge(latency_histogram_t *dest, const latency_histogram_t *src)
+{
+    for (int m = 0; m < LATENCY_HISTOGRAM_MAGNITUDES; m++)
+        for (int s = 0; s < LATENCY_HISTOGRAM_SUB_BUCKETS; s++)
+            dest->buckets[m][s] += src->buckets[m][s];
+    dest->count += src->count;
+    dest->sum_us += src->sum_us;
+    if (src->max_us > dest->max_us)
+        dest->max_us = src->max_us;
+    if (src->min_us < dest->min_us)
+        dest->min_us = src->min_us;
+}
+
+uint64_t latency_histogram_percentile(const latency_histogram_t *histogram, double percentile)
+{
+    if (histogram->count == 0)
+        return 0;
+    uint64_t target = (uint64_t)(percentile / 100.0 * histogram->count + 0.5);
+    if (target == 0)
+        target = 1;
+
+    uint64_t seen = 0;
+    for (int m = 0; m < LATENCY_HISTOGRAM_MAGNITUDES; m++)
+    {
+        for (int s = 0; s < LATENCY_HISTOGRAM_SUB_BUCKETS; s++)
+        {
+            seen += histogram->buckets[m][s];
+            if (seen >= target)
+            {
+                uint64_t upper = bucket_upper(m, s);
+                return upper < histogram->max_us ? upper : histogram->max_us;
+            }
+        }
+    }
+    return histogram->max_us;
+}
@@ -0,0 +1,34 @@
+/*
+ * latency_histogram.h
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Histograma log-lineal de latencias en microsegundos (error relativo
+ *  menor al 1/LATENCY_HISTOGRAM_SUB_BUCKETS). Tamaño fijo, sin memoria
+ *  dinamica; varios histogramas se combinan con latency_histogram_merge().
+ */
+
+#ifndef LATENCY_HISTOGRAM_H_
+#define LATENCY_HISTOGRAM_H_
+
+#include <stdint.h>
+
+#define LATENCY_HISTOGRAM_SUB_BUCKETS 64
+#define LATENCY_HISTOGRAM_MAGNITUDES 40
+
+typedef struct
+{
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t max_us;
+    uint64_t min_us;
+    uint32_t buckets[LATENCY_HISTOGRAM_MAGNITUDES][LATENCY_HISTOGRAM_SUB_BUCKETS];
+} latency_histogram_t;
+
+void latency_histogram_init(latency_histogram_t *histogram);
+void latency_histogram_record(latency_histogram_t *histogram, uint64_t value_us);
+void latency_histogram_merge(latency_histogram_t *dest, const latency_histogram_t *src);
+/* percentile en [0, 100]; devuelve el limite superior del bucket */
+uint64_t latency_histogram_percentile(const latency_histogram_t *histogram, double percentile);
+
+#endif /* LATENCY_HISTOGRAM_H_ */
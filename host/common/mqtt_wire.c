@@ -0,0 +1,332 @@
+/*
+ * mqtt_wire.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <string.h>
+
+#include "mqtt_wire.h"
+
+#define MQTT_MAX_REMAINING_LENGTH 268435455u
+
+static size_t put_remaining_length(uint8_t *buffer, size_t remaining)
+{
+    size_t n = 0;
+    do
+    {
+        uint8_t byte = remaining % 128;
+        remaining /= 128;
+        buffer[n++] = byte | (remaining > 0 ? 0x80 : 0);
+    } while (remaining > 0);
+    return n;
+}
+
+static size_t remaining_length_size(size_t remaining)
+{
+    return remaining < 128 ? 1 : remaining < 16384 ? 2 : remaining < 2097152 ? 3 : 4;
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t value)
+{
+    p[0] = value >> 8;
+    p[1] = value & 0xff;
+    return p + 2;
+}
+
+static uint8_t *put_string(uint8_t *p, const char *text, size_t len)
+{
+    p = put_u16(p, (uint16_t)len);
+    memcpy(p, text, len);
+    return p + len;
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+/* Escribe el encabezado fijo y devuelve el puntero al cuerpo, o NULL si no entra */
+static uint8_t *begin_packet(uint8_t *buffer, size_t buffer_len, uint8_t first_byte, size_t remaining, size_t *total)
+{
+    if (remaining > MQTT_MAX_REMAINING_LENGTH)
+        return NULL;
+    *total = 1 + remaining_length_size(remaining) + remaining;
+    if (*total > buffer_len)
+        return NULL;
+    buffer[0] = first_byte;
+    return buffer + 1 + put_remaining_length(buffer + 1, remaining);
+}
+
+int mqtt_wire_parse(const uint8_t *buffer, size_t len, mqtt_packet_t *packet)
+{
+    size_t remaining = 0;
+    size_t multiplier = 1;
+    size_t pos = 1;
+
+    if (len < 2)
+        return 0;
+    for (;;)
+    {
+        if (pos >= len)
+            return 0;
+        if (pos > 4)
+            return -1;
+        uint8_t byte = buffer[pos++];
+        remaining += (byte & 0x7f) * multiplier;
+        multiplier *= 128;
+        if ((byte & 0x80) == 0)
+            break;
+    }
+    if (len - pos < remaining)
+        return 0;
+
+    packet->type = buffer[0] >> 4;
+    packet->flags = buffer[0] & 0x0f;
+    packet->body = buffer + pos;
+    packet->body_len = remaining;
+    packet->length = pos + remaining;
+    return 1;
+}
+
+int mqtt_wire_parse_connect(const mqtt_packet_t *packet, mqtt_connect_t *connect)
+{
+    const uint8_t *p = packet->body;
+    const uint8_t *end = packet->body + packet->body_len;
+
+    memset(connect, 0, sizeof(*connect));
+    // "MQTT" (6) + nivel (1) + flags (1) + keepalive (2)
+    if (packet->type != MQTT_PACKET_CONNECT || packet->body_len < 10 || get_u16(p) != 4 || memcmp(p + 2, "MQTT", 4) != 0)
+        return -1;
+    uint8_t flags = p[7];
+    connect->keepalive = get_u16(p + 8);
+    p += 10;
+
+    if (end - p < 2 || end - p - 2 < get_u16(p))
+        return -1;
+    connect->client_id_len = get_u16(p);
+    connect->client_id = (const char *)p + 2;
+    p += 2 + connect->client_id_len;
+
+    if (flags & 0x04)
+    {
+        // Will topic y will message: se saltean
+        for (int i = 0; i < 2; i++)
+        {
+            if (end - p < 2 || end - p - 2 < get_u16(p))
+                return -1;
+            p += 2 + get_u16(p);
+        }
+    }
+    if (flags & 0x80)
+    {
+        if (end - p < 2 || end - p - 2 < get_u16(p))
+            return -1;
+        connect->username_len = get_u16(p);
+        connect->username = (const char *)p + 2;
+        p += 2 + connect->username_len;
+    }
+    if (flags & 0x40)
+    {
+        if (end - p < 2 || end - p - 2 < get_u16(p))
+            return -1;
+        connect->password_len = get_u16(p);
+        connect->password = (const char *)p + 2;
+        p += 2 + connect->password_len;
+    }
+    return 0;
+}
+
+int mqtt_wire_parse_publish(const mqtt_packet_t *packet, mqtt_publish_t *publish)
+{
+    const uint8_t *p = packet->body;
+    const uint8_t *end = packet->body + packet->body_len;
+
+    memset(publish, 0, sizeof(*publish));
+    if (packet->type != MQTT_PACKET_PUBLISH || packet->body_len < 2)
+        return -1;
+    publish->qos = (packet->flags >> 1) & 0x03;
+    publish->topic_len = get_u16(p);
+    if (end - p - 2 < publish->topic_len)
+        return -1;
+    publish->topic = (const char *)p + 2;
+    p += 2 + publish->topic_len;
+    if (publish->qos > 0)
+    {
+        if (end - p < 2)
+            return -1;
+        publish->packet_id = get_u16(p);
+        p += 2;
+    }
+    publish->payload = p;
+    publish->payload_len = end - p;
+    return 0;
+}
+
+int mqtt_wire_parse_subscribe(const mqtt_packet_t *packet, uint16_t *packet_id, size_t *offset,
+                              mqtt_subscription_t *subscription)
+{
+    const uint8_t *end = packet->body + packet->body_len;
+
+    if (packet->type != MQTT_PACKET_SUBSCRIBE || packet->body_len < 2)
+        return -1;
+    *packet_id = get_u16(packet->body);
+    if (*offset == 0)
+        *offset = 2;
+    if (*offset == packet->body_len)
+        return *offset > 2 ? 0 : -1; // Al menos un filtro
+
+    const uint8_t *p = packet->body + *offset;
+    if (end - p < 3 || end - p - 3 < get_u16(p))
+        return -1;
+    subscription->topic_len = get_u16(p);
+    subscription->topic = (const char *)p + 2;
+    subscription->qos = p[2 + subscription->topic_len] & 0x03;
+    *offset += 3 + subscription->topic_len;
+    return 1;
+}
+
+int mqtt_wire_parse_packet_id(const mqtt_packet_t *packet, uint16_t *packet_id)
+{
+    if (packet->body_len < 2)
+        return -1;
+    *packet_id = packet->type == MQTT_PACKET_CONNACK ? packet->body[1] : get_u16(packet->body);
+    return 0;
+}
+
+size_t mqtt_wire_connect(uint8_t *buffer, size_t buffer_len, const char *client_id, const char *username,
+                         const char *password, uint16_t keepalive)
+{
+    size_t client_id_len = strlen(client_id);
+    size_t username_len = username != NULL ? strlen(username) : 0;
+    size_t password_len = password != NULL ? strlen(password) : 0;
+    size_t remaining = 10 + 2 + client_id_len;
+    uint8_t flags = 0x02; // Clean session
+
+    if (username != NULL)
+    {
+        remaining += 2 + username_len;
+        flags |= 0x80;
+    }
+    if (password != NULL)
+    {
+        remaining += 2 + password_len;
+        flags |= 0x40;
+    }
+
+    size_t total;
+    uint8_t *p = begin_packet(buffer, buffer_len, MQTT_PACKET_CONNECT << 4, remaining, &total);
+    if (p == NULL)
+        return 0;
+    p = put_string(p, "MQTT", 4);
+    *p++ = 4; // MQTT 3.1.1
+    *p++ = flags;
+    p = put_u16(p, keepalive);
+    p = put_string(p, client_id, client_id_len);
+    if (username != NULL)
+        p = put_string(p, username, username_len);
+    if (password != NULL)
+        p = put_string(p, password, password_len);
+    return total;
+}
+
+size_t mqtt_wire_connack(uint8_t *buffer, size_t buffer_len, uint8_t return_code)
+{
+    size_t total;
+    uint8_t *p = begin_packet(buffer, buffer_len, MQTT_PACKET_CONNACK << 4, 2, &total);
+    if (p == NULL)
+        return 0;
+    p[0] = 0;
+    p[1] = return_code;
+    return total;
+}
+
+size_t mqtt_wire_publish(uint8_t *buffer, size_t buffer_len, const char *topic, const void *payload, size_t payload_len,
+                         uint8_t qos, uint16_t packet_id)
+{
+    size_t header_len = mqtt_wire_publish_header(buffer, buffer_len, topic, strlen(topic), payload_len, qos, packet_id);
+    if (header_len == 0 || buffer_len - header_len < payload_len)
+        return 0;
+    memcpy(buffer + header_len, payload, payload_len);
+    return header_len + payload_len;
+}
+
+size_t mqtt_wire_publish_header(uint8_t *buffer, size_t buffer_len, const char *topic, size_t topic_len, size_t payload_len,
+                                uint8_t qos, uint16_t packet_id)
+{
+    size_t variable_len = 2 + topic_len + (qos > 0 ? 2 : 0);
+    size_t remaining = variable_len + payload_len;
+    if (topic_len > UINT16_MAX || remaining > MQTT_MAX_REMAINING_LENGTH)
+        return 0;
+    size_t header_len = 1 + remaining_length_size(remaining) + variable_len;
+    if (header_len > buffer_len)
+        return 0;
+    buffer[0] = MQTT_PACKET_PUBLISH << 4 | (qos & 0x03) << 1;
+    uint8_t *p = buffer + 1 + put_remaining_length(buffer + 1, remaining);
+    p = put_string(p, topic, topic_len);
+    if (qos > 0)
+        put_u16(p, packet_id);
+    return header_len;
+}
+
+static size_t packet_id_packet(uint8_t *buffer, size_t buffer_len, uint8_t first_byte, uint16_t packet_id)
+{
+    size_t total;
+    uint8_t *p = begin_packet(buffer, buffer_len, first_byte, 2, &total);
+    if (p == NULL)
+        return 0;
+    put_u16(p, packet_id);
+    return total;
+}
+
+size_t mqtt_wire_puback(uint8_t *buffer, size_t buffer_len, uint16_t packet_id)
+{
+    return packet_id_packet(buffer, buffer_len, MQTT_PACKET_PUBACK << 4, packet_id);
+}
+
+size_t mqtt_wire_unsuback(uint8_t *buffer, size_t buffer_len, uint16_t packet_id)
+{
+    return packet_id_packet(buffer, buffer_len, MQTT_PACKET_UNSUBACK << 4, packet_id);
+}
+
+size_t mqtt_wire_subscribe(uint8_t *buffer, size_t buffer_len, uint16_t packet_id, const char *topic, uint8_t qos)
+{
+    size_t topic_len = strlen(topic);
+    size_t total;
+    uint8_t *p = begin_packet(buffer, buffer_len, MQTT_PACKET_SUBSCRIBE << 4 | 0x02, 2 + 2 + topic_len + 1, &total);
+    if (p == NULL)
+        return 0;
+    p = put_u16(p, packet_id);
+    p = put_string(p, topic, topic_len);
+    *p = qos;
+    return total;
+}
+
+size_t mqtt_wire_suback(uint8_t *buffer, size_t buffer_len, uint16_t packet_id, uint8_t granted_qos)
+{
+    size_t total;
+    uint8_t *p = begin_packet(buffer, buffer_len, MQTT_PACKET_SUBACK << 4, 3, &total);
+    if (p == NULL)
+        return 0;
+    p = put_u16(p, packet_id);
+    *p = granted_qos;
+    return total;
+}
+
+size_t mqtt_wire_suback_codes(uint8_t *buffer, size_t buffer_len, uint16_t packet_id, const uint8_t *codes, size_t count)
+{
+    size_t total;
+    uint8_t *p = begin_packet(buffer, buffer_len, MQTT_PACKET_SUBACK << 4, 2 + count, &total);
+    if (p == NULL)
+        return 0;
+    p = put_u16(p, packet_id);
+    memcpy(p, codes, count);
+    return total;
+}
+
+size_t mqtt_wire_simple(uint8_t *buffer, size_t buffer_len, uint8_t type)
+{
+    size_t total;
+    return begin_packet(buffer, buffer_len, type << 4, 0, &total) != NULL ? total : 0;
+}
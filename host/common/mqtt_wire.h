@@ -0,0 +1,107 @@
+/*
+ * mqtt_wire.h
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Codificacion y decodificacion de paquetes MQTT 3.1.1, sin sockets ni
+ *  memoria dinamica. Lo usan las herramientas de host (simulador de flota,
+ *  broker de prueba).
+ */
+
+#ifndef MQTT_WIRE_H_
+#define MQTT_WIRE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MQTT_PACKET_CONNECT 1
+#define MQTT_PACKET_CONNACK 2
+#define MQTT_PACKET_PUBLISH 3
+#define MQTT_PACKET_PUBACK 4
+#define MQTT_PACKET_SUBSCRIBE 8
+#define MQTT_PACKET_SUBACK 9
+#define MQTT_PACKET_UNSUBSCRIBE 10
+#define MQTT_PACKET_UNSUBACK 11
+#define MQTT_PACKET_PINGREQ 12
+#define MQTT_PACKET_PINGRESP 13
+#define MQTT_PACKET_DISCONNECT 14
+
+/* Codigos de retorno de CONNACK */
+#define MQTT_CONNACK_ACCEPTED 0
+#define MQTT_CONNACK_BAD_PROTOCOL 1
+#define MQTT_CONNACK_ID_REJECTED 2
+#define MQTT_CONNACK_UNAVAILABLE 3
+#define MQTT_CONNACK_BAD_CREDENTIALS 4
+#define MQTT_CONNACK_NOT_AUTHORIZED 5
+
+/* Paquete decodificado; los punteros apuntan dentro del buffer de entrada */
+typedef struct
+{
+    uint8_t type;
+    uint8_t flags;
+    size_t length; // Largo total del paquete (encabezado fijo incluido)
+    const uint8_t *body;
+    size_t body_len;
+} mqtt_packet_t;
+
+/* Campos de un CONNECT */
+typedef struct
+{
+    const char *client_id;
+    uint16_t client_id_len;
+    const char *username;
+    uint16_t username_len;
+    const char *password;
+    uint16_t password_len;
+    uint16_t keepalive;
+} mqtt_connect_t;
+
+/* Campos de un PUBLISH */
+typedef struct
+{
+    const char *topic;
+    uint16_t topic_len;
+    uint16_t packet_id;
+    uint8_t qos;
+    const uint8_t *payload;
+    size_t payload_len;
+} mqtt_publish_t;
+
+/* Un filtro de un SUBSCRIBE */
+typedef struct
+{
+    const char *topic;
+    uint16_t topic_len;
+    uint8_t qos;
+} mqtt_subscription_t;
+
+/* Devuelve 1 si hay un paquete completo, 0 si faltan bytes y -1 si es invalido */
+int mqtt_wire_parse(const uint8_t *buffer, size_t len, mqtt_packet_t *packet);
+
+int mqtt_wire_parse_connect(const mqtt_packet_t *packet, mqtt_connect_t *connect);
+int mqtt_wire_parse_publish(const mqtt_packet_t *packet, mqtt_publish_t *publish);
+/* Recorre los filtros de un SUBSCRIBE: offset en 0 la primera vez. Devuelve 1
+ * por filtro, 0 al terminar y -1 si el paquete es invalido */
+int mqtt_wire_parse_subscribe(const mqtt_packet_t *packet, uint16_t *packet_id, size_t *offset,
+                              mqtt_subscription_t *subscription);
+/* Ack de 2 bytes (PUBACK, SUBACK: packet id); CONNACK: return code */
+int mqtt_wire_parse_packet_id(const mqtt_packet_t *packet, uint16_t *packet_id);
+
+/* Los encoders devuelven el largo escrito, o 0 si no entra en el buffer */
+size_t mqtt_wire_connect(uint8_t *buffer, size_t buffer_len, const char *client_id, const char *username,
+                         const char *password, uint16_t keepalive);
+size_t mqtt_wire_connack(uint8_t *buffer, size_t buffer_len, uint8_t return_code);
+size_t mqtt_wire_publish(uint8_t *buffer, size_t buffer_len, const char *topic, const void *payload, size_t payload_len,
+                         uint8_t qos, uint16_t packet_id);
+/* Solo el encabezado de un PUBLISH (topic sin terminar en 0); el payload se envia aparte */
+size_t mqtt_wire_publish_header(uint8_t *buffer, size_t buffer_len, const char *topic, size_t topic_len, size_t payload_len,
+                                uint8_t qos, uint16_t packet_id);
+size_t mqtt_wire_puback(uint8_t *buffer, size_t buffer_len, uint16_t packet_id);
+size_t mqtt_wire_subscribe(uint8_t *buffer, size_t buffer_len, uint16_t packet_id, const char *topic, uint8_t qos);
+size_t mqtt_wire_suback(uint8_t *buffer, size_t buffer_len, uint16_t packet_id, uint8_t granted_qos);
+/* SUBACK con un codigo por filtro (QoS otorgado o 0x80) */
+size_t mqtt_wire_suback_codes(uint8_t *buffer, size_t buffer_len, uint16_t packet_id, const uint8_t *codes, size_t count);
+size_t mqtt_wire_unsuback(uint8_t *buffer, size_t buffer_len, uint16_t packet_id);
+size_t mqtt_wire_simple(uint8_t *buffer, size_t buffer_len, uint8_t type);
+
+#endif /* MQTT_WIRE_H_ */
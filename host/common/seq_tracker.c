@@ -0,0 +1,257 @@
+/*
+ * seq_tracker.c
+ *
+ *  Created on: 19/10/2026
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "seq_tracker.h"
+
+#define SEQ_KEY "\"seq\""
+#define SEQ_RESYNC_KEY "\"seq_resync\""
+
+static inline bool bit_test(const seq_tracker_t *tracker, uint64_t seq)
+{
+    uint64_t slot = seq % SEQ_TRACKER_WINDOW;
+    return (tracker->bits[slot / 64] >> (slot % 64)) & 1;
+}
+
+static inline void bit_set(seq_tracker_t *tracker, uint64_t seq)
+{
+    uint64_t slot = seq % SEQ_TRACKER_WINDOW;
+    tracker->bits[slot / 64] |= 1ULL << (slot % 64);
+}
+
+static inline void bit_clear(seq_tracker_t *tracker, uint64_t seq)
+{
+    uint64_t slot = seq % SEQ_TRACKER_WINDOW;
+    tracker->bits[slot / 64] &= ~(1ULL << (slot % 64));
+}
+
+static void count_missing(seq_tracker_t *tracker, uint64_t count)
+{
+    if (!tracker->in_gap)
+        tracker->stats.gaps++;
+    tracker->in_gap = true;
+    tracker->stats.missing += count;
+}
+
+/* Mueve el inicio de la ventana a new_base; lo que sale sin haber llegado es un faltante */
+static void slide(seq_tracker_t *tracker, uint64_t new_base)
+{
+    uint64_t limit = tracker->base + SEQ_TRACKER_WINDOW;
+    if (limit > new_base)
+        limit = new_base;
+
+    for (uint64_t seq = tracker->base; seq < limit; seq++)
+    {
+        if (bit_test(tracker, seq))
+        {
+            bit_clear(tracker, seq);
+            tracker->in_gap = false;
+        }
+        else
+        {
+            count_missing(tracker, 1);
+        }
+    }
+    // Salto mayor que la ventana: el resto nunca entro en el mapa
+    if (new_base > limit)
+        count_missing(tracker, new_base - limit);
+    tracker->base = new_base;
+}
+
+static void restart(seq_tracker_t *tracker, uint64_t seq)
+{
+    tracker->base = seq;
+    tracker->highest = seq;
+    tracker->in_gap = false;
+    bit_set(tracker, seq);
+}
+
+void seq_tracker_init(seq_tracker_t *tracker)
+{
+    memset(tracker, 0, sizeof(*tracker));
+}
+
+seq_result_t seq_tracker_add(seq_tracker_t *tracker, uint64_t seq, bool resync)
+{
+    tracker->stats.received++;
+    if (tracker->highest == 0)
+    {
+        restart(tracker, seq);
+        return SEQ_NEW;
+    }
+
+    // El contador se recupero del NVS tras un corte: el salto es esperado
+    if (resync && seq > tracker->highest)
+    {
+        tracker->stats.resyncs++;
+        tracker->stats.resync_skipped += seq - tracker->highest - 1;
+        slide(tracker, tracker->highest + 1);
+        restart(tracker, seq);
+        return SEQ_NEW;
+    }
+
+    if (seq < tracker->base)
+    {
+        tracker->stats.too_old++;
+        return SEQ_TOO_OLD;
+    }
+    if (seq >= tracker->base + SEQ_TRACKER_WINDOW)
+        slide(tracker, seq - SEQ_TRACKER_WINDOW + 1);
+
+    if (bit_test(tracker, seq))
+    {
+        tracker->stats.duplicates++;
+        return SEQ_DUPLICATE;
+    }
+    bit_set(tracker, seq);
+    if (seq < tracker->highest)
+        tracker->stats.reordered++;
+    else
+        tracker->highest = seq;
+    return SEQ_NEW;
+}
+
+void seq_tracker_finish(seq_tracker_t *tracker)
+{
+    if (tracker->highest != 0 && tracker->base <= tracker->highest)
+        slide(tracker, tracker->highest + 1);
+}
+
+/* Busca key en [from, to); devuelve la posicion o to */
+static size_t find(const char *text, size_t from, size_t to, const char *key)
+{
+    size_t key_len = strlen(key);
+    for (size_t i = from; i + key_len <= to; i++)
+        if (text[i] == key[0] && memcmp(text + i, key, key_len) == 0)
+            return i;
+    return to;
+}
+
+int seq_tracker_parse(const char *payload, size_t len, size_t *offset, uint64_t *seq, bool *resync)
+{
+    for (size_t at = find(payload, *offset, len, SEQ_KEY); at < len; at = find(payload, at + 1, len, SEQ_KEY))
+    {
+        size_t p = at + strlen(SEQ_KEY);
+        while (p < len && (payload[p] == ' ' || payload[p] == ':'))
+            p++;
+        if (p >= len || payload[p] < '0' || payload[p] > '9')
+            continue;
+        uint64_t value = 0;
+        while (p < len && payload[p] >= '0' && payload[p] <= '9')
+            value = value * 10 + (payload[p++] - '0');
+
+        // La marca de resincronizacion, si esta, va en el mismo objeto
+        size_t object_end = p;
+        while (object_end < len && payload[object_end] != '}')
+            object_end++;
+        size_t mark = find(payload, p, object_end, SEQ_RESYNC_KEY);
+        *resync = false;
+        if (mark < object_end)
+        {
+            size_t q = mark + strlen(SEQ_RESYNC_KEY);
+            while (q < object_end && (payload[q] == ' ' || payload[q] == ':'))
+                q++;
+            *resync = object_end - q >= 4 && memcmp(payload + q, "true", 4) == 0;
+        }
+
+        *seq = value;
+        *offset = p;
+        return 1;
+    }
+    *offset = len;
+    return 0;
+}
+
+/*****************************************************
+ *   Conjunto por dispositivo                         *
+ ******************************************************/
+static uint64_t hash_key(const char *key, size_t key_len)
+{
+    uint64_t hash = 1469598103934665603ULL; // FNV-1a
+    for (size_t i = 0; i < key_len; i++)
+        hash = (hash ^ (uint8_t)key[i]) * 1099511628211ULL;
+    return hash;
+}
+
+void seq_tracker_set_init(seq_tracker_set_t *set)
+{
+    memset(set, 0, sizeof(*set));
+}
+
+static seq_tracker_entry_t *find_slot(seq_tracker_entry_t *entries, size_t capacity, const char *key, size_t key_len)
+{
+    size_t i = hash_key(key, key_len) & (capacity - 1);
+    while (entries[i].key != NULL && (strlen(entries[i].key) != key_len || memcmp(entries[i].key, key, key_len) != 0))
+        i = (i + 1) & (capacity - 1);
+    return &entries[i];
+}
+
+static int grow(seq_tracker_set_t *set)
+{
+    size_t capacity = set->capacity > 0 ? set->capacity * 2 : 64;
+    seq_tracker_entry_t *entries = calloc(capacity, sizeof(*entries));
+    if (entries == NULL)
+        return -1;
+    for (size_t i = 0; i < set->capacity; i++)
+    {
+        if (set->entries[i].key != NULL)
+            *find_slot(entries, capacity, set->entries[i].key, strlen(set->entries[i].key)) = set->entries[i];
+    }
+    free(set->entries);
+    set->entries = entries;
+    set->capacity = capacity;
+    return 0;
+}
+
+seq_tracker_t *seq_tracker_set_get(seq_tracker_set_t *set, const char *key, size_t key_len)
+{
+    if ((set->count + 1) * 4 > set->capacity * 3 && grow(set) != 0)
+        return NULL;
+
+    seq_tracker_entry_t *entry = find_slot(set->entries, set->capacity, key, key_len);
+    if (entry->key == NULL)
+    {
+        entry->key = malloc(key_len + 1);
+        if (entry->key == NULL)
+            return NULL;
+        memcpy(entry->key, key, key_len);
+        entry->key[key_len] = 0;
+        seq_tracker_init(&entry->tracker);
+        set->count++;
+    }
+    return &entry->tracker;
+}
+
+void seq_tracker_set_finish(seq_tracker_set_t *set, seq_tracker_stats_t *totals)
+{
+    memset(totals, 0, sizeof(*totals));
+    for (size_t i = 0; i < set->capacity; i++)
+    {
+        if (set->entries[i].key == NULL)
+            continue;
+        seq_tracker_t *tracker = &set->entries[i].tracker;
+        seq_tracker_finish(tracker);
+        totals->received += tracker->stats.received;
+        totals->duplicates += tracker->stats.duplicates;
+        totals->missing += tracker->stats.missing;
+        totals->gaps += tracker->stats.gaps;
+        totals->reordered += tracker->stats.reordered;
+        totals->too_old += tracker->stats.too_old;
+        totals->resyncs += tracker->stats.resyncs;
+        totals->resync_skipped += tracker->stats.resync_skipped;
+    }
+}
+
+void seq_tracker_set_free(seq_tracker_set_t *set)
+{
+    for (size_t i = 0; i < set->capacity; i++)
+        free(set->entries[i].key);
+    free(set->entries);
+    memset(set, 0, sizeof(*set));
+}
@@ -0,0 +1,86 @@
+/*
+ * seq_tracker.h
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Deteccion de huecos y duplicados sobre los numeros de secuencia que
+ *  el firmware agrega a cada payload ("seq", msg_sequence.h). Por
+ *  dispositivo se guarda el mayor numero visto y un mapa de bits de los
+ *  SEQ_TRACKER_WINDOW numeros anteriores: cada mensaje cuesta O(1), y
+ *  llegar fuera de orden (las alarmas adelantan a los lotes) no cuenta
+ *  como hueco mientras el faltante llegue dentro de la ventana.
+ */
+
+#ifndef SEQ_TRACKER_H_
+#define SEQ_TRACKER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef SEQ_TRACKER_WINDOW
+#define SEQ_TRACKER_WINDOW 1024 // Multiplo de 64
+#endif
+
+typedef enum
+{
+    SEQ_NEW = 0,
+    SEQ_DUPLICATE,
+    SEQ_TOO_OLD, // Anterior a la ventana: no se puede saber si es duplicado
+} seq_result_t;
+
+typedef struct
+{
+    uint64_t received;
+    uint64_t duplicates;
+    uint64_t missing;        // Numeros que salieron de la ventana sin llegar
+    uint64_t gaps;           // Tramos de numeros faltantes consecutivos
+    uint64_t reordered;      // Llegaron despues de un numero mayor
+    uint64_t too_old;
+    uint64_t resyncs;        // Mensajes con "seq_resync" (contador recuperado del NVS)
+    uint64_t resync_skipped; // Numeros salteados por esos reinicios, no son perdidas
+} seq_tracker_stats_t;
+
+typedef struct
+{
+    uint64_t highest; // 0 = sin mensajes
+    uint64_t base;    // Menor numero dentro de la ventana
+    bool in_gap;      // El ultimo numero que salio de la ventana faltaba
+    uint64_t bits[SEQ_TRACKER_WINDOW / 64];
+    seq_tracker_stats_t stats;
+} seq_tracker_t;
+
+void seq_tracker_init(seq_tracker_t *tracker);
+seq_result_t seq_tracker_add(seq_tracker_t *tracker, uint64_t seq, bool resync);
+/* Cuenta como perdidos los numeros que faltan dentro de la ventana */
+void seq_tracker_finish(seq_tracker_t *tracker);
+
+/* Recorre los "seq" de un payload (un mensaje o un lote [m1, m2, ...]).  */
+/* Devuelve 1 y avanza *offset por cada numero encontrado, 0 al terminar. */
+int seq_tracker_parse(const char *payload, size_t len, size_t *offset, uint64_t *seq, bool *resync);
+
+/************************************************************************/
+/* Conjunto de trackers por clave (device ID), tabla hash abierta que   */
+/* crece al duplicarse.                                                 */
+/************************************************************************/
+typedef struct
+{
+    char *key;
+    seq_tracker_t tracker;
+} seq_tracker_entry_t;
+
+typedef struct
+{
+    seq_tracker_entry_t *entries;
+    size_t capacity;
+    size_t count;
+} seq_tracker_set_t;
+
+void seq_tracker_set_init(seq_tracker_set_t *set);
+/* Devuelve el tracker de key, creandolo si no existe; NULL sin memoria */
+seq_tracker_t *seq_tracker_set_get(seq_tracker_set_t *set, const char *key, size_t key_len);
+/* Llama a seq_tracker_finish() en todos y suma sus estadisticas */
+void seq_tracker_set_finish(seq_tracker_set_t *set, seq_tracker_stats_t *totals);
+void seq_tracker_set_free(seq_tracker_set_t *set);
+
+#endif /* SEQ_TRACKER_H_ */
@@ -0,0 +1,564 @@
+/*
+ * fault_runner.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Ejecuta un escenario de fallas (host_fault.h) contra el firmware
+ *  compilado en el host: arranca igual que main.c (config_store,
+ *  wifi_manager, conector Clearblade, sensor simulado), conecta a un
+ *  broker MQTT local y, mientras el guion cae la conexion, demora los ACK,
+ *  rechaza la autenticacion o baja el AP, mide cuanto tarda el firmware en
+ *  volver a publicar y cuantos mensajes se pierden.
+ *
+ *  Uso: fault_runner --scenario archivo.txt [--broker host:puerto]
+ *                    [--duration S] [--interval-ms MS] [--drain S]
+ *                    [--seed N] [--trace archivo] [--capture archivo.tcap]
+ *                    [--log-bin archivo] [--http-port N] [--batch N]
+ *                    [--model texto] [--deadline-ms MS] [--max-action accion]
+ *                    [--out archivo.json]
+ *
+ *  Sin --duration el escenario termina en el paso "end" del guion. Con
+ *  --capture las publicaciones que salen por el cliente se graban con
+ *  telemetry_capture. Con --trace el sensor reproduce una traza grabada
+ *  (CSV o binaria, sensor_trace.h) en lugar del modelo TPH. Con --log-bin
+ *  el log diferido se graba en binario (deferred_log.h) en lugar de
+ *  formatearse; se convierte a texto con dlog_decode. Con --http-port
+ *  status_server sirve /metrics y /status en 127.0.0.1 durante la corrida.
+ *  Con --batch las muestras salen por telemetry_dispatch en lotes de N
+ *  (QoS 1) en lugar de publicarse una por una. El resultado incluye el
+ *  reporte de resource_monitor con el stack que usaron las tareas y el de
+ *  energy_meter con la carga estimada por muestra; --model cambia el
+ *  modelo de consumo ("tx=120000,radio_on=90000", energy_meter.h).
+ *  health_supervisor mide el tiempo entre publicaciones del loop; con
+ *  --deadline-ms ademas lo supervisa con ese periodo y, si se vence,
+ *  reinicia el cliente y despues el Wi-Fi como en main.c. Como main.c,
+ *  el loop tambien late mientras la estacion no tiene IP y sigue
+ *  reintentando. Con --max-action (none, restart_client, restart_wifi)
+ *  la corrida sale con 1 si el supervisor llego a una accion mayor; un
+ *  reinicio termina la corrida, y sale con 1 salvo --max-action reboot.
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "clearblade_connect.h"
+#include "config_store.h"
+#include "deferred_log.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "energy_meter.h"
+#include "esp_wifi.h"
+#include "health_supervisor.h"
+#include "host_fault.h"
+#include "msg_sequence.h"
+#include "nvs_flash.h"
+#include "resource_monitor.h"
+#include "state_shadow.h"
+#include "status_server.h"
+#include "telemetry_capture.h"
+#include "telemetry_dispatch.h"
+#include "temp_sensor.h"
+#include "wifi_manager.h"
+
+#define RUNNER_DEFAULT_BROKER "127.0.0.1:1883"
+#define RUNNER_DEFAULT_OUT "fault_results.json"
+#define RUNNER_DEFAULT_DURATION_S 60
+#define RUNNER_DEFAULT_INTERVAL_MS 1000
+#define RUNNER_DEFAULT_DRAIN_S 15
+#define RUNNER_DEVICE_ID "device-fault"
+
+typedef struct
+{
+    host_fault_step_t step;
+    int64_t applied_us;
+    int64_t disconnected_us; // Primer MQTT_EVENT_DISCONNECTED despues de la falla
+    int64_t reconnected_us;  // Primer MQTT_EVENT_CONNECTED despues de la desconexion
+    int64_t first_ack_us;    // Primer PUBACK despues de la falla (y de la reconexion)
+} fault_record_t;
+
+static struct
+{
+    const char *broker;
+    const char *scenario;
+    const char *capture_path;
+    const char *trace_path;
+    const char *log_bin_path;
+    const char *out_path;
+    const char *model;
+    uint32_t duration_s;
+    uint32_t interval_ms;
+    uint32_t drain_s;
+    uint32_t deadline_ms;
+    health_action_t max_action;
+    uint64_t seed;
+    uint16_t http_port;
+    uint8_t batch;
+} options = {
+    .broker = RUNNER_DEFAULT_BROKER,
+    .out_path = RUNNER_DEFAULT_OUT,
+    .interval_ms = RUNNER_DEFAULT_INTERVAL_MS,
+    .drain_s = RUNNER_DEFAULT_DRAIN_S,
+    .max_action = HEALTH_ACTION_REBOOT,
+    .seed = 1,
+};
+
+static pthread_mutex_t record_mutex = PTHREAD_MUTEX_INITIALIZER;
+static fault_record_t records[HOST_FAULT_MAX_STEPS];
+static int record_count = 0;
+static int64_t start_us = 0;
+static FILE *log_bin = NULL;
+
+static struct
+{
+    uint32_t samples;
+    uint32_t mqtt_connected;
+    uint32_t mqtt_disconnected;
+    uint32_t mqtt_errors;
+    uint32_t wifi_disconnected;
+    uint32_t wifi_connected;
+    uint32_t got_ip;
+    uint32_t lost_ip;
+    int64_t first_connect_us;
+    int64_t offline_us; // Tiempo total sin conexion MQTT
+    int64_t offline_since_us;
+} counters;
+
+/*****************************************************
+ *   Observadores                                     *
+ ******************************************************/
+static void on_fault_step(const host_fault_step_t *step, int64_t applied_us, void *ctx)
+{
+    (void)ctx;
+    if (step->action == HOST_FAULT_END)
+        return;
+    fprintf(stderr, "[%7.3f s] falla: %s %d\n", (applied_us - start_us) / 1e6, host_fault_action_name(step->action),
+            (int)(int32_t)step->value);
+
+    pthread_mutex_lock(&record_mutex);
+    if (record_count < HOST_FAULT_MAX_STEPS)
+        records[record_count++] = (fault_record_t){.step = *step, .applied_us = applied_us};
+    pthread_mutex_unlock(&record_mutex);
+}
+
+static void on_mqtt_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event_id, int msg_id)
+{
+    (void)client;
+    (void)msg_id;
+    int64_t now = esp_timer_get_time();
+
+    pthread_mutex_lock(&record_mutex);
+    switch (event_id)
+    {
+    case MQTT_EVENT_CONNECTED:
+        counters.mqtt_connected++;
+        if (counters.first_connect_us == 0)
+            counters.first_connect_us = now;
+        if (counters.offline_since_us != 0)
+        {
+            counters.offline_us += now - counters.offline_since_us;
+            counters.offline_since_us = 0;
+        }
+        for (int i = 0; i < record_count; i++)
+            if (records[i].disconnected_us != 0 && records[i].reconnected_us == 0)
+                records[i].reconnected_us = now;
+        break;
+    case MQTT_EVENT_DISCONNECTED:
+        counters.mqtt_disconnected++;
+        if (counters.offline_since_us == 0)
+            counters.offline_since_us = now;
+        for (int i = 0; i < record_count; i++)
+            if (records[i].disconnected_us == 0 && records[i].first_ack_us == 0)
+                records[i].disconnected_us = now;
+        break;
+    case MQTT_EVENT_PUBLISHED:
+        // Si la falla corto la conexion, cuenta el primer PUBACK de la sesion nueva
+        for (int i = 0; i < record_count; i++)
+            if (records[i].first_ack_us == 0 && (records[i].disconnected_us == 0 || records[i].reconnected_us != 0))
+                records[i].first_ack_us = now;
+        break;
+    case MQTT_EVENT_ERROR:
+        counters.mqtt_errors++;
+        break;
+    default:
+        break;
+    }
+    pthread_mutex_unlock(&record_mutex);
+}
+
+static void on_network_event(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    pthread_mutex_lock(&record_mutex);
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
+        counters.wifi_disconnected++;
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED)
+        counters.wifi_connected++;
+    else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
+        counters.got_ip++;
+    else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_LOST_IP)
+        counters.lost_ip++;
+    pthread_mutex_unlock(&record_mutex);
+}
+
+/* Igual que en main.c */
+static void wifi_got_ip_event_callback(void)
+{
+    mqtt_client.set_network_available_flag(true);
+}
+
+static void wifi_disconnected_event_callback(void)
+{
+    mqtt_client.set_network_available_flag(false);
+}
+
+/*****************************************************
+ *   Resultados                                       *
+ ******************************************************/
+static double relative_ms(int64_t event_us, int64_t origin_us)
+{
+    return event_us != 0 ? (event_us - origin_us) / 1000.0 : -1.0;
+}
+
+static void write_results(const host_mqtt_stats_t *stats, double elapsed_s, bool wifi_gave_up)
+{
+    FILE *out = fopen(options.out_path, "w");
+    if (out == NULL)
+    {
+        perror(options.out_path);
+        return;
+    }
+    uint32_t unacked = stats->published - stats->acked;
+
+    fprintf(out, "{\n  \"schema\": 1,\n  \"scenario\": \"%s\",\n  \"broker\": \"%s\",\n", options.scenario, options.broker);
+    fprintf(out, "  \"interval_ms\": %u,\n  \"seed\": %llu,\n  \"elapsed_s\": %.3f,\n", options.interval_ms,
+            (unsigned long long)options.seed, elapsed_s);
+    fprintf(out, "  \"first_connect_ms\": %.1f,\n  \"offline_ms\": %.1f,\n  \"wifi_gave_up\": %s,\n",
+            relative_ms(counters.first_connect_us, start_us), counters.offline_us / 1000.0, wifi_gave_up ? "true" : "false");
+    fprintf(out, "  \"samples\": %u,\n  \"published\": %u,\n  \"rejected\": %u,\n  \"acked\": %u,\n  \"lost\": %u,\n",
+            counters.samples, stats->published, stats->rejected, stats->acked, unacked + stats->rejected);
+    fprintf(out, "  \"retransmitted\": %u,\n  \"outbox_expired\": %u,\n  \"bytes_sent\": %llu,\n", stats->retransmitted,
+            stats->outbox_expired, (unsigned long long)stats->bytes_sent);
+    fprintf(out, "  \"mqtt\": {\"connect_attempts\": %u, \"connects\": %u, \"refused\": %u, \"transport_errors\": %u, "
+                 "\"disconnects\": %u, \"error_events\": %u},\n",
+            stats->connect_attempts, stats->connects, stats->connect_refused, stats->transport_errors, stats->disconnects,
+            counters.mqtt_errors);
+    publish_limiter_stats_t throttle;
+    clearblade_client_get_publish_stats(mqtt_client.instance, &throttle);
+    fprintf(out, "  \"publish_limit\": {\"passed\": %u, \"throttled\": %u, \"rejected\": %u, \"throttle_ms_total\": %.1f, "
+                 "\"throttle_ms_max\": %.1f},\n",
+            throttle.passed, throttle.throttled, throttle.rejected, throttle.throttle_us_total / 1000.0,
+            throttle.throttle_us_max / 1000.0);
+    fprintf(out, "  \"wifi\": {\"sta_disconnected\": %u, \"sta_connected\": %u, \"got_ip\": %u, \"lost_ip\": %u},\n",
+            counters.wifi_disconnected, counters.wifi_connected, counters.got_ip, counters.lost_ip);
+    // Stack de las tareas del firmware medido en los hilos del host (orientativo)
+    char resources[RESOURCE_MONITOR_REPORT_MAX_LEN];
+    resource_monitor.sample();
+    if (resource_monitor_format_report(resources, sizeof(resources)) < (int)sizeof(resources))
+        fprintf(out, "  \"resources\": %s,\n", resources);
+    state_shadow_stats_t shadow;
+    state_shadow.get_stats(&shadow);
+    fprintf(out, "  \"state\": {\"snapshots\": %u, \"diffs\": %u, \"fields\": %u, \"reverted\": %u, \"bytes\": %u},\n",
+            shadow.snapshots, shadow.diffs, shadow.fields_sent, shadow.reverted, shadow.bytes);
+    // Ciclo completo (desde el arranque) con el modelo de consumo de la corrida
+    char energy[ENERGY_METER_REPORT_MAX_LEN];
+    energy_totals_t totals;
+    energy_model_t model;
+    energy_meter.get_cycle(&totals);
+    energy_meter.get_model(&model);
+    int energy_len = energy_meter_format_report(energy, sizeof(energy), "energy", &totals, &model);
+    if (energy_len < (int)sizeof(energy))
+        fprintf(out, "  %.*s,\n", energy_len - 2, energy + 1); // Sin las llaves de afuera
+    // Percentiles desde el ultimo reporte periodico (en corridas cortas, desde el arranque)
+    char health[HEALTH_SUPERVISOR_REPORT_MAX_LEN];
+    int health_len = health_supervisor_format_report(health, sizeof(health));
+    if (health_len < (int)sizeof(health))
+        fprintf(out, "  %.*s,\n", health_len - 2, health + 1);
+    fprintf(out, "  \"faults\": [");
+    for (int i = 0; i < record_count; i++)
+    {
+        const fault_record_t *record = &records[i];
+        fprintf(out, "%s\n    {\"at_ms\": %u, \"action\": \"%s\", \"value\": %d, \"disconnect_ms\": %.1f, "
+                     "\"reconnect_ms\": %.1f, \"recovery_ms\": %.1f}",
+                i > 0 ? "," : "", record->step.at_ms, host_fault_action_name(record->step.action), (int)(int32_t)record->step.value,
+                relative_ms(record->disconnected_us, record->applied_us), relative_ms(record->reconnected_us, record->applied_us),
+                relative_ms(record->first_ack_us, record->applied_us));
+    }
+    fprintf(out, "\n  ]\n}\n");
+    fclose(out);
+}
+
+/*****************************************************
+ *   main                                             *
+ ******************************************************/
+/* Marcos del log diferido, tal cual, para dlog_decode */
+static void log_bin_sink(const uint8_t *frame, size_t len, void *ctx)
+{
+    fwrite(frame, 1, len, (FILE *)ctx);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Uso: %s --scenario archivo.txt [--broker host:puerto] [--duration S] [--interval-ms MS]\n"
+            "          [--drain S] [--seed N] [--trace archivo] [--capture archivo.tcap] [--log-bin archivo]\n"
+            "          [--http-port N] [--batch N] [--model texto] [--deadline-ms MS] [--max-action accion]\n"
+            "          [--out archivo.json]\n",
+            argv0);
+}
+
+/* Accion por nombre (health_action_name()); -1 si no existe */
+static int parse_action(const char *name)
+{
+    for (int action = 0; action < HEALTH_ACTION_COUNT; action++)
+        if (strcmp(name, health_action_name(action)) == 0)
+            return action;
+    return -1;
+}
+
+static int parse_options(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (value == NULL)
+            return -1;
+        i++;
+        if (strcmp(arg, "--scenario") == 0)
+            options.scenario = value;
+        else if (strcmp(arg, "--broker") == 0)
+            options.broker = value;
+        else if (strcmp(arg, "--duration") == 0)
+            options.duration_s = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--interval-ms") == 0)
+            options.interval_ms = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--drain") == 0)
+            options.drain_s = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--seed") == 0)
+            options.seed = strtoull(value, NULL, 10);
+        else if (strcmp(arg, "--trace") == 0)
+            options.trace_path = value;
+        else if (strcmp(arg, "--capture") == 0)
+            options.capture_path = value;
+        else if (strcmp(arg, "--log-bin") == 0)
+            options.log_bin_path = value;
+        else if (strcmp(arg, "--http-port") == 0)
+            options.http_port = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--batch") == 0)
+            options.batch = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--model") == 0)
+            options.model = value;
+        else if (strcmp(arg, "--deadline-ms") == 0)
+            options.deadline_ms = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--max-action") == 0)
+        {
+            int action = parse_action(value);
+            if (action < 0)
+                return -1;
+            options.max_action = action;
+        }
+        else if (strcmp(arg, "--out") == 0)
+            options.out_path = value;
+        else
+            return -1;
+    }
+    if (options.model != NULL)
+    {
+        energy_model_t model;
+        energy_meter.get_model(&model);
+        if (!energy_meter_parse_model(options.model, &model))
+            return -1;
+        energy_meter.set_model(&model);
+    }
+    return options.scenario != NULL && options.interval_ms > 0 ? 0 : -1;
+}
+
+/* Las dos primeras acciones de la escalada, igual que main.c; el reinicio termina la corrida */
+static esp_err_t health_recovery_callback(health_action_t action, const char *task, void *ctx)
+{
+    if (action == HEALTH_ACTION_RESTART_CLIENT)
+        return clearblade_client_restart(mqtt_client.instance);
+    if (action == HEALTH_ACTION_RESTART_WIFI)
+        return wifi_manager.restart();
+    if (action == HEALTH_ACTION_REBOOT && options.max_action < HEALTH_ACTION_REBOOT)
+    {
+        fprintf(stderr, "%s: reinicio por %s, mayor que --max-action %s\n", options.scenario, task,
+                health_action_name(options.max_action));
+        _exit(1);
+    }
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+/* Espera hasta que el bit este en 1 o se cumpla el plazo */
+static bool wait_bits_until(EventGroupHandle_t group, EventBits_t bits, int64_t deadline_us)
+{
+    int64_t now = esp_timer_get_time();
+    if (now >= deadline_us)
+        return false;
+    TickType_t ticks = (TickType_t)((deadline_us - now) / 1000 / portTICK_PERIOD_MS) + 1;
+    return (xEventGroupWaitBits(group, bits, pdFALSE, pdTRUE, ticks) & bits) == bits;
+}
+
+int main(int argc, char **argv)
+{
+    if (parse_options(argc, argv) != 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    int bad_line = host_fault_load_script(options.scenario);
+    if (bad_line != 0)
+    {
+        fprintf(stderr, "%s: error en la linea %d\n", options.scenario, bad_line);
+        return 2;
+    }
+    if (options.duration_s == 0)
+        options.duration_s = host_fault_end_ms() > 0 ? (host_fault_end_ms() + 999) / 1000 : RUNNER_DEFAULT_DURATION_S;
+    host_mock_seed_random(options.seed);
+
+    // createGCPJWTBuffer() y el sensor imprimen por stdout (printf); los logs van por stderr.
+    fflush(stdout);
+    int dev_null = open("/dev/null", O_WRONLY);
+    dup2(dev_null, STDOUT_FILENO);
+    close(dev_null);
+
+    if (options.capture_path != NULL && telemetry_capture.start(options.capture_path) != ESP_OK)
+        return 1;
+    if (options.log_bin_path != NULL)
+    {
+        log_bin = fopen(options.log_bin_path, "wb");
+        if (log_bin == NULL)
+        {
+            perror(options.log_bin_path);
+            return 1;
+        }
+        deferred_log.set_sink(log_bin_sink, log_bin);
+    }
+
+    // Arranque, en el mismo orden que app_main()
+    ESP_ERROR_CHECK_WITHOUT_ABORT(deferred_log.start());
+    ESP_ERROR_CHECK_WITHOUT_ABORT(resource_monitor.start());
+    ESP_ERROR_CHECK_WITHOUT_ABORT(energy_meter.start());
+    health_supervisor.set_recovery_callback(health_recovery_callback, NULL);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(health_supervisor.start());
+    ESP_ERROR_CHECK(nvs_flash_init());
+    ESP_ERROR_CHECK_WITHOUT_ABORT(config_store.load());
+    ESP_ERROR_CHECK_WITHOUT_ABORT(msg_sequence.initialize());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, on_network_event, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, ESP_EVENT_ANY_ID, on_network_event, NULL));
+    host_mqtt_set_event_observer(on_mqtt_event);
+
+    // Con credenciales en NVS wifi_init() arranca en APSTA y la estacion se asocia sola
+    wifi_manager.set_sta_credentials("host-ap", "host-password");
+    start_us = esp_timer_get_time();
+    wifi_manager.wifi_init();
+    wifi_manager.set_got_ip_callback(wifi_got_ip_event_callback);
+    wifi_manager.set_disconnected_callback(wifi_disconnected_event_callback);
+
+    char broker_uri[CLEARBLADE_BROKER_URI_MAX_LEN];
+    snprintf(broker_uri, sizeof(broker_uri), "mqtt://%s", options.broker);
+    mqtt_client.set_clearblade_data(broker_uri, "daiot-practica", "us-central1", "registry_1", RUNNER_DEVICE_ID);
+    mqtt_client.start();
+    if (options.http_port != 0 && status_server.start(mqtt_client.instance, options.http_port) != ESP_OK)
+        return 1;
+    ESP_ERROR_CHECK_WITHOUT_ABORT(state_shadow.start(mqtt_client.instance));
+    if (options.batch > 0)
+    {
+        // Un lote sale lleno o, si el sensor se atrasa, cuando su primera muestra cumple N intervalos
+        telemetry_class_config_t bulk_config = {
+            .subtopic = TELEMETRY_DISPATCH_BULK_SUBTOPIC,
+            .qos = 1,
+            .batch_max = options.batch,
+            .batch_max_age_ms = options.batch * options.interval_ms,
+            .compress_min_len = TELEMETRY_DISPATCH_COMPRESS_MIN_LEN,
+        };
+        telemetry_dispatch.set_class_config(TELEMETRY_CLASS_BULK, &bulk_config);
+        if (telemetry_dispatch.start(mqtt_client.instance) != ESP_OK)
+            return 1;
+    }
+
+    tempSensor.initialize();
+    tempSensor.set_mqtt_info("", RUNNER_DEVICE_ID, mqtt_client.instance);
+    if (options.trace_path != NULL && tempSensor.set_source(&sensor_source_trace, options.trace_path) != ESP_OK)
+    {
+        fprintf(stderr, "No se pudo abrir la traza %s\n", options.trace_path);
+        return 1;
+    }
+
+    host_fault_start(on_fault_step, NULL);
+
+    // Loop de main.c con plazo: muestrea, espera red y broker, publica. Con --deadline-ms la espera
+    // dura a lo sumo ese plazo, como HEALTH_SUPERVISOR_WAIT_MS en main.c
+    int64_t deadline_us = start_us + options.duration_s * 1000000LL;
+    int health_id = health_supervisor.register_task("app_main", options.deadline_ms);
+    while (esp_timer_get_time() < deadline_us)
+    {
+        tempSensor.sample_temp();
+        int64_t wait_us = deadline_us;
+        if (options.deadline_ms > 0 && esp_timer_get_time() + options.deadline_ms * 1000LL < deadline_us)
+            wait_us = esp_timer_get_time() + options.deadline_ms * 1000LL;
+        bool connected = wait_bits_until(*mqtt_client.mqtt_event_group, NETWORK_AVAILABLE | CONNECTED_TO_MQTT_BROKER, wait_us);
+        // Con --batch la muestra se encola aunque no haya conexion
+        if (connected || telemetry_dispatch.is_running())
+        {
+            tempSensor.publish_to_mqtt();
+            counters.samples++;
+        }
+        if (connected || (!(xEventGroupGetBits(*mqtt_client.mqtt_event_group) & NETWORK_AVAILABLE) &&
+                          !(xEventGroupGetBits(*wifi_manager.wifi_event_group) & WIFI_STA_FAIL_BIT)))
+            health_supervisor.beat(health_id);
+        if (esp_timer_get_time() >= deadline_us)
+            break;
+        vTaskDelay(options.interval_ms / portTICK_PERIOD_MS);
+    }
+
+    // Espera los PUBACK pendientes (o que el outbox los descarte)
+    host_mqtt_stats_t stats = {0};
+    int64_t drain_deadline_us = esp_timer_get_time() + options.drain_s * 1000000LL;
+    if (telemetry_dispatch.is_running())
+    {
+        telemetry_dispatch.flush();
+        telemetry_dispatch.wait_idle(options.drain_s * 1000 / portTICK_PERIOD_MS);
+    }
+    while (*mqtt_client.client_handle != NULL)
+    {
+        host_mqtt_get_stats(*mqtt_client.client_handle, &stats);
+        if (stats.acked + stats.outbox_expired >= stats.published || esp_timer_get_time() >= drain_deadline_us)
+            break;
+        usleep(100 * 1000);
+    }
+    double elapsed_s = (esp_timer_get_time() - start_us) / 1e6;
+    telemetry_capture.stop();
+
+    pthread_mutex_lock(&record_mutex);
+    if (counters.offline_since_us != 0)
+        counters.offline_us += esp_timer_get_time() - counters.offline_since_us;
+    bool wifi_gave_up = (xEventGroupGetBits(*wifi_manager.wifi_event_group) & WIFI_STA_FAIL_BIT) != 0;
+    write_results(&stats, elapsed_s, wifi_gave_up);
+    pthread_mutex_unlock(&record_mutex);
+
+    fprintf(stderr, "%s: %u muestras, %u publicadas, %u con PUBACK, %u perdidas, %u reconexiones%s -> %s\n",
+            options.scenario, counters.samples, stats.published, stats.acked,
+            stats.published - stats.acked + stats.rejected, stats.connects > 0 ? stats.connects - 1 : 0,
+            wifi_gave_up ? ", Wi-Fi agoto los reintentos" : "", options.out_path);
+    health_status_t health;
+    health_supervisor.get_status(&health);
+    health_action_t max_action = HEALTH_ACTION_NONE;
+    for (int action = HEALTH_ACTION_RESTART_CLIENT; action < HEALTH_ACTION_COUNT; action++)
+        if (health.actions[action] > 0)
+            max_action = action;
+    if (max_action > options.max_action)
+        fprintf(stderr, "%s: el supervisor llego a %s, mayor que --max-action %s\n", options.scenario,
+                health_action_name(max_action), health_action_name(options.max_action));
+    deferred_log.flush();
+    if (log_bin != NULL)
+        fflush(log_bin); // La tarea de vaciado sigue viva: no se cierra
+    // Las tareas del firmware no terminan: se sale sin esperarlas
+    _exit(max_action > options.max_action ? 1 : 0);
+}
@@ -0,0 +1,1109 @@
+/*
+ * fleet_sim.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Simulador de flota: N dispositivos virtuales contra un broker MQTT local.
+ *
+ *  Cada dispositivo tiene su device ID, su conexion TCP y su cadencia de
+ *  muestreo. Usa el modelo TPH y el formato de payload de sensor_tph, y el
+ *  client ID / topics / JWT del conector Clearblade. Cada hilo de trabajo
+ *  atiende una porcion de la flota con un loop epoll y un heap de plazos;
+ *  no hay un hilo por dispositivo.
+ *
+ *  Uso: fleet_sim [--broker host:puerto] [--devices N] [--threads T]
+ *                 [--interval-ms MS] [--duration S] [--qos 0|1]
+ *                 [--connect-rate N/s] [--jwt-per-device] [--signer-workers N]
+ *                 [--seed N] [--capture archivo.tcap] [--out archivo.json]
+ *
+ *  Cada hilo genera un paso de tph_model para todos sus dispositivos por
+ *  intervalo, en bloque; cada dispositivo publica el valor de su canal.
+ *  Con la misma --seed cada dispositivo tiene la misma serie, sin importar
+ *  la cantidad de hilos.
+ *  Con --jwt-per-device cada dispositivo firma su propio JWT al conectar,
+ *  a traves del pool jwt_signer (--signer-workers, 0 = uno por CPU) o, con
+ *  --signer-workers -1, en el hilo de red como lo hace cada ESP32.
+ *
+ *  Con --capture cada publicacion se graba con telemetry_capture, en el
+ *  mismo formato que el firmware, para reproducirla con telemetry_replay.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "certs.h"
+#include "clearblade_connect.h"
+#include "jwt_signer.h"
+#include "jwt_token_gcp.h"
+#include "mqtt_basico.h"
+#include "telemetry_capture.h"
+#include "temp_sensor.h"
+#include "tph_model.h"
+
+#include "latency_histogram.h"
+#include "mqtt_wire.h"
+
+#define SIM_MAX_INFLIGHT 4
+#define SIM_RX_BUFFER_SIZE 64
+#define SIM_TX_SCRATCH_SIZE 1536
+#define SIM_EPOLL_EVENTS 512
+#define SIM_CONNACK_TIMEOUT_US (10 * 1000000LL)
+#define SIM_BACKOFF_MIN_US (1 * 1000000LL)
+#define SIM_DEVICE_ID_MAX_LEN 32
+
+typedef enum
+{
+    DEVICE_IDLE = 0,
+    DEVICE_CONNECTING,    // connect() no bloqueante en curso
+    DEVICE_WAIT_TOKEN,    // TCP establecido, JWT en el pool de firma
+    DEVICE_WAIT_CONNACK,  // CONNECT enviado
+    DEVICE_CONNECTED,
+    DEVICE_BACKOFF,       // Esperando para reconectar
+} device_state_t;
+
+typedef struct
+{
+    uint16_t packet_id;
+    uint32_t sent_us; // Relativo al inicio, con aritmetica modular
+} inflight_t;
+
+struct sim_worker;
+typedef struct sim_jwt_job sim_jwt_job_t;
+
+/* Estado de un dispositivo virtual; se mantiene chico a proposito */
+typedef struct
+{
+    struct sim_worker *worker;
+    uint8_t *tx_pending; // Solo si send() no aceptó todo el paquete
+    int64_t deadline_us;
+    int64_t connect_start_us;
+    int64_t offline_since_us;
+    sim_jwt_job_t *jwt_job; // Solo en DEVICE_WAIT_TOKEN
+    uint32_t index;
+    uint32_t heap_pos;
+    uint32_t rng;
+    uint32_t seq; // Ultimo numero de secuencia usado (msg_sequence.h)
+    int fd;
+    uint16_t next_packet_id;
+    uint16_t tx_pending_len;
+    uint16_t rx_len;
+    uint8_t state;
+    uint8_t inflight_count;
+    inflight_t inflight[SIM_MAX_INFLIGHT];
+    uint8_t rx[SIM_RX_BUFFER_SIZE];
+} sim_device_t;
+
+typedef struct
+{
+    uint64_t published;
+    uint64_t acked;
+    uint64_t connects;
+    uint64_t connect_failures;
+    uint64_t disconnects;
+    uint64_t inflight_full;
+    uint64_t bytes_sent;
+} sim_counters_t;
+
+/* Pedido de firma de un dispositivo; se reserva solo mientras dura la firma */
+struct sim_jwt_job
+{
+    jwt_request_t request;
+    struct sim_worker *worker;
+    sim_device_t *device; // NULL si el dispositivo se cerro mientras se firmaba
+    sim_jwt_job_t *next;
+    char identity[SIM_DEVICE_ID_MAX_LEN];
+    char token[JWT_TOKEN_MAX_LEN];
+};
+
+typedef struct sim_worker
+{
+    pthread_t thread;
+    int id;
+    int epoll_fd;
+    sim_device_t *devices;
+    uint32_t device_count;
+    sim_device_t **heap;
+    uint32_t heap_size;
+    uint32_t connected;
+    int64_t next_connect_us;
+    int64_t connect_spacing_us;
+    sim_counters_t counters;
+    latency_histogram_t ack_latency;
+    latency_histogram_t connect_latency;
+    pthread_mutex_t stats_mutex;
+    int jwt_event_fd;              // Lo escribe el pool de firma al completar un pedido
+    pthread_mutex_t jwt_done_mutex;
+    sim_jwt_job_t *jwt_done;
+    tph_model_t model;             // Un canal por dispositivo del hilo
+    void *model_storage;
+    float *model_temp;             // Ultimo paso del modelo
+    float *model_press;
+    float *model_hum;
+    int64_t model_next_us;
+    uint8_t tx_scratch[SIM_TX_SCRATCH_SIZE];
+} sim_worker_t;
+
+typedef struct
+{
+    struct sockaddr_in broker;
+    const char *broker_text;
+    uint32_t devices;
+    int threads;
+    uint32_t interval_ms;
+    uint32_t duration_s;
+    uint32_t report_s;
+    uint32_t connect_rate;
+    uint8_t qos;
+    bool jwt_per_device;
+    int signer_workers;
+    const char *project;
+    const char *region;
+    const char *registry;
+    const char *id_prefix;
+    const char *capture_path;
+    const char *out_path;
+    uint64_t seed;
+} sim_options_t;
+
+static sim_options_t options = {
+    .broker_text = "127.0.0.1:1883",
+    .devices = 1000,
+    .threads = 1,
+    .interval_ms = 1000,
+    .duration_s = 30,
+    .report_s = 5,
+    .connect_rate = 2000,
+    .signer_workers = 0,
+    .qos = 1,
+    .project = "sim-project",
+    .region = "us-central1",
+    .registry = "sim-registry",
+    .id_prefix = "sim-",
+    .out_path = "fleet_results.json",
+    .seed = 1,
+};
+
+static volatile sig_atomic_t stop_requested = 0;
+static char shared_jwt[JWT_TOKEN_MAX_LEN];
+static struct timespec start_time;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec - start_time.tv_sec) * 1000000LL + (ts.tv_nsec - start_time.tv_nsec) / 1000;
+}
+
+static uint32_t device_random(sim_device_t *device)
+{
+    // xorshift32: cada dispositivo tiene su propia secuencia, sin estado compartido entre hilos
+    uint32_t x = device->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    device->rng = x;
+    return x;
+}
+
+static void device_id(const sim_device_t *device, char *buffer, size_t buffer_len)
+{
+    snprintf(buffer, buffer_len, "%s%06u", options.id_prefix, device->index);
+}
+
+/*****************************************************
+ *   Heap de plazos (min-heap por deadline_us)        *
+ ******************************************************/
+static void heap_swap(sim_worker_t *worker, uint32_t a, uint32_t b)
+{
+    sim_device_t *tmp = worker->heap[a];
+    worker->heap[a] = worker->heap[b];
+    worker->heap[b] = tmp;
+    worker->heap[a]->heap_pos = a;
+    worker->heap[b]->heap_pos = b;
+}
+
+static void heap_sift_up(sim_worker_t *worker, uint32_t pos)
+{
+    while (pos > 0)
+    {
+        uint32_t parent = (pos - 1) / 2;
+        if (worker->heap[parent]->deadline_us <= worker->heap[pos]->deadline_us)
+            break;
+        heap_swap(worker, parent, pos);
+        pos = parent;
+    }
+}
+
+static void heap_sift_down(sim_worker_t *worker, uint32_t pos)
+{
+    for (;;)
+    {
+        uint32_t left = 2 * pos + 1;
+        uint32_t smallest = pos;
+        if (left < worker->heap_size && worker->heap[left]->deadline_us < worker->heap[smallest]->deadline_us)
+            smallest = left;
+        if (left + 1 < worker->heap_size && worker->heap[left + 1]->deadline_us < worker->heap[smallest]->deadline_us)
+            smallest = left + 1;
+        if (smallest == pos)
+            return;
+        heap_swap(worker, pos, smallest);
+        pos = smallest;
+    }
+}
+
+static void schedule(sim_device_t *device, int64_t deadline_us)
+{
+    sim_worker_t *worker = device->worker;
+    int64_t previous = device->deadline_us;
+    device->deadline_us = deadline_us;
+    if (deadline_us < previous)
+        heap_sift_up(worker, device->heap_pos);
+    else
+        heap_sift_down(worker, device->heap_pos);
+}
+
+/*****************************************************
+ *   Conexion                                         *
+ ******************************************************/
+static void device_close(sim_device_t *device, bool failed)
+{
+    sim_worker_t *worker = device->worker;
+
+    if (device->fd >= 0)
+    {
+        epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, device->fd, NULL);
+        close(device->fd);
+        device->fd = -1;
+    }
+    if (device->jwt_job != NULL)
+    {
+        device->jwt_job->device = NULL; // El pool lo completa y el loop lo descarta
+        device->jwt_job = NULL;
+    }
+    if (device->state == DEVICE_CONNECTED)
+    {
+        worker->connected--;
+        worker->counters.disconnects++;
+        device->offline_since_us = now_us();
+    }
+    else if (failed)
+        worker->counters.connect_failures++;
+
+    free(device->tx_pending);
+    device->tx_pending = NULL;
+    device->tx_pending_len = 0;
+    device->rx_len = 0;
+    device->inflight_count = 0;
+    device->state = DEVICE_BACKOFF;
+    schedule(device, now_us() + SIM_BACKOFF_MIN_US + device_random(device) % SIM_BACKOFF_MIN_US);
+}
+
+/* Envia un paquete completo; lo que no entra en el socket queda pendiente para EPOLLOUT */
+static bool device_send(sim_device_t *device, const uint8_t *data, size_t len)
+{
+    if (device->tx_pending != NULL)
+        return false; // Todavia hay un paquete a medio enviar: contrapresion
+
+    ssize_t sent = send(device->fd, data, len, MSG_NOSIGNAL);
+    if (sent < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            device_close(device, false);
+            return false;
+        }
+        sent = 0;
+    }
+    device->worker->counters.bytes_sent += sent;
+    if ((size_t)sent < len)
+    {
+        device->tx_pending_len = (uint16_t)(len - sent);
+        device->tx_pending = malloc(device->tx_pending_len);
+        memcpy(device->tx_pending, data + sent, device->tx_pending_len);
+        struct epoll_event event = {.events = EPOLLIN | EPOLLOUT, .data.ptr = device};
+        epoll_ctl(device->worker->epoll_fd, EPOLL_CTL_MOD, device->fd, &event);
+    }
+    return true;
+}
+
+static void device_flush(sim_device_t *device)
+{
+    ssize_t sent = send(device->fd, device->tx_pending, device->tx_pending_len, MSG_NOSIGNAL);
+    if (sent < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            device_close(device, false);
+        return;
+    }
+    device->worker->counters.bytes_sent += sent;
+    if ((size_t)sent < device->tx_pending_len)
+    {
+        memmove(device->tx_pending, device->tx_pending + sent, device->tx_pending_len - sent);
+        device->tx_pending_len -= sent;
+        return;
+    }
+    free(device->tx_pending);
+    device->tx_pending = NULL;
+    device->tx_pending_len = 0;
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = device};
+    epoll_ctl(device->worker->epoll_fd, EPOLL_CTL_MOD, device->fd, &event);
+}
+
+static void device_start_connect(sim_device_t *device)
+{
+    sim_worker_t *worker = device->worker;
+
+    device->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (device->fd < 0)
+    {
+        device_close(device, true);
+        return;
+    }
+    int one = 1;
+    setsockopt(device->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    device->connect_start_us = now_us();
+    if (connect(device->fd, (struct sockaddr *)&options.broker, sizeof(options.broker)) < 0 && errno != EINPROGRESS)
+    {
+        device_close(device, true);
+        return;
+    }
+    device->state = DEVICE_CONNECTING;
+    struct epoll_event event = {.events = EPOLLOUT, .data.ptr = device};
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, device->fd, &event);
+    schedule(device, device->connect_start_us + SIM_CONNACK_TIMEOUT_US);
+}
+
+static void device_send_connect_with(sim_device_t *device, const char *password)
+{
+    sim_worker_t *worker = device->worker;
+    char id[SIM_DEVICE_ID_MAX_LEN];
+    char client_id[CLEARBLADE_CLIENT_ID_MAX_LEN];
+
+    device_id(device, id, sizeof(id));
+    clearblade_format_client_id(client_id, sizeof(client_id), options.project, options.region, options.registry, id);
+    uint16_t keepalive = options.interval_ms / 1000 * 2 + 60;
+    size_t len = mqtt_wire_connect(worker->tx_scratch, sizeof(worker->tx_scratch), client_id, IOTCORE_USERNAME, password, keepalive);
+
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = device};
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_MOD, device->fd, &event);
+    device->state = DEVICE_WAIT_CONNACK;
+    device_send(device, worker->tx_scratch, len);
+}
+
+/* Lo llama un worker del pool de firma: encola el pedido y despierta al hilo de red */
+static void jwt_job_done(jwt_request_t *request, void *ctx)
+{
+    sim_jwt_job_t *job = ctx;
+    sim_worker_t *worker = job->worker;
+    uint64_t one = 1;
+
+    pthread_mutex_lock(&worker->jwt_done_mutex);
+    job->next = worker->jwt_done;
+    worker->jwt_done = job;
+    pthread_mutex_unlock(&worker->jwt_done_mutex);
+    if (write(worker->jwt_event_fd, &one, sizeof(one)) < 0)
+        perror("eventfd");
+}
+
+/* Envia CONNECT a los dispositivos cuyo token ya esta firmado */
+static void worker_drain_jwt_jobs(sim_worker_t *worker)
+{
+    uint64_t value;
+    if (read(worker->jwt_event_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        perror("eventfd");
+
+    pthread_mutex_lock(&worker->jwt_done_mutex);
+    sim_jwt_job_t *job = worker->jwt_done;
+    worker->jwt_done = NULL;
+    pthread_mutex_unlock(&worker->jwt_done_mutex);
+
+    while (job != NULL)
+    {
+        sim_jwt_job_t *next = job->next;
+        sim_device_t *device = job->device;
+        if (device != NULL)
+        {
+            device->jwt_job = NULL;
+            if (job->request.result_len == 0)
+                device_close(device, true);
+            else
+                device_send_connect_with(device, job->token);
+        }
+        free(job);
+        job = next;
+    }
+}
+
+static void device_request_jwt(sim_device_t *device)
+{
+    sim_jwt_job_t *job = malloc(sizeof(*job));
+    if (job == NULL)
+    {
+        device_close(device, true);
+        return;
+    }
+    job->worker = device->worker;
+    job->device = device;
+    device_id(device, job->identity, sizeof(job->identity));
+
+    jwt_request_t *request = &job->request;
+    memset(request, 0, sizeof(*request));
+    request->identity = job->identity;
+    request->project_id = options.project;
+    request->private_key = (const unsigned char *)DEVICE_KEY;
+    request->private_key_len = strlen(DEVICE_KEY);
+    request->expiration_minutes = IOTCORE_TOKEN_EXPIRATION_TIME_MINUTES;
+    request->offline_since_us = device->offline_since_us;
+    request->token = job->token;
+    request->token_len = sizeof(job->token);
+    request->done = jwt_job_done;
+    request->done_ctx = job;
+
+    if (jwt_signer.submit(request) != ESP_OK)
+    {
+        free(job);
+        device_close(device, true);
+        return;
+    }
+    // Sin EPOLLOUT mientras se firma: solo interesan errores del socket
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = device};
+    epoll_ctl(device->worker->epoll_fd, EPOLL_CTL_MOD, device->fd, &event);
+    device->jwt_job = job;
+    device->state = DEVICE_WAIT_TOKEN;
+}
+
+/* TCP establecido: genera el JWT (o usa el compartido) y envia CONNECT */
+static void device_send_connect(sim_device_t *device)
+{
+    char jwt[JWT_TOKEN_MAX_LEN];
+
+    int error = 0;
+    socklen_t error_len = sizeof(error);
+    getsockopt(device->fd, SOL_SOCKET, SO_ERROR, &error, &error_len);
+    if (error != 0)
+    {
+        device_close(device, true);
+        return;
+    }
+
+    if (!options.jwt_per_device)
+    {
+        device_send_connect_with(device, shared_jwt);
+        return;
+    }
+    if (jwt_signer.is_running())
+    {
+        device_request_jwt(device);
+        return;
+    }
+    if (createGCPJWTBuffer(jwt, sizeof(jwt), options.project, (const unsigned char *)DEVICE_KEY, strlen(DEVICE_KEY),
+                           IOTCORE_TOKEN_EXPIRATION_TIME_MINUTES) == 0)
+    {
+        device_close(device, true);
+        return;
+    }
+    device_send_connect_with(device, jwt);
+}
+
+/*****************************************************
+ *   Telemetria                                       *
+ ******************************************************/
+static void device_publish_sample(sim_device_t *device, int64_t now)
+{
+    sim_worker_t *worker = device->worker;
+    char id[SIM_DEVICE_ID_MAX_LEN];
+    char topic[sizeof("/devices//events") + SIM_DEVICE_ID_MAX_LEN];
+    char temp_text[10];
+    char payload[256];
+
+    if (options.qos > 0 && device->inflight_count == SIM_MAX_INFLIGHT)
+    {
+        worker->counters.inflight_full++;
+        return;
+    }
+
+    // El modelo avanza un paso por intervalo, para todos los dispositivos del hilo
+    while (now >= worker->model_next_us)
+    {
+        tph_model_generate(&worker->model, 1, worker->model_temp, worker->model_press, worker->model_hum);
+        worker->model_next_us += options.interval_ms * 1000LL;
+    }
+    uint32_t channel = device - worker->devices;
+    snprintf(temp_text, sizeof(temp_text), "%04.1f", worker->model_temp[channel]);
+    device_id(device, id, sizeof(id));
+    int8_t rssi = -45 - (int8_t)(device_random(device) % 40);
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    int payload_len = temp_sensor_format_payload(payload, sizeof(payload), id, ++device->seq, temp_text, worker->model_press[channel],
+                                                 worker->model_hum[channel], rssi,
+                                                 wall.tv_sec * 1000LL + wall.tv_nsec / 1000000, 0, NULL);
+    clearblade_format_topic(topic, sizeof(topic), id, NULL);
+
+    uint16_t packet_id = 0;
+    if (options.qos > 0)
+    {
+        if (++device->next_packet_id == 0)
+            device->next_packet_id = 1;
+        packet_id = device->next_packet_id;
+    }
+    size_t len = mqtt_wire_publish(worker->tx_scratch, sizeof(worker->tx_scratch), topic, payload, payload_len, options.qos, packet_id);
+    if (!device_send(device, worker->tx_scratch, len))
+    {
+        if (device->fd >= 0)
+            worker->counters.inflight_full++;
+        return;
+    }
+    worker->counters.published++;
+    telemetry_capture.record(topic, payload, payload_len, options.qos);
+    if (options.qos > 0 && device->state == DEVICE_CONNECTED)
+        device->inflight[device->inflight_count++] = (inflight_t){packet_id, (uint32_t)now};
+}
+
+static void device_handle_packet(sim_device_t *device, const mqtt_packet_t *packet, int64_t now)
+{
+    sim_worker_t *worker = device->worker;
+    uint16_t value = 0;
+
+    switch (packet->type)
+    {
+    case MQTT_PACKET_CONNACK:
+        if (device->state != DEVICE_WAIT_CONNACK || mqtt_wire_parse_packet_id(packet, &value) != 0 || value != MQTT_CONNACK_ACCEPTED)
+        {
+            device_close(device, true);
+            return;
+        }
+        device->state = DEVICE_CONNECTED;
+        worker->connected++;
+        worker->counters.connects++;
+        latency_histogram_record(&worker->connect_latency, now - device->connect_start_us);
+        // Fase aleatoria dentro del intervalo, para no publicar todos a la vez
+        schedule(device, now + (int64_t)(device_random(device) % (options.interval_ms * 1000ULL)));
+        break;
+
+    case MQTT_PACKET_PUBACK:
+        if (mqtt_wire_parse_packet_id(packet, &value) != 0)
+            break;
+        for (int i = 0; i < device->inflight_count; i++)
+        {
+            if (device->inflight[i].packet_id == value)
+            {
+                latency_histogram_record(&worker->ack_latency, (uint32_t)((uint32_t)now - device->inflight[i].sent_us));
+                worker->counters.acked++;
+                device->inflight[i] = device->inflight[--device->inflight_count];
+                break;
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void device_handle_input(sim_device_t *device)
+{
+    for (;;)
+    {
+        ssize_t received = recv(device->fd, device->rx + device->rx_len, sizeof(device->rx) - device->rx_len, 0);
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            device_close(device, device->state != DEVICE_CONNECTED);
+            return;
+        }
+        if (received < 0)
+            return;
+        device->rx_len += received;
+
+        int64_t now = now_us();
+        size_t offset = 0;
+        mqtt_packet_t packet;
+        int rc;
+        while ((rc = mqtt_wire_parse(device->rx + offset, device->rx_len - offset, &packet)) == 1)
+        {
+            device_handle_packet(device, &packet, now);
+            if (device->fd < 0)
+                return;
+            offset += packet.length;
+        }
+        // Paquete invalido o mas grande que el buffer (el simulador no se suscribe a nada)
+        if (rc < 0 || (offset == 0 && device->rx_len == sizeof(device->rx)))
+        {
+            device_close(device, false);
+            return;
+        }
+        memmove(device->rx, device->rx + offset, device->rx_len - offset);
+        device->rx_len -= offset;
+    }
+}
+
+static void device_handle_deadline(sim_device_t *device, int64_t now)
+{
+    sim_worker_t *worker = device->worker;
+
+    switch (device->state)
+    {
+    case DEVICE_IDLE:
+    case DEVICE_BACKOFF:
+        // Rampa de conexion: como maximo connect_rate conexiones por segundo en toda la flota
+        if (worker->next_connect_us > now)
+        {
+            schedule(device, worker->next_connect_us);
+            return;
+        }
+        worker->next_connect_us = (worker->next_connect_us > now - worker->connect_spacing_us ? worker->next_connect_us : now) + worker->connect_spacing_us;
+        device_start_connect(device);
+        break;
+
+    case DEVICE_CONNECTING:
+    case DEVICE_WAIT_TOKEN:
+    case DEVICE_WAIT_CONNACK:
+        device_close(device, true); // Timeout
+        break;
+
+    case DEVICE_CONNECTED:
+        schedule(device, device->deadline_us + options.interval_ms * 1000LL);
+        device_publish_sample(device, now);
+        break;
+    }
+}
+
+/*****************************************************
+ *   Hilos de trabajo                                 *
+ ******************************************************/
+static void *worker_main(void *arg)
+{
+    sim_worker_t *worker = arg;
+    struct epoll_event events[SIM_EPOLL_EVENTS];
+
+    while (!stop_requested)
+    {
+        // El mutex solo protege las estadisticas frente al hilo de reporte; se libera durante epoll_wait.
+        pthread_mutex_lock(&worker->stats_mutex);
+        int64_t now = now_us();
+        while (worker->heap_size > 0 && worker->heap[0]->deadline_us <= now)
+            device_handle_deadline(worker->heap[0], now);
+
+        int timeout_ms = 100;
+        if (worker->heap_size > 0)
+        {
+            int64_t wait_us = worker->heap[0]->deadline_us - now_us();
+            timeout_ms = wait_us <= 0 ? 0 : wait_us < 100000 ? (int)((wait_us + 999) / 1000) : 100;
+        }
+        pthread_mutex_unlock(&worker->stats_mutex);
+
+        int count = epoll_wait(worker->epoll_fd, events, SIM_EPOLL_EVENTS, timeout_ms);
+        pthread_mutex_lock(&worker->stats_mutex);
+        for (int i = 0; i < count; i++)
+        {
+            if (events[i].data.ptr == worker)
+            {
+                worker_drain_jwt_jobs(worker);
+                continue;
+            }
+            sim_device_t *device = events[i].data.ptr;
+            if (device->fd < 0)
+                continue;
+            if (device->state == DEVICE_CONNECTING)
+            {
+                if (events[i].events & (EPOLLERR | EPOLLHUP))
+                    device_close(device, true);
+                else
+                    device_send_connect(device);
+                continue;
+            }
+            if ((events[i].events & EPOLLOUT) && device->tx_pending != NULL)
+                device_flush(device);
+            if (device->fd >= 0 && (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+                device_handle_input(device);
+        }
+        pthread_mutex_unlock(&worker->stats_mutex);
+    }
+
+    for (uint32_t i = 0; i < worker->device_count; i++)
+    {
+        if (worker->devices[i].jwt_job != NULL)
+            worker->devices[i].jwt_job->device = NULL;
+        if (worker->devices[i].fd >= 0)
+            close(worker->devices[i].fd);
+        free(worker->devices[i].tx_pending);
+    }
+    return NULL;
+}
+
+static int worker_init(sim_worker_t *worker, int id, uint32_t first_index, uint32_t count)
+{
+    worker->id = id;
+    worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    worker->devices = calloc(count, sizeof(sim_device_t));
+    worker->heap = calloc(count, sizeof(sim_device_t *));
+    if (worker->epoll_fd < 0 || (count > 0 && (worker->devices == NULL || worker->heap == NULL)))
+        return -1;
+    worker->device_count = count;
+    worker->connect_spacing_us = 1000000LL * options.threads / (options.connect_rate > 0 ? options.connect_rate : 1);
+    latency_histogram_init(&worker->ack_latency);
+    latency_histogram_init(&worker->connect_latency);
+    pthread_mutex_init(&worker->stats_mutex, NULL);
+    pthread_mutex_init(&worker->jwt_done_mutex, NULL);
+    worker->jwt_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (worker->jwt_event_fd < 0)
+        return -1;
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = worker};
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->jwt_event_fd, &event);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        sim_device_t *device = &worker->devices[i];
+        device->worker = worker;
+        device->index = first_index + i;
+        device->fd = -1;
+        device->rng = 0x9E3779B9u ^ (device->index * 2654435761u) ^ 1;
+        device->state = DEVICE_IDLE;
+        device->deadline_us = 0;
+        device->heap_pos = i;
+        worker->heap[i] = device;
+    }
+    worker->heap_size = count;
+
+    // Sitios distintos por dispositivo; la semilla de cada canal depende de su indice global
+    if (count == 0)
+        return 0;
+    tph_model_params_t params;
+    tph_model_default_params(&params);
+    params.site_temp_spread_c = 3.0f;
+    params.site_press_spread_hpa = 10.0f;
+    params.site_hum_spread_pct = 10.0f;
+    params.site_phase_spread_s = 3600.0f;
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    size_t storage_len = TPH_MODEL_STORAGE_BYTES(count);
+    worker->model_storage = aligned_alloc(64, (storage_len + 63) & ~(size_t)63);
+    worker->model_temp = calloc(count, sizeof(float));
+    worker->model_press = calloc(count, sizeof(float));
+    worker->model_hum = calloc(count, sizeof(float));
+    if (worker->model_storage == NULL || worker->model_temp == NULL || worker->model_press == NULL || worker->model_hum == NULL)
+        return -1;
+    return tph_model_init(&worker->model, &params, worker->model_storage, storage_len, count, options.seed, first_index,
+                          wall.tv_sec + wall.tv_nsec / 1e9, options.interval_ms / 1000.0f) == ESP_OK ? 0 : -1;
+}
+
+/*****************************************************
+ *   Reporte                                          *
+ ******************************************************/
+typedef struct
+{
+    sim_counters_t counters;
+    uint32_t connected;
+    latency_histogram_t ack_latency;
+    latency_histogram_t connect_latency;
+} sim_totals_t;
+
+static void collect(sim_worker_t *workers, sim_totals_t *totals)
+{
+    memset(totals, 0, sizeof(*totals));
+    latency_histogram_init(&totals->ack_latency);
+    latency_histogram_init(&totals->connect_latency);
+    for (int w = 0; w < options.threads; w++)
+    {
+        pthread_mutex_lock(&workers[w].stats_mutex);
+        sim_counters_t *c = &workers[w].counters;
+        totals->counters.published += c->published;
+        totals->counters.acked += c->acked;
+        totals->counters.connects += c->connects;
+        totals->counters.connect_failures += c->connect_failures;
+        totals->counters.disconnects += c->disconnects;
+        totals->counters.inflight_full += c->inflight_full;
+        totals->counters.bytes_sent += c->bytes_sent;
+        totals->connected += workers[w].connected;
+        latency_histogram_merge(&totals->ack_latency, &workers[w].ack_latency);
+        latency_histogram_merge(&totals->connect_latency, &workers[w].connect_latency);
+        pthread_mutex_unlock(&workers[w].stats_mutex);
+    }
+}
+
+static long rss_kb(void)
+{
+    long pages_total = 0, pages_resident = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL)
+        return 0;
+    if (fscanf(statm, "%ld %ld", &pages_total, &pages_resident) != 2)
+        pages_resident = 0;
+    fclose(statm);
+    return pages_resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void write_results(const sim_totals_t *totals, double elapsed_s, long rss_base_kb, long rss_peak_kb, size_t heap_bytes)
+{
+    FILE *out = fopen(options.out_path, "w");
+    if (out == NULL)
+    {
+        perror(options.out_path);
+        return;
+    }
+    const latency_histogram_t *ack = &totals->ack_latency;
+    const latency_histogram_t *conn = &totals->connect_latency;
+
+    fprintf(out, "{\n  \"schema\": 1,\n  \"broker\": \"%s\",\n", options.broker_text);
+    fprintf(out, "  \"devices\": %u,\n  \"threads\": %d,\n  \"interval_ms\": %u,\n  \"qos\": %u,\n",
+            options.devices, options.threads, options.interval_ms, options.qos);
+    fprintf(out, "  \"jwt_per_device\": %s,\n  \"signer_workers\": %d,\n  \"elapsed_s\": %.3f,\n",
+            options.jwt_per_device ? "true" : "false", options.signer_workers, elapsed_s);
+    fprintf(out, "  \"connected\": %u,\n  \"connects\": %llu,\n  \"connect_failures\": %llu,\n  \"disconnects\": %llu,\n",
+            totals->connected, (unsigned long long)totals->counters.connects,
+            (unsigned long long)totals->counters.connect_failures, (unsigned long long)totals->counters.disconnects);
+    fprintf(out, "  \"published\": %llu,\n  \"acked\": %llu,\n  \"inflight_full\": %llu,\n",
+            (unsigned long long)totals->counters.published, (unsigned long long)totals->counters.acked,
+            (unsigned long long)totals->counters.inflight_full);
+    fprintf(out, "  \"publish_rate\": %.1f,\n  \"ack_rate\": %.1f,\n  \"bytes_sent\": %llu,\n",
+            totals->counters.published / elapsed_s, totals->counters.acked / elapsed_s,
+            (unsigned long long)totals->counters.bytes_sent);
+    fprintf(out, "  \"ack_latency_us\": {\"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu, \"mean\": %.1f},\n",
+            (unsigned long long)latency_histogram_percentile(ack, 50), (unsigned long long)latency_histogram_percentile(ack, 90),
+            (unsigned long long)latency_histogram_percentile(ack, 99), (unsigned long long)latency_histogram_percentile(ack, 99.9),
+            (unsigned long long)ack->max_us, ack->count > 0 ? (double)ack->sum_us / ack->count : 0.0);
+    fprintf(out, "  \"connect_latency_us\": {\"p50\": %llu, \"p99\": %llu, \"max\": %llu},\n",
+            (unsigned long long)latency_histogram_percentile(conn, 50), (unsigned long long)latency_histogram_percentile(conn, 99),
+            (unsigned long long)conn->max_us);
+    fprintf(out, "  \"memory\": {\"device_struct_bytes\": %zu, \"heap_bytes_per_device\": %.1f, \"rss_bytes_per_device\": %.1f}\n}\n",
+            sizeof(sim_device_t), options.devices > 0 ? (double)heap_bytes / options.devices : 0.0,
+            options.devices > 0 ? (rss_peak_kb - rss_base_kb) * 1024.0 / options.devices : 0.0);
+    fclose(out);
+}
+
+/*****************************************************
+ *   main                                             *
+ ******************************************************/
+static void on_signal(int signal_number)
+{
+    (void)signal_number;
+    stop_requested = 1;
+}
+
+static int parse_broker(const char *text)
+{
+    char host[256];
+    const char *colon = strrchr(text, ':');
+    size_t host_len = colon != NULL ? (size_t)(colon - text) : strlen(text);
+    if (host_len >= sizeof(host))
+        return -1;
+    memcpy(host, text, host_len);
+    host[host_len] = 0;
+
+    struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *result;
+    if (getaddrinfo(host, colon != NULL ? colon + 1 : "1883", &hints, &result) != 0)
+        return -1;
+    memcpy(&options.broker, result->ai_addr, sizeof(options.broker));
+    freeaddrinfo(result);
+    return 0;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Uso: %s [--broker host:puerto] [--devices N] [--threads T] [--interval-ms MS]\n"
+            "          [--duration S] [--report-s S] [--qos 0|1] [--connect-rate N] [--jwt-per-device]\n"
+            "          [--signer-workers N (0 = uno por CPU, -1 = sin pool)]\n"
+            "          [--project P] [--region R] [--registry R] [--id-prefix P] [--seed N] [--capture archivo.tcap]\n"
+            "          [--out archivo.json]\n",
+            argv0);
+}
+
+static int parse_options(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--jwt-per-device") == 0)
+        {
+            options.jwt_per_device = true;
+            continue;
+        }
+        if (value == NULL)
+            return -1;
+        i++;
+        if (strcmp(arg, "--broker") == 0)
+            options.broker_text = value;
+        else if (strcmp(arg, "--devices") == 0)
+            options.devices = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--threads") == 0)
+            options.threads = atoi(value);
+        else if (strcmp(arg, "--interval-ms") == 0)
+            options.interval_ms = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--duration") == 0)
+            options.duration_s = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--report-s") == 0)
+            options.report_s = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--qos") == 0)
+            options.qos = atoi(value) > 0 ? 1 : 0;
+        else if (strcmp(arg, "--signer-workers") == 0)
+            options.signer_workers = atoi(value);
+        else if (strcmp(arg, "--connect-rate") == 0)
+            options.connect_rate = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--project") == 0)
+            options.project = value;
+        else if (strcmp(arg, "--region") == 0)
+            options.region = value;
+        else if (strcmp(arg, "--registry") == 0)
+            options.registry = value;
+        else if (strcmp(arg, "--id-prefix") == 0)
+            options.id_prefix = value;
+        else if (strcmp(arg, "--seed") == 0)
+            options.seed = strtoull(value, NULL, 10);
+        else if (strcmp(arg, "--capture") == 0)
+            options.capture_path = value;
+        else if (strcmp(arg, "--out") == 0)
+            options.out_path = value;
+        else
+            return -1;
+    }
+    if (options.threads < 1 || options.interval_ms == 0 || strlen(options.id_prefix) > SIM_DEVICE_ID_MAX_LEN - 8)
+        return -1;
+    return 0;
+}
+
+static void raise_fd_limit(void)
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < options.devices + 64)
+        fprintf(stderr, "Aviso: RLIMIT_NOFILE=%lu, menor que la cantidad de dispositivos\n", (unsigned long)limit.rlim_cur);
+}
+
+int main(int argc, char **argv)
+{
+    if (parse_options(argc, argv) != 0 || parse_broker(options.broker_text) != 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+    raise_fd_limit();
+
+    if (!options.jwt_per_device &&
+        createGCPJWTBuffer(shared_jwt, sizeof(shared_jwt), options.project, (const unsigned char *)DEVICE_KEY,
+                           strlen(DEVICE_KEY), IOTCORE_TOKEN_EXPIRATION_TIME_MINUTES) == 0)
+    {
+        fprintf(stderr, "No se pudo generar el JWT\n");
+        return 1;
+    }
+    if (options.jwt_per_device && options.signer_workers >= 0 && jwt_signer.start(options.signer_workers) != ESP_OK)
+    {
+        fprintf(stderr, "No se pudo iniciar el pool de firma\n");
+        return 1;
+    }
+
+    if (options.capture_path != NULL && telemetry_capture.start(options.capture_path) != ESP_OK)
+    {
+        fprintf(stderr, "No se pudo abrir la captura %s\n", options.capture_path);
+        return 1;
+    }
+
+    long rss_base_kb = rss_kb();
+    struct mallinfo2 heap_info = mallinfo2();
+    size_t heap_base = heap_info.uordblks + heap_info.hblkhd;
+
+    sim_worker_t *workers = calloc(options.threads, sizeof(sim_worker_t));
+    uint32_t per_worker = options.devices / options.threads;
+    uint32_t first = 0;
+    for (int w = 0; w < options.threads; w++)
+    {
+        uint32_t count = per_worker + (w < (int)(options.devices % options.threads) ? 1 : 0);
+        if (worker_init(&workers[w], w, first, count) != 0)
+        {
+            fprintf(stderr, "Sin memoria para %u dispositivos\n", options.devices);
+            return 1;
+        }
+        first += count;
+    }
+    heap_info = mallinfo2();
+    size_t heap_devices = heap_info.uordblks + heap_info.hblkhd - heap_base;
+
+    for (int w = 0; w < options.threads; w++)
+        pthread_create(&workers[w].thread, NULL, worker_main, &workers[w]);
+
+    fprintf(stderr, "fleet_sim: %u dispositivos, %d hilos, broker %s, intervalo %u ms\n",
+            options.devices, options.threads, options.broker_text, options.interval_ms);
+
+    int64_t start = now_us();
+    int64_t end = start + options.duration_s * 1000000LL;
+    int64_t next_report = start + options.report_s * 1000000LL;
+    uint64_t last_published = 0, last_acked = 0;
+    long rss_peak_kb = rss_base_kb;
+    static sim_totals_t totals;
+
+    while (!stop_requested && now_us() < end)
+    {
+        usleep(100000);
+        long rss = rss_kb();
+        if (rss > rss_peak_kb)
+            rss_peak_kb = rss;
+        if (options.report_s > 0 && now_us() >= next_report)
+        {
+            collect(workers, &totals);
+            fprintf(stderr, "[%5.1fs] conectados %u/%u  pub/s %.0f  ack/s %.0f  ack p50 %llu us  p99 %llu us  fallos %llu\n",
+                    (now_us() - start) / 1e6, totals.connected, options.devices,
+                    (double)(totals.counters.published - last_published) / options.report_s,
+                    (double)(totals.counters.acked - last_acked) / options.report_s,
+                    (unsigned long long)latency_histogram_percentile(&totals.ack_latency, 50),
+                    (unsigned long long)latency_histogram_percentile(&totals.ack_latency, 99),
+                    (unsigned long long)totals.counters.connect_failures);
+            last_published = totals.counters.published;
+            last_acked = totals.counters.acked;
+            next_report += options.report_s * 1000000LL;
+        }
+    }
+    double elapsed_s = (now_us() - start) / 1e6;
+    collect(workers, &totals);
+    stop_requested = 1;
+    for (int w = 0; w < options.threads; w++)
+        pthread_join(workers[w].thread, NULL);
+    // Los pedidos en curso se completan contra hilos ya terminados; se esperan antes de salir
+    if (jwt_signer.is_running())
+        jwt_signer.wait_idle(pdMS_TO_TICKS(5000));
+
+    if (telemetry_capture.is_active())
+    {
+        telemetry_capture_stats_t capture_stats;
+        telemetry_capture.get_stats(&capture_stats);
+        telemetry_capture.stop();
+        fprintf(stderr, "Captura: %u registros, %llu bytes en %s\n", capture_stats.records,
+                (unsigned long long)capture_stats.bytes, options.capture_path);
+    }
+
+    write_results(&totals, elapsed_s, rss_base_kb, rss_peak_kb, heap_devices);
+    fprintf(stderr, "Publicados %llu (%.0f/s), confirmados %llu, ack p50/p99/p999 %llu/%llu/%llu us, %zu B/dispositivo (struct)\n",
+            (unsigned long long)totals.counters.published, totals.counters.published / elapsed_s,
+            (unsigned long long)totals.counters.acked,
+            (unsigned long long)latency_histogram_percentile(&totals.ack_latency, 50),
+            (unsigned long long)latency_histogram_percentile(&totals.ack_latency, 99),
+            (unsigned long long)latency_histogram_percentile(&totals.ack_latency, 99.9), sizeof(sim_device_t));
+    fprintf(stderr, "Resultados: %s\n", options.out_path);
+    return 0;
+}
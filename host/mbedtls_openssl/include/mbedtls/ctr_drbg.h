@@ -0,0 +1,25 @@
+/*
+ * mbedtls/ctr_drbg.h (host, adaptador sobre OpenSSL)
+ *
+ *  El DRBG delega en RAND_bytes(); la siembra solo verifica la fuente.
+ */
+
+#ifndef HOST_MBEDTLS_CTR_DRBG_H_
+#define HOST_MBEDTLS_CTR_DRBG_H_
+
+#include <stddef.h>
+
+#define MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED -0x0034
+
+typedef struct
+{
+    int seeded;
+} mbedtls_ctr_drbg_context;
+
+void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context *ctx);
+void mbedtls_ctr_drbg_free(mbedtls_ctr_drbg_context *ctx);
+int mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context *ctx, int (*f_entropy)(void *, unsigned char *, size_t),
+                          void *p_entropy, const unsigned char *custom, size_t len);
+int mbedtls_ctr_drbg_random(void *p_rng, unsigned char *output, size_t output_len);
+
+#endif /* HOST_MBEDTLS_CTR_DRBG_H_ */
@@ -0,0 +1,19 @@
+/*
+ * mbedtls/entropy.h (host, adaptador sobre OpenSSL)
+ */
+
+#ifndef HOST_MBEDTLS_ENTROPY_H_
+#define HOST_MBEDTLS_ENTROPY_H_
+
+#include <stddef.h>
+
+typedef struct
+{
+    int initialized;
+} mbedtls_entropy_context;
+
+void mbedtls_entropy_init(mbedtls_entropy_context *ctx);
+void mbedtls_entropy_free(mbedtls_entropy_context *ctx);
+int mbedtls_entropy_func(void *data, unsigned char *output, size_t len);
+
+#endif /* HOST_MBEDTLS_ENTROPY_H_ */
@@ -0,0 +1,12 @@
+/*
+ * mbedtls/error.h (host, adaptador sobre OpenSSL)
+ */
+
+#ifndef HOST_MBEDTLS_ERROR_H_
+#define HOST_MBEDTLS_ERROR_H_
+
+#include <stddef.h>
+
+void mbedtls_strerror(int errnum, char *buffer, size_t buflen);
+
+#endif /* HOST_MBEDTLS_ERROR_H_ */
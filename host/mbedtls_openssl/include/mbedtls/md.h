@@ -0,0 +1,23 @@
+/*
+ * mbedtls/md.h (host, adaptador sobre OpenSSL)
+ */
+
+#ifndef HOST_MBEDTLS_MD_H_
+#define HOST_MBEDTLS_MD_H_
+
+#include <stddef.h>
+
+#define MBEDTLS_ERR_MD_BAD_INPUT_DATA -0x5100
+
+typedef enum
+{
+    MBEDTLS_MD_NONE = 0,
+    MBEDTLS_MD_SHA256 = 9,
+} mbedtls_md_type_t;
+
+typedef struct mbedtls_md_info_t mbedtls_md_info_t;
+
+const mbedtls_md_info_t *mbedtls_md_info_from_type(mbedtls_md_type_t md_type);
+int mbedtls_md(const mbedtls_md_info_t *md_info, const unsigned char *input, size_t ilen, unsigned char *output);
+
+#endif /* HOST_MBEDTLS_MD_H_ */
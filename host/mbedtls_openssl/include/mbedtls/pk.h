@@ -0,0 +1,47 @@
+/*
+ * mbedtls/pk.h (host, adaptador sobre OpenSSL)
+ *
+ *  Solo se usa cuando el host no tiene MbedTLS 3.x instalado. Implementa las
+ *  firmas de la API 3.x que usa el firmware, delegando en libcrypto.
+ */
+
+#ifndef HOST_MBEDTLS_PK_H_
+#define HOST_MBEDTLS_PK_H_
+
+#include <stddef.h>
+#include "mbedtls/md.h"
+
+#define MBEDTLS_ERR_PK_ALLOC_FAILED -0x3F80
+#define MBEDTLS_ERR_PK_TYPE_MISMATCH -0x3F00
+#define MBEDTLS_ERR_PK_BAD_INPUT_DATA -0x3E80
+#define MBEDTLS_ERR_PK_KEY_INVALID_FORMAT -0x3D00
+#define MBEDTLS_ERR_PK_INVALID_PUBKEY -0x3B00
+#define MBEDTLS_ERR_PK_BUFFER_TOO_SMALL -0x3880
+#define MBEDTLS_ERR_RSA_VERIFY_FAILED -0x4380
+#define MBEDTLS_PK_SIGNATURE_MAX_SIZE 1024
+
+typedef enum
+{
+    MBEDTLS_PK_NONE = 0,
+    MBEDTLS_PK_RSA,
+    MBEDTLS_PK_ECKEY,
+} mbedtls_pk_type_t;
+
+typedef struct
+{
+    void *pkey; // EVP_PKEY *
+} mbedtls_pk_context;
+
+void mbedtls_pk_init(mbedtls_pk_context *ctx);
+void mbedtls_pk_free(mbedtls_pk_context *ctx);
+int mbedtls_pk_parse_key(mbedtls_pk_context *ctx, const unsigned char *key, size_t keylen, const unsigned char *pwd,
+                         size_t pwdlen, int (*f_rng)(void *, unsigned char *, size_t), void *p_rng);
+int mbedtls_pk_parse_public_key(mbedtls_pk_context *ctx, const unsigned char *key, size_t keylen);
+int mbedtls_pk_sign(mbedtls_pk_context *ctx, mbedtls_md_type_t md_alg, const unsigned char *hash, size_t hash_len,
+                    unsigned char *sig, size_t sig_size, size_t *sig_len,
+                    int (*f_rng)(void *, unsigned char *, size_t), void *p_rng);
+int mbedtls_pk_verify(mbedtls_pk_context *ctx, mbedtls_md_type_t md_alg, const unsigned char *hash, size_t hash_len,
+                      const unsigned char *sig, size_t sig_len);
+mbedtls_pk_type_t mbedtls_pk_get_type(const mbedtls_pk_context *ctx);
+
+#endif /* HOST_MBEDTLS_PK_H_ */
@@ -0,0 +1,268 @@
+/*
+ * mbedtls_openssl.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Implementacion de la parte de la API de MbedTLS 3.x que usa el firmware
+ *  (pk, md, entropy, ctr_drbg, error) sobre libcrypto de OpenSSL. Permite
+ *  compilar jwt_token_gcp.c en hosts que solo tienen OpenSSL.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rand.h>
+#include <openssl/x509.h>
+
+#include "mbedtls/pk.h"
+#include "mbedtls/md.h"
+#include "mbedtls/error.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+
+struct mbedtls_md_info_t
+{
+    mbedtls_md_type_t type;
+};
+
+static const mbedtls_md_info_t md_info_sha256 = {MBEDTLS_MD_SHA256};
+
+/*****************************************************
+ *   md                                               *
+ ******************************************************/
+const mbedtls_md_info_t *mbedtls_md_info_from_type(mbedtls_md_type_t md_type)
+{
+    return md_type == MBEDTLS_MD_SHA256 ? &md_info_sha256 : NULL;
+}
+
+int mbedtls_md(const mbedtls_md_info_t *md_info, const unsigned char *input, size_t ilen, unsigned char *output)
+{
+    if (md_info == NULL || md_info->type != MBEDTLS_MD_SHA256)
+        return MBEDTLS_ERR_MD_BAD_INPUT_DATA;
+    return EVP_Digest(input, ilen, output, NULL, EVP_sha256(), NULL) == 1 ? 0 : MBEDTLS_ERR_MD_BAD_INPUT_DATA;
+}
+
+/*****************************************************
+ *   entropy / ctr_drbg                               *
+ ******************************************************/
+void mbedtls_entropy_init(mbedtls_entropy_context *ctx)
+{
+    ctx->initialized = 1;
+}
+
+void mbedtls_entropy_free(mbedtls_entropy_context *ctx)
+{
+    ctx->initialized = 0;
+}
+
+int mbedtls_entropy_func(void *data, unsigned char *output, size_t len)
+{
+    (void)data;
+    return RAND_bytes(output, (int)len) == 1 ? 0 : MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED;
+}
+
+void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context *ctx)
+{
+    ctx->seeded = 0;
+}
+
+void mbedtls_ctr_drbg_free(mbedtls_ctr_drbg_context *ctx)
+{
+    ctx->seeded = 0;
+}
+
+int mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context *ctx, int (*f_entropy)(void *, unsigned char *, size_t),
+                          void *p_entropy, const unsigned char *custom, size_t len)
+{
+    unsigned char probe[16];
+    (void)custom;
+    (void)len;
+
+    if (f_entropy(p_entropy, probe, sizeof(probe)) != 0)
+        return MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED;
+    ctx->seeded = 1;
+    return 0;
+}
+
+int mbedtls_ctr_drbg_random(void *p_rng, unsigned char *output, size_t output_len)
+{
+    (void)p_rng;
+    return RAND_bytes(output, (int)output_len) == 1 ? 0 : MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED;
+}
+
+/*****************************************************
+ *   pk                                               *
+ ******************************************************/
+void mbedtls_pk_init(mbedtls_pk_context *ctx)
+{
+    ctx->pkey = NULL;
+}
+
+void mbedtls_pk_free(mbedtls_pk_context *ctx)
+{
+    EVP_PKEY_free((EVP_PKEY *)ctx->pkey);
+    ctx->pkey = NULL;
+}
+
+/* Acepta PEM (con el '\0' final incluido en keylen, como MbedTLS) o DER */
+int mbedtls_pk_parse_key(mbedtls_pk_context *ctx, const unsigned char *key, size_t keylen, const unsigned char *pwd,
+                         size_t pwdlen, int (*f_rng)(void *, unsigned char *, size_t), void *p_rng)
+{
+    (void)pwd;
+    (void)pwdlen;
+    (void)f_rng;
+    (void)p_rng;
+
+    if (ctx->pkey != NULL)
+        return MBEDTLS_ERR_PK_BAD_INPUT_DATA;
+
+    if (keylen > 0 && key[keylen - 1] == '\0')
+    {
+        BIO *bio = BIO_new_mem_buf(key, (int)keylen - 1);
+        if (bio == NULL)
+            return MBEDTLS_ERR_PK_ALLOC_FAILED;
+        ctx->pkey = PEM_read_bio_PrivateKey(bio, NULL, NULL, NULL);
+        BIO_free(bio);
+    }
+    else
+    {
+        const unsigned char *p = key;
+        ctx->pkey = d2i_AutoPrivateKey(NULL, &p, (long)keylen);
+    }
+    ERR_clear_error();
+    return ctx->pkey != NULL ? 0 : MBEDTLS_ERR_PK_KEY_INVALID_FORMAT;
+}
+
+int mbedtls_pk_parse_public_key(mbedtls_pk_context *ctx, const unsigned char *key, size_t keylen)
+{
+    if (ctx->pkey != NULL)
+        return MBEDTLS_ERR_PK_BAD_INPUT_DATA;
+
+    if (keylen > 0 && key[keylen - 1] == '\0')
+    {
+        BIO *bio = BIO_new_mem_buf(key, (int)keylen - 1);
+        if (bio == NULL)
+            return MBEDTLS_ERR_PK_ALLOC_FAILED;
+        ctx->pkey = PEM_read_bio_PUBKEY(bio, NULL, NULL, NULL);
+        BIO_free(bio);
+    }
+    else
+    {
+        const unsigned char *p = key;
+        ctx->pkey = d2i_PUBKEY(NULL, &p, (long)keylen);
+    }
+    ERR_clear_error();
+    return ctx->pkey != NULL ? 0 : MBEDTLS_ERR_PK_INVALID_PUBKEY;
+}
+
+mbedtls_pk_type_t mbedtls_pk_get_type(const mbedtls_pk_context *ctx)
+{
+    if (ctx->pkey == NULL)
+        return MBEDTLS_PK_NONE;
+    switch (EVP_PKEY_get_base_id((EVP_PKEY *)ctx->pkey))
+    {
+    case EVP_PKEY_RSA:
+        return MBEDTLS_PK_RSA;
+    case EVP_PKEY_EC:
+        return MBEDTLS_PK_ECKEY;
+    default:
+        return MBEDTLS_PK_NONE;
+    }
+}
+
+/* RSA: PKCS#1 v1.5. EC: ECDSA con firma DER, igual que MbedTLS */
+static EVP_PKEY_CTX *new_signature_ctx(mbedtls_pk_context *ctx, mbedtls_md_type_t md_alg, int verify)
+{
+    if (ctx->pkey == NULL || md_alg != MBEDTLS_MD_SHA256)
+        return NULL;
+
+    EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new((EVP_PKEY *)ctx->pkey, NULL);
+    if (pctx == NULL)
+        return NULL;
+    int rc = verify ? EVP_PKEY_verify_init(pctx) : EVP_PKEY_sign_init(pctx);
+    if (rc == 1 && mbedtls_pk_get_type(ctx) == MBEDTLS_PK_RSA)
+        rc = EVP_PKEY_CTX_set_rsa_padding(pctx, RSA_PKCS1_PADDING);
+    if (rc == 1)
+        rc = EVP_PKEY_CTX_set_signature_md(pctx, EVP_sha256());
+    if (rc != 1)
+    {
+        EVP_PKEY_CTX_free(pctx);
+        return NULL;
+    }
+    return pctx;
+}
+
+int mbedtls_pk_sign(mbedtls_pk_context *ctx, mbedtls_md_type_t md_alg, const unsigned char *hash, size_t hash_len,
+                    unsigned char *sig, size_t sig_size, size_t *sig_len,
+                    int (*f_rng)(void *, unsigned char *, size_t), void *p_rng)
+{
+    (void)f_rng;
+    (void)p_rng;
+
+    EVP_PKEY_CTX *pctx = new_signature_ctx(ctx, md_alg, 0);
+    if (pctx == NULL)
+        return MBEDTLS_ERR_PK_BAD_INPUT_DATA;
+
+    size_t len = 0;
+    int rc = EVP_PKEY_sign(pctx, NULL, &len, hash, hash_len);
+    if (rc == 1 && len > sig_size)
+        rc = -2;
+    if (rc == 1)
+        rc = EVP_PKEY_sign(pctx, sig, &len, hash, hash_len);
+    EVP_PKEY_CTX_free(pctx);
+    ERR_clear_error();
+
+    if (rc == -2)
+        return MBEDTLS_ERR_PK_BUFFER_TOO_SMALL;
+    if (rc != 1)
+        return MBEDTLS_ERR_PK_BAD_INPUT_DATA;
+    *sig_len = len;
+    return 0;
+}
+
+int mbedtls_pk_verify(mbedtls_pk_context *ctx, mbedtls_md_type_t md_alg, const unsigned char *hash, size_t hash_len,
+                      const unsigned char *sig, size_t sig_len)
+{
+    EVP_PKEY_CTX *pctx = new_signature_ctx(ctx, md_alg, 1);
+    if (pctx == NULL)
+        return MBEDTLS_ERR_PK_BAD_INPUT_DATA;
+
+    int rc = EVP_PKEY_verify(pctx, sig, sig_len, hash, hash_len);
+    EVP_PKEY_CTX_free(pctx);
+    ERR_clear_error();
+    return rc == 1 ? 0 : MBEDTLS_ERR_RSA_VERIFY_FAILED;
+}
+
+/*****************************************************
+ *   error                                            *
+ ******************************************************/
+void mbedtls_strerror(int errnum, char *buffer, size_t buflen)
+{
+    const char *text;
+
+    switch (errnum)
+    {
+    case MBEDTLS_ERR_PK_KEY_INVALID_FORMAT:
+        text = "PK - Invalid key tag or value";
+        break;
+    case MBEDTLS_ERR_PK_INVALID_PUBKEY:
+        text = "PK - The pubkey tag or value is invalid";
+        break;
+    case MBEDTLS_ERR_PK_BUFFER_TOO_SMALL:
+        text = "PK - The output buffer is too small";
+        break;
+    case MBEDTLS_ERR_RSA_VERIFY_FAILED:
+        text = "RSA - The PKCS#1 verification failed";
+        break;
+    case MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED:
+        text = "CTR_DRBG - The entropy source failed";
+        break;
+    default:
+        text = "Bad input parameters or OpenSSL error";
+        break;
+    }
+    snprintf(buffer, buflen, "%s", text);
+}
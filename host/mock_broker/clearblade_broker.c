@@ -0,0 +1,1371 @@
+/*
+ * clearblade_broker.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Broker MQTT local que se comporta como el de Clearblade IoT Core para
+ *  medir el camino completo de autenticacion y publicacion sin salir a
+ *  us-central1-mqtt.clearblade.com:
+ *
+ *   - El client ID debe tener la forma que arma clearblade_client_set_data():
+ *     projects/<proyecto>/locations/<region>/registries/<registro>/devices/<id>.
+ *   - El password es un JWT RS256 o ES256 firmado con la clave del
+ *     dispositivo; se verifica la firma, aud (= proyecto), iat y exp (vida
+ *     maxima de 24 h, con tolerancia de reloj).
+ *   - Un dispositivo solo publica en /devices/<id>/events[/...] y
+ *     /devices/<id>/state, y solo se suscribe a /devices/<id>/config y
+ *     /devices/<id>/commands[/...]. Publicar fuera de eso cierra la conexion,
+ *     igual que Clearblade; una suscripcion no permitida recibe 0x80.
+ *   - Un segundo CONNECT del mismo dispositivo cierra la sesion anterior.
+ *   - Con --quota-msgs / --quota-bytes, un dispositivo que supera esa tasa
+ *     de publicacion (mensajes o bytes de topic + payload por segundo,
+ *     con hasta un segundo de rafaga) es desconectado, como Clearblade.
+ *   - Con --seq-check sigue los numeros de secuencia ("seq") de cada
+ *     dispositivo entre conexiones y reporta faltantes y duplicados
+ *     (seq_tracker.h), por ejemplo los reenvios QoS 1 tras una caida.
+ *   - Los payloads comprimidos (payload_codec.h) se decodifican antes de
+ *     buscar "seq"; el JSON de --out cuenta cuantos llegaron y su largo
+ *     original.
+ *
+ *  Es un solo hilo con un loop epoll. Por cada conexion mide aceptacion ->
+ *  CONNECT, verificacion del JWT, CONNECT -> CONNACK y CONNACK -> primer
+ *  PUBLISH; los percentiles van al JSON de --out y, con --conn-log, una
+ *  linea CSV por conexion cerrada.
+ *
+ *  Uso: clearblade_broker [--listen [host:]puerto] [--key clave.pem|none]
+ *                         [--device id=clave.pem]... [--project P]
+ *                         [--region R] [--registry R] [--clock-skew S]
+ *                         [--config texto] [--quota-msgs N] [--quota-bytes N]
+ *                         [--seq-check] [--duration S] [--report-s S]
+ *                         [--conn-log archivo.csv] [--out archivo.json]
+ *
+ *  Las claves pueden ser publicas o privadas (PEM). Sin --key se usa la
+ *  clave embebida del conector (device.key), la misma con la que firman
+ *  fleet_sim y fault_runner.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/md.h>
+#include <mbedtls/pk.h>
+
+#include "base64url.h"
+#include "certs.h"
+#include "clearblade_connect.h"
+
+#include "latency_histogram.h"
+#include "mqtt_wire.h"
+#include "payload_codec.h"
+#include "seq_tracker.h"
+
+#define BROKER_DEFAULT_LISTEN "127.0.0.1:1883"
+#define BROKER_DEFAULT_OUT "broker_results.json"
+#define BROKER_EPOLL_EVENTS 256
+#define BROKER_READ_CHUNK 4096
+#define BROKER_MAX_PACKET (256 * 1024)    // Limite de Clearblade para un mensaje
+#define BROKER_CONNECT_TIMEOUT_US (10 * 1000000LL)
+#define BROKER_DEVICE_ID_MAX_LEN 128
+#define BROKER_CLIENT_ID_MAX_LEN 512
+#define BROKER_JWT_MAX_LEN 2048
+#define BROKER_JWT_MAX_LIFETIME_S (24 * 3600)
+#define BROKER_HASH_BUCKETS 65536
+
+/* Motivos de rechazo de un CONNECT */
+typedef enum
+{
+    REJECT_PROTOCOL = 0,
+    REJECT_CLIENT_ID,
+    REJECT_REGISTRY,
+    REJECT_UNKNOWN_DEVICE,
+    REJECT_NO_PASSWORD,
+    REJECT_JWT_FORMAT,
+    REJECT_ALG,
+    REJECT_SIGNATURE,
+    REJECT_AUDIENCE,
+    REJECT_IAT,
+    REJECT_EXPIRED,
+    REJECT_LIFETIME,
+    REJECT_COUNT,
+} reject_reason_t;
+
+static const char *const reject_names[REJECT_COUNT] = {
+    [REJECT_PROTOCOL] = "protocol",
+    [REJECT_CLIENT_ID] = "client_id",
+    [REJECT_REGISTRY] = "registry",
+    [REJECT_UNKNOWN_DEVICE] = "unknown_device",
+    [REJECT_NO_PASSWORD] = "no_password",
+    [REJECT_JWT_FORMAT] = "jwt_format",
+    [REJECT_ALG] = "alg",
+    [REJECT_SIGNATURE] = "signature",
+    [REJECT_AUDIENCE] = "audience",
+    [REJECT_IAT] = "iat",
+    [REJECT_EXPIRED] = "expired",
+    [REJECT_LIFETIME] = "lifetime",
+};
+
+/* Motivos de cierre de una conexion */
+typedef enum
+{
+    CLOSE_PEER = 0,
+    CLOSE_DISCONNECT,
+    CLOSE_PROTOCOL,
+    CLOSE_REJECTED,
+    CLOSE_PUBLISH_ACL,
+    CLOSE_QUOTA,
+    CLOSE_QOS2,
+    CLOSE_KEEPALIVE,
+    CLOSE_CONNECT_TIMEOUT,
+    CLOSE_REPLACED,
+    CLOSE_SHUTDOWN,
+    CLOSE_COUNT,
+} close_reason_t;
+
+static const char *const close_names[CLOSE_COUNT] = {
+    [CLOSE_PEER] = "peer_closed",
+    [CLOSE_DISCONNECT] = "disconnect",
+    [CLOSE_PROTOCOL] = "protocol_error",
+    [CLOSE_REJECTED] = "rejected",
+    [CLOSE_PUBLISH_ACL] = "publish_acl",
+    [CLOSE_QUOTA] = "quota",
+    [CLOSE_QOS2] = "qos2",
+    [CLOSE_KEEPALIVE] = "keepalive",
+    [CLOSE_CONNECT_TIMEOUT] = "connect_timeout",
+    [CLOSE_REPLACED] = "replaced",
+    [CLOSE_SHUTDOWN] = "shutdown",
+};
+
+typedef struct
+{
+    int fd;
+    bool authenticated;
+    bool want_write;
+    uint8_t connack_code;
+    uint16_t keepalive;
+    int next_same_device; // Siguiente fd del mismo bucket, -1 al final
+
+    uint8_t *rx;
+    size_t rx_len;
+    size_t rx_cap;
+    uint8_t *tx;
+    size_t tx_len;
+    size_t tx_cap;
+
+    char device_id[BROKER_DEVICE_ID_MAX_LEN + 1];
+
+    // Tiempos (us monotonicos desde el arranque del broker)
+    int64_t accept_us;
+    int64_t connect_us;
+    int64_t connack_us;
+    int64_t first_publish_us;
+    int64_t last_rx_us;
+    int64_t verify_us;
+
+    uint32_t publishes;
+    uint32_t subscribes;
+    uint64_t payload_bytes;
+
+    // Cuota de publicacion: baldes de hasta un segundo de tasa
+    double quota_msgs;
+    double quota_bytes;
+    int64_t quota_refill_us;
+} broker_conn_t;
+
+typedef struct
+{
+    char device_id[BROKER_DEVICE_ID_MAX_LEN + 1];
+    mbedtls_pk_context pk;
+} device_key_t;
+
+static struct
+{
+    const char *listen_text;
+    const char *key_path;
+    const char *project;
+    const char *region;
+    const char *registry;
+    const char *config_payload;
+    const char *conn_log_path;
+    const char *out_path;
+    uint32_t clock_skew_s;
+    uint32_t quota_msgs;
+    uint32_t quota_bytes;
+    uint32_t duration_s;
+    uint32_t report_s;
+    bool verbose;
+    bool seq_check;
+} options = {
+    .listen_text = BROKER_DEFAULT_LISTEN,
+    .clock_skew_s = 600,
+    .report_s = 5,
+    .out_path = BROKER_DEFAULT_OUT,
+};
+
+static struct
+{
+    uint64_t accepted;
+    uint64_t authenticated;
+    uint64_t rejected;
+    uint64_t rejects[REJECT_COUNT];
+    uint64_t closes[CLOSE_COUNT];
+    uint64_t open;
+    uint64_t peak_open;
+    uint64_t events;
+    uint64_t states;
+    uint64_t acked;
+    uint64_t payload_bytes;
+    uint64_t compressed;        // Payloads con PAYLOAD_CODEC_MARKER
+    uint64_t decoded_bytes;     // Largo original de esos payloads
+    uint64_t corrupt;           // Comprimidos que no se pudieron decodificar
+    uint64_t subscriptions_granted;
+    uint64_t subscriptions_denied;
+    uint64_t configs_sent;
+} stats;
+
+static struct
+{
+    latency_histogram_t accept_to_connect;
+    latency_histogram_t jwt_verify;
+    latency_histogram_t connect_to_connack;
+    latency_histogram_t connack_to_first_publish;
+    latency_histogram_t accept_to_first_publish;
+} timing;
+
+static volatile sig_atomic_t stop_requested = 0;
+static struct timespec start_time;
+static int epoll_fd = -1;
+static FILE *conn_log = NULL;
+
+static broker_conn_t **conns = NULL; // Indexado por fd
+static size_t conns_cap = 0;
+static int device_buckets[BROKER_HASH_BUCKETS];
+
+static seq_tracker_set_t seq_trackers;
+
+static device_key_t *device_keys = NULL;
+static size_t device_key_count = 0;
+static mbedtls_pk_context default_key;
+static bool has_default_key = false;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec - start_time.tv_sec) * 1000000LL + (ts.tv_nsec - start_time.tv_nsec) / 1000;
+}
+
+/*****************************************************
+ *   Claves de los dispositivos                       *
+ ******************************************************/
+static char *read_file(const char *path, size_t *len)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        perror(path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *data = size >= 0 ? malloc(size + 1) : NULL;
+    if (data == NULL || fread(data, 1, size, file) != (size_t)size)
+    {
+        fprintf(stderr, "%s: no se pudo leer\n", path);
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    data[size] = 0;
+    *len = size;
+    return data;
+}
+
+/* Acepta una clave publica o privada; de la privada solo se usa la parte publica */
+static int parse_key(mbedtls_pk_context *pk, const char *pem, size_t pem_len)
+{
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context ctr_drbg;
+
+    mbedtls_pk_init(pk);
+    // Como en createGCPJWTBuffer(): el largo del PEM incluye el '\0'
+    if (mbedtls_pk_parse_public_key(pk, (const unsigned char *)pem, pem_len + 1) == 0)
+        return 0;
+
+    mbedtls_pk_free(pk);
+    mbedtls_pk_init(pk);
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&ctr_drbg);
+    int rc = mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy, (const unsigned char *)"broker", 6);
+    if (rc == 0)
+        rc = mbedtls_pk_parse_key(pk, (const unsigned char *)pem, pem_len + 1, NULL, 0, mbedtls_ctr_drbg_random, &ctr_drbg);
+    mbedtls_ctr_drbg_free(&ctr_drbg);
+    mbedtls_entropy_free(&entropy);
+    if (rc == 0 && mbedtls_pk_get_type(pk) != MBEDTLS_PK_RSA && mbedtls_pk_get_type(pk) != MBEDTLS_PK_ECKEY)
+        rc = MBEDTLS_ERR_PK_TYPE_MISMATCH;
+    if (rc != 0)
+        mbedtls_pk_free(pk);
+    return rc;
+}
+
+static int load_key_file(mbedtls_pk_context *pk, const char *path)
+{
+    size_t len;
+    char *pem = read_file(path, &len);
+    if (pem == NULL)
+        return -1;
+    int rc = parse_key(pk, pem, len);
+    free(pem);
+    if (rc != 0)
+        fprintf(stderr, "%s: clave invalida (-0x%x)\n", path, -rc);
+    return rc;
+}
+
+/* --device id=clave.pem */
+static int add_device_key(const char *text)
+{
+    const char *equal = strchr(text, '=');
+    if (equal == NULL || equal == text || equal - text > BROKER_DEVICE_ID_MAX_LEN)
+        return -1;
+
+    device_key_t *keys = realloc(device_keys, (device_key_count + 1) * sizeof(*keys));
+    if (keys == NULL)
+        return -1;
+    device_keys = keys;
+    device_key_t *entry = &device_keys[device_key_count];
+    memcpy(entry->device_id, text, equal - text);
+    entry->device_id[equal - text] = 0;
+    if (load_key_file(&entry->pk, equal + 1) != 0)
+        return -1;
+    device_key_count++;
+    return 0;
+}
+
+static mbedtls_pk_context *find_device_key(const char *device_id)
+{
+    for (size_t i = 0; i < device_key_count; i++)
+        if (strcmp(device_keys[i].device_id, device_id) == 0)
+            return &device_keys[i].pk;
+    return has_default_key ? &default_key : NULL;
+}
+
+/*****************************************************
+ *   Client ID y JWT                                  *
+ ******************************************************/
+
+/* Separa projects/<p>/locations/<r>/registries/<g>/devices/<id> y lo vuelve a
+ * armar con clearblade_format_client_id(): el formato aceptado es el del conector */
+static int parse_client_id(const char *client_id, char parts[4][BROKER_DEVICE_ID_MAX_LEN + 1])
+{
+    static const char *const labels[4] = {"projects", "locations", "registries", "devices"};
+    const char *p = client_id;
+
+    for (int i = 0; i < 4; i++)
+    {
+        size_t label_len = strlen(labels[i]);
+        if (strncmp(p, labels[i], label_len) != 0 || p[label_len] != '/')
+            return -1;
+        p += label_len + 1;
+        const char *slash = strchr(p, '/');
+        size_t len = slash != NULL ? (size_t)(slash - p) : strlen(p);
+        if (len == 0 || len > BROKER_DEVICE_ID_MAX_LEN || (i < 3) != (slash != NULL))
+            return -1;
+        memcpy(parts[i], p, len);
+        parts[i][len] = 0;
+        p += len + (slash != NULL ? 1 : 0);
+    }
+
+    char rebuilt[BROKER_CLIENT_ID_MAX_LEN];
+    int len = clearblade_format_client_id(rebuilt, sizeof(rebuilt), parts[0], parts[1], parts[2], parts[3]);
+    return len > 0 && (size_t)len < sizeof(rebuilt) && strcmp(rebuilt, client_id) == 0 ? 0 : -1;
+}
+
+/* Decodifica un segmento base64url sin relleno; devuelve el largo o -1 */
+static int decode_segment(const char *in, size_t in_len, uint8_t *out, size_t out_len)
+{
+    if (in_len < 2 || in_len % 4 == 1 || BASE64_DECODE_OUT_SIZE(in_len) + 3 > out_len)
+        return -1;
+    if (base64url_decode(in, (unsigned int)in_len, out) != BASE64_OK)
+        return -1;
+    size_t len = in_len * 3 / 4;
+    out[len] = 0;
+    return (int)len;
+}
+
+/* Valor de una clave de un objeto JSON plano, o NULL */
+static const char *json_value(const char *json, const char *key)
+{
+    size_t key_len = strlen(key);
+    for (const char *p = strchr(json, '"'); p != NULL; p = strchr(p + 1, '"'))
+    {
+        if (strncmp(p + 1, key, key_len) != 0 || p[1 + key_len] != '"')
+            continue;
+        const char *v = p + 2 + key_len;
+        while (*v == ' ' || *v == '\t')
+            v++;
+        if (*v++ != ':')
+            continue;
+        while (*v == ' ' || *v == '\t')
+            v++;
+        return v;
+    }
+    return NULL;
+}
+
+static bool json_string_equals(const char *json, const char *key, const char *expected)
+{
+    const char *v = json_value(json, key);
+    size_t len = strlen(expected);
+    return v != NULL && v[0] == '"' && strncmp(v + 1, expected, len) == 0 && v[1 + len] == '"';
+}
+
+static bool json_int(const char *json, const char *key, int64_t *value)
+{
+    const char *v = json_value(json, key);
+    char *end;
+    if (v == NULL)
+        return false;
+    *value = strtoll(v, &end, 10);
+    return end != v;
+}
+
+/* Firma JWS ES256 (r || s) a la forma DER que espera mbedtls_pk_verify() */
+static size_t ecdsa_raw_to_der(const uint8_t *raw, size_t raw_len, uint8_t *der)
+{
+    size_t half = raw_len / 2;
+    size_t pos = 2;
+
+    for (int i = 0; i < 2; i++)
+    {
+        const uint8_t *n = raw + i * half;
+        size_t len = half;
+        while (len > 1 && *n == 0)
+        {
+            n++;
+            len--;
+        }
+        bool pad = (n[0] & 0x80) != 0;
+        der[pos++] = 0x02;
+        der[pos++] = (uint8_t)(len + pad);
+        if (pad)
+            der[pos++] = 0;
+        memcpy(der + pos, n, len);
+        pos += len;
+    }
+    der[0] = 0x30;
+    der[1] = (uint8_t)(pos - 2);
+    return pos;
+}
+
+static reject_reason_t verify_jwt(const char *token, size_t token_len, const char *project, mbedtls_pk_context *pk)
+{
+    uint8_t header[256];
+    uint8_t claims[512];
+    uint8_t signature[MBEDTLS_PK_SIGNATURE_MAX_SIZE + 4];
+    uint8_t der[80];
+
+    const char *dot1 = memchr(token, '.', token_len);
+    const char *dot2 = dot1 != NULL ? memchr(dot1 + 1, '.', token + token_len - dot1 - 1) : NULL;
+    if (dot2 == NULL || memchr(dot2 + 1, '.', token + token_len - dot2 - 1) != NULL)
+        return REJECT_JWT_FORMAT;
+    int header_len = decode_segment(token, dot1 - token, header, sizeof(header));
+    int claims_len = decode_segment(dot1 + 1, dot2 - dot1 - 1, claims, sizeof(claims));
+    int signature_len = decode_segment(dot2 + 1, token + token_len - dot2 - 1, signature, sizeof(signature));
+    if (header_len <= 0 || claims_len <= 0 || signature_len <= 0 ||
+        strlen((char *)header) != (size_t)header_len || strlen((char *)claims) != (size_t)claims_len)
+        return REJECT_JWT_FORMAT;
+
+    mbedtls_pk_type_t key_type = mbedtls_pk_get_type(pk);
+    bool es256 = json_string_equals((char *)header, "alg", "ES256");
+    if (es256 ? key_type != MBEDTLS_PK_ECKEY || signature_len != 64
+              : key_type != MBEDTLS_PK_RSA || !json_string_equals((char *)header, "alg", "RS256"))
+        return REJECT_ALG;
+
+    // Los reclamos se revisan antes que la firma, que es lo caro
+    int64_t iat, exp;
+    int64_t now = time(NULL);
+    if (!json_string_equals((char *)claims, "aud", project))
+        return REJECT_AUDIENCE;
+    if (!json_int((char *)claims, "iat", &iat) || !json_int((char *)claims, "exp", &exp))
+        return REJECT_JWT_FORMAT;
+    if (iat > now + options.clock_skew_s)
+        return REJECT_IAT;
+    if (exp <= now - (int64_t)options.clock_skew_s)
+        return REJECT_EXPIRED;
+    if (exp <= iat || exp - iat > BROKER_JWT_MAX_LIFETIME_S)
+        return REJECT_LIFETIME;
+
+    uint8_t digest[32];
+    if (mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), (const unsigned char *)token, dot2 - token, digest) != 0)
+        return REJECT_SIGNATURE;
+    const uint8_t *sig = signature;
+    size_t sig_len = signature_len;
+    if (es256)
+    {
+        sig_len = ecdsa_raw_to_der(signature, signature_len, der);
+        sig = der;
+    }
+    if (mbedtls_pk_verify(pk, MBEDTLS_MD_SHA256, digest, sizeof(digest), sig, sig_len) != 0)
+        return REJECT_SIGNATURE;
+    return REJECT_COUNT; // Aceptado
+}
+
+/*****************************************************
+ *   Sesiones por dispositivo                         *
+ ******************************************************/
+static uint32_t device_hash(const char *device_id)
+{
+    uint32_t hash = 2166136261u; // FNV-1a
+    while (*device_id)
+        hash = (hash ^ (uint8_t)*device_id++) * 16777619u;
+    return hash % BROKER_HASH_BUCKETS;
+}
+
+static broker_conn_t *find_session(const char *device_id)
+{
+    for (int fd = device_buckets[device_hash(device_id)]; fd >= 0; fd = conns[fd]->next_same_device)
+        if (strcmp(conns[fd]->device_id, device_id) == 0)
+            return conns[fd];
+    return NULL;
+}
+
+static void add_session(broker_conn_t *conn)
+{
+    uint32_t bucket = device_hash(conn->device_id);
+    conn->next_same_device = device_buckets[bucket];
+    device_buckets[bucket] = conn->fd;
+}
+
+static void remove_session(broker_conn_t *conn)
+{
+    int *link = &device_buckets[device_hash(conn->device_id)];
+    while (*link >= 0 && *link != conn->fd)
+        link = &conns[*link]->next_same_device;
+    if (*link == conn->fd)
+        *link = conn->next_same_device;
+}
+
+/*****************************************************
+ *   Conexiones                                       *
+ ******************************************************/
+static void log_connection(const broker_conn_t *conn, close_reason_t reason)
+{
+    if (conn_log == NULL)
+        return;
+    int64_t end_us = now_us();
+    fprintf(conn_log, "%s,%d,%s,%lld,%lld,%lld,%lld,%lld,%u,%llu,%lld\n", conn->device_id,
+            conn->connect_us > 0 ? conn->connack_code : -1, close_names[reason],
+            conn->connect_us > 0 ? (long long)(conn->connect_us - conn->accept_us) : -1LL,
+            conn->verify_us > 0 ? (long long)conn->verify_us : -1LL,
+            conn->connack_us > 0 ? (long long)(conn->connack_us - conn->connect_us) : -1LL,
+            conn->first_publish_us > 0 ? (long long)(conn->first_publish_us - conn->connack_us) : -1LL,
+            conn->first_publish_us > 0 ? (long long)(conn->first_publish_us - conn->accept_us) : -1LL,
+            conn->publishes, (unsigned long long)conn->payload_bytes, (long long)((end_us - conn->accept_us) / 1000));
+}
+
+static void close_conn(broker_conn_t *conn, close_reason_t reason)
+{
+    log_connection(conn, reason);
+    stats.closes[reason]++;
+    stats.open--;
+    if (conn->authenticated)
+        remove_session(conn);
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    conns[conn->fd] = NULL;
+    free(conn->rx);
+    free(conn->tx);
+    free(conn);
+}
+
+static int ensure_capacity(uint8_t **buffer, size_t *cap, size_t needed)
+{
+    if (needed <= *cap)
+        return 0;
+    size_t new_cap = *cap > 0 ? *cap : 256;
+    while (new_cap < needed)
+        new_cap *= 2;
+    uint8_t *grown = realloc(*buffer, new_cap);
+    if (grown == NULL)
+        return -1;
+    *buffer = grown;
+    *cap = new_cap;
+    return 0;
+}
+
+static void update_epoll(broker_conn_t *conn, bool want_write)
+{
+    if (conn->want_write == want_write)
+        return;
+    struct epoll_event event = {.events = EPOLLIN | (want_write ? EPOLLOUT : 0), .data.fd = conn->fd};
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+    conn->want_write = want_write;
+}
+
+static int flush_tx(broker_conn_t *conn)
+{
+    size_t sent = 0;
+    while (sent < conn->tx_len)
+    {
+        ssize_t n = send(conn->fd, conn->tx + sent, conn->tx_len - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n <= 0)
+            return -1;
+        sent += n;
+    }
+    memmove(conn->tx, conn->tx + sent, conn->tx_len - sent);
+    conn->tx_len -= sent;
+    update_epoll(conn, conn->tx_len > 0);
+    return 0;
+}
+
+/* Encola y trata de enviar; lo que no sale queda para EPOLLOUT */
+static int conn_send(broker_conn_t *conn, const uint8_t *data, size_t len)
+{
+    if (len == 0 || ensure_capacity(&conn->tx, &conn->tx_cap, conn->tx_len + len) != 0)
+        return -1;
+    memcpy(conn->tx + conn->tx_len, data, len);
+    conn->tx_len += len;
+    return flush_tx(conn);
+}
+
+static void reject(broker_conn_t *conn, reject_reason_t reason, uint8_t code)
+{
+    uint8_t packet[4];
+
+    stats.rejected++;
+    stats.rejects[reason]++;
+    conn->connack_code = code;
+    conn->connack_us = now_us();
+    latency_histogram_record(&timing.connect_to_connack, conn->connack_us - conn->connect_us);
+    conn_send(conn, packet, mqtt_wire_connack(packet, sizeof(packet), code));
+    if (options.verbose)
+        fprintf(stderr, "rechazado %s: %s (CONNACK %u)\n", conn->device_id[0] ? conn->device_id : "?", reject_names[reason], code);
+}
+
+/*****************************************************
+ *   Paquetes                                         *
+ ******************************************************/
+static int handle_connect(broker_conn_t *conn, const mqtt_packet_t *packet)
+{
+    mqtt_connect_t connect;
+    char client_id[BROKER_CLIENT_ID_MAX_LEN];
+    char parts[4][BROKER_DEVICE_ID_MAX_LEN + 1];
+    char token[BROKER_JWT_MAX_LEN];
+
+    conn->connect_us = now_us();
+    latency_histogram_record(&timing.accept_to_connect, conn->connect_us - conn->accept_us);
+    if (mqtt_wire_parse_connect(packet, &connect) != 0)
+    {
+        // No es MQTT 3.1.1: se corta sin CONNACK, como indica la norma
+        stats.rejected++;
+        stats.rejects[REJECT_PROTOCOL]++;
+        return -1;
+    }
+    conn->keepalive = connect.keepalive;
+
+    if (connect.client_id_len >= sizeof(client_id))
+    {
+        reject(conn, REJECT_CLIENT_ID, MQTT_CONNACK_ID_REJECTED);
+        return -1;
+    }
+    memcpy(client_id, connect.client_id, connect.client_id_len);
+    client_id[connect.client_id_len] = 0;
+    if (parse_client_id(client_id, parts) != 0)
+    {
+        reject(conn, REJECT_CLIENT_ID, MQTT_CONNACK_ID_REJECTED);
+        return -1;
+    }
+    strcpy(conn->device_id, parts[3]);
+    if ((options.project != NULL && strcmp(parts[0], options.project) != 0) ||
+        (options.region != NULL && strcmp(parts[1], options.region) != 0) ||
+        (options.registry != NULL && strcmp(parts[2], options.registry) != 0))
+    {
+        reject(conn, REJECT_REGISTRY, MQTT_CONNACK_NOT_AUTHORIZED);
+        return -1;
+    }
+    mbedtls_pk_context *pk = find_device_key(conn->device_id);
+    if (pk == NULL)
+    {
+        reject(conn, REJECT_UNKNOWN_DEVICE, MQTT_CONNACK_NOT_AUTHORIZED);
+        return -1;
+    }
+    if (connect.password == NULL || connect.password_len == 0)
+    {
+        reject(conn, REJECT_NO_PASSWORD, MQTT_CONNACK_BAD_CREDENTIALS);
+        return -1;
+    }
+    if (connect.password_len >= sizeof(token))
+    {
+        reject(conn, REJECT_JWT_FORMAT, MQTT_CONNACK_BAD_CREDENTIALS);
+        return -1;
+    }
+    memcpy(token, connect.password, connect.password_len);
+    token[connect.password_len] = 0;
+
+    int64_t verify_start_us = now_us();
+    reject_reason_t reason = verify_jwt(token, connect.password_len, parts[0], pk);
+    conn->verify_us = now_us() - verify_start_us;
+    latency_histogram_record(&timing.jwt_verify, conn->verify_us);
+    if (reason != REJECT_COUNT)
+    {
+        reject(conn, reason, MQTT_CONNACK_BAD_CREDENTIALS);
+        return -1;
+    }
+
+    broker_conn_t *previous = find_session(conn->device_id);
+    if (previous != NULL)
+        close_conn(previous, CLOSE_REPLACED);
+    conn->authenticated = true;
+    add_session(conn);
+    stats.authenticated++;
+
+    uint8_t packet_out[4];
+    conn->connack_code = MQTT_CONNACK_ACCEPTED;
+    conn->connack_us = now_us();
+    latency_histogram_record(&timing.connect_to_connack, conn->connack_us - conn->connect_us);
+    return conn_send(conn, packet_out, mqtt_wire_connack(packet_out, sizeof(packet_out), MQTT_CONNACK_ACCEPTED));
+}
+
+/* Topic /devices/<id>/<subtopic> exacto, o seguido de '/' si se aceptan subcarpetas */
+static bool topic_allowed(const char *topic, size_t topic_len, const char *device_id, const char *subtopic, bool subfolders)
+{
+    char prefix[BROKER_DEVICE_ID_MAX_LEN + 32];
+    size_t len = (size_t)clearblade_format_topic(prefix, sizeof(prefix), device_id, subtopic);
+
+    if (topic_len < len || memcmp(topic, prefix, len) != 0)
+        return false;
+    return topic_len == len || (subfolders && topic[len] == '/' && topic_len > len + 1);
+}
+
+/* Descuenta la publicacion de los baldes; false si el dispositivo supero su cuota */
+static bool quota_consume(broker_conn_t *conn, size_t bytes)
+{
+    int64_t now = now_us();
+    if (conn->quota_refill_us == 0)
+    {
+        conn->quota_msgs = options.quota_msgs;
+        conn->quota_bytes = options.quota_bytes;
+    }
+    else
+    {
+        double elapsed_s = (now - conn->quota_refill_us) / 1e6;
+        conn->quota_msgs += elapsed_s * options.quota_msgs;
+        conn->quota_bytes += elapsed_s * options.quota_bytes;
+        if (conn->quota_msgs > options.quota_msgs)
+            conn->quota_msgs = options.quota_msgs;
+        if (conn->quota_bytes > options.quota_bytes)
+            conn->quota_bytes = options.quota_bytes;
+    }
+    conn->quota_refill_us = now;
+
+    conn->quota_msgs -= 1;
+    conn->quota_bytes -= bytes;
+    return (options.quota_msgs == 0 || conn->quota_msgs >= 0) && (options.quota_bytes == 0 || conn->quota_bytes >= 0);
+}
+
+static int handle_publish(broker_conn_t *conn, const mqtt_packet_t *packet)
+{
+    mqtt_publish_t publish;
+
+    if (mqtt_wire_parse_publish(packet, &publish) != 0)
+        return CLOSE_PROTOCOL;
+    if (publish.qos > 1)
+        return CLOSE_QOS2;
+    if (topic_allowed(publish.topic, publish.topic_len, conn->device_id, "events", true))
+        stats.events++;
+    else if (topic_allowed(publish.topic, publish.topic_len, conn->device_id, "state", false))
+        stats.states++;
+    else
+    {
+        if (options.verbose)
+            fprintf(stderr, "%s: publicacion no permitida en %.*s\n", conn->device_id, publish.topic_len, publish.topic);
+        return CLOSE_PUBLISH_ACL;
+    }
+    if (!quota_consume(conn, publish.topic_len + publish.payload_len))
+    {
+        if (options.verbose)
+            fprintf(stderr, "%s: cuota de publicacion superada\n", conn->device_id);
+        return CLOSE_QUOTA;
+    }
+
+    if (conn->first_publish_us == 0)
+    {
+        conn->first_publish_us = now_us();
+        latency_histogram_record(&timing.connack_to_first_publish, conn->first_publish_us - conn->connack_us);
+        latency_histogram_record(&timing.accept_to_first_publish, conn->first_publish_us - conn->accept_us);
+    }
+
+    // Un lote comprimido por telemetry_dispatch se decodifica como lo haria el backend
+    const uint8_t *payload = publish.payload;
+    size_t payload_len = publish.payload_len;
+    if (payload_codec_is_encoded(payload, payload_len))
+    {
+        static uint8_t decoded[PAYLOAD_CODEC_MAX_INPUT];
+        int decoded_len = payload_codec_decompress(payload, payload_len, decoded, sizeof(decoded));
+        stats.compressed++;
+        if (decoded_len < 0)
+        {
+            stats.corrupt++;
+            if (options.verbose)
+                fprintf(stderr, "%s: payload comprimido corrupto\n", conn->device_id);
+            payload_len = 0;
+        }
+        else
+        {
+            stats.decoded_bytes += decoded_len;
+            payload = decoded;
+            payload_len = decoded_len;
+        }
+    }
+    if (options.seq_check)
+    {
+        seq_tracker_t *tracker = seq_tracker_set_get(&seq_trackers, conn->device_id, strlen(conn->device_id));
+        size_t offset = 0;
+        uint64_t seq;
+        bool resync;
+        while (tracker != NULL && seq_tracker_parse((const char *)payload, payload_len, &offset, &seq, &resync) == 1)
+            seq_tracker_add(tracker, seq, resync);
+    }
+    conn->publishes++;
+    conn->payload_bytes += publish.payload_len;
+    stats.payload_bytes += publish.payload_len;
+
+    if (publish.qos == 1)
+    {
+        uint8_t ack[4];
+        stats.acked++;
+        if (conn_send(conn, ack, mqtt_wire_puback(ack, sizeof(ack), publish.packet_id)) != 0)
+            return CLOSE_PEER;
+    }
+    return -1;
+}
+
+static int handle_subscribe(broker_conn_t *conn, const mqtt_packet_t *packet)
+{
+    mqtt_subscription_t subscription;
+    uint8_t codes[64];
+    size_t count = 0;
+    size_t offset = 0;
+    uint16_t packet_id;
+    bool send_config = false;
+    int rc;
+
+    while ((rc = mqtt_wire_parse_subscribe(packet, &packet_id, &offset, &subscription)) == 1)
+    {
+        if (count == sizeof(codes))
+            return CLOSE_PROTOCOL;
+        bool config = topic_allowed(subscription.topic, subscription.topic_len, conn->device_id, "config", false);
+        if (config || topic_allowed(subscription.topic, subscription.topic_len, conn->device_id, "commands", true))
+        {
+            codes[count++] = subscription.qos > 1 ? 1 : subscription.qos;
+            stats.subscriptions_granted++;
+            send_config |= config;
+        }
+        else
+        {
+            codes[count++] = 0x80;
+            stats.subscriptions_denied++;
+        }
+    }
+    if (rc < 0)
+        return CLOSE_PROTOCOL;
+
+    uint8_t suback[4 + sizeof(codes)];
+    conn->subscribes++;
+    if (conn_send(conn, suback, mqtt_wire_suback_codes(suback, sizeof(suback), packet_id, codes, count)) != 0)
+        return CLOSE_PEER;
+
+    // Clearblade entrega la ultima configuracion al suscribirse a /config
+    if (send_config && options.config_payload != NULL)
+    {
+        char topic[BROKER_DEVICE_ID_MAX_LEN + 32];
+        uint8_t message[1024];
+        clearblade_format_topic(topic, sizeof(topic), conn->device_id, "config");
+        size_t len = mqtt_wire_publish(message, sizeof(message), topic, options.config_payload,
+                                       strlen(options.config_payload), 0, 0);
+        if (len > 0)
+        {
+            stats.configs_sent++;
+            if (conn_send(conn, message, len) != 0)
+                return CLOSE_PEER;
+        }
+    }
+    return -1;
+}
+
+/* Devuelve -1 si la conexion sigue abierta, o el motivo para cerrarla */
+static int handle_packet(broker_conn_t *conn, const mqtt_packet_t *packet)
+{
+    uint8_t reply[4];
+    uint16_t packet_id;
+
+    if (!conn->authenticated)
+    {
+        if (packet->type != MQTT_PACKET_CONNECT || conn->connect_us != 0)
+            return CLOSE_PROTOCOL;
+        return handle_connect(conn, packet) == 0 ? -1 : CLOSE_REJECTED;
+    }
+
+    switch (packet->type)
+    {
+    case MQTT_PACKET_PUBLISH:
+        return handle_publish(conn, packet);
+    case MQTT_PACKET_SUBSCRIBE:
+        return handle_subscribe(conn, packet);
+    case MQTT_PACKET_UNSUBSCRIBE:
+        if (mqtt_wire_parse_packet_id(packet, &packet_id) != 0)
+            return CLOSE_PROTOCOL;
+        return conn_send(conn, reply, mqtt_wire_unsuback(reply, sizeof(reply), packet_id)) == 0 ? -1 : CLOSE_PEER;
+    case MQTT_PACKET_PUBACK:
+        return -1; // Config o comandos QoS 1: no se reintentan
+    case MQTT_PACKET_PINGREQ:
+        return conn_send(conn, reply, mqtt_wire_simple(reply, sizeof(reply), MQTT_PACKET_PINGRESP)) == 0 ? -1 : CLOSE_PEER;
+    case MQTT_PACKET_DISCONNECT:
+        return CLOSE_DISCONNECT;
+    default:
+        return CLOSE_PROTOCOL;
+    }
+}
+
+static void handle_readable(broker_conn_t *conn)
+{
+    for (;;)
+    {
+        if (ensure_capacity(&conn->rx, &conn->rx_cap, conn->rx_len + BROKER_READ_CHUNK) != 0)
+        {
+            close_conn(conn, CLOSE_PROTOCOL);
+            return;
+        }
+        ssize_t n = recv(conn->fd, conn->rx + conn->rx_len, conn->rx_cap - conn->rx_len, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n <= 0)
+        {
+            close_conn(conn, CLOSE_PEER);
+            return;
+        }
+        conn->rx_len += n;
+        conn->last_rx_us = now_us();
+
+        size_t consumed = 0;
+        mqtt_packet_t packet;
+        int rc;
+        while ((rc = mqtt_wire_parse(conn->rx + consumed, conn->rx_len - consumed, &packet)) == 1)
+        {
+            consumed += packet.length;
+            int reason = handle_packet(conn, &packet);
+            if (reason >= 0)
+            {
+                close_conn(conn, (close_reason_t)reason);
+                return;
+            }
+        }
+        if (rc < 0 || conn->rx_len - consumed > BROKER_MAX_PACKET)
+        {
+            close_conn(conn, CLOSE_PROTOCOL);
+            return;
+        }
+        memmove(conn->rx, conn->rx + consumed, conn->rx_len - consumed);
+        conn->rx_len -= consumed;
+    }
+}
+
+static void accept_connections(int listen_fd)
+{
+    for (;;)
+    {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                perror("accept");
+            return;
+        }
+        if ((size_t)fd >= conns_cap)
+        {
+            size_t new_cap = conns_cap > 0 ? conns_cap : 1024;
+            while (new_cap <= (size_t)fd)
+                new_cap *= 2;
+            broker_conn_t **grown = realloc(conns, new_cap * sizeof(*conns));
+            if (grown == NULL)
+            {
+                close(fd);
+                continue;
+            }
+            memset(grown + conns_cap, 0, (new_cap - conns_cap) * sizeof(*conns));
+            conns = grown;
+            conns_cap = new_cap;
+        }
+        broker_conn_t *conn = calloc(1, sizeof(*conn));
+        if (conn == NULL)
+        {
+            close(fd);
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        conn->fd = fd;
+        conn->next_same_device = -1;
+        conn->accept_us = now_us();
+        conn->last_rx_us = conn->accept_us;
+        conns[fd] = conn;
+
+        struct epoll_event event = {.events = EPOLLIN, .data.fd = fd};
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+        stats.accepted++;
+        if (++stats.open > stats.peak_open)
+            stats.peak_open = stats.open;
+    }
+}
+
+/* Cierra las conexiones sin CONNECT a tiempo y las que superan 1,5 x keepalive */
+static void check_timeouts(void)
+{
+    int64_t now = now_us();
+    for (size_t fd = 0; fd < conns_cap; fd++)
+    {
+        broker_conn_t *conn = conns[fd];
+        if (conn == NULL)
+            continue;
+        if (!conn->authenticated && conn->connect_us == 0 && now - conn->accept_us > BROKER_CONNECT_TIMEOUT_US)
+            close_conn(conn, CLOSE_CONNECT_TIMEOUT);
+        else if (conn->authenticated && conn->keepalive > 0 && now - conn->last_rx_us > conn->keepalive * 1500000LL)
+            close_conn(conn, CLOSE_KEEPALIVE);
+    }
+}
+
+/*****************************************************
+ *   Resultados                                       *
+ ******************************************************/
+static void write_timing(FILE *out, const char *name, const latency_histogram_t *histogram, bool last)
+{
+    fprintf(out, "    \"%s\": {\"count\": %llu, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"max\": %llu, \"mean\": %.1f}%s\n", name,
+            (unsigned long long)histogram->count, (unsigned long long)latency_histogram_percentile(histogram, 50),
+            (unsigned long long)latency_histogram_percentile(histogram, 90),
+            (unsigned long long)latency_histogram_percentile(histogram, 99), (unsigned long long)histogram->max_us,
+            histogram->count > 0 ? (double)histogram->sum_us / histogram->count : 0.0, last ? "" : ",");
+}
+
+static void write_results(double elapsed_s)
+{
+    FILE *out = fopen(options.out_path, "w");
+    if (out == NULL)
+    {
+        perror(options.out_path);
+        return;
+    }
+    fprintf(out, "{\n  \"broker\": {\"listen\": \"%s\", \"key\": \"%s\", \"devices_registered\": %zu, \"elapsed_s\": %.3f},\n",
+            options.listen_text, options.key_path != NULL ? options.key_path : "device.key", device_key_count, elapsed_s);
+    fprintf(out, "  \"connections\": {\"accepted\": %llu, \"authenticated\": %llu, \"rejected\": %llu, \"peak_open\": %llu},\n",
+            (unsigned long long)stats.accepted, (unsigned long long)stats.authenticated, (unsigned long long)stats.rejected,
+            (unsigned long long)stats.peak_open);
+    fprintf(out, "  \"rejects\": {");
+    for (int i = 0; i < REJECT_COUNT; i++)
+        fprintf(out, "%s\"%s\": %llu", i > 0 ? ", " : "", reject_names[i], (unsigned long long)stats.rejects[i]);
+    fprintf(out, "},\n  \"closes\": {");
+    for (int i = 0; i < CLOSE_COUNT; i++)
+        fprintf(out, "%s\"%s\": %llu", i > 0 ? ", " : "", close_names[i], (unsigned long long)stats.closes[i]);
+    fprintf(out, "},\n");
+    fprintf(out, "  \"publishes\": {\"events\": %llu, \"state\": %llu, \"acked\": %llu, \"payload_bytes\": %llu, \"per_s\": %.1f},\n",
+            (unsigned long long)stats.events, (unsigned long long)stats.states, (unsigned long long)stats.acked,
+            (unsigned long long)stats.payload_bytes, elapsed_s > 0 ? (stats.events + stats.states) / elapsed_s : 0.0);
+    fprintf(out, "  \"compressed\": {\"payloads\": %llu, \"decoded_bytes\": %llu, \"corrupt\": %llu},\n",
+            (unsigned long long)stats.compressed, (unsigned long long)stats.decoded_bytes, (unsigned long long)stats.corrupt);
+    fprintf(out, "  \"subscriptions\": {\"granted\": %llu, \"denied\": %llu, \"configs_sent\": %llu},\n",
+            (unsigned long long)stats.subscriptions_granted, (unsigned long long)stats.subscriptions_denied,
+            (unsigned long long)stats.configs_sent);
+    if (options.seq_check)
+    {
+        seq_tracker_stats_t seq;
+        seq_tracker_set_finish(&seq_trackers, &seq);
+        fprintf(out,
+                "  \"sequence\": {\"devices\": %zu, \"received\": %llu, \"duplicates\": %llu, \"missing\": %llu, \"gaps\": %llu, "
+                "\"reordered\": %llu, \"too_old\": %llu, \"resyncs\": %llu},\n",
+                seq_trackers.count, (unsigned long long)seq.received, (unsigned long long)seq.duplicates,
+                (unsigned long long)seq.missing, (unsigned long long)seq.gaps, (unsigned long long)seq.reordered,
+                (unsigned long long)seq.too_old, (unsigned long long)seq.resyncs);
+    }
+    fprintf(out, "  \"timing_us\": {\n");
+    write_timing(out, "accept_to_connect", &timing.accept_to_connect, false);
+    write_timing(out, "jwt_verify", &timing.jwt_verify, false);
+    write_timing(out, "connect_to_connack", &timing.connect_to_connack, false);
+    write_timing(out, "connack_to_first_publish", &timing.connack_to_first_publish, false);
+    write_timing(out, "accept_to_first_publish", &timing.accept_to_first_publish, true);
+    fprintf(out, "  }\n}\n");
+    fclose(out);
+}
+
+/*****************************************************
+ *   main                                             *
+ ******************************************************/
+static void on_signal(int signal_number)
+{
+    (void)signal_number;
+    stop_requested = 1;
+}
+
+static int open_listener(const char *text)
+{
+    char host[256] = "127.0.0.1";
+    const char *port = text;
+    const char *colon = strrchr(text, ':');
+    if (colon != NULL)
+    {
+        if ((size_t)(colon - text) >= sizeof(host))
+            return -1;
+        memcpy(host, text, colon - text);
+        host[colon - text] = 0;
+        port = colon + 1;
+    }
+
+    struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_STREAM, .ai_flags = AI_PASSIVE};
+    struct addrinfo *result;
+    if (getaddrinfo(host, port, &hints, &result) != 0)
+        return -1;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd < 0 || bind(fd, result->ai_addr, result->ai_addrlen) != 0 || listen(fd, 4096) != 0)
+    {
+        perror(text);
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+    return fd;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Uso: %s [--listen [host:]puerto] [--key clave.pem|none] [--device id=clave.pem]...\n"
+            "          [--project P] [--region R] [--registry R] [--clock-skew S] [--config texto]\n"
+            "          [--quota-msgs N] [--quota-bytes N] [--seq-check]\n"
+            "          [--duration S] [--report-s S] [--conn-log archivo.csv] [--out archivo.json] [--verbose]\n",
+            argv0);
+}
+
+static int parse_options(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--verbose") == 0)
+        {
+            options.verbose = true;
+            continue;
+        }
+        if (strcmp(arg, "--seq-check") == 0)
+        {
+            options.seq_check = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            return -1;
+        const char *value = argv[++i];
+        if (strcmp(arg, "--listen") == 0)
+            options.listen_text = value;
+        else if (strcmp(arg, "--key") == 0)
+            options.key_path = value;
+        else if (strcmp(arg, "--device") == 0)
+        {
+            if (add_device_key(value) != 0)
+                return -1;
+        }
+        else if (strcmp(arg, "--project") == 0)
+            options.project = value;
+        else if (strcmp(arg, "--region") == 0)
+            options.region = value;
+        else if (strcmp(arg, "--registry") == 0)
+            options.registry = value;
+        else if (strcmp(arg, "--clock-skew") == 0)
+            options.clock_skew_s = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--config") == 0)
+            options.config_payload = value;
+        else if (strcmp(arg, "--quota-msgs") == 0)
+            options.quota_msgs = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--quota-bytes") == 0)
+            options.quota_bytes = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--duration") == 0)
+            options.duration_s = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--report-s") == 0)
+            options.report_s = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--conn-log") == 0)
+            options.conn_log_path = value;
+        else if (strcmp(arg, "--out") == 0)
+            options.out_path = value;
+        else
+            return -1;
+    }
+    return 0;
+}
+
+static int load_default_key(void)
+{
+    if (options.key_path == NULL)
+    {
+        int rc = parse_key(&default_key, DEVICE_KEY, strlen(DEVICE_KEY));
+        if (rc != 0)
+            fprintf(stderr, "device.key: clave invalida (-0x%x)\n", -rc);
+        has_default_key = rc == 0;
+        return rc;
+    }
+    if (strcmp(options.key_path, "none") == 0)
+        return 0;
+    if (load_key_file(&default_key, options.key_path) != 0)
+        return -1;
+    has_default_key = true;
+    return 0;
+}
+
+static void raise_fd_limit(void)
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    if (parse_options(argc, argv) != 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    if (load_default_key() != 0)
+        return 1;
+    if (!has_default_key && device_key_count == 0)
+    {
+        fprintf(stderr, "Sin claves: use --key o --device\n");
+        return 2;
+    }
+
+    raise_fd_limit();
+    seq_tracker_set_init(&seq_trackers);
+    memset(device_buckets, 0xff, sizeof(device_buckets));
+    latency_histogram_init(&timing.accept_to_connect);
+    latency_histogram_init(&timing.jwt_verify);
+    latency_histogram_init(&timing.connect_to_connack);
+    latency_histogram_init(&timing.connack_to_first_publish);
+    latency_histogram_init(&timing.accept_to_first_publish);
+
+    if (options.conn_log_path != NULL)
+    {
+        conn_log = fopen(options.conn_log_path, "w");
+        if (conn_log == NULL)
+        {
+            perror(options.conn_log_path);
+            return 1;
+        }
+        fprintf(conn_log, "device_id,connack,close_reason,accept_to_connect_us,jwt_verify_us,connect_to_connack_us,"
+                          "connack_to_first_publish_us,accept_to_first_publish_us,publishes,payload_bytes,duration_ms\n");
+    }
+
+    int listen_fd = open_listener(options.listen_text);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (listen_fd < 0 || epoll_fd < 0)
+        return 1;
+    struct epoll_event listen_event = {.events = EPOLLIN, .data.fd = listen_fd};
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &listen_event);
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+    fprintf(stderr, "clearblade_broker escuchando en %s (%s, %zu dispositivos registrados)\n", options.listen_text,
+            has_default_key ? "clave por defecto" : "solo dispositivos registrados", device_key_count);
+
+    struct epoll_event events[BROKER_EPOLL_EVENTS];
+    int64_t end_us = options.duration_s > 0 ? options.duration_s * 1000000LL : INT64_MAX;
+    int64_t next_check_us = 1000000;
+    int64_t next_report_us = options.report_s * 1000000LL;
+    uint64_t last_publishes = 0;
+    uint64_t last_authenticated = 0;
+
+    while (!stop_requested && now_us() < end_us)
+    {
+        int count = epoll_wait(epoll_fd, events, BROKER_EPOLL_EVENTS, 200);
+        for (int i = 0; i < count; i++)
+        {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd)
+            {
+                accept_connections(listen_fd);
+                continue;
+            }
+            broker_conn_t *conn = (size_t)fd < conns_cap ? conns[fd] : NULL;
+            if (conn == NULL)
+                continue;
+            if ((events[i].events & EPOLLOUT) && flush_tx(conn) != 0)
+            {
+                close_conn(conn, CLOSE_PEER);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                handle_readable(conn);
+        }
+
+        int64_t now = now_us();
+        if (now >= next_check_us)
+        {
+            check_timeouts();
+            next_check_us = now + 1000000;
+        }
+        if (options.report_s > 0 && now >= next_report_us)
+        {
+            uint64_t publishes = stats.events + stats.states;
+            fprintf(stderr, "[%6.1f s] abiertas %llu, CONNECT ok %llu/s, rechazados %llu, publicaciones %llu/s, verificacion p99 %llu us\n",
+                    now / 1e6, (unsigned long long)stats.open,
+                    (unsigned long long)((stats.authenticated - last_authenticated) / options.report_s),
+                    (unsigned long long)stats.rejected, (unsigned long long)((publishes - last_publishes) / options.report_s),
+                    (unsigned long long)latency_histogram_percentile(&timing.jwt_verify, 99));
+            last_publishes = publishes;
+            last_authenticated = stats.authenticated;
+            next_report_us += options.report_s * 1000000LL;
+        }
+    }
+
+    double elapsed_s = now_us() / 1e6;
+    for (size_t fd = 0; fd < conns_cap; fd++)
+        if (conns[fd] != NULL)
+            close_conn(conns[fd], CLOSE_SHUTDOWN);
+    close(listen_fd);
+    close(epoll_fd);
+    if (conn_log != NULL)
+        fclose(conn_log);
+
+    write_results(elapsed_s);
+    fprintf(stderr, "%llu conexiones, %llu autenticadas, %llu rechazadas, %llu publicaciones; verificacion JWT p50 %llu us -> %s\n",
+            (unsigned long long)stats.accepted, (unsigned long long)stats.authenticated, (unsigned long long)stats.rejected,
+            (unsigned long long)(stats.events + stats.states),
+            (unsigned long long)latency_histogram_percentile(&timing.jwt_verify, 50), options.out_path);
+    return 0;
+}
@@ -0,0 +1,26 @@
+/*
+ * esp_app_desc.h (host mock)
+ *
+ *  La version es HOST_APP_VERSION (por defecto "host").
+ */
+
+#ifndef HOST_ESP_APP_DESC_H_
+#define HOST_ESP_APP_DESC_H_
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t magic_word;
+    uint32_t secure_version;
+    char version[32];
+    char project_name[32];
+    char time[16];
+    char date[16];
+    char idf_ver[32];
+    uint8_t app_elf_sha256[32];
+} esp_app_desc_t;
+
+const esp_app_desc_t *esp_app_get_description(void);
+
+#endif /* HOST_ESP_APP_DESC_H_ */
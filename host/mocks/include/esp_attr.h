@@ -0,0 +1,16 @@
+/*
+ * esp_attr.h (host mock)
+ */
+
+#ifndef HOST_ESP_ATTR_H_
+#define HOST_ESP_ATTR_H_
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_FAST_ATTR
+#define RTC_SLOW_ATTR
+#define EXT_RAM_BSS_ATTR
+
+#endif /* HOST_ESP_ATTR_H_ */
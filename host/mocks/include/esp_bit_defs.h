@@ -0,0 +1,24 @@
+/*
+ * esp_bit_defs.h (host mock)
+ */
+
+#ifndef HOST_ESP_BIT_DEFS_H_
+#define HOST_ESP_BIT_DEFS_H_
+
+#define BIT31 0x80000000
+#define BIT24 0x01000000
+#define BIT16 0x00010000
+#define BIT15 0x00008000
+#define BIT10 0x00000400
+#define BIT9 0x00000200
+#define BIT8 0x00000100
+#define BIT7 0x00000080
+#define BIT6 0x00000040
+#define BIT5 0x00000020
+#define BIT4 0x00000010
+#define BIT3 0x00000008
+#define BIT2 0x00000004
+#define BIT1 0x00000002
+#define BIT0 0x00000001
+
+#endif /* HOST_ESP_BIT_DEFS_H_ */
@@ -0,0 +1,46 @@
+/*
+ * esp_log.h (host mock)
+ *
+ *  Los mensajes se escriben en stderr. El nivel se toma de la variable de
+ *  entorno HOST_LOG_LEVEL (0..5, por defecto CONFIG_LOG_DEFAULT_LEVEL) y el
+ *  formateo se omite por completo si el mensaje no supera el nivel.
+ */
+
+#ifndef HOST_ESP_LOG_H_
+#define HOST_ESP_LOG_H_
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+typedef enum
+{
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+extern esp_log_level_t host_log_level;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+void host_log_write(esp_log_level_t level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+uint32_t esp_log_timestamp(void);
+/* Como en el IDF: escribe el texto tal cual, sin prefijo ni salto de linea */
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOG_LEVEL(level, tag, format, ...)                   \
+    do                                                           \
+    {                                                            \
+        if (host_log_level >= (level))                           \
+            host_log_write(level, tag, format, ##__VA_ARGS__);   \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+#endif /* HOST_ESP_LOG_H_ */
@@ -0,0 +1,11 @@
+/*
+ * esp_mac.h (host mock)
+ */
+
+#ifndef HOST_ESP_MAC_H_
+#define HOST_ESP_MAC_H_
+
+#define MAC2STR(a) (a)[0], (a)[1], (a)[2], (a)[3], (a)[4], (a)[5]
+#define MACSTR "%02x:%02x:%02x:%02x:%02x:%02x"
+
+#endif /* HOST_ESP_MAC_H_ */
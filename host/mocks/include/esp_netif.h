@@ -0,0 +1,62 @@
+/*
+ * esp_netif.h (host mock)
+ *
+ *  Tambien cubre esp_netif_types.h, esp_netif_ip_addr.h y
+ *  esp_netif_defaults.h, que solo lo incluyen.
+ */
+
+#ifndef HOST_ESP_NETIF_H_
+#define HOST_ESP_NETIF_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+typedef struct
+{
+    uint32_t addr;
+} esp_ip4_addr_t;
+
+typedef struct
+{
+    esp_ip4_addr_t ip;
+    esp_ip4_addr_t netmask;
+    esp_ip4_addr_t gw;
+} esp_netif_ip_info_t;
+
+typedef struct esp_netif_obj esp_netif_t;
+
+typedef struct
+{
+    esp_netif_t *esp_netif;
+    esp_netif_ip_info_t ip_info;
+    bool ip_changed;
+} ip_event_got_ip_t;
+
+typedef enum
+{
+    IP_EVENT_STA_GOT_IP,
+    IP_EVENT_STA_LOST_IP,
+    IP_EVENT_AP_STAIPASSIGNED,
+} ip_event_t;
+
+ESP_EVENT_DECLARE_BASE(IP_EVENT);
+
+#define esp_netif_set_ip4_addr(ipaddr, a, b, c, d) \
+    ((ipaddr)->addr = (uint32_t)(a) | (uint32_t)(b) << 8 | (uint32_t)(c) << 16 | (uint32_t)(d) << 24)
+
+#define IP2STR(ipaddr) ((uint8_t *)(ipaddr))[0], ((uint8_t *)(ipaddr))[1], ((uint8_t *)(ipaddr))[2], ((uint8_t *)(ipaddr))[3]
+#define IPSTR "%d.%d.%d.%d"
+
+esp_err_t esp_netif_init(void);
+esp_netif_t *esp_netif_create_default_wifi_sta(void);
+esp_netif_t *esp_netif_create_default_wifi_ap(void);
+esp_err_t esp_netif_set_ip_info(esp_netif_t *esp_netif, const esp_netif_ip_info_t *ip_info);
+esp_err_t esp_netif_get_ip_info(esp_netif_t *esp_netif, esp_netif_ip_info_t *ip_info);
+esp_netif_t *esp_netif_get_handle_from_ifkey(const char *if_key); // "WIFI_STA_DEF" o "WIFI_AP_DEF"
+esp_err_t esp_netif_dhcps_start(esp_netif_t *esp_netif);
+esp_err_t esp_netif_dhcps_stop(esp_netif_t *esp_netif);
+uint32_t esp_ip4addr_aton(const char *addr);
+
+#endif /* HOST_ESP_NETIF_H_ */
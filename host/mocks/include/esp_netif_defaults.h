@@ -0,0 +1,10 @@
+/*
+ * esp_netif_defaults.h (host mock)
+ */
+
+#ifndef HOST_ESP_NETIF_DEFAULTS_H_
+#define HOST_ESP_NETIF_DEFAULTS_H_
+
+#include "esp_netif.h"
+
+#endif /* HOST_ESP_NETIF_DEFAULTS_H_ */
@@ -0,0 +1,10 @@
+/*
+ * esp_netif_ip_addr.h (host mock)
+ */
+
+#ifndef HOST_ESP_NETIF_IP_ADDR_H_
+#define HOST_ESP_NETIF_IP_ADDR_H_
+
+#include "esp_netif.h"
+
+#endif /* HOST_ESP_NETIF_IP_ADDR_H_ */
@@ -0,0 +1,10 @@
+/*
+ * esp_netif_types.h (host mock)
+ */
+
+#ifndef HOST_ESP_NETIF_TYPES_H_
+#define HOST_ESP_NETIF_TYPES_H_
+
+#include "esp_netif.h"
+
+#endif /* HOST_ESP_NETIF_TYPES_H_ */
@@ -0,0 +1,19 @@
+/*
+ * esp_random.h (host mock)
+ *
+ *  Generador determinista (xorshift) para que las corridas en el host sean
+ *  reproducibles; la semilla se cambia con host_mock_seed_random().
+ */
+
+#ifndef HOST_ESP_RANDOM_H_
+#define HOST_ESP_RANDOM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint32_t esp_random(void);
+void esp_fill_random(void *buf, size_t len);
+
+void host_mock_seed_random(uint64_t seed);
+
+#endif /* HOST_ESP_RANDOM_H_ */
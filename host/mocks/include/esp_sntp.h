@@ -0,0 +1,68 @@
+/*
+ * esp_sntp.h (host mock)
+ *
+ *  Cliente SNTP como el de lwIP: consulta los servidores en orden, pasa
+ *  al siguiente si uno no contesta y entrega la hora a sntp_sync_time().
+ *
+ *  El reloj del sistema del host no se puede ajustar sin privilegios:
+ *  quien incluye este header lee y ajusta un reloj virtual, la hora real
+ *  mas un offset. Los nombres de servidor aceptan "host:puerto" para
+ *  apuntar a un servidor local sin privilegios (por defecto, 123).
+ */
+
+#ifndef HOST_ESP_SNTP_H_
+#define HOST_ESP_SNTP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+/* Espera de la respuesta de un servidor (lwIP: SNTP_RECV_TIMEOUT, 15 s) */
+#ifndef HOST_SNTP_RECV_TIMEOUT_MS
+#define HOST_SNTP_RECV_TIMEOUT_MS 1000
+#endif
+/* Espera antes de volver a recorrer la lista si ningun servidor contesto */
+#ifndef HOST_SNTP_RETRY_MS
+#define HOST_SNTP_RETRY_MS 1000
+#endif
+/* Intervalo entre sincronizaciones (CONFIG_LWIP_SNTP_UPDATE_DELAY) */
+#ifndef HOST_SNTP_UPDATE_DELAY_MS
+#define HOST_SNTP_UPDATE_DELAY_MS (3600 * 1000)
+#endif
+
+typedef enum
+{
+    SNTP_OPMODE_POLL,
+    SNTP_OPMODE_LISTENONLY,
+} esp_sntp_operatingmode_t;
+
+typedef enum
+{
+    SNTP_SYNC_STATUS_RESET,
+    SNTP_SYNC_STATUS_COMPLETED,
+    SNTP_SYNC_STATUS_IN_PROGRESS,
+} sntp_sync_status_t;
+
+void esp_sntp_setoperatingmode(esp_sntp_operatingmode_t operating_mode);
+void esp_sntp_setservername(uint8_t idx, const char *server);
+void esp_sntp_init(void);
+void esp_sntp_stop(void);
+/* Consulta de inmediato, sin esperar al intervalo; false si no esta iniciado */
+bool esp_sntp_restart(void);
+bool esp_sntp_enabled(void);
+
+void sntp_set_sync_status(sntp_sync_status_t sync_status);
+sntp_sync_status_t sntp_get_sync_status(void);
+
+/* Weak en el mock: ajusta el reloj virtual. La aplicacion puede reemplazarla */
+void sntp_sync_time(struct timeval *tv);
+
+/* Reloj virtual */
+int host_gettimeofday(struct timeval *tv, void *tz);
+int host_settimeofday(const struct timeval *tv, const void *tz);
+/* Control del mock: corre el reloj virtual delta_us (tiempo que paso, error del RTC) */
+void host_clock_adjust_us(int64_t delta_us);
+#define gettimeofday host_gettimeofday
+#define settimeofday host_settimeofday
+
+#endif /* HOST_ESP_SNTP_H_ */
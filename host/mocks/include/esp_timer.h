@@ -0,0 +1,13 @@
+/*
+ * esp_timer.h (host mock)
+ */
+
+#ifndef HOST_ESP_TIMER_H_
+#define HOST_ESP_TIMER_H_
+
+#include <stdint.h>
+
+/* Microsegundos desde el inicio del proceso (CLOCK_MONOTONIC) */
+int64_t esp_timer_get_time(void);
+
+#endif /* HOST_ESP_TIMER_H_ */
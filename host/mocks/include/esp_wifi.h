@@ -0,0 +1,194 @@
+/*
+ * esp_wifi.h (host mock)
+ *
+ *  Lo que usan los componentes compilados en el host, wifi_manager
+ *  incluido. El RSSI que devuelve esp_wifi_sta_get_ap_info() se fija con
+ *  host_mock_set_rssi().
+ *
+ *  Sin esp_wifi_start() la estacion se considera asociada y con IP. Despues
+ *  de esp_wifi_start() se simula la asociacion: esp_wifi_connect() tarda
+ *  HOST_WIFI_CONNECT_MS y entrega WIFI_EVENT_STA_CONNECTED e
+ *  IP_EVENT_STA_GOT_IP, o, si el AP esta caido (host_mock_wifi_ap_down()),
+ *  tarda HOST_WIFI_SCAN_FAIL_MS y entrega WIFI_EVENT_STA_DISCONNECTED.
+ *  Despues de esp_wifi_stop() esp_wifi_connect() falla hasta el proximo
+ *  esp_wifi_start().
+ */
+
+#ifndef HOST_ESP_WIFI_H_
+#define HOST_ESP_WIFI_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+#define HOST_WIFI_CONNECT_MS 300
+#define HOST_WIFI_SCAN_FAIL_MS 2000
+
+typedef struct
+{
+    uint8_t bssid[6];
+    uint8_t ssid[33];
+    uint8_t primary;
+    int8_t rssi;
+} wifi_ap_record_t;
+
+typedef struct
+{
+    uint8_t ssid[32];
+    uint8_t ssid_len;
+    uint8_t bssid[6];
+    uint8_t reason;
+    int8_t rssi;
+} wifi_event_sta_disconnected_t;
+
+typedef struct
+{
+    uint8_t mac[6];
+    uint8_t aid;
+    bool is_mesh_child;
+} wifi_event_ap_staconnected_t;
+
+typedef struct
+{
+    uint8_t mac[6];
+    uint8_t aid;
+    bool is_mesh_child;
+    uint8_t reason;
+} wifi_event_ap_stadisconnected_t;
+
+typedef enum
+{
+    WIFI_EVENT_WIFI_READY = 0,
+    WIFI_EVENT_SCAN_DONE,
+    WIFI_EVENT_STA_START,
+    WIFI_EVENT_STA_STOP,
+    WIFI_EVENT_STA_CONNECTED,
+    WIFI_EVENT_STA_DISCONNECTED,
+    WIFI_EVENT_STA_AUTHMODE_CHANGE,
+    WIFI_EVENT_STA_WPS_ER_SUCCESS,
+    WIFI_EVENT_STA_WPS_ER_FAILED,
+    WIFI_EVENT_STA_WPS_ER_TIMEOUT,
+    WIFI_EVENT_STA_WPS_ER_PIN,
+    WIFI_EVENT_STA_WPS_ER_PBC_OVERLAP,
+    WIFI_EVENT_AP_START,
+    WIFI_EVENT_AP_STOP,
+    WIFI_EVENT_AP_STACONNECTED,
+    WIFI_EVENT_AP_STADISCONNECTED,
+} wifi_event_t;
+
+#define ESP_ERR_WIFI_NOT_STARTED 0x3007
+
+#define WIFI_REASON_BEACON_TIMEOUT 200
+#define WIFI_REASON_NO_AP_FOUND 201
+
+typedef enum
+{
+    WIFI_MODE_NULL = 0,
+    WIFI_MODE_STA,
+    WIFI_MODE_AP,
+    WIFI_MODE_APSTA,
+} wifi_mode_t;
+
+typedef enum
+{
+    WIFI_IF_STA = 0,
+    WIFI_IF_AP,
+} wifi_interface_t;
+
+typedef enum
+{
+    WIFI_AUTH_OPEN = 0,
+    WIFI_AUTH_WEP,
+    WIFI_AUTH_WPA_PSK,
+    WIFI_AUTH_WPA2_PSK,
+    WIFI_AUTH_WPA_WPA2_PSK,
+    WIFI_AUTH_WPA2_ENTERPRISE,
+    WIFI_AUTH_WPA3_PSK,
+} wifi_auth_mode_t;
+
+typedef enum
+{
+    WPA3_SAE_PWE_UNSPECIFIED = 0,
+    WPA3_SAE_PWE_HUNT_AND_PECK,
+    WPA3_SAE_PWE_HASH_TO_ELEMENT,
+    WPA3_SAE_PWE_BOTH,
+} wifi_sae_pwe_method_t;
+
+typedef enum
+{
+    WIFI_PS_NONE = 0,
+    WIFI_PS_MIN_MODEM,
+    WIFI_PS_MAX_MODEM,
+} wifi_ps_type_t;
+
+typedef struct
+{
+    bool capable;
+    bool required;
+} wifi_pmf_config_t;
+
+typedef struct
+{
+    uint8_t ssid[32];
+    uint8_t password[64];
+    uint8_t ssid_len;
+    uint8_t channel;
+    wifi_auth_mode_t authmode;
+    uint8_t ssid_hidden;
+    uint8_t max_connection;
+    uint16_t beacon_interval;
+    wifi_pmf_config_t pmf_cfg;
+    wifi_sae_pwe_method_t sae_pwe_h2e;
+} wifi_ap_config_t;
+
+typedef struct
+{
+    uint8_t ssid[32];
+    uint8_t password[64];
+    struct
+    {
+        int8_t rssi;
+        wifi_auth_mode_t authmode;
+    } threshold;
+    wifi_pmf_config_t pmf_cfg;
+    wifi_sae_pwe_method_t sae_pwe_h2e;
+    uint8_t sae_h2e_identifier[32];
+} wifi_sta_config_t;
+
+typedef union
+{
+    wifi_ap_config_t ap;
+    wifi_sta_config_t sta;
+} wifi_config_t;
+
+typedef struct
+{
+    int unused;
+} wifi_init_config_t;
+
+#define WIFI_INIT_CONFIG_DEFAULT() {0}
+
+ESP_EVENT_DECLARE_BASE(WIFI_EVENT);
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config);
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode);
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf);
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type);
+esp_err_t esp_wifi_start(void);
+esp_err_t esp_wifi_stop(void);
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info);
+esp_err_t esp_wifi_connect(void);
+esp_err_t esp_wifi_disconnect(void);
+
+/* Control del mock */
+void host_mock_set_rssi(int8_t rssi);
+void host_mock_set_wifi_connected(bool connected);
+/* El AP deja de responder durante down_ms; si habia asociacion, STA_DISCONNECTED */
+void host_mock_wifi_ap_down(uint32_t down_ms);
+/* Pierde o recupera la IP y publica IP_EVENT_STA_LOST_IP / IP_EVENT_STA_GOT_IP */
+void host_mock_wifi_set_ip(bool has_ip);
+/* Asociado y con IP: hay ruta al broker */
+bool host_mock_wifi_link_up(void);
+
+#endif /* HOST_ESP_WIFI_H_ */
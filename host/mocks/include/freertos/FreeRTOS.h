@@ -0,0 +1,57 @@
+/*
+ * FreeRTOS.h (host mock)
+ *
+ *  Subconjunto de la API de FreeRTOS implementado sobre pthreads. Un tick
+ *  equivale a 1 ms. Las tareas son hilos; las variantes "Static" ignoran el
+ *  stack provisto y solo usan el buffer de control.
+ */
+
+#ifndef HOST_FREERTOS_H_
+#define HOST_FREERTOS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_bit_defs.h"
+
+typedef uint32_t TickType_t;
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint8_t StackType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define errQUEUE_EMPTY ((BaseType_t)0)
+#define errQUEUE_FULL ((BaseType_t)0)
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(xTimeInMs) ((TickType_t)(((uint64_t)(xTimeInMs) * configTICK_RATE_HZ) / 1000U))
+#define pdTICKS_TO_MS(xTicks) ((TickType_t)(((uint64_t)(xTicks) * 1000U) / configTICK_RATE_HZ))
+#define configMAX_PRIORITIES 25
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define configRUN_TIME_COUNTER_TYPE uint32_t
+
+/* Un "nucleo" por CPU del host */
+int host_num_processors(void);
+#define portNUM_PROCESSORS host_num_processors()
+
+/* Las secciones criticas se implementan con un mutex recursivo global */
+typedef struct
+{
+    int unused;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+void host_enter_critical(void);
+void host_exit_critical(void);
+#define portENTER_CRITICAL(mux) ((void)(mux), host_enter_critical())
+#define portEXIT_CRITICAL(mux) ((void)(mux), host_exit_critical())
+#define taskENTER_CRITICAL(mux) ((void)(mux), host_enter_critical())
+#define taskEXIT_CRITICAL(mux) ((void)(mux), host_exit_critical())
+#define portYIELD_FROM_ISR(x) ((void)(x))
+
+#endif /* HOST_FREERTOS_H_ */
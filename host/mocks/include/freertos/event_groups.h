@@ -0,0 +1,36 @@
+/*
+ * event_groups.h (host mock)
+ */
+
+#ifndef HOST_FREERTOS_EVENT_GROUPS_H_
+#define HOST_FREERTOS_EVENT_GROUPS_H_
+
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+// Como en FreeRTOS: event_groups.h -> timers.h -> task.h
+#include "freertos/task.h"
+
+typedef uint32_t EventBits_t;
+
+typedef struct host_event_group
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    EventBits_t bits;
+    bool is_static;
+} StaticEventGroup_t;
+
+typedef StaticEventGroup_t *EventGroupHandle_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *buffer);
+void vEventGroupDelete(EventGroupHandle_t group);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks_to_wait);
+
+#define xEventGroupSetBitsFromISR(group, bits, woken) (xEventGroupSetBits(group, bits), pdPASS)
+
+#endif /* HOST_FREERTOS_EVENT_GROUPS_H_ */
@@ -0,0 +1,45 @@
+/*
+ * task.h (host mock)
+ */
+
+#ifndef HOST_FREERTOS_TASK_H_
+#define HOST_FREERTOS_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+
+typedef struct host_task
+{
+    TaskFunction_t function;
+    void *param;
+    char name[16];
+    uint32_t stack_depth;
+    bool is_static;
+    unsigned long thread;
+    void *stack_base;     // Stack propio del hilo (mmap), para medir el consumo
+    size_t stack_bytes;
+    size_t stack_overhead; // Ya usado al entrar al hilo (TLS y descriptor de glibc)
+} StaticTask_t;
+
+typedef StaticTask_t *TaskHandle_t;
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *param,
+                       UBaseType_t priority, TaskHandle_t *handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth, void *param,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core_id);
+TaskHandle_t xTaskCreateStatic(TaskFunction_t function, const char *name, uint32_t stack_depth, void *param,
+                               UBaseType_t priority, StackType_t *stack, StaticTask_t *task_buffer);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+const char *pcTaskGetName(TaskHandle_t task);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+void taskYIELD(void);
+/* Tiempo de ejecucion en us: el de CPU del hilo. Hay una sola tarea idle */
+/* (nucleo 0), con el tiempo que el proceso no ocupo                      */
+TaskHandle_t xTaskGetIdleTaskHandleForCore(BaseType_t core_id);
+configRUN_TIME_COUNTER_TYPE ulTaskGetRunTimeCounter(const TaskHandle_t task);
+
+#endif /* HOST_FREERTOS_TASK_H_ */
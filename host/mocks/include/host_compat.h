@@ -0,0 +1,20 @@
+/*
+ * host_compat.h
+ *
+ *  Se incluye (-include) en todas las fuentes compiladas para el host.
+ *  Cubre las diferencias entre newlib (ESP-IDF) y glibc.
+ */
+
+#ifndef HOST_COMPAT_H_
+#define HOST_COMPAT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38)
+size_t strlcpy(char *dst, const char *src, size_t size);
+size_t strlcat(char *dst, const char *src, size_t size);
+#endif
+
+#endif /* HOST_COMPAT_H_ */
@@ -0,0 +1,87 @@
+/*
+ * host_fault.h (host mock)
+ *
+ *  Inyeccion de fallas entre el conector y el transporte. El transporte TCP
+ *  del mock de esp-mqtt y la estacion Wi-Fi simulada consultan este estado
+ *  en cada conexion, envio y paquete recibido. Las fallas se aplican a
+ *  mano (host_fault_apply()) o desde un guion con tiempos relativos:
+ *
+ *      # ms    accion            argumentos
+ *      5000    drop                          cierra la conexion con el broker
+ *      8000    connack_delay     3000        demora cada CONNACK (ms, 0 = off)
+ *      8000    puback_delay      500         demora cada PUBACK (ms, 0 = off)
+ *      12000   refuse_auth       on          CONNACK "not authorized" (on|off)
+ *      15000   throttle          2000        bytes/s hacia el broker (0 = off)
+ *      20000   wifi_down         10000       WIFI_EVENT_STA_DISCONNECTED y el AP
+ *                                            no responde durante N ms
+ *      40000   lost_ip                       IP_EVENT_STA_LOST_IP, el enlace sigue
+ *      41000   got_ip                        IP_EVENT_STA_GOT_IP
+ *      45000   rssi              -78         RSSI del AP (dBm)
+ *      60000   end                           fin del escenario
+ *
+ *  La flash de sample_store (sample_store_host.c) admite un corte de
+ *  energia: despues de N bytes grabados la escritura en curso queda a
+ *  medias y las siguientes fallan, hasta volver a abrir la serie.
+ */
+
+#ifndef HOST_FAULT_H_
+#define HOST_FAULT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HOST_FAULT_MAX_STEPS 64
+
+typedef enum
+{
+    HOST_FAULT_DROP = 0,
+    HOST_FAULT_CONNACK_DELAY,
+    HOST_FAULT_PUBACK_DELAY,
+    HOST_FAULT_REFUSE_AUTH,
+    HOST_FAULT_THROTTLE,
+    HOST_FAULT_WIFI_DOWN,
+    HOST_FAULT_LOST_IP,
+    HOST_FAULT_GOT_IP,
+    HOST_FAULT_RSSI,
+    HOST_FAULT_END,
+} host_fault_action_t;
+
+typedef struct
+{
+    uint32_t at_ms;
+    host_fault_action_t action;
+    uint32_t value; // rssi: int32_t
+} host_fault_step_t;
+
+/* Se llama al aplicar cada paso del guion, desde la tarea del escenario */
+typedef void (*host_fault_observer_t)(const host_fault_step_t *step, int64_t applied_us, void *ctx);
+
+/* Guion */
+void host_fault_reset(void);
+int host_fault_load_script(const char *path);          // 0, o numero de linea con error
+int host_fault_parse_line(const char *line, host_fault_step_t *step); // 1 paso, 0 vacia, -1 error
+int host_fault_step_count(void);
+const host_fault_step_t *host_fault_get_step(int index);
+uint32_t host_fault_end_ms(void);                      // Tiempo del paso "end", 0 si no hay
+const char *host_fault_action_name(host_fault_action_t action);
+void host_fault_start(host_fault_observer_t observer, void *ctx);
+bool host_fault_finished(void);
+
+/* Control directo */
+void host_fault_apply(const host_fault_step_t *step);
+
+/* Consultas del transporte */
+bool host_fault_link_up(void);
+uint32_t host_fault_drop_generation(void);
+uint32_t host_fault_connack_delay_ms(void);
+uint32_t host_fault_puback_delay_ms(void);
+bool host_fault_refuse_auth(void);
+/* Bloquea lo necesario para no superar el ancho de banda configurado */
+void host_fault_throttle(size_t bytes);
+
+/* Corte de energia en la flash de sample_store */
+void host_fault_flash_cut(uint32_t after_bytes);
+bool host_fault_flash_is_cut(void);
+
+#endif /* HOST_FAULT_H_ */
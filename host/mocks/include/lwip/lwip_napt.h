@@ -0,0 +1,10 @@
+/*
+ * lwip/lwip_napt.h (host mock)
+ *
+ *  Vacio: wifi_manager.c lo incluye pero no usa nada de lwIP.
+ */
+
+#ifndef HOST_LWIP_LWIP_NAPT_H_
+#define HOST_LWIP_LWIP_NAPT_H_
+
+#endif /* HOST_LWIP_LWIP_NAPT_H_ */
@@ -0,0 +1,10 @@
+/*
+ * lwip/opt.h (host mock)
+ *
+ *  Vacio: wifi_manager.c lo incluye pero no usa nada de lwIP.
+ */
+
+#ifndef HOST_LWIP_OPT_H_
+#define HOST_LWIP_OPT_H_
+
+#endif /* HOST_LWIP_OPT_H_ */
@@ -0,0 +1,15 @@
+/*
+ * lwip/sockets.h (host mock)
+ *
+ *  Los sockets BSD del sistema.
+ */
+
+#ifndef HOST_LWIP_SOCKETS_H_
+#define HOST_LWIP_SOCKETS_H_
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#endif /* HOST_LWIP_SOCKETS_H_ */
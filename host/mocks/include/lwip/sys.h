@@ -0,0 +1,10 @@
+/*
+ * lwip/sys.h (host mock)
+ *
+ *  Vacio: wifi_manager.c lo incluye pero no usa nada de lwIP.
+ */
+
+#ifndef HOST_LWIP_SYS_H_
+#define HOST_LWIP_SYS_H_
+
+#endif /* HOST_LWIP_SYS_H_ */
@@ -0,0 +1,140 @@
+/*
+ * mqtt_client.h (host mock)
+ *
+ *  Cliente esp-mqtt simulado. Con una URI "mqtt://host:puerto" habla MQTT
+ *  3.1.1 sobre TCP con un broker local, a traves de host_fault.h. Con
+ *  cualquier otra no abre sockets: esp_mqtt_client_start() entrega
+ *  MQTT_EVENT_CONNECTED y cada publicacion QoS>0 entrega
+ *  MQTT_EVENT_PUBLISHED, ambos sincronicos. Las publicaciones se cuentan y
+ *  se pueden observar con host_mqtt_set_publish_hook().
+ */
+
+#ifndef HOST_MQTT_CLIENT_H_
+#define HOST_MQTT_CLIENT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
+
+typedef enum
+{
+    MQTT_EVENT_ANY = -1,
+    MQTT_EVENT_ERROR = 0,
+    MQTT_EVENT_CONNECTED,
+    MQTT_EVENT_DISCONNECTED,
+    MQTT_EVENT_SUBSCRIBED,
+    MQTT_EVENT_UNSUBSCRIBED,
+    MQTT_EVENT_PUBLISHED,
+    MQTT_EVENT_DATA,
+    MQTT_EVENT_BEFORE_CONNECT,
+    MQTT_EVENT_DELETED,
+} esp_mqtt_event_id_t;
+
+typedef struct
+{
+    esp_mqtt_event_id_t event_id;
+    esp_mqtt_client_handle_t client;
+    char *data;
+    int data_len;
+    int total_data_len;
+    int current_data_offset;
+    char *topic;
+    int topic_len;
+    int msg_id;
+    int session_present;
+    bool retain;
+    int qos;
+    bool dup;
+} esp_mqtt_event_t;
+
+typedef esp_mqtt_event_t *esp_mqtt_event_handle_t;
+
+typedef struct
+{
+    struct
+    {
+        struct
+        {
+            const char *uri;
+            const char *hostname;
+            uint32_t port;
+        } address;
+        struct
+        {
+            const char *certificate;
+            size_t certificate_len;
+        } verification;
+    } broker;
+    struct
+    {
+        const char *username;
+        const char *client_id;
+        struct
+        {
+            const char *password;
+        } authentication;
+    } credentials;
+    struct
+    {
+        int keepalive;
+        bool disable_clean_session;
+    } session;
+    struct
+    {
+        int reconnect_timeout_ms;
+        int timeout_ms;
+        bool disable_auto_reconnect;
+    } network;
+    struct
+    {
+        int priority;
+        int stack_size;
+    } task;
+    struct
+    {
+        int size;
+        int out_size;
+    } buffer;
+} esp_mqtt_client_config_t;
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config);
+esp_err_t esp_mqtt_set_config(esp_mqtt_client_handle_t client, const esp_mqtt_client_config_t *config);
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler, void *event_handler_arg);
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos);
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain);
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos,
+                            int retain, bool store);
+
+/* Control del mock */
+typedef struct
+{
+    uint32_t published;        // Aceptadas por esp_mqtt_client_publish()
+    uint32_t rejected;         // esp_mqtt_client_publish() devolvio -1
+    uint32_t acked;            // PUBACK recibido (QoS 1)
+    uint32_t retransmitted;    // Reenviadas desde el outbox al reconectar
+    uint32_t outbox_expired;   // QoS 1 descartadas sin PUBACK
+    uint32_t connect_attempts;
+    uint32_t connects;
+    uint32_t connect_refused;  // CONNACK con codigo de error
+    uint32_t transport_errors; // Sin enlace o conexion TCP rechazada
+    uint32_t disconnects;
+    uint64_t bytes_sent;
+} host_mqtt_stats_t;
+
+typedef void (*host_mqtt_publish_hook_t)(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos);
+typedef void (*host_mqtt_event_observer_t)(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event_id, int msg_id);
+void host_mqtt_set_publish_hook(host_mqtt_publish_hook_t hook);
+/* Se llama despues del handler del cliente, en el hilo que despacha */
+void host_mqtt_set_event_observer(host_mqtt_event_observer_t observer);
+void host_mqtt_get_stats(esp_mqtt_client_handle_t client, host_mqtt_stats_t *stats);
+uint32_t host_mqtt_publish_count(void);
+void host_mqtt_dispatch(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event_id, int msg_id);
+
+#endif /* HOST_MQTT_CLIENT_H_ */
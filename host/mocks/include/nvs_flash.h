@@ -0,0 +1,13 @@
+/*
+ * nvs_flash.h (host mock)
+ */
+
+#ifndef HOST_NVS_FLASH_H_
+#define HOST_NVS_FLASH_H_
+
+#include "nvs.h"
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+
+#endif /* HOST_NVS_FLASH_H_ */
@@ -0,0 +1,18 @@
+/*
+ * sdkconfig.h (host)
+ *
+ *  Configuracion minima equivalente a la del target para compilar los
+ *  componentes en Linux.
+ */
+
+#ifndef HOST_SDKCONFIG_H_
+#define HOST_SDKCONFIG_H_
+
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_FREERTOS_HZ 1000
+#define CONFIG_LWIP_SNTP_MAX_SERVERS 3
+#define CONFIG_LOG_DEFAULT_LEVEL 2
+#define CONFIG_FREERTOS_SUPPORT_STATIC_ALLOCATION 1
+#define CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS 1
+
+#endif /* HOST_SDKCONFIG_H_ */
@@ -0,0 +1,417 @@
+/*
+ * cjson_host.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Parser JSON recursivo con la interfaz de cJSON (ver cJSON.h del
+ *  mock). Como cJSON: los numeros son double con valueint saturado, las
+ *  cadenas se decodifican a UTF-8 (incluidos \uXXXX y pares suplentes) y
+ *  lo que sigue al primer valor completo se ignora.
+ */
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "cJSON.h"
+
+#define HOST_CJSON_NUMBER_MAX_LEN 64
+
+typedef struct
+{
+    const char *data;
+    size_t len;
+    size_t pos;
+    int depth;
+} parser_t;
+
+static bool parse_value(parser_t *p, cJSON *item);
+
+static void skip_whitespace(parser_t *p)
+{
+    while (p->pos < p->len && (p->data[p->pos] == ' ' || p->data[p->pos] == '\t' || p->data[p->pos] == '\n' ||
+                               p->data[p->pos] == '\r'))
+        p->pos++;
+}
+
+static bool consume_literal(parser_t *p, const char *literal)
+{
+    size_t n = strlen(literal);
+    if (p->len - p->pos < n || memcmp(p->data + p->pos, literal, n) != 0)
+        return false;
+    p->pos += n;
+    return true;
+}
+
+static bool parse_number(parser_t *p, cJSON *item)
+{
+    char buffer[HOST_CJSON_NUMBER_MAX_LEN];
+    size_t n = 0;
+    while (p->pos + n < p->len && n < sizeof(buffer) - 1 && strchr("0123456789+-.eE", p->data[p->pos + n]) != NULL &&
+           p->data[p->pos + n] != 0)
+    {
+        buffer[n] = p->data[p->pos + n];
+        n++;
+    }
+    buffer[n] = 0;
+    char *end;
+    double value = strtod(buffer, &end);
+    if (end == buffer)
+        return false;
+    p->pos += end - buffer;
+
+    item->type = cJSON_Number;
+    item->valuedouble = value;
+    if (value >= INT_MAX)
+        item->valueint = INT_MAX;
+    else if (value <= (double)INT_MIN)
+        item->valueint = INT_MIN;
+    else
+        item->valueint = (int)value;
+    return true;
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c = tolower((unsigned char)c);
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+static bool parse_hex4(parser_t *p, size_t at, unsigned *value)
+{
+    if (p->len - at < 4)
+        return false;
+    *value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        int digit = hex_value(p->data[at + i]);
+        if (digit < 0)
+            return false;
+        *value = (*value << 4) | digit;
+    }
+    return true;
+}
+
+static size_t encode_utf8(unsigned codepoint, char *out)
+{
+    if (codepoint < 0x80)
+    {
+        out[0] = codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800)
+    {
+        out[0] = 0xC0 | (codepoint >> 6);
+        out[1] = 0x80 | (codepoint & 0x3F);
+        return 2;
+    }
+    if (codepoint < 0x10000)
+    {
+        out[0] = 0xE0 | (codepoint >> 12);
+        out[1] = 0x80 | ((codepoint >> 6) & 0x3F);
+        out[2] = 0x80 | (codepoint & 0x3F);
+        return 3;
+    }
+    out[0] = 0xF0 | (codepoint >> 18);
+    out[1] = 0x80 | ((codepoint >> 12) & 0x3F);
+    out[2] = 0x80 | ((codepoint >> 6) & 0x3F);
+    out[3] = 0x80 | (codepoint & 0x3F);
+    return 4;
+}
+
+/* p->pos en la comilla de apertura; devuelve la cadena decodificada (malloc) */
+static char *parse_string_raw(parser_t *p)
+{
+    size_t start = ++p->pos;
+    size_t end = start;
+    while (end < p->len && p->data[end] != '"')
+        end += p->data[end] == '\\' ? 2 : 1;
+    if (end >= p->len)
+        return NULL;
+
+    // El texto decodificado nunca es mas largo que el escapado
+    char *out = malloc(end - start + 1);
+    if (out == NULL)
+        return NULL;
+    size_t n = 0;
+    size_t i = start;
+    while (i < end)
+    {
+        char c = p->data[i++];
+        if (c != '\\')
+        {
+            out[n++] = c;
+            continue;
+        }
+        c = p->data[i++];
+        switch (c)
+        {
+        case 'b':
+            out[n++] = '\b';
+            break;
+        case 'f':
+            out[n++] = '\f';
+            break;
+        case 'n':
+            out[n++] = '\n';
+            break;
+        case 'r':
+            out[n++] = '\r';
+            break;
+        case 't':
+            out[n++] = '\t';
+            break;
+        case '"':
+        case '\\':
+        case '/':
+            out[n++] = c;
+            break;
+        case 'u':
+        {
+            unsigned codepoint;
+            if (!parse_hex4(p, i, &codepoint))
+                goto invalid;
+            i += 4;
+            if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+            {
+                unsigned low;
+                if (i + 6 > end || p->data[i] != '\\' || p->data[i + 1] != 'u' || !parse_hex4(p, i + 2, &low) ||
+                    low < 0xDC00 || low > 0xDFFF)
+                    goto invalid;
+                i += 6;
+                codepoint = 0x10000 + (((codepoint & 0x3FF) << 10) | (low & 0x3FF));
+            }
+            else if (codepoint >= 0xDC00 && codepoint <= 0xDFFF)
+                goto invalid;
+            n += encode_utf8(codepoint, out + n);
+            break;
+        }
+        default:
+            goto invalid;
+        }
+    }
+    out[n] = 0;
+    p->pos = end + 1;
+    return out;
+
+invalid:
+    free(out);
+    return NULL;
+}
+
+static bool parse_string(parser_t *p, cJSON *item)
+{
+    char *value = parse_string_raw(p);
+    if (value == NULL)
+        return false;
+    item->type = cJSON_String;
+    item->valuestring = value;
+    return true;
+}
+
+/* Elementos de un arreglo ({...} con claves si object) */
+static bool parse_children(parser_t *p, cJSON *item, bool object)
+{
+    char close = object ? '}' : ']';
+    item->type = object ? cJSON_Object : cJSON_Array;
+    if (++p->depth > CJSON_NESTING_LIMIT)
+        return false;
+    p->pos++;
+    skip_whitespace(p);
+    if (p->pos < p->len && p->data[p->pos] == close)
+    {
+        p->pos++;
+        p->depth--;
+        return true;
+    }
+
+    cJSON *last = NULL;
+    while (true)
+    {
+        cJSON *child = calloc(1, sizeof(*child));
+        if (child == NULL)
+            return false;
+        if (last == NULL)
+            item->child = child;
+        else
+        {
+            last->next = child;
+            child->prev = last;
+        }
+        last = child;
+
+        skip_whitespace(p);
+        if (object)
+        {
+            if (p->pos >= p->len || p->data[p->pos] != '"' || (child->string = parse_string_raw(p)) == NULL)
+                return false;
+            skip_whitespace(p);
+            if (p->pos >= p->len || p->data[p->pos] != ':')
+                return false;
+            p->pos++;
+            skip_whitespace(p);
+        }
+        if (!parse_value(p, child))
+            return false;
+        skip_whitespace(p);
+        if (p->pos >= p->len)
+            return false;
+        if (p->data[p->pos] == ',')
+        {
+            p->pos++;
+            continue;
+        }
+        if (p->data[p->pos] != close)
+            return false;
+        p->pos++;
+        p->depth--;
+        return true;
+    }
+}
+
+static bool parse_value(parser_t *p, cJSON *item)
+{
+    if (p->pos >= p->len)
+        return false;
+    char c = p->data[p->pos];
+    if (c == '{' || c == '[')
+        return parse_children(p, item, c == '{');
+    if (c == '"')
+        return parse_string(p, item);
+    if (c == '-' || (c >= '0' && c <= '9'))
+        return parse_number(p, item);
+    if (consume_literal(p, "null"))
+        item->type = cJSON_NULL;
+    else if (consume_literal(p, "true"))
+    {
+        item->type = cJSON_True;
+        item->valueint = 1;
+    }
+    else if (consume_literal(p, "false"))
+        item->type = cJSON_False;
+    else
+        return false;
+    return true;
+}
+
+cJSON *cJSON_ParseWithLength(const char *value, size_t buffer_length)
+{
+    if (value == NULL || buffer_length == 0)
+        return NULL;
+    cJSON *root = calloc(1, sizeof(*root));
+    if (root == NULL)
+        return NULL;
+    parser_t parser = {.data = value, .len = buffer_length};
+    skip_whitespace(&parser);
+    if (!parse_value(&parser, root))
+    {
+        cJSON_Delete(root);
+        return NULL;
+    }
+    return root;
+}
+
+cJSON *cJSON_Parse(const char *value)
+{
+    return value != NULL ? cJSON_ParseWithLength(value, strlen(value) + 1) : NULL;
+}
+
+void cJSON_Delete(cJSON *item)
+{
+    while (item != NULL)
+    {
+        cJSON *next = item->next;
+        cJSON_Delete(item->child);
+        free(item->valuestring);
+        free(item->string);
+        free(item);
+        item = next;
+    }
+}
+
+int cJSON_GetArraySize(const cJSON *array)
+{
+    int size = 0;
+    for (const cJSON *child = array != NULL ? array->child : NULL; child != NULL; child = child->next)
+        size++;
+    return size;
+}
+
+cJSON *cJSON_GetArrayItem(const cJSON *array, int index)
+{
+    if (index < 0)
+        return NULL;
+    cJSON *child = array != NULL ? array->child : NULL;
+    while (child != NULL && index > 0)
+    {
+        child = child->next;
+        index--;
+    }
+    return child;
+}
+
+cJSON *cJSON_GetObjectItem(const cJSON *object, const char *string)
+{
+    for (cJSON *child = object != NULL ? object->child : NULL; child != NULL; child = child->next)
+        if (child->string != NULL && string != NULL && strcasecmp(child->string, string) == 0)
+            return child;
+    return NULL;
+}
+
+cJSON *cJSON_GetObjectItemCaseSensitive(const cJSON *object, const char *string)
+{
+    for (cJSON *child = object != NULL ? object->child : NULL; child != NULL; child = child->next)
+        if (child->string != NULL && string != NULL && strcmp(child->string, string) == 0)
+            return child;
+    return NULL;
+}
+
+cJSON_bool cJSON_IsInvalid(const cJSON *item)
+{
+    return item != NULL && (item->type & 0xFF) == cJSON_Invalid;
+}
+
+cJSON_bool cJSON_IsFalse(const cJSON *item)
+{
+    return item != NULL && (item->type & 0xFF) == cJSON_False;
+}
+
+cJSON_bool cJSON_IsTrue(const cJSON *item)
+{
+    return item != NULL && (item->type & 0xFF) == cJSON_True;
+}
+
+cJSON_bool cJSON_IsBool(const cJSON *item)
+{
+    return item != NULL && (item->type & (cJSON_True | cJSON_False)) != 0;
+}
+
+cJSON_bool cJSON_IsNull(const cJSON *item)
+{
+    return item != NULL && (item->type & 0xFF) == cJSON_NULL;
+}
+
+cJSON_bool cJSON_IsNumber(const cJSON *item)
+{
+    return item != NULL && (item->type & 0xFF) == cJSON_Number;
+}
+
+cJSON_bool cJSON_IsString(const cJSON *item)
+{
+    return item != NULL && (item->type & 0xFF) == cJSON_String;
+}
+
+cJSON_bool cJSON_IsArray(const cJSON *item)
+{
+    return item != NULL && (item->type & 0xFF) == cJSON_Array;
+}
+
+cJSON_bool cJSON_IsObject(const cJSON *item)
+{
+    return item != NULL && (item->type & 0xFF) == cJSON_Object;
+}
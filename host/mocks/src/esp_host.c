@@ -0,0 +1,354 @@
+/*
+ * esp_host.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Servicios del sistema (log, timer, random, reset, sleep, eventos)
+ *  simulados para compilar y medir los componentes en Linux.
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_app_desc.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "esp_sleep.h"
+#include "esp_event.h"
+
+/*****************************************************
+ *   esp_err / esp_log                                *
+ ******************************************************/
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_NVS_NOT_FOUND:
+        return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_INVALID_HANDLE:
+        return "ESP_ERR_NVS_INVALID_HANDLE";
+    case ESP_ERR_NVS_INVALID_LENGTH:
+        return "ESP_ERR_NVS_INVALID_LENGTH";
+    case ESP_ERR_NVS_TYPE_MISMATCH:
+        return "ESP_ERR_NVS_TYPE_MISMATCH";
+    case ESP_ERR_NVS_READ_ONLY:
+        return "ESP_ERR_NVS_READ_ONLY";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
+
+static esp_log_level_t initial_log_level(void)
+{
+    const char *env = getenv("HOST_LOG_LEVEL");
+    return env != NULL ? (esp_log_level_t)atoi(env) : (esp_log_level_t)CONFIG_LOG_DEFAULT_LEVEL;
+}
+
+esp_log_level_t host_log_level = (esp_log_level_t)CONFIG_LOG_DEFAULT_LEVEL;
+
+__attribute__((constructor)) static void host_log_init(void)
+{
+    host_log_level = initial_log_level();
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;
+    host_log_level = level;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+void host_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "NEWIDV";
+    va_list args;
+
+    flockfile(stderr);
+    fprintf(stderr, "%c (%u) %s: ", letters[level], esp_log_timestamp(), tag);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+    funlockfile(stderr);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    va_list args;
+    (void)tag;
+    if (host_log_level < level)
+        return;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+/*****************************************************
+ *   esp_timer / esp_random                           *
+ ******************************************************/
+static struct timespec timer_start;
+static pthread_once_t timer_start_once = PTHREAD_ONCE_INIT;
+
+static void init_timer_start(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &timer_start);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec now;
+
+    pthread_once(&timer_start_once, init_timer_start);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - timer_start.tv_sec) * 1000000LL + (now.tv_nsec - timer_start.tv_nsec) / 1000;
+}
+
+static uint64_t random_state = 0x9E3779B97F4A7C15ULL;
+
+void host_mock_seed_random(uint64_t seed)
+{
+    random_state = seed != 0 ? seed : 0x9E3779B97F4A7C15ULL;
+}
+
+uint32_t esp_random(void)
+{
+    // xorshift64*; el estado es compartido, como el RNG de hardware.
+    uint64_t x = __atomic_load_n(&random_state, __ATOMIC_RELAXED);
+    uint64_t next;
+    do
+    {
+        next = x;
+        next ^= next >> 12;
+        next ^= next << 25;
+        next ^= next >> 27;
+    } while (!__atomic_compare_exchange_n(&random_state, &x, next, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return (uint32_t)((next * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+void esp_fill_random(void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    while (len > 0)
+    {
+        uint32_t r = esp_random();
+        size_t n = len < sizeof(r) ? len : sizeof(r);
+        memcpy(p, &r, n);
+        p += n;
+        len -= n;
+    }
+}
+
+/*****************************************************
+ *   esp_system / esp_sleep                           *
+ ******************************************************/
+static esp_reset_reason_t reset_reason = ESP_RST_POWERON;
+
+void host_mock_set_reset_reason(esp_reset_reason_t reason)
+{
+    reset_reason = reason;
+}
+
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return reset_reason;
+}
+
+void esp_restart(void)
+{
+    ESP_LOGW("host", "esp_restart()");
+    exit(0);
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return 0;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return 0;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return 0;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    return 0;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return 0;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void)
+{
+    return reset_reason == ESP_RST_DEEPSLEEP ? ESP_SLEEP_WAKEUP_TIMER : ESP_SLEEP_WAKEUP_UNDEFINED;
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us)
+{
+    (void)time_in_us;
+    return ESP_OK;
+}
+
+void esp_deep_sleep_start(void)
+{
+    ESP_LOGW("host", "esp_deep_sleep_start()");
+    exit(0);
+}
+
+#ifndef HOST_APP_VERSION
+#define HOST_APP_VERSION "host"
+#endif
+
+const esp_app_desc_t *esp_app_get_description(void)
+{
+    static const esp_app_desc_t desc = {
+        .version = HOST_APP_VERSION,
+        .project_name = "WiFi_base",
+        .time = __TIME__,
+        .date = __DATE__,
+    };
+    return &desc;
+}
+
+/*****************************************************
+ *   esp_event (loop por defecto, despacho sincronico)*
+ ******************************************************/
+#define HOST_EVENT_MAX_HANDLERS 32
+
+typedef struct
+{
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+} event_handler_entry_t;
+
+static event_handler_entry_t event_handlers[HOST_EVENT_MAX_HANDLERS];
+static pthread_mutex_t event_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler,
+                                     void *event_handler_arg)
+{
+    esp_err_t err = ESP_ERR_NO_MEM;
+
+    pthread_mutex_lock(&event_mutex);
+    for (int i = 0; i < HOST_EVENT_MAX_HANDLERS; i++)
+    {
+        if (event_handlers[i].handler == NULL)
+        {
+            event_handlers[i] = (event_handler_entry_t){event_base, event_id, event_handler, event_handler_arg};
+            err = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&event_mutex);
+    return err;
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler,
+                                              void *event_handler_arg, esp_event_handler_instance_t *instance)
+{
+    if (instance != NULL)
+        *instance = (void *)event_handler;
+    return esp_event_handler_register(event_base, event_id, event_handler, event_handler_arg);
+}
+
+esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler)
+{
+    pthread_mutex_lock(&event_mutex);
+    for (int i = 0; i < HOST_EVENT_MAX_HANDLERS; i++)
+    {
+        if (event_handlers[i].handler == event_handler && event_handlers[i].base == event_base && event_handlers[i].id == event_id)
+            memset(&event_handlers[i], 0, sizeof(event_handlers[i]));
+    }
+    pthread_mutex_unlock(&event_mutex);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, const void *event_data, size_t event_data_size,
+                         TickType_t ticks_to_wait)
+{
+    event_handler_entry_t matched[HOST_EVENT_MAX_HANDLERS];
+    int count = 0;
+    (void)event_data_size;
+    (void)ticks_to_wait;
+
+    // Se copian los handlers para poder despachar sin tener el mutex tomado.
+    pthread_mutex_lock(&event_mutex);
+    for (int i = 0; i < HOST_EVENT_MAX_HANDLERS; i++)
+    {
+        event_handler_entry_t *entry = &event_handlers[i];
+        if (entry->handler != NULL && (entry->base == ESP_EVENT_ANY_BASE || entry->base == event_base) &&
+            (entry->id == ESP_EVENT_ANY_ID || entry->id == event_id))
+            matched[count++] = *entry;
+    }
+    pthread_mutex_unlock(&event_mutex);
+
+    for (int i = 0; i < count; i++)
+        matched[i].handler(matched[i].arg, event_base, event_id, (void *)event_data);
+    return ESP_OK;
+}
+
+/*****************************************************
+ *   newlib                                           *
+ ******************************************************/
+#if defined(__GLIBC__) && (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38)
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size > 0)
+    {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = 0;
+    }
+    return len;
+}
+
+size_t strlcat(char *dst, const char *src, size_t size)
+{
+    size_t dst_len = strnlen(dst, size);
+    if (dst_len == size)
+        return size + strlen(src);
+    return dst_len + strlcpy(dst + dst_len, src, size - dst_len);
+}
+#endif
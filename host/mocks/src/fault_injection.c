@@ -0,0 +1,300 @@
+/*
+ * fault_injection.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Estado de fallas que consultan el transporte MQTT y la estacion Wi-Fi
+ *  simulados, y la tarea que ejecuta un guion de fallas (ver host_fault.h).
+ */
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "host_fault.h"
+
+static const char *TAG = "host_fault";
+
+static const char *const action_names[] = {
+    [HOST_FAULT_DROP] = "drop",
+    [HOST_FAULT_CONNACK_DELAY] = "connack_delay",
+    [HOST_FAULT_PUBACK_DELAY] = "puback_delay",
+    [HOST_FAULT_REFUSE_AUTH] = "refuse_auth",
+    [HOST_FAULT_THROTTLE] = "throttle",
+    [HOST_FAULT_WIFI_DOWN] = "wifi_down",
+    [HOST_FAULT_LOST_IP] = "lost_ip",
+    [HOST_FAULT_GOT_IP] = "got_ip",
+    [HOST_FAULT_RSSI] = "rssi",
+    [HOST_FAULT_END] = "end",
+};
+
+static host_fault_step_t steps[HOST_FAULT_MAX_STEPS];
+static int step_count = 0;
+static volatile bool finished = false;
+static host_fault_observer_t step_observer = NULL;
+static void *step_observer_ctx = NULL;
+
+// Estado actual de las fallas
+static pthread_mutex_t fault_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t drop_generation = 0;
+static uint32_t connack_delay_ms = 0;
+static uint32_t puback_delay_ms = 0;
+static bool refuse_auth = false;
+static uint32_t throttle_bps = 0;
+static int64_t throttle_next_us = 0;
+
+const char *host_fault_action_name(host_fault_action_t action)
+{
+    return action <= HOST_FAULT_END ? action_names[action] : "?";
+}
+
+void host_fault_reset(void)
+{
+    pthread_mutex_lock(&fault_mutex);
+    step_count = 0;
+    finished = false;
+    connack_delay_ms = 0;
+    puback_delay_ms = 0;
+    refuse_auth = false;
+    throttle_bps = 0;
+    throttle_next_us = 0;
+    pthread_mutex_unlock(&fault_mutex);
+}
+
+/*****************************************************
+ *   Guion                                            *
+ ******************************************************/
+int host_fault_parse_line(const char *line, host_fault_step_t *step)
+{
+    char action[32];
+    char argument[32] = "";
+    unsigned long at_ms;
+
+    while (isspace((unsigned char)*line))
+        line++;
+    if (*line == 0 || *line == '#')
+        return 0;
+    int fields = sscanf(line, "%lu %31s %31s", &at_ms, action, argument);
+    if (fields < 2)
+        return -1;
+
+    memset(step, 0, sizeof(*step));
+    step->at_ms = (uint32_t)at_ms;
+    for (int i = 0; i <= HOST_FAULT_END; i++)
+    {
+        if (strcmp(action, action_names[i]) != 0)
+            continue;
+        step->action = (host_fault_action_t)i;
+        if (i == HOST_FAULT_REFUSE_AUTH)
+        {
+            if (strcmp(argument, "on") != 0 && strcmp(argument, "off") != 0)
+                return -1;
+            step->value = strcmp(argument, "on") == 0;
+        }
+        else if (i == HOST_FAULT_CONNACK_DELAY || i == HOST_FAULT_PUBACK_DELAY || i == HOST_FAULT_THROTTLE || i == HOST_FAULT_WIFI_DOWN)
+        {
+            if (fields < 3 || !isdigit((unsigned char)argument[0]))
+                return -1;
+            step->value = (uint32_t)strtoul(argument, NULL, 10);
+        }
+        else if (i == HOST_FAULT_RSSI)
+        {
+            if (fields < 3 || (argument[0] != '-' && !isdigit((unsigned char)argument[0])))
+                return -1;
+            step->value = (uint32_t)(int32_t)strtol(argument, NULL, 10);
+        }
+        return 1;
+    }
+    return -1;
+}
+
+int host_fault_load_script(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    char line[256];
+    int line_number = 0;
+
+    if (file == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    host_fault_reset();
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        host_fault_step_t step;
+        line_number++;
+        int rc = host_fault_parse_line(line, &step);
+        if (rc < 0 || (rc > 0 && step_count == HOST_FAULT_MAX_STEPS) ||
+            (rc > 0 && step_count > 0 && step.at_ms < steps[step_count - 1].at_ms))
+        {
+            fclose(file);
+            return line_number;
+        }
+        if (rc > 0)
+            steps[step_count++] = step;
+    }
+    fclose(file);
+    return 0;
+}
+
+int host_fault_step_count(void)
+{
+    return step_count;
+}
+
+const host_fault_step_t *host_fault_get_step(int index)
+{
+    return index >= 0 && index < step_count ? &steps[index] : NULL;
+}
+
+uint32_t host_fault_end_ms(void)
+{
+    for (int i = 0; i < step_count; i++)
+        if (steps[i].action == HOST_FAULT_END)
+            return steps[i].at_ms;
+    return 0;
+}
+
+bool host_fault_finished(void)
+{
+    return finished;
+}
+
+void host_fault_apply(const host_fault_step_t *step)
+{
+    ESP_LOGW(TAG, "%s %d", host_fault_action_name(step->action), (int)(int32_t)step->value);
+
+    pthread_mutex_lock(&fault_mutex);
+    switch (step->action)
+    {
+    case HOST_FAULT_DROP:
+        drop_generation++;
+        break;
+    case HOST_FAULT_CONNACK_DELAY:
+        connack_delay_ms = step->value;
+        break;
+    case HOST_FAULT_PUBACK_DELAY:
+        puback_delay_ms = step->value;
+        break;
+    case HOST_FAULT_REFUSE_AUTH:
+        refuse_auth = step->value != 0;
+        break;
+    case HOST_FAULT_THROTTLE:
+        throttle_bps = step->value;
+        throttle_next_us = 0;
+        break;
+    default:
+        break;
+    }
+    pthread_mutex_unlock(&fault_mutex);
+
+    // Los eventos se publican fuera del mutex: los handlers consultan el estado
+    switch (step->action)
+    {
+    case HOST_FAULT_WIFI_DOWN:
+        host_mock_wifi_ap_down(step->value);
+        break;
+    case HOST_FAULT_LOST_IP:
+        host_mock_wifi_set_ip(false);
+        break;
+    case HOST_FAULT_GOT_IP:
+        host_mock_wifi_set_ip(true);
+        break;
+    case HOST_FAULT_RSSI:
+        host_mock_set_rssi((int8_t)(int32_t)step->value);
+        break;
+    default:
+        break;
+    }
+}
+
+static void *script_task(void *arg)
+{
+    (void)arg;
+    int64_t start_us = esp_timer_get_time();
+
+    for (int i = 0; i < step_count; i++)
+    {
+        int64_t due_us = start_us + steps[i].at_ms * 1000LL;
+        int64_t wait_us;
+        while ((wait_us = due_us - esp_timer_get_time()) > 0)
+            usleep(wait_us < 100000 ? wait_us : 100000);
+
+        if (steps[i].action != HOST_FAULT_END)
+            host_fault_apply(&steps[i]);
+        if (step_observer != NULL)
+            step_observer(&steps[i], esp_timer_get_time(), step_observer_ctx);
+        if (steps[i].action == HOST_FAULT_END)
+            break;
+    }
+    finished = true;
+    return NULL;
+}
+
+/* Ejecuta el guion cargado en una tarea propia; los tiempos son relativos a esta llamada */
+void host_fault_start(host_fault_observer_t observer, void *ctx)
+{
+    pthread_t thread;
+
+    step_observer = observer;
+    step_observer_ctx = ctx;
+    finished = false;
+    if (pthread_create(&thread, NULL, script_task, NULL) == 0)
+        pthread_detach(thread);
+    else
+        finished = true;
+}
+
+/*****************************************************
+ *   Consultas del transporte                         *
+ ******************************************************/
+bool host_fault_link_up(void)
+{
+    return host_mock_wifi_link_up();
+}
+
+uint32_t host_fault_drop_generation(void)
+{
+    return __atomic_load_n(&drop_generation, __ATOMIC_RELAXED);
+}
+
+uint32_t host_fault_connack_delay_ms(void)
+{
+    return __atomic_load_n(&connack_delay_ms, __ATOMIC_RELAXED);
+}
+
+uint32_t host_fault_puback_delay_ms(void)
+{
+    return __atomic_load_n(&puback_delay_ms, __ATOMIC_RELAXED);
+}
+
+bool host_fault_refuse_auth(void)
+{
+    return __atomic_load_n(&refuse_auth, __ATOMIC_RELAXED);
+}
+
+/* Cubeta de tiempo: cada envio corre el proximo instante libre en bytes / bps */
+void host_fault_throttle(size_t bytes)
+{
+    pthread_mutex_lock(&fault_mutex);
+    if (throttle_bps == 0)
+    {
+        pthread_mutex_unlock(&fault_mutex);
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    int64_t start = throttle_next_us > now ? throttle_next_us : now;
+    throttle_next_us = start + (int64_t)bytes * 1000000LL / throttle_bps;
+    int64_t wait_us = throttle_next_us - now;
+    pthread_mutex_unlock(&fault_mutex);
+
+    if (wait_us > 0)
+        usleep(wait_us);
+}
@@ -0,0 +1,603 @@
+/*
+ * freertos_host.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Tareas, grupos de eventos, colas y semaforos de FreeRTOS sobre pthreads.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#define QUEUE_TYPE_QUEUE 0
+#define QUEUE_TYPE_MUTEX 1
+#define QUEUE_TYPE_RECURSIVE_MUTEX 2
+#define QUEUE_TYPE_SEMAPHORE 3
+
+/* Los hilos del host usan mas stack que las tareas del ESP32 (glibc): */
+/* se reserva holgado y solo se ocupan las paginas que se tocan        */
+#define HOST_TASK_STACK_FACTOR 4
+#define HOST_TASK_STACK_MIN (512 * 1024)
+
+static pthread_mutex_t critical_mutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static __thread TaskHandle_t current_task = NULL;
+static struct timespec start_time;
+static pthread_once_t start_time_once = PTHREAD_ONCE_INIT;
+
+int host_num_processors(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
+static void init_start_time(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+}
+
+/* Plazo absoluto (CLOCK_MONOTONIC) a partir de un timeout en ticks */
+static struct timespec deadline_from_ticks(TickType_t ticks)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ms = pdTICKS_TO_MS(ticks);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+static void init_cond(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/* Espera en cond hasta deadline; con portMAX_DELAY espera indefinidamente */
+static int cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, TickType_t ticks, const struct timespec *deadline)
+{
+    if (ticks == portMAX_DELAY)
+        return pthread_cond_wait(cond, mutex);
+    return pthread_cond_timedwait(cond, mutex, deadline);
+}
+
+void host_enter_critical(void)
+{
+    pthread_mutex_lock(&critical_mutex);
+}
+
+void host_exit_critical(void)
+{
+    pthread_mutex_unlock(&critical_mutex);
+}
+
+/*****************************************************
+ *   Tareas                                           *
+ ******************************************************/
+/* Stack en cero con una pagina de guarda abajo */
+static bool map_stack(TaskHandle_t task, uint32_t stack_depth)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t bytes = (size_t)stack_depth * HOST_TASK_STACK_FACTOR;
+    if (bytes < HOST_TASK_STACK_MIN)
+        bytes = HOST_TASK_STACK_MIN;
+    bytes = (bytes + page - 1) / page * page;
+
+    uint8_t *base = mmap(NULL, bytes + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK,
+                         -1, 0);
+    if (base == MAP_FAILED)
+        return false;
+    mprotect(base, page, PROT_NONE);
+    task->stack_base = base + page;
+    task->stack_bytes = bytes;
+    return true;
+}
+
+/* Bytes del stack del hilo que ya se escribieron (lo de abajo sigue en cero) */
+static size_t stack_used(TaskHandle_t task)
+{
+    const uint64_t *words = task->stack_base;
+    size_t count = task->stack_bytes / sizeof(uint64_t);
+    size_t untouched = 0;
+    while (untouched < count && words[untouched] == 0)
+        untouched++;
+    return task->stack_bytes - untouched * sizeof(uint64_t);
+}
+
+static void *task_entry(void *arg)
+{
+    TaskHandle_t task = arg;
+    current_task = task;
+    if (task->stack_base != NULL)
+        task->stack_overhead = stack_used(task);
+    task->function(task->param);
+    return NULL;
+}
+
+static BaseType_t start_task(TaskHandle_t task, TaskFunction_t function, const char *name, uint32_t stack_depth, void *param)
+{
+    pthread_t thread;
+    pthread_attr_t attr;
+
+    task->function = function;
+    task->param = param;
+    task->stack_depth = stack_depth;
+    strncpy(task->name, name != NULL ? name : "", sizeof(task->name) - 1);
+    task->name[sizeof(task->name) - 1] = 0;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    // El stack no se libera: como el handle, puede seguir consultandose tras vTaskDelete
+    if (map_stack(task, stack_depth))
+        pthread_attr_setstack(&attr, task->stack_base, task->stack_bytes);
+    int rc = pthread_create(&thread, &attr, task_entry, task);
+    pthread_attr_destroy(&attr);
+    if (rc != 0)
+        return pdFAIL;
+    task->thread = (unsigned long)thread;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *param,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    (void)priority;
+    TaskHandle_t task = calloc(1, sizeof(*task));
+    if (task == NULL)
+        return pdFAIL;
+    if (start_task(task, function, name, stack_depth, param) != pdPASS)
+    {
+        free(task);
+        return pdFAIL;
+    }
+    if (handle != NULL)
+        *handle = task;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth, void *param,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core_id)
+{
+    (void)core_id;
+    return xTaskCreate(function, name, stack_depth, param, priority, handle);
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t function, const char *name, uint32_t stack_depth, void *param,
+                               UBaseType_t priority, StackType_t *stack, StaticTask_t *task_buffer)
+{
+    (void)priority;
+    (void)stack;
+    memset(task_buffer, 0, sizeof(*task_buffer));
+    task_buffer->is_static = true;
+    return start_task(task_buffer, function, name, stack_depth, param) == pdPASS ? task_buffer : NULL;
+}
+
+/* Las tareas dinamicas no se liberan: otro hilo puede conservar el handle */
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == current_task)
+        pthread_exit(NULL);
+    pthread_cancel((pthread_t)task->thread);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    uint64_t ms = pdTICKS_TO_MS(ticks);
+    struct timespec ts = {.tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L};
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+        ;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec now;
+    pthread_once(&start_time_once, init_start_time);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t ms = (now.tv_sec - start_time.tv_sec) * 1000ULL + (now.tv_nsec - start_time.tv_nsec) / 1000000LL;
+    return pdMS_TO_TICKS(ms);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current_task;
+}
+
+const char *pcTaskGetName(TaskHandle_t task)
+{
+    if (task == NULL)
+        task = current_task;
+    return task != NULL ? task->name : "main";
+}
+
+/************************************************************************/
+/* Stack libre minimo, en bytes como en el ESP-IDF: el tamano pedido    */
+/* menos lo que el hilo llego a escribir desde que arranco. La cifra es */
+/* orientativa: el codigo del host y glibc no consumen lo mismo que en  */
+/* el ESP32, y tiende a exagerar el uso.                                */
+/************************************************************************/
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    if (task == NULL)
+        task = current_task;
+    if (task == NULL || task->stack_base == NULL)
+        return 0;
+    size_t used = stack_used(task) - task->stack_overhead;
+    return used < task->stack_depth ? task->stack_depth - used : 0;
+}
+
+void taskYIELD(void)
+{
+    sched_yield();
+}
+
+/************************************************************************/
+/* Estadisticas de tiempo de ejecucion. Los hilos de las tareas miden   */
+/* su propio tiempo de CPU; la tarea idle es una sola, la del nucleo 0, */
+/* y su contador es el tiempo transcurrido menos el de CPU del proceso. */
+/************************************************************************/
+static StaticTask_t idle_task = {.name = "IDLE"};
+
+TaskHandle_t xTaskGetIdleTaskHandleForCore(BaseType_t core_id)
+{
+    return core_id == 0 ? &idle_task : NULL;
+}
+
+static uint64_t clock_us(clockid_t clock)
+{
+    struct timespec ts;
+    if (clock_gettime(clock, &ts) != 0)
+        return 0;
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+configRUN_TIME_COUNTER_TYPE ulTaskGetRunTimeCounter(const TaskHandle_t task)
+{
+    if (task == &idle_task)
+    {
+        pthread_once(&start_time_once, init_start_time);
+        uint64_t start_us = start_time.tv_sec * 1000000ULL + start_time.tv_nsec / 1000;
+        uint64_t elapsed = clock_us(CLOCK_MONOTONIC) - start_us;
+        uint64_t busy = clock_us(CLOCK_PROCESS_CPUTIME_ID);
+        return (configRUN_TIME_COUNTER_TYPE)(elapsed > busy ? elapsed - busy : 0);
+    }
+    clockid_t clock;
+    if (task == NULL || pthread_getcpuclockid((pthread_t)task->thread, &clock) != 0)
+        return 0;
+    return (configRUN_TIME_COUNTER_TYPE)clock_us(clock);
+}
+
+/*****************************************************
+ *   Grupos de eventos                                *
+ ******************************************************/
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *buffer)
+{
+    pthread_mutex_init(&buffer->mutex, NULL);
+    init_cond(&buffer->cond);
+    buffer->bits = 0;
+    buffer->is_static = true;
+    return buffer;
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    StaticEventGroup_t *group = malloc(sizeof(*group));
+    if (group == NULL)
+        return NULL;
+    xEventGroupCreateStatic(group);
+    group->is_static = false;
+    return group;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+    pthread_cond_destroy(&group->cond);
+    pthread_mutex_destroy(&group->mutex);
+    if (!group->is_static)
+        free(group);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&group->mutex);
+    group->bits |= bits;
+    EventBits_t result = group->bits;
+    pthread_cond_broadcast(&group->cond);
+    pthread_mutex_unlock(&group->mutex);
+    return result;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&group->mutex);
+    EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->mutex);
+    return previous;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    pthread_mutex_lock(&group->mutex);
+    EventBits_t result = group->bits;
+    pthread_mutex_unlock(&group->mutex);
+    return result;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks_to_wait)
+{
+    struct timespec deadline = deadline_from_ticks(ticks_to_wait);
+
+    pthread_mutex_lock(&group->mutex);
+    for (;;)
+    {
+        EventBits_t match = group->bits & bits;
+        if (wait_for_all ? match == bits : match != 0)
+            break;
+        if (ticks_to_wait == 0 || cond_wait(&group->cond, &group->mutex, ticks_to_wait, &deadline) == ETIMEDOUT)
+            break;
+    }
+    EventBits_t result = group->bits;
+    EventBits_t match = result & bits;
+    if (clear_on_exit && (wait_for_all ? match == bits : match != 0))
+        group->bits &= ~bits;
+    pthread_mutex_unlock(&group->mutex);
+    return result;
+}
+
+/*****************************************************
+ *   Colas                                            *
+ ******************************************************/
+static QueueHandle_t queue_init(StaticQueue_t *queue, UBaseType_t length, UBaseType_t item_size, uint8_t *storage, int type)
+{
+    memset(queue, 0, sizeof(*queue));
+    pthread_mutex_init(&queue->mutex, NULL);
+    init_cond(&queue->not_empty);
+    init_cond(&queue->not_full);
+    queue->storage = storage;
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->type = type;
+    return queue;
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *storage, StaticQueue_t *buffer)
+{
+    queue_init(buffer, length, item_size, storage, QUEUE_TYPE_QUEUE);
+    buffer->is_static = true;
+    return buffer;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    StaticQueue_t *queue = malloc(sizeof(*queue));
+    uint8_t *storage = item_size > 0 ? malloc((size_t)length * item_size) : NULL;
+    if (queue == NULL || (item_size > 0 && storage == NULL))
+    {
+        free(queue);
+        free(storage);
+        return NULL;
+    }
+    return queue_init(queue, length, item_size, storage, QUEUE_TYPE_QUEUE);
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    pthread_mutex_destroy(&queue->mutex);
+    if (!queue->is_static)
+    {
+        free(queue->storage);
+        free(queue);
+    }
+}
+
+static BaseType_t queue_send(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait, bool to_front)
+{
+    struct timespec deadline = deadline_from_ticks(ticks_to_wait);
+
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == queue->length)
+    {
+        if (ticks_to_wait == 0 || cond_wait(&queue->not_full, &queue->mutex, ticks_to_wait, &deadline) == ETIMEDOUT)
+        {
+            pthread_mutex_unlock(&queue->mutex);
+            return errQUEUE_FULL;
+        }
+    }
+    UBaseType_t index;
+    if (to_front)
+    {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        index = queue->head;
+    }
+    else
+        index = (queue->head + queue->count) % queue->length;
+    if (queue->item_size > 0)
+        memcpy(queue->storage + (size_t)index * queue->item_size, item, queue->item_size);
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdPASS;
+}
+
+static BaseType_t queue_receive(QueueHandle_t queue, void *item, TickType_t ticks_to_wait, bool peek)
+{
+    struct timespec deadline = deadline_from_ticks(ticks_to_wait);
+
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == 0)
+    {
+        if (ticks_to_wait == 0 || cond_wait(&queue->not_empty, &queue->mutex, ticks_to_wait, &deadline) == ETIMEDOUT)
+        {
+            pthread_mutex_unlock(&queue->mutex);
+            return errQUEUE_EMPTY;
+        }
+    }
+    if (queue->item_size > 0 && item != NULL)
+        memcpy(item, queue->storage + (size_t)queue->head * queue->item_size, queue->item_size);
+    if (!peek)
+    {
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    return queue_send(queue, item, ticks_to_wait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    return queue_send(queue, item, ticks_to_wait, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks_to_wait)
+{
+    return queue_receive(queue, item, ticks_to_wait, false);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks_to_wait)
+{
+    return queue_receive(queue, item, ticks_to_wait, true);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    queue->head = 0;
+    queue->count = 0;
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->mutex);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    UBaseType_t spaces = queue->length - queue->count;
+    pthread_mutex_unlock(&queue->mutex);
+    return spaces;
+}
+
+/*****************************************************
+ *   Semaforos (colas de items de tamaño 0)           *
+ ******************************************************/
+static SemaphoreHandle_t semaphore_init(StaticSemaphore_t *buffer, UBaseType_t max_count, UBaseType_t initial_count, int type, bool is_static)
+{
+    queue_init(buffer, max_count, 0, NULL, type);
+    buffer->count = initial_count;
+    buffer->is_static = is_static;
+    return buffer;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer)
+{
+    return semaphore_init(buffer, 1, 1, QUEUE_TYPE_MUTEX, true);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    StaticSemaphore_t *buffer = malloc(sizeof(*buffer));
+    return buffer != NULL ? semaphore_init(buffer, 1, 1, QUEUE_TYPE_MUTEX, false) : NULL;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    StaticSemaphore_t *buffer = malloc(sizeof(*buffer));
+    return buffer != NULL ? semaphore_init(buffer, 1, 1, QUEUE_TYPE_RECURSIVE_MUTEX, false) : NULL;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer)
+{
+    return semaphore_init(buffer, 1, 0, QUEUE_TYPE_SEMAPHORE, true);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    StaticSemaphore_t *buffer = malloc(sizeof(*buffer));
+    return buffer != NULL ? semaphore_init(buffer, 1, 0, QUEUE_TYPE_SEMAPHORE, false) : NULL;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t max_count, UBaseType_t initial_count, StaticSemaphore_t *buffer)
+{
+    return semaphore_init(buffer, max_count, initial_count, QUEUE_TYPE_SEMAPHORE, true);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    StaticSemaphore_t *buffer = malloc(sizeof(*buffer));
+    return buffer != NULL ? semaphore_init(buffer, max_count, initial_count, QUEUE_TYPE_SEMAPHORE, false) : NULL;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait)
+{
+    if (queue_receive(semaphore, NULL, ticks_to_wait, false) != pdPASS)
+        return pdFALSE;
+    semaphore->owner = pthread_self();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    return queue_send(semaphore, NULL, 0, false);
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait)
+{
+    if (semaphore->recursion > 0 && pthread_equal(semaphore->owner, pthread_self()))
+    {
+        semaphore->recursion++;
+        return pdTRUE;
+    }
+    if (xSemaphoreTake(semaphore, ticks_to_wait) != pdTRUE)
+        return pdFALSE;
+    semaphore->recursion = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore)
+{
+    if (semaphore->recursion == 0 || !pthread_equal(semaphore->owner, pthread_self()))
+        return pdFALSE;
+    if (--semaphore->recursion > 0)
+        return pdTRUE;
+    return xSemaphoreGive(semaphore);
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t semaphore)
+{
+    return uxQueueMessagesWaiting(semaphore);
+}
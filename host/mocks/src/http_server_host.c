@@ -0,0 +1,313 @@
+/*
+ * http_server_host.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Servidor esp_http_server simulado: un hilo por servidor que acepta en
+ *  127.0.0.1, atiende un pedido por conexion y la cierra. Alcanza para
+ *  consultar los manejadores del firmware con curl o un scraper.
+ */
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "esp_http_server.h"
+#include "esp_log.h"
+
+#define HOST_HTTPD_REQUEST_MAX 2048
+#define HOST_HTTPD_HEADERS_MAX 512
+
+static const char *TAG = "httpd_host";
+
+typedef struct
+{
+    int listen_fd;
+    pthread_t thread;
+    httpd_config_t config;
+    httpd_uri_t *handlers;
+    size_t handler_count;
+} host_httpd_t;
+
+/* Estado de la respuesta en curso; httpd_req_t.aux apunta aca */
+typedef struct
+{
+    int fd;
+    const char *status;
+    const char *type;
+    char headers[HOST_HTTPD_HEADERS_MAX];
+    size_t headers_len;
+    bool started;  // Cabeceras enviadas
+    bool chunked;
+    bool finished;
+    bool failed;
+} host_response_t;
+
+static host_response_t *response_of(httpd_req_t *r)
+{
+    return (host_response_t *)r->aux;
+}
+
+static bool write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static esp_err_t send_headers(host_response_t *response, bool chunked, size_t content_len)
+{
+    char head[HOST_HTTPD_HEADERS_MAX + 256];
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Type: %s\r\n%.*s", response->status, response->type,
+                     (int)response->headers_len, response->headers);
+    if (chunked)
+        n += snprintf(head + n, sizeof(head) - n, "Transfer-Encoding: chunked\r\n");
+    else
+        n += snprintf(head + n, sizeof(head) - n, "Content-Length: %zu\r\n", content_len);
+    n += snprintf(head + n, sizeof(head) - n, "Connection: close\r\n\r\n");
+    response->started = true;
+    response->chunked = chunked;
+    if (!write_all(response->fd, head, n))
+    {
+        response->failed = true;
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return ESP_OK;
+}
+
+/*****************************************************
+ *   Respuestas                                       *
+ ******************************************************/
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status)
+{
+    response_of(r)->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type)
+{
+    response_of(r)->type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value)
+{
+    host_response_t *response = response_of(r);
+    int n = snprintf(response->headers + response->headers_len, sizeof(response->headers) - response->headers_len,
+                     "%s: %s\r\n", field, value);
+    if (n < 0 || response->headers_len + n >= sizeof(response->headers))
+        return ESP_ERR_HTTPD_RESP_SEND;
+    response->headers_len += n;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    host_response_t *response = response_of(r);
+    if (response->started)
+        return ESP_ERR_HTTPD_INVALID_REQ;
+    size_t len = buf == NULL ? 0 : buf_len == HTTPD_RESP_USE_STRLEN ? strlen(buf) : (size_t)buf_len;
+    esp_err_t err = send_headers(response, false, len);
+    response->finished = true;
+    if (err == ESP_OK && len > 0 && !write_all(response->fd, buf, len))
+        err = ESP_ERR_HTTPD_RESP_SEND;
+    return err;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    host_response_t *response = response_of(r);
+    if (response->failed || response->finished)
+        return ESP_ERR_HTTPD_RESP_SEND;
+    if (!response->started && send_headers(response, true, 0) != ESP_OK)
+        return ESP_ERR_HTTPD_RESP_SEND;
+
+    size_t len = buf == NULL ? 0 : buf_len == HTTPD_RESP_USE_STRLEN ? strlen(buf) : (size_t)buf_len;
+    char size_line[16];
+    int n = snprintf(size_line, sizeof(size_line), "%zx\r\n", len);
+    bool ok = write_all(response->fd, size_line, n) && write_all(response->fd, buf, len) && write_all(response->fd, "\r\n", 2);
+    if (len == 0)
+        response->finished = true;
+    if (!ok)
+    {
+        response->failed = true;
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg)
+{
+    static const char *const statuses[] = {
+        [HTTPD_400_BAD_REQUEST] = HTTPD_400,
+        [HTTPD_403_FORBIDDEN] = "403 Forbidden",
+        [HTTPD_404_NOT_FOUND] = HTTPD_404,
+        [HTTPD_500_INTERNAL_SERVER_ERROR] = HTTPD_500,
+    };
+    httpd_resp_set_status(req, statuses[error]);
+    httpd_resp_set_type(req, "text/plain");
+    return httpd_resp_send(req, msg != NULL ? msg : statuses[error], HTTPD_RESP_USE_STRLEN);
+}
+
+int httpd_req_to_sockfd(httpd_req_t *r)
+{
+    return response_of(r)->fd;
+}
+
+/*****************************************************
+ *   Servidor                                         *
+ ******************************************************/
+static int parse_method(const char *method)
+{
+    static const char *const names[] = {[HTTP_DELETE] = "DELETE", [HTTP_GET] = "GET", [HTTP_HEAD] = "HEAD",
+                                        [HTTP_POST] = "POST", [HTTP_PUT] = "PUT"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+        if (strcmp(method, names[i]) == 0)
+            return (int)i;
+    return -1;
+}
+
+static void serve_connection(host_httpd_t *server, int fd)
+{
+    char request[HOST_HTTPD_REQUEST_MAX + 1];
+    size_t len = 0;
+    while (len < HOST_HTTPD_REQUEST_MAX)
+    {
+        ssize_t n = recv(fd, request + len, HOST_HTTPD_REQUEST_MAX - len, 0);
+        if (n <= 0)
+            return;
+        len += n;
+        request[len] = 0;
+        if (strstr(request, "\r\n\r\n") != NULL)
+            break;
+    }
+
+    char method_name[8], path[HTTPD_MAX_URI_LEN + 1];
+    httpd_req_t req = {.handle = server};
+    host_response_t response = {.fd = fd, .status = HTTPD_200, .type = HTTPD_TYPE_TEXT};
+    req.aux = &response;
+    if (sscanf(request, "%7s %512s", method_name, path) != 2)
+    {
+        httpd_resp_send_err(&req, HTTPD_400_BAD_REQUEST, NULL);
+        return;
+    }
+    req.method = parse_method(method_name);
+    strcpy((char *)req.uri, path);
+
+    size_t path_len = strcspn(path, "?");
+    const httpd_uri_t *handler = NULL;
+    for (size_t i = 0; i < server->handler_count; i++)
+    {
+        const httpd_uri_t *candidate = &server->handlers[i];
+        if ((int)candidate->method == req.method && strlen(candidate->uri) == path_len &&
+            memcmp(candidate->uri, path, path_len) == 0)
+            handler = candidate;
+    }
+    if (handler == NULL)
+    {
+        httpd_resp_send_err(&req, HTTPD_404_NOT_FOUND, NULL);
+        return;
+    }
+
+    req.user_ctx = handler->user_ctx;
+    esp_err_t err = handler->handler(&req);
+    if (err != ESP_OK && !response.started)
+        httpd_resp_send_err(&req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    else if (err != ESP_OK || (response.chunked && !response.finished))
+        ESP_LOGW(TAG, "%s: respuesta incompleta", path);
+}
+
+static void *server_thread(void *arg)
+{
+    host_httpd_t *server = arg;
+    while (true)
+    {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break; // httpd_stop() cerro el socket
+        }
+        serve_connection(server, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
+{
+    host_httpd_t *server = calloc(1, sizeof(*server));
+    if (server == NULL)
+        return ESP_ERR_NO_MEM;
+    server->config = *config;
+    server->handlers = calloc(config->max_uri_handlers, sizeof(*server->handlers));
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(config->server_port)};
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int reuse = 1;
+    if (server->handlers == NULL || server->listen_fd < 0 ||
+        setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+        bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(server->listen_fd, config->backlog_conn) != 0)
+    {
+        ESP_LOGE(TAG, "No se pudo escuchar en el puerto %u: %s", config->server_port, strerror(errno));
+        if (server->listen_fd >= 0)
+            close(server->listen_fd);
+        free(server->handlers);
+        free(server);
+        return ESP_ERR_HTTPD_TASK;
+    }
+    if (pthread_create(&server->thread, NULL, server_thread, server) != 0)
+    {
+        close(server->listen_fd);
+        free(server->handlers);
+        free(server);
+        return ESP_ERR_HTTPD_TASK;
+    }
+    ESP_LOGI(TAG, "Escuchando en 127.0.0.1:%u", config->server_port);
+    *handle = server;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle)
+{
+    host_httpd_t *server = handle;
+    if (server == NULL)
+        return ESP_ERR_INVALID_ARG;
+    shutdown(server->listen_fd, SHUT_RDWR);
+    close(server->listen_fd);
+    pthread_join(server->thread, NULL);
+    free(server->handlers);
+    free(server);
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler)
+{
+    host_httpd_t *server = handle;
+    if (server == NULL || uri_handler == NULL)
+        return ESP_ERR_INVALID_ARG;
+    for (size_t i = 0; i < server->handler_count; i++)
+        if (strcmp(server->handlers[i].uri, uri_handler->uri) == 0 && server->handlers[i].method == uri_handler->method)
+            return ESP_ERR_HTTPD_HANDLER_EXISTS;
+    if (server->handler_count >= server->config.max_uri_handlers)
+        return ESP_ERR_HTTPD_HANDLERS_FULL;
+    // Se registra antes de aceptar conexiones (igual que en el ESP-IDF, sin sincronizar)
+    server->handlers[server->handler_count++] = *uri_handler;
+    return ESP_OK;
+}
@@ -0,0 +1,734 @@
+/*
+ * mqtt_client_host.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Cliente esp-mqtt simulado, con dos transportes segun la URI del broker:
+ *
+ *  - "mqtt://host:puerto": MQTT 3.1.1 sobre TCP contra un broker local, con
+ *    una tarea por cliente como esp-mqtt: reconexion automatica cada
+ *    reconnect_timeout_ms, keepalive, outbox de QoS 1 que se reenvia (DUP)
+ *    al reconectar y vence a los HOST_MQTT_OUTBOX_EXPIRE_MS. Cada conexion,
+ *    envio y paquete recibido pasa por host_fault.
+ *  - Cualquier otra (mqtts://, sin TLS en el host): sin red. start() entrega
+ *    CONNECTED y cada publicacion con QoS>0 entrega PUBLISHED en el mismo
+ *    hilo; lo usan los benchmarks.
+ */
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "host_fault.h"
+#include "mqtt_client.h"
+#include "mqtt_wire.h"
+
+#define HOST_MQTT_DEFAULT_KEEPALIVE_S 120
+#define HOST_MQTT_DEFAULT_RECONNECT_MS 10000
+#define HOST_MQTT_DEFAULT_TIMEOUT_MS 10000
+#define HOST_MQTT_OUTBOX_EXPIRE_MS 30000
+#define HOST_MQTT_RX_BUFFER_SIZE 4096
+#define HOST_MQTT_TX_BUFFER_SIZE 2048
+#define HOST_MQTT_MAX_DELAYED_ACKS 64
+#define HOST_MQTT_POLL_MS 10
+#define HOST_MQTT_CRED_MAX_LEN 1024
+
+static const char *TAG = "mqtt_client_host";
+
+typedef enum
+{
+    TRANSPORT_DISCONNECTED = 0,
+    TRANSPORT_WAIT_CONNACK,
+    TRANSPORT_CONNECTED,
+} transport_state_t;
+
+/* Publicacion QoS 1 sin PUBACK todavia */
+typedef struct outbox_entry
+{
+    struct outbox_entry *next;
+    int msg_id;
+    int64_t created_us;
+    size_t len;
+    uint8_t packet[];
+} outbox_entry_t;
+
+typedef struct
+{
+    int msg_id;
+    int64_t due_us;
+} delayed_ack_t;
+
+struct esp_mqtt_client
+{
+    esp_mqtt_client_config_t config;
+    esp_event_handler_t handler;
+    void *handler_arg;
+    int next_msg_id;
+    bool started;
+
+    // Transporte TCP
+    bool tcp;
+    char host[128];
+    char port[8];
+    char client_id[HOST_MQTT_CRED_MAX_LEN];
+    char username[HOST_MQTT_CRED_MAX_LEN];
+    char password[HOST_MQTT_CRED_MAX_LEN];
+    pthread_t thread;
+    pthread_mutex_t lock;
+    int fd;
+    transport_state_t state;
+    uint32_t drop_generation;
+    bool send_failed;
+    int64_t last_tx_us;
+    int64_t ping_sent_us;
+    int64_t connack_deadline_us;
+    int64_t connack_due_us;
+    int64_t reconnect_due_us; // Como esp-mqtt: reconnect_timeout_ms desde la desconexion
+    int connack_rc;
+    outbox_entry_t *outbox;
+    delayed_ack_t delayed_acks[HOST_MQTT_MAX_DELAYED_ACKS];
+    int delayed_ack_count;
+    size_t rx_len;
+    uint8_t rx[HOST_MQTT_RX_BUFFER_SIZE];
+    uint8_t tx[HOST_MQTT_TX_BUFFER_SIZE];
+    host_mqtt_stats_t stats;
+};
+
+static host_mqtt_publish_hook_t publish_hook = NULL;
+static host_mqtt_event_observer_t event_observer = NULL;
+static uint32_t publish_count = 0;
+
+void host_mqtt_set_publish_hook(host_mqtt_publish_hook_t hook)
+{
+    publish_hook = hook;
+}
+
+void host_mqtt_set_event_observer(host_mqtt_event_observer_t observer)
+{
+    event_observer = observer;
+}
+
+uint32_t host_mqtt_publish_count(void)
+{
+    return __atomic_load_n(&publish_count, __ATOMIC_RELAXED);
+}
+
+void host_mqtt_get_stats(esp_mqtt_client_handle_t client, host_mqtt_stats_t *stats)
+{
+    if (client->tcp)
+        pthread_mutex_lock(&client->lock);
+    *stats = client->stats;
+    if (client->tcp)
+        pthread_mutex_unlock(&client->lock);
+}
+
+static void dispatch_event(esp_mqtt_event_t *event)
+{
+    esp_mqtt_client_handle_t client = event->client;
+    if (client->handler != NULL)
+        client->handler(client->handler_arg, "MQTT_EVENTS", event->event_id, event);
+    if (event_observer != NULL)
+        event_observer(client, event->event_id, event->msg_id);
+}
+
+void host_mqtt_dispatch(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event_id, int msg_id)
+{
+    esp_mqtt_event_t event = {
+        .event_id = event_id,
+        .client = client,
+        .msg_id = msg_id,
+    };
+    dispatch_event(&event);
+}
+
+/*****************************************************
+ *   Transporte TCP                                   *
+ ******************************************************/
+
+/* "mqtt://host:puerto" -> transporte TCP; el puerto por defecto es 1883 */
+static bool parse_tcp_uri(esp_mqtt_client_handle_t client, const char *uri)
+{
+    if (uri == NULL || strncmp(uri, "mqtt://", 7) != 0)
+        return false;
+    const char *host = uri + 7;
+    const char *colon = strchr(host, ':');
+    size_t host_len = colon != NULL ? (size_t)(colon - host) : strcspn(host, "/");
+    if (host_len == 0 || host_len >= sizeof(client->host))
+        return false;
+    memcpy(client->host, host, host_len);
+    client->host[host_len] = 0;
+    snprintf(client->port, sizeof(client->port), "%.*s", colon != NULL ? (int)strcspn(colon + 1, "/") : 4,
+             colon != NULL ? colon + 1 : "1883");
+    return true;
+}
+
+/* esp-mqtt copia las credenciales: el conector reescribe el JWT en su buffer */
+static void copy_credentials(esp_mqtt_client_handle_t client)
+{
+    strlcpy(client->client_id, client->config.credentials.client_id != NULL ? client->config.credentials.client_id : "", sizeof(client->client_id));
+    strlcpy(client->username, client->config.credentials.username != NULL ? client->config.credentials.username : "", sizeof(client->username));
+    strlcpy(client->password, client->config.credentials.authentication.password != NULL ? client->config.credentials.authentication.password : "", sizeof(client->password));
+}
+
+static int64_t keepalive_us(esp_mqtt_client_handle_t client)
+{
+    int keepalive = client->config.session.keepalive > 0 ? client->config.session.keepalive : HOST_MQTT_DEFAULT_KEEPALIVE_S;
+    return keepalive * 1000000LL;
+}
+
+/* Envio con el lock tomado. Sin enlace falla como un write() sobre un socket sin ruta. */
+static bool transport_send(esp_mqtt_client_handle_t client, const uint8_t *data, size_t len)
+{
+    if (client->fd < 0)
+        return false;
+    if (!host_fault_link_up())
+    {
+        // Como esp-mqtt ante un write() fallido: la tarea aborta la conexion
+        client->send_failed = true;
+        return false;
+    }
+    host_fault_throttle(len);
+    size_t sent = 0;
+    while (sent < len)
+    {
+        ssize_t n = send(client->fd, data + sent, len - sent, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            client->send_failed = true;
+            return false;
+        }
+        sent += n;
+    }
+    client->last_tx_us = esp_timer_get_time();
+    client->stats.bytes_sent += len;
+    return true;
+}
+
+static int reconnect_timeout_ms(esp_mqtt_client_handle_t client)
+{
+    return client->config.network.reconnect_timeout_ms > 0 ? client->config.network.reconnect_timeout_ms : HOST_MQTT_DEFAULT_RECONNECT_MS;
+}
+
+/* Cierra la conexion con el lock tomado; devuelve true si habia una conexion MQTT */
+static bool transport_close(esp_mqtt_client_handle_t client)
+{
+    bool was_connected = client->state == TRANSPORT_CONNECTED;
+    if (client->fd >= 0)
+    {
+        close(client->fd);
+        client->fd = -1;
+    }
+    if (client->state != TRANSPORT_DISCONNECTED)
+        client->stats.disconnects++;
+    client->state = TRANSPORT_DISCONNECTED;
+    client->rx_len = 0;
+    client->send_failed = false;
+    client->delayed_ack_count = 0;
+    client->ping_sent_us = 0;
+    client->connack_due_us = 0;
+    client->reconnect_due_us = esp_timer_get_time() + reconnect_timeout_ms(client) * 1000LL;
+    return was_connected;
+}
+
+static int transport_open(esp_mqtt_client_handle_t client)
+{
+    struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *result = NULL;
+
+    if (!host_fault_link_up())
+        return -1;
+    if (getaddrinfo(client->host, client->port, &hints, &result) != 0 || result == NULL)
+        return -1;
+    int fd = socket(result->ai_family, result->ai_socktype | SOCK_CLOEXEC, result->ai_protocol);
+    if (fd >= 0 && connect(fd, result->ai_addr, result->ai_addrlen) != 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+    if (fd >= 0)
+    {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+static void outbox_expire(esp_mqtt_client_handle_t client, int64_t now)
+{
+    outbox_entry_t **link = &client->outbox;
+    while (*link != NULL)
+    {
+        outbox_entry_t *entry = *link;
+        if (now - entry->created_us > HOST_MQTT_OUTBOX_EXPIRE_MS * 1000LL)
+        {
+            *link = entry->next;
+            client->stats.outbox_expired++;
+            free(entry);
+        }
+        else
+            link = &entry->next;
+    }
+}
+
+static bool outbox_remove(esp_mqtt_client_handle_t client, int msg_id)
+{
+    for (outbox_entry_t **link = &client->outbox; *link != NULL; link = &(*link)->next)
+    {
+        if ((*link)->msg_id == msg_id)
+        {
+            outbox_entry_t *entry = *link;
+            *link = entry->next;
+            free(entry);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Al reconectar se reenvia lo que quedo sin PUBACK, marcado como duplicado */
+static void outbox_resend(esp_mqtt_client_handle_t client)
+{
+    for (outbox_entry_t *entry = client->outbox; entry != NULL; entry = entry->next)
+    {
+        entry->packet[0] |= 0x08;
+        if (!transport_send(client, entry->packet, entry->len))
+            break;
+        client->stats.retransmitted++;
+    }
+}
+
+/* Procesa un paquete del broker con el lock tomado; carga un evento a despachar si corresponde */
+static bool handle_packet(esp_mqtt_client_handle_t client, const mqtt_packet_t *packet, esp_mqtt_event_t *event, uint8_t *data_copy)
+{
+    uint16_t value = 0;
+    int64_t now = esp_timer_get_time();
+
+    switch (packet->type)
+    {
+    case MQTT_PACKET_CONNACK:
+        if (client->state != TRANSPORT_WAIT_CONNACK || mqtt_wire_parse_packet_id(packet, &value) != 0)
+            return false;
+        client->connack_rc = value;
+        client->connack_due_us = now + host_fault_connack_delay_ms() * 1000LL;
+        return false;
+
+    case MQTT_PACKET_PUBACK:
+        if (mqtt_wire_parse_packet_id(packet, &value) != 0 || client->delayed_ack_count == HOST_MQTT_MAX_DELAYED_ACKS)
+            return false;
+        client->delayed_acks[client->delayed_ack_count++] = (delayed_ack_t){value, now + host_fault_puback_delay_ms() * 1000LL};
+        return false;
+
+    case MQTT_PACKET_SUBACK:
+        if (mqtt_wire_parse_packet_id(packet, &value) != 0)
+            return false;
+        *event = (esp_mqtt_event_t){.event_id = MQTT_EVENT_SUBSCRIBED, .client = client, .msg_id = value};
+        return true;
+
+    case MQTT_PACKET_PINGRESP:
+        client->ping_sent_us = 0;
+        return false;
+
+    case MQTT_PACKET_PUBLISH:
+    {
+        mqtt_publish_t publish;
+        if (mqtt_wire_parse_publish(packet, &publish) != 0)
+            return false;
+        if (publish.qos > 0)
+        {
+            size_t len = mqtt_wire_puback(client->tx, sizeof(client->tx), publish.packet_id);
+            transport_send(client, client->tx, len);
+        }
+        // El evento apunta a una copia: rx se reacomoda antes de despachar
+        memcpy(data_copy, publish.topic, publish.topic_len);
+        memcpy(data_copy + publish.topic_len, publish.payload, publish.payload_len);
+        *event = (esp_mqtt_event_t){
+            .event_id = MQTT_EVENT_DATA,
+            .client = client,
+            .msg_id = publish.packet_id,
+            .topic = (char *)data_copy,
+            .topic_len = publish.topic_len,
+            .data = (char *)data_copy + publish.topic_len,
+            .data_len = (int)publish.payload_len,
+            .total_data_len = (int)publish.payload_len,
+            .qos = publish.qos,
+        };
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
+static void sleep_ms(int ms)
+{
+    usleep(ms * 1000);
+}
+
+/* Tarea del cliente: conexion, lectura, acks demorados, keepalive y reconexion */
+static void *client_task(void *arg)
+{
+    esp_mqtt_client_handle_t client = arg;
+    static __thread uint8_t data_copy[HOST_MQTT_RX_BUFFER_SIZE];
+
+    while (__atomic_load_n(&client->started, __ATOMIC_ACQUIRE))
+    {
+        int64_t now = esp_timer_get_time();
+        esp_mqtt_event_t events[HOST_MQTT_MAX_DELAYED_ACKS + 2];
+        int event_count = 0;
+        bool disconnected = false;
+
+        pthread_mutex_lock(&client->lock);
+        if (client->state == TRANSPORT_DISCONNECTED)
+        {
+            bool wait_reconnect = now < client->reconnect_due_us;
+            pthread_mutex_unlock(&client->lock);
+            if (wait_reconnect)
+            {
+                sleep_ms(HOST_MQTT_POLL_MS);
+                continue;
+            }
+
+            host_mqtt_dispatch(client, MQTT_EVENT_BEFORE_CONNECT, 0);
+            int fd = transport_open(client);
+            pthread_mutex_lock(&client->lock);
+            client->stats.connect_attempts++;
+            if (fd < 0)
+            {
+                client->stats.transport_errors++;
+                client->reconnect_due_us = esp_timer_get_time() + reconnect_timeout_ms(client) * 1000LL;
+                pthread_mutex_unlock(&client->lock);
+                ESP_LOGW(TAG, "No se pudo conectar a %s:%s", client->host, client->port);
+                host_mqtt_dispatch(client, MQTT_EVENT_ERROR, 0);
+                if (client->config.network.disable_auto_reconnect)
+                    break;
+                continue;
+            }
+            client->fd = fd;
+            client->drop_generation = host_fault_drop_generation();
+            copy_credentials(client);
+            int timeout_ms = client->config.network.timeout_ms > 0 ? client->config.network.timeout_ms : HOST_MQTT_DEFAULT_TIMEOUT_MS;
+            client->connack_deadline_us = esp_timer_get_time() + timeout_ms * 1000LL;
+            size_t len = mqtt_wire_connect(client->tx, sizeof(client->tx), client->client_id, client->username,
+                                           client->password, (uint16_t)(keepalive_us(client) / 1000000));
+            client->state = TRANSPORT_WAIT_CONNACK;
+            if (len == 0 || !transport_send(client, client->tx, len))
+                transport_close(client);
+            pthread_mutex_unlock(&client->lock);
+            continue;
+        }
+        int fd = client->fd;
+        pthread_mutex_unlock(&client->lock);
+
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        int ready = poll(&pfd, 1, HOST_MQTT_POLL_MS);
+        now = esp_timer_get_time();
+
+        pthread_mutex_lock(&client->lock);
+        if (ready > 0 && !host_fault_link_up())
+        {
+            // Sin enlace no llega nada: los datos quedan en el socket
+            pthread_mutex_unlock(&client->lock);
+            sleep_ms(HOST_MQTT_POLL_MS);
+            pthread_mutex_lock(&client->lock);
+        }
+        else if (ready > 0)
+        {
+            ssize_t n = recv(fd, client->rx + client->rx_len, sizeof(client->rx) - client->rx_len, MSG_DONTWAIT);
+            if (n <= 0 && !(n < 0 && (errno == EAGAIN || errno == EINTR)))
+                disconnected = true;
+            else if (n > 0)
+            {
+                client->rx_len += n;
+                mqtt_packet_t packet;
+                size_t offset = 0;
+                int rc;
+                while ((rc = mqtt_wire_parse(client->rx + offset, client->rx_len - offset, &packet)) == 1)
+                {
+                    // Un DATA por vuelta: el evento apunta a data_copy
+                    bool is_data = packet.type == MQTT_PACKET_PUBLISH;
+                    if (is_data && event_count > 0 && events[event_count - 1].event_id == MQTT_EVENT_DATA)
+                        break;
+                    if (handle_packet(client, &packet, &events[event_count], data_copy))
+                        event_count++;
+                    offset += packet.length;
+                }
+                if (rc < 0)
+                    disconnected = true;
+                memmove(client->rx, client->rx + offset, client->rx_len - offset);
+                client->rx_len -= offset;
+            }
+        }
+
+        // handle_packet() fecha los ACK recibidos despues del poll: sin esto,
+        // un ACK sin demora esperaria a la vuelta siguiente (HOST_MQTT_POLL_MS)
+        now = esp_timer_get_time();
+
+        // CONNACK, posiblemente demorado por host_fault
+        if (!disconnected && client->state == TRANSPORT_WAIT_CONNACK)
+        {
+            if (client->connack_due_us != 0 && now >= client->connack_due_us)
+            {
+                int rc = host_fault_refuse_auth() ? MQTT_CONNACK_NOT_AUTHORIZED : client->connack_rc;
+                if (rc != MQTT_CONNACK_ACCEPTED)
+                {
+                    client->stats.connect_refused++;
+                    ESP_LOGW(TAG, "Conexion rechazada por el broker, codigo %d", rc);
+                    events[event_count++] = (esp_mqtt_event_t){.event_id = MQTT_EVENT_ERROR, .client = client};
+                    disconnected = true;
+                }
+                else
+                {
+                    client->state = TRANSPORT_CONNECTED;
+                    client->stats.connects++;
+                    events[event_count++] = (esp_mqtt_event_t){.event_id = MQTT_EVENT_CONNECTED, .client = client};
+                    outbox_resend(client);
+                }
+            }
+            else if (now > client->connack_deadline_us)
+                disconnected = true;
+        }
+
+        // PUBACKs demorados
+        for (int i = 0; i < client->delayed_ack_count;)
+        {
+            if (now < client->delayed_acks[i].due_us)
+            {
+                i++;
+                continue;
+            }
+            int msg_id = client->delayed_acks[i].msg_id;
+            client->delayed_acks[i] = client->delayed_acks[--client->delayed_ack_count];
+            if (outbox_remove(client, msg_id))
+            {
+                client->stats.acked++;
+                events[event_count++] = (esp_mqtt_event_t){.event_id = MQTT_EVENT_PUBLISHED, .client = client, .msg_id = msg_id};
+            }
+        }
+
+        // Keepalive: sin PINGRESP durante un periodo, la conexion se da por perdida
+        if (!disconnected && client->state == TRANSPORT_CONNECTED)
+        {
+            if (client->ping_sent_us != 0 && now - client->ping_sent_us > keepalive_us(client))
+                disconnected = true;
+            else if (client->ping_sent_us == 0 && now - client->last_tx_us > keepalive_us(client))
+            {
+                size_t len = mqtt_wire_simple(client->tx, sizeof(client->tx), MQTT_PACKET_PINGREQ);
+                if (transport_send(client, client->tx, len))
+                    client->ping_sent_us = now;
+                else
+                    disconnected = true;
+            }
+        }
+
+        if (host_fault_drop_generation() != client->drop_generation || client->send_failed)
+            disconnected = true;
+
+        outbox_expire(client, now);
+
+        bool notify_disconnect = false;
+        if (disconnected)
+        {
+            transport_close(client);
+            notify_disconnect = true;
+        }
+        pthread_mutex_unlock(&client->lock);
+
+        // Los eventos se despachan sin el lock: los handlers publican y se suscriben
+        for (int i = 0; i < event_count; i++)
+            dispatch_event(&events[i]);
+        if (notify_disconnect)
+        {
+            host_mqtt_dispatch(client, MQTT_EVENT_DISCONNECTED, 0);
+            if (client->config.network.disable_auto_reconnect)
+                break;
+        }
+    }
+    return NULL;
+}
+
+/*****************************************************
+ *   API de esp-mqtt                                  *
+ ******************************************************/
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+    esp_mqtt_client_handle_t client = calloc(1, sizeof(*client));
+    if (client == NULL)
+        return NULL;
+    client->config = *config;
+    client->next_msg_id = 1;
+    client->fd = -1;
+    client->tcp = parse_tcp_uri(client, config->broker.address.uri);
+    pthread_mutex_init(&client->lock, NULL);
+    return client;
+}
+
+esp_err_t esp_mqtt_set_config(esp_mqtt_client_handle_t client, const esp_mqtt_client_config_t *config)
+{
+    // Como esp-mqtt: la nueva configuracion se usa en la proxima conexion
+    if (client->tcp)
+        pthread_mutex_lock(&client->lock);
+    client->config = *config;
+    if (client->tcp)
+        pthread_mutex_unlock(&client->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    (void)event;
+    client->handler = event_handler;
+    client->handler_arg = event_handler_arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    if (client->started)
+        return ESP_FAIL;
+    __atomic_store_n(&client->started, true, __ATOMIC_RELEASE);
+    if (client->tcp)
+        return pthread_create(&client->thread, NULL, client_task, client) == 0 ? ESP_OK : ESP_FAIL;
+    host_mqtt_dispatch(client, MQTT_EVENT_CONNECTED, 0);
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client)
+{
+    if (!client->started)
+        return ESP_FAIL;
+    __atomic_store_n(&client->started, false, __ATOMIC_RELEASE);
+    if (client->tcp)
+    {
+        pthread_join(client->thread, NULL);
+        pthread_mutex_lock(&client->lock);
+        bool was_connected = transport_close(client);
+        pthread_mutex_unlock(&client->lock);
+        if (!was_connected)
+            return ESP_OK;
+    }
+    host_mqtt_dispatch(client, MQTT_EVENT_DISCONNECTED, 0);
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client)
+{
+    if (client->started)
+        esp_mqtt_client_stop(client);
+    while (client->outbox != NULL)
+    {
+        outbox_entry_t *next = client->outbox->next;
+        free(client->outbox);
+        client->outbox = next;
+    }
+    pthread_mutex_destroy(&client->lock);
+    free(client);
+    return ESP_OK;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos)
+{
+    int msg_id = __atomic_fetch_add(&client->next_msg_id, 1, __ATOMIC_RELAXED);
+    if (!client->tcp)
+    {
+        host_mqtt_dispatch(client, MQTT_EVENT_SUBSCRIBED, msg_id);
+        return msg_id;
+    }
+
+    pthread_mutex_lock(&client->lock);
+    size_t len = mqtt_wire_subscribe(client->tx, sizeof(client->tx), (uint16_t)msg_id, topic, (uint8_t)qos);
+    bool sent = client->state == TRANSPORT_CONNECTED && len > 0 && transport_send(client, client->tx, len);
+    pthread_mutex_unlock(&client->lock);
+    return sent ? msg_id : -1;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain)
+{
+    (void)retain;
+    if (client == NULL || !client->started)
+        return -1;
+    if (len == 0 && data != NULL)
+        len = strlen(data);
+
+    if (!client->tcp)
+    {
+        int msg_id = qos > 0 ? __atomic_fetch_add(&client->next_msg_id, 1, __ATOMIC_RELAXED) : 0;
+        __atomic_fetch_add(&publish_count, 1, __ATOMIC_RELAXED);
+        client->stats.published++;
+        if (publish_hook != NULL)
+            publish_hook(client, topic, data, len, qos);
+        if (qos > 0)
+        {
+            client->stats.acked++;
+            host_mqtt_dispatch(client, MQTT_EVENT_PUBLISHED, msg_id);
+        }
+        return msg_id;
+    }
+
+    int msg_id = 0;
+    while (qos > 0 && msg_id == 0) // El packet id 0 no es valido en MQTT
+        msg_id = (uint16_t)__atomic_fetch_add(&client->next_msg_id, 1, __ATOMIC_RELAXED);
+    int result = msg_id;
+    pthread_mutex_lock(&client->lock);
+    size_t packet_len = mqtt_wire_publish(client->tx, sizeof(client->tx), topic, data, len, qos > 0 ? 1 : 0, (uint16_t)msg_id);
+    if (packet_len == 0)
+        result = -1;
+    else if (qos > 0)
+    {
+        // QoS 1: queda en el outbox hasta el PUBACK; sin conexion se envia al reconectar
+        outbox_entry_t *entry = malloc(sizeof(*entry) + packet_len);
+        if (entry == NULL)
+            result = -1;
+        else
+        {
+            entry->msg_id = msg_id;
+            entry->created_us = esp_timer_get_time();
+            entry->len = packet_len;
+            memcpy(entry->packet, client->tx, packet_len);
+            entry->next = NULL;
+            outbox_entry_t **link = &client->outbox;
+            while (*link != NULL)
+                link = &(*link)->next;
+            *link = entry;
+            if (client->state == TRANSPORT_CONNECTED)
+                transport_send(client, entry->packet, packet_len);
+        }
+    }
+    else if (client->state != TRANSPORT_CONNECTED || !transport_send(client, client->tx, packet_len))
+        result = -1;
+
+    if (result >= 0)
+        client->stats.published++;
+    else
+        client->stats.rejected++;
+    pthread_mutex_unlock(&client->lock);
+
+    if (result >= 0)
+    {
+        __atomic_fetch_add(&publish_count, 1, __ATOMIC_RELAXED);
+        if (publish_hook != NULL)
+            publish_hook(client, topic, data, len, qos);
+    }
+    return result;
+}
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos,
+                            int retain, bool store)
+{
+    (void)store;
+    return esp_mqtt_client_publish(client, topic, data, len, qos, retain);
+}
@@ -0,0 +1,327 @@
+/*
+ * nvs_host.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  NVS en memoria. Cada handle guarda el namespace y el modo de apertura;
+ *  las entradas viven en una tabla fija protegida por un mutex.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#define HOST_NVS_MAX_ENTRIES 128
+#define HOST_NVS_MAX_HANDLES 16
+#define HOST_NVS_MAX_VALUE 4000
+
+typedef enum
+{
+    NVS_TYPE_U8,
+    NVS_TYPE_U16,
+    NVS_TYPE_U32,
+    NVS_TYPE_U64,
+    NVS_TYPE_I32,
+    NVS_TYPE_STR,
+    NVS_TYPE_BLOB,
+} nvs_type_t;
+
+typedef struct
+{
+    bool used;
+    char namespace_name[NVS_KEY_NAME_MAX_SIZE];
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_type_t type;
+    size_t length;
+    size_t capacity; // Reservado en value: reescribir un valor del mismo largo no reserva memoria
+    uint8_t *value;
+} nvs_entry_t;
+
+typedef struct
+{
+    bool used;
+    char namespace_name[NVS_KEY_NAME_MAX_SIZE];
+    nvs_open_mode_t mode;
+} nvs_open_handle_t;
+
+static nvs_entry_t entries[HOST_NVS_MAX_ENTRIES];
+static nvs_open_handle_t handles[HOST_NVS_MAX_HANDLES];
+static pthread_mutex_t nvs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t write_count = 0;
+static uint32_t commit_count = 0;
+
+static bool namespace_exists(const char *name)
+{
+    for (int i = 0; i < HOST_NVS_MAX_ENTRIES; i++)
+    {
+        if (entries[i].used && strcmp(entries[i].namespace_name, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+static nvs_open_handle_t *get_handle(nvs_handle_t handle)
+{
+    if (handle == 0 || handle > HOST_NVS_MAX_HANDLES || !handles[handle - 1].used)
+        return NULL;
+    return &handles[handle - 1];
+}
+
+static nvs_entry_t *find_entry(const char *name, const char *key)
+{
+    for (int i = 0; i < HOST_NVS_MAX_ENTRIES; i++)
+    {
+        if (entries[i].used && strcmp(entries[i].namespace_name, name) == 0 && strcmp(entries[i].key, key) == 0)
+            return &entries[i];
+    }
+    return NULL;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    host_mock_nvs_reset();
+    return ESP_OK;
+}
+
+void host_mock_nvs_reset(void)
+{
+    pthread_mutex_lock(&nvs_mutex);
+    for (int i = 0; i < HOST_NVS_MAX_ENTRIES; i++)
+        free(entries[i].value);
+    memset(entries, 0, sizeof(entries));
+    write_count = 0;
+    commit_count = 0;
+    pthread_mutex_unlock(&nvs_mutex);
+}
+
+uint32_t host_mock_nvs_write_count(void)
+{
+    return write_count;
+}
+
+uint32_t host_mock_nvs_commit_count(void)
+{
+    return commit_count;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (name == NULL || strlen(name) >= NVS_KEY_NAME_MAX_SIZE)
+        return ESP_ERR_NVS_INVALID_NAME;
+
+    pthread_mutex_lock(&nvs_mutex);
+    if (open_mode == NVS_READONLY && !namespace_exists(name))
+    {
+        pthread_mutex_unlock(&nvs_mutex);
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    for (int i = 0; i < HOST_NVS_MAX_HANDLES; i++)
+    {
+        if (!handles[i].used)
+        {
+            handles[i].used = true;
+            strcpy(handles[i].namespace_name, name);
+            handles[i].mode = open_mode;
+            *out_handle = i + 1;
+            pthread_mutex_unlock(&nvs_mutex);
+            return ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&nvs_mutex);
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&nvs_mutex);
+    nvs_open_handle_t *h = get_handle(handle);
+    if (h != NULL)
+        h->used = false;
+    pthread_mutex_unlock(&nvs_mutex);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&nvs_mutex);
+    esp_err_t err = get_handle(handle) != NULL ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+    if (err == ESP_OK)
+        commit_count++;
+    pthread_mutex_unlock(&nvs_mutex);
+    return err;
+}
+
+static esp_err_t set_value(nvs_handle_t handle, const char *key, nvs_type_t type, const void *value, size_t length)
+{
+    if (key == NULL || strlen(key) >= NVS_KEY_NAME_MAX_SIZE)
+        return ESP_ERR_NVS_INVALID_NAME;
+    if (length > HOST_NVS_MAX_VALUE)
+        return ESP_ERR_NVS_INVALID_LENGTH;
+
+    pthread_mutex_lock(&nvs_mutex);
+    nvs_open_handle_t *h = get_handle(handle);
+    esp_err_t err = ESP_OK;
+    if (h == NULL)
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    else if (h->mode != NVS_READWRITE)
+        err = ESP_ERR_NVS_READ_ONLY;
+
+    nvs_entry_t *entry = NULL;
+    if (err == ESP_OK)
+    {
+        entry = find_entry(h->namespace_name, key);
+        for (int i = 0; entry == NULL && i < HOST_NVS_MAX_ENTRIES; i++)
+        {
+            if (!entries[i].used)
+            {
+                entry = &entries[i];
+                memset(entry, 0, sizeof(*entry));
+                entry->used = true;
+                strcpy(entry->namespace_name, h->namespace_name);
+                strcpy(entry->key, key);
+            }
+        }
+        if (entry == NULL)
+            err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+
+    if (err == ESP_OK)
+    {
+        if (entry->capacity < length || entry->value == NULL)
+        {
+            uint8_t *copy = malloc(length > 0 ? length : 1);
+            if (copy == NULL)
+                err = ESP_ERR_NO_MEM;
+            else
+            {
+                free(entry->value);
+                entry->value = copy;
+                entry->capacity = length > 0 ? length : 1;
+            }
+        }
+        if (err == ESP_OK)
+        {
+            memcpy(entry->value, value, length);
+            entry->length = length;
+            entry->type = type;
+            write_count++;
+        }
+    }
+    pthread_mutex_unlock(&nvs_mutex);
+    return err;
+}
+
+/* Con out_value NULL devuelve en *length el tamaño necesario, como el NVS real */
+static esp_err_t get_value(nvs_handle_t handle, const char *key, nvs_type_t type, void *out_value, size_t *length)
+{
+    pthread_mutex_lock(&nvs_mutex);
+    nvs_open_handle_t *h = get_handle(handle);
+    esp_err_t err = ESP_OK;
+    nvs_entry_t *entry = NULL;
+
+    if (h == NULL)
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    else if ((entry = find_entry(h->namespace_name, key)) == NULL)
+        err = ESP_ERR_NVS_NOT_FOUND;
+    else if (entry->type != type)
+        err = ESP_ERR_NVS_TYPE_MISMATCH;
+    else if (out_value == NULL)
+        *length = entry->length;
+    else if (*length < entry->length)
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    else
+    {
+        memcpy(out_value, entry->value, entry->length);
+        *length = entry->length;
+    }
+    pthread_mutex_unlock(&nvs_mutex);
+    return err;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    pthread_mutex_lock(&nvs_mutex);
+    nvs_open_handle_t *h = get_handle(handle);
+    esp_err_t err = ESP_OK;
+    nvs_entry_t *entry = NULL;
+
+    if (h == NULL)
+        err = ESP_ERR_NVS_INVALID_HANDLE;
+    else if ((entry = find_entry(h->namespace_name, key)) == NULL)
+        err = ESP_ERR_NVS_NOT_FOUND;
+    else
+    {
+        free(entry->value);
+        memset(entry, 0, sizeof(*entry));
+        write_count++;
+    }
+    pthread_mutex_unlock(&nvs_mutex);
+    return err;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&nvs_mutex);
+    nvs_open_handle_t *h = get_handle(handle);
+    if (h == NULL)
+    {
+        pthread_mutex_unlock(&nvs_mutex);
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    for (int i = 0; i < HOST_NVS_MAX_ENTRIES; i++)
+    {
+        if (entries[i].used && strcmp(entries[i].namespace_name, h->namespace_name) == 0)
+        {
+            free(entries[i].value);
+            memset(&entries[i], 0, sizeof(entries[i]));
+        }
+    }
+    write_count++;
+    pthread_mutex_unlock(&nvs_mutex);
+    return ESP_OK;
+}
+
+#define NVS_INTEGER_ACCESSORS(suffix, ctype, nvs_type)                                      \
+    esp_err_t nvs_set_##suffix(nvs_handle_t handle, const char *key, ctype value)           \
+    {                                                                                       \
+        return set_value(handle, key, nvs_type, &value, sizeof(value));                     \
+    }                                                                                       \
+    esp_err_t nvs_get_##suffix(nvs_handle_t handle, const char *key, ctype *out_value)      \
+    {                                                                                       \
+        size_t length = sizeof(*out_value);                                                 \
+        return get_value(handle, key, nvs_type, out_value, &length);                        \
+    }
+
+NVS_INTEGER_ACCESSORS(u8, uint8_t, NVS_TYPE_U8)
+NVS_INTEGER_ACCESSORS(u16, uint16_t, NVS_TYPE_U16)
+NVS_INTEGER_ACCESSORS(u32, uint32_t, NVS_TYPE_U32)
+NVS_INTEGER_ACCESSORS(u64, uint64_t, NVS_TYPE_U64)
+NVS_INTEGER_ACCESSORS(i32, int32_t, NVS_TYPE_I32)
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    return set_value(handle, key, NVS_TYPE_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    return get_value(handle, key, NVS_TYPE_STR, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return set_value(handle, key, NVS_TYPE_BLOB, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    return get_value(handle, key, NVS_TYPE_BLOB, out_value, length);
+}
@@ -0,0 +1,145 @@
+/*
+ * sample_store_host.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Flash de sample_store para el host: location es la ruta de un archivo
+ *  que hace de particion. Se comporta como una NOR: el borrado deja 0xFF y
+ *  grabar solo pasa bits de 1 a 0, de modo que un registro grabado dos
+ *  veces queda danado como en el ESP32. Si el archivo no existe se crea
+ *  borrado, de SAMPLE_STORE_HOST_DEFAULT_SIZE bytes. Reemplaza a
+ *  sample_store_flash.c, que usa la API de particiones.
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "host_fault.h"
+#include "sample_store.h"
+
+#ifndef SAMPLE_STORE_HOST_DEFAULT_SIZE
+#define SAMPLE_STORE_HOST_DEFAULT_SIZE (64 * SAMPLE_STORE_SECTOR_SIZE)
+#endif
+
+static int store_fd = -1;
+static uint32_t store_size = 0;
+
+// Corte de energia simulado (host_fault.h)
+static bool cut_armed = false;
+static bool cut_done = false;
+static uint32_t cut_remaining = 0;
+
+void host_fault_flash_cut(uint32_t after_bytes)
+{
+    cut_armed = true;
+    cut_done = false;
+    cut_remaining = after_bytes;
+}
+
+bool host_fault_flash_is_cut(void)
+{
+    return cut_done;
+}
+
+static esp_err_t fill_erased(uint32_t offset, size_t len)
+{
+    uint8_t erased[SAMPLE_STORE_SECTOR_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    while (len > 0)
+    {
+        size_t n = len < sizeof(erased) ? len : sizeof(erased);
+        if (pwrite(store_fd, erased, n, offset) != (ssize_t)n)
+            return ESP_FAIL;
+        offset += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t sample_store_flash_open(const char *location, uint32_t *size)
+{
+    if (store_fd >= 0)
+        return ESP_ERR_INVALID_STATE;
+    if (location == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    // Volver a abrir es volver a encender
+    cut_armed = false;
+    cut_done = false;
+
+    store_fd = open(location, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (store_fd < 0)
+        return ESP_ERR_NOT_FOUND;
+    struct stat st;
+    if (fstat(store_fd, &st) != 0)
+    {
+        sample_store_flash_close();
+        return ESP_FAIL;
+    }
+    store_size = st.st_size;
+    if (store_size == 0)
+    {
+        store_size = SAMPLE_STORE_HOST_DEFAULT_SIZE;
+        if (fill_erased(0, store_size) != ESP_OK)
+        {
+            sample_store_flash_close();
+            return ESP_FAIL;
+        }
+    }
+    *size = store_size;
+    return ESP_OK;
+}
+
+esp_err_t sample_store_flash_read(uint32_t offset, void *buffer, size_t len)
+{
+    if (store_fd < 0 || (uint64_t)offset + len > store_size)
+        return ESP_ERR_INVALID_ARG;
+    return pread(store_fd, buffer, len, offset) == (ssize_t)len ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t sample_store_flash_write(uint32_t offset, const void *data, size_t len)
+{
+    uint8_t current[SAMPLE_STORE_SECTOR_SIZE];
+    if (store_fd < 0 || len > sizeof(current) || (uint64_t)offset + len > store_size)
+        return ESP_ERR_INVALID_ARG;
+    if (cut_done)
+        return ESP_FAIL;
+
+    size_t programmed = len;
+    if (cut_armed && cut_remaining < len)
+    {
+        programmed = cut_remaining;
+        cut_done = true;
+    }
+    if (cut_armed)
+        cut_remaining -= programmed;
+
+    if (pread(store_fd, current, programmed, offset) != (ssize_t)programmed)
+        return ESP_FAIL;
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < programmed; i++)
+        current[i] &= bytes[i];
+    if (pwrite(store_fd, current, programmed, offset) != (ssize_t)programmed)
+        return ESP_FAIL;
+    return cut_done ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t sample_store_flash_erase(uint32_t offset, size_t len)
+{
+    if (store_fd < 0 || offset % SAMPLE_STORE_SECTOR_SIZE != 0 || len % SAMPLE_STORE_SECTOR_SIZE != 0 ||
+        (uint64_t)offset + len > store_size)
+        return ESP_ERR_INVALID_ARG;
+    if (cut_done)
+        return ESP_FAIL;
+    return fill_erased(offset, len);
+}
+
+void sample_store_flash_close(void)
+{
+    if (store_fd >= 0)
+        close(store_fd);
+    store_fd = -1;
+    store_size = 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * sensor_trace_host.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Acceso a trazas del sensor para el host: location es la ruta de un
+ *  archivo, que se mapea con mmap. Reemplaza a sensor_trace_flash.c, que
+ *  mapea una particion de la flash.
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sensor_trace.h"
+
+static const uint8_t *trace_data = NULL;
+static size_t trace_len = 0;
+
+esp_err_t sensor_trace_map(const char *location, const uint8_t **data, size_t *len)
+{
+    if (trace_data != NULL)
+        return ESP_ERR_INVALID_STATE;
+    if (location == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    int fd = open(location, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return ESP_ERR_NOT_FOUND;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return ESP_FAIL;
+    // El lector avanza en orden; las busquedas binarias son pocas
+    madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+
+    trace_data = mapped;
+    trace_len = st.st_size;
+    *data = trace_data;
+    *len = trace_len;
+    return ESP_OK;
+}
+
+void sensor_trace_unmap(void)
+{
+    if (trace_data == NULL)
+        return;
+    munmap((void *)trace_data, trace_len);
+    trace_data = NULL;
+    trace_len = 0;
+}
@@ -0,0 +1,327 @@
+/*
+ * sntp_host.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Cliente SNTP para el host (ver esp_sntp.h del mock). Un hilo hace lo
+ *  que el de lwIP en modo poll: manda el pedido al servidor actual, si no
+ *  contesta en HOST_SNTP_RECV_TIMEOUT_MS pasa al siguiente, y con una
+ *  respuesta valida llama a sntp_sync_time() con la hora corregida por la
+ *  demora de ida y vuelta.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "esp_sntp.h"
+#include "sdkconfig.h"
+
+#define NTP_PACKET_LEN 48
+#define NTP_PORT "123"
+#define NTP_MODE_CLIENT 3
+#define NTP_MODE_SERVER 4
+#define NTP_VERSION 4
+/* Segundos entre 1900 (epoca NTP) y 1970 */
+#define NTP_UNIX_OFFSET_S 2208988800ULL
+
+static const char *TAG = "sntp";
+
+static pthread_mutex_t sntp_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sntp_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t sntp_thread;
+static bool running = false;
+static bool poll_now = false;
+static const char *servers[CONFIG_LWIP_SNTP_MAX_SERVERS];
+static sntp_sync_status_t sync_status = SNTP_SYNC_STATUS_RESET;
+
+static pthread_mutex_t clock_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int64_t clock_offset_us = 0;
+
+/*****************************************************
+ *   Reloj virtual                                    *
+ ******************************************************/
+static int64_t real_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static int64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static int64_t virtual_time_us(void)
+{
+    pthread_mutex_lock(&clock_mutex);
+    int64_t offset_us = clock_offset_us;
+    pthread_mutex_unlock(&clock_mutex);
+    return real_time_us() + offset_us;
+}
+
+int host_gettimeofday(struct timeval *tv, void *tz)
+{
+    (void)tz;
+    int64_t now_us = virtual_time_us();
+    tv->tv_sec = now_us / 1000000LL;
+    tv->tv_usec = now_us % 1000000LL;
+    return 0;
+}
+
+int host_settimeofday(const struct timeval *tv, const void *tz)
+{
+    (void)tz;
+    int64_t target_us = (int64_t)tv->tv_sec * 1000000LL + tv->tv_usec;
+    pthread_mutex_lock(&clock_mutex);
+    clock_offset_us = target_us - real_time_us();
+    pthread_mutex_unlock(&clock_mutex);
+    return 0;
+}
+
+void host_clock_adjust_us(int64_t delta_us)
+{
+    pthread_mutex_lock(&clock_mutex);
+    clock_offset_us += delta_us;
+    pthread_mutex_unlock(&clock_mutex);
+}
+
+/*****************************************************
+ *   Cliente                                          *
+ ******************************************************/
+static void write_timestamp(uint8_t *out, int64_t unix_us)
+{
+    uint64_t seconds = unix_us / 1000000LL + NTP_UNIX_OFFSET_S;
+    uint64_t fraction = ((uint64_t)(unix_us % 1000000LL) << 32) / 1000000ULL;
+    uint32_t words[2] = {htonl((uint32_t)seconds), htonl((uint32_t)fraction)};
+    memcpy(out, words, sizeof(words));
+}
+
+static int64_t read_timestamp(const uint8_t *in)
+{
+    uint32_t words[2];
+    memcpy(words, in, sizeof(words));
+    uint64_t seconds = ntohl(words[0]);
+    uint64_t fraction = ntohl(words[1]);
+    return (int64_t)(seconds - NTP_UNIX_OFFSET_S) * 1000000LL + (int64_t)((fraction * 1000000ULL) >> 32);
+}
+
+/* "host" o "host:puerto" */
+static int open_server(const char *server)
+{
+    char host[128];
+    const char *port = NTP_PORT;
+    strlcpy(host, server, sizeof(host));
+    char *colon = strrchr(host, ':');
+    if (colon != NULL)
+    {
+        *colon = 0;
+        port = colon + 1;
+    }
+
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_DGRAM};
+    struct addrinfo *result;
+    if (getaddrinfo(host, port, &hints, &result) != 0)
+        return -1;
+    int fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (fd >= 0 && connect(fd, result->ai_addr, result->ai_addrlen) != 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+    return fd;
+}
+
+/* Hora del servidor al recibir la respuesta, o 0 si no hubo una valida */
+static int64_t query_server(const char *server)
+{
+    int fd = open_server(server);
+    if (fd < 0)
+        return 0;
+
+    uint8_t request[NTP_PACKET_LEN] = {0};
+    request[0] = (NTP_VERSION << 3) | NTP_MODE_CLIENT;
+    int64_t sent_us = virtual_time_us();
+    write_timestamp(&request[40], sent_us);
+
+    int64_t server_us = 0;
+    int64_t deadline_us = monotonic_us() + HOST_SNTP_RECV_TIMEOUT_MS * 1000LL;
+    if (send(fd, request, sizeof(request), 0) == sizeof(request))
+    {
+        // Como lwIP, se ignoran las respuestas que no son a este pedido
+        int64_t now_us;
+        while (server_us == 0 && (now_us = monotonic_us()) < deadline_us)
+        {
+            struct pollfd pfd = {.fd = fd, .events = POLLIN};
+            if (poll(&pfd, 1, (int)((deadline_us - now_us + 999) / 1000)) <= 0)
+                break;
+            uint8_t response[NTP_PACKET_LEN];
+            ssize_t len = recv(fd, response, sizeof(response), 0);
+            if (len < 0 && errno == ECONNREFUSED)
+                break;
+            int64_t received_us = virtual_time_us();
+            if (len < NTP_PACKET_LEN || (response[0] & 0x07) != NTP_MODE_SERVER || response[1] == 0 ||
+                memcmp(&response[24], &request[40], 8) != 0)
+                continue;
+            // offset = ((t2 - t1) + (t3 - t4)) / 2
+            int64_t offset_us = ((read_timestamp(&response[32]) - sent_us) + (read_timestamp(&response[40]) - received_us)) / 2;
+            server_us = received_us + offset_us;
+        }
+    }
+    close(fd);
+    return server_us;
+}
+
+static bool wait_poll(int64_t delay_ms)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += delay_ms / 1000;
+    deadline.tv_nsec += (delay_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&sntp_mutex);
+    while (running && !poll_now)
+        if (pthread_cond_timedwait(&sntp_cond, &sntp_mutex, &deadline) == ETIMEDOUT)
+            break;
+    poll_now = false;
+    bool keep_running = running;
+    pthread_mutex_unlock(&sntp_mutex);
+    return keep_running;
+}
+
+static void *sntp_task(void *arg)
+{
+    (void)arg;
+    uint8_t index = 0;
+    uint8_t failed = 0;
+    for (;;)
+    {
+        pthread_mutex_lock(&sntp_mutex);
+        const char *server = servers[index];
+        bool keep_running = running;
+        pthread_mutex_unlock(&sntp_mutex);
+        if (!keep_running)
+            break;
+
+        int64_t server_us = server != NULL ? query_server(server) : 0;
+        if (server_us != 0)
+        {
+            failed = 0;
+            struct timeval tv = {.tv_sec = server_us / 1000000LL, .tv_usec = server_us % 1000000LL};
+            sntp_sync_time(&tv);
+            if (!wait_poll(HOST_SNTP_UPDATE_DELAY_MS))
+                break;
+            continue;
+        }
+
+        if (server != NULL)
+            ESP_LOGW(TAG, "Sin respuesta de %s", server);
+        index = (index + 1) % CONFIG_LWIP_SNTP_MAX_SERVERS;
+        // Recorrida la lista sin respuesta, se espera antes de empezar de nuevo
+        if (++failed >= CONFIG_LWIP_SNTP_MAX_SERVERS)
+        {
+            failed = 0;
+            if (!wait_poll(HOST_SNTP_RETRY_MS))
+                break;
+        }
+    }
+    return NULL;
+}
+
+/*****************************************************
+ *   API                                              *
+ ******************************************************/
+void esp_sntp_setoperatingmode(esp_sntp_operatingmode_t operating_mode)
+{
+    (void)operating_mode;
+}
+
+void esp_sntp_setservername(uint8_t idx, const char *server)
+{
+    if (idx >= CONFIG_LWIP_SNTP_MAX_SERVERS)
+        return;
+    pthread_mutex_lock(&sntp_mutex);
+    servers[idx] = server;
+    pthread_mutex_unlock(&sntp_mutex);
+}
+
+void esp_sntp_init(void)
+{
+    pthread_mutex_lock(&sntp_mutex);
+    if (running)
+    {
+        pthread_mutex_unlock(&sntp_mutex);
+        return;
+    }
+    running = true;
+    poll_now = false;
+    pthread_mutex_unlock(&sntp_mutex);
+    pthread_create(&sntp_thread, NULL, sntp_task, NULL);
+}
+
+void esp_sntp_stop(void)
+{
+    pthread_mutex_lock(&sntp_mutex);
+    bool was_running = running;
+    running = false;
+    pthread_cond_broadcast(&sntp_cond);
+    pthread_mutex_unlock(&sntp_mutex);
+    if (was_running)
+        pthread_join(sntp_thread, NULL);
+}
+
+bool esp_sntp_restart(void)
+{
+    pthread_mutex_lock(&sntp_mutex);
+    bool was_running = running;
+    poll_now = running;
+    pthread_cond_broadcast(&sntp_cond);
+    pthread_mutex_unlock(&sntp_mutex);
+    return was_running;
+}
+
+bool esp_sntp_enabled(void)
+{
+    pthread_mutex_lock(&sntp_mutex);
+    bool enabled = running;
+    pthread_mutex_unlock(&sntp_mutex);
+    return enabled;
+}
+
+void sntp_set_sync_status(sntp_sync_status_t status)
+{
+    pthread_mutex_lock(&sntp_mutex);
+    sync_status = status;
+    pthread_mutex_unlock(&sntp_mutex);
+}
+
+sntp_sync_status_t sntp_get_sync_status(void)
+{
+    pthread_mutex_lock(&sntp_mutex);
+    sntp_sync_status_t status = sync_status;
+    pthread_mutex_unlock(&sntp_mutex);
+    return status;
+}
+
+__attribute__((weak)) void sntp_sync_time(struct timeval *tv)
+{
+    settimeofday(tv, NULL);
+    sntp_set_sync_status(SNTP_SYNC_STATUS_COMPLETED);
+}
@@ -0,0 +1,76 @@
+/*
+ * sntp_time_host.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Servicio de hora para el host: la hora del sistema se toma como
+ *  sincronizada por SNTP. Reemplaza a sntp_time.c, que ajusta el reloj.
+ */
+
+#include <sys/time.h>
+
+#include "sntp_time.h"
+
+static void set_servers(const char *const *servers, uint8_t count)
+{
+    (void)servers;
+    (void)count;
+}
+
+static void set_max_error_ms(uint32_t max_error_ms)
+{
+    (void)max_error_ms;
+}
+
+static void initialize(void)
+{
+}
+
+static bool wait_available(TickType_t ticks_to_wait)
+{
+    (void)ticks_to_wait;
+    return true;
+}
+
+static bool is_trusted(void)
+{
+    return true;
+}
+
+static time_quality_t get_quality(void)
+{
+    return TIME_QUALITY_SNTP;
+}
+
+static uint32_t get_uncertainty_ms(void)
+{
+    return SNTP_TIME_SYNC_UNCERTAINTY_MS;
+}
+
+static int32_t get_drift_ppm(void)
+{
+    return 0;
+}
+
+static int64_t get_time_ms(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/*****************************************************
+ *   Driver Instance Declaration(s) API(s)            *
+ ******************************************************/
+const time_service_t time_service = {
+    // Time Service Functions
+    .set_servers = set_servers,
+    .set_max_error_ms = set_max_error_ms,
+    .initialize = initialize,
+    .wait_available = wait_available,
+    .is_trusted = is_trusted,
+    .get_quality = get_quality,
+    .get_uncertainty_ms = get_uncertainty_ms,
+    .get_drift_ppm = get_drift_ppm,
+    .get_time_ms = get_time_ms,
+};
@@ -0,0 +1,331 @@
+/*
+ * wifi_host.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  esp_wifi y esp_netif simulados. Despues de esp_wifi_start() una tarea
+ *  simula cada intento de asociacion pedido con esp_wifi_connect() y
+ *  publica los eventos de Wi-Fi e IP como el driver real.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+
+#define HOST_WIFI_STA_IP "192.168.1.50"
+
+ESP_EVENT_DEFINE_BASE(WIFI_EVENT);
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+
+static const char *TAG = "wifi_host";
+
+struct esp_netif_obj
+{
+    esp_netif_ip_info_t ip_info;
+};
+
+static struct esp_netif_obj netif_sta;
+static struct esp_netif_obj netif_ap;
+
+static int8_t wifi_rssi = -60;
+static wifi_mode_t wifi_mode = WIFI_MODE_NULL;
+
+// Sin esp_wifi_start() la estacion esta asociada y con IP (benchmarks, simulador de flota)
+static pthread_mutex_t wifi_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wifi_cond = PTHREAD_COND_INITIALIZER;
+static bool wifi_started = false;
+static bool wifi_stopped = false;
+static bool wifi_associated = true;
+static bool wifi_has_ip = true;
+static bool connect_pending = false;
+static bool station_task_running = false;
+static int64_t ap_down_until_us = 0;
+
+/*****************************************************
+ *   esp_netif                                        *
+ ******************************************************/
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void)
+{
+    return &netif_sta;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_ap(void)
+{
+    return &netif_ap;
+}
+
+esp_err_t esp_netif_set_ip_info(esp_netif_t *esp_netif, const esp_netif_ip_info_t *ip_info)
+{
+    if (esp_netif == NULL)
+        return ESP_ERR_INVALID_ARG;
+    esp_netif->ip_info = *ip_info;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_get_ip_info(esp_netif_t *esp_netif, esp_netif_ip_info_t *ip_info)
+{
+    if (esp_netif == NULL)
+        return ESP_ERR_INVALID_ARG;
+    *ip_info = esp_netif->ip_info;
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_get_handle_from_ifkey(const char *if_key)
+{
+    if (strcmp(if_key, "WIFI_STA_DEF") == 0)
+        return &netif_sta;
+    if (strcmp(if_key, "WIFI_AP_DEF") == 0)
+        return &netif_ap;
+    return NULL;
+}
+
+esp_err_t esp_netif_dhcps_start(esp_netif_t *esp_netif)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcps_stop(esp_netif_t *esp_netif)
+{
+    return ESP_OK;
+}
+
+uint32_t esp_ip4addr_aton(const char *addr)
+{
+    unsigned a, b, c, d;
+    if (sscanf(addr, "%u.%u.%u.%u", &a, &b, &c, &d) != 4)
+        return 0;
+    return a | b << 8 | c << 16 | d << 24;
+}
+
+/*****************************************************
+ *   Estacion simulada                                *
+ ******************************************************/
+static void post_sta_disconnected(uint8_t reason)
+{
+    wifi_event_sta_disconnected_t event = {.reason = reason, .rssi = wifi_rssi};
+    memcpy(event.ssid, "host-ap", 7);
+    event.ssid_len = 7;
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &event, sizeof(event), portMAX_DELAY);
+}
+
+static void post_got_ip(void)
+{
+    ip_event_got_ip_t event = {.esp_netif = &netif_sta};
+    event.ip_info.ip.addr = esp_ip4addr_aton(HOST_WIFI_STA_IP);
+    event.ip_info.netmask.addr = esp_ip4addr_aton("255.255.255.0");
+    event.ip_info.gw.addr = esp_ip4addr_aton("192.168.1.1");
+    netif_sta.ip_info = event.ip_info;
+    esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &event, sizeof(event), portMAX_DELAY);
+}
+
+/* Un intento de asociacion por cada esp_wifi_connect(); los eventos se publican fuera del mutex */
+static void *station_task(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&wifi_mutex);
+    while (1)
+    {
+        while (!connect_pending)
+            pthread_cond_wait(&wifi_cond, &wifi_mutex);
+        connect_pending = false;
+        bool ap_available = esp_timer_get_time() >= ap_down_until_us;
+        pthread_mutex_unlock(&wifi_mutex);
+
+        usleep((ap_available ? HOST_WIFI_CONNECT_MS : HOST_WIFI_SCAN_FAIL_MS) * 1000);
+
+        pthread_mutex_lock(&wifi_mutex);
+        // El AP pudo caer durante el intento
+        ap_available = esp_timer_get_time() >= ap_down_until_us;
+        if (ap_available)
+        {
+            wifi_associated = true;
+            wifi_has_ip = true;
+        }
+        pthread_mutex_unlock(&wifi_mutex);
+
+        if (ap_available)
+        {
+            esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, NULL, 0, portMAX_DELAY);
+            post_got_ip();
+        }
+        else
+            post_sta_disconnected(WIFI_REASON_NO_AP_FOUND);
+        pthread_mutex_lock(&wifi_mutex);
+    }
+    return NULL;
+}
+
+void host_mock_wifi_ap_down(uint32_t down_ms)
+{
+    pthread_mutex_lock(&wifi_mutex);
+    ap_down_until_us = esp_timer_get_time() + down_ms * 1000LL;
+    bool was_associated = wifi_associated;
+    wifi_associated = false;
+    wifi_has_ip = false;
+    pthread_mutex_unlock(&wifi_mutex);
+
+    if (was_associated)
+        post_sta_disconnected(WIFI_REASON_BEACON_TIMEOUT);
+}
+
+void host_mock_wifi_set_ip(bool has_ip)
+{
+    pthread_mutex_lock(&wifi_mutex);
+    bool changed = wifi_associated && wifi_has_ip != has_ip;
+    if (changed)
+        wifi_has_ip = has_ip;
+    pthread_mutex_unlock(&wifi_mutex);
+
+    if (!changed)
+        return;
+    if (has_ip)
+        post_got_ip();
+    else
+        esp_event_post(IP_EVENT, IP_EVENT_STA_LOST_IP, NULL, 0, portMAX_DELAY);
+}
+
+bool host_mock_wifi_link_up(void)
+{
+    pthread_mutex_lock(&wifi_mutex);
+    bool up = wifi_associated && wifi_has_ip;
+    pthread_mutex_unlock(&wifi_mutex);
+    return up;
+}
+
+/*****************************************************
+ *   esp_wifi                                         *
+ ******************************************************/
+void host_mock_set_rssi(int8_t rssi)
+{
+    wifi_rssi = rssi;
+}
+
+void host_mock_set_wifi_connected(bool connected)
+{
+    pthread_mutex_lock(&wifi_mutex);
+    wifi_associated = connected;
+    pthread_mutex_unlock(&wifi_mutex);
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    wifi_mode = mode;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    return conf != NULL ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    pthread_mutex_lock(&wifi_mutex);
+    bool sta = wifi_mode == WIFI_MODE_STA || wifi_mode == WIFI_MODE_APSTA;
+    wifi_started = true;
+    wifi_stopped = false;
+    if (sta)
+    {
+        wifi_associated = false;
+        wifi_has_ip = false;
+    }
+    if (!station_task_running)
+    {
+        pthread_t thread;
+        station_task_running = pthread_create(&thread, NULL, station_task, NULL) == 0;
+        if (station_task_running)
+            pthread_detach(thread);
+    }
+    pthread_mutex_unlock(&wifi_mutex);
+
+    if (wifi_mode == WIFI_MODE_AP || wifi_mode == WIFI_MODE_APSTA)
+        esp_event_post(WIFI_EVENT, WIFI_EVENT_AP_START, NULL, 0, portMAX_DELAY);
+    if (sta)
+        esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0, portMAX_DELAY);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_stop(void)
+{
+    pthread_mutex_lock(&wifi_mutex);
+    bool was_associated = wifi_started && wifi_associated;
+    wifi_started = false;
+    wifi_stopped = true;
+    wifi_associated = false;
+    wifi_has_ip = false;
+    connect_pending = false;
+    pthread_mutex_unlock(&wifi_mutex);
+
+    ESP_LOGI(TAG, "esp_wifi_stop()");
+    if (was_associated)
+        post_sta_disconnected(8); // WIFI_REASON_ASSOC_LEAVE
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_STOP, NULL, 0, portMAX_DELAY);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info)
+{
+    memset(ap_info, 0, sizeof(*ap_info));
+    if (!host_mock_wifi_link_up())
+        return ESP_FAIL;
+    strcpy((char *)ap_info->ssid, "host-ap");
+    ap_info->primary = 1;
+    ap_info->rssi = wifi_rssi;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    pthread_mutex_lock(&wifi_mutex);
+    if (wifi_stopped)
+    {
+        pthread_mutex_unlock(&wifi_mutex);
+        return ESP_ERR_WIFI_NOT_STARTED;
+    }
+    if (!wifi_started)
+        wifi_associated = true;
+    else
+    {
+        connect_pending = true;
+        pthread_cond_signal(&wifi_cond);
+    }
+    pthread_mutex_unlock(&wifi_mutex);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+    pthread_mutex_lock(&wifi_mutex);
+    bool was_associated = wifi_associated;
+    wifi_associated = false;
+    wifi_has_ip = false;
+    pthread_mutex_unlock(&wifi_mutex);
+
+    ESP_LOGI(TAG, "esp_wifi_disconnect()");
+    if (was_associated && wifi_started)
+        post_sta_disconnected(8); // WIFI_REASON_ASSOC_LEAVE
+    return ESP_OK;
+}
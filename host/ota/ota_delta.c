@@ -0,0 +1,571 @@
+/*
+ * ota_delta.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Parches de firmware para /commands/ota (formato en delta_patch.h):
+ *
+ *   1. con --new arma el parche de --old a --new: busca cada tramo de la
+ *      nueva en la vieja con un indice de hashes de 8 bytes y extiende
+ *      cada coincidencia hacia los dos lados mientras haya mas bytes
+ *      iguales que distintos (como bsdiff), asi el codigo que solo se
+ *      movio sale como COPY y ADD en lugar de INSERT,
+ *   2. aplica el parche (el de 1 o uno existente) con el mismo
+ *      delta_patch.c del firmware, en pedazos de --chunk bytes como llega
+ *      por HTTP, y compara el resultado con el sha256 de la cabecera,
+ *   3. con --key firma el sha256 de la imagen nueva e imprime el pedido
+ *      de /commands/ota; con --pub y --sig verifica una firma.
+ *
+ *  Uso: ota_delta --old v1.bin --new v2.bin --patch v2.dpt [--key firma.pem]
+ *                 [--url https://...] [--id N] [--chunk bytes] [--out archivo.json]
+ *       ota_delta --old v1.bin --patch v2.dpt --apply v2.bin [--pub clave.pem --sig hex]
+ *
+ *  El resumen compara el tamano del parche con el de la imagen completa.
+ *  Sale con 1 si el parche no reproduce la imagen o la firma no verifica.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/md.h"
+#include "mbedtls/pk.h"
+
+#include "delta_patch.h"
+#include "esp_timer.h"
+#include "ota_update.h"
+
+#define MATCH_MIN 8                // Ventana del indice
+#define HASH_BITS 20
+#define MAX_CANDIDATES 64
+#define EXACT_MAX 4096             // Lo que sigue lo recorre la extension
+#define EXTEND_SLACK 64            // Distintos de mas antes de cortar la extension
+#define COPY_MIN 4                 // Iguales mas cortos van dentro del ADD
+
+static struct
+{
+    const char *old_path;
+    const char *new_path;
+    const char *patch_path;
+    const char *apply_path;
+    const char *key_path;
+    const char *pub_path;
+    const char *sig_hex;
+    const char *url;
+    const char *out_path;
+    uint32_t id;
+    uint32_t chunk;
+} options = {
+    .url = "https://example.com/firmware.dpt",
+    .out_path = "ota_delta.json",
+    .id = 1,
+    .chunk = OTA_UPDATE_CHUNK_SIZE,
+};
+
+typedef struct
+{
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} buffer_t;
+
+static struct
+{
+    size_t old_bytes;
+    size_t new_bytes;
+    size_t patch_bytes;
+    int64_t diff_us;
+    int64_t apply_us;
+    delta_patch_stats_t ops;
+    int result;
+    bool match;
+    int signature; // -1 sin firma, 0 invalida, 1 valida
+} summary = {.signature = -1};
+
+static int load(const char *path, buffer_t *out)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    out->data = malloc(len + 1);
+    out->len = out->cap = len;
+    if (out->data == NULL || fread(out->data, 1, len, f) != (size_t)len)
+    {
+        fclose(f);
+        fprintf(stderr, "%s: no se pudo leer\n", path);
+        return -1;
+    }
+    out->data[len] = 0; // Las claves PEM se pasan con el 0 final
+    fclose(f);
+    return 0;
+}
+
+static int save(const char *path, const buffer_t *in)
+{
+    FILE *f = fopen(path, "wb");
+    if (f == NULL || fwrite(in->data, 1, in->len, f) != in->len)
+    {
+        perror(path);
+        if (f != NULL)
+            fclose(f);
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+static void append(buffer_t *out, const uint8_t *data, size_t len)
+{
+    if (out->len + len > out->cap)
+    {
+        out->cap = (out->len + len) * 2;
+        out->data = realloc(out->data, out->cap);
+    }
+    memcpy(out->data + out->len, data, len);
+    out->len += len;
+}
+
+static void sha256(const uint8_t *data, size_t len, uint8_t *hash)
+{
+    mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), data, len, hash);
+}
+
+static void to_hex(const uint8_t *data, size_t len, char *out)
+{
+    for (size_t i = 0; i < len; i++)
+        sprintf(out + 2 * i, "%02x", data[i]);
+}
+
+/*****************************************************
+ *   Generacion del parche                            *
+ ******************************************************/
+static void put_op(buffer_t *out, uint8_t op, uint32_t arg)
+{
+    uint8_t encoded[6];
+    size_t n = 0;
+    encoded[n++] = op;
+    do
+    {
+        encoded[n] = arg & 0x7F;
+        arg >>= 7;
+        if (arg != 0)
+            encoded[n] |= 0x80;
+        n++;
+    } while (arg != 0);
+    append(out, encoded, n);
+}
+
+static uint32_t hash_window(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return (uint32_t)((v * 0x9E3779B97F4A7C15ULL) >> (64 - HASH_BITS));
+}
+
+static size_t exact_length(const uint8_t *a, size_t a_len, const uint8_t *b, size_t b_len)
+{
+    size_t max = a_len < b_len ? a_len : b_len;
+    if (max > EXACT_MAX)
+        max = EXACT_MAX;
+    size_t n = 0;
+    while (n < max && a[n] == b[n])
+        n++;
+    return n;
+}
+
+/* Largo que maximiza 2 * iguales - largo, recorriendo hacia adelante (step 1) o atras (-1) */
+static size_t extend(const uint8_t *new_p, const uint8_t *old_p, size_t max, int step)
+{
+    long score = 0, best_score = 0;
+    size_t best = 0;
+    for (size_t k = 1; k <= max; k++)
+    {
+        long offset = step > 0 ? (long)k - 1 : -(long)k;
+        score += new_p[offset] == old_p[offset] ? 1 : -1;
+        if (score > best_score)
+        {
+            best_score = score;
+            best = k;
+        }
+        else if (score < best_score - EXTEND_SLACK)
+            break;
+    }
+    return best;
+}
+
+/* Tramo alineado: COPY de los iguales, ADD con las diferencias */
+static void emit_aligned(buffer_t *out, const uint8_t *new_p, const uint8_t *old_p, size_t len)
+{
+    size_t k = 0;
+    while (k < len)
+    {
+        size_t run = 0;
+        while (k + run < len && new_p[k + run] == old_p[k + run])
+            run++;
+        if (run >= COPY_MIN || k + run == len)
+        {
+            if (run > 0)
+                put_op(out, DELTA_PATCH_OP_COPY, run);
+            k += run;
+            continue;
+        }
+        size_t end = k;
+        while (end < len)
+        {
+            run = 0;
+            while (end + run < len && new_p[end + run] == old_p[end + run])
+                run++;
+            if (run >= COPY_MIN || (run > 0 && end + run == len))
+                break;
+            end += run > 0 ? run : 1;
+        }
+        put_op(out, DELTA_PATCH_OP_ADD, end - k);
+        for (size_t i = k; i < end; i++)
+        {
+            uint8_t diff = new_p[i] - old_p[i];
+            append(out, &diff, 1);
+        }
+        k = end;
+    }
+}
+
+static void make_patch(const buffer_t *old, const buffer_t *new, buffer_t *patch)
+{
+    int32_t *head = malloc(sizeof(int32_t) << HASH_BITS);
+    int32_t *chain = malloc(sizeof(int32_t) * (old->len + 1));
+    memset(head, 0xFF, sizeof(int32_t) << HASH_BITS);
+    for (size_t j = 0; j + MATCH_MIN <= old->len; j++)
+    {
+        uint32_t h = hash_window(old->data + j);
+        chain[j] = head[h];
+        head[h] = (int32_t)j;
+    }
+
+    delta_patch_header_t header = {.old_size = old->len, .new_size = new->len};
+    sha256(old->data, old->len, header.old_sha256);
+    sha256(new->data, new->len, header.new_sha256);
+    uint8_t encoded[DELTA_PATCH_HEADER_LEN];
+    delta_patch_write_header(encoded, &header);
+    append(patch, encoded, sizeof(encoded));
+
+    size_t emitted = 0;   // La nueva ya cubierta por el parche
+    size_t old_pos = 0;   // Cursor de la vieja en el aplicador
+    long alignment = 0;   // old - new de la ultima coincidencia
+    size_t i = 0;
+    while (i + MATCH_MIN <= new->len)
+    {
+        // Candidatos: la alineacion anterior y los del indice
+        size_t best_len = 0, best_j = 0;
+        long aligned = (long)i + alignment;
+        if (aligned >= 0 && (size_t)aligned < old->len)
+        {
+            best_len = exact_length(new->data + i, new->len - i, old->data + aligned, old->len - aligned);
+            best_j = aligned;
+        }
+        int32_t j = head[hash_window(new->data + i)];
+        for (int c = 0; j >= 0 && c < MAX_CANDIDATES && best_len < EXACT_MAX; c++, j = chain[j])
+        {
+            size_t len = exact_length(new->data + i, new->len - i, old->data + j, old->len - j);
+            if (len > best_len)
+            {
+                best_len = len;
+                best_j = j;
+            }
+        }
+        if (best_len < MATCH_MIN)
+        {
+            i++;
+            continue;
+        }
+
+        size_t back_max = i - emitted < best_j ? i - emitted : best_j;
+        size_t back = extend(new->data + i, old->data + best_j, back_max, -1);
+        size_t end = i + best_len;
+        size_t old_end = best_j + best_len;
+        size_t fwd_max = new->len - end < old->len - old_end ? new->len - end : old->len - old_end;
+        end += extend(new->data + end, old->data + old_end, fwd_max, 1);
+
+        size_t start = i - back;
+        size_t old_start = best_j - back;
+        if (start > emitted)
+        {
+            put_op(patch, DELTA_PATCH_OP_INSERT, start - emitted);
+            append(patch, new->data + emitted, start - emitted);
+        }
+        if (old_start != old_pos)
+        {
+            long seek = (long)old_start - (long)old_pos;
+            put_op(patch, DELTA_PATCH_OP_SEEK, (uint32_t)((seek << 1) ^ (seek >> 63)));
+        }
+        emit_aligned(patch, new->data + start, old->data + old_start, end - start);
+        old_pos = old_start + (end - start);
+        alignment = (long)best_j - (long)i;
+        emitted = i = end;
+    }
+    if (emitted < new->len)
+    {
+        put_op(patch, DELTA_PATCH_OP_INSERT, new->len - emitted);
+        append(patch, new->data + emitted, new->len - emitted);
+    }
+    uint8_t end_op = DELTA_PATCH_OP_END;
+    append(patch, &end_op, 1);
+    free(head);
+    free(chain);
+}
+
+/*****************************************************
+ *   Aplicacion (delta_patch.c del firmware)           *
+ ******************************************************/
+typedef struct
+{
+    const buffer_t *old;
+    buffer_t *out;
+} apply_ctx_t;
+
+static int read_old(uint32_t offset, uint8_t *buffer, size_t len, void *ctx)
+{
+    const buffer_t *old = ((apply_ctx_t *)ctx)->old;
+    if (offset + len > old->len)
+        return -1;
+    memcpy(buffer, old->data + offset, len);
+    return 0;
+}
+
+static int write_new(const uint8_t *data, size_t len, void *ctx)
+{
+    append(((apply_ctx_t *)ctx)->out, data, len);
+    return 0;
+}
+
+static int check_base(const delta_patch_header_t *header, void *ctx)
+{
+    const buffer_t *old = ((apply_ctx_t *)ctx)->old;
+    uint8_t hash[DELTA_PATCH_HASH_LEN];
+    if (header->old_size != old->len)
+        return -1;
+    sha256(old->data, old->len, hash);
+    return memcmp(hash, header->old_sha256, sizeof(hash)) == 0 ? 0 : -1;
+}
+
+static void apply_patch(const buffer_t *old, const buffer_t *patch, buffer_t *out)
+{
+    static delta_patch_t applier; // Lo mismo que ocupa en el ESP32
+    apply_ctx_t ctx = {.old = old, .out = out};
+    delta_patch_io_t io = {.header = check_base, .read_old = read_old, .write_new = write_new, .ctx = &ctx};
+    int64_t start = esp_timer_get_time();
+    delta_patch_init(&applier, &io);
+    int result = DELTA_PATCH_MORE;
+    for (size_t offset = 0; offset < patch->len && result == DELTA_PATCH_MORE; offset += options.chunk)
+    {
+        size_t n = patch->len - offset < options.chunk ? patch->len - offset : options.chunk;
+        result = delta_patch_feed(&applier, patch->data + offset, n);
+    }
+    summary.apply_us = esp_timer_get_time() - start;
+    summary.result = result;
+    summary.ops = applier.stats;
+
+    uint8_t hash[DELTA_PATCH_HASH_LEN];
+    sha256(out->data, out->len, hash);
+    summary.match = result == DELTA_PATCH_DONE && out->len == applier.header.new_size &&
+                    memcmp(hash, applier.header.new_sha256, sizeof(hash)) == 0;
+}
+
+/*****************************************************
+ *   Firma                                            *
+ ******************************************************/
+static int sign(const uint8_t *hash, uint8_t *sig, size_t *sig_len)
+{
+    buffer_t key_pem;
+    if (load(options.key_path, &key_pem) != 0)
+        return -1;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context ctr_drbg;
+    mbedtls_pk_context key;
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&ctr_drbg);
+    mbedtls_pk_init(&key);
+    int ret = mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy, NULL, 0);
+    if (ret == 0)
+        ret = mbedtls_pk_parse_key(&key, key_pem.data, key_pem.len + 1, NULL, 0, mbedtls_ctr_drbg_random, &ctr_drbg);
+    if (ret == 0)
+        ret = mbedtls_pk_sign(&key, MBEDTLS_MD_SHA256, hash, DELTA_PATCH_HASH_LEN, sig, OTA_UPDATE_SIG_MAX_LEN, sig_len,
+                              mbedtls_ctr_drbg_random, &ctr_drbg);
+    if (ret != 0)
+        fprintf(stderr, "%s: no se pudo firmar (-0x%04x)\n", options.key_path, -ret);
+    mbedtls_pk_free(&key);
+    mbedtls_ctr_drbg_free(&ctr_drbg);
+    mbedtls_entropy_free(&entropy);
+    free(key_pem.data);
+    return ret == 0 ? 0 : -1;
+}
+
+static bool verify(const uint8_t *hash)
+{
+    buffer_t pub_pem;
+    uint8_t sig[OTA_UPDATE_SIG_MAX_LEN];
+    size_t sig_len = strlen(options.sig_hex) / 2;
+    if (sig_len > sizeof(sig) || load(options.pub_path, &pub_pem) != 0)
+        return false;
+    for (size_t i = 0; i < sig_len; i++)
+    {
+        unsigned int byte;
+        if (sscanf(options.sig_hex + 2 * i, "%2x", &byte) != 1)
+            return false;
+        sig[i] = byte;
+    }
+    mbedtls_pk_context key;
+    mbedtls_pk_init(&key);
+    int ret = mbedtls_pk_parse_public_key(&key, pub_pem.data, pub_pem.len + 1);
+    if (ret == 0)
+        ret = mbedtls_pk_verify(&key, MBEDTLS_MD_SHA256, hash, DELTA_PATCH_HASH_LEN, sig, sig_len);
+    mbedtls_pk_free(&key);
+    free(pub_pem.data);
+    return ret == 0;
+}
+
+/* El pedido de /commands/ota que aplicaria este parche */
+static void print_command(const uint8_t *hash, const uint8_t *sig, size_t sig_len)
+{
+    char hash_hex[2 * DELTA_PATCH_HASH_LEN + 1];
+    char *sig_hex = malloc(2 * sig_len + 1);
+    to_hex(hash, DELTA_PATCH_HASH_LEN, hash_hex);
+    to_hex(sig, sig_len, sig_hex);
+    printf("{\"id\": %lu, \"url\": \"%s\", \"delta\": 1, \"size\": %zu, \"sha256\": \"%s\", \"sig\": \"%s\"}\n",
+           (unsigned long)options.id, options.url, summary.new_bytes, hash_hex, sig_hex);
+    free(sig_hex);
+}
+
+static void write_results(void)
+{
+    FILE *out = fopen(options.out_path, "w");
+    if (out == NULL)
+    {
+        perror(options.out_path);
+        return;
+    }
+    fprintf(out,
+            "{\n  \"old_bytes\": %zu,\n  \"new_bytes\": %zu,\n  \"patch_bytes\": %zu,\n  \"patch_ratio\": %.4f,\n"
+            "  \"diff_ms\": %.1f,\n  \"apply_ms\": %.1f,\n  \"apply_ram_bytes\": %zu,\n  \"chunk\": %lu,\n"
+            "  \"ops\": {\"count\": %lu, \"copied\": %lu, \"added\": %lu, \"inserted\": %lu},\n"
+            "  \"result\": \"%s\",\n  \"match\": %s,\n  \"signature\": %s\n}\n",
+            summary.old_bytes, summary.new_bytes, summary.patch_bytes,
+            summary.new_bytes > 0 ? (double)summary.patch_bytes / summary.new_bytes : 0.0, summary.diff_us / 1000.0,
+            summary.apply_us / 1000.0, sizeof(delta_patch_t), (unsigned long)options.chunk,
+            (unsigned long)summary.ops.ops, (unsigned long)summary.ops.copied, (unsigned long)summary.ops.added,
+            (unsigned long)summary.ops.inserted, delta_patch_strerror(summary.result), summary.match ? "true" : "false",
+            summary.signature < 0 ? "null" : summary.signature ? "true" : "false");
+    fclose(out);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Uso: %s --old v1.bin --new v2.bin --patch v2.dpt [--key firma.pem] [--url URL] [--id N]\n"
+            "          [--chunk bytes] [--out archivo.json]\n"
+            "     %s --old v1.bin --patch v2.dpt --apply v2.bin [--pub clave.pem --sig hex] [--chunk bytes]\n",
+            argv0, argv0);
+}
+
+static int parse_options(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (i + 1 >= argc)
+            return -1;
+        const char *value = argv[++i];
+        if (strcmp(arg, "--old") == 0)
+            options.old_path = value;
+        else if (strcmp(arg, "--new") == 0)
+            options.new_path = value;
+        else if (strcmp(arg, "--patch") == 0)
+            options.patch_path = value;
+        else if (strcmp(arg, "--apply") == 0)
+            options.apply_path = value;
+        else if (strcmp(arg, "--key") == 0)
+            options.key_path = value;
+        else if (strcmp(arg, "--pub") == 0)
+            options.pub_path = value;
+        else if (strcmp(arg, "--sig") == 0)
+            options.sig_hex = value;
+        else if (strcmp(arg, "--url") == 0)
+            options.url = value;
+        else if (strcmp(arg, "--id") == 0)
+            options.id = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--chunk") == 0)
+            options.chunk = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--out") == 0)
+            options.out_path = value;
+        else
+            return -1;
+    }
+    if (options.old_path == NULL || options.patch_path == NULL || options.chunk == 0)
+        return -1;
+    if ((options.pub_path == NULL) != (options.sig_hex == NULL))
+        return -1;
+    return (options.new_path != NULL) != (options.apply_path != NULL) ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    if (parse_options(argc, argv) != 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    buffer_t old = {0}, new = {0}, patch = {0}, out = {0};
+    if (load(options.old_path, &old) != 0)
+        return 1;
+    summary.old_bytes = old.len;
+    if (options.new_path != NULL)
+    {
+        if (load(options.new_path, &new) != 0)
+            return 1;
+        int64_t start = esp_timer_get_time();
+        make_patch(&old, &new, &patch);
+        summary.diff_us = esp_timer_get_time() - start;
+        if (save(options.patch_path, &patch) != 0)
+            return 1;
+    }
+    else if (load(options.patch_path, &patch) != 0)
+        return 1;
+    summary.patch_bytes = patch.len;
+
+    apply_patch(&old, &patch, &out);
+    summary.new_bytes = out.len;
+    if (options.apply_path != NULL && summary.match && save(options.apply_path, &out) != 0)
+        return 1;
+
+    uint8_t hash[DELTA_PATCH_HASH_LEN];
+    sha256(out.data, out.len, hash);
+    if (summary.match && options.key_path != NULL)
+    {
+        uint8_t sig[OTA_UPDATE_SIG_MAX_LEN];
+        size_t sig_len;
+        if (sign(hash, sig, &sig_len) != 0)
+            return 1;
+        print_command(hash, sig, sig_len);
+    }
+    if (options.pub_path != NULL)
+        summary.signature = summary.match && verify(hash);
+
+    const char *status = summary.signature == 0 ? "firma invalida" : "coincide";
+    if (!summary.match)
+        status = summary.result == DELTA_PATCH_DONE ? "sha256 distinto" : delta_patch_strerror(summary.result);
+    write_results();
+    fprintf(stderr, "%s: imagen %zu bytes, parche %zu bytes (%.1f%%), %lu ops, diff %.0f ms, aplicado en %.0f ms con %zu "
+                    "bytes de estado: %s -> %s\n",
+            options.patch_path, summary.new_bytes, summary.patch_bytes,
+            summary.new_bytes > 0 ? 100.0 * summary.patch_bytes / summary.new_bytes : 0.0,
+            (unsigned long)summary.ops.ops, summary.diff_us / 1000.0, summary.apply_us / 1000.0, sizeof(delta_patch_t),
+            status, options.out_path);
+    return summary.match && summary.signature != 0 ? 0 : 1;
+}
@@ -0,0 +1,303 @@
+/*
+ * dlog_decode.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Convierte a texto el log diferido grabado en binario (deferred_log.h,
+ *  set_sink). Los marcos traen la direccion del sitio de cada llamada y
+ *  la del tag; el formato y el tag se leen del ELF que genero el log
+ *  (build/<proyecto>.elf en el ESP32, el ejecutable en el host). El marco
+ *  DEFERRED_LOG_FRAME_ANCHOR da el desplazamiento de carga si el
+ *  ejecutable es PIE.
+ *
+ *  Uso: dlog_decode --elf ejecutable --in archivo [--out archivo|-]
+ *
+ *  Cada linea sale como la escribiria esp_log_write() en el equipo. Sale
+ *  con 1 si algun marco no se pudo resolver contra el ELF.
+ */
+
+#include <elf.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "deferred_log.h"
+
+static struct
+{
+    const char *elf_path;
+    const char *in_path;
+    const char *out_path;
+} options = {
+    .out_path = "-",
+};
+
+/* Secciones con contenido en el archivo: direccion virtual -> offset */
+typedef struct
+{
+    uint64_t addr;
+    uint64_t size;
+    uint64_t offset;
+} elf_section_t;
+
+static struct
+{
+    const uint8_t *data;
+    size_t len;
+    elf_section_t *sections;
+    size_t section_count;
+    uint64_t anchor; // Valor del simbolo deferred_log_anchor
+    bool anchor_found;
+} elf;
+
+static uint64_t read_uint(const uint8_t *p, int size)
+{
+    uint64_t value = 0;
+    for (int i = size - 1; i >= 0; i--)
+        value = value << 8 | p[i];
+    return value;
+}
+
+/* Solo little endian (Xtensa, RISC-V, x86-64) */
+static int load_elf(void)
+{
+    if (elf.len < EI_NIDENT || memcmp(elf.data, ELFMAG, SELFMAG) != 0 || elf.data[EI_DATA] != ELFDATA2LSB)
+        return -1;
+    bool is64 = elf.data[EI_CLASS] == ELFCLASS64;
+    if (!is64 && elf.data[EI_CLASS] != ELFCLASS32)
+        return -1;
+
+    size_t ehdr_size = is64 ? sizeof(Elf64_Ehdr) : sizeof(Elf32_Ehdr);
+    if (elf.len < ehdr_size)
+        return -1;
+    uint64_t shoff;
+    unsigned shentsize, shnum;
+    if (is64)
+    {
+        const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *)elf.data;
+        shoff = ehdr->e_shoff;
+        shentsize = ehdr->e_shentsize;
+        shnum = ehdr->e_shnum;
+    }
+    else
+    {
+        const Elf32_Ehdr *ehdr = (const Elf32_Ehdr *)elf.data;
+        shoff = ehdr->e_shoff;
+        shentsize = ehdr->e_shentsize;
+        shnum = ehdr->e_shnum;
+    }
+    if (shnum == 0 || shoff + (uint64_t)shentsize * shnum > elf.len ||
+        shentsize < (is64 ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr)))
+        return -1;
+
+    elf.sections = calloc(shnum, sizeof(*elf.sections));
+    if (elf.sections == NULL)
+        return -1;
+
+    for (unsigned i = 0; i < shnum; i++)
+    {
+        const uint8_t *sh = elf.data + shoff + (uint64_t)i * shentsize;
+        uint32_t type, link;
+        uint64_t flags, addr, offset, size, entsize;
+        if (is64)
+        {
+            const Elf64_Shdr *shdr = (const Elf64_Shdr *)sh;
+            type = shdr->sh_type, link = shdr->sh_link, flags = shdr->sh_flags, addr = shdr->sh_addr;
+            offset = shdr->sh_offset, size = shdr->sh_size, entsize = shdr->sh_entsize;
+        }
+        else
+        {
+            const Elf32_Shdr *shdr = (const Elf32_Shdr *)sh;
+            type = shdr->sh_type, link = shdr->sh_link, flags = shdr->sh_flags, addr = shdr->sh_addr;
+            offset = shdr->sh_offset, size = shdr->sh_size, entsize = shdr->sh_entsize;
+        }
+        if (offset + size > elf.len && type != SHT_NOBITS)
+            continue;
+
+        if (type == SHT_PROGBITS && (flags & SHF_ALLOC) && size > 0)
+            elf.sections[elf.section_count++] = (elf_section_t){addr, size, offset};
+
+        if (type == SHT_SYMTAB && !elf.anchor_found && link < shnum && entsize > 0)
+        {
+            // Tabla de cadenas de los simbolos
+            const uint8_t *strsh = elf.data + shoff + (uint64_t)link * shentsize;
+            uint64_t str_offset = is64 ? ((const Elf64_Shdr *)strsh)->sh_offset : ((const Elf32_Shdr *)strsh)->sh_offset;
+            uint64_t str_size = is64 ? ((const Elf64_Shdr *)strsh)->sh_size : ((const Elf32_Shdr *)strsh)->sh_size;
+            if (str_offset + str_size > elf.len)
+                continue;
+            for (uint64_t s = 0; s + entsize <= size; s += entsize)
+            {
+                const uint8_t *sym = elf.data + offset + s;
+                uint32_t name = (uint32_t)read_uint(sym, 4);
+                uint64_t value = is64 ? ((const Elf64_Sym *)sym)->st_value : ((const Elf32_Sym *)sym)->st_value;
+                if (name < str_size && strncmp((const char *)elf.data + str_offset + name, "deferred_log_anchor",
+                                               str_size - name) == 0)
+                {
+                    elf.anchor = value;
+                    elf.anchor_found = true;
+                    break;
+                }
+            }
+        }
+    }
+    return elf.anchor_found ? 0 : -2;
+}
+
+/* Puntero al contenido del ELF en la direccion addr, o NULL */
+static const uint8_t *elf_at(uint64_t addr, size_t *available)
+{
+    for (size_t i = 0; i < elf.section_count; i++)
+    {
+        const elf_section_t *section = &elf.sections[i];
+        if (addr >= section->addr && addr < section->addr + section->size)
+        {
+            *available = section->addr + section->size - addr;
+            return elf.data + section->offset + (addr - section->addr);
+        }
+    }
+    return NULL;
+}
+
+/* Cadena terminada en 0 dentro de la seccion */
+static const char *elf_string(uint64_t addr)
+{
+    size_t available;
+    const char *text = (const char *)elf_at(addr, &available);
+    if (text == NULL || memchr(text, 0, available) == NULL)
+        return NULL;
+    return text;
+}
+
+static const uint8_t *map_file(const char *path, size_t *len, int *fd)
+{
+    struct stat st;
+    *fd = open(path, O_RDONLY);
+    if (*fd < 0 || fstat(*fd, &st) != 0 || st.st_size == 0)
+    {
+        perror(path);
+        return NULL;
+    }
+    *len = st.st_size;
+    const uint8_t *data = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, *fd, 0);
+    if (data == MAP_FAILED)
+    {
+        perror(path);
+        return NULL;
+    }
+    return data;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Uso: %s --elf ejecutable --in archivo [--out archivo|-]\n", argv0);
+}
+
+static int parse_options(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (value == NULL)
+            return -1;
+        i++;
+        if (strcmp(arg, "--elf") == 0)
+            options.elf_path = value;
+        else if (strcmp(arg, "--in") == 0)
+            options.in_path = value;
+        else if (strcmp(arg, "--out") == 0)
+            options.out_path = value;
+        else
+            return -1;
+    }
+    return options.elf_path != NULL && options.in_path != NULL ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    if (parse_options(argc, argv) != 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int elf_fd, in_fd;
+    elf.data = map_file(options.elf_path, &elf.len, &elf_fd);
+    if (elf.data == NULL)
+        return 1;
+    int rc = load_elf();
+    if (rc != 0)
+    {
+        fprintf(stderr, "%s: %s\n", options.elf_path,
+                rc == -2 ? "no tiene el simbolo deferred_log_anchor" : "no es un ELF little endian valido");
+        return 1;
+    }
+    size_t in_len;
+    const uint8_t *in = map_file(options.in_path, &in_len, &in_fd);
+    if (in == NULL)
+        return 1;
+
+    FILE *out = strcmp(options.out_path, "-") == 0 ? stdout : fopen(options.out_path, "w");
+    if (out == NULL)
+    {
+        perror(options.out_path);
+        return 1;
+    }
+
+    static const char level_letters[] = "NEWIDV";
+    uint64_t slide = 0;
+    size_t messages = 0, unresolved = 0, offset = 0;
+    char line[DEFERRED_LOG_LINE_MAX];
+    while (offset + DEFERRED_LOG_FRAME_HEADER <= in_len)
+    {
+        const uint8_t *frame = in + offset;
+        uint8_t payload_len = frame[1];
+        if ((frame[0] != DEFERRED_LOG_FRAME_MSG && frame[0] != DEFERRED_LOG_FRAME_ANCHOR) ||
+            offset + DEFERRED_LOG_FRAME_HEADER + payload_len > in_len)
+        {
+            fprintf(stderr, "%s: marco invalido en el byte %zu\n", options.in_path, offset);
+            break;
+        }
+        offset += DEFERRED_LOG_FRAME_HEADER + payload_len;
+        uint64_t site_addr = read_uint(frame + 8, 8);
+        if (frame[0] == DEFERRED_LOG_FRAME_ANCHOR)
+        {
+            slide = site_addr - elf.anchor;
+            continue;
+        }
+
+        messages++;
+        uint32_t timestamp_ms = (uint32_t)read_uint(frame + 4, 4);
+        uint64_t tag_addr = read_uint(frame + 16, 8);
+        size_t available;
+        const uint8_t *site = elf_at(site_addr - slide, &available);
+        const char *format = site != NULL && available > sizeof(deferred_log_site_t)
+                                 ? elf_string(site_addr - slide + sizeof(deferred_log_site_t))
+                                 : NULL;
+        const char *tag = tag_addr != 0 ? elf_string(tag_addr - slide) : NULL;
+        if (format == NULL)
+        {
+            unresolved++;
+            fprintf(out, "? (%u) %s: <sitio 0x%llx no encontrado>\n", timestamp_ms, tag != NULL ? tag : "?",
+                    (unsigned long long)site_addr);
+            continue;
+        }
+        deferred_log_format(format, frame + DEFERRED_LOG_FRAME_HEADER, payload_len, line, sizeof(line));
+        uint8_t level = site[offsetof(deferred_log_site_t, level)];
+        fprintf(out, "%c (%u) %s: %s\n", level_letters[level % 6], timestamp_ms, tag != NULL ? tag : "?", line);
+    }
+
+    if (out != stdout)
+        fclose(out);
+    fprintf(stderr, "%s: %zu mensajes, %zu sin resolver\n", options.in_path, messages, unresolved);
+    munmap((void *)in, in_len);
+    close(in_fd);
+    munmap((void *)elf.data, elf.len);
+    close(elf_fd);
+    free(elf.sections);
+    return unresolved > 0 ? 1 : 0;
+}
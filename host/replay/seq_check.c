@@ -0,0 +1,309 @@
+/*
+ * seq_check.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Recorre un flujo de mensajes y reporta, por dispositivo, los numeros
+ *  de secuencia faltantes y duplicados (seq_tracker.h). La entrada es una
+ *  captura de telemetry_capture (.tcap) o texto con una publicacion por
+ *  linea, "topic payload", como la salida de mosquitto_sub -v:
+ *
+ *    mosquitto_sub -t '/devices/+/events/#' -v | seq_check --in -
+ *
+ *  El dispositivo se toma del topic (/devices/<id>/...). Los lotes
+ *  comprimidos por telemetry_dispatch (payload_codec.h) se decodifican.
+ *
+ *  Uso: seq_check --in archivo|- [--devices] [--out archivo.json]
+ *
+ *  Con --devices el JSON incluye el detalle de cada dispositivo. Sale con
+ *  1 si falta algun mensaje.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "payload_codec.h"
+#include "telemetry_capture.h"
+
+#include "seq_tracker.h"
+
+#define SEQ_CHECK_LINE_MAX (256 * 1024)
+
+static struct
+{
+    const char *in_path;
+    const char *out_path;
+    bool devices;
+} options = {
+    .out_path = "seq_check.json",
+};
+
+static seq_tracker_set_t trackers;
+static uint64_t messages = 0;
+static uint64_t without_seq = 0;
+static uint64_t without_device = 0;
+
+/* /devices/<id>/... -> <id> */
+static bool topic_device(const char *topic, size_t topic_len, const char **id, size_t *id_len)
+{
+    static const char prefix[] = "/devices/";
+    if (topic_len <= sizeof(prefix) - 1 || memcmp(topic, prefix, sizeof(prefix) - 1) != 0)
+        return false;
+    *id = topic + sizeof(prefix) - 1;
+    const char *end = memchr(*id, '/', topic + topic_len - *id);
+    *id_len = (end != NULL ? end : topic + topic_len) - *id;
+    return *id_len > 0;
+}
+
+static void consume(const char *topic, size_t topic_len, const char *payload, size_t payload_len)
+{
+    const char *id;
+    size_t id_len;
+    messages++;
+    if (!topic_device(topic, topic_len, &id, &id_len))
+    {
+        without_device++;
+        return;
+    }
+    seq_tracker_t *tracker = seq_tracker_set_get(&trackers, id, id_len);
+    if (tracker == NULL)
+    {
+        perror("seq_check");
+        exit(1);
+    }
+
+    // Un payload comprimido corrupto queda como mensaje sin seq
+    static uint8_t decoded[PAYLOAD_CODEC_MAX_INPUT];
+    if (payload_codec_is_encoded((const uint8_t *)payload, payload_len))
+    {
+        int decoded_len = payload_codec_decompress((const uint8_t *)payload, payload_len, decoded, sizeof(decoded));
+        payload = (const char *)decoded;
+        payload_len = decoded_len > 0 ? decoded_len : 0;
+    }
+
+    size_t offset = 0;
+    uint64_t seq;
+    bool resync;
+    bool found = false;
+    while (seq_tracker_parse(payload, payload_len, &offset, &seq, &resync) == 1)
+    {
+        seq_tracker_add(tracker, seq, resync);
+        found = true;
+    }
+    if (!found)
+        without_seq++;
+}
+
+/* Los registros referencian los topics por indice: se recuerdan los definidos en el segmento */
+typedef struct
+{
+    const char *topic;
+    uint16_t len;
+} topic_ref_t;
+
+static int read_capture(const uint8_t *data, size_t len)
+{
+    telemetry_capture_cursor_t cursor;
+    telemetry_capture_record_t record;
+    topic_ref_t *topics = NULL;
+    size_t topics_cap = 0;
+    if (telemetry_capture_cursor_init(&cursor, data, len) != ESP_OK)
+        return -1;
+    int rc;
+    while ((rc = telemetry_capture_next(&cursor, data, len, &record)) != 0)
+    {
+        if (rc < 0)
+        {
+            fprintf(stderr, "Captura invalida en el byte %zu\n", cursor.offset);
+            break;
+        }
+        if (rc == 2)
+            continue; // Segmento nuevo: los indices se reinician y se vuelven a definir
+        if (record.topic_defined)
+        {
+            if ((size_t)record.topic_index >= topics_cap)
+            {
+                size_t cap = topics_cap > 0 ? topics_cap * 2 : 64;
+                while (cap <= (size_t)record.topic_index)
+                    cap *= 2;
+                topic_ref_t *grown = realloc(topics, cap * sizeof(*topics));
+                if (grown == NULL)
+                {
+                    free(topics);
+                    return -1;
+                }
+                topics = grown;
+                topics_cap = cap;
+            }
+            topics[record.topic_index] = (topic_ref_t){record.topic, record.topic_len};
+        }
+
+        const char *topic = record.topic;
+        uint16_t topic_len = record.topic_len;
+        if (topic == NULL && record.topic_index >= 0 && (size_t)record.topic_index < topics_cap)
+        {
+            topic = topics[record.topic_index].topic;
+            topic_len = topics[record.topic_index].len;
+        }
+        consume(topic != NULL ? topic : "", topic_len, (const char *)record.payload, record.payload_len);
+    }
+    free(topics);
+    return rc < 0 ? -1 : 0;
+}
+
+static int read_lines(FILE *in)
+{
+    char *line = malloc(SEQ_CHECK_LINE_MAX);
+    if (line == NULL)
+        return -1;
+    while (fgets(line, SEQ_CHECK_LINE_MAX, in) != NULL)
+    {
+        size_t len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            len--;
+        const char *space = memchr(line, ' ', len);
+        if (space == NULL)
+            continue;
+        consume(line, space - line, space + 1, len - (space + 1 - line));
+    }
+    free(line);
+    return 0;
+}
+
+static int read_input(void)
+{
+    if (strcmp(options.in_path, "-") == 0)
+        return read_lines(stdin);
+
+    int fd = open(options.in_path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        perror(options.in_path);
+        return -1;
+    }
+    size_t len = st.st_size;
+    const uint8_t *data = len > 0 ? mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    if (len > 0 && data == MAP_FAILED)
+    {
+        perror(options.in_path);
+        close(fd);
+        return -1;
+    }
+
+    int rc;
+    if (len >= TELEMETRY_CAPTURE_HEADER_LEN && memcmp(data, TELEMETRY_CAPTURE_MAGIC, 4) == 0)
+    {
+        madvise((void *)data, len, MADV_SEQUENTIAL);
+        rc = read_capture(data, len);
+    }
+    else
+    {
+        FILE *in = fdopen(dup(fd), "r");
+        rc = in != NULL ? read_lines(in) : -1;
+        if (in != NULL)
+            fclose(in);
+    }
+    if (len > 0)
+        munmap((void *)data, len);
+    close(fd);
+    return rc;
+}
+
+static void write_stats(FILE *out, const seq_tracker_stats_t *stats)
+{
+    fprintf(out,
+            "{\"received\": %llu, \"duplicates\": %llu, \"missing\": %llu, \"gaps\": %llu, \"reordered\": %llu, "
+            "\"too_old\": %llu, \"resyncs\": %llu, \"resync_skipped\": %llu}",
+            (unsigned long long)stats->received, (unsigned long long)stats->duplicates, (unsigned long long)stats->missing,
+            (unsigned long long)stats->gaps, (unsigned long long)stats->reordered, (unsigned long long)stats->too_old,
+            (unsigned long long)stats->resyncs, (unsigned long long)stats->resync_skipped);
+}
+
+static void write_results(const seq_tracker_stats_t *totals)
+{
+    FILE *out = fopen(options.out_path, "w");
+    if (out == NULL)
+    {
+        perror(options.out_path);
+        return;
+    }
+    fprintf(out, "{\n  \"messages\": %llu,\n  \"without_seq\": %llu,\n  \"without_device\": %llu,\n  \"devices\": %zu,\n",
+            (unsigned long long)messages, (unsigned long long)without_seq, (unsigned long long)without_device, trackers.count);
+    fprintf(out, "  \"totals\": ");
+    write_stats(out, totals);
+    if (options.devices)
+    {
+        fprintf(out, ",\n  \"per_device\": {");
+        bool first = true;
+        for (size_t i = 0; i < trackers.capacity; i++)
+        {
+            if (trackers.entries[i].key == NULL)
+                continue;
+            fprintf(out, "%s\n    \"%s\": ", first ? "" : ",", trackers.entries[i].key);
+            write_stats(out, &trackers.entries[i].tracker.stats);
+            first = false;
+        }
+        fprintf(out, "\n  }");
+    }
+    fprintf(out, "\n}\n");
+    fclose(out);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Uso: %s --in archivo|- [--devices] [--out archivo.json]\n", argv0);
+}
+
+static int parse_options(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--devices") == 0)
+        {
+            options.devices = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            return -1;
+        const char *value = argv[++i];
+        if (strcmp(arg, "--in") == 0)
+            options.in_path = value;
+        else if (strcmp(arg, "--out") == 0)
+            options.out_path = value;
+        else
+            return -1;
+    }
+    return options.in_path != NULL ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    if (parse_options(argc, argv) != 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    seq_tracker_set_init(&trackers);
+    if (read_input() != 0)
+        return 1;
+
+    seq_tracker_stats_t totals;
+    seq_tracker_set_finish(&trackers, &totals);
+    write_results(&totals);
+    fprintf(stderr,
+            "%llu mensajes de %zu dispositivos: %llu numeros, %llu duplicados, %llu faltantes en %llu huecos, "
+            "%llu fuera de orden, %llu reinicios de secuencia -> %s\n",
+            (unsigned long long)messages, trackers.count, (unsigned long long)totals.received,
+            (unsigned long long)totals.duplicates, (unsigned long long)totals.missing, (unsigned long long)totals.gaps,
+            (unsigned long long)totals.reordered, (unsigned long long)totals.resyncs, options.out_path);
+    seq_tracker_set_free(&trackers);
+    return totals.missing == 0 ? 0 : 1;
+}
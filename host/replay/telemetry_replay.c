@@ -0,0 +1,536 @@
+/*
+ * telemetry_replay.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Reproduce una captura de telemetry_capture contra un broker MQTT,
+ *  respetando los intervalos entre publicaciones divididos por --speed
+ *  (0 = tan rapido como se pueda). El archivo se lee con mmap y se
+ *  recorre una sola vez: las paginas ya enviadas se liberan, de modo que
+ *  una captura de varios GB no ocupa memoria.
+ *
+ *  Uso: telemetry_replay --in archivo.tcap [--broker host:puerto]
+ *                        [--speed X] [--connections N] [--qos -1|0|1]
+ *                        [--window N] [--client-prefix P] [--info]
+ *                        [--out archivo.json]
+ *
+ *  Los topics se reparten entre las conexiones por indice, asi cada topic
+ *  conserva su orden. --qos -1 usa el QoS grabado. --info solo recorre el
+ *  archivo e informa su contenido.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "telemetry_capture.h"
+
+#include "latency_histogram.h"
+#include "mqtt_wire.h"
+
+#define REPLAY_MAX_CONNECTIONS 256
+#define REPLAY_RX_BUFFER_SIZE 4096
+#define REPLAY_ACK_TIMEOUT_MS 5000
+#define REPLAY_RELEASE_CHUNK (64u << 20) // Bytes ya enviados que se devuelven al kernel de una vez
+#define REPLAY_PUBLISH_HEADER_MAX (1 + 4 + 2 + UINT16_MAX + 2)
+
+typedef struct
+{
+    int fd;
+    uint16_t next_packet_id;
+    uint32_t inflight;
+    size_t rx_len;
+    uint8_t rx[REPLAY_RX_BUFFER_SIZE];
+} replay_connection_t;
+
+typedef struct
+{
+    size_t offset; // Dentro del mmap
+    uint16_t len;
+} topic_ref_t;
+
+static struct
+{
+    const char *in_path;
+    const char *broker;
+    const char *client_prefix;
+    const char *out_path;
+    double speed;
+    int connections;
+    int qos; // -1 = el de la captura
+    uint32_t window;
+    bool info;
+} options = {
+    .broker = "127.0.0.1:1883",
+    .client_prefix = "replay-",
+    .out_path = "replay_results.json",
+    .speed = 1.0,
+    .connections = 1,
+    .qos = -1,
+    .window = 32,
+};
+
+static struct
+{
+    uint64_t records;
+    uint64_t payload_bytes;
+    uint64_t bytes_sent;
+    uint64_t acked;
+    uint32_t segments;
+    uint32_t max_topics;
+    int64_t capture_span_us;
+    bool truncated_tail;
+    bool corrupt;
+} totals;
+
+static replay_connection_t *connections;
+static topic_ref_t *topics;
+static size_t topics_capacity;
+static latency_histogram_t lateness;
+static volatile sig_atomic_t stop_requested = 0;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void on_signal(int signal_number)
+{
+    (void)signal_number;
+    stop_requested = 1;
+}
+
+/*****************************************************
+ *   Conexiones                                       *
+ ******************************************************/
+static bool send_all(int fd, struct iovec *iov, int iov_count)
+{
+    while (iov_count > 0)
+    {
+        ssize_t n = writev(fd, iov, iov_count);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        totals.bytes_sent += n;
+        while (iov_count > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            iov++;
+            iov_count--;
+        }
+        if (iov_count > 0)
+        {
+            iov->iov_base = (uint8_t *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+/* Lee lo que haya (o espera hasta timeout_ms) y cuenta los PUBACK; devuelve -1 si se cerro la conexion */
+static int connection_poll(replay_connection_t *connection, int timeout_ms)
+{
+    struct pollfd pfd = {.fd = connection->fd, .events = POLLIN};
+    if (poll(&pfd, 1, timeout_ms) <= 0)
+        return 0;
+    ssize_t n = recv(connection->fd, connection->rx + connection->rx_len, sizeof(connection->rx) - connection->rx_len,
+                     MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+        return -1;
+    if (n < 0)
+        return 0;
+    connection->rx_len += n;
+
+    mqtt_packet_t packet;
+    size_t offset = 0;
+    int rc;
+    while ((rc = mqtt_wire_parse(connection->rx + offset, connection->rx_len - offset, &packet)) == 1)
+    {
+        if (packet.type == MQTT_PACKET_PUBACK && connection->inflight > 0)
+        {
+            connection->inflight--;
+            totals.acked++;
+        }
+        offset += packet.length;
+    }
+    if (rc < 0)
+        return -1;
+    memmove(connection->rx, connection->rx + offset, connection->rx_len - offset);
+    connection->rx_len -= offset;
+    return 1;
+}
+
+static int connection_open(replay_connection_t *connection, const struct addrinfo *address, int index)
+{
+    char client_id[64];
+    uint8_t buffer[256];
+
+    connection->fd = socket(address->ai_family, SOCK_STREAM, 0);
+    if (connection->fd < 0 || connect(connection->fd, address->ai_addr, address->ai_addrlen) != 0)
+        return -1;
+    int one = 1;
+    setsockopt(connection->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    snprintf(client_id, sizeof(client_id), "%s%d", options.client_prefix, index);
+    size_t len = mqtt_wire_connect(buffer, sizeof(buffer), client_id, NULL, NULL, 0);
+    struct iovec iov = {.iov_base = buffer, .iov_len = len};
+    if (len == 0 || !send_all(connection->fd, &iov, 1))
+        return -1;
+
+    // CONNACK
+    int64_t deadline = now_us() + REPLAY_ACK_TIMEOUT_MS * 1000LL;
+    while (now_us() < deadline)
+    {
+        struct pollfd pfd = {.fd = connection->fd, .events = POLLIN};
+        if (poll(&pfd, 1, 100) <= 0)
+            continue;
+        ssize_t n = recv(connection->fd, connection->rx + connection->rx_len, sizeof(connection->rx) - connection->rx_len, 0);
+        if (n <= 0)
+            return -1;
+        connection->rx_len += n;
+        mqtt_packet_t packet;
+        uint16_t return_code;
+        if (mqtt_wire_parse(connection->rx, connection->rx_len, &packet) == 1)
+        {
+            if (packet.type != MQTT_PACKET_CONNACK || mqtt_wire_parse_packet_id(&packet, &return_code) != 0 ||
+                return_code != MQTT_CONNACK_ACCEPTED)
+                return -1;
+            memmove(connection->rx, connection->rx + packet.length, connection->rx_len - packet.length);
+            connection->rx_len -= packet.length;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int open_connections(void)
+{
+    char host[256];
+    const char *colon = strrchr(options.broker, ':');
+    size_t host_len = colon != NULL ? (size_t)(colon - options.broker) : strlen(options.broker);
+    if (host_len >= sizeof(host))
+        return -1;
+    memcpy(host, options.broker, host_len);
+    host[host_len] = 0;
+
+    struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *address;
+    if (getaddrinfo(host, colon != NULL ? colon + 1 : "1883", &hints, &address) != 0)
+        return -1;
+    connections = calloc(options.connections, sizeof(replay_connection_t));
+    int rc = connections != NULL ? 0 : -1;
+    for (int i = 0; i < options.connections && rc == 0; i++)
+        rc = connection_open(&connections[i], address, i);
+    freeaddrinfo(address);
+    return rc;
+}
+
+static bool publish(replay_connection_t *connection, const char *topic, uint16_t topic_len,
+                    const telemetry_capture_record_t *record)
+{
+    static uint8_t header[REPLAY_PUBLISH_HEADER_MAX];
+    uint8_t qos = options.qos >= 0 ? (uint8_t)options.qos : (record->qos > 0 ? 1 : 0);
+
+    // Ventana de QoS 1 llena: se espera algun PUBACK
+    while (qos > 0 && connection->inflight >= options.window)
+        if (connection_poll(connection, REPLAY_ACK_TIMEOUT_MS) <= 0)
+            return false;
+
+    uint16_t packet_id = 0;
+    if (qos > 0)
+    {
+        if (++connection->next_packet_id == 0)
+            connection->next_packet_id = 1;
+        packet_id = connection->next_packet_id;
+    }
+    size_t header_len = mqtt_wire_publish_header(header, sizeof(header), topic, topic_len, record->payload_len, qos, packet_id);
+    if (header_len == 0)
+        return false;
+
+    // El payload sale directo desde el mmap
+    struct iovec iov[2] = {
+        {.iov_base = header, .iov_len = header_len},
+        {.iov_base = (void *)record->payload, .iov_len = record->payload_len},
+    };
+    if (!send_all(connection->fd, iov, 2))
+        return false;
+    if (qos > 0)
+        connection->inflight++;
+    // Se drenan los PUBACK que ya llegaron, sin esperar
+    return connection_poll(connection, 0) >= 0;
+}
+
+static void close_connections(void)
+{
+    uint8_t buffer[2];
+    int64_t deadline = now_us() + REPLAY_ACK_TIMEOUT_MS * 1000LL;
+
+    for (int i = 0; i < options.connections; i++)
+    {
+        replay_connection_t *connection = &connections[i];
+        while (connection->inflight > 0 && now_us() < deadline)
+            if (connection_poll(connection, 100) < 0)
+                break;
+        size_t len = mqtt_wire_simple(buffer, sizeof(buffer), MQTT_PACKET_DISCONNECT);
+        struct iovec iov = {.iov_base = buffer, .iov_len = len};
+        send_all(connection->fd, &iov, 1);
+        close(connection->fd);
+    }
+}
+
+/*****************************************************
+ *   Reproduccion                                     *
+ ******************************************************/
+static bool remember_topic(const uint8_t *base, const telemetry_capture_record_t *record)
+{
+    if ((size_t)record->topic_index >= topics_capacity)
+    {
+        size_t capacity = topics_capacity > 0 ? topics_capacity * 2 : 1024;
+        while (capacity <= (size_t)record->topic_index)
+            capacity *= 2;
+        topic_ref_t *grown = realloc(topics, capacity * sizeof(*topics));
+        if (grown == NULL)
+            return false;
+        topics = grown;
+        topics_capacity = capacity;
+    }
+    topics[record->topic_index] = (topic_ref_t){(size_t)((const uint8_t *)record->topic - base), record->topic_len};
+    if ((uint32_t)record->topic_index + 1 > totals.max_topics)
+        totals.max_topics = record->topic_index + 1;
+    return true;
+}
+
+static uint32_t topic_connection(const telemetry_capture_record_t *record, const char *topic, uint16_t topic_len)
+{
+    if (record->topic_index >= 0)
+        return (uint32_t)record->topic_index % options.connections;
+    uint32_t hash = 2166136261u;
+    for (uint16_t i = 0; i < topic_len; i++)
+        hash = (hash ^ (uint8_t)topic[i]) * 16777619u;
+    return hash % options.connections;
+}
+
+static int replay(const uint8_t *data, size_t len)
+{
+    telemetry_capture_cursor_t cursor;
+    telemetry_capture_record_t record;
+    size_t released = 0;
+    long page_size = sysconf(_SC_PAGESIZE);
+    int64_t first_us = -1;
+    int64_t replay_start_us = now_us();
+    int rc = 0;
+
+    if (telemetry_capture_cursor_init(&cursor, data, len) != ESP_OK)
+    {
+        fprintf(stderr, "%s no es una captura valida\n", options.in_path);
+        return -1;
+    }
+    while (!stop_requested && (rc = telemetry_capture_next(&cursor, data, len, &record)) != 0)
+    {
+        if (rc < 0)
+        {
+            totals.corrupt = true;
+            fprintf(stderr, "Registro invalido en el byte %zu, se detiene la reproduccion\n", cursor.offset);
+            break;
+        }
+        if (rc == 2)
+        {
+            totals.segments++;
+            continue;
+        }
+        if (record.topic_defined && !remember_topic(data, &record))
+            return -1;
+
+        const char *topic = record.topic;
+        uint16_t topic_len = record.topic_len;
+        if (topic == NULL)
+        {
+            topic = (const char *)data + topics[record.topic_index].offset;
+            topic_len = topics[record.topic_index].len;
+        }
+        if (first_us < 0)
+            first_us = record.timestamp_us;
+        totals.capture_span_us = record.timestamp_us - first_us;
+
+        if (!options.info)
+        {
+            if (options.speed > 0)
+            {
+                int64_t due_us = replay_start_us + (int64_t)((record.timestamp_us - first_us) / options.speed);
+                int64_t wait_us = due_us - now_us();
+                if (wait_us > 0)
+                    usleep(wait_us);
+                int64_t late_us = now_us() - due_us;
+                latency_histogram_record(&lateness, late_us > 0 ? late_us : 0);
+            }
+            if (!publish(&connections[topic_connection(&record, topic, topic_len)], topic, topic_len, &record))
+            {
+                fprintf(stderr, "Se perdio la conexion con el broker\n");
+                return -1;
+            }
+        }
+        totals.records++;
+        totals.payload_bytes += record.payload_len;
+
+        // Paginas ya enviadas: no se vuelven a leer (los topics definidos se consultan por offset, quedan en el page cache)
+        if (cursor.offset - released >= REPLAY_RELEASE_CHUNK)
+        {
+            size_t upto = cursor.offset & ~((size_t)page_size - 1);
+            madvise((uint8_t *)data + released, upto - released, MADV_DONTNEED);
+            released = upto;
+        }
+    }
+    totals.truncated_tail = rc == 0 && cursor.offset < len;
+    return 0;
+}
+
+/*****************************************************
+ *   main                                             *
+ ******************************************************/
+static void write_results(double elapsed_s, size_t file_len)
+{
+    FILE *out = fopen(options.out_path, "w");
+    if (out == NULL)
+    {
+        perror(options.out_path);
+        return;
+    }
+    double span_s = totals.capture_span_us / 1e6;
+
+    fprintf(out, "{\n  \"schema\": 1,\n  \"capture\": \"%s\",\n  \"file_bytes\": %zu,\n", options.in_path, file_len);
+    fprintf(out, "  \"records\": %llu,\n  \"segments\": %u,\n  \"topics\": %u,\n  \"payload_bytes\": %llu,\n",
+            (unsigned long long)totals.records, totals.segments, totals.max_topics, (unsigned long long)totals.payload_bytes);
+    fprintf(out, "  \"capture_span_s\": %.3f,\n  \"truncated_tail\": %s,\n  \"corrupt\": %s",
+            span_s, totals.truncated_tail ? "true" : "false", totals.corrupt ? "true" : "false");
+    if (!options.info)
+    {
+        fprintf(out, ",\n  \"broker\": \"%s\",\n  \"connections\": %d,\n  \"speed\": %.3f,\n  \"qos\": %d,\n",
+                options.broker, options.connections, options.speed, options.qos);
+        fprintf(out, "  \"elapsed_s\": %.3f,\n  \"effective_speed\": %.3f,\n  \"publish_rate\": %.1f,\n",
+                elapsed_s, elapsed_s > 0 ? span_s / elapsed_s : 0.0, elapsed_s > 0 ? totals.records / elapsed_s : 0.0);
+        fprintf(out, "  \"bytes_sent\": %llu,\n  \"acked\": %llu,\n", (unsigned long long)totals.bytes_sent,
+                (unsigned long long)totals.acked);
+        fprintf(out, "  \"lateness_us\": {\"p50\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu}",
+                (unsigned long long)latency_histogram_percentile(&lateness, 50),
+                (unsigned long long)latency_histogram_percentile(&lateness, 99),
+                (unsigned long long)latency_histogram_percentile(&lateness, 99.9), (unsigned long long)lateness.max_us);
+    }
+    fprintf(out, "\n}\n");
+    fclose(out);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Uso: %s --in archivo.tcap [--broker host:puerto] [--speed X (0 = sin pausas)]\n"
+            "          [--connections N] [--qos -1|0|1] [--window N] [--client-prefix P] [--info]\n"
+            "          [--out archivo.json]\n",
+            argv0);
+}
+
+static int parse_options(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--info") == 0)
+        {
+            options.info = true;
+            continue;
+        }
+        if (value == NULL)
+            return -1;
+        i++;
+        if (strcmp(arg, "--in") == 0)
+            options.in_path = value;
+        else if (strcmp(arg, "--broker") == 0)
+            options.broker = value;
+        else if (strcmp(arg, "--speed") == 0)
+            options.speed = strtod(value, NULL);
+        else if (strcmp(arg, "--connections") == 0)
+            options.connections = atoi(value);
+        else if (strcmp(arg, "--qos") == 0)
+            options.qos = atoi(value);
+        else if (strcmp(arg, "--window") == 0)
+            options.window = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--client-prefix") == 0)
+            options.client_prefix = value;
+        else if (strcmp(arg, "--out") == 0)
+            options.out_path = value;
+        else
+            return -1;
+    }
+    if (options.in_path == NULL || options.speed < 0 || options.connections < 1 ||
+        options.connections > REPLAY_MAX_CONNECTIONS || options.qos < -1 || options.qos > 1 || options.window == 0)
+        return -1;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (parse_options(argc, argv) != 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+    latency_histogram_init(&lateness);
+
+    int fd = open(options.in_path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        perror(options.in_path);
+        return 1;
+    }
+    size_t file_len = (size_t)st.st_size;
+    const uint8_t *data = file_len > 0 ? mmap(NULL, file_len, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (data == MAP_FAILED || data == NULL)
+    {
+        fprintf(stderr, "No se pudo mapear %s\n", options.in_path);
+        return 1;
+    }
+    madvise((void *)data, file_len, MADV_SEQUENTIAL);
+
+    if (!options.info && open_connections() != 0)
+    {
+        fprintf(stderr, "No se pudo conectar a %s\n", options.broker);
+        return 1;
+    }
+
+    int64_t start = now_us();
+    int rc = replay(data, file_len);
+    if (!options.info)
+        close_connections();
+    double elapsed_s = (now_us() - start) / 1e6;
+
+    write_results(elapsed_s, file_len);
+    fprintf(stderr, "%llu registros (%.1f s de captura) en %.3f s, %llu PUBACK%s -> %s\n",
+            (unsigned long long)totals.records, totals.capture_span_us / 1e6, elapsed_s,
+            (unsigned long long)totals.acked, totals.truncated_tail ? ", registro final incompleto" : "", options.out_path);
+    munmap((void *)data, file_len);
+    return rc == 0 && !totals.corrupt ? 0 : 1;
+}
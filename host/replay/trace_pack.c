@@ -0,0 +1,110 @@
+/*
+ * trace_pack.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Convierte una traza CSV del sensor (sensor_trace.h) al formato
+ *  binario: registros de largo fijo, que el lector ubica con busqueda
+ *  binaria y ocupan menos flash que el texto.
+ *
+ *  Uso: trace_pack entrada.csv salida.tpht
+ *
+ *  La salida se graba en la particion "trace" con
+ *  parttool.py write_partition --partition-name trace --input salida.tpht
+ *  o se pasa a fault_runner --trace.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sensor_trace.h"
+
+static void put_u32(uint8_t *p, uint32_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static void put_f32(uint8_t *p, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put_u32(p, bits);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Uso: %s entrada.csv salida.tpht\n", argv[0]);
+        return 2;
+    }
+
+    const uint8_t *data;
+    size_t len;
+    sensor_trace_t trace;
+    if (sensor_trace_map(argv[1], &data, &len) != ESP_OK || sensor_trace_open(&trace, data, len) != ESP_OK)
+    {
+        fprintf(stderr, "%s no es una traza valida\n", argv[1]);
+        return 1;
+    }
+    if (trace.last_ms - trace.first_ms > UINT32_MAX)
+    {
+        fprintf(stderr, "%s dura mas de 49 dias\n", argv[1]);
+        return 1;
+    }
+
+    FILE *out = fopen(argv[2], "wb");
+    if (out == NULL)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+
+    // El encabezado se reescribe al final con la cantidad de registros
+    uint8_t header[SENSOR_TRACE_HEADER_LEN] = {0};
+    fwrite(header, 1, sizeof(header), out);
+
+    uint32_t points = 0, skipped = 0;
+    int64_t previous_ms = INT64_MIN;
+    size_t offset = trace.first_offset;
+    sensor_trace_point_t point;
+    while (sensor_trace_next(&trace, &offset, &point))
+    {
+        if (point.time_ms < previous_ms || point.time_ms - trace.first_ms > UINT32_MAX)
+        {
+            skipped++; // El lector necesita tiempos crecientes
+            continue;
+        }
+        previous_ms = point.time_ms;
+        uint8_t record[SENSOR_TRACE_RECORD_LEN];
+        put_u32(record, (uint32_t)(point.time_ms - trace.first_ms));
+        put_f32(record + 4, point.temp_c);
+        put_f32(record + 8, point.press_hpa);
+        put_f32(record + 12, point.hum_pct);
+        fwrite(record, 1, sizeof(record), out);
+        points++;
+    }
+
+    memcpy(header, SENSOR_TRACE_MAGIC, 4);
+    header[4] = SENSOR_TRACE_VERSION;
+    header[5] = SENSOR_TRACE_RECORD_LEN;
+    put_u32(header + 8, points);
+    put_u32(header + 12, (uint32_t)(uint64_t)trace.first_ms);
+    put_u32(header + 16, (uint32_t)((uint64_t)trace.first_ms >> 32));
+    fseek(out, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), out);
+    if (fclose(out) != 0)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+    sensor_trace_unmap();
+
+    fprintf(stderr, "%u muestras (%u fuera de orden descartadas), %lld s, %zu -> %zu bytes\n", points, skipped,
+            (long long)((trace.last_ms - trace.first_ms) / 1000), trace.len,
+            SENSOR_TRACE_HEADER_LEN + (size_t)points * SENSOR_TRACE_RECORD_LEN);
+    return 0;
+}
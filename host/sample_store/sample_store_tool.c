@@ -0,0 +1,349 @@
+/*
+ * sample_store_tool.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Ejercita sample_store y las respuestas de historial sobre una imagen de
+ *  la particion (un archivo, ver sample_store_host.c):
+ *
+ *   1. abre la imagen y mide la recuperacion del indice,
+ *   2. agrega --append muestras sinteticas cada --period-ms; con
+ *      --cut-after corta la energia tras N bytes grabados, vuelve a abrir
+ *      y verifica que la serie sigue siendo legible,
+ *   3. con --query pide el rango [--from, --to] como lo haria
+ *      /commands/history, decodifica cada bloque y compara cada muestra con
+ *      el valor sintetico de su hora.
+ *
+ *  Uso: sample_store_tool --image archivo [--append N] [--period-ms P]
+ *                         [--start-ms T] [--cut-after bytes] [--query]
+ *                         [--from ms] [--to ms] [--max N] [--out archivo.json]
+ *
+ *  La misma imagen se puede grabar en el ESP32 con
+ *  parttool.py write_partition --partition-name samples --input archivo.
+ *  Sale con 1 si alguna muestra no coincide o un bloque no decodifica.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "host_fault.h"
+#include "sample_history.h"
+#include "sample_store.h"
+
+#define DEFAULT_START_MS 1760000000000LL
+
+static struct
+{
+    const char *image;
+    const char *out_path;
+    uint32_t append;
+    uint32_t period_ms;
+    int64_t start_ms;
+    int64_t cut_after;
+    bool query;
+    int64_t from_ms;
+    int64_t to_ms;
+    uint32_t max_records;
+} options = {
+    .out_path = "sample_store_tool.json",
+    .period_ms = 240000,
+    .start_ms = -1,
+    .cut_after = -1,
+    .from_ms = 0,
+    .to_ms = INT64_MAX,
+};
+
+typedef struct
+{
+    int64_t open_us;
+    sample_store_stats_t stats;
+} open_result_t;
+
+static struct
+{
+    uint32_t appended;
+    uint32_t failed;
+    int64_t elapsed_us;
+    int64_t first_ms;
+    int64_t last_ms;
+} append_result;
+
+/* Resultado de la consulta, acumulado bloque a bloque por el sink */
+static struct
+{
+    uint32_t chunks;
+    uint32_t records;
+    uint64_t bytes;
+    size_t max_chunk;
+    uint32_t decode_errors;
+    uint32_t mismatches;
+    uint32_t out_of_range;
+    uint32_t out_of_order;
+    uint32_t gaps;
+    uint32_t bad_index;
+    bool last_seen;
+    bool incomplete;
+    int64_t first_ms;
+    int64_t last_ms;
+    int64_t elapsed_us;
+} query_result;
+
+/* Valor sintetico de cada hora: la verificacion lo recalcula sin guardar nada */
+static void synthetic_record(sample_record_t *record, int64_t time_ms)
+{
+    double day = (double)(time_ms % 86400000LL) / 86400000.0;
+    double hour = (double)(time_ms % 3600000LL) / 3600000.0;
+    sample_store_make_record(record, time_ms, (float)(20.0 + 8.0 * sin(2 * M_PI * day)),
+                             (float)(55.0 + 20.0 * cos(2 * M_PI * day)), (float)(1013.0 + 5.0 * sin(2 * M_PI * hour)));
+}
+
+static int open_store(open_result_t *result)
+{
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = sample_store.open(options.image);
+    result->open_us = esp_timer_get_time() - start_us;
+    if (err != ESP_OK)
+    {
+        fprintf(stderr, "%s: %s\n", options.image, esp_err_to_name(err));
+        return -1;
+    }
+    sample_store.get_stats(&result->stats);
+    return 0;
+}
+
+static void append_samples(void)
+{
+    sample_store_stats_t stats;
+    sample_store.get_stats(&stats);
+    int64_t time_ms = options.start_ms;
+    if (time_ms < 0)
+        time_ms = stats.head_seq != 0 ? stats.newest_ms + options.period_ms : DEFAULT_START_MS;
+    append_result.first_ms = time_ms;
+    append_result.last_ms = time_ms;
+
+    if (options.cut_after >= 0)
+        host_fault_flash_cut((uint32_t)options.cut_after);
+
+    int64_t start_us = esp_timer_get_time();
+    for (uint32_t i = 0; i < options.append; i++, time_ms += options.period_ms)
+    {
+        sample_record_t record;
+        synthetic_record(&record, time_ms);
+        if (sample_store.append(&record) != ESP_OK)
+        {
+            append_result.failed++;
+            if (host_fault_flash_is_cut())
+                break;
+            continue;
+        }
+        append_result.appended++;
+        append_result.last_ms = time_ms;
+    }
+    append_result.elapsed_us = esp_timer_get_time() - start_us;
+}
+
+static int check_chunk(const uint8_t *chunk, size_t len, void *ctx)
+{
+    static sample_record_t records[SAMPLE_HISTORY_CHUNK_RECORDS_MAX];
+    sample_history_chunk_info_t info;
+
+    query_result.bytes += len;
+    if (len > query_result.max_chunk)
+        query_result.max_chunk = len;
+    int count = sample_history_decode(chunk, len, &info, records, SAMPLE_HISTORY_CHUNK_RECORDS_MAX);
+    if (count < 0)
+    {
+        query_result.decode_errors++;
+        query_result.chunks++;
+        return 0;
+    }
+    if (info.index != query_result.chunks || query_result.last_seen)
+        query_result.bad_index++;
+    query_result.chunks++;
+    query_result.last_seen = (info.flags & SAMPLE_HISTORY_FLAG_LAST) != 0;
+    query_result.incomplete |= (info.flags & SAMPLE_HISTORY_FLAG_INCOMPLETE) != 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        const sample_record_t *record = &records[i];
+        sample_record_t expected;
+        synthetic_record(&expected, record->time_ms);
+        if (memcmp(record, &expected, sizeof(expected)) != 0)
+            query_result.mismatches++;
+        if (record->time_ms < options.from_ms || record->time_ms > options.to_ms)
+            query_result.out_of_range++;
+        if (query_result.records > 0)
+        {
+            if (record->time_ms < query_result.last_ms)
+                query_result.out_of_order++;
+            else if (record->time_ms - query_result.last_ms != options.period_ms)
+                query_result.gaps++;
+        }
+        else
+        {
+            query_result.first_ms = record->time_ms;
+        }
+        query_result.last_ms = record->time_ms;
+        query_result.records++;
+    }
+    return 0;
+}
+
+static void run_query(void)
+{
+    sample_history_request_t request = {
+        .id = 1,
+        .from_ms = options.from_ms,
+        .to_ms = options.to_ms,
+        .max_records = options.max_records,
+    };
+    int64_t start_us = esp_timer_get_time();
+    sample_history_stream(&request, check_chunk, NULL);
+    query_result.elapsed_us = esp_timer_get_time() - start_us;
+}
+
+static void write_open(FILE *out, const char *name, const open_result_t *result)
+{
+    const sample_store_stats_t *stats = &result->stats;
+    fprintf(out,
+            "  \"%s\": {\"open_us\": %lld, \"sectors\": %lu, \"used_sectors\": %lu, \"head_seq\": %lu, "
+            "\"head_records\": %lu, \"oldest_ms\": %lld, \"newest_ms\": %lld, \"torn\": %lu},\n",
+            name, (long long)result->open_us, (unsigned long)stats->sectors, (unsigned long)stats->used_sectors,
+            (unsigned long)stats->head_seq, (unsigned long)stats->head_records, (long long)stats->oldest_ms,
+            (long long)stats->newest_ms, (unsigned long)stats->torn);
+}
+
+static void write_results(const open_result_t *opened, const open_result_t *reopened)
+{
+    FILE *out = fopen(options.out_path, "w");
+    if (out == NULL)
+    {
+        perror(options.out_path);
+        return;
+    }
+    sample_store_stats_t stats;
+    sample_store.get_stats(&stats);
+
+    fprintf(out, "{\n  \"image\": \"%s\",\n", options.image);
+    write_open(out, "open", opened);
+    fprintf(out,
+            "  \"append\": {\"requested\": %lu, \"appended\": %lu, \"failed\": %lu, \"rejected\": %lu, \"erases\": %lu, "
+            "\"first_ms\": %lld, \"last_ms\": %lld, \"us_per_sample\": %.2f},\n",
+            (unsigned long)options.append, (unsigned long)append_result.appended, (unsigned long)append_result.failed,
+            (unsigned long)stats.rejected, (unsigned long)stats.erases, (long long)append_result.first_ms,
+            (long long)append_result.last_ms,
+            append_result.appended > 0 ? (double)append_result.elapsed_us / append_result.appended : 0.0);
+    if (reopened != NULL)
+        write_open(out, "recovery", reopened);
+    if (options.query)
+    {
+        fprintf(out,
+                "  \"query\": {\"chunks\": %lu, \"records\": %lu, \"bytes\": %llu, \"bytes_per_record\": %.2f, "
+                "\"max_chunk\": %zu, \"first_ms\": %lld, \"last_ms\": %lld, \"gaps\": %lu, \"incomplete\": %s, "
+                "\"elapsed_us\": %lld,\n"
+                "            \"decode_errors\": %lu, \"mismatches\": %lu, \"out_of_range\": %lu, \"out_of_order\": %lu, "
+                "\"bad_index\": %lu, \"last_flag\": %s},\n",
+                (unsigned long)query_result.chunks, (unsigned long)query_result.records,
+                (unsigned long long)query_result.bytes,
+                query_result.records > 0 ? (double)query_result.bytes / query_result.records : 0.0, query_result.max_chunk,
+                (long long)query_result.first_ms, (long long)query_result.last_ms, (unsigned long)query_result.gaps,
+                query_result.incomplete ? "true" : "false", (long long)query_result.elapsed_us,
+                (unsigned long)query_result.decode_errors, (unsigned long)query_result.mismatches,
+                (unsigned long)query_result.out_of_range, (unsigned long)query_result.out_of_order,
+                (unsigned long)query_result.bad_index, query_result.last_seen ? "true" : "false");
+    }
+    fprintf(out, "  \"record_size\": %d,\n  \"records_per_sector\": %d\n}\n", SAMPLE_STORE_RECORD_SIZE,
+            SAMPLE_STORE_RECORDS_PER_SECTOR);
+    fclose(out);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Uso: %s --image archivo [--append N] [--period-ms P] [--start-ms T] [--cut-after bytes]\n"
+            "          [--query] [--from ms] [--to ms] [--max N] [--out archivo.json]\n",
+            argv0);
+}
+
+static int parse_options(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--query") == 0)
+        {
+            options.query = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            return -1;
+        const char *value = argv[++i];
+        if (strcmp(arg, "--image") == 0)
+            options.image = value;
+        else if (strcmp(arg, "--out") == 0)
+            options.out_path = value;
+        else if (strcmp(arg, "--append") == 0)
+            options.append = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--period-ms") == 0)
+            options.period_ms = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--start-ms") == 0)
+            options.start_ms = strtoll(value, NULL, 10);
+        else if (strcmp(arg, "--cut-after") == 0)
+            options.cut_after = strtoll(value, NULL, 10);
+        else if (strcmp(arg, "--from") == 0)
+            options.from_ms = strtoll(value, NULL, 10);
+        else if (strcmp(arg, "--to") == 0)
+            options.to_ms = strtoll(value, NULL, 10);
+        else if (strcmp(arg, "--max") == 0)
+            options.max_records = strtoul(value, NULL, 10);
+        else
+            return -1;
+    }
+    return options.image != NULL && options.period_ms > 0 ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    if (parse_options(argc, argv) != 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    open_result_t opened, reopened;
+    if (open_store(&opened) != 0)
+        return 1;
+    append_samples();
+
+    bool cut = host_fault_flash_is_cut();
+    if (cut)
+    {
+        // Tras el corte: volver a encender y recuperar
+        sample_store.close();
+        if (open_store(&reopened) != 0)
+            return 1;
+    }
+    if (options.query)
+        run_query();
+
+    write_results(&opened, cut ? &reopened : NULL);
+    sample_store_stats_t stats;
+    sample_store.get_stats(&stats);
+    fprintf(stderr, "%s: %lu muestras agregadas%s, %lu sectores en uso, ultima %lld", options.image,
+            (unsigned long)append_result.appended, cut ? " (corte de energia)" : "", (unsigned long)stats.used_sectors,
+            (long long)stats.newest_ms);
+    if (options.query)
+        fprintf(stderr, "; consulta: %lu muestras en %lu bloques, %.2f bytes/muestra, %lu distintas, %lu errores",
+                (unsigned long)query_result.records, (unsigned long)query_result.chunks,
+                query_result.records > 0 ? (double)query_result.bytes / query_result.records : 0.0,
+                (unsigned long)query_result.mismatches, (unsigned long)query_result.decode_errors);
+    fprintf(stderr, " -> %s\n", options.out_path);
+    sample_store.close();
+
+    bool failed = query_result.mismatches > 0 || query_result.decode_errors > 0 || query_result.out_of_range > 0 ||
+                  query_result.out_of_order > 0 || query_result.bad_index > 0 || (options.query && !query_result.last_seen);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+/*
+ * rtc_drift_check.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Simula un dispositivo que duerme y despierta durante dias con un RTC
+ *  que deriva, y pasa por rtc_drift.c (lo mismo que usa sntp_time.c) la
+ *  secuencia de sincronizaciones SNTP y de despertares:
+ *
+ *    - al despertar aplica la correccion de deriva y compara la hora
+ *      corregida con la verdadera: el error tiene que quedar dentro de
+ *      rtc_drift_uncertainty_ms(), que es lo que decide si la hora del
+ *      RTC se usa sin esperar a SNTP;
+ *    - cada --sync-h horas sincroniza con una hora SNTP con --jitter-ms
+ *      de error y ajusta el reloj;
+ *    - a mitad de la corrida la deriva cambia --step-ppm (temperatura).
+ *      Un salto mayor que RTC_DRIFT_RESIDUAL_MIN_PPM puede pasar la cota
+ *      hasta la sincronizacion siguiente, que la agranda.
+ *
+ *  Uso: rtc_drift_check [--drift-ppm N] [--step-ppm N] [--days N]
+ *                       [--sleep-s S] [--sync-h H] [--jitter-ms MS]
+ *                       [--max-error-ms MS] [--seed N]
+ *
+ *  Sale con 1 si algun despertar tiene un error mayor que la cota, o si
+ *  al final la deriva estimada no esta dentro de su cota.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rtc_drift.h"
+
+#define CHECK_START_US 1790000000000000LL // Hora SNTP del primer arranque
+
+static struct
+{
+    int32_t drift_ppm;
+    int32_t step_ppm;
+    uint32_t days;
+    uint32_t sleep_s;
+    uint32_t sync_h;
+    uint32_t jitter_ms;
+    uint32_t max_error_ms;
+    uint32_t seed;
+} options = {
+    .drift_ppm = 35,
+    .step_ppm = 10,
+    .days = 7,
+    .sleep_s = 600,
+    .sync_h = 6,
+    .jitter_ms = 20,
+    .max_error_ms = 2000,
+    .seed = 1,
+};
+
+static uint32_t rng;
+
+static uint32_t next_random(void)
+{
+    // xorshift32
+    uint32_t x = rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng = x;
+    return x;
+}
+
+/* Error de la hora SNTP recibida, uniforme en [-jitter, +jitter] */
+static int64_t sntp_jitter_us(void)
+{
+    if (options.jitter_ms == 0)
+        return 0;
+    uint32_t span_us = 2 * options.jitter_ms * 1000;
+    return (int64_t)(next_random() % (span_us + 1)) - span_us / 2;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Uso: %s [--drift-ppm N] [--step-ppm N] [--days N] [--sleep-s S] [--sync-h H]\n"
+            "          [--jitter-ms MS] [--max-error-ms MS] [--seed N]\n",
+            argv0);
+}
+
+static int parse_options(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (value == NULL)
+            return -1;
+        i++;
+        if (strcmp(arg, "--drift-ppm") == 0)
+            options.drift_ppm = strtol(value, NULL, 10);
+        else if (strcmp(arg, "--step-ppm") == 0)
+            options.step_ppm = strtol(value, NULL, 10);
+        else if (strcmp(arg, "--days") == 0)
+            options.days = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--sleep-s") == 0)
+            options.sleep_s = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--sync-h") == 0)
+            options.sync_h = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--jitter-ms") == 0)
+            options.jitter_ms = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--max-error-ms") == 0)
+            options.max_error_ms = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--seed") == 0)
+            options.seed = strtoul(value, NULL, 10);
+        else
+            return -1;
+    }
+    return options.days > 0 && options.sleep_s > 0 && options.sync_h > 0 ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    if (parse_options(argc, argv) != 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    rng = options.seed != 0 ? options.seed : 1;
+
+    rtc_drift_t drift = {0};
+    int64_t true_us = CHECK_START_US;
+    int64_t local_us = true_us;
+    int64_t end_us = true_us + options.days * 86400LL * 1000000;
+    int64_t step_us = true_us + (end_us - true_us) / 2;
+    int64_t next_sync_us = true_us;
+    int32_t drift_ppm = options.drift_ppm;
+
+    uint32_t wakes = 0, trusted = 0, violations = 0, syncs = 0;
+    int64_t max_error_us = 0;
+    uint32_t max_uncertainty_ms = 0;
+    while (true_us < end_us)
+    {
+        if (true_us >= next_sync_us)
+        {
+            int64_t sntp_us = true_us + sntp_jitter_us();
+            rtc_drift_sync(&drift, local_us, sntp_us, NULL);
+            local_us = sntp_us;
+            next_sync_us = true_us + options.sync_h * 3600LL * 1000000;
+            syncs++;
+        }
+
+        // Deep sleep: el RTC cuenta el intervalo con su deriva
+        int64_t sleep_us = options.sleep_s * 1000000LL;
+        if (true_us < step_us && true_us + sleep_us >= step_us)
+            drift_ppm += options.step_ppm;
+        true_us += sleep_us;
+        local_us += sleep_us + sleep_us * drift_ppm / 1000000;
+
+        // Despertar: restore_rtc_time()
+        local_us -= rtc_drift_correction_us(&drift, local_us);
+        uint32_t uncertainty_ms = rtc_drift_uncertainty_ms(&drift, local_us);
+        int64_t error_us = llabs(local_us - true_us);
+        wakes++;
+        if (uncertainty_ms <= options.max_error_ms)
+            trusted++;
+        if (error_us > (int64_t)uncertainty_ms * 1000)
+        {
+            if (violations++ < 5)
+                fprintf(stderr, "Dia %.2f: error %.1f ms mayor que la cota %u ms\n",
+                        (true_us - CHECK_START_US) / 86400e6, error_us / 1000.0, uncertainty_ms);
+        }
+        if (error_us > max_error_us)
+            max_error_us = error_us;
+        if (uncertainty_ms > max_uncertainty_ms)
+            max_uncertainty_ms = uncertainty_ms;
+    }
+
+    bool converged = drift.drift_valid && (uint32_t)abs(drift.drift_ppm - drift_ppm) <= drift.drift_bound_ppm;
+    printf("%u despertares, %u sincronizaciones: %u con hora confiable (<= %u ms), error maximo %.1f ms, "
+           "cota maxima %u ms, %u fuera de la cota; deriva real %d ppm, estimada %d +/- %u ppm\n",
+           wakes, syncs, trusted, options.max_error_ms, max_error_us / 1000.0, max_uncertainty_ms, violations, drift_ppm,
+           drift.drift_ppm, drift.drift_bound_ppm);
+    if (!converged)
+        fprintf(stderr, "La deriva estimada no esta dentro de su cota\n");
+    return violations == 0 && converged ? 0 : 1;
+}
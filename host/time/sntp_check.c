@@ -0,0 +1,355 @@
+/*
+ * sntp_check.c
+ *
+ *  Created on: 19/10/2026
+ *
+ *  Corre el servicio de hora real (sntp_time.c) contra servidores NTP
+ *  locales: un respondedor UDP minimo en 127.0.0.1 que contesta con su
+ *  hora (la real mas un offset) o se queda callado. El cliente SNTP es
+ *  el del mock (esp_sntp.h), que recorre la lista como lwIP, y el reloj
+ *  del sistema es el virtual del mock. Cada caso es un arranque en frio
+ *  en un proceso aparte:
+ *
+ *    - cold_boot: el reloj arranca en 1970 como el del ESP32; el primer
+ *      servidor no contesta y el segundo si. La hora no es confiable
+ *      hasta sincronizar, wait_available() espera a SNTP y despues la
+ *      hora coincide con la del servidor dentro de la cota.
+ *    - unreachable: ningun servidor contesta (uno con el puerto cerrado,
+ *      dos callados). La hora sigue sin ser confiable hasta que uno
+ *      vuelve, y entonces sincroniza en el reintento.
+ *    - step: tras 20 minutos el servidor adelanto su hora 30 s. La hora
+ *      salta a la del servidor y el salto no se toma como deriva.
+ *    - drift: tras 20 minutos el RTC adelanta 100 ms (83 ppm), que es lo
+ *      que se estima como deriva.
+ *
+ *  Uso: sntp_check [--case nombre]
+ *
+ *  Sale con 1 si falla algun caso.
+ */
+
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esp_sntp.h"
+#include "freertos/FreeRTOS.h"
+#include "sntp_time.h"
+
+#define NTP_PACKET_LEN 48
+#define NTP_UNIX_OFFSET_S 2208988800ULL
+#define CHECK_SERVER_COUNT CONFIG_LWIP_SNTP_MAX_SERVERS
+/* Tiempo que "pasa" entre las dos sincronizaciones de step y drift */
+#define CHECK_ELAPSED_US (20 * 60 * 1000000LL)
+
+typedef struct
+{
+    int fd;
+    uint16_t port;
+    char name[32];             // "127.0.0.1:puerto" para esp_sntp_setservername()
+    atomic_bool silent;        // Recibe los pedidos pero no contesta
+    _Atomic int64_t offset_us; // Hora del servidor: la real mas este offset
+    atomic_uint requests;
+} ntp_responder_t;
+
+static ntp_responder_t responders[CHECK_SERVER_COUNT];
+static const char *server_names[CHECK_SERVER_COUNT];
+static const char *case_name = NULL;
+static int failures = 0;
+
+static int64_t real_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "  %s: FALLA %s\n", case_name, what);
+        failures++;
+    }
+}
+
+/*****************************************************
+ *   Respondedor NTP                                  *
+ ******************************************************/
+static void write_timestamp(uint8_t *out, int64_t unix_us)
+{
+    uint64_t seconds = unix_us / 1000000LL + NTP_UNIX_OFFSET_S;
+    uint64_t fraction = ((uint64_t)(unix_us % 1000000LL) << 32) / 1000000ULL;
+    uint32_t words[2] = {htonl((uint32_t)seconds), htonl((uint32_t)fraction)};
+    memcpy(out, words, sizeof(words));
+}
+
+static void *responder_task(void *arg)
+{
+    ntp_responder_t *responder = arg;
+    for (;;)
+    {
+        uint8_t packet[NTP_PACKET_LEN];
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t len = recvfrom(responder->fd, packet, sizeof(packet), 0, (struct sockaddr *)&from, &from_len);
+        int64_t received_us = real_time_us() + responder->offset_us;
+        if (len < NTP_PACKET_LEN)
+            continue;
+        responder->requests++;
+        if (responder->silent)
+            continue;
+
+        // Modo servidor, misma version, stratum 2; originate = transmit del pedido
+        uint8_t version = packet[0] & 0x38;
+        memcpy(&packet[24], &packet[40], 8);
+        packet[0] = version | 4;
+        packet[1] = 2;
+        packet[2] = 6;
+        packet[3] = 0xEC;
+        memset(&packet[4], 0, 12);
+        write_timestamp(&packet[16], received_us);
+        write_timestamp(&packet[32], received_us);
+        write_timestamp(&packet[40], real_time_us() + responder->offset_us);
+        sendto(responder->fd, packet, sizeof(packet), 0, (struct sockaddr *)&from, from_len);
+    }
+    return NULL;
+}
+
+static bool responder_start(ntp_responder_t *responder)
+{
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t addr_len = sizeof(addr);
+    responder->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (responder->fd < 0 || bind(responder->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        getsockname(responder->fd, (struct sockaddr *)&addr, &addr_len) != 0)
+        return false;
+    responder->port = ntohs(addr.sin_port);
+    snprintf(responder->name, sizeof(responder->name), "127.0.0.1:%u", responder->port);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, responder_task, responder) != 0)
+        return false;
+    pthread_detach(thread);
+    return true;
+}
+
+/* Un puerto que nadie escucha: el pedido vuelve rechazado (ICMP) */
+static bool closed_port_name(char *name, size_t name_len)
+{
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t addr_len = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &addr_len) != 0)
+        return false;
+    close(fd);
+    snprintf(name, name_len, "127.0.0.1:%u", ntohs(addr.sin_port));
+    return true;
+}
+
+/*****************************************************
+ *   Casos                                            *
+ ******************************************************/
+static int64_t server_time_ms(const ntp_responder_t *responder)
+{
+    return (real_time_us() + responder->offset_us) / 1000;
+}
+
+static int64_t clock_error_ms(const ntp_responder_t *responder)
+{
+    return llabs(time_service.get_time_ms() - server_time_ms(responder));
+}
+
+/* El ESP32 arranca en 1970 tras un encendido; el host, con su hora real */
+static void cold_boot_clock(void)
+{
+    host_clock_adjust_us(-real_time_us());
+}
+
+static void start_service(void)
+{
+    time_service.set_servers(server_names, CHECK_SERVER_COUNT);
+    time_service.initialize();
+}
+
+static void check_untrusted(void)
+{
+    check(time_service.get_quality() == TIME_QUALITY_UNSET, "la hora no deberia tener calidad");
+    check(!time_service.is_trusted(), "la hora no deberia ser confiable");
+    check(time_service.get_uncertainty_ms() == UINT32_MAX, "sin hora la incertidumbre deberia ser UINT32_MAX");
+}
+
+static void check_synced(const ntp_responder_t *responder)
+{
+    check(time_service.get_quality() == TIME_QUALITY_SNTP, "la calidad deberia ser SNTP");
+    check(time_service.is_trusted(), "la hora sincronizada deberia ser confiable");
+    check(time_service.get_uncertainty_ms() <= SNTP_TIME_SYNC_UNCERTAINTY_MS + 1, "incertidumbre mayor que la de una sincronizacion");
+    check(clock_error_ms(responder) <= SNTP_TIME_SYNC_UNCERTAINTY_MS, "la hora no coincide con la del servidor");
+}
+
+/* Fuerza una consulta y espera a que sntp_sync_time() la aplique */
+static bool resync(void)
+{
+    sntp_set_sync_status(SNTP_SYNC_STATUS_RESET);
+    esp_sntp_restart();
+    for (int i = 0; i < 50 && sntp_get_sync_status() != SNTP_SYNC_STATUS_COMPLETED; i++)
+        usleep(100000);
+    return sntp_get_sync_status() == SNTP_SYNC_STATUS_COMPLETED;
+}
+
+static void case_cold_boot(void)
+{
+    responders[0].silent = true;
+    cold_boot_clock();
+    start_service();
+    check_untrusted();
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    check(time_service.wait_available(pdMS_TO_TICKS(3 * HOST_SNTP_RECV_TIMEOUT_MS)), "wait_available() no vio la sincronizacion");
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    int64_t waited_ms = (end.tv_sec - start.tv_sec) * 1000LL + (end.tv_nsec - start.tv_nsec) / 1000000;
+
+    check(responders[0].requests == 1, "el primer servidor deberia recibir un pedido");
+    check(responders[1].requests == 1, "el segundo servidor deberia recibir un pedido");
+    check(responders[2].requests == 0, "el tercer servidor no deberia consultarse");
+    check(waited_ms >= HOST_SNTP_RECV_TIMEOUT_MS * 9 / 10, "se paso al segundo servidor sin esperar al primero");
+    check_synced(&responders[1]);
+
+    time_service.set_max_error_ms(SNTP_TIME_SYNC_UNCERTAINTY_MS - 1);
+    check(!time_service.is_trusted(), "con un error maximo menor a la incertidumbre no deberia ser confiable");
+}
+
+static void case_unreachable(void)
+{
+    static char closed_name[32];
+    if (!closed_port_name(closed_name, sizeof(closed_name)))
+    {
+        check(false, "no se pudo reservar un puerto cerrado");
+        return;
+    }
+    server_names[0] = closed_name;
+    for (int i = 1; i < CHECK_SERVER_COUNT; i++)
+        responders[i].silent = true;
+    start_service();
+
+    check(!time_service.wait_available(pdMS_TO_TICKS(3 * HOST_SNTP_RECV_TIMEOUT_MS)), "sin servidores la hora no deberia estar disponible");
+    check_untrusted();
+    for (int i = 1; i < CHECK_SERVER_COUNT; i++)
+        check(responders[i].requests >= 1, "todos los servidores deberian consultarse");
+
+    responders[2].silent = false;
+    check(time_service.wait_available(pdMS_TO_TICKS(4 * HOST_SNTP_RECV_TIMEOUT_MS + HOST_SNTP_RETRY_MS)),
+          "no sincronizo cuando el servidor volvio");
+    check_synced(&responders[2]);
+}
+
+static void case_step(void)
+{
+    start_service();
+    check(time_service.wait_available(pdMS_TO_TICKS(2 * HOST_SNTP_RECV_TIMEOUT_MS)), "no sincronizo");
+    check_synced(&responders[0]);
+
+    host_clock_adjust_us(CHECK_ELAPSED_US);
+    responders[0].offset_us += CHECK_ELAPSED_US + 30 * 1000000LL;
+    check(resync(), "no hubo segunda sincronizacion");
+    check_synced(&responders[0]);
+    check(time_service.get_drift_ppm() == 0, "el salto de 30 s se tomo como deriva");
+}
+
+static void case_drift(void)
+{
+    start_service();
+    check(time_service.wait_available(pdMS_TO_TICKS(2 * HOST_SNTP_RECV_TIMEOUT_MS)), "no sincronizo");
+
+    host_clock_adjust_us(CHECK_ELAPSED_US + 100000);
+    responders[0].offset_us += CHECK_ELAPSED_US;
+    check(resync(), "no hubo segunda sincronizacion");
+    check_synced(&responders[0]);
+    int32_t drift_ppm = time_service.get_drift_ppm();
+    check(drift_ppm >= 80 && drift_ppm <= 86, "la deriva estimada no es la del RTC (83 ppm)");
+}
+
+static const struct
+{
+    const char *name;
+    void (*run)(void);
+} cases[] = {
+    {"cold_boot", case_cold_boot},
+    {"unreachable", case_unreachable},
+    {"step", case_step},
+    {"drift", case_drift},
+};
+
+/* Cada caso en su proceso: sntp_time.c se inicializa una vez por arranque */
+static bool run_case(int index)
+{
+    pid_t pid = fork();
+    if (pid < 0)
+        return false;
+    if (pid == 0)
+    {
+        case_name = cases[index].name;
+        for (int i = 0; i < CHECK_SERVER_COUNT; i++)
+        {
+            if (!responder_start(&responders[i]))
+            {
+                perror("sntp_check");
+                _exit(1);
+            }
+            server_names[i] = responders[i].name;
+        }
+        cases[index].run();
+        _exit(failures > 0 ? 1 : 0);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    printf("%-12s %s\n", cases[index].name, ok ? "ok" : "FALLA");
+    return ok;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Uso: %s [--case nombre]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *only = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--case") == 0 && i + 1 < argc)
+            only = argv[++i];
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    int run = 0, failed = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        if (only != NULL && strcmp(only, cases[i].name) != 0)
+            continue;
+        run++;
+        if (!run_case(i))
+            failed++;
+    }
+    if (run == 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    printf("%d casos, %d con fallas\n", run, failed);
+    return failed > 0 ? 1 : 0;
+}
@@ -13,10 +13,24 @@
 #include "esp_event.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
+#include "sdkconfig.h"
 
 #include "wifi_manager.h"
 #include "temp_sensor.h"
 #include "clearblade_connect.h"
+#include "boot_timeline.h"
+#include "config_store.h"
+#include "telemetry_dispatch.h"
+#include "msg_sequence.h"
+#include "sample_store.h"
+#include "sample_history.h"
+#include "deferred_log.h"
+#include "state_shadow.h"
+#include "ota_update.h"
+#include "status_server.h"
+#include "resource_monitor.h"
+#include "energy_meter.h"
+#include "health_supervisor.h"
 
 #define WIFI_SSID "tu-ssid"     // !!!!!!!!!!! Configurar
 #define WIFI_PASSWORD "tu-wifi-password" // !!!!!!!!!!! Configurar
@@ -24,6 +38,9 @@
 #define CLEARBLADE_PROJECT_ID "daiot-practica"
 #define CLEARBLADE_REGION "us-central1"
 #define CLEARBLADE_REGISTRY "registry_1"
+#define SENSOR_TRACE_PARTITION "trace" // partitions.csv
+#define SAMPLE_STORE_PARTITION "samples" // partitions.csv
+#define MAIN_LOOP_PERIOD_MS (4 * 60 * 1000)
 
 // Configurar CLEARBLADE_DEVICE_ID segun tu nombre
 #define CLEARBLADE_DEVICE_ID "device-10x" // Ejemplo para Leopoldo: "device-101"
@@ -42,11 +59,94 @@ static const char *TAG = "Main section";
 
 void wifi_got_ip_event_callback(void)
 {
+    boot_timeline.stamp(BOOT_PHASE_GOT_IP);
     mqtt_client.set_network_available_flag(true);
 }
 
+/* Station disconnected, IP lost or Wi-Fi restarted: no network until the next IP */
+void wifi_disconnected_event_callback(void)
+{
+    mqtt_client.set_network_available_flag(false);
+}
+
+/* Messages on config are handled by the connector; commands arrive here */
+void mqtt_data_callback(clearblade_client_t *client, const char *topic, int topic_len, const char *data, int data_len, void *ctx)
+{
+    if (sample_history.handle_command(topic, topic_len, data, data_len))
+        return;
+    if (ota_update.handle_command(topic, topic_len, data, data_len))
+        return;
+    ESP_LOGI(TAG, "Unhandled message on %.*s", topic_len, topic);
+}
+
+/* Stack/heap alerts share the alarm queue; the periodic report goes out on its own subtopic */
+void resource_report_callback(const char *json, int len, bool alert, void *ctx)
+{
+    if (alert)
+        telemetry_dispatch.send(TELEMETRY_CLASS_ALARM, json, len);
+    else if (xEventGroupGetBits(*mqtt_client.mqtt_event_group) & CONNECTED_TO_MQTT_BROKER)
+        clearblade_client_publish(mqtt_client.instance, "events/resources", json, len, 0);
+}
+
+/* Energy summaries go out on their own subtopic; the previous wake cycle is retried until connected */
+bool energy_report_callback(const char *json, int len, bool cycle, void *ctx)
+{
+    EventGroupHandle_t mqtt_event_group = *mqtt_client.mqtt_event_group;
+    if (mqtt_event_group == NULL || !(xEventGroupGetBits(mqtt_event_group) & CONNECTED_TO_MQTT_BROKER))
+        return false;
+    return clearblade_client_publish(mqtt_client.instance, "events/energy", json, len, cycle ? 1 : 0) >= 0;
+}
+
+/* Escalation alerts and the boot reason share the alarm queue; the periodic report goes out on its own subtopic */
+bool health_report_callback(const char *json, int len, health_report_kind_t kind, void *ctx)
+{
+    if (kind != HEALTH_REPORT_PERIODIC)
+        return telemetry_dispatch.send(TELEMETRY_CLASS_ALARM, json, len) == ESP_OK;
+    EventGroupHandle_t mqtt_event_group = *mqtt_client.mqtt_event_group;
+    if (mqtt_event_group == NULL || !(xEventGroupGetBits(mqtt_event_group) & CONNECTED_TO_MQTT_BROKER))
+        return false;
+    return clearblade_client_publish(mqtt_client.instance, "events/health", json, len, 0) >= 0;
+}
+
+/* Runs on the supervisor task; before a reboot only saves what would otherwise be lost */
+esp_err_t health_recovery_callback(health_action_t action, const char *task, void *ctx)
+{
+    switch (action)
+    {
+    case HEALTH_ACTION_RESTART_CLIENT:
+        return clearblade_client_restart(mqtt_client.instance);
+    case HEALTH_ACTION_RESTART_WIFI:
+        return wifi_manager.restart();
+    case HEALTH_ACTION_REBOOT:
+        energy_meter.end_cycle(0);
+        deferred_log.flush();
+        return ESP_OK;
+    default:
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+}
+
 void app_main(void)
 {
+    // Boot phase timeline (RTC)
+    boot_timeline.initialize();
+
+    // Deferred log: DLOGx calls only copy their arguments, a low priority task formats them
+    ESP_ERROR_CHECK_WITHOUT_ABORT(deferred_log.start());
+
+    // Stack high-water marks of every task and heap fragmentation, reported every 15 minutes
+    resource_monitor.set_report_callback(resource_report_callback, NULL);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(resource_monitor.start());
+
+    // Radio-on time, TX bytes (MQTT and TLS), handshakes, JWT signs and CPU time, charged per sample every 15 minutes
+    energy_meter.set_report_callback(energy_report_callback, NULL);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(energy_meter.start());
+
+    // Heartbeat deadlines of the critical loops: client restart, then Wi-Fi restart, then reboot (reason kept in RTC)
+    health_supervisor.set_report_callback(health_report_callback, NULL);
+    health_supervisor.set_recovery_callback(health_recovery_callback, NULL);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(health_supervisor.start());
+
     // Initialize NVS
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
@@ -55,14 +155,26 @@ void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    boot_timeline.stamp(BOOT_PHASE_NVS_INIT);
+
+    // Load device configuration from NVS into RAM (once)
+    ESP_ERROR_CHECK_WITHOUT_ABORT(config_store.load());
+
+    // Message sequence number: RTC across deep sleep, NVS block checkpoint across power loss
+    ESP_ERROR_CHECK_WITHOUT_ABORT(msg_sequence.initialize());
+
+    // Sample history on its own flash partition; recovers the write position after a power loss
+    ESP_ERROR_CHECK_WITHOUT_ABORT(sample_store.open(SAMPLE_STORE_PARTITION));
 
     // Initialize Default Event Loop
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
     // Wi-Fi manager configuration
     wifi_manager.wifi_init();
+    boot_timeline.stamp(BOOT_PHASE_WIFI_INIT);
     wifi_manager.set_sta_credentials(WIFI_SSID, WIFI_PASSWORD);
     wifi_manager.set_got_ip_callback(wifi_got_ip_event_callback);
+    wifi_manager.set_disconnected_callback(wifi_disconnected_event_callback);
 
     // Clearblade MQTT cliente configuration
     mqtt_client.set_clearblade_data(
@@ -71,22 +183,56 @@ void app_main(void)
         CLEARBLADE_REGION,
         CLEARBLADE_REGISTRY,
         CLEARBLADE_DEVICE_ID);
+    clearblade_client_set_data_callback(mqtt_client.instance, mqtt_data_callback, NULL);
     mqtt_client.start();
+    // Alarms go out immediately (events/alarm, QoS 1); routine samples are batched (events/batch, QoS 0)
+    ESP_ERROR_CHECK_WITHOUT_ABORT(telemetry_dispatch.start(mqtt_client.instance));
+    // /commands/history requests are streamed back from the sample store to events/history
+    ESP_ERROR_CHECK_WITHOUT_ABORT(sample_history.start(mqtt_client.instance));
+    // Prometheus /metrics and JSON /status for on-site collectors, served on the SoftAP only
+    ESP_ERROR_CHECK_WITHOUT_ABORT(status_server.start(mqtt_client.instance, STATUS_SERVER_PORT));
+    // Device state on /state: only changed fields after a coalescing window, a full snapshot on every connect
+    ESP_ERROR_CHECK_WITHOUT_ABORT(state_shadow.start(mqtt_client.instance));
+    // /commands/ota: signed delta (or full) images streamed into the inactive OTA slot, progress on events/ota
+    ESP_ERROR_CHECK_WITHOUT_ABORT(ota_update.start(mqtt_client.instance));
 
     // Temp sensor simulator config
     tempSensor.initialize();
-    tempSensor.set_mqtt_info("", CLEARBLADE_DEVICE_ID, mqtt_client.client_handle);
+    tempSensor.set_mqtt_info("", CLEARBLADE_DEVICE_ID, mqtt_client.instance);
+    // With a recorded trace in the "trace" partition, it is replayed instead of the TPH model
+    if (tempSensor.set_source(&sensor_source_trace, SENSOR_TRACE_PARTITION) != ESP_OK)
+        ESP_LOGI(TAG, "No sensor trace, using the TPH model");
 
     /* Main loop */
+    // Beats after every publish, or while the station has no IP and is still retrying (NETWORK_AVAILABLE
+    // is cleared on every disconnect): restarting the client or rebooting does not bring an AP back.
+    // Once the station gives up, the missed deadline escalates to a Wi-Fi restart, which retries again.
+    // A broker connection that never comes back with the network up escalates all the way to a reboot
+    int health_id = health_supervisor.register_task("app_main", MAIN_LOOP_PERIOD_MS + HEALTH_SUPERVISOR_WAIT_MS);
     while (true)
     {
         tempSensor.sample_temp();
         ESP_LOGI(TAG, "Temp: %s", tempSensor.temp_string);
-        xEventGroupWaitBits(*mqtt_client.mqtt_event_group, NETWORK_AVAILABLE | CONNECTED_TO_MQTT_BROKER,
-                            pdFALSE,
-                            pdTRUE,
-                            portMAX_DELAY);
-        tempSensor.publish_to_mqtt();
-        vTaskDelay(4 * 60 * 1000 / portTICK_PERIOD_MS); // publica cada 4 minutos
+        EventBits_t bits = xEventGroupWaitBits(*mqtt_client.mqtt_event_group,
+                                               NETWORK_AVAILABLE | CONNECTED_TO_MQTT_BROKER,
+                                               pdFALSE,
+                                               pdTRUE,
+                                               pdMS_TO_TICKS(HEALTH_SUPERVISOR_WAIT_MS));
+        bool connected = (bits & CONNECTED_TO_MQTT_BROKER) && (bits & NETWORK_AVAILABLE);
+        // The wait only decides the heartbeat: with the dispatcher running the sample is queued anyway, and
+        // the bulk queue keeps the newest TELEMETRY_DISPATCH_BULK_DEPTH samples until the broker is back
+        if (connected || telemetry_dispatch.is_running())
+        {
+            tempSensor.publish_to_mqtt();
+        }
+        else
+        {
+            // Only kept in the sample store, and only if it has a valid timestamp
+            ESP_LOGW(TAG, "Not connected, sample not published");
+        }
+        if (connected ||
+            (!(bits & NETWORK_AVAILABLE) && !(xEventGroupGetBits(*wifi_manager.wifi_event_group) & WIFI_STA_FAIL_BIT)))
+            health_supervisor.beat(health_id);
+        vTaskDelay(MAIN_LOOP_PERIOD_MS / portTICK_PERIOD_MS); // publica cada 4 minutos
     }
 }